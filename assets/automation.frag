@@ -0,0 +1,21 @@
+#version 450
+
+layout(location = 0) in float across;
+
+layout(push_constant) uniform constants {
+  vec4 rect;
+  vec4 color;
+  vec2 size;
+  vec2 range;
+  uvec2 start;
+  float span;
+} PushConstants;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+  // soft edges instead of multisampling
+  float edge = 1.0 - smoothstep(0.5, 1.0, abs(across));
+  vec4 color = PushConstants.color;
+  outColor = vec4(color.rgb, color.a * edge);
+}
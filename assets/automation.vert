@@ -0,0 +1,108 @@
+#version 450
+
+// one instance per segment between neighbouring breakpoints. the breakpoint
+// buffer is bound twice, the second binding one breakpoint further on, so
+// each instance sees both of its ends. the segment is traced as STEPS short
+// thick lines over the part of it that's in view
+layout(location = 0) in uvec2 position; // samples, low and high words
+layout(location = 1) in float value;
+layout(location = 2) in uint shape;
+layout(location = 3) in vec2 control;
+layout(location = 4) in uvec2 nextPosition;
+layout(location = 5) in float nextValue;
+
+layout(push_constant) uniform constants {
+  vec4 rect; // x, y, width, height
+  vec4 color;
+  vec2 size;
+  vec2 range;  // values at the bottom and the top
+  uvec2 start; // first sample in view, low and high words
+  float span;  // samples in view
+} PushConstants;
+
+layout(location = 0) out float across; // -1 to 1 across the line
+
+const int STEPS = 32;
+const float HALF_WIDTH = 1.5;
+
+// enum AutomationShape
+const uint HOLD = 0u;
+const uint EXPONENTIAL = 2u;
+const uint BEZIER = 3u;
+
+// x runs along the line, y across it
+const vec2 corners[6] = vec2[](vec2(0, -1), vec2(1, -1), vec2(1, 1),
+                               vec2(1, 1), vec2(0, 1), vec2(0, -1));
+
+// samples from the first one in view, negative before it. the difference is
+// taken in integers so far away positions keep their precision
+float relative(uvec2 p) {
+  uvec2 s = PushConstants.start;
+  bool before = p.y < s.y || (p.y == s.y && p.x < s.x);
+  uvec2 a = before ? s : p;
+  uvec2 b = before ? p : s;
+  uint low = a.x - b.x;
+  uint high = a.y - b.y - (a.x < b.x ? 1u : 0u);
+  float d = float(high) * 4294967296.0 + float(low);
+  return before ? -d : d;
+}
+
+// matches segmentValue in src/automation.c
+float valueAt(float t) {
+  if (shape == EXPONENTIAL && value * nextValue > 0.0) {
+    return value * pow(nextValue / value, t);
+  }
+  if (shape == BEZIER) {
+    float s = 1.0 - t;
+    return s * s * s * value + 3.0 * s * s * t * control.x +
+           3.0 * s * t * t * control.y + t * t * t * nextValue;
+  }
+  return mix(value, nextValue, t);
+}
+
+float x0, extent, from, to;
+
+// point k of the STEPS + 1 along the visible part, in window coordinates.
+// a held segment runs flat for all but the last line, which is the jump
+vec2 pointAt(int k) {
+  float t, v;
+  if (shape == HOLD) {
+    t = mix(from, to, min(float(k) / float(STEPS - 1), 1.0));
+    v = k == STEPS && to == 1.0 ? nextValue : value;
+  } else {
+    t = mix(from, to, float(k) / float(STEPS));
+    v = valueAt(t);
+  }
+
+  vec4 rect = PushConstants.rect;
+  vec2 range = PushConstants.range;
+  float x = rect.x + (x0 + t * extent) / PushConstants.span * rect.z;
+  float height = clamp((v - range.x) / (range.y - range.x), 0.0, 1.0);
+  return vec2(x, rect.y + rect.w - height * rect.w);
+}
+
+void main() {
+  x0 = relative(position);
+  extent = relative(nextPosition) - x0;
+  from = 0.0;
+  to = 1.0;
+  if (extent > 0.0) {
+    from = clamp(-x0 / extent, 0.0, 1.0);
+    to = clamp((PushConstants.span - x0) / extent, 0.0, 1.0);
+  }
+
+  int line = gl_VertexIndex / 6;
+  vec2 corner = corners[gl_VertexIndex % 6];
+  vec2 a = pointAt(line);
+  vec2 b = pointAt(line + 1);
+
+  // thick along the normal, and a little past both ends so lines join
+  vec2 along = b - a;
+  along = dot(along, along) > 1e-6 ? normalize(along) : vec2(1, 0);
+  vec2 normal = vec2(-along.y, along.x);
+  vec2 p = mix(a, b, corner.x) + normal * corner.y * HALF_WIDTH +
+           along * (corner.x * 2.0 - 1.0) * HALF_WIDTH;
+
+  gl_Position = vec4(p / PushConstants.size * 2 - 1, 0.0, 1.0);
+  across = corner.y;
+}
@@ -0,0 +1,34 @@
+#version 450
+
+layout(location = 0) in vec2 local;
+layout(location = 1) flat in vec3 levels; // peak, rms, hold
+
+layout(location = 0) out vec4 outColor;
+
+// -15 dB and -6 dB on the -60..0 scale
+vec3 zone(float y) {
+  if (y < 0.75) {
+    return vec3(0.2, 0.75, 0.3);
+  } else if (y < 0.9) {
+    return vec3(0.9, 0.8, 0.2);
+  }
+  return vec3(0.9, 0.2, 0.2);
+}
+
+void main() {
+  float y = local.y;
+  vec3 color = zone(y);
+
+  if (y <= levels.y) {
+    outColor = vec4(color, 1.0);
+  } else if (y <= levels.x) {
+    outColor = vec4(color, 0.45);
+  } else {
+    outColor = vec4(0.15, 0.15, 0.15, 1.0);
+  }
+
+  // a line about two pixels thick
+  if (levels.z > 0.0 && abs(y - levels.z) < fwidth(y)) {
+    outColor = vec4(zone(levels.z), 1.0);
+  }
+}
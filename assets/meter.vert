@@ -0,0 +1,47 @@
+#version 450
+
+// one instance per meter, see struct MeterInstance in src/meter.h
+layout(location = 0) in vec4 rect; // x, y, width, height
+layout(location = 1) in vec3 peak; // level, from, time
+layout(location = 2) in vec3 rms;  // level, from, time
+layout(location = 3) in vec2 hold; // level, time
+
+layout(push_constant) uniform constants {
+  vec2 size;
+  float time;
+} PushConstants;
+
+layout(location = 0) out vec2 local;       // 0..1 across the meter, y up
+layout(location = 1) flat out vec3 levels; // peak, rms, hold as heights
+
+const float FLOOR_DB = -60.0;
+const float DECAY_DB_PER_SECOND = 24.0;
+const float HOLD_SECONDS = 1.5;
+
+const vec2 corners[6] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1),
+                               vec2(1, 1), vec2(0, 1), vec2(0, 0));
+
+// matches meterShown in src/meter.c
+float shown(vec3 level) {
+  float since = PushConstants.time - level.z;
+  return max(level.x, level.y - DECAY_DB_PER_SECOND * since);
+}
+
+float height(float db) {
+  return clamp((db - FLOOR_DB) / -FLOOR_DB, 0.0, 1.0);
+}
+
+void main() {
+  vec2 corner = corners[gl_VertexIndex];
+  vec2 pos = rect.xy + corner * rect.zw;
+  gl_Position = vec4(pos / PushConstants.size * 2 - 1, 0.0, 1.0);
+  local = vec2(corner.x, 1 - corner.y);
+
+  float p = shown(peak);
+  float since = PushConstants.time - hold.y;
+  float h = hold.x;
+  if (since >= HOLD_SECONDS) {
+    h -= DECAY_DB_PER_SECOND * (since - HOLD_SECONDS);
+  }
+  levels = vec3(height(p), height(shown(rms)), height(max(h, p)));
+}
@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in vec2 local;
+layout(location = 1) flat in vec2 extent;
+layout(location = 2) flat in vec3 color;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+  // a darker outline a pixel wide so neighbouring notes stay apart
+  bool edge = local.x < 1.0 || local.y < 1.0 || local.x > extent.x - 1.0 ||
+              local.y > extent.y - 1.0;
+  outColor = vec4(edge ? color * 0.5 : color, 1.0);
+}
@@ -0,0 +1,61 @@
+#version 450
+
+// one instance per note, a quad from the shared corners. the note columns
+// are separate vertex buffers, each read at the instance's index
+layout(location = 0) in vec2 pos; // corner of the unit quad
+layout(location = 1) in uvec2 start; // samples, low and high words
+layout(location = 2) in uint duration;
+layout(location = 3) in uint pitch;
+layout(location = 4) in uint velocity;
+
+layout(push_constant) uniform constants {
+  vec4 rect; // x, y, width, height
+  vec2 size;
+  uvec2 start; // first sample in view, low and high words
+  float span;  // samples in view
+  float low;   // pitches at the bottom and top
+  float high;
+} PushConstants;
+
+layout(location = 0) out vec2 local;       // pixels from the top left
+layout(location = 1) flat out vec2 extent; // note size in pixels
+layout(location = 2) flat out vec3 color;
+
+// samples from the first one in view, negative before it. the difference is
+// taken in integers so far away positions keep their precision
+float relative(uvec2 p) {
+  uvec2 s = PushConstants.start;
+  bool before = p.y < s.y || (p.y == s.y && p.x < s.x);
+  uvec2 a = before ? s : p;
+  uvec2 b = before ? p : s;
+  uint low = a.x - b.x;
+  uint high = a.y - b.y - (a.x < b.x ? 1u : 0u);
+  float d = float(high) * 4294967296.0 + float(low);
+  return before ? -d : d;
+}
+
+void main() {
+  vec4 rect = PushConstants.rect;
+  float rows = PushConstants.high - PushConstants.low + 1.0;
+  float row = rect.w / rows;
+
+  float scale = rect.z / PushConstants.span;
+  float x0 = rect.x + relative(start) * scale;
+  float x1 = x0 + float(duration) * scale;
+  float y0 = rect.y + (PushConstants.high - float(pitch)) * row;
+
+  // clipped to the rectangle, at least a pixel wide so short notes show
+  float left = max(x0, rect.x);
+  float right = min(max(x1, x0 + 1.0), rect.x + rect.z);
+  bool hidden = right <= left || float(pitch) < PushConstants.low ||
+                float(pitch) > PushConstants.high;
+
+  vec2 p = mix(vec2(left, y0), vec2(right, y0 + row), pos);
+  gl_Position = hidden ? vec4(2.0, 2.0, 0.0, 1.0)
+                       : vec4(p / PushConstants.size * 2 - 1, 0.0, 1.0);
+
+  local = (p - vec2(x0, y0));
+  extent = vec2(max(x1 - x0, 1.0), row);
+  color = mix(vec3(0.25, 0.45, 0.85), vec3(1.0, 0.55, 0.2),
+              float(velocity) / 127.0);
+}
@@ -0,0 +1,7 @@
+#version 450
+
+layout(location = 0) flat in vec4 fill;
+
+layout(location = 0) out vec4 outColor;
+
+void main() { outColor = fill; }
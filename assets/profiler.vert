@@ -0,0 +1,20 @@
+#version 450
+
+// one instance per bar, see struct ProfilerInstance in src/profilerlayer.c
+layout(location = 0) in vec4 rect; // x, y, width, height
+layout(location = 1) in vec4 color;
+
+layout(push_constant) uniform constants {
+  vec2 size;
+} PushConstants;
+
+layout(location = 0) flat out vec4 fill;
+
+const vec2 corners[6] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1),
+                               vec2(1, 1), vec2(0, 1), vec2(0, 0));
+
+void main() {
+  vec2 pos = rect.xy + corners[gl_VertexIndex] * rect.zw;
+  gl_Position = vec4(pos / PushConstants.size * 2 - 1, 0.0, 1.0);
+  fill = color;
+}
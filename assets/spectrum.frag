@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in float below;
+
+layout(push_constant) uniform constants {
+  vec4 rect;
+  vec4 color;
+  vec2 size;
+  int first;
+  int points;
+} PushConstants;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+  // a line about two pixels thick along the curve over a faint fill
+  float line = 1.0 - clamp(below - 1.0, 0.0, 1.0);
+  vec4 color = PushConstants.color;
+  outColor = vec4(color.rgb, color.a * mix(0.2, 1.0, line));
+}
@@ -0,0 +1,37 @@
+#version 450
+
+// one instance per segment between neighbouring points of a curve. the
+// heights buffer is bound twice, the second binding one point further on,
+// so each instance sees both of its ends
+layout(location = 0) in float left;
+layout(location = 1) in float right;
+
+layout(push_constant) uniform constants {
+  vec4 rect; // x, y, width, height
+  vec4 color;
+  vec2 size;
+  int first; // instance index of this curve's first point
+  int points;
+} PushConstants;
+
+layout(location = 0) out float below; // pixels under the curve
+
+// x runs along the segment, y from the curve (0) down to the bottom (1)
+const vec2 corners[6] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1),
+                               vec2(1, 1), vec2(0, 1), vec2(0, 0));
+
+void main() {
+  vec2 corner = corners[gl_VertexIndex];
+  vec4 rect = PushConstants.rect;
+
+  float segment = float(gl_InstanceIndex - PushConstants.first);
+  float step = rect.z / float(PushConstants.points - 1);
+  float x = rect.x + (segment + corner.x) * step;
+
+  float bottom = rect.y + rect.w;
+  float top = bottom - mix(left, right, corner.x) * rect.w;
+  float y = mix(top, bottom, corner.y);
+
+  gl_Position = vec4(vec2(x, y) / PushConstants.size * 2 - 1, 0.0, 1.0);
+  below = y - top;
+}
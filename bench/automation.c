@@ -0,0 +1,178 @@
+// block rendering of automation against evaluating it one sample at a time:
+// first that the values match, then what each costs during playback
+#include "automation.h"
+#include "clock.h"
+#include "dsp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE 48000
+#define BLOCK 256
+#define POINTS 2000
+#define SPACING 4000 // average samples between breakpoints
+#define SECONDS 60
+
+static float randomValue(void) { return (float)rand() / RAND_MAX * 2 - 1; }
+
+// every shape, a few jumps, and values on both sides of zero so exponential
+// segments also take the linear way out
+static Automation makeCurve(void) {
+  struct Breakpoint points[POINTS];
+  uint64_t position = 1000;
+  for (int i = 0; i < POINTS; i++) {
+    points[i] = (struct Breakpoint){
+        .position = position,
+        .value = randomValue(),
+        .shape = (uint32_t)(rand() % 4),
+        .control = {randomValue(), randomValue()},
+    };
+    if (rand() % 10) {
+      position += 1 + rand() % (2 * SPACING);
+    }
+  }
+  return makeAutomation(points, POINTS);
+}
+
+static int check(Automation curve) {
+  uint64_t end = automationPoints(curve)[POINTS - 1].position + 5000;
+  float *rendered = malloc(BLOCK * sizeof(float));
+  struct AutomationCursor playback = {0}, single = {0};
+  double worst = 0;
+
+  // odd block sizes so segments end anywhere in a block, and a few seeks
+  for (uint64_t position = 0; position < end;) {
+    int frames = 1 + rand() % BLOCK;
+    automationRender(curve, &playback, position, rendered, frames);
+    for (int i = 0; i < frames; i++) {
+      float expected = automationValue(curve, &single, position + i);
+      worst = fmax(worst, fabs(rendered[i] - expected));
+    }
+    position += frames;
+    if (rand() % 200 == 0) {
+      position = (uint64_t)rand() % end;
+    }
+  }
+  free(rendered);
+
+  // the visible range covers the view and nothing more than it needs
+  int visible = 1;
+  for (int i = 0; i < 1000 && visible; i++) {
+    uint64_t start = (uint64_t)rand() % end;
+    uint64_t stop = start + 1 + rand() % (20 * SPACING);
+    int first, count = automationVisible(curve, start, stop, &first);
+    const struct Breakpoint *p = automationPoints(curve) + first;
+    int last = first + count - 1;
+    visible = (first == 0 || p[0].position <= start) &&
+              (first + 1 >= POINTS || p[1].position > start) &&
+              (last == POINTS - 1 || p[count - 1].position >= stop) &&
+              (count < 2 || p[count - 2].position < stop);
+  }
+
+  int ok = worst < 1e-4 && visible;
+  printf("check: %d points, largest error %.2e, visible ranges %s%s\n",
+         POINTS, worst, visible ? "right" : "wrong", ok ? "" : " (FAILED)");
+  return ok;
+}
+
+// a lane shared the way the daw shares it: new curves from the ui, the
+// node picking them up, the old ones coming back to be freed. a ui that never
+// collects still has every old curve freed by its next edit. a lane made
+// without a curve is silent
+static int checkLane(Automation curve, int collecting) {
+  AutomationLane lane = makeAutomationLane(curve);
+  float out[BLOCK];
+  float *outputs[] = {out};
+  struct ProcessContext ctx = {BLOCK, 0, 1, 0, 1, NULL, outputs, NULL};
+
+  Automation edited = curve;
+  automationRetain(edited);
+  for (int i = 0; i < 100; i++) {
+    struct Breakpoint p = {
+        .position = (uint64_t)i * BLOCK,
+        .value = (float)i / 100,
+        .shape = AUTOMATION_LINEAR,
+    };
+    Automation next = automationInsert(edited, p);
+    automationLaneSet(lane, next);
+    automationRelease(edited);
+    edited = next;
+
+    automationLaneProcess(lane, &ctx);
+    automationLaneDisplay(lane);
+    if (collecting) {
+      automationLaneCollect(lane);
+    }
+    ctx.position += BLOCK;
+  }
+  struct AutomationCursor cursor = {0};
+  float expected = automationValue(edited, &cursor, ctx.position - 1);
+  int ok = fabsf(out[BLOCK - 1] - expected) < 1e-4f &&
+           automationCount(edited) == POINTS + 100;
+  automationRelease(edited);
+  freeAutomationLane(lane);
+
+  lane = makeAutomationLane(NULL);
+  automationLaneProcess(lane, &ctx);
+  for (int i = 0; i < BLOCK; i++) {
+    ok &= out[i] == 0;
+  }
+  freeAutomationLane(lane);
+  printf("check: lane through 100 edits%s%s\n",
+         collecting ? "" : ", never collected", ok ? "" : " (FAILED)");
+  return ok;
+}
+
+// keeps the evaluation from being optimized away
+static volatile float sink;
+
+static void measure(Automation curve) {
+  long blocks = (long)SECONDS * RATE / BLOCK;
+  float out[BLOCK];
+  printf("%d s of playback, %d frame blocks, %d points every ~%d samples\n",
+         SECONDS, BLOCK, POINTS, SPACING);
+
+  struct AutomationCursor cursor = {0};
+  uint64_t start = clockNanos();
+  for (long b = 0; b < blocks; b++) {
+    for (int i = 0; i < BLOCK; i++) {
+      out[i] = automationValue(curve, &cursor, (uint64_t)b * BLOCK + i);
+    }
+    sink += out[0];
+  }
+  double perSample = (double)(clockNanos() - start) / blocks / BLOCK;
+  printf("  per sample    %6.2f ns a value\n", perSample);
+
+  cursor = (struct AutomationCursor){0};
+  start = clockNanos();
+  for (long b = 0; b < blocks; b++) {
+    automationRender(curve, &cursor, (uint64_t)b * BLOCK, out, BLOCK);
+    sink += out[0];
+  }
+  double block = (double)(clockNanos() - start) / blocks / BLOCK;
+  printf("  block         %6.2f ns a value, %.1fx faster\n", block,
+         perSample / block);
+
+  // a fresh cursor every block, the cost of searching for the segment
+  start = clockNanos();
+  for (long b = 0; b < blocks; b++) {
+    cursor = (struct AutomationCursor){0};
+    automationRender(curve, &cursor, (uint64_t)b * BLOCK, out, BLOCK);
+    sink += out[0];
+  }
+  double searched = (double)(clockNanos() - start) / blocks / BLOCK;
+  printf("  block, seek   %6.2f ns a value\n", searched);
+}
+
+int main(void) {
+  dspInit();
+  printf("selected: %s\n", dsp->name);
+  Automation curve = makeCurve();
+  int ok = check(curve) && checkLane(curve, 1) &&
+           checkLane(curve, 0);
+  if (ok) {
+    measure(curve);
+  }
+  automationRelease(curve);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
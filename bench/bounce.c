@@ -0,0 +1,277 @@
+// offline export end to end, no audio device needed: renders a synthetic
+// session to one WAV per bus plus the master, reports the realtime factor,
+// then checks the master file against the same session played through the
+// engine block by block. a three channel stem through a queue of a few frames
+// has to come out with every channel in its place
+#define _POSIX_C_SOURCE 200809L
+#include "bounce.h"
+#include "dsp.h"
+#include "engine.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define SECONDS 30
+#define TRACKS 64
+#define BUSES 8
+#define ENGINE_BLOCK 256
+#define CHECK_FRAMES (SAMPLE_RATE * 2)
+#define ODD_CHANNELS 3
+#define TINY_QUEUE 5
+
+struct Tone {
+  double hz;
+  float left, right;
+};
+
+// a driven sine, a pure function of the transport position so any block
+// size renders the same samples
+static void tone(void *state, const struct ProcessContext *ctx) {
+  struct Tone *t = state;
+  for (int i = 0; i < ctx->frames; i++) {
+    double phase = 2 * DSP_PI * t->hz * (double)(ctx->position + i);
+    float x =
+        ctx->playing ? (float)tanh(2 * sin(phase / SAMPLE_RATE)) * 0.1f : 0;
+    ctx->outputs[0][i] = x * t->left;
+    ctx->outputs[1][i] = x * t->right;
+  }
+}
+
+static void passThrough(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int ch = 0; ch < ctx->outputCount; ch++) {
+    memcpy(ctx->outputs[ch], ctx->inputs[ch], ctx->frames * sizeof(float));
+  }
+}
+
+// every sample tells its frame and channel apart
+static float ramp(uint64_t frame, int channel) {
+  return (float)(frame % 1000) / 1000 + channel;
+}
+
+static void ramps(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int ch = 0; ch < ctx->outputCount; ch++) {
+    for (int i = 0; i < ctx->frames; i++) {
+      ctx->outputs[ch][i] = ramp(ctx->position + i, ch);
+    }
+  }
+}
+
+// a stem of an odd channel count through a queue that fills every block, so
+// the writer reads whatever has arrived. returns the samples not where they
+// belong
+static long checkOddStem(const char *path) {
+  Graph g = makeGraph();
+  int node = graphAddNode(g, (struct NodeDescription){
+                                 .name = "ramps",
+                                 .outputs = ODD_CHANNELS,
+                                 .process = ramps,
+                             });
+  CompiledGraph c = compileGraph(g, BOUNCE_BLOCK_SIZE);
+  struct BounceStem stem = {path, node, ODD_CHANNELS, SAMPLE_FLOAT32};
+  struct BounceResult r = bounce(c, &stem, 1,
+                                 (struct BounceSettings){
+                                     .sampleRate = SAMPLE_RATE,
+                                     .frames = CHECK_FRAMES,
+                                     .workers = 1,
+                                     .queueFrames = TINY_QUEUE,
+                                 });
+  freeCompiledGraph(c);
+  freeGraph(g);
+
+  long wrong = (long)CHECK_FRAMES * ODD_CHANNELS;
+  float *samples = malloc(CHECK_FRAMES * ODD_CHANNELS * sizeof(float));
+  AudioFile f = r.ok ? openAudioFile(path) : NULL;
+  if (f && audioFileFormat(f).channels == ODD_CHANNELS &&
+      readAudioFile(f, 0, samples, CHECK_FRAMES) == CHECK_FRAMES) {
+    wrong = 0;
+    for (int i = 0; i < CHECK_FRAMES; i++) {
+      for (int ch = 0; ch < ODD_CHANNELS; ch++) {
+        wrong += samples[i * ODD_CHANNELS + ch] != ramp(i, ch);
+      }
+    }
+  }
+  if (f) {
+    closeAudioFile(f);
+  }
+  free(samples);
+  unlink(path);
+  return wrong;
+}
+
+// only when someone is watching, it's noise in a log
+static int progress(void *user, double fraction, double realtimeFactor) {
+  (void)user;
+  if (!isatty(STDERR_FILENO)) {
+    return 1;
+  }
+  fprintf(stderr, "\r%5.1f%%  %6.1fx realtime", fraction * 100,
+          realtimeFactor);
+  return 1;
+}
+
+static Graph makeSession(struct Tone *tones, int *buses, int *master) {
+  Graph g = makeGraph();
+  struct NodeDescription bus = {
+      .name = "bus",
+      .inputs = 2,
+      .outputs = 2,
+      .process = passThrough,
+  };
+
+  bus.name = "master";
+  *master = graphAddNode(g, bus);
+  bus.name = "bus";
+  for (int b = 0; b < BUSES; b++) {
+    buses[b] = graphAddNode(g, bus);
+    graphConnect(g, buses[b], 0, *master, 0);
+    graphConnect(g, buses[b], 1, *master, 1);
+  }
+  for (int t = 0; t < TRACKS; t++) {
+    tones[t].hz = 55.0 * pow(2.0, t / 12.0);
+    dspPanGains((float)(t % 9) / 4 - 1, &tones[t].left, &tones[t].right);
+    int track = graphAddNode(g, (struct NodeDescription){
+                                    .name = "tone",
+                                    .outputs = 2,
+                                    .process = tone,
+                                    .state = &tones[t],
+                                });
+    graphConnect(g, track, 0, buses[t % BUSES], 0);
+    graphConnect(g, track, 1, buses[t % BUSES], 1);
+  }
+  return g;
+}
+
+// plays the first CHECK_FRAMES through the engine and compares them with the
+// master file, returns the number of mismatching samples
+static int checkAgainstEngine(Graph g, int master, const char *path) {
+  Engine e = makeEngine(SAMPLE_RATE, ENGINE_BLOCK, 1, graphNodeCount(g));
+  engineSetGraph(e, compileGraph(g, ENGINE_BLOCK), master);
+  sendCommand(engineQueues(e),
+              (struct Command){
+                  .type = COMMAND_TRANSPORT,
+                  .transport = {.action = TRANSPORT_PLAY},
+              });
+
+  float *played = malloc(CHECK_FRAMES * 2 * sizeof(float));
+  float left[ENGINE_BLOCK], right[ENGINE_BLOCK];
+  float *out[] = {left, right};
+  for (int f = 0; f < CHECK_FRAMES; f += ENGINE_BLOCK) {
+    engineProcess(e, out, 2, ENGINE_BLOCK);
+    dspInterleave(played + f * 2, (const float *const *)out, 2, ENGINE_BLOCK);
+  }
+  freeEngine(e);
+
+  float *bounced = malloc(CHECK_FRAMES * 2 * sizeof(float));
+  AudioFile f = openAudioFile(path);
+  int mismatches = CHECK_FRAMES * 2;
+  if (f && readAudioFile(f, 0, bounced, CHECK_FRAMES) == CHECK_FRAMES) {
+    mismatches = 0;
+    for (int i = 0; i < CHECK_FRAMES * 2; i++) {
+      mismatches += played[i] != bounced[i];
+    }
+  }
+  if (f) {
+    closeAudioFile(f);
+  }
+  free(played);
+  free(bounced);
+  return mismatches;
+}
+
+int main(void) {
+  dspInit();
+
+  char dir[] = "/tmp/bounce-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  struct Tone tones[TRACKS];
+  int buses[BUSES], master;
+  Graph g = makeSession(tones, buses, &master);
+
+  char paths[BUSES + 1][64];
+  struct BounceStem stems[BUSES + 1];
+  for (int b = 0; b < BUSES; b++) {
+    snprintf(paths[b], sizeof(paths[b]), "%s/bus%d.wav", dir, b);
+    stems[b] = (struct BounceStem){paths[b], buses[b], 2, SAMPLE_INT24};
+  }
+  snprintf(paths[BUSES], sizeof(paths[BUSES]), "%s/master.wav", dir);
+  stems[BUSES] = (struct BounceStem){paths[BUSES], master, 2, SAMPLE_FLOAT32};
+
+  printf("%d tracks, %d stems, %d s at %d Hz\n", TRACKS, BUSES + 1, SECONDS,
+         SAMPLE_RATE);
+  printf("%8s %10s %12s\n", "workers", "seconds", "x realtime");
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int failed = 0;
+  for (int workers = 1; workers <= cores; workers *= 2) {
+    CompiledGraph c = compileGraph(g, BOUNCE_BLOCK_SIZE);
+    struct BounceResult r = bounce(c, stems, BUSES + 1,
+                                   (struct BounceSettings){
+                                       .sampleRate = SAMPLE_RATE,
+                                       .frames = SECONDS * SAMPLE_RATE,
+                                       .workers = workers,
+                                       .progress = progress,
+                                   });
+    freeCompiledGraph(c);
+    if (isatty(STDERR_FILENO)) {
+      fprintf(stderr, "\r%30s\r", "");
+    }
+    printf("%8d %10.2f %12.1f\n", workers, r.seconds, r.realtimeFactor);
+    failed |= !r.ok;
+  }
+
+  for (int i = 0; i <= BUSES; i++) {
+    AudioFile f = openAudioFile(paths[i]);
+    if (!f || audioFileFormat(f).frames != SECONDS * SAMPLE_RATE) {
+      printf("%s: wrong length\n", paths[i]);
+      failed = 1;
+    }
+    if (f) {
+      closeAudioFile(f);
+    }
+  }
+
+  // stems of nodes the graph doesn't have
+  CompiledGraph c = compileGraph(g, BOUNCE_BLOCK_SIZE);
+  int refused = 0, nodes[] = {-1, compiledNodeCount(c)};
+  for (int i = 0; i < 2; i++) {
+    struct BounceStem bad = stems[BUSES];
+    bad.node = nodes[i];
+    refused += !bounce(c, &bad, 1,
+                       (struct BounceSettings){
+                           .sampleRate = SAMPLE_RATE,
+                           .frames = SAMPLE_RATE,
+                           .workers = 1,
+                       })
+                    .ok;
+  }
+  freeCompiledGraph(c);
+  printf("stems of missing nodes refused: %d of 2\n", refused);
+  failed |= refused != 2;
+
+  char odd[64];
+  snprintf(odd, sizeof(odd), "%s/odd.wav", dir);
+  long misplaced = checkOddStem(odd);
+  printf("%d channels through a %d frame queue: %ld samples misplaced\n",
+         ODD_CHANNELS, TINY_QUEUE, misplaced);
+  failed |= misplaced != 0;
+
+  int mismatches = checkAgainstEngine(g, master, paths[BUSES]);
+  printf("engine vs bounce: %d mismatching samples\n", mismatches);
+  failed |= mismatches != 0;
+
+  for (int i = 0; i <= BUSES; i++) {
+    unlink(paths[i]);
+  }
+  rmdir(dir);
+  freeGraph(g);
+  return failed;
+}
@@ -0,0 +1,57 @@
+// compares two reports the benchmarks wrote, a baseline and a new run. a
+// result counts as slower when its median moved past the threshold and past
+// what the two runs' deviations can explain. exits 1 if any did
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THRESHOLD 0.05 // of the baseline median
+#define DEVIATIONS 3   // median absolute deviations of noise, both runs
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s baseline.json new.json [threshold]\n", argv[0]);
+    return 2;
+  }
+  BenchReport old = benchRead(argv[1]);
+  BenchReport new = benchRead(argv[2]);
+  if (!old || !new) {
+    fprintf(stderr, "can't read %s\n", !old ? argv[1] : argv[2]);
+    return 2;
+  }
+  double threshold = argc > 3 ? atof(argv[3]) : THRESHOLD;
+  printf("%s -> %s\n", *benchCommit(old) ? benchCommit(old) : argv[1],
+         *benchCommit(new) ? benchCommit(new) : argv[2]);
+
+  int slower = 0;
+  for (int i = 0; i < benchCount(new); i++) {
+    struct BenchResult n = benchResult(new, i);
+    int found = 0;
+    for (int j = 0; j < benchCount(old) && !found; j++) {
+      struct BenchResult o = benchResult(old, j);
+      if (strcmp(o.name, n.name) != 0) {
+        continue;
+      }
+      found = 1;
+      double change = (n.median - o.median) / o.median;
+      double noise = DEVIATIONS * (o.mad + n.mad);
+      const char *verdict = "";
+      if (change > threshold && n.median - o.median > noise) {
+        verdict = "SLOWER";
+        slower++;
+      } else if (-change > threshold && o.median - n.median > noise) {
+        verdict = "faster";
+      }
+      printf("%-32s %12.1f -> %12.1f ns %+7.1f%% %s\n", n.name, o.median,
+             n.median, 100 * change, verdict);
+    }
+    if (!found) {
+      printf("%-32s %12s -> %12.1f ns new\n", n.name, "", n.median);
+    }
+  }
+  printf("%d slower\n", slower);
+  freeBenchReport(old);
+  freeBenchReport(new);
+  return slower > 0;
+}
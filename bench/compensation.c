@@ -0,0 +1,305 @@
+// latency compensation: parallel paths through nodes with lookahead have to
+// meet sample aligned, delayed no further than the longest of them, and a
+// path that meets none has to keep its own latency. a tone meeting a path
+// whose lookahead keeps changing has to move to each new delay without a
+// click, even where the old graph kept none of its past and where compiles
+// the audio thread never ran came in between, and once it's back to no delay
+// the line it needed has to go. then what the delay lines cost a block.
+// results go to the json file named on the command line, if any, for
+// bench-compare
+#define _POSIX_C_SOURCE 200809L
+#include "dsp.h"
+#include "engine.h"
+#include "scheduler.h"
+#include "stats.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define IMPULSE_AT 700
+#define MAX_LOOKAHEAD 2048
+#define TONE_HZ 100.0
+#define BLOCKS_PER_CHANGE 40
+#define PATHS 16
+
+// a node with lookahead, its output is its input `latency` frames late
+struct Lookahead {
+  int latency;
+  int at;
+  float ring[MAX_LOOKAHEAD];
+};
+
+static void impulse(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    ctx->outputs[0][i] = ctx->position + i == IMPULSE_AT ? 1.0f : 0.0f;
+  }
+}
+
+static float toneAt(int64_t frame) {
+  return frame < 0 ? 0.0f
+                   : 0.5f * (float)sin(2 * DSP_PI * TONE_HZ * frame /
+                                       SAMPLE_RATE);
+}
+
+static void tone(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    ctx->outputs[0][i] = toneAt((int64_t)(ctx->position + i));
+  }
+}
+
+static void silence(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  memset(ctx->outputs[0], 0, ctx->frames * sizeof(float));
+}
+
+static void lookahead(void *state, const struct ProcessContext *ctx) {
+  struct Lookahead *l = state;
+  for (int i = 0; i < ctx->frames; i++) {
+    if (!l->latency) {
+      ctx->outputs[0][i] = ctx->inputs[0][i];
+      continue;
+    }
+    ctx->outputs[0][i] = l->ring[l->at];
+    l->ring[l->at] = ctx->inputs[0][i];
+    l->at = (l->at + 1) % l->latency;
+  }
+}
+
+static void passThrough(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  memcpy(ctx->outputs[0], ctx->inputs[0], ctx->frames * sizeof(float));
+}
+
+static int addLookahead(Graph g, struct Lookahead *l, int latency) {
+  l->latency = latency;
+  return graphAddNode(g, (struct NodeDescription){
+                             .name = "lookahead",
+                             .inputs = 1,
+                             .outputs = 1,
+                             .process = lookahead,
+                             .state = l,
+                             .latency = latency,
+                         });
+}
+
+static int addPassThrough(Graph g, const char *name) {
+  return graphAddNode(g, (struct NodeDescription){
+                             .name = name,
+                             .inputs = 1,
+                             .outputs = 1,
+                             .process = passThrough,
+                         });
+}
+
+// where the output of `node` has something, and how much of it
+static void findImpulse(Scheduler s, CompiledGraph c, int blocks, int node,
+                        int *at, float *height, int *count) {
+  *count = 0;
+  for (int b = 0; b < blocks; b++) {
+    schedulerRun(s, c, BLOCK, (uint64_t)b * BLOCK, 1);
+    const float *out = compiledOutput(c, node, 0);
+    for (int i = 0; i < BLOCK; i++) {
+      if (fabsf(out[i]) > 1e-6f) {
+        *at = b * BLOCK + i;
+        *height = out[i];
+        ++*count;
+      }
+    }
+  }
+}
+
+struct Load {
+  Scheduler scheduler;
+  CompiledGraph graph;
+  uint64_t position;
+};
+
+static void blockBody(void *state, long iterations) {
+  struct Load *l = state;
+  for (long i = 0; i < iterations; i++) {
+    schedulerRun(l->scheduler, l->graph, BLOCK, l->position, 1);
+    l->position += BLOCK;
+  }
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  int failed = 0;
+
+  // three paths of 500, 1000 and no lookahead meet in a bus, a monitor hangs
+  // straight off the source
+  static struct Lookahead looks[PATHS];
+  Graph g = makeGraph();
+  int source = graphAddNode(g, (struct NodeDescription){
+                                   .name = "impulse",
+                                   .outputs = 1,
+                                   .process = impulse,
+                               });
+  int bus = addPassThrough(g, "bus");
+  int monitor = addPassThrough(g, "monitor");
+  int first = addLookahead(g, &looks[0], 300);
+  int second = addLookahead(g, &looks[1], 200);
+  int longest = addLookahead(g, &looks[2], 1000);
+  graphConnect(g, source, 0, first, 0);
+  graphConnect(g, first, 0, second, 0);
+  graphConnect(g, second, 0, bus, 0);
+  graphConnect(g, source, 0, longest, 0);
+  graphConnect(g, longest, 0, bus, 0);
+  graphConnect(g, source, 0, bus, 0);
+  graphConnect(g, source, 0, monitor, 0);
+  CompiledGraph c = compileGraph(g, BLOCK);
+  Scheduler s = makeScheduler(1, 64, 0);
+  int at = -1, count;
+  float height = 0;
+  findImpulse(s, c, 16, bus, &at, &height, &count);
+  int aligned = count == 1 && height == 3.0f && at == IMPULSE_AT + 1000 &&
+                compiledLatency(c, bus) == 1000;
+  printf("paths of 500, 1000 and 0 frames meet %s, %d frames late, "
+         "reported %d\n",
+         aligned ? "as one" : "apart", at - IMPULSE_AT,
+         compiledLatency(c, bus));
+  findImpulse(s, c, 16, monitor, &at, &height, &count);
+  int tight = count == 1 && at == IMPULSE_AT && !compiledLatency(c, monitor);
+  printf("monitor off the source: %d frames late\n", at - IMPULSE_AT);
+  failed |= !aligned || !tight;
+  freeCompiledGraph(c);
+  freeGraph(g);
+
+  // a tone meets a silent path whose lookahead changes, through the engine
+  g = makeGraph();
+  source = graphAddNode(g, (struct NodeDescription){
+                               .name = "tone",
+                               .outputs = 1,
+                               .process = tone,
+                           });
+  int quiet = graphAddNode(g, (struct NodeDescription){
+                                  .name = "silence",
+                                  .outputs = 1,
+                                  .process = silence,
+                              });
+  int changing = addLookahead(g, &looks[3], 0);
+  bus = addPassThrough(g, "bus");
+  graphConnect(g, quiet, 0, changing, 0);
+  graphConnect(g, changing, 0, bus, 0);
+  graphConnect(g, source, 0, bus, 0);
+
+  // each delay to the next: with the past kept, from kept into none, from
+  // none at all. some changes come after compiles of another delay that are
+  // replaced before the audio thread gets to them, -1 where none does
+  int latencies[] = {1000, 0, 600, 1200, 0, 0, 800, 300, 1500, 0};
+  int skipped[] = {-1, -1, 2000, -1, 0, 1800, 0, 1900, -1, 0};
+  int changes = sizeof(latencies) / sizeof(*latencies);
+  Engine e = makeEngine(SAMPLE_RATE, BLOCK, 1, 64);
+  sendCommand(engineQueues(e),
+              (struct Command){
+                  .type = COMMAND_TRANSPORT,
+                  .transport = {.action = TRANSPORT_PLAY},
+              });
+  float out[BLOCK], *outs[] = {out}, last = 0;
+  double step = 0, natural = 0, abrupt = 0;
+  int exact = 1;
+  for (int k = 0; k < changes; k++) {
+    if (skipped[k] >= 0) {
+      graphSetLatency(g, changing, skipped[k]);
+      engineSetGraph(e, compileGraph(g, BLOCK), bus);
+    }
+    looks[3].latency = latencies[k];
+    graphSetLatency(g, changing, latencies[k]);
+    engineSetGraph(e, compileGraph(g, BLOCK), bus);
+    int64_t switched = (int64_t)enginePosition(e);
+    if (k > 0) {
+      double jump = fabs(toneAt(switched - latencies[k]) -
+                         toneAt(switched - latencies[k - 1]));
+      abrupt = jump > abrupt ? jump : abrupt;
+    }
+    for (int b = 0; b < BLOCKS_PER_CHANGE; b++) {
+      int64_t position = (int64_t)enginePosition(e);
+      engineProcess(e, outs, 1, BLOCK);
+      engineCollect(e);
+      for (int i = 0; i < BLOCK; i++) {
+        int64_t frame = position + i;
+        double d = fabs(out[i] - last);
+        double n = fabs(toneAt(frame) - toneAt(frame - 1));
+        step = frame > 0 && d > step ? d : step;
+        natural = n > natural ? n : natural;
+        last = out[i];
+        // settled once the fades are over and the line has the past
+        if (b > BLOCKS_PER_CHANGE / 2) {
+          exact &= out[i] == toneAt(frame - latencies[k]);
+        }
+      }
+    }
+  }
+  // the last change was back to no delay and it has run, so the next compile
+  // needs no line at all
+  CompiledGraph undelayed = compileGraph(g, BLOCK);
+  size_t kept = compiledDelayBytes(undelayed);
+  engineSetGraph(e, undelayed, bus);
+  engineProcess(e, outs, 1, BLOCK);
+  freeEngine(e);
+  freeGraph(g);
+  int smooth = step < 2 * natural;
+  printf("%d delay changes, some past compiles never run: largest step "
+         "%.4f against the tone's own %.4f, %s (abruptly up to %.3f)\n",
+         changes - 1, step, natural, smooth ? "no clicks" : "clicks", abrupt);
+  printf("settled on each delay exactly: %s\n", exact ? "yes" : "no");
+  printf("delay lines kept once back to none: %zu bytes\n", kept);
+  failed |= !smooth || !exact || kept;
+
+  // a bus fed by paths of every lookahead up to 1500 frames, against the
+  // same paths reporting none
+  g = makeGraph();
+  bus = addPassThrough(g, "bus");
+  int nodes[PATHS];
+  for (int p = 0; p < PATHS; p++) {
+    int track = graphAddNode(g, (struct NodeDescription){
+                                    .name = "tone",
+                                    .outputs = 1,
+                                    .process = tone,
+                                });
+    nodes[p] = addLookahead(g, &looks[p], p * 100);
+    graphConnect(g, track, 0, nodes[p], 0);
+    graphConnect(g, nodes[p], 0, bus, 0);
+  }
+  BenchReport r = makeBenchReport("compensation");
+  struct Load l = {s, compileGraph(g, BLOCK), 0};
+  struct BenchResult compensated = benchRun(
+      r, "compensation/block", "256 frames, 16 paths", blockBody, &l);
+  freeCompiledGraph(l.graph);
+  // the same paths in a graph that was never delayed, so has no lines
+  Graph plainGraph = makeGraph();
+  graphAddNode(plainGraph, (struct NodeDescription){
+                               .name = "bus",
+                               .inputs = 1,
+                               .outputs = 1,
+                               .process = passThrough,
+                           });
+  for (int p = 0; p < PATHS; p++) {
+    int track = graphAddNode(plainGraph, (struct NodeDescription){
+                                             .name = "tone",
+                                             .outputs = 1,
+                                             .process = tone,
+                                         });
+    int path = addLookahead(plainGraph, &looks[p], 0);
+    graphConnect(plainGraph, track, 0, path, 0);
+    graphConnect(plainGraph, path, 0, 0, 0);
+  }
+  l.graph = compileGraph(plainGraph, BLOCK);
+  struct BenchResult plain = benchRun(
+      r, "compensation/none", "256 frames, 16 paths", blockBody, &l);
+  freeCompiledGraph(l.graph);
+  freeGraph(plainGraph);
+  freeGraph(g);
+  printf("%.0f ns a block for each of %d delayed paths\n",
+         (compensated.median - plain.median) / (PATHS - 1), PATHS - 1);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  freeBenchReport(r);
+  freeScheduler(s);
+  return failed || !written;
+}
@@ -0,0 +1,176 @@
+// partitioned convolution against plain direct convolution: first that the
+// output matches it, then what each costs per instance with a long response
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "convolver.h"
+#include "dsp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RATE 48000
+
+// small blocks so a short response still reaches every tier
+#define CHECK_BLOCK 32
+#define CHECK_LENGTH 40000
+#define CHECK_FRAMES 60000
+
+#define BLOCK 256
+#define CHANNELS 2
+#define RESPONSE_SECONDS 5
+#define SECONDS 10
+#define DIRECT_SECONDS 0.5
+
+static float randomSample(void) { return (float)rand() / RAND_MAX * 2 - 1; }
+
+// a decaying noise tail, roughly what a hall sounds like
+static float *makeResponse(int length) {
+  float *r = malloc(length * sizeof(float));
+  for (int i = 0; i < length; i++) {
+    r[i] = randomSample() * expf(-6.9f * i / length);
+  }
+  return r;
+}
+
+static double cpuSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// y[n] = sum of r[k] x[n - k], straight from the definition
+static void direct(const float *reversed, int length, const float *padded,
+                   float *out, int frames) {
+  for (int n = 0; n < frames; n++) {
+    out[n] = dsp->dot(reversed, padded + n, length);
+  }
+}
+
+static int check(void) {
+  float *response = makeResponse(CHECK_LENGTH);
+  float *reversed = malloc(CHECK_LENGTH * sizeof(float));
+  for (int i = 0; i < CHECK_LENGTH; i++) {
+    reversed[i] = response[CHECK_LENGTH - 1 - i];
+  }
+
+  // the input, with a response's worth of silence in front for direct
+  float *padded = calloc(CHECK_LENGTH + CHECK_FRAMES, sizeof(float));
+  float *input = padded + CHECK_LENGTH - 1;
+  for (int i = 0; i < CHECK_FRAMES; i++) {
+    input[i] = randomSample();
+  }
+  float *expected = malloc(CHECK_FRAMES * sizeof(float));
+  direct(reversed, CHECK_LENGTH, padded, expected, CHECK_FRAMES);
+
+  const float *responses[] = {response};
+  Convolver c = makeConvolver(responses, 1, CHECK_LENGTH, CHECK_BLOCK);
+  float *actual = malloc(CHECK_FRAMES * sizeof(float));
+  for (int i = 0; i < CHECK_FRAMES; i += CHECK_BLOCK) {
+    const float *in[] = {input + i};
+    float *out[] = {actual + i};
+    convolverProcess(c, in, out, CHECK_BLOCK);
+  }
+  freeConvolver(c);
+
+  double worst = 0, largest = 0;
+  for (int i = 0; i < CHECK_FRAMES; i++) {
+    worst = fmax(worst, fabs(actual[i] - expected[i]));
+    largest = fmax(largest, fabs(expected[i]));
+  }
+  int ok = worst < 1e-5 * largest;
+  printf("check: %d taps, block %d, largest error %.2e of the peak%s\n",
+         CHECK_LENGTH, CHECK_BLOCK, worst / largest, ok ? "" : " (FAILED)");
+
+  free(response);
+  free(reversed);
+  free(padded);
+  free(expected);
+  free(actual);
+  return ok;
+}
+
+static void measure(void) {
+  int length = RESPONSE_SECONDS * RATE;
+  float *response[CHANNELS];
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    response[ch] = makeResponse(length);
+  }
+  float in[CHANNELS][BLOCK], out[CHANNELS][BLOCK];
+  const float *ins[CHANNELS];
+  float *outs[CHANNELS];
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    for (int i = 0; i < BLOCK; i++) {
+      in[ch][i] = randomSample();
+    }
+    ins[ch] = in[ch];
+    outs[ch] = out[ch];
+  }
+  printf("%d s response, %d channels, %d frame blocks\n", RESPONSE_SECONDS,
+         CHANNELS, BLOCK);
+
+  // direct form gets a short run, it's nowhere near real time
+  float *reversed = malloc(length * sizeof(float));
+  float *padded = calloc(length + BLOCK, sizeof(float));
+  for (int i = 0; i < length; i++) {
+    reversed[i] = response[0][length - 1 - i];
+  }
+  long directBlocks = (long)(DIRECT_SECONDS * RATE / BLOCK);
+  double start = cpuSeconds();
+  for (long b = 0; b < directBlocks; b++) {
+    for (int ch = 0; ch < CHANNELS; ch++) {
+      direct(reversed, length, padded, out[ch], BLOCK);
+    }
+  }
+  double directLoad = (cpuSeconds() - start) / DIRECT_SECONDS;
+  printf("  direct        %9.1f%% of a core\n", 100 * directLoad);
+
+  // paced like a real device so the background thread has its deadlines.
+  // everything the instance costs, background thread included, plus what
+  // the audio thread alone sees per block
+  Convolver c = makeConvolver((const float *const *)response, CHANNELS,
+                              length, BLOCK);
+  long blocks = (long)SECONDS * RATE / BLOCK;
+  uint64_t worst = 0, total = 0;
+  start = cpuSeconds();
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  for (long b = 0; b < blocks; b++) {
+    next.tv_nsec += 1000000000L * BLOCK / RATE;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_sec++;
+      next.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+    uint64_t begin = clockNanos();
+    convolverProcess(c, ins, outs, BLOCK);
+    uint64_t nanos = clockNanos() - begin;
+    total += nanos;
+    worst = nanos > worst ? nanos : worst;
+  }
+  double load = (cpuSeconds() - start) / SECONDS;
+  double deadline = 1e9 * BLOCK / RATE;
+  printf("  partitioned   %9.1f%% of a core, %.0fx less than direct\n",
+         100 * load, directLoad / load);
+  printf("  audio thread  %9.1f%% of the deadline on average, %.1f%% worst, "
+         "%llu late blocks\n",
+         100 * total / blocks / deadline, 100 * worst / deadline,
+         (unsigned long long)convolverLateBlocks(c));
+  freeConvolver(c);
+
+  free(reversed);
+  free(padded);
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    free(response[ch]);
+  }
+}
+
+int main(void) {
+  dspInit();
+  if (!check()) {
+    return EXIT_FAILURE;
+  }
+  measure();
+  return EXIT_SUCCESS;
+}
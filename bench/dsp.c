@@ -0,0 +1,228 @@
+// checks every kernel the cpu supports against the scalar reference, then
+// reports throughput in GB/s (bytes read plus bytes written)
+#include "clock.h"
+#include "dsp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAMES 4096
+#define ITERATIONS 20000
+
+// sizes that exercise the vector bodies and every tail length
+static const int checkSizes[] = {0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 64, 255};
+#define CHECK_SIZES (int)(sizeof(checkSizes) / sizeof(checkSizes[0]))
+
+static float a[2 * FRAMES], b[2 * FRAMES], c[2 * FRAMES], d[2 * FRAMES];
+static int16_t s16[2][FRAMES];
+static uint8_t s24[2][3 * FRAMES];
+static double p64[2][FRAMES];
+
+static void randomize(float *x, int n, float range) {
+  for (int i = 0; i < n; i++) {
+    x[i] = ((float)rand() / RAND_MAX * 2 - 1) * range;
+  }
+}
+
+static int same(const void *x, const void *y, size_t bytes, const char *isa,
+                const char *kernel, int n) {
+  if (memcmp(x, y, bytes) != 0) {
+    fprintf(stderr, "%s %s differs from scalar at n=%d\n", isa, kernel, n);
+    return 0;
+  }
+  return 1;
+}
+
+static int check(const struct DspKernels *k) {
+  const struct DspKernels *ref = &dspScalar;
+  int ok = 1;
+
+  for (int i = 0; i < CHECK_SIZES; i++) {
+    int n = checkSizes[i];
+    size_t bytes = n * sizeof(float);
+    randomize(a, 2 * FRAMES, 1.2f); // a little past full scale, for clamping
+    randomize(b, 2 * FRAMES, 1.0f);
+
+    memcpy(c, b, sizeof(c));
+    memcpy(d, b, sizeof(d));
+    ref->add(c, a, n);
+    k->add(d, a, n);
+    ok &= same(c, d, bytes, k->name, "add", n);
+
+    ref->mix(c, a, 0.7f, n);
+    k->mix(d, a, 0.7f, n);
+    ok &= same(c, d, bytes, k->name, "mix", n);
+
+    ref->gainRamp(c, a, 0.2f, 0.9f, n);
+    k->gainRamp(d, a, 0.2f, 0.9f, n);
+    ok &= same(c, d, bytes, k->name, "gainRamp", n);
+
+    ref->mixRamp(c, a, 1.0f, 0.0f, n);
+    k->mixRamp(d, a, 1.0f, 0.0f, n);
+    ok &= same(c, d, bytes, k->name, "mixRamp", n);
+
+    // summation order is free to differ
+    float expected = ref->dot(a, b, n);
+    if (fabsf(k->dot(a, b, n) - expected) > 1e-4f * (1 + fabsf(expected))) {
+      fprintf(stderr, "%s dot differs from scalar at n=%d\n", k->name, n);
+      ok = 0;
+    }
+
+    // the peak is exact, the sum of squares is another reduction
+    float refPeak, refSum, peak, sum;
+    ref->levels(a, n, &refPeak, &refSum);
+    k->levels(a, n, &peak, &sum);
+    if (peak != refPeak || fabsf(sum - refSum) > 1e-4f * (1 + refSum)) {
+      fprintf(stderr, "%s levels differ from scalar at n=%d\n", k->name, n);
+      ok = 0;
+    }
+
+    // horner per lane from the same index, so it matches exactly
+    ref->cubic(c, 0.3f, -0.01f, 2e-4f, -1e-6f, n);
+    k->cubic(d, 0.3f, -0.01f, 2e-4f, -1e-6f, n);
+    ok &= same(c, d, bytes, k->name, "cubic", n);
+
+    // lanes advance by ratio^width, a few roundings apart from scalar
+    ref->geometric(c, 0.5f, 1.003f, n);
+    k->geometric(d, 0.5f, 1.003f, n);
+    for (int j = 0; j < n; j++) {
+      if (fabsf(c[j] - d[j]) > 1e-5f * fabsf(c[j])) {
+        fprintf(stderr, "%s geometric differs from scalar at n=%d\n",
+                k->name, n);
+        ok = 0;
+        break;
+      }
+    }
+
+    // a multiply then an add, rounded as scalar rounds them
+    for (int j = 0; j < n; j++) {
+      p64[0][j] = a[j] * 1e6;
+    }
+    ref->affine(p64[1], p64[0], 12345.678, 1.0 / 3, n);
+    k->affine(p64[0], p64[0], 12345.678, 1.0 / 3, n);
+    ok &= same(p64[0], p64[1], n * sizeof(double), k->name, "affine", n);
+
+    // one multiply and add per lane, the same as scalar
+    randomize(c, 2 * FRAMES, 1.0f);
+    memcpy(d, c, sizeof(d));
+    ref->complexMac(c, c + FRAMES, a, a + FRAMES, b, b + FRAMES, n);
+    k->complexMac(d, d + FRAMES, a, a + FRAMES, b, b + FRAMES, n);
+    ok &= same(c, d, bytes, k->name, "complexMac", n);
+    ok &= same(c + FRAMES, d + FRAMES, bytes, k->name, "complexMac", n);
+
+    ref->interleave2(c, a, b, n);
+    k->interleave2(d, a, b, n);
+    ok &= same(c, d, 2 * bytes, k->name, "interleave2", n);
+
+    ref->deinterleave2(c, c + FRAMES, a, n);
+    k->deinterleave2(d, d + FRAMES, a, n);
+    ok &= same(c, d, bytes, k->name, "deinterleave2", n);
+    ok &= same(c + FRAMES, d + FRAMES, bytes, k->name, "deinterleave2", n);
+
+    ref->floatToInt16(s16[0], a, n);
+    k->floatToInt16(s16[1], a, n);
+    ok &= same(s16[0], s16[1], n * sizeof(int16_t), k->name, "floatToInt16",
+               n);
+
+    ref->int16ToFloat(c, s16[0], n);
+    k->int16ToFloat(d, s16[0], n);
+    ok &= same(c, d, bytes, k->name, "int16ToFloat", n);
+
+    ref->floatToInt24(s24[0], a, n);
+    k->floatToInt24(s24[1], a, n);
+    ok &= same(s24[0], s24[1], 3 * n, k->name, "floatToInt24", n);
+
+    ref->int24ToFloat(c, s24[0], n);
+    k->int24ToFloat(d, s24[0], n);
+    ok &= same(c, d, bytes, k->name, "int24ToFloat", n);
+  }
+
+  // round trips should be within one step of the integer format
+  randomize(a, FRAMES, 1.0f);
+  k->floatToInt24(s24[0], a, FRAMES);
+  k->int24ToFloat(c, s24[0], FRAMES);
+  for (int i = 0; i < FRAMES; i++) {
+    if (fabsf(a[i] - c[i]) > 1.0f / 8388607.0f) {
+      fprintf(stderr, "%s 24 bit round trip off at %d\n", k->name, i);
+      ok = 0;
+      break;
+    }
+  }
+
+  // fft passes do the same arithmetic in every lane, so they match exactly.
+  // the twiddles don't need to be real ones for that
+  for (int m = 1; m <= 64; m *= 2) {
+    int n = 16 * m;
+    randomize(a, 4 * m, 1.0f);
+    randomize(c, 2 * FRAMES, 1.0f);
+    memcpy(d, c, sizeof(d));
+    ref->fftRadix4(c, c + FRAMES, n, m, a);
+    k->fftRadix4(d, d + FRAMES, n, m, a);
+    ok &= same(c, d, n * sizeof(float), k->name, "fftRadix4", m);
+    ok &= same(c + FRAMES, d + FRAMES, n * sizeof(float), k->name,
+               "fftRadix4", m);
+  }
+  return ok;
+}
+
+// keeps dot and levels from being optimized away
+static volatile float sink;
+
+static void report(const char *isa, const char *kernel, uint64_t nanos,
+                   double bytesPerCall) {
+  double gbs = bytesPerCall * ITERATIONS / (double)nanos;
+  printf("%-8s %-14s %8.2f GB/s\n", isa, kernel, gbs);
+}
+
+#define TIME(kernel, bytes, call)                                              \
+  do {                                                                         \
+    uint64_t start = clockNanos();                                             \
+    for (int it = 0; it < ITERATIONS; it++) {                                  \
+      call;                                                                    \
+    }                                                                          \
+    report(k->name, kernel, clockNanos() - start, bytes);                      \
+  } while (0)
+
+static void measure(const struct DspKernels *k) {
+  double f = FRAMES * sizeof(float);
+  float peak, sum;
+  TIME("add", 3 * f, k->add(c, a, FRAMES));
+  TIME("mix", 3 * f, k->mix(c, a, 0.5f, FRAMES));
+  TIME("gainRamp", 2 * f, k->gainRamp(c, a, 0.0f, 1.0f, FRAMES));
+  TIME("mixRamp", 3 * f, k->mixRamp(c, a, 1.0f, 0.0f, FRAMES));
+  TIME("dot", 2 * f, sink += k->dot(a, b, FRAMES));
+  TIME("cubic", f, k->cubic(c, 0.5f, 1e-4f, -1e-8f, 1e-12f, FRAMES));
+  TIME("geometric", f, k->geometric(c, 0.5f, 1.0001f, FRAMES));
+  TIME("affine", 4 * f, k->affine(p64[1], p64[0], 1.0, 0.5, FRAMES));
+  TIME("levels", f, k->levels(a, FRAMES, &peak, &sum); sink += peak + sum);
+  TIME("fftRadix4", 4 * f,
+       k->fftRadix4(c, c + FRAMES, FRAMES, FRAMES / 16, a));
+  TIME("complexMac", 6 * f,
+       k->complexMac(c, c + FRAMES, a, a + FRAMES, b, b + FRAMES, FRAMES));
+  TIME("interleave2", 4 * f, k->interleave2(c, a, b, FRAMES));
+  TIME("deinterleave2", 4 * f, k->deinterleave2(c, d, a, FRAMES));
+  TIME("floatToInt16", f + FRAMES * 2, k->floatToInt16(s16[0], a, FRAMES));
+  TIME("int16ToFloat", f + FRAMES * 2, k->int16ToFloat(c, s16[0], FRAMES));
+  TIME("floatToInt24", f + FRAMES * 3, k->floatToInt24(s24[0], a, FRAMES));
+  TIME("int24ToFloat", f + FRAMES * 3, k->int24ToFloat(c, s24[0], FRAMES));
+}
+
+int main(void) {
+  dspInit();
+  printf("selected: %s\n", dsp->name);
+
+  int ok = 1;
+  for (int isa = 0; isa < DSP_ISA_COUNT; isa++) {
+    const struct DspKernels *k = dspKernels(isa);
+    if (!k) {
+      continue;
+    }
+    if (!check(k)) {
+      ok = 0;
+      continue;
+    }
+    measure(k);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,171 @@
+// fft accuracy against a double precision dft and of the round trip, and
+// speed for every isa the cpu supports. then the spectrum analyzer end to
+// end: what its thread costs and whether a tone lands where it should
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "fft.h"
+#include "spectrum.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_SIZE 16384
+#define CHECK_MAX 4096
+#define TIME_NANOS 200000000ull
+
+#define RATE 48000
+#define ANALYZER_SIZE 4096
+#define ANALYZER_OVERLAP 4
+#define ANALYZER_CHANNELS 2
+#define ANALYZER_SECONDS 20
+#define BLOCK 256
+// on a bin centre, so the window's scalloping doesn't enter into it
+#define TONE_HZ (85.0 * RATE / ANALYZER_SIZE)
+#define TONE_AMPLITUDE 0.5
+
+static float in[MAX_SIZE];
+static float re[MAX_SIZE / 2 + 1], im[MAX_SIZE / 2 + 1];
+
+// largest error against the exact transform, relative to the largest bin
+static double accuracy(int size) {
+  Fft f = makeFft(size);
+  for (int i = 0; i < size; i++) {
+    in[i] = (float)rand() / RAND_MAX * 2 - 1;
+  }
+  fftForward(f, in, re, im);
+
+  double worst = 0, largest = 0;
+  for (int k = 0; k <= size / 2; k++) {
+    double sr = 0, si = 0;
+    for (int n = 0; n < size; n++) {
+      double angle = -2 * DSP_PI * (double)k * n / size;
+      sr += in[n] * cos(angle);
+      si += in[n] * sin(angle);
+    }
+    double error = hypot(re[k] - sr, im[k] - si);
+    worst = error > worst ? error : worst;
+    largest = hypot(sr, si) > largest ? hypot(sr, si) : largest;
+  }
+
+  // and back, the round trip scales by size
+  static float out[MAX_SIZE];
+  fftInverse(f, re, im, out);
+  for (int n = 0; n < size; n++) {
+    double error = fabs(out[n] / size - in[n]);
+    worst = error > worst ? error : worst;
+  }
+  freeFft(f);
+  return worst / largest;
+}
+
+static double nanosPerTransform(int size) {
+  Fft f = makeFft(size);
+  long count = 0;
+  uint64_t start = clockNanos(), elapsed;
+  do {
+    for (int i = 0; i < 64; i++) {
+      fftForward(f, in, re, im);
+    }
+    count += 64;
+    elapsed = clockNanos() - start;
+  } while (elapsed < TIME_NANOS);
+  freeFft(f);
+  return (double)elapsed / count;
+}
+
+static int analyzer(void) {
+  Spectrum s =
+      makeSpectrum(ANALYZER_CHANNELS, RATE, ANALYZER_SIZE, ANALYZER_OVERLAP);
+  float block[BLOCK];
+  long frames = (long)ANALYZER_SECONDS * RATE;
+  long phase = 0;
+
+  // feed it as fast as it takes, sleeping while the ring is full so the
+  // process cpu time is close to what the analysis costs
+  struct timespec wait = {0, 100000};
+  clock_t cpu = clock();
+  for (long done = 0; done < frames; done += BLOCK) {
+    for (int i = 0; i < BLOCK; i++, phase++) {
+      block[i] = (float)(TONE_AMPLITUDE *
+                         sin(2 * DSP_PI * TONE_HZ * phase / RATE));
+    }
+    for (int c = 0; c < ANALYZER_CHANNELS; c++) {
+      int written = 0;
+      while ((written += spectrumWrite(s, c, block + written,
+                                       BLOCK - written)) < BLOCK) {
+        nanosleep(&wait, NULL);
+      }
+    }
+  }
+
+  // the last windows still have to be picked up
+  const float *curves = NULL;
+  for (int tries = 0; tries < 100; tries++) {
+    const float *latest = spectrumRead(s);
+    curves = latest ? latest : curves;
+    nanosleep(&wait, NULL);
+  }
+  double seconds = (double)(clock() - cpu) / CLOCKS_PER_SEC;
+  printf("analyzer: %d channels, %d point fft, %d%% overlap, "
+         "%.2f%% of a core\n",
+         ANALYZER_CHANNELS, ANALYZER_SIZE, 100 - 100 / ANALYZER_OVERLAP,
+         100 * seconds / ANALYZER_SECONDS);
+
+  int ok = curves != NULL;
+  for (int c = 0; ok && c < ANALYZER_CHANNELS; c++) {
+    const float *curve = curves + c * SPECTRUM_POINTS;
+    int loudest = 0;
+    for (int p = 1; p < SPECTRUM_POINTS; p++) {
+      loudest = curve[p] > curve[loudest] ? p : loudest;
+    }
+    float db = SPECTRUM_FLOOR_DB * (1 - curve[loudest]);
+    float expected = (float)(20 * log10(TONE_AMPLITUDE));
+    printf("  channel %d: peak at %.0f Hz, %.1f dB\n", c,
+           spectrumPointHz(loudest), db);
+    if (fabsf(spectrumPointHz(loudest) / (float)TONE_HZ - 1) > 0.03f ||
+        fabsf(db - expected) > 0.5f) {
+      fprintf(stderr, "expected %.0f Hz at %.1f dB\n", TONE_HZ, expected);
+      ok = 0;
+    }
+  }
+  freeSpectrum(s);
+  return ok;
+}
+
+int main(void) {
+  dspInit();
+
+  int ok = 1;
+  printf("%-8s %6s %12s %10s %10s\n", "isa", "size", "rel. error",
+         "ns", "mflops");
+  for (int isa = 0; isa < DSP_ISA_COUNT; isa++) {
+    const struct DspKernels *k = dspKernels(isa);
+    if (!k) {
+      continue;
+    }
+    dsp = k;
+    for (int size = 4; size <= MAX_SIZE; size *= 2) {
+      int checked = size <= CHECK_MAX;
+      double error = checked ? accuracy(size) : 0;
+      double nanos = nanosPerTransform(size);
+      // the usual 2.5 n log2 n for a real transform
+      double mflops = 2.5 * size * log2(size) / nanos * 1e3;
+      char shown[16] = "n/a";
+      if (checked) {
+        snprintf(shown, sizeof(shown), "%.2e", error);
+      }
+      printf("%-8s %6d %12s %10.0f %10.0f\n", k->name, size, shown, nanos,
+             mflops);
+      if (error > 1e-5) {
+        fprintf(stderr, "%s fft of %d is off\n", k->name, size);
+        ok = 0;
+      }
+    }
+  }
+
+  dspInit();
+  ok &= analyzer();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
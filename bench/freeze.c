@@ -0,0 +1,380 @@
+// track freezing: renders an expensive track into the cache, checks the
+// frozen track streams back exactly what live processing makes and compares
+// what each costs the audio thread. then that the key follows every input of
+// the render and nothing else, and that the cache keeps the recently used
+// renders within its budget, across a restart too
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "freeze.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RATE 48000
+#define BLOCK 256
+#define SECONDS 4
+#define STAGES 48 // biquads a channel, a heavy insert chain
+#define PATH_SIZE 256
+
+// PROCESSING
+
+struct Chain {
+  float b0[STAGES], b1[STAGES], b2[STAGES], a1[STAGES], a2[STAGES];
+  float z1[2][STAGES], z2[2][STAGES];
+};
+
+// a detuned saw, a pure function of the transport position
+static void saw(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    double t = (double)(ctx->position + i) / RATE;
+    float left = (float)(fmod(t * 110, 1) - 0.5);
+    float right = (float)(fmod(t * 110.7, 1) - 0.5);
+    ctx->outputs[0][i] = ctx->playing ? left * 0.5f : 0;
+    ctx->outputs[1][i] = ctx->playing ? right * 0.5f : 0;
+  }
+}
+
+// peaking filters spread over the spectrum, one after the other
+static void chain(void *state, const struct ProcessContext *ctx) {
+  struct Chain *c = state;
+  for (int ch = 0; ch < 2; ch++) {
+    const float *in = ctx->inputs[ch];
+    float *out = ctx->outputs[ch];
+    float *z1 = c->z1[ch], *z2 = c->z2[ch];
+    for (int i = 0; i < ctx->frames; i++) {
+      float x = in[i];
+      for (int s = 0; s < STAGES; s++) {
+        float y = c->b0[s] * x + z1[s];
+        z1[s] = c->b1[s] * x - c->a1[s] * y + z2[s];
+        z2[s] = c->b2[s] * x - c->a2[s] * y;
+        x = y;
+      }
+      out[i] = x;
+    }
+  }
+}
+
+static void designChain(struct Chain *c) {
+  memset(c, 0, sizeof(*c));
+  for (int s = 0; s < STAGES; s++) {
+    double hz = 40 * pow(2.0, s * 9.0 / STAGES);
+    double w = 2 * DSP_PI * hz / RATE, alpha = sin(w) / (2 * 2.0);
+    double gain = pow(10, (s % 2 ? -1.0 : 1.0) / 40);
+    double a0 = 1 + alpha / gain;
+    c->b0[s] = (float)((1 + alpha * gain) / a0);
+    c->b1[s] = (float)(-2 * cos(w) / a0);
+    c->b2[s] = (float)((1 - alpha * gain) / a0);
+    c->a1[s] = (float)(-2 * cos(w) / a0);
+    c->a2[s] = (float)((1 - alpha / gain) / a0);
+  }
+}
+
+// a track's processing, saw into chain, as a graph for the cache to bounce
+static CompiledGraph makeTrackGraph(struct Chain *c, int *output) {
+  Graph g = makeGraph();
+  int source = graphAddNode(g, (struct NodeDescription){
+                                   .name = "saw",
+                                   .outputs = 2,
+                                   .process = saw,
+                               });
+  *output = graphAddNode(g, (struct NodeDescription){
+                                .name = "chain",
+                                .inputs = 2,
+                                .outputs = 2,
+                                .process = chain,
+                                .state = c,
+                            });
+  graphConnect(g, source, 0, *output, 0);
+  graphConnect(g, source, 1, *output, 1);
+  CompiledGraph compiled = compileGraph(g, BOUNCE_BLOCK_SIZE);
+  freeGraph(g);
+  return compiled;
+}
+
+// PLAYBACK
+
+static int compare(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static double median(uint64_t *nanos, int count) {
+  qsort(nanos, count, sizeof(uint64_t), compare);
+  return nanos[count / 2] / 1e3;
+}
+
+// plays the track live and frozen block by block. the frozen track is paced
+// a little faster than real time so the streamer keeps up, only the process
+// calls are timed
+static int checkPlayback(Streamer s, const char *path, struct Chain *c) {
+  int blocks = SECONDS * RATE / BLOCK;
+  float *buffers = malloc(8 * BLOCK * sizeof(float));
+  float *dry[] = {buffers, buffers + BLOCK};
+  float *live[] = {buffers + 2 * BLOCK, buffers + 3 * BLOCK};
+  float *frozen[] = {buffers + 4 * BLOCK, buffers + 5 * BLOCK};
+  uint64_t *liveNanos = malloc(blocks * sizeof(uint64_t));
+  uint64_t *frozenNanos = malloc(blocks * sizeof(uint64_t));
+
+  FrozenTrack f = makeFrozenTrack(s, path, 0);
+  if (!f) {
+    printf("can't stream %s\n", path);
+    return 0;
+  }
+  designChain(c);
+  long mismatches = 0;
+  for (int b = 0; b < blocks; b++) {
+    struct ProcessContext ctx = {
+        .frames = BLOCK,
+        .position = (uint64_t)b * BLOCK,
+        .playing = 1,
+        .outputCount = 2,
+        .outputs = dry,
+    };
+    saw(NULL, &ctx);
+
+    ctx.inputCount = 2;
+    ctx.inputs = (const float *const *)dry;
+    ctx.outputs = live;
+    uint64_t t0 = clockNanos();
+    chain(c, &ctx);
+    uint64_t t1 = clockNanos();
+
+    ctx.inputCount = 0;
+    ctx.inputs = NULL;
+    ctx.outputs = frozen;
+    frozenTrackProcess(f, &ctx);
+    uint64_t t2 = clockNanos();
+    liveNanos[b] = t1 - t0;
+    frozenNanos[b] = t2 - t1;
+
+    for (int ch = 0; ch < 2; ch++) {
+      for (int i = 0; i < BLOCK; i++) {
+        mismatches += live[ch][i] != frozen[ch][i];
+      }
+    }
+    nanosleep(&(struct timespec){0, 1000000}, NULL);
+  }
+
+  double liveMicros = median(liveNanos, blocks);
+  double frozenMicros = median(frozenNanos, blocks);
+  double budget = BLOCK * 1e6 / RATE;
+  printf("per %d frame block: live %.1f us, frozen %.2f us\n", BLOCK,
+         liveMicros, frozenMicros);
+  printf("tracks a core fits: live %.0f, frozen %.0f\n", budget / liveMicros,
+         budget / frozenMicros);
+  printf("frozen vs live: %ld mismatching samples, %llu underruns\n",
+         mismatches, (unsigned long long)streamerUnderruns(s));
+  int ok = mismatches == 0 && streamerUnderruns(s) == 0;
+
+  // past the end of the render it's silence
+  struct ProcessContext past = {
+      .frames = BLOCK,
+      .position = (uint64_t)blocks * BLOCK,
+      .playing = 1,
+      .outputCount = 2,
+      .outputs = frozen,
+  };
+  frozenTrackProcess(f, &past);
+  for (int i = 0; i < BLOCK; i++) {
+    ok &= frozen[0][i] == 0 && frozen[1][i] == 0;
+  }
+
+  freeFrozenTrack(f);
+  free(liveNanos);
+  free(frozenNanos);
+  free(buffers);
+  return ok;
+}
+
+// KEYS
+
+static void writeFile(const char *path, size_t bytes) {
+  FILE *f = fopen(path, "wb");
+  for (size_t i = 0; i < bytes; i++) {
+    fputc((int)(i & 0xff), f);
+  }
+  fclose(f);
+}
+
+// each input of the render changes the key, mixing doesn't
+static int checkKeys(const char *dir) {
+  char source[PATH_SIZE];
+  snprintf(source, sizeof(source), "%s/source.raw", dir);
+  writeFile(source, 1000);
+
+  struct FreezeRange range = {RATE, 2, 0, SECONDS * RATE};
+  struct Chain c;
+  designChain(&c);
+  struct Note note = {RATE, RATE / 2, 60, 100};
+  struct Breakpoint point = {0, 0.5f, 0, {0, 0}};
+  struct ClipState clip = {0, RATE, 0, source, 0};
+
+  Track empty = makeTrack("lead");
+  Track clipped = trackInsertClip(empty, 0, clip);
+  NoteTrack notes = makeNoteTrack(&note, 1);
+  Track noted = trackSetNotes(clipped, notes);
+  Automation curve = makeAutomation(&point, 1);
+  Track t = trackSetCurve(noted, 3, curve);
+  uint64_t key = freezeKey(t, &c, sizeof(c), range);
+
+  int ok = 1;
+  const char *failed = NULL;
+  Track renamed = trackRename(t, "lead 2");
+  Track mixed = trackSetMix(renamed, PROJECT_TRACK_MUTED, 0.5f, -1);
+  if (freezeKey(mixed, &c, sizeof(c), range) != key) {
+    failed = "name or mix";
+  }
+
+  struct ClipState moved = clip;
+  moved.start += 1;
+  Track movedClip = trackSetClip(t, 0, moved);
+  if (freezeKey(movedClip, &c, sizeof(c), range) == key) {
+    failed = "clip position";
+  }
+
+  point.value = 0.25f;
+  Automation edited = automationReplace(curve, 0, point);
+  Track editedCurve = trackSetCurve(t, 3, edited);
+  if (freezeKey(editedCurve, &c, sizeof(c), range) == key) {
+    failed = "automation";
+  }
+
+  note.pitch++;
+  NoteTrack more = noteTrackInsert(notes, note);
+  Track moreNotes = trackSetNotes(t, more);
+  if (freezeKey(moreNotes, &c, sizeof(c), range) == key) {
+    failed = "notes";
+  }
+
+  struct Chain other = c;
+  other.b0[STAGES - 1] += 1e-6f;
+  if (freezeKey(t, &other, sizeof(other), range) == key) {
+    failed = "processing state";
+  }
+
+  struct FreezeRange longer = range;
+  longer.frames++;
+  if (freezeKey(t, &c, sizeof(c), longer) == key) {
+    failed = "range";
+  }
+
+  writeFile(source, 1001);
+  if (freezeKey(t, &c, sizeof(c), range) == key) {
+    failed = "source file";
+  }
+  unlink(source);
+
+  if (failed) {
+    printf("key: %s\n", failed);
+    ok = 0;
+  } else {
+    printf("key: follows clips, sources, notes, automation, processing and "
+           "range, not the mix\n");
+  }
+
+  Track tracks[] = {empty, clipped,     noted,       t,        renamed,
+                    mixed, movedClip, editedCurve, moreNotes};
+  for (size_t i = 0; i < sizeof(tracks) / sizeof(*tracks); i++) {
+    trackRelease(tracks[i]);
+  }
+  noteTrackRelease(notes);
+  noteTrackRelease(more);
+  automationRelease(curve);
+  automationRelease(edited);
+  return ok;
+}
+
+// EVICTION
+
+static int exists(const char *path) { return access(path, F_OK) == 0; }
+
+// three short renders in a budget for two and a bit: the one not used since
+// goes. then a restart sees the same cache and clears a partial render
+static int checkEviction(const char *dir, struct Chain *c) {
+  int output;
+  CompiledGraph graph = makeTrackGraph(c, &output);
+  struct FreezeRange range = {RATE, 2, 0, RATE / 2};
+
+  char a[PATH_SIZE], b[PATH_SIZE], d[PATH_SIZE], found[PATH_SIZE];
+  FreezeCache cache = makeFreezeCache(dir, UINT64_MAX);
+  int ok = freezeCacheRender(cache, 1, graph, output, range, a, PATH_SIZE);
+  uint64_t size = freezeCacheBytes(cache);
+  freeFreezeCache(cache);
+
+  // a render's worth of budget a key, the first was cached already
+  cache = makeFreezeCache(dir, size * 5 / 2);
+  ok &= freezeCacheCount(cache) == 1;
+  ok &= freezeCacheRender(cache, 2, graph, output, range, b, PATH_SIZE);
+  ok &= freezeCacheFind(cache, 1, found, PATH_SIZE);
+  ok &= strcmp(found, a) == 0;
+  ok &= freezeCacheRender(cache, 3, graph, output, range, d, PATH_SIZE);
+  ok &= exists(a) && !exists(b) && exists(d);
+  ok &= !freezeCacheFind(cache, 2, found, PATH_SIZE);
+  ok &= freezeCacheCount(cache) == 2;
+  ok &= freezeCacheBytes(cache) <= size * 5 / 2;
+  freeFreezeCache(cache);
+
+  char partial[PATH_SIZE];
+  snprintf(partial, sizeof(partial), "%s/%016llx.part", dir, 4ULL);
+  writeFile(partial, 100);
+  cache = makeFreezeCache(dir, size);
+  ok &= !exists(partial);
+  ok &= freezeCacheCount(cache) == 1;
+  freeFreezeCache(cache);
+  printf("eviction: %s\n", ok ? "least recently used goes" : "wrong");
+
+  unlink(a);
+  unlink(d);
+  freeCompiledGraph(graph);
+  return ok;
+}
+
+int main(void) {
+  dspInit();
+
+  char dir[] = "/tmp/freeze-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char cacheDir[64];
+  snprintf(cacheDir, sizeof(cacheDir), "%s/cache", dir);
+
+  struct Chain c;
+  designChain(&c);
+  int output;
+  CompiledGraph graph = makeTrackGraph(&c, &output);
+  FreezeCache cache = makeFreezeCache(cacheDir, UINT64_MAX);
+  struct FreezeRange range = {RATE, 2, 0, SECONDS * RATE};
+  Track track = makeTrack("lead");
+  uint64_t key = freezeKey(track, &c, sizeof(c), range);
+
+  char path[PATH_SIZE];
+  int failed = freezeCacheFind(cache, key, path, sizeof(path));
+  uint64_t t0 = clockNanos();
+  failed |=
+      !freezeCacheRender(cache, key, graph, output, range, path, sizeof(path));
+  double seconds = (clockNanos() - t0) / 1e9;
+  failed |= !freezeCacheFind(cache, key, path, sizeof(path));
+  printf("freeze %d s of %d biquads a channel: %.2f s, %.1f MB\n", SECONDS,
+         STAGES, seconds, freezeCacheBytes(cache) / 1e6);
+
+  Streamer s = makeStreamer(4);
+  failed |= !checkPlayback(s, path, &c);
+  freeStreamer(s);
+  unlink(path);
+  freeFreezeCache(cache);
+  freeCompiledGraph(graph);
+  trackRelease(track);
+
+  failed |= !checkKeys(dir);
+  failed |= !checkEviction(cacheDir, &c);
+  rmdir(cacheDir);
+  rmdir(dir);
+  return failed;
+}
@@ -0,0 +1,310 @@
+// scaling of the parallel graph scheduler from 1 to N workers on a synthetic
+// session: TRACKS tracks of EFFECTS chained filters, summed into BUSES buses
+// and a master. then random graphs run with work stealing on several workers
+// have to come out sample for sample the same as the serial walk of their
+// topological order. last, every node run has to find its worker's scratch
+// empty, able to hand out all of it and nothing more.
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "graph.h"
+#include "scheduler.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACKS 256
+#define EFFECTS 4
+#define BUSES 16
+#define BLOCK_SIZE 256
+#define WARMUP_BLOCKS 50
+#define BLOCKS 1000
+#define SAMPLE_RATE 48000.0
+#define RANDOM_GRAPHS 8
+#define RANDOM_NODES 300
+#define RANDOM_BLOCKS 8
+#define MAX_WORKERS 8
+#define SCRATCH_NODES 64
+
+struct Noise {
+  unsigned state;
+};
+
+// a one-pole lowpass run several times, about as heavy as a cheap plugin
+struct Filter {
+  float z[8];
+};
+
+static void noise(void *state, const struct ProcessContext *ctx) {
+  struct Noise *n = state;
+  for (int i = 0; i < ctx->frames; i++) {
+    n->state = n->state * 1664525u + 1013904223u;
+    ctx->outputs[0][i] = (float)(n->state >> 8) / (float)(1 << 24) - 0.5f;
+  }
+}
+
+static void filter(void *state, const struct ProcessContext *ctx) {
+  struct Filter *f = state;
+  const float *in = ctx->inputs[0];
+  float *out = ctx->outputs[0];
+  for (int i = 0; i < ctx->frames; i++) {
+    float x = in[i];
+    for (int stage = 0; stage < 8; stage++) {
+      f->z[stage] += 0.1f * (x - f->z[stage]);
+      x = f->z[stage];
+    }
+    out[i] = x;
+  }
+}
+
+static void gain(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    ctx->outputs[0][i] = ctx->inputs[0][i] * 0.5f;
+  }
+}
+
+// a source that is a pure function of the position, so every run of the same
+// blocks sees the same samples
+static void hashed(void *state, const struct ProcessContext *ctx) {
+  unsigned seed = *(unsigned *)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    unsigned x = (unsigned)(ctx->position + i) * 2654435761u ^ seed;
+    x ^= x >> 15;
+    x *= 2246822519u;
+    x ^= x >> 13;
+    ctx->outputs[0][i] = (float)(x >> 8) / (float)(1 << 24) - 0.5f;
+  }
+}
+
+// stateless, and not linear, so an input read too early or twice shows
+static void shape(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    float x = ctx->inputs[0][i] - 0.5f * ctx->inputs[1][i];
+    ctx->outputs[0][i] = tanhf(x);
+  }
+}
+
+struct Scratch {
+  atomic_long runs;
+  atomic_long refused;    // fitting allocations that failed or were unaligned
+  atomic_long overflowed; // allocations past the end that were handed out
+};
+
+// takes all of the scratch in two halves, writes it, then asks for a byte more
+static void useScratch(void *state, const struct ProcessContext *ctx) {
+  struct Scratch *s = state;
+  size_t half = SCHEDULER_SCRATCH_BYTES / 2;
+  for (int i = 0; i < 2; i++) {
+    unsigned char *p = arenaAlloc(ctx->scratch, half);
+    if (!p || (uintptr_t)p % 64) {
+      atomic_fetch_add(&s->refused, 1);
+      continue;
+    }
+    memset(p, i + 1, half);
+  }
+  if (arenaAlloc(ctx->scratch, 1)) {
+    atomic_fetch_add(&s->overflowed, 1);
+  }
+  atomic_fetch_add(&s->runs, 1);
+  memcpy(ctx->outputs[0], ctx->inputs[0], ctx->frames * sizeof(float));
+}
+
+// chains of scratch users side by side, on every worker count. returns 1 if
+// every run found its scratch as it should
+static int checkScratch(void) {
+  struct Scratch s;
+  atomic_init(&s.runs, 0);
+  atomic_init(&s.refused, 0);
+  atomic_init(&s.overflowed, 0);
+  Graph g = makeGraph();
+  for (int i = 0; i < SCRATCH_NODES; i++) {
+    graphAddNode(g, (struct NodeDescription){
+                        .name = "scratch",
+                        .inputs = 1,
+                        .outputs = 1,
+                        .process = useScratch,
+                        .state = &s,
+                    });
+    if (i >= 8) {
+      graphConnect(g, i - 8, 0, i, 0);
+    }
+  }
+  CompiledGraph c = compileGraph(g, BLOCK_SIZE);
+  for (int workers = 1; workers <= MAX_WORKERS; workers *= 2) {
+    Scheduler scheduler = makeScheduler(workers, SCRATCH_NODES, 0);
+    for (int b = 0; b < RANDOM_BLOCKS; b++) {
+      schedulerRun(scheduler, c, BLOCK_SIZE, (uint64_t)b * BLOCK_SIZE, 1);
+    }
+    freeScheduler(scheduler);
+  }
+  freeCompiledGraph(c);
+  freeGraph(g);
+
+  long runs = atomic_load(&s.runs), refused = atomic_load(&s.refused),
+       overflowed = atomic_load(&s.overflowed);
+  printf("scratch: %ld node runs on 1 to %d workers, %ld fitting "
+         "allocations refused, %ld past the end handed out\n",
+         runs, MAX_WORKERS, refused, overflowed);
+  return runs == 4L * RANDOM_BLOCKS * SCRATCH_NODES && !refused && !overflowed;
+}
+
+// every node takes its inputs from earlier ones, some ports summing several
+static Graph makeRandomGraph(unsigned *seeds, unsigned *rng) {
+  Graph g = makeGraph();
+  for (int i = 0; i < RANDOM_NODES; i++) {
+    *rng = *rng * 1664525u + 1013904223u;
+    if (i < 8 || *rng >> 28 == 0) {
+      seeds[i] = *rng;
+      graphAddNode(g, (struct NodeDescription){
+                          .name = "source",
+                          .outputs = 1,
+                          .process = hashed,
+                          .state = &seeds[i],
+                      });
+      continue;
+    }
+    graphAddNode(g, (struct NodeDescription){
+                        .name = "shape",
+                        .inputs = 2,
+                        .outputs = 1,
+                        .process = shape,
+                    });
+    int connections = 1 + (*rng >> 8) % 4;
+    for (int c = 0; c < connections; c++) {
+      *rng = *rng * 1664525u + 1013904223u;
+      graphConnect(g, (int)((*rng >> 8) % i), 0, i, c % 2);
+    }
+  }
+  return g;
+}
+
+// every node's output for every block, as `workers` ran them
+static float *runRandomGraph(CompiledGraph c, int workers) {
+  int n = compiledNodeCount(c);
+  float *out = malloc((size_t)RANDOM_BLOCKS * n * BLOCK_SIZE * sizeof(float));
+  Scheduler s = makeScheduler(workers, n, 0);
+  for (int b = 0; b < RANDOM_BLOCKS; b++) {
+    schedulerRun(s, c, BLOCK_SIZE, (uint64_t)b * BLOCK_SIZE, 1);
+    for (int i = 0; i < n; i++) {
+      memcpy(out + ((size_t)b * n + i) * BLOCK_SIZE, compiledOutput(c, i, 0),
+             BLOCK_SIZE * sizeof(float));
+    }
+  }
+  freeScheduler(s);
+  return out;
+}
+
+int main(void) {
+  dspInit();
+
+  struct Noise *noises = calloc(TRACKS, sizeof(struct Noise));
+  struct Filter *filters = calloc(TRACKS * EFFECTS, sizeof(struct Filter));
+
+  // build the session
+  Graph g = makeGraph();
+  int master = graphAddNode(g, (struct NodeDescription){
+                                   .name = "master",
+                                   .inputs = 1,
+                                   .outputs = 1,
+                                   .process = gain,
+                               });
+  int buses[BUSES];
+  for (int b = 0; b < BUSES; b++) {
+    buses[b] = graphAddNode(g, (struct NodeDescription){
+                                   .name = "bus",
+                                   .inputs = 1,
+                                   .outputs = 1,
+                                   .process = gain,
+                               });
+    graphConnect(g, buses[b], 0, master, 0);
+  }
+  for (int t = 0; t < TRACKS; t++) {
+    noises[t].state = t + 1;
+    int prev = graphAddNode(g, (struct NodeDescription){
+                                   .name = "source",
+                                   .outputs = 1,
+                                   .process = noise,
+                                   .state = &noises[t],
+                               });
+    for (int e = 0; e < EFFECTS; e++) {
+      int fx = graphAddNode(g, (struct NodeDescription){
+                                   .name = "filter",
+                                   .inputs = 1,
+                                   .outputs = 1,
+                                   .process = filter,
+                                   .state = &filters[t * EFFECTS + e],
+                               });
+      graphConnect(g, prev, 0, fx, 0);
+      prev = fx;
+    }
+    graphConnect(g, prev, 0, buses[t % BUSES], 0);
+  }
+
+  CompiledGraph c = compileGraph(g, BLOCK_SIZE);
+  int nodes = compiledNodeCount(c);
+  double deadline = BLOCK_SIZE / SAMPLE_RATE * 1e6;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  printf("%d nodes, %d frame blocks, deadline %.1f us\n", nodes, BLOCK_SIZE,
+         deadline);
+  printf("%8s %12s %10s %10s\n", "workers", "us/block", "speedup", "load");
+
+  double serial = 0;
+  for (int workers = 1; workers <= cores; workers++) {
+    Scheduler s = makeScheduler(workers, nodes, 1);
+    for (int i = 0; i < WARMUP_BLOCKS; i++) {
+      schedulerRun(s, c, BLOCK_SIZE, 0, 1);
+    }
+
+    uint64_t start = clockNanos();
+    for (int i = 0; i < BLOCKS; i++) {
+      schedulerRun(s, c, BLOCK_SIZE, 0, 1);
+    }
+    double us = (clockNanos() - start) / 1e3 / BLOCKS;
+    if (workers == 1) {
+      serial = us;
+    }
+
+    printf("%8d %12.1f %9.2fx %9.1f%%\n", workers, us, serial / us,
+           us / deadline * 100);
+    freeScheduler(s);
+  }
+
+  freeCompiledGraph(c);
+  freeGraph(g);
+  free(filters);
+  free(noises);
+
+  // a single worker walks the topological order, the reference
+  unsigned rng = 1, seeds[RANDOM_NODES];
+  long mismatches = 0;
+  for (int r = 0; r < RANDOM_GRAPHS; r++) {
+    g = makeRandomGraph(seeds, &rng);
+    c = compileGraph(g, BLOCK_SIZE);
+    size_t samples =
+        (size_t)RANDOM_BLOCKS * compiledNodeCount(c) * BLOCK_SIZE;
+    float *serialOut = runRandomGraph(c, 1);
+    for (int workers = 2; workers <= MAX_WORKERS; workers *= 2) {
+      float *parallelOut = runRandomGraph(c, workers);
+      for (size_t i = 0; i < samples; i++) {
+        mismatches += parallelOut[i] != serialOut[i];
+      }
+      free(parallelOut);
+    }
+    free(serialOut);
+    freeCompiledGraph(c);
+    freeGraph(g);
+  }
+  printf("%d random graphs on 2 to %d workers against the serial order: "
+         "%ld mismatching samples\n",
+         RANDOM_GRAPHS, MAX_WORKERS, mismatches);
+
+  int scratched = checkScratch();
+  return mismatches != 0 || !scratched;
+}
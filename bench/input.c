@@ -0,0 +1,159 @@
+// input: fader drags from a 1 kHz mouse, read by a 60 Hz frame loop that
+// keeps two frames in flight the way the renderer does. every event pushed
+// has to be handed on or merged, a drag's moves mustn't be merged across its
+// press or release, the fader has to end up where each drag let go, and the
+// latency histogram has to show the frame the oldest move waits to be read
+// plus the frames in flight
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "input.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MOUSE_NANOS 1000000ull  // 1 kHz
+#define FRAME_NANOS 16666667ull // 60 Hz
+#define FRAMES_IN_FLIGHT 2
+#define DRAGS 4
+#define DRAG_MOVES 250
+#define FADER_HEIGHT 200.0
+
+struct Fader {
+  int dragging;
+  double value, grabbed;
+  double released[DRAGS];
+  int drags;
+  uint64_t handed, moves, strayMoves;
+  int movesThisFrame, buttonsThisFrame, worstFrame;
+};
+
+struct Mouse {
+  Input input;
+  double released[DRAGS]; // where each drag let go
+  atomic_int done;
+};
+
+static void sleepUntil(uint64_t deadline) {
+  uint64_t now = clockNanos();
+  if (deadline > now) {
+    struct timespec t = {(deadline - now) / 1000000000,
+                         (deadline - now) % 1000000000};
+    nanosleep(&t, NULL);
+  }
+}
+
+// press, drag a fader down and back up a little, release, pause
+static void *mouse(void *arg) {
+  struct Mouse *m = arg;
+  uint64_t next = clockNanos();
+  for (int d = 0; d < DRAGS; d++) {
+    inputPush(m->input, (struct InputEvent){.type = INPUT_MOUSE_MOVE,
+                                            .x = 10,
+                                            .y = 0});
+    inputPush(m->input, (struct InputEvent){.type = INPUT_MOUSE_BUTTON,
+                                            .action = 1});
+    double y = 0;
+    for (int i = 0; i < DRAG_MOVES; i++) {
+      next += MOUSE_NANOS;
+      sleepUntil(next);
+      y = i < DRAG_MOVES * 3 / 4 ? i : DRAG_MOVES * 3 / 2 - i;
+      y *= d + 1;
+      inputPush(m->input, (struct InputEvent){.type = INPUT_MOUSE_MOVE,
+                                              .x = 10,
+                                              .y = y});
+    }
+    m->released[d] = y;
+    inputPush(m->input, (struct InputEvent){.type = INPUT_MOUSE_BUTTON,
+                                            .action = 0});
+    next += 20 * MOUSE_NANOS;
+    sleepUntil(next);
+  }
+  atomic_store(&m->done, 1);
+  return NULL;
+}
+
+static void fader(void *state, const struct InputEvent *e) {
+  struct Fader *f = state;
+  f->handed += e->merged;
+  if (e->type == INPUT_MOUSE_BUTTON) {
+    f->buttonsThisFrame++;
+    f->dragging = e->action;
+    if (e->action) {
+      f->grabbed = e->y;
+    } else if (f->drags < DRAGS) {
+      f->released[f->drags++] = f->value;
+    }
+  } else if (e->type == INPUT_MOUSE_MOVE) {
+    f->movesThisFrame++;
+    f->moves++;
+    if (f->dragging) {
+      f->value = e->y - f->grabbed;
+    } else if (e->y != 0) {
+      f->strayMoves++; // a drag's move merged past its release
+    }
+  }
+}
+
+int main(void) {
+  Input in = makeInput(1024);
+  struct Mouse m = {.input = in};
+  atomic_init(&m.done, 0);
+  struct Fader f = {0};
+  uint64_t arrived[FRAMES_IN_FLIGHT] = {0};
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, mouse, &m);
+  uint64_t next = clockNanos();
+  int frames = 0;
+  for (int slot = 0; !atomic_load(&m.done) || frames % FRAMES_IN_FLIGHT;
+       slot = (slot + 1) % FRAMES_IN_FLIGHT) {
+    // the slot's last frame is done once the loop comes round to it
+    inputPresented(in, arrived[slot], clockNanos());
+    f.movesThisFrame = f.buttonsThisFrame = 0;
+    arrived[slot] = inputDispatch(in, fader, &f);
+    // at most one move either side of each press or release
+    int allowed = f.buttonsThisFrame + 1;
+    if (f.movesThisFrame - allowed > f.worstFrame) {
+      f.worstFrame = f.movesThisFrame - allowed;
+    }
+    next += FRAME_NANOS;
+    sleepUntil(next);
+    frames++;
+  }
+  pthread_join(thread, NULL);
+  for (int slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+    inputPresented(in, arrived[slot], clockNanos());
+  }
+  // whatever came in after the last frame
+  inputDispatch(in, fader, &f);
+
+  uint64_t pushed = inputPushed(in);
+  int accounted = f.handed + inputDropped(in) == pushed &&
+                  f.moves + inputMerged(in) + 2 * DRAGS == pushed;
+  int released = f.drags == DRAGS;
+  for (int d = 0; d < f.drags; d++) {
+    released &= f.released[d] == m.released[d];
+  }
+  struct InputLatency l = inputLatency(in);
+  int inRange = l.frames > 0 &&
+                l.p50 >= FRAME_NANOS * FRAMES_IN_FLIGHT &&
+                l.p50 <= FRAME_NANOS * (FRAMES_IN_FLIGHT + 1) * 1.25;
+  printf("%llu events over %d frames: %llu merged, %llu handed on, "
+         "%llu dropped\n",
+         (unsigned long long)pushed, frames,
+         (unsigned long long)inputMerged(in), (unsigned long long)f.handed,
+         (unsigned long long)inputDropped(in));
+  printf("every event accounted for: %s, drags released in place: %s, "
+         "stray moves: %llu, extra moves in a frame: %d\n",
+         accounted ? "yes" : "no", released ? "yes" : "no",
+         (unsigned long long)f.strayMoves, f.worstFrame);
+  printf("input to photon over %llu frames: p50 %.1f ms, p99 %.1f ms, "
+         "max %.1f ms\n",
+         (unsigned long long)l.frames, l.p50 / 1e6, l.p99 / 1e6,
+         l.max / 1e6);
+
+  freeInput(in);
+  return !accounted || !released || f.strayMoves || f.worstFrame > 0 ||
+         !inRange;
+}
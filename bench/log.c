@@ -0,0 +1,255 @@
+// logging: a record has to come out of the file the way printf would have
+// written it, filtered levels mustn't even evaluate their arguments, and
+// threads logging flat out have to lose records only by dropping them,
+// counted, never by garbling or reordering their own. then what a record
+// costs the thread writing it, and written out on top. results go to the json
+// file named on the command line, if any, for bench-compare
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "log.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINE 1024
+#define CASES 32
+#define THREADS 4
+#define FLAT_OUT 200000 // records a thread writes as fast as it can
+#define PACED 500       // records a thread writes well inside its ring
+#define BURST 512
+
+struct Cases {
+  char expected[CASES][LINE];
+  int count;
+};
+
+struct Writer {
+  int index;
+  int records;
+  pthread_t thread;
+};
+
+struct Load {
+  uint64_t hotNanos, hotRecords;
+};
+
+// splits a line into the thread's name and the message, 0 if it isn't one
+static int splitLine(char *line, char **name, char **message) {
+  line[strcspn(line, "\n")] = '\0';
+  char *colon = strstr(line, ": ");
+  if (!colon) {
+    return 0;
+  }
+  *colon = '\0';
+  *name = strrchr(line, ' ');
+  *name = *name ? *name + 1 : line;
+  *message = colon + 2;
+  return 1;
+}
+
+static int readMessages(const char *path, char (*messages)[LINE], int max) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return -1;
+  }
+  char line[LINE + 64], *name, *message;
+  int n = 0;
+  while (n < max && fgets(line, sizeof(line), f)) {
+    if (splitLine(line, &name, &message)) {
+      snprintf(messages[n++], LINE, "%s", message);
+    }
+  }
+  fclose(f);
+  return n;
+}
+
+static void *writerMain(void *arg) {
+  struct Writer *w = arg;
+  char name[16];
+  snprintf(name, sizeof(name), "writer%d", w->index);
+  logThreadEnter(name);
+  for (int i = 0; i < w->records; i++) {
+    logInfo("%d %d", w->index, i);
+  }
+  logThreadLeave();
+  return NULL;
+}
+
+// every thread's records come out in order, returns how many there were
+static long checkThreads(const char *path, int records, int *ordered) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    *ordered = 0;
+    return 0;
+  }
+  int last[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    last[t] = -1;
+  }
+  char line[LINE + 64], *name, *message;
+  long lines = 0;
+  *ordered = 1;
+  while (fgets(line, sizeof(line), f)) {
+    int t, seq;
+    if (!splitLine(line, &name, &message) ||
+        strncmp(name, "writer", 6) != 0 ||
+        sscanf(message, "%d %d", &t, &seq) != 2) {
+      continue;
+    }
+    if (t < 0 || t >= THREADS || atoi(name + 6) != t) {
+      *ordered = 0;
+      continue;
+    }
+    *ordered &= seq > last[t] && seq < records;
+    last[t] = seq;
+    lines++;
+  }
+  fclose(f);
+  return lines;
+}
+
+static long runThreads(const char *path, int records, int *ordered) {
+  truncate(path, 0);
+  struct Writer writers[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    writers[t] = (struct Writer){t, records, 0};
+    pthread_create(&writers[t].thread, NULL, writerMain, &writers[t]);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(writers[t].thread, NULL);
+  }
+  logFlush();
+  return checkThreads(path, records, ordered);
+}
+
+static void writeBody(void *state, long iterations) {
+  struct Load *l = state;
+  for (long i = 0; i < iterations; i++) {
+    uint64_t start = clockNanos();
+    for (int j = 0; j < BURST; j++) {
+      logInfo("voice %d at %.3f on %s", j, j * 0.25, "synth");
+    }
+    l->hotNanos += clockNanos() - start;
+    l->hotRecords += BURST;
+    logFlush();
+  }
+}
+
+#define CASE(...)                                                              \
+  do {                                                                         \
+    logInfo(__VA_ARGS__);                                                      \
+    snprintf(c.expected[c.count++], LINE, __VA_ARGS__);                        \
+  } while (0)
+
+int main(int argc, char **argv) {
+  char dir[] = "/tmp/log-XXXXXX";
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "Failed to make a temporary directory\n");
+    return 1;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "%s/daw.log", dir);
+  if (!logStart(path)) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return 1;
+  }
+  int failed = 0;
+
+  // formats, from a thread that hasn't entered
+  static struct Cases c;
+  long long big = -1234567890123ll;
+  size_t size = 4096;
+  ptrdiff_t distance = -77;
+  long double precise = 2.5L;
+  CASE("plain");
+  CASE("%d %i %u", -42, 7, 4000000000u);
+  CASE("[%5.2f|%-8s|%08x|%+d]", 3.14159, "left", 0xbeef, 5);
+  CASE("%lld %llu %lx", big, 18446744073709551615ull, 123456789l);
+  CASE("%zu %td %jd", size, distance, (intmax_t)-9);
+  CASE("%hhd %hhu %hd %hu", 300, 300, 70000, 70000);
+  CASE("%c%c%c", 'a', 'b', 'c');
+  CASE("%e %g %a %10.3E", 12345.678, 0.0001, 1.0, -2.5);
+  CASE("%Lf", precise);
+  CASE("%p", (void *)&c);
+  CASE("100%% sure of %s and %s", "this", "that");
+  CASE("%d %d %d %d %d %d", 1, 2, 3, 4, 5, 6);
+  CASE("%#o %#x %X", 8, 255, 255);
+  int cases = c.count;
+
+  // past LOG_ARGS the rest is as written, strings are cut to fit, and a
+  // trailing newline goes
+  logInfo("%d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7);
+  snprintf(c.expected[c.count++], LINE, "1 2 3 4 5 6 %%d");
+  char longText[100];
+  memset(longText, 'x', sizeof(longText) - 1);
+  longText[sizeof(longText) - 1] = '\0';
+  logInfo("%s|", longText);
+  snprintf(c.expected[c.count++], LINE, "%.*s|", LOG_TEXT - 1, longText);
+  logWarn("done\n");
+  snprintf(c.expected[c.count++], LINE, "done");
+
+  // filtered out in release builds, arguments and all
+  int evaluated = 0;
+#if LOG_LEVEL > LOG_DEBUG
+  logDebug("%d", evaluated++);
+#endif
+
+  logFlush();
+  static char messages[CASES][LINE];
+  int n = readMessages(path, messages, CASES);
+  int matched = n == c.count;
+  for (int i = 0; i < c.count && i < n; i++) {
+    if (strcmp(messages[i], c.expected[i]) != 0) {
+      printf("  wrote \"%s\", printf says \"%s\"\n", messages[i],
+             c.expected[i]);
+      matched = 0;
+    }
+  }
+  printf("%d formats and %d edge cases as printf writes them: %s\n", cases,
+         c.count - cases, matched ? "yes" : "no");
+  printf("filtered level evaluated its arguments: %s\n",
+         evaluated ? "yes" : "no");
+  failed |= !matched || evaluated;
+
+  // inside their rings nothing is lost, flat out everything is written or
+  // counted as dropped
+  int ordered;
+  uint64_t droppedBefore = logDropped();
+  long paced = runThreads(path, PACED, &ordered);
+  int pacedOk = paced == THREADS * PACED && logDropped() == droppedBefore &&
+                ordered;
+  printf("%d threads x %d records: %ld written, %s\n", THREADS, PACED, paced,
+         pacedOk ? "in order" : "wrong");
+  failed |= !pacedOk;
+
+  droppedBefore = logDropped();
+  long flat = runThreads(path, FLAT_OUT, &ordered);
+  uint64_t lost = logDropped() - droppedBefore;
+  int flatOk = flat + (long)lost == (long)THREADS * FLAT_OUT && ordered;
+  printf("%d threads x %d records flat out: %ld written, %llu dropped, %s\n",
+         THREADS, FLAT_OUT, flat, (unsigned long long)lost,
+         flatOk ? "in order" : "wrong");
+  failed |= !flatOk;
+
+  truncate(path, 0);
+  logThreadEnter("bench");
+  struct Load l = {0};
+  BenchReport r = makeBenchReport("log");
+  struct BenchResult write =
+      benchRun(r, "log/write", "512 records", writeBody, &l);
+  printf("%.0f ns a record on the writing thread, %.0f written out\n",
+         (double)l.hotNanos / l.hotRecords, write.median / BURST);
+  logThreadLeave();
+  logStop();
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  freeBenchReport(r);
+  unlink(path);
+  rmdir(dir);
+  return failed || !written;
+}
@@ -0,0 +1,178 @@
+// metering cost on both sides for 256 channels, plus a check that peaks
+// survive the trip to a ui reading slower than the audio thread publishes
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "meter.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define CHANNELS 256
+#define BLOCKS 20000
+#define FRAMES 2000
+#define FPS 120
+
+// the lost peak check
+#define CHECK_CHANNELS 32
+#define CHECK_BLOCKS 20000
+
+static float signal[CHANNELS][BLOCK];
+
+static void fill(int block, int steady) {
+  for (int c = 0; c < CHANNELS; c++) {
+    for (int i = 0; i < BLOCK; i++) {
+      double t = (double)(block * BLOCK + i) / SAMPLE_RATE;
+      double amplitude = steady ? 0.5 : 0.5 + 0.45 * sin(t * (1 + c % 7));
+      signal[c][i] = (float)(amplitude * sin(2 * DSP_PI * 440 * t));
+    }
+  }
+}
+
+static void audioSide(void) {
+  Meters m = makeMeters(CHANNELS, SAMPLE_RATE);
+  fill(0, 0);
+
+  uint64_t start = clockNanos();
+  for (int b = 0; b < BLOCKS; b++) {
+    for (int c = 0; c < CHANNELS; c++) {
+      meterMeasure(m, c, signal[c], BLOCK);
+    }
+    meterPublish(m, (uint64_t)b * BLOCK);
+  }
+  double us = (clockNanos() - start) / 1e3 / BLOCKS;
+  double deadline = 1e6 * BLOCK / SAMPLE_RATE;
+
+  printf("audio: %d channels, %.2f us per %d frame block (%.2f%% of "
+         "the deadline)\n",
+         CHANNELS, us, BLOCK, 100 * us / deadline);
+  freeMeters(m);
+}
+
+// one display frame per FPS, with the audio running ahead of it
+static void uiSide(const char *name, int steady) {
+  Meters m = makeMeters(CHANNELS, SAMPLE_RATE);
+  struct MeterInstance instances[CHANNELS];
+  uint8_t dirty[CHANNELS];
+  for (int c = 0; c < CHANNELS; c++) {
+    instances[c] = makeMeterInstance(c * 4.0f, 0, 3, 200);
+  }
+
+  int blocksPerFrame = SAMPLE_RATE / BLOCK / FPS + 1;
+  long uploads = 0;
+  uint64_t nanos = 0;
+  for (int f = 0; f < FRAMES; f++) {
+    for (int b = 0; b < blocksPerFrame; b++) {
+      fill(f * blocksPerFrame + b, steady);
+      for (int c = 0; c < CHANNELS; c++) {
+        meterMeasure(m, c, signal[c], BLOCK);
+      }
+      meterPublish(m, 0);
+    }
+
+    uint64_t start = clockNanos();
+    const struct MeterLevel *levels = meterRead(m, NULL);
+    if (levels) {
+      uploads += meterUpdateInstances(instances, levels, CHANNELS,
+                                      (float)f / FPS, dirty);
+    }
+    nanos += clockNanos() - start;
+  }
+
+  // the first second is the meters rising from the floor
+  printf("ui %-8s %.2f us per frame, %.1f of %d meters written per frame\n",
+         name, nanos / 1e3 / FRAMES, (double)uploads / FRAMES, CHANNELS);
+  freeMeters(m);
+}
+
+struct Reading {
+  uint64_t position;
+  float peaks[CHECK_CHANNELS];
+};
+
+struct Check {
+  Meters meters;
+  struct Reading *readings;
+  int readingCount;
+  atomic_int done;
+};
+
+static void *reader(void *arg) {
+  struct Check *c = arg;
+  struct timespec wait = {0, 200000};
+  for (;;) {
+    int done = atomic_load(&c->done);
+    uint64_t position;
+    const struct MeterLevel *levels = meterRead(c->meters, &position);
+    if (levels) {
+      struct Reading *r = &c->readings[c->readingCount++];
+      r->position = position;
+      for (int ch = 0; ch < CHECK_CHANNELS; ch++) {
+        r->peaks[ch] = levels[ch].peak;
+      }
+    } else if (done) {
+      return NULL;
+    }
+    nanosleep(&wait, NULL);
+  }
+}
+
+// every block spikes one channel with a value smaller than any before it. the
+// first reading at or after that block must show at least that much on that
+// channel, otherwise the spike was lost
+static int lostPeaks(void) {
+  static float block[BLOCK];
+  struct Check c = {0};
+  c.meters = makeMeters(CHECK_CHANNELS, SAMPLE_RATE);
+  c.readings = malloc(CHECK_BLOCKS * sizeof(struct Reading));
+  atomic_init(&c.done, 0);
+
+  int *channels = malloc(CHECK_BLOCKS * sizeof(int));
+  unsigned seed = 12345;
+  pthread_t thread;
+  pthread_create(&thread, NULL, reader, &c);
+
+  for (int b = 0; b < CHECK_BLOCKS; b++) {
+    seed = seed * 1103515245 + 12345;
+    channels[b] = (seed >> 16) % CHECK_CHANNELS;
+    block[BLOCK / 2] = 1.0f - b * 1e-5f;
+    meterMeasure(c.meters, channels[b], block, BLOCK);
+    meterPublish(c.meters, b);
+    if (b % 64 == 0) {
+      sched_yield();
+    }
+  }
+  atomic_store(&c.done, 1);
+  pthread_join(thread, NULL);
+
+  int lost = 0, r = 0;
+  for (int b = 0; b < CHECK_BLOCKS; b++) {
+    while (r < c.readingCount && c.readings[r].position < (uint64_t)b) {
+      r++;
+    }
+    if (r == c.readingCount ||
+        c.readings[r].peaks[channels[b]] < 1.0f - b * 1e-5f) {
+      lost++;
+    }
+  }
+  printf("check: %d blocks, %d readings, %d spikes lost\n", CHECK_BLOCKS,
+         c.readingCount, lost);
+
+  free(channels);
+  free(c.readings);
+  freeMeters(c.meters);
+  return lost;
+}
+
+int main(void) {
+  dspInit();
+  audioSide();
+  uiSide("steady", 1);
+  uiSide("moving", 0);
+  return lostPeaks() != 0;
+}
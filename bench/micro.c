@@ -0,0 +1,229 @@
+// microbenchmarks of the hot paths that run every frame or every block:
+// building the ui's draw list, the way main.c used to with a realloc a
+// vertex and with the draw list that replaced it, and the dsp kernels of
+// every isa the cpu runs. the draw lists have to come out the same. results
+// go to the json file named on the command line, if any, for bench-compare
+#include "drawlist.h"
+#include "dsp.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECTS 1000 // a busy arrangement view
+#define TRIANGLE_EVERY 8
+#define BLOCK 256
+
+// what main.c did before the draw list, a realloc for every vertex
+struct VertexBuilder {
+  struct Vertex *vertices;
+  int vertexCount;
+};
+
+struct Kernel {
+  const struct DspKernels *k;
+  float *a, *b, *c;
+  int16_t *s16;
+};
+
+static volatile float sink;
+
+static void pushVertex(struct VertexBuilder *b, struct Vertex v) {
+  b->vertices =
+      realloc(b->vertices, (b->vertexCount + 1) * sizeof(struct Vertex));
+  b->vertices[b->vertexCount++] = v;
+}
+
+static void rectangle(struct VertexBuilder *b, int x, int y, int width,
+                      int height) {
+  struct Vertex topLeft = {{x, y}};
+  struct Vertex topRight = {{x + width, y}};
+  struct Vertex bottomRight = {{x + width, y + height}};
+  struct Vertex bottomLeft = {{x, y + height}};
+
+  pushVertex(b, topLeft);
+  pushVertex(b, topRight);
+  pushVertex(b, bottomRight);
+  pushVertex(b, bottomRight);
+  pushVertex(b, bottomLeft);
+  pushVertex(b, topLeft);
+}
+
+static void triangle(struct VertexBuilder *b, int x, int y, int width,
+                     int height) {
+  struct Vertex top = {{x, y}};
+  struct Vertex left = {{x, y + height}};
+  struct Vertex right = {{x + width, y + height}};
+
+  pushVertex(b, top);
+  pushVertex(b, right);
+  pushVertex(b, left);
+}
+
+// clips on a grid of tracks, a marker on every few
+static void buildLegacy(struct VertexBuilder *b) {
+  for (int i = 0; i < RECTS; i++) {
+    int x = i % 40 * 30, y = i / 40 * 20;
+    rectangle(b, x, y, 28, 18);
+    if (i % TRIANGLE_EVERY == 0) {
+      triangle(b, x, y, 6, 6);
+    }
+  }
+}
+
+static void build(DrawList l) {
+  for (int i = 0; i < RECTS; i++) {
+    int x = i % 40 * 30, y = i / 40 * 20;
+    drawListRectangle(l, x, y, 28, 18);
+    if (i % TRIANGLE_EVERY == 0) {
+      drawListTriangle(l, x, y, 6, 6);
+    }
+  }
+}
+
+static void legacyBody(void *state, long iterations) {
+  (void)state;
+  for (long i = 0; i < iterations; i++) {
+    struct VertexBuilder b = {0};
+    buildLegacy(&b);
+    sink = b.vertices[b.vertexCount - 1].pos.x;
+    free(b.vertices);
+  }
+}
+
+static void growBody(void *state, long iterations) {
+  (void)state;
+  for (long i = 0; i < iterations; i++) {
+    DrawList l = makeDrawList(0);
+    build(l);
+    sink = drawListVertices(l)[drawListCount(l) - 1].pos.x;
+    freeDrawList(l);
+  }
+}
+
+static void reusedBody(void *state, long iterations) {
+  DrawList l = state;
+  for (long i = 0; i < iterations; i++) {
+    drawListClear(l);
+    build(l);
+    sink = drawListVertices(l)[drawListCount(l) - 1].pos.x;
+  }
+}
+
+static void addBody(void *state, long iterations) {
+  struct Kernel *k = state;
+  for (long i = 0; i < iterations; i++) {
+    k->k->add(k->c, k->a, BLOCK);
+  }
+}
+
+static void mixRampBody(void *state, long iterations) {
+  struct Kernel *k = state;
+  for (long i = 0; i < iterations; i++) {
+    k->k->mixRamp(k->c, k->a, 0.5f, 0.25f, BLOCK);
+  }
+}
+
+static void dotBody(void *state, long iterations) {
+  struct Kernel *k = state;
+  for (long i = 0; i < iterations; i++) {
+    sink = k->k->dot(k->a, k->b, BLOCK);
+  }
+}
+
+static void levelsBody(void *state, long iterations) {
+  struct Kernel *k = state;
+  float peak, sumSquares;
+  for (long i = 0; i < iterations; i++) {
+    k->k->levels(k->a, BLOCK, &peak, &sumSquares);
+  }
+  sink = peak + sumSquares;
+}
+
+static void interleaveBody(void *state, long iterations) {
+  struct Kernel *k = state;
+  for (long i = 0; i < iterations; i++) {
+    k->k->interleave2(k->c, k->a, k->b, BLOCK);
+  }
+}
+
+static void toInt16Body(void *state, long iterations) {
+  struct Kernel *k = state;
+  for (long i = 0; i < iterations; i++) {
+    k->k->floatToInt16(k->s16, k->a, BLOCK);
+  }
+}
+
+static int sameDrawLists(void) {
+  struct VertexBuilder b = {0};
+  buildLegacy(&b);
+  DrawList l = makeDrawList(0);
+  build(l);
+  int same = b.vertexCount == drawListCount(l) &&
+             memcmp(b.vertices, drawListVertices(l),
+                    b.vertexCount * sizeof(struct Vertex)) == 0;
+  free(b.vertices);
+  freeDrawList(l);
+  return same;
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  BenchReport r = makeBenchReport("micro");
+
+  int same = sameDrawLists();
+  printf("draw lists: %s\n", same ? "identical" : "DIFFER");
+
+  char unit[32];
+  snprintf(unit, sizeof(unit), "%d rects", RECTS);
+  benchRun(r, "draw/pushVertex", unit, legacyBody, NULL);
+  benchRun(r, "draw/grow", unit, growBody, NULL);
+  DrawList reused = makeDrawList(0);
+  benchRun(r, "draw/reused", unit, reusedBody, reused);
+  freeDrawList(reused);
+
+  struct Kernel k;
+  k.a = malloc(2 * BLOCK * sizeof(float));
+  k.b = malloc(2 * BLOCK * sizeof(float));
+  k.c = malloc(2 * BLOCK * sizeof(float));
+  k.s16 = malloc(BLOCK * sizeof(int16_t));
+  for (int i = 0; i < 2 * BLOCK; i++) {
+    k.a[i] = (float)rand() / RAND_MAX * 2 - 1;
+    k.b[i] = (float)rand() / RAND_MAX * 2 - 1;
+    k.c[i] = 0;
+  }
+  snprintf(unit, sizeof(unit), "%d frames", BLOCK);
+  struct {
+    const char *name;
+    BenchBody body;
+  } kernels[] = {
+      {"add", addBody},
+      {"mixRamp", mixRampBody},
+      {"dot", dotBody},
+      {"levels", levelsBody},
+      {"interleave2", interleaveBody},
+      {"floatToInt16", toInt16Body},
+  };
+  for (int isa = 0; isa < DSP_ISA_COUNT; isa++) {
+    k.k = dspKernels(isa);
+    if (!k.k) {
+      continue;
+    }
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+      char name[64];
+      snprintf(name, sizeof(name), "dsp/%s/%s", k.k->name, kernels[i].name);
+      benchRun(r, name, unit, kernels[i].body, &k);
+    }
+  }
+  free(k.a);
+  free(k.b);
+  free(k.c);
+  free(k.s16);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  if (!written) {
+    fprintf(stderr, "can't write %s\n", argv[1]);
+  }
+  freeBenchReport(r);
+  return !same || !written;
+}
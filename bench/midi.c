@@ -0,0 +1,281 @@
+// note tracks: block event extraction against scanning every note, edits
+// against building the track from scratch, and what playback and scrolling
+// cost on an orchestral sized track, with and without a note held through
+// the whole song
+#include "clock.h"
+#include "midi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 48000
+#define BLOCK 256
+#define CHECK_NOTES 5000
+#define NOTES 300000
+#define MINUTES 40
+#define MAX_EVENTS 512
+#define MAX_RUNS 16
+
+static struct Note randomNote(uint64_t songLength) {
+  // mostly short notes, now and then one held for seconds
+  uint32_t length = rand() % 20 ? 1000 + rand() % 24000 : rand() % (8 * RATE);
+  return (struct Note){
+      .start = (uint64_t)((double)rand() / RAND_MAX * songLength),
+      .length = length,
+      .pitch = (uint8_t)(24 + rand() % 85),
+      .velocity = (uint8_t)(1 + rand() % 127),
+  };
+}
+
+static int compareEvents(const void *x, const void *y) {
+  const struct MidiEvent *a = x, *b = y;
+  if (a->offset != b->offset) {
+    return a->offset < b->offset ? -1 : 1;
+  }
+  if (a->type != b->type) {
+    return a->type - b->type;
+  }
+  if (a->pitch != b->pitch) {
+    return a->pitch - b->pitch;
+  }
+  return a->velocity - b->velocity;
+}
+
+// every note of the track, looked at once per block
+static int scan(NoteTrack t, uint64_t position, int frames,
+                struct MidiEvent *events) {
+  struct NoteColumns c = noteTrackColumns(t);
+  int n = 0;
+  for (int i = 0; i < noteTrackCount(t); i++) {
+    uint64_t end = c.starts[i] + c.lengths[i];
+    if (end >= position && end < position + frames) {
+      events[n++] = (struct MidiEvent){(uint32_t)(end - position),
+                                       MIDI_NOTE_OFF, c.pitches[i], 0};
+    }
+    if (c.starts[i] >= position && c.starts[i] < position + frames) {
+      events[n++] =
+          (struct MidiEvent){(uint32_t)(c.starts[i] - position), MIDI_NOTE_ON,
+                             c.pitches[i], c.velocities[i]};
+    }
+  }
+  return n;
+}
+
+static int sameTracks(NoteTrack a, NoteTrack b) {
+  int n = noteTrackCount(a);
+  if (n != noteTrackCount(b)) {
+    return 0;
+  }
+  struct NoteColumns x = noteTrackColumns(a), y = noteTrackColumns(b);
+  return memcmp(x.starts, y.starts, n * sizeof(uint64_t)) == 0 &&
+         memcmp(x.lengths, y.lengths, n * sizeof(uint32_t)) == 0 &&
+         memcmp(x.pitches, y.pitches, n) == 0 &&
+         memcmp(x.velocities, y.velocities, n) == 0;
+}
+
+static int checkEvents(NoteTrack t, uint64_t songLength) {
+  struct MidiEvent actual[MAX_EVENTS], expected[MAX_EVENTS];
+  struct NoteCursor cursor = {0};
+
+  // odd block sizes and a few seeks. a seek adds one all notes off up front
+  int ok = 1;
+  for (uint64_t position = 0; position < songLength && ok;) {
+    int frames = 1 + rand() % (4 * BLOCK);
+    int seeked = cursor.track && cursor.next != position;
+    int n = noteTrackEvents(t, &cursor, position, frames, actual, MAX_EVENTS);
+    int m = scan(t, position, frames, expected);
+    if (seeked) {
+      ok &= n > 0 && actual[0].type == MIDI_ALL_NOTES_OFF;
+      n = n > 0 ? n - 1 : 0;
+      memmove(actual, actual + 1, n * sizeof(struct MidiEvent));
+    }
+    for (int i = 1; i < n; i++) {
+      ok &= actual[i - 1].offset <= actual[i].offset;
+    }
+    qsort(actual, n, sizeof(struct MidiEvent), compareEvents);
+    qsort(expected, m, sizeof(struct MidiEvent), compareEvents);
+    ok &= n == m;
+    for (int i = 0; i < n && ok; i++) {
+      ok &= compareEvents(&actual[i], &expected[i]) == 0;
+    }
+
+    position += frames;
+    if (rand() % 100 == 0) {
+      position = (uint64_t)((double)rand() / RAND_MAX * songLength);
+    }
+  }
+
+  // a tiny event buffer delays events, it never loses them
+  int ons = 0, offs = 0;
+  cursor = (struct NoteCursor){0};
+  for (uint64_t position = 0; position < songLength + 10 * RATE;
+       position += BLOCK) {
+    struct MidiEvent few[2];
+    int n = noteTrackEvents(t, &cursor, position, BLOCK, few, 2);
+    for (int i = 0; i < n; i++) {
+      ons += few[i].type == MIDI_NOTE_ON;
+      offs += few[i].type == MIDI_NOTE_OFF;
+    }
+  }
+  ok &= ons == noteTrackCount(t) && offs == noteTrackCount(t);
+  return ok;
+}
+
+static int checkEdits(struct Note *notes, NoteTrack t) {
+  int ok = 1;
+  for (int i = 0; i < 100 && ok; i++) {
+    struct Note note = notes[rand() % CHECK_NOTES];
+    note.pitch = (uint8_t)(note.pitch + 1 + rand() % 3);
+
+    // insert, then the same as built from scratch
+    notes[CHECK_NOTES] = note;
+    NoteTrack inserted = noteTrackInsert(t, note);
+    NoteTrack expected = makeNoteTrack(notes, CHECK_NOTES + 1);
+    ok &= sameTracks(inserted, expected);
+
+    // and removed again
+    int index = 0;
+    struct Note found = noteTrackNote(inserted, index);
+    while (found.start != note.start || found.pitch != note.pitch ||
+           found.length != note.length || found.velocity != note.velocity) {
+      found = noteTrackNote(inserted, ++index);
+    }
+    NoteTrack removed = noteTrackRemove(inserted, index);
+    ok &= sameTracks(removed, t);
+    noteTrackRelease(inserted);
+    noteTrackRelease(expected);
+    noteTrackRelease(removed);
+  }
+  return ok;
+}
+
+// every overlapping note in exactly one run, with room for one run or many
+static int checkVisible(NoteTrack t, uint64_t songLength) {
+  struct NoteColumns c = noteTrackColumns(t);
+  char *seen = malloc(noteTrackCount(t));
+  int ok = 1;
+  for (int i = 0; i < 1000 && ok; i++) {
+    uint64_t start = (uint64_t)((double)rand() / RAND_MAX * songLength);
+    uint64_t end = start + 1 + rand() % (20 * RATE);
+    struct NoteRange runs[MAX_RUNS];
+    int count = noteTrackVisible(t, start, end, runs, i % 2 ? MAX_RUNS : 1);
+    memset(seen, 0, noteTrackCount(t));
+    for (int r = 0; r < count; r++) {
+      for (int j = runs[r].first; j < runs[r].first + runs[r].count; j++) {
+        ok &= !seen[j]++;
+      }
+    }
+    for (int j = 0; j < noteTrackCount(t); j++) {
+      ok &= seen[j] || c.starts[j] >= end ||
+            c.starts[j] + c.lengths[j] <= start;
+    }
+  }
+  free(seen);
+  return ok;
+}
+
+// notes handed to the renderer for one view
+static int visibleNotes(NoteTrack t, uint64_t start, uint64_t end) {
+  struct NoteRange runs[MAX_RUNS];
+  int count = noteTrackVisible(t, start, end, runs, MAX_RUNS), notes = 0;
+  for (int r = 0; r < count; r++) {
+    notes += runs[r].count;
+  }
+  return notes;
+}
+
+static int check(void) {
+  uint64_t songLength = (uint64_t)60 * RATE;
+  struct Note *notes = malloc((CHECK_NOTES + 1) * sizeof(struct Note));
+  for (int i = 0; i < CHECK_NOTES; i++) {
+    notes[i] = randomNote(songLength);
+  }
+  NoteTrack t = makeNoteTrack(notes, CHECK_NOTES);
+
+  int events = checkEvents(t, songLength);
+  int edits = checkEdits(notes, t);
+  NoteTrack held = noteTrackInsert(
+      t, (struct Note){0, (uint32_t)songLength, 60, 100});
+  int visible = checkVisible(t, songLength) && checkVisible(held, songLength);
+  noteTrackRelease(held);
+  printf("check: %d notes, events %s, edits %s, visible ranges %s\n",
+         CHECK_NOTES, events ? "right" : "WRONG", edits ? "right" : "WRONG",
+         visible ? "right" : "WRONG");
+
+  noteTrackRelease(t);
+  free(notes);
+  return events && edits && visible;
+}
+
+// keeps the extraction from being optimized away
+static volatile int sink;
+
+static void measure(void) {
+  uint64_t songLength = (uint64_t)MINUTES * 60 * RATE;
+  struct Note *notes = malloc(NOTES * sizeof(struct Note));
+  for (int i = 0; i < NOTES; i++) {
+    notes[i] = randomNote(songLength);
+  }
+  uint64_t start = clockNanos();
+  NoteTrack t = makeNoteTrack(notes, NOTES);
+  printf("%d notes over %d minutes, built in %.1f ms\n", NOTES, MINUTES,
+         (clockNanos() - start) / 1e6);
+
+  // the whole song block by block
+  struct MidiEvent events[MAX_EVENTS];
+  struct NoteCursor cursor = {0};
+  long blocks = (long)(songLength / BLOCK);
+  start = clockNanos();
+  for (long b = 0; b < blocks; b++) {
+    sink += noteTrackEvents(t, &cursor, (uint64_t)b * BLOCK, BLOCK, events,
+                            MAX_EVENTS);
+  }
+  double cursorNanos = (double)(clockNanos() - start) / blocks;
+  printf("  events      %9.1f ns a block\n", cursorNanos);
+
+  // scanning every note gets a sample of blocks, it's far too slow for all
+  long sampled = 2000;
+  start = clockNanos();
+  for (long b = 0; b < sampled; b++) {
+    sink += scan(t, (uint64_t)(b * (blocks / sampled)) * BLOCK, BLOCK, events);
+  }
+  double scanNanos = (double)(clockNanos() - start) / sampled;
+  printf("  scan        %9.1f ns a block, %.0fx slower\n", scanNanos,
+         scanNanos / cursorNanos);
+
+  // what scrolling costs the renderer: one range query a frame, then the
+  // same with a pedal note held from the first frame to the last
+  NoteTrack held = noteTrackInsert(
+      t, (struct Note){0, (uint32_t)songLength, 36, 100});
+  NoteTrack tracks[] = {t, held};
+  const char *names[] = {"visible", "  held note"};
+  for (int k = 0; k < 2; k++) {
+    long notes = 0;
+    start = clockNanos();
+    for (int i = 0; i < 100000; i++) {
+      uint64_t from = (uint64_t)i * (songLength / 100000);
+      notes += visibleNotes(tracks[k], from, from + 20 * RATE);
+    }
+    printf("  %-11s %9.1f ns a frame, %ld notes drawn\n", names[k],
+           (clockNanos() - start) / 1e5, notes / 100000);
+    sink += (int)notes;
+  }
+  noteTrackRelease(held);
+
+  // an edit copies the track once
+  start = clockNanos();
+  NoteTrack edited = noteTrackInsert(t, notes[0]);
+  printf("  edit        %9.1f ms\n", (clockNanos() - start) / 1e6);
+
+  noteTrackRelease(edited);
+  noteTrackRelease(t);
+  free(notes);
+}
+
+int main(void) {
+  if (!check()) {
+    return EXIT_FAILURE;
+  }
+  measure();
+  return EXIT_SUCCESS;
+}
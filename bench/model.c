@@ -0,0 +1,428 @@
+// the persistent project model: vectors against plain arrays, undo and redo
+// through a long history, then what an edit costs on a 200 track project in
+// time and in memory kept per undo step, against copying the whole project
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "model.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RATE 48000
+#define TRACKS 200
+#define NOTES 2000 // a track
+#define LANES 4
+#define POINTS 200 // a curve
+#define CLIPS 8
+#define MINUTES 10
+#define CHECK_OPS 20000
+#define EDITS 1000
+
+// VECTORS
+
+// items are counted in and out, a vector that leaks or frees twice shows
+static long liveItems;
+
+static void retainItem(const void *item) {
+  (void)item;
+  liveItems++;
+}
+
+static void releaseItem(const void *item) {
+  (void)item;
+  liveItems--;
+}
+
+static const struct VectorItems counted = {sizeof(int), retainItem,
+                                           releaseItem};
+
+static int sameAsArray(Vector v, const int *array, int count) {
+  if (vectorCount(v) != count) {
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    if (*(const int *)vectorGet(v, i) != array[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// random edits side by side with an array. every version is kept and checked
+// again at the end, old versions must not see later edits
+static int checkVectors(void) {
+  int *arrays = malloc((size_t)CHECK_OPS * 2100 * sizeof(int));
+  int *counts = malloc(CHECK_OPS * sizeof(int));
+  Vector *versions = malloc(CHECK_OPS * sizeof(Vector));
+  int kept = 0, ok = 1;
+
+  Vector v = makeVector(&counted);
+  int array[2100], count = 0;
+  for (int op = 0; op < CHECK_OPS && ok; op++) {
+    int item = rand(), index = count ? rand() % count : 0;
+    int kind = rand() % 10;
+    Vector next;
+    if (count < 2000 && (kind < 5 || count == 0)) {
+      next = vectorPush(v, &item);
+      array[count++] = item;
+    } else if (kind < 7) {
+      next = vectorSet(v, index, &item);
+      array[index] = item;
+    } else if (kind < 8) {
+      next = vectorPop(v);
+      count--;
+    } else if (kind < 9 && count < 2000) {
+      index = rand() % (count + 1);
+      next = vectorInsert(v, index, &item);
+      memmove(array + index + 1, array + index, (count - index) * sizeof(int));
+      array[index] = item;
+      count++;
+    } else {
+      next = vectorRemove(v, index);
+      memmove(array + index, array + index + 1,
+              (count - index - 1) * sizeof(int));
+      count--;
+    }
+    vectorRelease(v);
+    v = next;
+    ok &= sameAsArray(v, array, count);
+
+    if (op % 20 == 0) {
+      vectorRetain(v);
+      versions[kept] = v;
+      counts[kept] = count;
+      memcpy(arrays + (size_t)kept * 2100, array, count * sizeof(int));
+      kept++;
+    }
+  }
+  for (int i = 0; i < kept; i++) {
+    ok &= sameAsArray(versions[i], arrays + (size_t)i * 2100, counts[i]);
+    vectorRelease(versions[i]);
+  }
+  vectorRelease(v);
+  ok &= liveItems == 0;
+
+  printf("check: %d vector edits, %d versions kept, items %s\n", CHECK_OPS,
+         kept, liveItems ? "LEAKED" : "all freed");
+  free(arrays);
+  free(counts);
+  free(versions);
+  return ok;
+}
+
+// A PROJECT
+
+static uint64_t randomPosition(void) {
+  return (uint64_t)((double)rand() / RAND_MAX * MINUTES * 60 * RATE);
+}
+
+static struct Note randomNote(void) {
+  return (struct Note){
+      .start = randomPosition(),
+      .length = 1000 + rand() % 24000,
+      .pitch = (uint8_t)(24 + rand() % 85),
+      .velocity = (uint8_t)(1 + rand() % 127),
+  };
+}
+
+static struct Breakpoint randomPoint(void) {
+  return (struct Breakpoint){
+      .position = randomPosition(),
+      .value = (float)rand() / RAND_MAX,
+      .shape = (uint32_t)(rand() % 4),
+      .control = {0.25f, 0.75f},
+  };
+}
+
+static struct ClipState randomClip(int track, int take) {
+  static char source[64];
+  snprintf(source, sizeof(source), "audio/track%03d-take%d.wav", track, take);
+  return (struct ClipState){randomPosition(), 10 * RATE,
+                            (uint64_t)(rand() % RATE), source, 0};
+}
+
+static Model makeProject(void) {
+  struct Note notes[NOTES];
+  struct Breakpoint points[POINTS];
+  Model m = makeModel(RATE);
+  for (int t = 0; t < TRACKS; t++) {
+    char name[32];
+    snprintf(name, sizeof(name), "Track %d", t + 1);
+    Track track = makeTrack(name);
+    for (int i = 0; i < NOTES; i++) {
+      notes[i] = randomNote();
+    }
+    NoteTrack noteTrack = makeNoteTrack(notes, NOTES);
+    Track next = trackSetNotes(track, noteTrack);
+    noteTrackRelease(noteTrack);
+    trackRelease(track);
+    track = next;
+
+    for (int c = 0; c < CLIPS; c++) {
+      next = trackInsertClip(track, c, randomClip(t, c));
+      trackRelease(track);
+      track = next;
+    }
+    for (int l = 0; l < LANES; l++) {
+      for (int i = 0; i < POINTS; i++) {
+        points[i] = randomPoint();
+      }
+      Automation curve = makeAutomation(points, POINTS);
+      next = trackSetCurve(track, (uint32_t)l, curve);
+      automationRelease(curve);
+      trackRelease(track);
+      track = next;
+    }
+
+    Model grown = modelInsertTrack(m, t, track);
+    trackRelease(track);
+    modelRelease(m);
+    m = grown;
+  }
+  return m;
+}
+
+enum Edit { EDIT_GAIN, EDIT_CLIP, EDIT_NOTE, EDIT_CURVE, EDIT_TRACK, EDITS_ };
+
+static const char *editNames[EDITS_] = {"gain", "move clip", "add note",
+                                        "add breakpoint", "insert track"};
+
+// one edit the way the ui makes it, a new version of the whole project
+static Model edit(Model m, enum Edit kind) {
+  int index = rand() % modelTrackCount(m);
+  Track t = modelTrack(m, index), u = NULL;
+  switch (kind) {
+  case EDIT_GAIN:
+    u = trackSetMix(t, trackFlags(t), (float)rand() / RAND_MAX, trackPan(t));
+    break;
+  case EDIT_CLIP: {
+    // inserted tracks start out empty
+    if (trackClipCount(t) == 0) {
+      u = trackInsertClip(t, 0, randomClip(index, 0));
+      break;
+    }
+    int c = rand() % trackClipCount(t);
+    struct ClipState clip = trackClip(t, c);
+    clip.start += RATE;
+    u = trackSetClip(t, c, clip);
+    break;
+  }
+  case EDIT_NOTE: {
+    struct Note note = randomNote();
+    NoteTrack notes = trackNotes(t) ? noteTrackInsert(trackNotes(t), note)
+                                    : makeNoteTrack(&note, 1);
+    u = trackSetNotes(t, notes);
+    noteTrackRelease(notes);
+    break;
+  }
+  case EDIT_CURVE: {
+    uint32_t param = (uint32_t)(rand() % LANES);
+    struct Breakpoint point = randomPoint();
+    Automation curve = trackCurve(t, param)
+                           ? automationInsert(trackCurve(t, param), point)
+                           : makeAutomation(&point, 1);
+    u = trackSetCurve(t, param, curve);
+    automationRelease(curve);
+    break;
+  }
+  case EDIT_TRACK: {
+    Track added = makeTrack("New Track");
+    Model next = modelInsertTrack(m, index, added);
+    trackRelease(added);
+    return next;
+  }
+  default:
+    return NULL;
+  }
+  Model next = modelSetTrack(m, index, u);
+  trackRelease(u);
+  return next;
+}
+
+static int sameModels(Model a, Model b) {
+  if (modelTrackCount(a) != modelTrackCount(b)) {
+    return 0;
+  }
+  for (int i = 0; i < modelTrackCount(a); i++) {
+    Track x = modelTrack(a, i), y = modelTrack(b, i);
+    int ok = strcmp(trackName(x), trackName(y)) == 0 &&
+             trackFlags(x) == trackFlags(y) && trackGain(x) == trackGain(y) &&
+             trackPan(x) == trackPan(y) &&
+             trackClipCount(x) == trackClipCount(y) &&
+             trackLaneCount(x) == trackLaneCount(y) &&
+             !trackNotes(x) == !trackNotes(y);
+    for (int c = 0; c < trackClipCount(x) && ok; c++) {
+      struct ClipState p = trackClip(x, c), q = trackClip(y, c);
+      ok &= p.start == q.start && p.length == q.length &&
+            p.offset == q.offset && p.flags == q.flags &&
+            strcmp(p.source, q.source) == 0;
+    }
+    for (int l = 0; l < trackLaneCount(x) && ok; l++) {
+      Automation p = trackLane(x, l).curve, q = trackLane(y, l).curve;
+      ok &= trackLane(x, l).param == trackLane(y, l).param &&
+            automationCount(p) == automationCount(q) &&
+            memcmp(automationPoints(p), automationPoints(q),
+                   automationCount(p) * sizeof(struct Breakpoint)) == 0;
+    }
+    if (ok && trackNotes(x)) {
+      NoteTrack p = trackNotes(x), q = trackNotes(y);
+      struct NoteColumns c = noteTrackColumns(p), d = noteTrackColumns(q);
+      int n = noteTrackCount(p);
+      ok &= n == noteTrackCount(q) &&
+            memcmp(c.starts, d.starts, n * sizeof(uint64_t)) == 0 &&
+            memcmp(c.lengths, d.lengths, n * sizeof(uint32_t)) == 0 &&
+            memcmp(c.pitches, d.pitches, n) == 0;
+    }
+    if (!ok) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// undo walks back through exactly the versions committed, redo forward, a
+// commit after undoing drops the rest. and a model survives a project file
+static int checkModel(Model project) {
+  Model versions[EDITS + 1];
+  versions[0] = project;
+  History h = makeHistory(project, EDITS + 1);
+  for (int i = 1; i <= EDITS; i++) {
+    versions[i] = edit(versions[i - 1], (enum Edit)(rand() % EDITS_));
+    historyCommit(h, versions[i]);
+  }
+
+  int ok = 1;
+  for (int i = EDITS; i > 0; i--) {
+    ok &= historyCurrent(h) == versions[i] && historyUndo(h);
+  }
+  ok &= historyCurrent(h) == versions[0] && !historyUndo(h);
+  for (int i = 1; i <= EDITS / 2; i++) {
+    ok &= historyRedo(h) && historyCurrent(h) == versions[i];
+  }
+  historyCommit(h, versions[0]);
+  ok &= !historyRedo(h) && historyUndo(h) &&
+        historyCurrent(h) == versions[EDITS / 2];
+  int history = ok;
+
+  // every thread reads whole versions
+  ModelLane lane = makeModelLane(versions[0]);
+  for (int i = 1; i <= EDITS && ok; i++) {
+    modelLaneSet(lane, versions[i]);
+    ok &= modelLaneAudio(lane) == versions[i] &&
+          modelLaneDisplay(lane) == versions[i];
+    modelLaneCollect(lane);
+  }
+  freeModelLane(lane);
+  int shared = ok;
+
+  char dir[] = "/tmp/model-XXXXXX", path[64];
+  int saved = 0;
+  if (mkdtemp(dir)) {
+    snprintf(path, sizeof(path), "%s/model.dawproj", dir);
+    ProjectWriter w = makeProjectWriter(path);
+    modelSave(w, versions[EDITS]);
+    saved = projectFlush(w);
+    freeProjectWriter(w);
+    Project p = openProject(path);
+    Model loaded = p ? modelLoad(p) : NULL;
+    saved &= loaded && sameModels(loaded, versions[EDITS]);
+    modelRelease(loaded);
+    if (p) {
+      closeProject(p);
+    }
+    unlink(path);
+    rmdir(dir);
+  }
+
+  freeHistory(h);
+  for (int i = 1; i <= EDITS; i++) {
+    modelRelease(versions[i]);
+  }
+  printf("check: undo and redo through %d versions %s, lane %s, "
+         "project file %s\n",
+         EDITS, history ? "right" : "WRONG", shared ? "right" : "WRONG",
+         saved ? "right" : "WRONG");
+  return ok && saved;
+}
+
+// keeps the copies from being optimized away
+static volatile int sink;
+
+static void measure(Model project) {
+  size_t whole = modelBytes(project, NULL);
+  printf("%d tracks, %d notes, %d clips and %d curves each: %.1f MB\n",
+         TRACKS, NOTES, CLIPS, LANES, whole / 1e6);
+  printf("%16s %12s %16s\n", "edit", "us", "bytes a step");
+
+  Model versions[EDITS + 1];
+  for (int kind = 0; kind < EDITS_; kind++) {
+    versions[0] = project;
+    modelRetain(project);
+    uint64_t start = clockNanos();
+    for (int i = 1; i <= EDITS; i++) {
+      versions[i] = edit(versions[i - 1], (enum Edit)kind);
+    }
+    double micros = (clockNanos() - start) / 1e3 / EDITS;
+    size_t bytes = 0;
+    for (int i = 1; i <= EDITS; i++) {
+      bytes += modelBytes(versions[i], versions[i - 1]);
+    }
+    printf("%16s %12.2f %16.0f\n", editNames[kind], micros,
+           (double)bytes / EDITS);
+    for (int i = 0; i <= EDITS; i++) {
+      modelRelease(versions[i]);
+    }
+  }
+
+  // undo is moving a cursor
+  History h = makeHistory(project, EDITS + 1);
+  Model m = project;
+  modelRetain(m);
+  for (int i = 0; i < EDITS; i++) {
+    Model next = edit(m, (enum Edit)(rand() % EDITS_));
+    historyCommit(h, next);
+    modelRelease(m);
+    m = next;
+  }
+  modelRelease(m);
+  uint64_t start = clockNanos();
+  for (int round = 0; round < 100; round++) {
+    while (historyUndo(h)) {
+      sink += modelTrackCount(historyCurrent(h));
+    }
+    while (historyRedo(h)) {
+      sink += modelTrackCount(historyCurrent(h));
+    }
+  }
+  printf("%16s %12.3f\n", "undo or redo",
+         (clockNanos() - start) / 1e3 / (200.0 * EDITS));
+  freeHistory(h);
+
+  // a copying undo stores the whole project a step, at least a memcpy of it
+  char *from = malloc(whole), *to = malloc(whole);
+  memset(from, 1, whole);
+  memset(to, 0, whole);
+  start = clockNanos();
+  for (int i = 0; i < 10; i++) {
+    memcpy(to, from, whole);
+    sink += to[i];
+  }
+  printf("%16s %12.2f %16zu\n", "full copy", (clockNanos() - start) / 1e4,
+         whole);
+  free(from);
+  free(to);
+}
+
+int main(void) {
+  dspInit();
+  srand(1);
+  Model project = makeProject();
+  int ok = checkVectors() && checkModel(project);
+  if (ok) {
+    measure(project);
+  }
+  modelRelease(project);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,183 @@
+// waveform overviews: every level of every file has to match a brute force
+// min/max of its samples, a long file has to show its coarse levels well
+// before it's done, a visible file queued last has to jump the batch, and
+// removing files mid-job must be safe. then how fast a batch goes through on
+// one worker and on several
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "overview.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define FILES 32
+#define BATCH_SECONDS 20
+#define LONG_SECONDS 600
+#define WORKERS 4
+
+// polls without spinning, the workers run at idle priority and a spinning
+// thread would starve them
+static void nap(void) {
+  struct timespec t = {0, 100000};
+  nanosleep(&t, NULL);
+}
+
+static int writeFile(const char *path, int channels, uint64_t frames,
+                     unsigned seed) {
+  AudioWriter w = openWavWriter(path, channels, SAMPLE_RATE, SAMPLE_INT16);
+  if (!w) {
+    return 0;
+  }
+  float buffer[4096 * 2];
+  int ok = 1;
+  for (uint64_t at = 0; at < frames && ok; at += 4096) {
+    int n = frames - at < 4096 ? (int)(frames - at) : 4096;
+    for (int i = 0; i < n * channels; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      // louder towards the end, so the levels differ from bin to bin
+      float envelope = (float)(at + i / channels) / frames;
+      buffer[i] = ((float)(seed >> 8) / (float)(1 << 24) - 0.5f) * envelope;
+    }
+    ok = writeAudioFile(w, buffer, n);
+  }
+  return closeAudioWriter(w) && ok;
+}
+
+// every level against a min/max straight from the file
+static int matchesFile(Overview v, const char *path) {
+  AudioFile f = openAudioFile(path);
+  struct AudioFormat format = audioFileFormat(f);
+  float *samples = malloc(format.frames * format.channels * sizeof(float));
+  readAudioFile(f, 0, samples, (int)format.frames);
+  closeAudioFile(f);
+
+  int ok = overviewDone(v) && overviewReadyLevel(v) == 0 &&
+           overviewBinCount(v, overviewLevelCount(v) - 1) == 1;
+  struct Peak *bins = malloc(overviewBinCount(v, 0) * sizeof(struct Peak));
+  for (int l = 0; l < overviewLevelCount(v) && ok; l++) {
+    uint64_t binFrames = overviewBinFrames(l);
+    for (int ch = 0; ch < format.channels; ch++) {
+      int n = overviewRead(v, l, ch, 0, (int)overviewBinCount(v, l), bins);
+      ok &= n == (int)overviewBinCount(v, l);
+      for (int b = 0; b < n && ok; b++) {
+        struct Peak expect = {1e9f, -1e9f};
+        uint64_t end = (b + 1) * binFrames;
+        end = end < format.frames ? end : format.frames;
+        for (uint64_t i = b * binFrames; i < end; i++) {
+          float x = samples[i * format.channels + ch];
+          expect.min = x < expect.min ? x : expect.min;
+          expect.max = x > expect.max ? x : expect.max;
+        }
+        ok &= bins[b].min == expect.min && bins[b].max == expect.max;
+      }
+    }
+  }
+  free(bins);
+  free(samples);
+  return ok;
+}
+
+static double runBatch(char (*paths)[64], int workers) {
+  Overviews o = makeOverviews(workers);
+  uint64_t start = clockNanos();
+  for (int f = 0; f < FILES; f++) {
+    overviewsAdd(o, paths[f]);
+  }
+  overviewsWait(o);
+  double seconds = (clockNanos() - start) / 1e9;
+  freeOverviews(o);
+  return seconds;
+}
+
+int main(void) {
+  char dir[] = "/tmp/overview-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char paths[FILES][64], longPath[64];
+  int failed = 0;
+  for (int f = 0; f < FILES; f++) {
+    snprintf(paths[f], sizeof(paths[f]), "%s/take%02d.wav", dir, f);
+    // odd lengths, some shorter than a span
+    uint64_t frames = f % 8 == 0 ? 1000 + f : BATCH_SECONDS * SAMPLE_RATE + f;
+    failed |= !writeFile(paths[f], 1 + f % 2, frames, f + 1);
+  }
+  snprintf(longPath, sizeof(longPath), "%s/long.wav", dir);
+  failed |= !writeFile(longPath, 2, LONG_SECONDS * SAMPLE_RATE, 99);
+
+  // the batch on one worker, the last one visible
+  Overviews o = makeOverviews(1);
+  Overview views[FILES];
+  uint64_t start = clockNanos(), visibleAt = 0;
+  for (int f = 0; f < FILES; f++) {
+    views[f] = overviewsAdd(o, paths[f]);
+  }
+  overviewsSetVisible(o, views[FILES - 1], 1);
+  while (!overviewDone(views[FILES - 1])) {
+    nap();
+  }
+  visibleAt = clockNanos() - start;
+  overviewsWait(o);
+  uint64_t all = clockNanos() - start;
+  int matching = 1;
+  for (int f = 0; f < FILES; f++) {
+    matching &= matchesFile(views[f], paths[f]);
+  }
+  printf("batch of %d: visible one done after %.1f ms of %.1f ms\n", FILES,
+         visibleAt / 1e6, all / 1e6);
+  printf("every level matches the samples: %s\n", matching ? "yes" : "no");
+  failed |= !matching || visibleAt * 4 > all;
+
+  // a long file, watched as it fills in
+  start = clockNanos();
+  Overview v = overviewsAdd(o, longPath);
+  int levels = overviewLevelCount(v), coarsest = levels;
+  uint64_t coarseAt = 0;
+  while (!overviewDone(v)) {
+    int ready = overviewReadyLevel(v);
+    if (ready < levels && !coarseAt) {
+      coarseAt = clockNanos() - start;
+      coarsest = ready;
+    }
+    nap();
+  }
+  uint64_t doneAt = clockNanos() - start;
+  int progressive = coarseAt && coarseAt * 4 < doneAt &&
+                    coarsest > 0 && matchesFile(v, longPath);
+  printf("%d s file: level %d of %d ready after %.1f ms, done after %.1f ms\n",
+         LONG_SECONDS, coarsest, levels, coarseAt / 1e6, doneAt / 1e6);
+  failed |= !progressive;
+
+  // removed while being worked on, and while still queued
+  freeOverviews(o);
+  o = makeOverviews(WORKERS);
+  for (int f = 0; f < FILES; f++) {
+    views[f] = overviewsAdd(o, paths[f]);
+  }
+  v = overviewsAdd(o, longPath);
+  while (overviewVersion(v) == 0 && overviewVersion(views[0]) == 0) {
+    nap();
+  }
+  for (int f = 0; f < FILES; f++) {
+    overviewsRemove(o, views[f]);
+  }
+  overviewsRemove(o, v);
+  overviewsWait(o);
+  freeOverviews(o);
+  printf("removal mid-job: ok\n");
+
+  double one = runBatch(paths, 1), several = runBatch(paths, WORKERS);
+  printf("batch: %.1f ms on one worker, %.1f ms on %d (%.1fx)\n", one * 1e3,
+         several * 1e3, WORKERS, one / several);
+
+  for (int f = 0; f < FILES; f++) {
+    unlink(paths[f]);
+  }
+  unlink(longPath);
+  rmdir(dir);
+  return failed;
+}
@@ -0,0 +1,236 @@
+// audio path profiling: what recording every block and node costs the audio
+// thread, then a session where one node now and then stalls past the block
+// deadline. every such xrun has to be caught and pinned on that node, the
+// histograms have to show the tail, and the traces have to come out
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "engine.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define TRACKS 64
+#define BLOCKS 3000
+#define SPIKE_EVERY 1000 // blocks
+#define SPIKE_LOAD 1.5   // of the deadline
+#define HISTORY 64
+#define COLLECT_EVERY 3 // blocks, about once a display frame
+
+struct Filter {
+  float z[4];
+};
+
+// a stall in the blocks whose position comes round to it
+struct Spike {
+  uint64_t nanos;
+  int blocks;
+};
+
+static void noise(void *state, const struct ProcessContext *ctx) {
+  unsigned *s = state;
+  for (int i = 0; i < ctx->frames; i++) {
+    *s = *s * 1664525u + 1013904223u;
+    ctx->outputs[0][i] = (float)(*s >> 8) / (float)(1 << 24) - 0.5f;
+  }
+}
+
+static void filter(void *state, const struct ProcessContext *ctx) {
+  struct Filter *f = state;
+  for (int i = 0; i < ctx->frames; i++) {
+    float x = ctx->inputs[0][i];
+    for (int s = 0; s < 4; s++) {
+      f->z[s] += 0.1f * (x - f->z[s]);
+      x = f->z[s];
+    }
+    ctx->outputs[0][i] = x;
+  }
+}
+
+static void spike(void *state, const struct ProcessContext *ctx) {
+  struct Spike *s = state;
+  memcpy(ctx->outputs[0], ctx->inputs[0], ctx->frames * sizeof(float));
+  if (s->nanos && ctx->position / BLOCK % SPIKE_EVERY == SPIKE_EVERY / 2) {
+    uint64_t until = clockNanos() + s->nanos;
+    while (clockNanos() < until) {
+    }
+    s->blocks++;
+  }
+}
+
+static void mix(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  memcpy(ctx->outputs[0], ctx->inputs[0], ctx->frames * sizeof(float));
+}
+
+// tracks of noise through a filter into the master, the spike on the first
+static Graph makeSession(unsigned *seeds, struct Filter *filters,
+                         struct Spike *s, int *master, int *spiked) {
+  Graph g = makeGraph();
+  *master = graphAddNode(g, (struct NodeDescription){
+                                .name = "master",
+                                .inputs = 1,
+                                .outputs = 1,
+                                .process = mix,
+                            });
+  for (int t = 0; t < TRACKS; t++) {
+    seeds[t] = t + 1;
+    int source = graphAddNode(g, (struct NodeDescription){
+                                     .name = "noise",
+                                     .outputs = 1,
+                                     .process = noise,
+                                     .state = &seeds[t],
+                                 });
+    int last = graphAddNode(g, (struct NodeDescription){
+                                   .name = "filter \"lowpass\"",
+                                   .inputs = 1,
+                                   .outputs = 1,
+                                   .process = filter,
+                                   .state = &filters[t],
+                               });
+    graphConnect(g, source, 0, last, 0);
+    if (t == 0) {
+      *spiked = graphAddNode(g, (struct NodeDescription){
+                                    .name = "spike",
+                                    .inputs = 1,
+                                    .outputs = 1,
+                                    .process = spike,
+                                    .state = s,
+                                });
+      graphConnect(g, last, 0, *spiked, 0);
+      last = *spiked;
+    }
+    graphConnect(g, last, 0, *master, 0);
+  }
+  return g;
+}
+
+static int compare(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// the median engineProcess, with or without a profiler
+static double blockMicros(Graph g, int master, Profiler p, int blocks) {
+  Engine e = makeEngine(SAMPLE_RATE, BLOCK, 1, graphNodeCount(g));
+  engineSetGraph(e, compileGraph(g, BLOCK), master);
+  engineSetProfiler(e, p);
+  sendCommand(engineQueues(e), (struct Command){
+                                   .type = COMMAND_TRANSPORT,
+                                   .transport = {.action = TRANSPORT_PLAY},
+                               });
+
+  float left[BLOCK];
+  float *out[] = {left};
+  uint64_t *nanos = malloc(blocks * sizeof(uint64_t));
+  for (int b = 0; b < blocks; b++) {
+    uint64_t start = clockNanos();
+    engineProcess(e, out, 1, BLOCK);
+    nanos[b] = clockNanos() - start;
+    if (p && b % COLLECT_EVERY == 0) {
+      profilerCollect(p);
+    }
+  }
+  if (p) {
+    profilerCollect(p);
+  }
+  freeEngine(e);
+
+  qsort(nanos, blocks, sizeof(uint64_t), compare);
+  double median = nanos[blocks / 2] / 1e3;
+  free(nanos);
+  return median;
+}
+
+static int fileLooksLikeTrace(const char *path, const char *expect) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return 0;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  char *text = malloc(size + 1);
+  text[fread(text, 1, size, f)] = 0;
+  fclose(f);
+  int ok = strncmp(text, "{\"displayTimeUnit\"", 18) == 0 &&
+           strstr(text, expect) && strstr(text, "]}\n");
+  free(text);
+  return ok;
+}
+
+int main(void) {
+  dspInit();
+
+  unsigned seeds[TRACKS];
+  struct Filter filters[TRACKS];
+  memset(filters, 0, sizeof(filters));
+  uint64_t deadline = (uint64_t)BLOCK * 1000000000 / SAMPLE_RATE;
+  struct Spike s = {0, 0};
+  int master, spiked;
+  Graph g = makeSession(seeds, filters, &s, &master, &spiked);
+  int nodes = graphNodeCount(g);
+
+  // the spike is off while measuring what profiling costs
+  double bare = blockMicros(g, master, NULL, BLOCKS);
+  Profiler p = makeProfiler(nodes, HISTORY);
+  double profiled = blockMicros(g, master, p, BLOCKS);
+  freeProfiler(p);
+  printf("%d nodes, %d frame blocks: %.1f us bare, %.1f us profiled\n", nodes,
+         BLOCK, bare, profiled);
+
+  s.nanos = (uint64_t)(deadline * SPIKE_LOAD);
+  p = makeProfiler(nodes, HISTORY);
+  CompiledGraph named = compileGraph(g, BLOCK);
+  profilerNameNodes(p, named);
+  freeCompiledGraph(named);
+  blockMicros(g, master, p, BLOCKS);
+
+  struct ProfileStats block = profilerBlockStats(p);
+  struct ProfileStats node = profilerNodeStats(p, spiked);
+  printf("block vs %.0f us deadline: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+         deadline / 1e3, block.p50 / 1e3, block.p99 / 1e3, block.max / 1e3);
+  printf("spiking node: p50 %.1f us, max %.1f us\n", node.p50 / 1e3,
+         node.max / 1e3);
+
+  // other xruns can happen on a busy machine, the spikes must be among them
+  int caught = 0, blamed = 0;
+  for (int i = 0; i < profilerXrunCount(p); i++) {
+    struct ProfileXrun x = profilerXrun(p, i);
+    if (x.block.position / BLOCK % SPIKE_EVERY == SPIKE_EVERY / 2) {
+      caught++;
+      blamed += x.culprit == spiked;
+    }
+  }
+  printf("xruns: %llu seen, %d of %d spikes caught, %d blamed on the spike\n",
+         (unsigned long long)profilerXrunTotal(p), caught, s.blocks, blamed);
+  int failed = caught != s.blocks || blamed != caught ||
+               block.max <= deadline || node.max < s.nanos ||
+               profilerDropped(p) != 0;
+
+  char dir[] = "/tmp/profiler-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char history[64], xrun[64];
+  snprintf(history, sizeof(history), "%s/history.json", dir);
+  snprintf(xrun, sizeof(xrun), "%s/xrun.json", dir);
+  int traced = profilerWriteTrace(p, history) &&
+               profilerWriteXrunTrace(p, profilerXrunCount(p) - 1, xrun) &&
+               fileLooksLikeTrace(history, "filter \\\"lowpass\\\"") &&
+               fileLooksLikeTrace(xrun, "\"name\":\"xrun\"");
+  printf("traces: %s\n", traced ? "written" : "broken");
+  failed |= !traced;
+  unlink(history);
+  unlink(xrun);
+  rmdir(dir);
+
+  freeProfiler(p);
+  freeGraph(g);
+  return failed;
+}
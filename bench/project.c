@@ -0,0 +1,379 @@
+// project files: a full save and an incremental one of a 200 track session,
+// how long the ui thread is held up, how long opening takes, and that a save
+// cut short, a torn header or a damaged root leaves the previous save to
+// open
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "project.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RATE 48000
+#define TRACKS 200
+#define NOTES 2000 // a track
+#define LANES 4
+#define POINTS 200 // a curve
+#define CLIPS 8
+#define MINUTES 10
+#define OPENS 100
+
+struct Session {
+  struct TrackState tracks[TRACKS];
+  struct LaneState lanes[TRACKS][LANES];
+  struct ClipState clips[TRACKS][CLIPS];
+  char names[TRACKS][32];
+  char sources[TRACKS][CLIPS][48];
+};
+
+static uint64_t randomPosition(void) {
+  return (uint64_t)((double)rand() / RAND_MAX * MINUTES * 60 * RATE);
+}
+
+static struct Note randomNote(void) {
+  return (struct Note){
+      .start = randomPosition(),
+      .length = 1000 + rand() % 24000,
+      .pitch = (uint8_t)(24 + rand() % 85),
+      .velocity = (uint8_t)(1 + rand() % 127),
+  };
+}
+
+static Automation randomCurve(void) {
+  struct Breakpoint points[POINTS];
+  for (int i = 0; i < POINTS; i++) {
+    points[i] = (struct Breakpoint){
+        .position = randomPosition(),
+        .value = (float)rand() / RAND_MAX,
+        .shape = (uint32_t)(rand() % 4),
+        .control = {0.25f, 0.75f},
+    };
+  }
+  return makeAutomation(points, POINTS);
+}
+
+static void makeSession(struct Session *s) {
+  struct Note *notes = malloc(NOTES * sizeof(struct Note));
+  for (int t = 0; t < TRACKS; t++) {
+    for (int i = 0; i < NOTES; i++) {
+      notes[i] = randomNote();
+    }
+    for (int l = 0; l < LANES; l++) {
+      s->lanes[t][l] = (struct LaneState){(uint32_t)l, randomCurve()};
+    }
+    for (int c = 0; c < CLIPS; c++) {
+      snprintf(s->sources[t][c], sizeof(s->sources[t][c]),
+               "audio/track%03d-take%d.wav", t, c);
+      s->clips[t][c] = (struct ClipState){randomPosition(), 10 * RATE,
+                                          (uint64_t)(rand() % RATE),
+                                          s->sources[t][c], 0};
+    }
+    snprintf(s->names[t], sizeof(s->names[t]), "Track %d", t + 1);
+    s->tracks[t] = (struct TrackState){
+        .name = s->names[t],
+        .flags = t % 7 == 0 ? PROJECT_TRACK_MUTED : 0,
+        .gain = 0.5f + (float)t / TRACKS,
+        .pan = (float)(t % 5 - 2) / 2,
+        .notes = makeNoteTrack(notes, NOTES),
+        .lanes = s->lanes[t],
+        .laneCount = LANES,
+        .clips = s->clips[t],
+        .clipCount = CLIPS,
+    };
+  }
+  free(notes);
+}
+
+static void freeSession(struct Session *s) {
+  for (int t = 0; t < TRACKS; t++) {
+    noteTrackRelease(s->tracks[t].notes);
+    for (int l = 0; l < LANES; l++) {
+      automationRelease(s->lanes[t][l].curve);
+    }
+  }
+}
+
+static struct ProjectState state(const struct Session *s) {
+  return (struct ProjectState){RATE, s->tracks, TRACKS};
+}
+
+// one more note and one curve redrawn, like an edit in the ui
+static void edit(struct Session *s, int t) {
+  NoteTrack notes = noteTrackInsert(s->tracks[t].notes, randomNote());
+  noteTrackRelease(s->tracks[t].notes);
+  s->tracks[t].notes = notes;
+  automationRelease(s->lanes[t][0].curve);
+  s->lanes[t][0].curve = randomCurve();
+}
+
+static int sameNotes(Project p, const struct ProjectTrack *track,
+                     NoteTrack notes) {
+  struct NoteColumns x, y = noteTrackColumns(notes);
+  int n = projectNotes(p, track, &x);
+  return n == noteTrackCount(notes) &&
+         memcmp(x.starts, y.starts, n * sizeof(uint64_t)) == 0 &&
+         memcmp(x.lengths, y.lengths, n * sizeof(uint32_t)) == 0 &&
+         memcmp(x.pitches, y.pitches, n) == 0 &&
+         memcmp(x.velocities, y.velocities, n) == 0;
+}
+
+static int sameTrack(Project p, const struct ProjectTrack *track,
+                     const struct TrackState *t) {
+  int ok = strcmp(projectString(p, track->name), t->name) == 0 &&
+           track->flags == t->flags && track->gain == t->gain &&
+           track->pan == t->pan && sameNotes(p, track, t->notes);
+
+  int lanes, points;
+  const struct ProjectLane *lane = projectLanes(p, track, &lanes);
+  ok &= lanes == t->laneCount;
+  for (int l = 0; l < lanes && ok; l++) {
+    Automation curve = t->lanes[l].curve;
+    const struct Breakpoint *saved = projectCurve(p, lane[l].curve, &points);
+    ok &= lane[l].param == t->lanes[l].param &&
+          points == automationCount(curve) &&
+          memcmp(saved, automationPoints(curve),
+                 points * sizeof(struct Breakpoint)) == 0;
+  }
+
+  int clips;
+  const struct ProjectClip *clip = projectClips(p, track, &clips);
+  ok &= clips == t->clipCount;
+  for (int c = 0; c < clips && ok; c++) {
+    const struct ClipState *expected = &t->clips[c];
+    ok &= clip[c].start == expected->start &&
+          clip[c].length == expected->length &&
+          clip[c].offset == expected->offset &&
+          clip[c].flags == expected->flags &&
+          strcmp(projectString(p, clip[c].source), expected->source) == 0;
+  }
+  return ok;
+}
+
+static int matches(const char *path, const struct Session *s) {
+  Project p = openProject(path);
+  if (!p) {
+    return 0;
+  }
+  int ok = projectSampleRate(p) == RATE && projectTrackCount(p) == TRACKS;
+  for (int t = 0; t < TRACKS && ok; t++) {
+    ok &= sameTrack(p, projectTrack(p, t), &s->tracks[t]);
+  }
+  closeProject(p);
+  return ok;
+}
+
+static off_t fileSize(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+// the two header slots, read or written back
+static int headers(const char *path, char *slots, int write) {
+  int fd = open(path, O_RDWR);
+  ssize_t n = write ? pwrite(fd, slots, 128, 0) : pread(fd, slots, 128, 0);
+  close(fd);
+  return n == 128;
+}
+
+// flips the lowest bit of the byte at `offset`
+static int flip(const char *path, uint64_t offset) {
+  int fd = open(path, O_RDWR);
+  unsigned char byte;
+  int ok = pread(fd, &byte, 1, (off_t)offset) == 1;
+  byte ^= 1;
+  ok &= pwrite(fd, &byte, 1, (off_t)offset) == 1;
+  close(fd);
+  return ok;
+}
+
+// saves survive a crash: appended chunks with no header pointing at them,
+// and a header torn half way, both leave the save before, as does a root
+// damaged after the fact. a writer carrying on writes damaged chunks again
+// rather than reuse them
+static int checkCrashes(const char *path, struct Session *s) {
+  ProjectWriter w = makeProjectWriter(path);
+  projectSave(w, state(s));
+  int ok = projectFlush(w);
+  char before[128], after[128];
+  ok &= headers(path, before, 0);
+  off_t saved = fileSize(path);
+
+  NoteTrack kept = s->tracks[3].notes;
+  noteTrackRetain(kept);
+  Automation keptCurve = s->lanes[3][0].curve;
+  automationRetain(keptCurve);
+  edit(s, 3);
+  projectSave(w, state(s));
+  ok &= projectFlush(w);
+  freeProjectWriter(w);
+  ok &= headers(path, after, 0);
+  off_t grown = fileSize(path);
+
+  // the new save's root, damaged under an intact header
+  NoteTrack edited = s->tracks[3].notes;
+  Automation editedCurve = s->lanes[3][0].curve;
+  s->tracks[3].notes = kept;
+  s->lanes[3][0].curve = keptCurve;
+  int slot = memcmp(before, after, 64) != 0 ? 0 : 1;
+  uint64_t root;
+  memcpy(&root, after + 64 * slot + 24, sizeof(root));
+  ok &= flip(path, root + 24);
+  int damaged = matches(path, s);
+  ok &= flip(path, root + 24);
+
+  // the new save's header, torn
+  after[64 * slot + 40] ^= 1;
+  ok &= headers(path, after, 1);
+  int torn = matches(path, s);
+
+  // the new save's chunks half written, its header never
+  ok &= headers(path, before, 1);
+  ok &= truncate(path, saved + (grown - saved) / 2) == 0;
+  int cut = matches(path, s);
+
+  // and the writer carries on from the intact save, one of whose note
+  // tracks the new save keeps has since been damaged
+  Project p = openProject(path);
+  uint64_t notes = p ? projectTrack(p, 5)->notes : 0;
+  if (p) {
+    closeProject(p);
+  }
+  ok &= notes && flip(path, notes + 24 + 8);
+  s->tracks[3].notes = edited;
+  s->lanes[3][0].curve = editedCurve;
+  w = makeProjectWriter(path);
+  projectSave(w, state(s));
+  ok &= projectFlush(w);
+  freeProjectWriter(w);
+  int resumed = matches(path, s);
+
+  noteTrackRelease(kept);
+  automationRelease(keptCurve);
+  printf("check: damaged root %s, torn header %s, cut save %s, saving after "
+         "%s\n",
+         damaged ? "recovered" : "LOST", torn ? "recovered" : "LOST",
+         cut ? "recovered" : "LOST", resumed ? "right" : "WRONG");
+  return ok && damaged && torn && cut && resumed;
+}
+
+// edits until the dead chunks set off a compaction
+static int checkCompaction(const char *path, struct Session *s) {
+  ProjectWriter w = makeProjectWriter(path);
+  off_t largest = 0, size = 0;
+  int ok = 1, saves = 0;
+  do {
+    for (int t = 0; t < TRACKS; t += 10) {
+      edit(s, (t + saves) % TRACKS);
+    }
+    projectSave(w, state(s));
+    ok &= projectFlush(w);
+    size = fileSize(path);
+    largest = size > largest ? size : largest;
+    saves++;
+  } while (ok && size == largest && saves < 1000);
+  freeProjectWriter(w);
+
+  int right = matches(path, s);
+  printf("check: compacted after %d saves, %.1f MB to %.1f MB, contents %s\n",
+         saves, largest / 1e6, size / 1e6, right ? "right" : "WRONG");
+  return ok && size < largest && right;
+}
+
+static int compareDoubles(const void *x, const void *y) {
+  double a = *(const double *)x, b = *(const double *)y;
+  return a < b ? -1 : a > b;
+}
+
+int main(void) {
+  dspInit();
+  srand(1);
+
+  char dir[] = "/tmp/project-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "%s/session.dawproj", dir);
+
+  struct Session *s = malloc(sizeof(struct Session));
+  makeSession(s);
+  printf("%d tracks, %d notes and %d curves each\n", TRACKS, NOTES, LANES);
+
+  // first save, everything is new
+  ProjectWriter w = makeProjectWriter(path);
+  uint64_t start = clockNanos();
+  projectSave(w, state(s));
+  double held = (clockNanos() - start) / 1e3;
+  int ok = projectFlush(w);
+  double total = (clockNanos() - start) / 1e6;
+  printf("  full save   %8.1f us on the ui thread, %6.1f ms to disk, "
+         "%.1f MB\n",
+         held, total, projectLastSaveBytes(w) / 1e6);
+
+  // an edit only appends what changed
+  edit(s, 0);
+  start = clockNanos();
+  projectSave(w, state(s));
+  held = (clockNanos() - start) / 1e3;
+  ok &= projectFlush(w);
+  total = (clockNanos() - start) / 1e6;
+  printf("  after edit  %8.1f us on the ui thread, %6.1f ms to disk, "
+         "%.1f kB\n",
+         held, total, projectLastSaveBytes(w) / 1e3);
+
+  // autosaving faster than the disk keeps up never waits on it. on a single
+  // core the worst call includes the writer thread's time slice
+  double calls[100];
+  for (int i = 0; i < 100; i++) {
+    edit(s, rand() % TRACKS);
+    start = clockNanos();
+    projectSave(w, state(s));
+    calls[i] = (double)(clockNanos() - start);
+  }
+  ok &= projectFlush(w);
+  qsort(calls, 100, sizeof(double), compareDoubles);
+  printf("  autosave    %8.1f us median, %.1f us worst of 100 back to back\n",
+         calls[50] / 1e3, calls[99] / 1e3);
+  freeProjectWriter(w);
+
+  start = clockNanos();
+  int names = 0;
+  for (int i = 0; i < OPENS; i++) {
+    Project p = openProject(path);
+    for (int t = 0; t < projectTrackCount(p); t++) {
+      names += (int)strlen(projectString(p, projectTrack(p, t)->name));
+    }
+    closeProject(p);
+  }
+  printf("  open        %8.1f us\n", (clockNanos() - start) / 1e3 / OPENS);
+
+  // everything loaded back into live tracks and curves
+  Project p = openProject(path);
+  start = clockNanos();
+  for (int t = 0; t < TRACKS; t++) {
+    const struct ProjectTrack *track = projectTrack(p, t);
+    noteTrackRelease(projectLoadNotes(p, track));
+    int lanes;
+    const struct ProjectLane *lane = projectLanes(p, track, &lanes);
+    for (int l = 0; l < lanes; l++) {
+      automationRelease(projectLoadCurve(p, lane[l].curve));
+    }
+  }
+  printf("  load all    %8.1f ms\n", (clockNanos() - start) / 1e6);
+  closeProject(p);
+
+  int right = ok && names > 0 && matches(path, s);
+  printf("check: contents %s\n", right ? "right" : "WRONG");
+  ok = right && checkCrashes(path, s) && checkCompaction(path, s);
+
+  unlink(path);
+  rmdir(dir);
+  freeSession(s);
+  free(s);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
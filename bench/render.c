@@ -0,0 +1,622 @@
+// the renderer without a window or a swapchain: the ui drawn into an
+// offscreen image, meant for lavapipe so the numbers come from the cpu and
+// not whatever gpu the machine has (make bench-render points the loader at
+// it). measures rebuilding and uploading the draw list, recording a frame's
+// command buffer on its own, and whole frames submitted and waited for, then
+// whole frames with every layer the daw has drawn over the ui from live
+// sources. a frame is read back first to check it drew anything, and each
+// layer has to change the pixels of its own rectangle. results go to the json
+// file named on the command line, if any, for bench-compare
+#include "automationlayer.h"
+#include "clock.h"
+#include "drawlist.h"
+#include "dsp.h"
+#include "meterlayer.h"
+#include "pianorolllayer.h"
+#include "profilerlayer.h"
+#include "scheduler.h"
+#include "spectrumlayer.h"
+#include "stats.h"
+#include "vk.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define RECTS 1000
+#define TRIANGLE_EVERY 8
+#define TRIANGLES ((RECTS + TRIANGLE_EVERY - 1) / TRIANGLE_EVERY)
+#define MAX_VERTICES (6 * RECTS + 3 * TRIANGLES)
+#define MAX_LAYERS 8
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define METERS 16
+#define SPECTRA 2
+#define FFT_SIZE 4096
+#define OVERLAP 4
+#define VIEW_SECONDS 4
+#define NOTES 64
+#define LOW_PITCH 48
+#define HIGH_PITCH 84
+#define HISTORY 256
+
+// bgra, what the clear and the shader leave behind
+#define WHITE 0xffffffffu
+#define BLACK 0xff000000u
+
+struct Headless {
+  // vulkan
+  VkInstance instance;
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkQueue queue;
+  struct SwapchainSettings settings;
+
+  // target
+  struct ImageAndMemory target;
+  VkImageView *view;
+  VkFramebuffer *framebuffer;
+
+  // pipeline
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkRenderPass renderPass;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+
+  // commands
+  VkCommandPool commandPool;
+  VkCommandBuffer commandBuffer;
+  VkFence fence;
+
+  // ui, rebuilt into a mapped vertex buffer
+  DrawList ui;
+  struct VertexBufferAndMemory vertices;
+  struct Vertex *mapped;
+  int vertexCount;
+
+  // layers over the ui, drawn while `layered`, each over its own rectangle
+  struct Layer layers[MAX_LAYERS];
+  const char *names[MAX_LAYERS];
+  float rects[MAX_LAYERS][4];
+  int layerCount;
+  int layered;
+  double time; // seconds, a frame further on every frame
+
+  // what they show. a block of a graph runs before every frame: a tone,
+  // louder on every channel, through a meter and a spectrum tap
+  Graph graph;
+  CompiledGraph compiled;
+  Scheduler scheduler;
+  Meters meters;
+  struct MeterTap meterTap;
+  Spectrum spectrum;
+  struct SpectrumTap spectrumTap;
+  Profiler profiler;
+  AutomationLane automation;
+  NoteLane notes;
+  struct TimelineView timeline;
+  uint64_t position;
+};
+
+static void makeHeadless(struct Headless *h) {
+  h->instance = makeVkHeadlessInstance("bench-render");
+  h->physicalDevice = pickVkPhysicalDevice(h->instance);
+  int queueFamilyIndex = findVkGraphicsQueueFamilyIndex(h->physicalDevice);
+  h->device = makeVkHeadlessDevice(h->physicalDevice, queueFamilyIndex);
+  vkGetDeviceQueue(h->device, queueFamilyIndex, 0, &h->queue);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(h->physicalDevice, &properties);
+  printf("device: %s\n", properties.deviceName);
+
+  // one image stands in for the swapchain
+  h->settings = (struct SwapchainSettings){0};
+  h->settings.imageCount = 1;
+  h->settings.selectedFormat.format = VK_FORMAT_B8G8R8A8_UNORM;
+  h->settings.selectedFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+  h->settings.selectedExtent.width = WIDTH;
+  h->settings.selectedExtent.height = HEIGHT;
+
+  h->renderPass = makeVkOffscreenRenderPass(h->device, h->settings);
+  h->target = makeVkColorImage(h->physicalDevice, h->device, h->settings);
+  h->view = makeVkImageViews(h->device, h->settings, &h->target.image);
+  h->framebuffer =
+      makeVkFramebuffers(h->device, h->settings, h->view, h->renderPass);
+
+  h->vertShader = makeVkShaderModule(h->device, "bin/vert.spv");
+  h->fragShader = makeVkShaderModule(h->device, "bin/frag.spv");
+  h->pipelineLayout = makeVkPipelineLayout(h->device);
+  h->pipeline = makeVkPipeline(h->device, h->settings, h->vertShader,
+                               h->fragShader, h->renderPass,
+                               h->pipelineLayout);
+
+  h->commandPool = makeVkCommandPool(h->device, queueFamilyIndex);
+  h->commandBuffer = makeVkCommandBuffer(h->device, h->commandPool);
+  VkFenceCreateInfo fenceInfo = {0};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(h->device, &fenceInfo, NULL, &h->fence) != VK_SUCCESS) {
+    fprintf(stderr, "can't create a fence\n");
+    exit(1);
+  }
+
+  VkDeviceSize size = MAX_VERTICES * sizeof(struct Vertex);
+  h->ui = makeDrawList(MAX_VERTICES);
+  h->vertices = makeVkHostBuffer(h->physicalDevice, h->device, size,
+                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  vkMapMemory(h->device, h->vertices.memory, 0, size, 0,
+              (void **)&h->mapped);
+  h->vertexCount = 0;
+}
+
+static void addLayer(struct Headless *h, const char *name, float x, float y,
+                     float width, float height,
+                     struct Layer (*make)(struct Headless *h, float x, float y,
+                                          float width, float height)) {
+  h->names[h->layerCount] = name;
+  h->rects[h->layerCount][0] = x;
+  h->rects[h->layerCount][1] = y;
+  h->rects[h->layerCount][2] = width;
+  h->rects[h->layerCount][3] = height;
+  h->layers[h->layerCount++] = make(h, x, y, width, height);
+}
+
+static struct RenderContext context(struct Headless *h) {
+  return (struct RenderContext){
+      .physicalDevice = h->physicalDevice,
+      .device = h->device,
+      .renderPass = h->renderPass,
+      .swapchainSettings = h->settings,
+      .framesInFlight = 1,
+  };
+}
+
+static struct Layer meterLayer(struct Headless *h, float x, float y,
+                               float width, float height) {
+  return makeMeterLayer(context(h), h->meters, x, y, width, height);
+}
+
+static struct Layer spectrumLayer(struct Headless *h, float x, float y,
+                                  float width, float height) {
+  return makeSpectrumLayer(context(h), h->spectrum, x, y, width, height);
+}
+
+static struct Layer automationLayer(struct Headless *h, float x, float y,
+                                    float width, float height) {
+  return makeAutomationLayer(context(h), h->automation, &h->timeline, 0, 1,
+                             x, y, width, height);
+}
+
+// a breakpoint every half second, every shape in turn
+static Automation makeCurve(void) {
+  struct Breakpoint points[2 * VIEW_SECONDS + 1];
+  int count = sizeof(points) / sizeof(*points);
+  for (int i = 0; i < count; i++) {
+    points[i] = (struct Breakpoint){
+        .position = (uint64_t)i * SAMPLE_RATE / 2,
+        .value = i % 2 ? 0.9f : 0.1f,
+        .shape = (uint32_t)(i % (AUTOMATION_BEZIER + 1)),
+        .control = {0.8f, 0.2f},
+    };
+  }
+  return makeAutomation(points, count);
+}
+
+static struct Layer pianoRollLayer(struct Headless *h, float x, float y,
+                                   float width, float height) {
+  return makePianoRollLayer(context(h), h->notes, &h->timeline, LOW_PITCH,
+                            HIGH_PITCH, x, y, width, height);
+}
+
+static struct Layer profilerLayer(struct Headless *h, float x, float y,
+                                  float width, float height) {
+  return makeProfilerLayer(context(h), h->profiler, x, y, width, height);
+}
+
+static void tone(void *state, const struct ProcessContext *ctx) {
+  (void)state;
+  for (int i = 0; i < ctx->frames; i++) {
+    float x =
+        (float)sin(2 * DSP_PI * 440 * (ctx->position + i) / SAMPLE_RATE);
+    for (int c = 0; c < ctx->outputCount; c++) {
+      ctx->outputs[c][i] = x * (c + 1) / ctx->outputCount;
+    }
+  }
+}
+
+static void makeSources(struct Headless *h) {
+  h->meters = makeMeters(METERS, SAMPLE_RATE);
+  h->meterTap = (struct MeterTap){h->meters, 0};
+  h->spectrum = makeSpectrum(SPECTRA, SAMPLE_RATE, FFT_SIZE, OVERLAP);
+  h->spectrumTap = (struct SpectrumTap){h->spectrum, 0};
+  h->graph = makeGraph();
+  int source = graphAddNode(h->graph, (struct NodeDescription){
+                                          .name = "tone",
+                                          .outputs = METERS,
+                                          .process = tone,
+                                      });
+  int meters = graphAddNode(h->graph, (struct NodeDescription){
+                                          .name = "meters",
+                                          .inputs = METERS,
+                                          .outputs = METERS,
+                                          .process = meterTapProcess,
+                                          .state = &h->meterTap,
+                                      });
+  int spectrum = graphAddNode(h->graph, (struct NodeDescription){
+                                            .name = "spectrum",
+                                            .inputs = SPECTRA,
+                                            .outputs = SPECTRA,
+                                            .process = spectrumTapProcess,
+                                            .state = &h->spectrumTap,
+                                        });
+  for (int c = 0; c < METERS; c++) {
+    graphConnect(h->graph, source, c, meters, c);
+  }
+  for (int c = 0; c < SPECTRA; c++) {
+    graphConnect(h->graph, source, c, spectrum, c);
+  }
+  h->compiled = compileGraph(h->graph, BLOCK);
+  h->scheduler = makeScheduler(1, 16, 0);
+  h->profiler = makeProfiler(16, HISTORY);
+  profilerNameNodes(h->profiler, h->compiled);
+}
+
+// an arpeggio climbing the view, a long note held under it
+static NoteTrack makeNotes(void) {
+  struct Note notes[NOTES];
+  uint32_t step = (uint32_t)VIEW_SECONDS * SAMPLE_RATE / (NOTES - 1);
+  for (int i = 0; i < NOTES - 1; i++) {
+    notes[i] = (struct Note){
+        .start = (uint64_t)i * step,
+        .length = step * 2,
+        .pitch = (uint8_t)(LOW_PITCH + 12 + i % 24),
+        .velocity = 100,
+    };
+  }
+  notes[NOTES - 1] = (struct Note){
+      .length = (uint32_t)VIEW_SECONDS * SAMPLE_RATE,
+      .pitch = LOW_PITCH + 2,
+      .velocity = 80,
+  };
+  return makeNoteTrack(notes, NOTES);
+}
+
+// the sources the way the daw has them, then a layer over each, clear of
+// the pixels checkFrame looks at
+static void makeLayers(struct Headless *h) {
+  makeSources(h);
+  Automation curve = makeCurve();
+  h->automation = makeAutomationLane(curve);
+  automationRelease(curve);
+  NoteTrack track = makeNotes();
+  h->notes = makeNoteLane(track);
+  noteTrackRelease(track);
+  atomic_init(&h->timeline.start, 0);
+  atomic_init(&h->timeline.end, (uint64_t)VIEW_SECONDS * SAMPLE_RATE);
+  h->layerCount = 0;
+  h->layered = 0;
+  h->time = 0;
+  h->position = 0;
+  addLayer(h, "meters", 1210, 20, 60, 680, meterLayer);
+  addLayer(h, "spectrum", 0, 520, 600, 180, spectrumLayer);
+  addLayer(h, "automation", 620, 520, 560, 90, automationLayer);
+  addLayer(h, "piano roll", 620, 620, 560, 80, pianoRollLayer);
+  addLayer(h, "profiler", 620, 260, 560, 240, profilerLayer);
+}
+
+// a block the way the engine runs one, in place of what the audio thread
+// would have done since the last frame
+static void feed(struct Headless *h) {
+  uint64_t start = clockNanos();
+  schedulerRun(h->scheduler, h->compiled, BLOCK, h->position, 1);
+  meterPublish(h->meters, h->position);
+  profilerRecord(h->profiler, h->compiled, start, clockNanos(), h->position,
+                 BLOCK, SAMPLE_RATE);
+  h->position += BLOCK;
+}
+
+static void freeLayers(struct Headless *h) {
+  vkDeviceWaitIdle(h->device);
+  for (int i = 0; i < h->layerCount; i++) {
+    h->layers[i].destroy(h->layers[i].state);
+  }
+  freeScheduler(h->scheduler);
+  freeCompiledGraph(h->compiled);
+  freeGraph(h->graph);
+  freeProfiler(h->profiler);
+  freeMeters(h->meters);
+  freeSpectrum(h->spectrum);
+  freeAutomationLane(h->automation);
+  freeNoteLane(h->notes);
+}
+
+static void freeHeadless(struct Headless *h) {
+  vkDeviceWaitIdle(h->device);
+
+  vkUnmapMemory(h->device, h->vertices.memory);
+  vkDestroyBuffer(h->device, h->vertices.buffer, NULL);
+  vkFreeMemory(h->device, h->vertices.memory, NULL);
+  freeDrawList(h->ui);
+
+  vkDestroyFence(h->device, h->fence, NULL);
+  vkDestroyCommandPool(h->device, h->commandPool, NULL);
+
+  vkDestroyPipeline(h->device, h->pipeline, NULL);
+  vkDestroyPipelineLayout(h->device, h->pipelineLayout, NULL);
+  vkDestroyShaderModule(h->device, h->fragShader, NULL);
+  vkDestroyShaderModule(h->device, h->vertShader, NULL);
+
+  vkDestroyFramebuffer(h->device, h->framebuffer[0], NULL);
+  free(h->framebuffer);
+  vkDestroyImageView(h->device, h->view[0], NULL);
+  free(h->view);
+  vkDestroyImage(h->device, h->target.image, NULL);
+  vkFreeMemory(h->device, h->target.memory, NULL);
+  vkDestroyRenderPass(h->device, h->renderPass, NULL);
+
+  vkDestroyDevice(h->device, NULL);
+  vkDestroyInstance(h->instance, NULL);
+}
+
+// clips on a grid of tracks, a marker on every few, as bench/micro.c builds
+static void upload(struct Headless *h) {
+  drawListClear(h->ui);
+  for (int i = 0; i < RECTS; i++) {
+    int x = i % 40 * 30, y = i / 40 * 20;
+    drawListRectangle(h->ui, x, y, 28, 18);
+    if (i % TRIANGLE_EVERY == 0) {
+      drawListTriangle(h->ui, x, y, 6, 6);
+    }
+  }
+  h->vertexCount = drawListCount(h->ui);
+  memcpy(h->mapped, drawListVertices(h->ui),
+         h->vertexCount * sizeof(struct Vertex));
+}
+
+// what the renderer records for a frame, less the layers
+static void record(struct Headless *h) {
+  VkCommandBuffer cmd = h->commandBuffer;
+
+  VkCommandBufferBeginInfo beginInfo = {0};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmd, &beginInfo);
+
+  VkRenderPassBeginInfo renderPassInfo = {0};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = h->renderPass;
+  renderPassInfo.framebuffer = h->framebuffer[0];
+  renderPassInfo.renderArea.extent = h->settings.selectedExtent;
+  VkClearValue clearValue = {{{1.0f, 1.0f, 1.0f, 1.0f}}};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+  vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, h->pipeline);
+
+  VkViewport viewport = {0};
+  viewport.width = WIDTH;
+  viewport.height = HEIGHT;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  VkRect2D scissor = {0};
+  scissor.extent = h->settings.selectedExtent;
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+  // the shader takes the framebuffer size with the ui at half of it, as on
+  // a retina display, so this puts ui coordinates on pixels
+  struct PushConstants pushConstants = {{2 * WIDTH, 2 * HEIGHT}};
+  vkCmdPushConstants(cmd, h->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(struct PushConstants), &pushConstants);
+
+  VkBuffer vertexBuffers[] = {h->vertices.buffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
+  vkCmdDraw(cmd, h->vertexCount, 1, 0, 0);
+
+  // layers take window coordinates, which are pixels here
+  for (int i = 0; h->layered && i < h->layerCount; i++) {
+    h->layers[i].record(h->layers[i].state, cmd, 0, h->time,
+                        (struct Vec2){WIDTH, HEIGHT});
+  }
+
+  vkCmdEndRenderPass(cmd);
+}
+
+// what the renderer does outside the render pass, after the previous frame
+// is done with the buffers
+static void prepare(struct Headless *h) {
+  h->time += 1.0 / 60;
+  if (!h->layered) {
+    return;
+  }
+  feed(h);
+  for (int i = 0; i < h->layerCount; i++) {
+    if (h->layers[i].prepare) {
+      h->layers[i].prepare(h->layers[i].state, 0, h->time);
+    }
+  }
+}
+
+static void submit(struct Headless *h) {
+  VkSubmitInfo submitInfo = {0};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &h->commandBuffer;
+  vkQueueSubmit(h->queue, 1, &submitInfo, h->fence);
+  vkWaitForFences(h->device, 1, &h->fence, VK_TRUE, UINT64_MAX);
+  vkResetFences(h->device, 1, &h->fence);
+}
+
+static void uploadBody(void *state, long iterations) {
+  struct Headless *h = state;
+  for (long i = 0; i < iterations; i++) {
+    upload(h);
+  }
+}
+
+static void recordBody(void *state, long iterations) {
+  struct Headless *h = state;
+  for (long i = 0; i < iterations; i++) {
+    vkResetCommandPool(h->device, h->commandPool, 0);
+    record(h);
+    vkEndCommandBuffer(h->commandBuffer);
+  }
+}
+
+static void frameBody(void *state, long iterations) {
+  struct Headless *h = state;
+  for (long i = 0; i < iterations; i++) {
+    upload(h);
+    prepare(h);
+    vkResetCommandPool(h->device, h->commandPool, 0);
+    record(h);
+    vkEndCommandBuffer(h->commandBuffer);
+    submit(h);
+  }
+}
+
+// renders a frame and copies it out
+static uint32_t *readFrame(struct Headless *h) {
+  VkDeviceSize size = (VkDeviceSize)WIDTH * HEIGHT * 4;
+  struct VertexBufferAndMemory readback = makeVkHostBuffer(
+      h->physicalDevice, h->device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  upload(h);
+  prepare(h);
+  vkResetCommandPool(h->device, h->commandPool, 0);
+  record(h);
+
+  VkImageMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = h->target.image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(h->commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                       &barrier);
+
+  VkBufferImageCopy region = {0};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = WIDTH;
+  region.imageExtent.height = HEIGHT;
+  region.imageExtent.depth = 1;
+  vkCmdCopyImageToBuffer(h->commandBuffer, h->target.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer,
+                         1, &region);
+  vkEndCommandBuffer(h->commandBuffer);
+  submit(h);
+
+  void *mapped;
+  uint32_t *pixels = malloc(size);
+  vkMapMemory(h->device, readback.memory, 0, size, 0, &mapped);
+  memcpy(pixels, mapped, size);
+  vkUnmapMemory(h->device, readback.memory);
+  vkDestroyBuffer(h->device, readback.buffer, NULL);
+  vkFreeMemory(h->device, readback.memory, NULL);
+  return pixels;
+}
+
+// a pixel inside the first clip has to be drawn over and one in the gap
+// after it left clear
+static int checkFrame(struct Headless *h) {
+  uint32_t *pixels = readFrame(h);
+  uint32_t inside = pixels[10 * WIDTH + 10];
+  uint32_t gap = pixels[10 * WIDTH + 29];
+  free(pixels);
+
+  printf("frame: %s\n",
+         inside == BLACK && gap == WHITE ? "drawn" : "WRONG PIXELS");
+  return inside == BLACK && gap == WHITE;
+}
+
+// every layer has to change some of its rectangle against the ui alone, and
+// nothing outside the rectangles may change
+static int checkLayers(struct Headless *h) {
+  h->layered = 0;
+  uint32_t *plain = readFrame(h);
+  // enough frames for the sources to have something to show, the spectrum a
+  // few windows
+  h->layered = 1;
+  for (int i = 0; i < 60; i++) {
+    free(readFrame(h));
+  }
+  uint32_t *layered = readFrame(h);
+
+  int ok = 1;
+  long changed[MAX_LAYERS] = {0}, stray = 0;
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      if (plain[y * WIDTH + x] == layered[y * WIDTH + x]) {
+        continue;
+      }
+      int owner = -1;
+      for (int i = 0; i < h->layerCount && owner < 0; i++) {
+        const float *r = h->rects[i];
+        owner = x >= r[0] - 1 && x <= r[0] + r[2] + 1 && y >= r[1] - 1 &&
+                        y <= r[1] + r[3] + 1
+                    ? i
+                    : -1;
+      }
+      if (owner < 0) {
+        stray++;
+      } else {
+        changed[owner]++;
+      }
+    }
+  }
+  printf("layers:");
+  for (int i = 0; i < h->layerCount; i++) {
+    printf(" %s %ld px%s", h->names[i], changed[i],
+           changed[i] ? "" : " (NONE)");
+    ok &= changed[i] > 0;
+  }
+  printf(", %ld px outside them\n", stray);
+  h->layered = 0;
+  free(plain);
+  free(layered);
+  return ok && stray == 0;
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  struct Headless h;
+  makeHeadless(&h);
+  BenchReport r = makeBenchReport("render");
+
+  makeLayers(&h);
+  int drawn = checkFrame(&h);
+  int layered = checkLayers(&h);
+
+  char unit[32];
+  snprintf(unit, sizeof(unit), "%d rects", RECTS);
+  benchRun(r, "render/upload", unit, uploadBody, &h);
+  benchRun(r, "render/record", "command buffer", recordBody, &h);
+  snprintf(unit, sizeof(unit), "%dx%d frame", WIDTH, HEIGHT);
+  h.layered = 0;
+  benchRun(r, "render/frame", unit, frameBody, &h);
+  snprintf(unit, sizeof(unit), "%dx%d, %d layers", WIDTH, HEIGHT,
+           h.layerCount);
+  h.layered = 1;
+  benchRun(r, "render/layers", unit, frameBody, &h);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  if (!written) {
+    fprintf(stderr, "can't write %s\n", argv[1]);
+  }
+  freeBenchReport(r);
+  freeLayers(&h);
+  freeHeadless(&h);
+  return !drawn || !layered || !written;
+}
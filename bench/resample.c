@@ -0,0 +1,155 @@
+// resampler throughput (channels x realtime) and quality: THD+N of a 1 kHz
+// tone, and how far a tone above the new nyquist is suppressed
+#include "clock.h"
+#include "dsp.h"
+#include "resampler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BLOCK 256
+#define CHANNELS 2
+#define SECONDS 10
+#define ANALYSIS_FRAMES 32768
+
+static const char *qualityNames[] = {"low", "medium", "high", "best"};
+
+struct Conversion {
+  int in, out;
+};
+
+static const struct Conversion conversions[] = {
+    {44100, 48000}, {48000, 44100}, {96000, 48000}, {48000, 96000}};
+#define CONVERSIONS (int)(sizeof(conversions) / sizeof(conversions[0]))
+
+// runs `frames` of a sine at `hz` through a fresh resampler, writing output
+// frames to `out` and returning how many were produced
+static int convert(struct Conversion c, enum ResamplerQuality q, double hz,
+                   float *out, int frames) {
+  Resampler r = makeResampler(c.in, c.out, 1, BLOCK, q);
+  float in[2 * BLOCK + 64];
+  const float *inputs[] = {in};
+  long phase = 0;
+  int produced = 0;
+
+  while (produced + BLOCK <= frames) {
+    int need = resamplerInputFrames(r, BLOCK);
+    for (int i = 0; i < need; i++, phase++) {
+      in[i] = (float)(0.5 * sin(2 * DSP_PI * hz * phase / c.in));
+    }
+    float *outputs[] = {out + produced};
+    produced += resamplerProcess(r, inputs, need, outputs, BLOCK);
+  }
+  freeResampler(r);
+  return produced;
+}
+
+// least-squares fit of a sine at `hz`, returns what's left relative to the
+// fitted tone in dB
+static double thdnDb(const float *x, int n, double hz, int rate) {
+  double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0;
+  for (int i = 0; i < n; i++) {
+    double s = sin(2 * DSP_PI * hz * i / rate);
+    double c = cos(2 * DSP_PI * hz * i / rate);
+    ss += s * s;
+    sc += s * c;
+    cc += c * c;
+    xs += x[i] * s;
+    xc += x[i] * c;
+  }
+  double det = ss * cc - sc * sc;
+  double a = (xs * cc - xc * sc) / det;
+  double b = (xc * ss - xs * sc) / det;
+
+  double tone = 0, residual = 0;
+  for (int i = 0; i < n; i++) {
+    double fit = a * sin(2 * DSP_PI * hz * i / rate) +
+                 b * cos(2 * DSP_PI * hz * i / rate);
+    tone += fit * fit;
+    residual += (x[i] - fit) * (x[i] - fit);
+  }
+  return 10 * log10(residual / tone);
+}
+
+// power left of a tone that should have been filtered out, relative to the
+// power it went in with
+static double leakDb(const float *x, int n, double amplitude) {
+  double power = 0;
+  for (int i = 0; i < n; i++) {
+    power += (double)x[i] * x[i];
+  }
+  power /= n;
+  power = power > 1e-30 ? power : 1e-30;
+  return 10 * log10(power / (amplitude * amplitude / 2));
+}
+
+int main(void) {
+  dspInit();
+
+  // quality
+  printf("%-16s %-8s %10s %10s %8s\n", "conversion", "quality", "THD+N dB",
+         "alias dB", "latency");
+  float *out = malloc((ANALYSIS_FRAMES + BLOCK) * sizeof(float));
+  int skip = 4096; // past the filter's startup transient
+  for (int i = 0; i < CONVERSIONS; i++) {
+    struct Conversion c = conversions[i];
+    for (int q = RESAMPLER_LOW; q <= RESAMPLER_BEST; q++) {
+      int n = convert(c, q, 1000, out, ANALYSIS_FRAMES);
+      double thd = thdnDb(out + skip, n - skip, 1000, c.out);
+
+      // a tone between the output nyquist and the input nyquist should vanish
+      double alias = NAN;
+      if (c.out < c.in) {
+        double hz = (c.out / 2.0 + c.in / 2.0) / 2;
+        n = convert(c, q, hz, out, ANALYSIS_FRAMES);
+        alias = leakDb(out + skip, n - skip, 0.5);
+      }
+
+      Resampler r = makeResampler(c.in, c.out, 1, BLOCK, q);
+      char name[32];
+      snprintf(name, sizeof(name), "%d>%d", c.in, c.out);
+      char aliasText[16] = "-";
+      if (!isnan(alias)) {
+        snprintf(aliasText, sizeof(aliasText), "%.1f", alias);
+      }
+      printf("%-16s %-8s %10.1f %10s %8d\n", name, qualityNames[q], thd,
+             aliasText, resamplerLatency(r));
+      freeResampler(r);
+    }
+  }
+  free(out);
+
+  // throughput
+  printf("\n%-16s %-8s %16s\n", "conversion", "quality", "channels x rt");
+  float *planes[CHANNELS], *outPlanes[CHANNELS];
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    planes[ch] = calloc(4 * BLOCK, sizeof(float));
+    outPlanes[ch] = calloc(BLOCK, sizeof(float));
+    for (int i = 0; i < 4 * BLOCK; i++) {
+      planes[ch][i] = (float)rand() / RAND_MAX - 0.5f;
+    }
+  }
+  for (int i = 0; i < CONVERSIONS; i++) {
+    struct Conversion c = conversions[i];
+    for (int q = RESAMPLER_LOW; q <= RESAMPLER_BEST; q++) {
+      Resampler r = makeResampler(c.in, c.out, CHANNELS, BLOCK, q);
+      long blocks = (long)SECONDS * c.out / BLOCK;
+      uint64_t start = clockNanos();
+      for (long b = 0; b < blocks; b++) {
+        int need = resamplerInputFrames(r, BLOCK);
+        resamplerProcess(r, (const float *const *)planes, need, outPlanes,
+                         BLOCK);
+      }
+      double seconds = (clockNanos() - start) / 1e9;
+      char name[32];
+      snprintf(name, sizeof(name), "%d>%d", c.in, c.out);
+      printf("%-16s %-8s %16.0f\n", name, qualityNames[q],
+             CHANNELS * SECONDS / seconds);
+      freeResampler(r);
+    }
+  }
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    free(planes[ch]);
+    free(outPlanes[ch]);
+  }
+}
@@ -0,0 +1,219 @@
+// the sample cache: a drum-heavy project, hundreds of clips on a handful of
+// one-shots some of which are copies under other names, loaded from several
+// threads at once, must decode every distinct sound once and no more. a
+// tight budget has to evict and then refuse rather than grow, and an evicted
+// sample must outlive an audio block that could still be reading it. then
+// what a hit costs. results go to the json file named on the command line,
+// if any, for bench-compare
+#define _POSIX_C_SOURCE 200809L
+#include "audiofile.h"
+#include "dsp.h"
+#include "samplecache.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define FRAMES 24000 // half a second
+#define CHANNELS 2
+#define SOUNDS 12
+#define COPIES 4 // of the first sounds, under other names
+#define FILES (SOUNDS + COPIES)
+#define CLIPS 400
+#define LOADERS 4
+#define SAMPLE_BYTES ((size_t)FRAMES * CHANNELS * sizeof(float))
+
+struct Loader {
+  SampleCache cache;
+  char (*paths)[64];
+  unsigned seed;
+  Sample clips[CLIPS / LOADERS];
+};
+
+struct Hit {
+  SampleCache cache;
+  const char *path;
+};
+
+static int writeSound(const char *path, unsigned seed) {
+  AudioWriter w = openWavWriter(path, CHANNELS, SAMPLE_RATE, SAMPLE_INT16);
+  if (!w) {
+    return 0;
+  }
+  float *frames = malloc(SAMPLE_BYTES);
+  for (int i = 0; i < FRAMES * CHANNELS; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    float decay = 1.0f - (float)(i / CHANNELS) / FRAMES;
+    frames[i] = ((float)(seed >> 8) / (float)(1 << 24) - 0.5f) * decay;
+  }
+  int ok = writeAudioFile(w, frames, FRAMES);
+  free(frames);
+  return closeAudioWriter(w) && ok;
+}
+
+// clips on random files, the way a pattern-based project uses its kit
+static void *load(void *arg) {
+  struct Loader *l = arg;
+  for (int c = 0; c < CLIPS / LOADERS; c++) {
+    l->seed = l->seed * 1664525u + 1013904223u;
+    l->clips[c] = sampleCacheLoad(l->cache, l->paths[(l->seed >> 8) % FILES]);
+  }
+  return NULL;
+}
+
+static void hitBody(void *state, long iterations) {
+  struct Hit *h = state;
+  for (long i = 0; i < iterations; i++) {
+    sampleRelease(sampleCacheLoad(h->cache, h->path));
+  }
+}
+
+static void printStats(const char *label, struct SampleCacheStats s) {
+  printf("%s: %llu hits (%llu shared), %llu misses, %llu refused, "
+         "%llu evictions, %zu of %zu KiB\n",
+         label, (unsigned long long)s.hits, (unsigned long long)s.shared,
+         (unsigned long long)s.misses, (unsigned long long)s.refused,
+         (unsigned long long)s.evictions, s.bytes / 1024, s.budget / 1024);
+}
+
+// every thread's clips together, all loaded, on the sounds they should be
+static int checkProject(struct Loader *loaders) {
+  int ok = 1;
+  for (int t = 0; t < LOADERS; t++) {
+    for (int c = 0; c < CLIPS / LOADERS; c++) {
+      Sample s = loaders[t].clips[c];
+      ok &= s && sampleFrames(s) == FRAMES &&
+            sampleChannelCount(s) == CHANNELS &&
+            sampleSampleRate(s) == SAMPLE_RATE;
+    }
+  }
+  return ok;
+}
+
+static void releaseProject(struct Loader *loaders) {
+  for (int t = 0; t < LOADERS; t++) {
+    for (int c = 0; c < CLIPS / LOADERS; c++) {
+      if (loaders[t].clips[c]) {
+        sampleRelease(loaders[t].clips[c]);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+
+  char dir[] = "/tmp/samplecache-XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char paths[FILES][64];
+  int failed = 0;
+  for (int f = 0; f < FILES; f++) {
+    snprintf(paths[f], sizeof(paths[f]), "%s/%s%02d.wav", dir,
+             f < SOUNDS ? "kick" : "copy", f);
+    failed |= !writeSound(paths[f], f < SOUNDS ? f + 1 : f - SOUNDS + 1);
+  }
+
+  // the project, room for every sound
+  SampleCache c = makeSampleCache(2 * SOUNDS * SAMPLE_BYTES);
+  struct Loader *loaders = calloc(LOADERS, sizeof(struct Loader));
+  pthread_t threads[LOADERS];
+  for (int t = 0; t < LOADERS; t++) {
+    loaders[t] = (struct Loader){.cache = c, .paths = paths, .seed = t + 1};
+    pthread_create(&threads[t], NULL, load, &loaders[t]);
+  }
+  for (int t = 0; t < LOADERS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  struct SampleCacheStats s = sampleCacheStats(c);
+  printStats("project", s);
+  int loaded = checkProject(loaders);
+  int decodedOnce = s.misses == SOUNDS && s.hits == CLIPS - SOUNDS &&
+                    s.samples == SOUNDS && s.bytes == SOUNDS * SAMPLE_BYTES &&
+                    s.usedBytes == s.bytes;
+  printf("every clip loaded: %s, each sound decoded once: %s\n",
+         loaded ? "yes" : "no", decodedOnce ? "yes" : "no");
+  failed |= !loaded || !decodedOnce;
+
+  // a copy is the same sample as its original
+  Sample original = sampleCacheLoad(c, paths[0]);
+  Sample copy = sampleCacheLoad(c, paths[SOUNDS]);
+  int shared = original == copy && sampleCacheStats(c).shared > 0;
+  printf("copies shared: %s\n", shared ? "yes" : "no");
+  failed |= !shared;
+  sampleRelease(original);
+  sampleRelease(copy);
+  releaseProject(loaders);
+  s = sampleCacheStats(c);
+  failed |= s.usedBytes != 0 || s.samples != SOUNDS;
+
+  // what a hit costs, the path seen before and unchanged
+  BenchReport r = makeBenchReport("samplecache");
+  struct Hit hit = {c, paths[1]};
+  benchRun(r, "samplecache/hit", "load and release", hitBody, &hit);
+  freeSampleCache(c);
+
+  // room for four sounds: cycling through them all evicts, holding four
+  // refuses a fifth, and the cache never goes over
+  c = makeSampleCache(4 * SAMPLE_BYTES);
+  size_t peak = 0;
+  for (int f = 0; f < SOUNDS; f++) {
+    Sample one = sampleCacheLoad(c, paths[f]);
+    failed |= one == NULL;
+    if (one) {
+      sampleRelease(one);
+    }
+    size_t bytes = sampleCacheStats(c).bytes;
+    peak = bytes > peak ? bytes : peak;
+  }
+  Sample held[5];
+  for (int f = 0; f < 5; f++) {
+    held[f] = sampleCacheLoad(c, paths[f]);
+  }
+  s = sampleCacheStats(c);
+  printStats("tight budget", s);
+  int bounded = peak <= s.budget && s.bytes <= s.budget && s.evictions > 0 &&
+                s.refused == 1 && held[4] == NULL;
+  printf("bounded: %s\n", bounded ? "yes" : "no");
+  failed |= !bounded;
+  for (int f = 0; f < 4; f++) {
+    failed |= held[f] == NULL;
+    if (held[f]) {
+      sampleRelease(held[f]);
+    }
+  }
+
+  // a block in progress keeps what it could have seen: evict everything
+  // while a reader is inside one, nothing is freed until it leaves
+  int reader = sampleCacheAddReader(c);
+  sampleCacheCollect(c);
+  sampleCacheEnter(c, reader);
+  for (int f = 4; f < 8; f++) {
+    sampleRelease(sampleCacheLoad(c, paths[f]));
+  }
+  size_t during = sampleCacheCollect(c);
+  size_t retired = sampleCacheStats(c).retiredBytes;
+  sampleCacheLeave(c, reader);
+  size_t after = sampleCacheCollect(c);
+  printf("evicted in a block: %zu KiB freed during it, %zu KiB after\n",
+         during / 1024, after / 1024);
+  failed |= during != 0 || retired == 0 || after != retired ||
+            sampleCacheStats(c).retiredBytes != 0;
+  sampleCacheRemoveReader(c, reader);
+  freeSampleCache(c);
+  free(loaders);
+
+  for (int f = 0; f < FILES; f++) {
+    unlink(paths[f]);
+  }
+  rmdir(dir);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  freeBenchReport(r);
+  return failed || !written;
+}
@@ -0,0 +1,162 @@
+#include "stats.h"
+
+#include "clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WARMUP_NANOS 50000000ull // 50 ms
+#define SAMPLE_NANOS 5000000ull  // 5 ms
+#define SAMPLES 25
+
+struct BenchReport {
+  char suite[32];
+  char commit[64];
+  struct BenchResult *results;
+  int count;
+  int capacity;
+};
+
+// PRIVATE FUNCTIONS
+
+static int compare(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// sorts `x`
+static double median(double *x, int n) {
+  qsort(x, n, sizeof(double), compare);
+  return n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+}
+
+static uint64_t timeBody(BenchBody body, void *state, long iterations) {
+  uint64_t start = clockNanos();
+  body(state, iterations);
+  return clockNanos() - start;
+}
+
+static void add(BenchReport r, struct BenchResult result) {
+  if (r->count == r->capacity) {
+    r->capacity = r->capacity ? 2 * r->capacity : 16;
+    r->results = realloc(r->results, r->capacity * sizeof(struct BenchResult));
+  }
+  r->results[r->count++] = result;
+}
+
+// PUBLIC FUNCTIONS
+
+BenchReport makeBenchReport(const char *suite) {
+  BenchReport r = calloc(1, sizeof(struct BenchReport));
+  snprintf(r->suite, sizeof(r->suite), "%s", suite);
+  const char *commit = getenv("BENCH_COMMIT");
+  snprintf(r->commit, sizeof(r->commit), "%s", commit ? commit : "");
+  return r;
+}
+
+void freeBenchReport(BenchReport r) {
+  free(r->results);
+  free(r);
+}
+
+struct BenchResult benchRun(BenchReport r, const char *name, const char *unit,
+                            BenchBody body, void *state) {
+  struct BenchResult result = {0};
+  snprintf(result.name, sizeof(result.name), "%s", name);
+  snprintf(result.unit, sizeof(result.unit), "%s", unit);
+
+  // grow the iterations until a run is long enough to scale from, which
+  // doubles as the start of the warmup
+  uint64_t warmupEnd = clockNanos() + WARMUP_NANOS;
+  long iterations = 1;
+  uint64_t nanos = timeBody(body, state, iterations);
+  while (nanos < SAMPLE_NANOS / 8) {
+    iterations *= nanos < SAMPLE_NANOS / 64 ? 8 : 2;
+    nanos = timeBody(body, state, iterations);
+  }
+  iterations = (long)((double)iterations * SAMPLE_NANOS / nanos);
+  iterations = iterations > 0 ? iterations : 1;
+  while (clockNanos() < warmupEnd) {
+    body(state, iterations);
+  }
+
+  double times[SAMPLES], deviations[SAMPLES];
+  result.min = 1e300;
+  for (int s = 0; s < SAMPLES; s++) {
+    times[s] = (double)timeBody(body, state, iterations) / iterations;
+    result.min = times[s] < result.min ? times[s] : result.min;
+    result.max = times[s] > result.max ? times[s] : result.max;
+  }
+  result.median = median(times, SAMPLES);
+  for (int s = 0; s < SAMPLES; s++) {
+    double d = times[s] - result.median;
+    deviations[s] = d < 0 ? -d : d;
+  }
+  result.mad = median(deviations, SAMPLES);
+  result.iterations = iterations;
+  result.samples = SAMPLES;
+
+  printf("%-32s %12.1f ns +- %-8.1f min %12.1f  per %s\n", result.name,
+         result.median, result.mad, result.min, result.unit);
+  fflush(stdout);
+  add(r, result);
+  return result;
+}
+
+int benchWrite(BenchReport r, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return 0;
+  }
+  fprintf(f, "{\"suite\":\"%s\",\"commit\":\"%s\",\"results\":[\n", r->suite,
+          r->commit);
+  for (int i = 0; i < r->count; i++) {
+    struct BenchResult *b = &r->results[i];
+    fprintf(f,
+            "{\"name\":\"%s\",\"unit\":\"%s\",\"iterations\":%ld,"
+            "\"samples\":%d,\"median\":%.3f,\"mad\":%.3f,\"min\":%.3f,"
+            "\"max\":%.3f}%s\n",
+            b->name, b->unit, b->iterations, b->samples, b->median, b->mad,
+            b->min, b->max, i + 1 < r->count ? "," : "");
+  }
+  fprintf(f, "]}\n");
+  return fclose(f) == 0;
+}
+
+BenchReport benchRead(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return NULL;
+  }
+  char line[512];
+  char suite[32] = "", commit[64] = "";
+  if (!fgets(line, sizeof(line), f) ||
+      sscanf(line, "{\"suite\":\"%31[^\"]\",\"commit\":\"%63[^\"]\"", suite,
+             commit) < 1) {
+    fclose(f);
+    return NULL;
+  }
+  BenchReport r = makeBenchReport(suite);
+  snprintf(r->commit, sizeof(r->commit), "%s", commit);
+  while (fgets(line, sizeof(line), f)) {
+    struct BenchResult b = {0};
+    if (sscanf(line,
+               "{\"name\":\"%63[^\"]\",\"unit\":\"%31[^\"]\","
+               "\"iterations\":%ld,\"samples\":%d,\"median\":%lf,"
+               "\"mad\":%lf,\"min\":%lf,\"max\":%lf}",
+               b.name, b.unit, &b.iterations, &b.samples, &b.median, &b.mad,
+               &b.min, &b.max) == 8) {
+      add(r, b);
+    }
+  }
+  fclose(f);
+  return r;
+}
+
+int benchCount(BenchReport r) { return r->count; }
+
+struct BenchResult benchResult(BenchReport r, int index) {
+  return r->results[index];
+}
+
+const char *benchCommit(BenchReport r) { return r->commit; }
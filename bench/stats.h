@@ -0,0 +1,41 @@
+#ifndef STATS_H
+#define STATS_H
+
+// repeatable timings for the benchmarks. a body is warmed up, then timed in
+// samples long enough that the clock's resolution doesn't matter, and
+// summarised by the median and the median absolute deviation, which a sample
+// the scheduler got in the way of barely moves. results collect in a report
+// written out as json, a result a line, to compare runs between commits.
+typedef struct BenchReport *BenchReport;
+
+// times in nanoseconds per iteration
+struct BenchResult {
+  char name[64];
+  char unit[32]; // what one iteration does
+  long iterations; // per sample
+  int samples;
+  double median, mad, min, max;
+};
+
+// runs what's measured `iterations` times over
+typedef void (*BenchBody)(void *state, long iterations);
+
+BenchReport makeBenchReport(const char *suite);
+void freeBenchReport(BenchReport r);
+
+// measures `body`, prints the result and adds it to the report
+struct BenchResult benchRun(BenchReport r, const char *name, const char *unit,
+                            BenchBody body, void *state);
+
+// the commit the results are for is taken from BENCH_COMMIT, if set. returns
+// 0 if the file can't be written
+int benchWrite(BenchReport r, const char *path);
+
+// a report benchWrite wrote, NULL if it can't be read
+BenchReport benchRead(const char *path);
+
+int benchCount(BenchReport r);
+struct BenchResult benchResult(BenchReport r, int index);
+const char *benchCommit(BenchReport r);
+
+#endif
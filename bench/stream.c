@@ -0,0 +1,247 @@
+// disk streaming: a session of TRACKS stereo clips evicted from the page cache
+// plays in real time block by block, every track looping at its end and a few
+// jumping somewhere random every SEEK_EVERY blocks. every frame a clip hands
+// over has to be the file's own frame at the clip's position, nothing may run
+// dry outside a seek, and a seek has to be playing again within a few blocks.
+// files with impossible headers have to be refused
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "dsp.h"
+#include "stream.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define TRACKS 128
+#define FILE_SECONDS 3
+#define PLAY_SECONDS 8
+#define BLOCK 256
+#define PREFETCH_SECONDS 0.5
+#define SEEK_EVERY 20 // blocks
+#define SEEKS_AT_ONCE 8
+#define MAX_SEEKS 4096
+
+struct Track {
+  StreamClip clip;
+  AudioFile reference; // the same file mapped on its own
+  uint64_t frames;
+  uint64_t position; // file frame the clip hands over next
+  int seeking;
+  uint64_t seekStart; // clockNanos when the seek was asked for
+};
+
+// a tone of its own per track under a little noise, so a frame from the
+// wrong place or the wrong file shows
+static int writeTrack(const char *path, int track) {
+  AudioWriter w = openWavWriter(path, 2, SAMPLE_RATE, SAMPLE_INT16);
+  if (!w) {
+    return 0;
+  }
+  uint64_t frames = (uint64_t)FILE_SECONDS * SAMPLE_RATE;
+  float buffer[4096 * 2];
+  unsigned seed = track + 1;
+  double hz = 110.0 * pow(2.0, track / 24.0);
+  int ok = 1;
+  for (uint64_t at = 0; at < frames && ok; at += 4096) {
+    int n = frames - at < 4096 ? (int)(frames - at) : 4096;
+    for (int i = 0; i < n; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      float noise = ((float)(seed >> 8) / (float)(1 << 24) - 0.5f) * 0.05f;
+      float x = 0.4f * (float)sin(2 * DSP_PI * hz * (at + i) / SAMPLE_RATE);
+      buffer[i * 2] = x + noise;
+      buffer[i * 2 + 1] = x - noise;
+    }
+    ok = writeAudioFile(w, buffer, n);
+  }
+  if (!closeAudioWriter(w) || !ok) {
+    return 0;
+  }
+
+  // out of the page cache, so the streamer reads from the disk
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+  return 1;
+}
+
+// a wav header claiming `channels`, `bits` and `rate`, with some data
+static int writeHeader(const char *path, int channels, int bits, int rate) {
+  unsigned char h[44 + 64] = {0};
+  unsigned fields[][2] = {{4, 36 + 64}, {16, 16}, {24, (unsigned)rate},
+                          {40, 64}};
+  memcpy(h, "RIFF", 4);
+  memcpy(h + 8, "WAVEfmt ", 8);
+  memcpy(h + 36, "data", 4);
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 4; b++) {
+      h[fields[i][0] + b] = (unsigned char)(fields[i][1] >> (8 * b));
+    }
+  }
+  h[20] = 1; // pcm
+  h[22] = (unsigned char)channels;
+  h[34] = (unsigned char)bits;
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return 0;
+  }
+  int ok = fwrite(h, sizeof(h), 1, f) == 1;
+  return fclose(f) == 0 && ok;
+}
+
+static int compareUint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void seekTrack(struct Track *t, uint64_t frame) {
+  streamClipSeek(t->clip, frame);
+  t->position = frame;
+  t->seeking = 1;
+  t->seekStart = clockNanos();
+}
+
+int main(void) {
+  dspInit();
+  char dir[] = "/tmp/stream-XXXXXX";
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "Failed to make a temporary directory\n");
+    return 1;
+  }
+  char path[64];
+  int failed = 0;
+
+  // impossible headers
+  int refused = 0;
+  int bad[][3] = {{0, 16, SAMPLE_RATE}, {2, 0, SAMPLE_RATE}, {2, 16, 0}};
+  Streamer s = makeStreamer(TRACKS);
+  for (int i = 0; i < 3; i++) {
+    snprintf(path, sizeof(path), "%s/bad%d.wav", dir, i);
+    StreamClip c = NULL;
+    if (writeHeader(path, bad[i][0], bad[i][1], bad[i][2])) {
+      c = streamerOpen(s, path, PREFETCH_SECONDS);
+      refused += !c;
+    }
+    if (c) {
+      streamerClose(s, c);
+    }
+    unlink(path);
+  }
+  printf("headers with no channels, no bits or no rate refused: %d of 3\n",
+         refused);
+  failed |= refused != 3;
+
+  struct Track *tracks = calloc(TRACKS, sizeof(struct Track));
+  for (int t = 0; t < TRACKS; t++) {
+    snprintf(path, sizeof(path), "%s/track%d.wav", dir, t);
+    if (!writeTrack(path, t)) {
+      fprintf(stderr, "Failed to write %s\n", path);
+      return 1;
+    }
+  }
+  uint64_t opening = clockNanos();
+  for (int t = 0; t < TRACKS; t++) {
+    snprintf(path, sizeof(path), "%s/track%d.wav", dir, t);
+    tracks[t].clip = streamerOpen(s, path, PREFETCH_SECONDS);
+    tracks[t].reference = openAudioFile(path);
+    if (!tracks[t].clip || !tracks[t].reference) {
+      fprintf(stderr, "Failed to open %s\n", path);
+      return 1;
+    }
+    tracks[t].frames = audioFileFormat(tracks[t].reference).frames;
+  }
+  printf("%d tracks opened and primed in %.1f ms\n", TRACKS,
+         (clockNanos() - opening) / 1e6);
+
+  // the session in real time, the bench thread standing in for the device
+  float left[BLOCK], right[BLOCK], reference[BLOCK * 2];
+  float *out[] = {left, right};
+  uint64_t *seekNanos = malloc(MAX_SEEKS * sizeof(uint64_t));
+  int seeks = 0, blocks = PLAY_SECONDS * SAMPLE_RATE / BLOCK;
+  long mismatches = 0;
+  uint64_t checked = 0, busiest = 0;
+  unsigned rng = 1;
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  for (int b = 0; b < blocks; b++) {
+    uint64_t start = clockNanos();
+    if (b % SEEK_EVERY == SEEK_EVERY - 1) {
+      for (int i = 0; i < SEEKS_AT_ONCE; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        struct Track *t = &tracks[(rng >> 8) % TRACKS];
+        rng = rng * 1664525u + 1013904223u;
+        if (!t->seeking) {
+          seekTrack(t, (rng >> 8) % t->frames);
+        }
+      }
+    }
+
+    for (int i = 0; i < TRACKS; i++) {
+      struct Track *t = &tracks[i];
+      int got = streamClipRead(t->clip, out, 2, BLOCK);
+      if (t->seeking && got > 0) {
+        t->seeking = 0;
+        if (seeks < MAX_SEEKS) {
+          seekNanos[seeks++] = clockNanos() - t->seekStart;
+        }
+      }
+      if (got > 0) {
+        int n = readAudioFile(t->reference, t->position, reference, got);
+        mismatches += (long)(got - n);
+        for (int f = 0; f < n; f++) {
+          mismatches += left[f] != reference[f * 2];
+          mismatches += right[f] != reference[f * 2 + 1];
+        }
+        checked += got;
+        t->position += got;
+      }
+      if (!t->seeking && t->position >= t->frames) {
+        seekTrack(t, 0);
+      }
+    }
+    uint64_t took = clockNanos() - start;
+    busiest = took > busiest ? took : busiest;
+
+    next.tv_nsec += 1000000000L / SAMPLE_RATE * BLOCK;
+    while (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+
+  uint64_t underruns = streamerUnderruns(s);
+  qsort(seekNanos, seeks, sizeof(uint64_t), compareUint64);
+  double blockMs = 1e3 * BLOCK / SAMPLE_RATE;
+  printf("%d tracks for %d s: %llu frames checked against the files, %ld "
+         "mismatching\n",
+         TRACKS, PLAY_SECONDS, (unsigned long long)checked, mismatches);
+  printf("%llu underruns, busiest block %.2f ms of %.2f\n",
+         (unsigned long long)underruns, busiest / 1e6, blockMs);
+  if (seeks > 0) {
+    printf("%d seeks playing again after p50 %.1f ms, p99 %.1f ms, max %.1f "
+           "ms\n",
+           seeks, seekNanos[seeks / 2] / 1e6, seekNanos[seeks * 99 / 100] / 1e6,
+           seekNanos[seeks - 1] / 1e6);
+  }
+  failed |= mismatches != 0 || checked == 0 || underruns != 0 || seeks == 0;
+
+  for (int t = 0; t < TRACKS; t++) {
+    streamerClose(s, tracks[t].clip);
+    closeAudioFile(tracks[t].reference);
+    snprintf(path, sizeof(path), "%s/track%d.wav", dir, t);
+    unlink(path);
+  }
+  freeStreamer(s);
+  rmdir(dir);
+  free(seekNanos);
+  free(tracks);
+  return failed;
+}
@@ -0,0 +1,340 @@
+// time stretching: at ratio 1 and no shift the output has to be the input
+// delayed by the reported latency, how the blocks fall mustn't change a
+// thing, a stretched tone has to keep its pitch and a shifted one move by
+// the interval, and transients have to come out sharper with their phases
+// reset than without. a live stretcher has to keep up block for block, and
+// a render has to be the streamed output without its latency, cached. then
+// how many stereo instances a core runs in real time. results go to the json
+// file named on the command line, if any, for bench-compare
+#include "dsp.h"
+#include "samplecache.h"
+#include "stats.h"
+#include "stretch.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 48000
+#define FFT 2048
+#define LENGTH (RATE * 2)
+#define CLICK_APART 12000
+#define BLOCK 256
+#define MAX_BLOCK 4096
+
+struct Signal {
+  float *channels[2];
+  int length;
+};
+
+struct Load {
+  Stretch stretch;
+  const float *in[2];
+  float *out[2];
+  float *input, *output;
+};
+
+static struct Signal makeSignal(int length) {
+  struct Signal s = {{malloc(length * sizeof(float)),
+                      malloc(length * sizeof(float))},
+                     length};
+  return s;
+}
+
+static void freeSignal(struct Signal s) {
+  free(s.channels[0]);
+  free(s.channels[1]);
+}
+
+static struct Signal tone(double frequency) {
+  struct Signal s = makeSignal(LENGTH);
+  for (int i = 0; i < LENGTH; i++) {
+    s.channels[0][i] = s.channels[1][i] =
+        0.5f * (float)sin(2 * DSP_PI * frequency * i / RATE);
+  }
+  return s;
+}
+
+// chords and a little noise, something with partials everywhere
+static struct Signal music(void) {
+  struct Signal s = makeSignal(LENGTH);
+  srand(1);
+  for (int i = 0; i < LENGTH; i++) {
+    double t = (double)i / RATE;
+    double x = 0.2 * sin(2 * DSP_PI * 220 * t) +
+               0.15 * sin(2 * DSP_PI * 277.2 * t) +
+               0.1 * sin(2 * DSP_PI * 329.6 * t + 1) +
+               0.05 * sin(2 * DSP_PI * 1760 * t);
+    float noise = 0.01f * ((float)rand() / RAND_MAX - 0.5f);
+    s.channels[0][i] = (float)x + noise;
+    s.channels[1][i] = (float)(0.8 * x) - noise;
+  }
+  return s;
+}
+
+static struct Signal clicks(void) {
+  struct Signal s = makeSignal(LENGTH);
+  for (int i = 0; i < LENGTH; i++) {
+    s.channels[0][i] = s.channels[1][i] =
+        i % CLICK_APART == CLICK_APART / 2 ? 1.0f : 0.0f;
+  }
+  return s;
+}
+
+// the whole signal through `s` pulled in blocks from `blocks`, cycled, into
+// `frames` of output. the source runs out into silence
+static struct Signal stretchAll(Stretch s, struct Signal in, int frames,
+                                const int *blocks, int blockCount) {
+  struct Signal out = makeSignal(frames);
+  float *pad[2] = {malloc(64 * MAX_BLOCK * sizeof(float)),
+                   malloc(64 * MAX_BLOCK * sizeof(float))};
+  int read = 0, written = 0;
+  for (int b = 0; written < frames; b++) {
+    int block = blocks[b % blockCount];
+    block = block < frames - written ? block : frames - written;
+    int need = stretchInputFrames(s, block);
+    const float *from[2];
+    float *to[2];
+    for (int ch = 0; ch < 2; ch++) {
+      int have = read < in.length ? in.length - read : 0;
+      have = have < need ? have : need;
+      memcpy(pad[ch], in.channels[ch] + read, have * sizeof(float));
+      memset(pad[ch] + have, 0, (need - have) * sizeof(float));
+      from[ch] = pad[ch];
+      to[ch] = out.channels[ch] + written;
+    }
+    written += stretchProcess(s, from, need, to, block);
+    read += need;
+  }
+  free(pad[0]);
+  free(pad[1]);
+  return out;
+}
+
+static Stretch makeConfigured(double ratio, double semitones, int transients) {
+  Stretch s = makeStretch(2, FFT, MAX_BLOCK, 0);
+  stretchSetRatio(s, ratio);
+  stretchSetPitch(s, semitones);
+  stretchSetTransients(s, transients);
+  return s;
+}
+
+// from interpolated upward zero crossings of the middle half
+static double measureFrequency(const float *x, int length) {
+  double first = -1, last = -1;
+  int crossings = 0;
+  for (int i = length / 4; i < length * 3 / 4; i++) {
+    if (x[i - 1] < 0 && x[i] >= 0) {
+      double at = i - 1 + x[i - 1] / (x[i - 1] - x[i]);
+      first = first < 0 ? at : first;
+      last = at;
+      crossings++;
+    }
+  }
+  return crossings > 1 ? (crossings - 1) * RATE / (last - first) : 0;
+}
+
+static double rms(const float *x, int from, int to) {
+  double sum = 0;
+  for (int i = from; i < to; i++) {
+    sum += (double)x[i] * x[i];
+  }
+  return sqrt(sum / (to - from));
+}
+
+// how much of the energy around each click is in its loudest sample, 1 for a
+// perfect click
+static double sharpness(const float *y, int frames, double ratio,
+                        int latency) {
+  double total = 0;
+  int count = 0;
+  for (int c = CLICK_APART / 2; c < LENGTH - CLICK_APART; c += CLICK_APART) {
+    int centre = (int)(c * ratio) + latency;
+    double peak = 0, energy = 0;
+    for (int i = centre - FFT; i < centre + FFT && i < frames; i++) {
+      double e = (double)y[i] * y[i];
+      peak = e > peak ? e : peak;
+      energy += e;
+    }
+    if (energy > 0) {
+      total += peak / energy;
+      count++;
+    }
+  }
+  return count ? total / count : 0;
+}
+
+static int synthesize(void *state, float *const *channels, uint64_t frames) {
+  struct Signal *s = state;
+  for (int ch = 0; ch < 2; ch++) {
+    memcpy(channels[ch], s->channels[ch], frames * sizeof(float));
+  }
+  return 1;
+}
+
+static void blockBody(void *state, long iterations) {
+  struct Load *l = state;
+  for (long i = 0; i < iterations; i++) {
+    int need = stretchInputFrames(l->stretch, BLOCK);
+    stretchProcess(l->stretch, l->in, need, l->out, BLOCK);
+  }
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  int failed = 0;
+  int steady[] = {BLOCK};
+  int uneven[] = {1, 700, 64, 4096, 333, 2, 1500};
+
+  // ratio 1 and no shift gives the input back, from where four frames
+  // overlap
+  struct Signal m = music();
+  Stretch s = makeConfigured(1, 0, 1);
+  int latency = stretchLatency(s);
+  struct Signal same = stretchAll(s, m, LENGTH, steady, 1);
+  double error = 0;
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = FFT; i < LENGTH; i++) {
+      double e = fabs(same.channels[ch][i] - m.channels[ch][i - latency]);
+      error = e > error ? e : error;
+    }
+  }
+  printf("ratio 1 is the input %d frames late: %s, %.1g off at most\n",
+         latency, error < 1e-4 ? "yes" : "no", error);
+  failed |= error >= 1e-4;
+  freeStretch(s);
+  freeSignal(same);
+
+  // however the blocks fall
+  int frames = (int)(LENGTH * 1.37);
+  s = makeConfigured(1.37, 2, 1);
+  struct Signal a = stretchAll(s, m, frames, steady, 1);
+  freeStretch(s);
+  s = makeConfigured(1.37, 2, 1);
+  struct Signal b = stretchAll(s, m, frames, uneven, 7);
+  freeStretch(s);
+  int blockFree = memcmp(a.channels[0], b.channels[0],
+                         frames * sizeof(float)) == 0 &&
+                  memcmp(a.channels[1], b.channels[1],
+                         frames * sizeof(float)) == 0;
+  printf("blocking changes nothing: %s\n", blockFree ? "yes" : "no");
+  failed |= !blockFree;
+  freeSignal(b);
+
+  // pitch and level through a stretch, and a shift
+  struct Signal t = tone(440);
+  double ratios[] = {1.5, 0.7, 1};
+  double shifts[] = {0, 0, 7};
+  for (int i = 0; i < 3; i++) {
+    int length = (int)(LENGTH * ratios[i]);
+    s = makeConfigured(ratios[i], shifts[i], 1);
+    struct Signal y = stretchAll(s, t, length, steady, 1);
+    double expected = 440 * pow(2, shifts[i] / 12);
+    double frequency = measureFrequency(y.channels[0], length);
+    double level = 20 * log10(rms(y.channels[0], length / 4, length * 3 / 4) /
+                              rms(t.channels[0], LENGTH / 4, LENGTH * 3 / 4));
+    int ok = fabs(frequency - expected) < expected * 0.002 && fabs(level) < 1;
+    printf("440 Hz at ratio %.2f shifted %+.0f: %.1f Hz, %+.2f dB, %s\n",
+           ratios[i], shifts[i], frequency, level, ok ? "ok" : "wrong");
+    failed |= !ok;
+    freeStretch(s);
+    freeSignal(y);
+  }
+
+  // clicks stretched, with their phases reset and without
+  struct Signal k = clicks();
+  frames = (int)(LENGTH * 1.5);
+  s = makeConfigured(1.5, 0, 1);
+  struct Signal kept = stretchAll(s, k, frames, steady, 1);
+  uint64_t transients = stretchTransients(s);
+  freeStretch(s);
+  s = makeConfigured(1.5, 0, 0);
+  struct Signal smeared = stretchAll(s, k, frames, steady, 1);
+  freeStretch(s);
+  double sharp = sharpness(kept.channels[0], frames, 1.5, latency);
+  double blunt = sharpness(smeared.channels[0], frames, 1.5, latency);
+  printf("clicks at ratio 1.5: %.3f of their energy in the peak with "
+         "transients kept, %.3f without, %llu transient frames\n",
+         sharp, blunt, (unsigned long long)transients);
+  failed |= !(sharp > 2 * blunt);
+  freeSignal(kept);
+  freeSignal(smeared);
+
+  // live, a block in and a block out every time, an impulse arrives at the
+  // latency
+  s = makeStretch(1, FFT, BLOCK, 1);
+  float impulse[BLOCK] = {1}, silence[BLOCK] = {0}, out[BLOCK];
+  const float *in[1];
+  float *to[1] = {out};
+  int full = 1, arrived = -1;
+  for (int block = 0; block < 32; block++) {
+    in[0] = block ? silence : impulse;
+    full &= stretchProcess(s, in, BLOCK, to, BLOCK) == BLOCK;
+    for (int i = 0; i < BLOCK; i++) {
+      if (fabsf(out[i]) > 0.5f) {
+        arrived = block * BLOCK + i;
+      }
+    }
+  }
+  printf("live: full blocks %s, impulse at %d of latency %d\n",
+         full ? "yes" : "no", arrived, stretchLatency(s));
+  failed |= !full || arrived != stretchLatency(s);
+  freeStretch(s);
+
+  // rendered once and cached, the stream without its latency. pitches past
+  // the limit are the limit, so they share one render
+  SampleCache cache = makeSampleCache(64 << 20);
+  Sample source = sampleCacheDerive(cache, 1, 2, RATE, LENGTH, synthesize, &m);
+  Sample rendered = stretchRender(cache, source, 1.37, 2, FFT);
+  Sample again = stretchRender(cache, source, 1.37, 2, FFT);
+  Sample other = stretchRender(cache, source, 1.25, 2, FFT);
+  Sample high = stretchRender(cache, source, 1.25, 30, FFT);
+  Sample higher = stretchRender(cache, source, 1.25, 40, FFT);
+  frames = (int)sampleFrames(rendered);
+  int matches = frames == (int)llround(LENGTH * 1.37);
+  for (int ch = 0; ch < 2 && matches; ch++) {
+    matches = memcmp(sampleChannel(rendered, ch), a.channels[ch] + latency,
+                     (frames - latency) * sizeof(float)) == 0;
+  }
+  struct SampleCacheStats stats = sampleCacheStats(cache);
+  int cached = again == rendered && other != rendered && higher == high &&
+               stats.hits == 2 && stats.misses == 4;
+  printf("render is the stream less its latency: %s, cached: %s\n",
+         matches ? "yes" : "no", cached ? "yes" : "no");
+  failed |= !matches || !cached;
+  sampleRelease(higher);
+  sampleRelease(high);
+  sampleRelease(other);
+  sampleRelease(again);
+  sampleRelease(rendered);
+  sampleRelease(source);
+  freeSampleCache(cache);
+  freeSignal(a);
+
+  // a stereo loop following the tempo, shifted too
+  struct Load l;
+  l.stretch = makeConfigured(1.25, 3, 1);
+  l.input = malloc(2 * MAX_BLOCK * sizeof(float));
+  l.output = malloc(2 * BLOCK * sizeof(float));
+  for (int ch = 0; ch < 2; ch++) {
+    memcpy(l.input + ch * MAX_BLOCK, m.channels[ch], MAX_BLOCK * sizeof(float));
+    l.in[ch] = l.input + ch * MAX_BLOCK;
+    l.out[ch] = l.output + ch * BLOCK;
+  }
+  BenchReport r = makeBenchReport("stretch");
+  struct BenchResult block =
+      benchRun(r, "stretch/block", "256 stereo frames", blockBody, &l);
+  double deadline = 1e9 * BLOCK / RATE;
+  printf("%.1f%% of a core per stereo instance, %.0f instances in real time\n",
+         100 * block.median / deadline, deadline / block.median);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  freeBenchReport(r);
+  freeStretch(l.stretch);
+  free(l.input);
+  free(l.output);
+  freeSignal(m);
+  freeSignal(t);
+  freeSignal(k);
+  return failed || !written;
+}
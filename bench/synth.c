@@ -0,0 +1,172 @@
+// the synth: every vector kernel has to play a dense random part the way
+// the scalar one does, a full pool has to steal, and released voices have to
+// come free. then how many voices one core keeps up with at 48 kHz in 64
+// frame blocks, per kernel. results go to the json file named on the command
+// line, if any, for bench-compare
+#include "rtmem.h"
+#include "stats.h"
+#include "synth.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK 64
+#define VOICES 64
+#define BLOCKS 4000 // four seconds or so
+#define EVENTS_PER_BLOCK 4
+#define TOLERANCE 1e-5f // of the peak, the kernels sum voices in other orders
+
+struct Load {
+  Synth synth;
+  float out[BLOCK];
+};
+
+// the isas with a kernel of their own
+static const enum DspIsa kernels[] = {DSP_SCALAR, DSP_AVX2, DSP_AVX512};
+static const char *kernelNames[] = {"scalar", "avx2", "avx512"};
+#define KERNELS 3
+
+// random note ons and offs over four octaves, most blocks busy
+static int randomEvents(unsigned *seed, struct MidiEvent *events) {
+  int count = 0;
+  uint32_t offset = 0;
+  for (int e = 0; e < EVENTS_PER_BLOCK; e++) {
+    *seed = *seed * 1664525u + 1013904223u;
+    offset += *seed >> 8 & 15;
+    if (offset >= BLOCK) {
+      break;
+    }
+    uint8_t pitch = 36 + (*seed >> 16) % 48;
+    uint8_t type = *seed >> 28 & 1 ? MIDI_NOTE_ON : MIDI_NOTE_OFF;
+    events[count++] = (struct MidiEvent){offset, type, pitch, 100};
+  }
+  return count;
+}
+
+// plays the same part with a kernel and with the scalar reference, on few
+// enough voices that some get stolen
+static int sameAsScalar(int kernel) {
+  Synth reference = makeSynth(SAMPLE_RATE, VOICES / 4, NULL);
+  Synth s = makeSynth(SAMPLE_RATE, VOICES / 4, NULL);
+  synthUseKernel(reference, DSP_SCALAR);
+  synthUseKernel(s, kernels[kernel]);
+  synthSetParam(reference, SYNTH_RESONANCE, 0.8f);
+  synthSetParam(s, SYNTH_RESONANCE, 0.8f);
+
+  unsigned seed = 1;
+  float a[BLOCK], b[BLOCK];
+  float peak = 0, error = 0;
+  int voicesMatch = 1;
+  for (int block = 0; block < BLOCKS; block++) {
+    struct MidiEvent events[EVENTS_PER_BLOCK];
+    int count = randomEvents(&seed, events);
+    synthRender(reference, events, count, a, BLOCK);
+    synthRender(s, events, count, b, BLOCK);
+    for (int i = 0; i < BLOCK; i++) {
+      peak = fabsf(a[i]) > peak ? fabsf(a[i]) : peak;
+      error = fabsf(a[i] - b[i]) > error ? fabsf(a[i] - b[i]) : error;
+    }
+    voicesMatch &= synthActiveVoices(reference) == synthActiveVoices(s);
+  }
+  int same = voicesMatch && peak > 0 && error <= TOLERANCE * peak &&
+             synthStolenVoices(reference) == synthStolenVoices(s);
+  printf("%-6s vs scalar: peak %.3f, error %.2g, %llu stolen: %s\n",
+         kernelNames[kernel], peak, error,
+         (unsigned long long)synthStolenVoices(s), same ? "same" : "DIFFERS");
+  freeSynth(reference);
+  freeSynth(s);
+  return same;
+}
+
+// more notes than voices, held, then let go of
+static int stealsAndFrees(void) {
+  Synth s = makeSynth(SAMPLE_RATE, 16, NULL);
+  float out[BLOCK];
+  struct MidiEvent events[40];
+  for (int i = 0; i < 40; i++) {
+    events[i] = (struct MidiEvent){i, MIDI_NOTE_ON, 30 + i, 90};
+  }
+
+  // a debug build aborts if a note on allocates
+  rtThreadEnter();
+  synthRender(s, events, 40, out, BLOCK);
+  int held = synthActiveVoices(s);
+  uint64_t stolen = synthStolenVoices(s);
+  struct MidiEvent off = {0, MIDI_ALL_NOTES_OFF, 0, 0};
+  synthRender(s, &off, 1, out, BLOCK);
+  int blocks = 1;
+  while (synthActiveVoices(s) > 0 && blocks < SAMPLE_RATE / BLOCK) {
+    synthRender(s, NULL, 0, out, BLOCK);
+    blocks++;
+  }
+  // nothing left to render
+  synthRender(s, NULL, 0, out, BLOCK);
+  rtThreadLeave();
+
+  float silence = 0;
+  for (int i = 0; i < BLOCK; i++) {
+    silence += fabsf(out[i]);
+  }
+  printf("40 notes on 16 voices: %d sounding, %llu stolen, free %.0f ms "
+         "after release\n",
+         held, (unsigned long long)stolen, blocks * BLOCK * 1e3 / SAMPLE_RATE);
+  int ok = held == 16 && stolen == 24 && synthActiveVoices(s) == 0 &&
+           silence == 0;
+  freeSynth(s);
+  return ok;
+}
+
+static void loadBody(void *state, long iterations) {
+  struct Load *l = state;
+  for (long i = 0; i < iterations; i++) {
+    synthRender(l->synth, NULL, 0, l->out, BLOCK);
+  }
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  int failed = !stealsAndFrees();
+  for (int k = 1; k < KERNELS; k++) {
+    if (dspKernels(kernels[k])) {
+      failed |= !sameAsScalar(k);
+    }
+  }
+
+  // every voice held at sustain, a chord spread over the keyboard
+  BenchReport r = makeBenchReport("synth");
+  double blockNanos = 1e9 * BLOCK / SAMPLE_RATE;
+  for (int k = 0; k < KERNELS; k++) {
+    struct Load l;
+    l.synth = makeSynth(SAMPLE_RATE, VOICES, NULL);
+    if (!synthUseKernel(l.synth, kernels[k])) {
+      freeSynth(l.synth);
+      continue;
+    }
+    struct MidiEvent events[VOICES];
+    for (int v = 0; v < VOICES; v++) {
+      events[v] = (struct MidiEvent){0, MIDI_NOTE_ON, 24 + v, 100};
+    }
+    synthRender(l.synth, events, VOICES, l.out, BLOCK);
+    for (int b = 0; b < SAMPLE_RATE / BLOCK; b++) {
+      synthRender(l.synth, NULL, 0, l.out, BLOCK);
+    }
+
+    char name[64], unit[32];
+    snprintf(name, sizeof(name), "synth/%s/%d voices", kernelNames[k],
+             VOICES);
+    snprintf(unit, sizeof(unit), "%d frames", BLOCK);
+    struct BenchResult b = benchRun(r, name, unit, loadBody, &l);
+    printf("  %.0f voices per core at %d Hz, %d frame blocks\n",
+           VOICES * blockNanos / b.median, SAMPLE_RATE, BLOCK);
+    failed |= synthActiveVoices(l.synth) != VOICES;
+    freeSynth(l.synth);
+  }
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  if (!written) {
+    fprintf(stderr, "can't write %s\n", argv[1]);
+  }
+  freeBenchReport(r);
+  return failed || !written;
+}
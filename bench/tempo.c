@@ -0,0 +1,221 @@
+// the tempo map: conversions have to agree with the closed forms on a known
+// ramp, round trip, stay continuous across segments, count bars through time
+// signature changes, and come out the same batched, cursored or not. then
+// what a conversion costs sequentially, at random, batched, and by walking
+// the points from the start the way a map without a segment table would.
+// results go to the json file named on the command line, if any, for
+// bench-compare
+#include "dsp.h"
+#include "stats.h"
+#include "tempo.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 48000
+#define POINTS 1000
+#define BEATS_APART 16
+#define BATCH 4096
+
+struct Load {
+  TempoMap map;
+  double beats[BATCH];
+  double shuffled[BATCH];
+  double out[BATCH];
+  double sink;
+};
+
+static TempoMap makeSong(void) {
+  struct TempoPoint *points = malloc(POINTS * sizeof(struct TempoPoint));
+  for (int i = 0; i < POINTS; i++) {
+    int signature = i / 50 % 3;
+    points[i] = (struct TempoPoint){
+        .beat = i * BEATS_APART,
+        .bpm = 90 + (i * 37) % 80,
+        .ramp = i % 3 == 0,
+        .numerator = signature == 0 ? 4 : signature == 1 ? 3 : 7,
+        .denominator = signature == 2 ? 8 : 4,
+    };
+  }
+  TempoMap m = makeTempoMap(points, POINTS, SAMPLE_RATE);
+  free(points);
+  return m;
+}
+
+// how it'd go without the table: every segment from the start, each time
+static double walkedSample(TempoMap m, double beat) {
+  const struct TempoPoint *p = tempoPoints(m);
+  int count = tempoCount(m);
+  double sample = 0;
+  for (int i = 0; i < count; i++) {
+    double end = i + 1 < count ? p[i + 1].beat : INFINITY;
+    double beats = (beat < end ? beat : end) - p[i].beat;
+    double v0 = p[i].bpm / (60.0 * SAMPLE_RATE);
+    if (p[i].ramp && i + 1 < count && p[i + 1].bpm != p[i].bpm) {
+      double v1 = p[i + 1].bpm / (60.0 * SAMPLE_RATE);
+      double a = (v1 - v0) * (v1 + v0) / (2 * (end - p[i].beat));
+      sample += 2 * beats / (v0 + sqrt(v0 * v0 + 2 * a * beats));
+    } else {
+      sample += beats / v0;
+    }
+    if (beat < end) {
+      break;
+    }
+  }
+  return sample;
+}
+
+static void sequentialBody(void *state, long iterations) {
+  struct Load *l = state;
+  struct TempoCursor c = {0};
+  for (long it = 0; it < iterations; it++) {
+    for (int i = 0; i < BATCH; i++) {
+      l->sink += tempoSampleAt(l->map, &c, l->beats[i]);
+    }
+  }
+}
+
+static void randomBody(void *state, long iterations) {
+  struct Load *l = state;
+  struct TempoCursor c = {0};
+  for (long it = 0; it < iterations; it++) {
+    for (int i = 0; i < BATCH; i++) {
+      l->sink += tempoSampleAt(l->map, &c, l->shuffled[i]);
+    }
+  }
+}
+
+static void batchBody(void *state, long iterations) {
+  struct Load *l = state;
+  struct TempoCursor c = {0};
+  for (long it = 0; it < iterations; it++) {
+    tempoSamplesAt(l->map, &c, l->beats, l->out, BATCH);
+    l->sink += l->out[BATCH - 1];
+  }
+}
+
+static void walkBody(void *state, long iterations) {
+  struct Load *l = state;
+  for (long it = 0; it < iterations; it++) {
+    for (int i = 0; i < BATCH; i++) {
+      l->sink += walkedSample(l->map, l->beats[i]);
+    }
+  }
+}
+
+// 120 to 180 bpm evenly over 16 beats takes 6.4 s, and is at 150 halfway in
+static int checkRamp(void) {
+  struct TempoPoint points[] = {
+      {0, 120, 1, 4, 4},
+      {16, 180, 0, 4, 4},
+  };
+  TempoMap m = makeTempoMap(points, 2, SAMPLE_RATE);
+  struct TempoCursor c = {0};
+  double end = tempoSampleAt(m, &c, 16);
+  double halfway = tempoBeatAt(m, &c, 3.2 * SAMPLE_RATE);
+  double bpm = tempoBpmAt(m, &c, halfway);
+  int ok = fabs(end - 6.4 * SAMPLE_RATE) < 1e-6 && fabs(bpm - 150) < 1e-9 &&
+           fabs(tempoBpmAt(m, &c, 20) - 180) < 1e-9;
+  printf("ramp: 16 beats in %.6f s, %.6f bpm halfway\n", end / SAMPLE_RATE,
+         bpm);
+  tempoRelease(m);
+  return ok;
+}
+
+// 4/4 for a bar and a half, then 3/4 from a fresh bar
+static int checkBars(void) {
+  struct TempoPoint points[] = {
+      {0, 120, 0, 4, 4},
+      {6, 100, 0, 3, 4},
+  };
+  TempoMap m = makeTempoMap(points, 2, SAMPLE_RATE);
+  struct TempoCursor c = {0};
+  int ok = tempoBarAt(m, &c, 5) == 1.25 && tempoBarAt(m, &c, 6) == 2 &&
+           tempoBarAt(m, &c, 9) == 3 && tempoBeatAtBar(m, &c, 3) == 9 &&
+           tempoSignatureAt(m, &c, 7).numerator == 3;
+  tempoRelease(m);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  dspInit();
+  struct Load *l = malloc(sizeof(struct Load));
+  l->map = makeSong();
+  l->sink = 0;
+  double span = (double)POINTS * BEATS_APART;
+  srand(1);
+  for (int i = 0; i < BATCH; i++) {
+    l->beats[i] = span * i / BATCH;
+    l->shuffled[i] = span * rand() / RAND_MAX;
+  }
+
+  int failed = !checkRamp();
+  int bars = checkBars();
+  printf("bars across a time signature change: %s\n", bars ? "ok" : "wrong");
+  failed |= !bars;
+
+  // round trips, continuity, against the walk, and cursors against none
+  struct TempoCursor c = {0}, d = {0};
+  double roundTrip = 0, jump = 0, walked = 0;
+  int cursorsAgree = 1;
+  for (int i = 0; i < BATCH; i++) {
+    double beat = l->shuffled[i];
+    struct TempoCursor fresh = {0};
+    double sample = tempoSampleAt(l->map, &c, beat);
+    cursorsAgree &= sample == tempoSampleAt(l->map, &fresh, beat);
+    roundTrip = fmax(roundTrip, fabs(tempoBeatAt(l->map, &d, sample) - beat));
+    walked = fmax(walked, fabs(walkedSample(l->map, beat) - sample));
+  }
+  for (int p = 1; p < POINTS; p++) {
+    double at = p * BEATS_APART;
+    double before = tempoSampleAt(l->map, &c, nextafter(at, 0));
+    jump = fmax(jump, fabs(tempoSampleAt(l->map, &c, at) - before));
+  }
+  printf("round trip %.2g beats, jump at a boundary %.2g samples, "
+         "walk %.2g samples\n",
+         roundTrip, jump, walked);
+  failed |= roundTrip > 1e-9 || jump > 1e-3 || walked > 1e-3 || !cursorsAgree;
+
+  // batched, ascending and shuffled, in place, both ways, and as pixels
+  int batched = 1;
+  for (int order = 0; order < 2; order++) {
+    double *beats = order ? l->shuffled : l->beats;
+    struct TempoCursor fresh = {0};
+    tempoSamplesAt(l->map, &fresh, beats, l->out, BATCH);
+    for (int i = 0; i < BATCH; i++) {
+      batched &= l->out[i] == tempoSampleAt(l->map, &c, beats[i]);
+    }
+    double samples[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+      samples[i] = l->out[i];
+    }
+    tempoBeatsAt(l->map, &fresh, l->out, l->out, BATCH);
+    for (int i = 0; i < BATCH; i++) {
+      batched &= l->out[i] == tempoBeatAt(l->map, &c, samples[i]);
+    }
+    tempoPixelsAt(l->map, &fresh, beats, l->out, BATCH, 1e6, 1.0 / 512);
+    for (int i = 0; i < BATCH; i++) {
+      batched &= fabs(l->out[i] - (samples[i] - 1e6) / 512) < 1e-6;
+    }
+  }
+  printf("batches match single lookups: %s\n", batched ? "yes" : "no");
+  failed |= !batched;
+
+  BenchReport r = makeBenchReport("tempo");
+  struct BenchResult sequential =
+      benchRun(r, "tempo/sequential", "4096 beats", sequentialBody, l);
+  benchRun(r, "tempo/random", "4096 beats", randomBody, l);
+  struct BenchResult batch =
+      benchRun(r, "tempo/batch", "4096 beats", batchBody, l);
+  struct BenchResult walk =
+      benchRun(r, "tempo/walk", "4096 beats", walkBody, l);
+  printf("%d points: %.1f ns a beat sequential, %.1f batched, %.0f walking\n",
+         POINTS, sequential.median / BATCH, batch.median / BATCH,
+         walk.median / BATCH);
+
+  int written = argc < 2 || benchWrite(r, argv[1]);
+  freeBenchReport(r);
+  tempoRelease(l->map);
+  free(l);
+  return failed || !written;
+}
@@ -0,0 +1,38 @@
+#include "arena.h"
+
+#include "rtmem.h"
+#include "spsc.h"
+
+struct Arena {
+  unsigned char *memory;
+  size_t capacity;
+  size_t used;
+};
+
+Arena makeArena(size_t capacity) {
+  Arena a = rtAlloc(sizeof(struct Arena));
+  a->memory = rtAlloc(capacity);
+  a->capacity = capacity;
+  a->used = 0;
+  return a;
+}
+
+void freeArena(Arena a) {
+  rtFree(a->memory, a->capacity);
+  rtFree(a, sizeof(struct Arena));
+}
+
+void *arenaAlloc(Arena a, size_t size) {
+  // cache line alignment keeps scratch buffers friendly to simd loads
+  size_t start =
+      (a->used + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  if (start > a->capacity || size > a->capacity - start) {
+    return NULL;
+  }
+  a->used = start + size;
+  return a->memory + start;
+}
+
+void arenaReset(Arena a) { a->used = 0; }
+
+size_t arenaUsed(Arena a) { return a->used; }
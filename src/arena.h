@@ -0,0 +1,19 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// bump allocator for temporary buffers inside one audio block. locked and
+// touched up front, single threaded, reset it before every use. returns NULL
+// when full. the scheduler keeps one per worker and hands it to every node
+// it runs, see ProcessContext.scratch
+typedef struct Arena *Arena;
+
+Arena makeArena(size_t capacity);
+void freeArena(Arena a);
+
+void *arenaAlloc(Arena a, size_t size);
+void arenaReset(Arena a);
+size_t arenaUsed(Arena a);
+
+#endif
@@ -0,0 +1,434 @@
+#define _DEFAULT_SOURCE
+#include "audiofile.h"
+
+#include "dsp.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#define WAV_HEADER_SIZE 44
+#define MAX_CHANNELS 256
+#define MAX_SAMPLE_RATE 768000
+#define WRITE_CHUNK_SAMPLES 16384
+
+struct AudioFile {
+  struct AudioFormat format;
+  const uint8_t *map;
+  size_t mapSize;
+  const uint8_t *data; // first frame
+};
+
+struct AudioWriter {
+  FILE *file;
+  struct AudioFormat format;
+  uint8_t *encoded; // WRITE_CHUNK_SAMPLES samples
+  int failed;
+};
+
+// PRIVATE FUNCTIONS
+
+static uint32_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t le32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint32_t be16(const uint8_t *p) { return p[0] << 8 | p[1]; }
+
+static uint32_t be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         (uint32_t)p[3];
+}
+
+// AIFF stores the sample rate as an 80 bit IEEE 754 extended float
+static double be80(const uint8_t *p) {
+  int exponent = ((p[0] & 0x7F) << 8 | p[1]) - 16383;
+  uint64_t mantissa = (uint64_t)be32(p + 2) << 32 | be32(p + 6);
+  double value = ldexp((double)mantissa, exponent - 63);
+  return p[0] & 0x80 ? -value : value;
+}
+
+// headers are untrusted, nothing is worked out from them until they pass
+static int validLayout(int channels, double sampleRate) {
+  return channels > 0 && channels <= MAX_CHANNELS && sampleRate >= 1 &&
+         sampleRate <= MAX_SAMPLE_RATE;
+}
+
+static int formatFromBits(int bits, int isFloat, enum SampleFormat *format) {
+  if (isFloat) {
+    *format = SAMPLE_FLOAT32;
+    return bits == 32;
+  }
+  switch (bits) {
+  case 16:
+    *format = SAMPLE_INT16;
+    return 1;
+  case 24:
+    *format = SAMPLE_INT24;
+    return 1;
+  case 32:
+    *format = SAMPLE_INT32;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static int parseWav(AudioFile f) {
+  const uint8_t *p = f->map + 12;
+  const uint8_t *end = f->map + f->mapSize;
+  int haveFormat = 0;
+
+  while (p + 8 <= end) {
+    uint32_t size = le32(p + 4);
+    const uint8_t *body = p + 8;
+    if (size > (size_t)(end - body)) {
+      size = end - body; // truncated file, use what's there
+    }
+
+    if (memcmp(p, "fmt ", 4) == 0 && size >= 16) {
+      int tag = le16(body);
+      if (tag == WAVE_FORMAT_EXTENSIBLE && size >= 40) {
+        tag = le16(body + 24); // first two bytes of the subformat guid
+      }
+      int bits = le16(body + 14);
+      int channels = le16(body + 2);
+      uint32_t sampleRate = le32(body + 4);
+      if ((tag != WAVE_FORMAT_PCM && tag != WAVE_FORMAT_IEEE_FLOAT) ||
+          !validLayout(channels, sampleRate) ||
+          !formatFromBits(bits, tag == WAVE_FORMAT_IEEE_FLOAT,
+                          &f->format.sampleFormat)) {
+        return 0;
+      }
+      f->format.channels = channels;
+      f->format.sampleRate = (int)sampleRate;
+      f->format.bigEndian = 0;
+      f->format.bytesPerFrame = f->format.channels * bits / 8;
+      haveFormat = 1;
+    } else if (memcmp(p, "data", 4) == 0 && haveFormat) {
+      f->data = body;
+      f->format.frames = size / f->format.bytesPerFrame;
+      return 1;
+    }
+
+    p = body + size + (size & 1);
+  }
+  return 0;
+}
+
+static int parseAiff(AudioFile f, int compressed) {
+  const uint8_t *p = f->map + 12;
+  const uint8_t *end = f->map + f->mapSize;
+  int haveFormat = 0;
+  uint64_t declaredFrames = 0;
+
+  while (p + 8 <= end) {
+    uint32_t size = be32(p + 4);
+    const uint8_t *body = p + 8;
+    if (size > (size_t)(end - body)) {
+      size = end - body;
+    }
+
+    if (memcmp(p, "COMM", 4) == 0 && size >= 18) {
+      int bits = be16(body + 6);
+      int isFloat = 0;
+      int channels = be16(body);
+      double sampleRate = be80(body + 8);
+      if (!validLayout(channels, sampleRate)) {
+        return 0;
+      }
+      f->format.channels = channels;
+      f->format.sampleRate = (int)sampleRate;
+      f->format.bigEndian = 1;
+      declaredFrames = be32(body + 2);
+
+      if (compressed && size >= 22) {
+        const uint8_t *type = body + 18;
+        if (memcmp(type, "sowt", 4) == 0) {
+          f->format.bigEndian = 0;
+        } else if (memcmp(type, "fl32", 4) == 0 ||
+                   memcmp(type, "FL32", 4) == 0) {
+          isFloat = 1;
+          bits = 32;
+        } else if (memcmp(type, "NONE", 4) != 0) {
+          return 0;
+        }
+      }
+      if (!formatFromBits(bits, isFloat, &f->format.sampleFormat)) {
+        return 0;
+      }
+      f->format.bytesPerFrame = f->format.channels * bits / 8;
+      haveFormat = 1;
+    } else if (memcmp(p, "SSND", 4) == 0 && haveFormat && size >= 8) {
+      uint32_t offset = be32(body);
+      if (offset > size - 8) {
+        return 0;
+      }
+      f->data = body + 8 + offset;
+      f->format.frames = (size - 8 - offset) / f->format.bytesPerFrame;
+      if (declaredFrames < f->format.frames) {
+        f->format.frames = declaredFrames;
+      }
+      return 1;
+    }
+
+    p = body + size + (size & 1);
+  }
+  return 0;
+}
+
+// the general path: any endianness, any alignment
+static void decodeBytes(const struct AudioFormat *format, const uint8_t *src,
+                        float *dst, int samples) {
+  int bytes = format->bytesPerFrame / format->channels;
+  for (int i = 0; i < samples; i++, src += bytes) {
+    uint8_t b[4];
+    for (int j = 0; j < bytes; j++) {
+      b[j] = format->bigEndian ? src[bytes - 1 - j] : src[j];
+    }
+    switch (format->sampleFormat) {
+    case SAMPLE_INT16:
+      dst[i] = (int16_t)le16(b) * (1.0f / 32767.0f);
+      break;
+    case SAMPLE_INT24:
+      // assemble in the top bits so the shift back sign extends
+      dst[i] = ((int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 |
+                          (uint32_t)b[2] << 24) >>
+                8) *
+               (1.0f / 8388607.0f);
+      break;
+    case SAMPLE_INT32:
+      dst[i] = (float)((int32_t)le32(b) * (1.0 / 2147483647.0));
+      break;
+    case SAMPLE_FLOAT32: {
+      uint32_t bits = le32(b);
+      memcpy(&dst[i], &bits, sizeof(float));
+      break;
+    }
+    }
+  }
+}
+
+static void putLe16(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8 & 0xFF;
+}
+
+static void putLe32(uint8_t *p, uint32_t v) {
+  putLe16(p, v & 0xFFFF);
+  putLe16(p + 2, v >> 16);
+}
+
+static void encodeWavHeader(const struct AudioFormat *format, uint8_t *h) {
+  // RIFF sizes are 32 bit, longer files are clamped and only the first 4GB
+  // are addressable by most readers anyway
+  uint64_t data = format->frames * format->bytesPerFrame;
+  if (data > UINT32_MAX - WAV_HEADER_SIZE) {
+    data = UINT32_MAX - WAV_HEADER_SIZE;
+  }
+  int bytes = format->bytesPerFrame / format->channels;
+
+  memcpy(h, "RIFF", 4);
+  putLe32(h + 4, (uint32_t)(WAV_HEADER_SIZE - 8 + data));
+  memcpy(h + 8, "WAVE", 4);
+  memcpy(h + 12, "fmt ", 4);
+  putLe32(h + 16, 16);
+  putLe16(h + 20, format->sampleFormat == SAMPLE_FLOAT32
+                      ? WAVE_FORMAT_IEEE_FLOAT
+                      : WAVE_FORMAT_PCM);
+  putLe16(h + 22, format->channels);
+  putLe32(h + 24, format->sampleRate);
+  putLe32(h + 28, format->sampleRate * format->bytesPerFrame);
+  putLe16(h + 32, format->bytesPerFrame);
+  putLe16(h + 34, bytes * 8);
+  memcpy(h + 36, "data", 4);
+  putLe32(h + 40, (uint32_t)data);
+}
+
+static void encodeSamples(enum SampleFormat format, const float *src,
+                          uint8_t *dst, int samples) {
+  switch (format) {
+  case SAMPLE_INT16:
+    dsp->floatToInt16((int16_t *)dst, src, samples);
+    break;
+  case SAMPLE_INT24:
+    dsp->floatToInt24(dst, src, samples);
+    break;
+  case SAMPLE_INT32:
+    for (int i = 0; i < samples; i++) {
+      float x = src[i];
+      x = x > 1.0f ? 1.0f : x < -1.0f ? -1.0f : x;
+      putLe32(dst + i * 4, (uint32_t)(int32_t)lrint(x * 2147483647.0));
+    }
+    break;
+  case SAMPLE_FLOAT32:
+    memcpy(dst, src, samples * sizeof(float));
+    break;
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+AudioFile openAudioFile(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 12) {
+    close(fd);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  AudioFile f = calloc(1, sizeof(struct AudioFile));
+  f->map = map;
+  f->mapSize = st.st_size;
+
+  int ok = 0;
+  if (memcmp(f->map, "RIFF", 4) == 0 && memcmp(f->map + 8, "WAVE", 4) == 0) {
+    ok = parseWav(f);
+  } else if (memcmp(f->map, "FORM", 4) == 0 &&
+             memcmp(f->map + 8, "AIFF", 4) == 0) {
+    ok = parseAiff(f, 0);
+  } else if (memcmp(f->map, "FORM", 4) == 0 &&
+             memcmp(f->map + 8, "AIFC", 4) == 0) {
+    ok = parseAiff(f, 1);
+  }
+  if (!ok) {
+    closeAudioFile(f);
+    return NULL;
+  }
+
+  // streaming reads go front to back
+  posix_madvise((void *)f->map, f->mapSize, POSIX_MADV_SEQUENTIAL);
+  return f;
+}
+
+void closeAudioFile(AudioFile f) {
+  munmap((void *)f->map, f->mapSize);
+  free(f);
+}
+
+struct AudioFormat audioFileFormat(AudioFile f) { return f->format; }
+
+int readAudioFile(AudioFile f, uint64_t frame, float *interleaved, int frames) {
+  if (frame >= f->format.frames) {
+    return 0;
+  }
+  if ((uint64_t)frames > f->format.frames - frame) {
+    frames = (int)(f->format.frames - frame);
+  }
+
+  const uint8_t *src = f->data + frame * f->format.bytesPerFrame;
+  int samples = frames * f->format.channels;
+
+  // little-endian data goes through the simd kernels
+  if (!f->format.bigEndian && f->format.sampleFormat == SAMPLE_INT16 &&
+      ((uintptr_t)src & 1) == 0) {
+    dsp->int16ToFloat(interleaved, (const int16_t *)src, samples);
+  } else if (!f->format.bigEndian && f->format.sampleFormat == SAMPLE_INT24) {
+    dsp->int24ToFloat(interleaved, src, samples);
+  } else if (!f->format.bigEndian &&
+             f->format.sampleFormat == SAMPLE_FLOAT32) {
+    memcpy(interleaved, src, samples * sizeof(float));
+  } else {
+    decodeBytes(&f->format, src, interleaved, samples);
+  }
+  return frames;
+}
+
+void prefetchAudioFile(AudioFile f, uint64_t frame, uint64_t frames) {
+  if (frame >= f->format.frames) {
+    return;
+  }
+  if (frames > f->format.frames - frame) {
+    frames = f->format.frames - frame;
+  }
+
+  // madvise wants page-aligned addresses
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)(f->data + frame * f->format.bytesPerFrame);
+  uintptr_t end = start + frames * f->format.bytesPerFrame;
+  start &= ~(uintptr_t)(page - 1);
+  posix_madvise((void *)start, end - start, POSIX_MADV_WILLNEED);
+}
+
+AudioWriter openWavWriter(const char *path, int channels, int sampleRate,
+                          enum SampleFormat format) {
+  static const int sampleBytes[] = {
+      [SAMPLE_INT16] = 2,
+      [SAMPLE_INT24] = 3,
+      [SAMPLE_INT32] = 4,
+      [SAMPLE_FLOAT32] = 4,
+  };
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return NULL;
+  }
+
+  AudioWriter w = calloc(1, sizeof(struct AudioWriter));
+  w->file = file;
+  w->format = (struct AudioFormat){
+      .channels = channels,
+      .sampleRate = sampleRate,
+      .sampleFormat = format,
+      .bytesPerFrame = channels * sampleBytes[format],
+  };
+  w->encoded = malloc((size_t)WRITE_CHUNK_SAMPLES * sampleBytes[format]);
+
+  // placeholder sizes until close
+  uint8_t header[WAV_HEADER_SIZE];
+  encodeWavHeader(&w->format, header);
+  w->failed = fwrite(header, sizeof(header), 1, file) != 1;
+  return w;
+}
+
+int writeAudioFile(AudioWriter w, const float *interleaved, int frames) {
+  int channels = w->format.channels;
+  int bytes = w->format.bytesPerFrame / channels;
+  long samples = (long)frames * channels;
+
+  for (long done = 0; done < samples && !w->failed;) {
+    int n = samples - done < WRITE_CHUNK_SAMPLES ? (int)(samples - done)
+                                                 : WRITE_CHUNK_SAMPLES;
+    encodeSamples(w->format.sampleFormat, interleaved + done, w->encoded, n);
+    w->failed = fwrite(w->encoded, (size_t)n * bytes, 1, w->file) != 1;
+    done += n;
+  }
+  if (!w->failed) {
+    w->format.frames += frames;
+  }
+  return !w->failed;
+}
+
+int closeAudioWriter(AudioWriter w) {
+  uint8_t header[WAV_HEADER_SIZE];
+  encodeWavHeader(&w->format, header);
+
+  int ok = !w->failed;
+  ok = ok && fseek(w->file, 0, SEEK_SET) == 0;
+  ok = ok && fwrite(header, sizeof(header), 1, w->file) == 1;
+  ok = fclose(w->file) == 0 && ok;
+
+  free(w->encoded);
+  free(w);
+  return ok;
+}
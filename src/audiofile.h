@@ -0,0 +1,54 @@
+#ifndef AUDIOFILE_H
+#define AUDIOFILE_H
+
+#include <stdint.h>
+
+enum SampleFormat {
+  SAMPLE_INT16,
+  SAMPLE_INT24,
+  SAMPLE_INT32,
+  SAMPLE_FLOAT32,
+};
+
+struct AudioFormat {
+  int channels;
+  int sampleRate;
+  enum SampleFormat sampleFormat;
+  int bigEndian;
+  int bytesPerFrame;
+  uint64_t frames;
+};
+
+// a memory-mapped WAV or AIFF/AIFC file, PCM 16/24/32 bit or 32 bit float.
+// reading touches the mapping, so it belongs on an i/o thread.
+typedef struct AudioFile *AudioFile;
+
+// returns NULL if the file can't be read or isn't a supported format
+AudioFile openAudioFile(const char *path);
+void closeAudioFile(AudioFile f);
+
+struct AudioFormat audioFileFormat(AudioFile f);
+
+// decode up to `frames` frames starting at `frame` into interleaved floats,
+// returns how many were decoded (fewer at the end of the file)
+int readAudioFile(AudioFile f, uint64_t frame, float *interleaved, int frames);
+
+// hint the kernel to start reading a region in the background
+void prefetchAudioFile(AudioFile f, uint64_t frame, uint64_t frames);
+
+// a WAV file being written front to back. the header is patched with the
+// final sizes on close, so a crashed export leaves a file with zero frames
+// rather than a truncated one claiming to be complete.
+typedef struct AudioWriter *AudioWriter;
+
+// returns NULL if the file can't be created
+AudioWriter openWavWriter(const char *path, int channels, int sampleRate,
+                          enum SampleFormat format);
+
+// encode interleaved floats, returns 0 on a write error
+int writeAudioFile(AudioWriter w, const float *interleaved, int frames);
+
+// returns 0 if anything failed since the writer was opened
+int closeAudioWriter(AudioWriter w);
+
+#endif
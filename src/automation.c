@@ -0,0 +1,325 @@
+#include "automation.h"
+
+#include "die.h"
+#include "dsp.h"
+#include "lane.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// how far a cursor walks forward before it gives up and searches
+#define CURSOR_STEPS 4
+
+struct Automation {
+  atomic_int references;
+  int count;
+  struct Breakpoint points[];
+};
+
+struct AutomationLane {
+  Lane curves;
+  struct AutomationCursor cursor; // audio thread
+};
+
+_Static_assert(sizeof(struct Breakpoint) == 24,
+               "the automation layer reads breakpoints as vertex data");
+
+// PRIVATE FUNCTIONS
+
+static Automation allocate(int count) {
+  Automation a = malloc(sizeof(struct Automation) +
+                        (size_t)count * sizeof(struct Breakpoint));
+  atomic_init(&a->references, 1);
+  a->count = count;
+  return a;
+}
+
+struct Sortable {
+  struct Breakpoint point;
+  int index;
+};
+
+static int compareSortable(const void *x, const void *y) {
+  const struct Sortable *a = x, *b = y;
+  if (a->point.position != b->point.position) {
+    return a->point.position < b->point.position ? -1 : 1;
+  }
+  return a->index - b->index;
+}
+
+// index of the last point at or before `position`, -1 if there is none
+static int search(Automation a, uint64_t position) {
+  int low = 0, high = a->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (a->points[mid].position <= position) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low - 1;
+}
+
+static int locate(Automation a, struct AutomationCursor *c, uint64_t position) {
+  int s = c->segment;
+  if (c->curve == a && s < a->count &&
+      (s < 0 || a->points[s].position <= position)) {
+    for (int step = 0; step < CURSOR_STEPS; step++) {
+      if (s + 1 == a->count || a->points[s + 1].position > position) {
+        c->segment = s;
+        return s;
+      }
+      s++;
+    }
+  }
+  c->curve = a;
+  c->segment = search(a, position);
+  return c->segment;
+}
+
+// everything but point `skip`, plus `point` where it sorts
+static Automation rebuild(Automation a, int skip,
+                          const struct Breakpoint *point) {
+  Automation b = allocate(a->count - (skip >= 0) + (point != NULL));
+  int written = 0;
+  for (int i = 0; i < a->count; i++) {
+    if (i == skip) {
+      continue;
+    }
+    if (point && a->points[i].position > point->position) {
+      b->points[written++] = *point;
+      point = NULL;
+    }
+    b->points[written++] = a->points[i];
+  }
+  if (point) {
+    b->points[written++] = *point;
+  }
+  return b;
+}
+
+// `t` from 0 to 1 along the segment starting at `p`
+static double segmentValue(const struct Breakpoint *p, double t) {
+  double v0 = p->value, v1 = p[1].value;
+  switch (p->shape) {
+  case AUTOMATION_HOLD:
+    return v0;
+  case AUTOMATION_EXPONENTIAL:
+    if (v0 * v1 > 0) {
+      return v0 * pow(v1 / v0, t);
+    }
+    break;
+  case AUTOMATION_BEZIER: {
+    double s = 1 - t;
+    return s * s * s * v0 + 3 * s * s * t * p->control[0] +
+           3 * s * t * t * p->control[1] + t * t * t * v1;
+  }
+  }
+  return v0 + (v1 - v0) * t;
+}
+
+// n values of the segment starting at `p`, from `offset` samples into it
+static void fillSegment(const struct Breakpoint *p, uint64_t offset,
+                        float *out, int n) {
+  double length = (double)(p[1].position - p->position);
+  double alpha = offset / length, beta = 1 / length;
+  double v0 = p->value, v1 = p[1].value;
+  double c0 = p->control[0], c1 = p->control[1];
+
+  // the segment as a cubic in t, a0 is v0
+  double a1 = v1 - v0, a2 = 0, a3 = 0;
+  switch (p->shape) {
+  case AUTOMATION_HOLD:
+    dsp->cubic(out, p->value, 0, 0, 0, n);
+    return;
+  case AUTOMATION_EXPONENTIAL:
+    if (v0 * v1 > 0) {
+      double ratio = v1 / v0;
+      dsp->geometric(out, (float)(v0 * pow(ratio, alpha)),
+                     (float)pow(ratio, beta), n);
+      return;
+    }
+    break;
+  case AUTOMATION_BEZIER:
+    a1 = 3 * (c0 - v0);
+    a2 = 3 * (v0 - 2 * c0 + c1);
+    a3 = v1 - v0 + 3 * (c0 - c1);
+    break;
+  }
+
+  // t = alpha + beta i, expanded around this stretch's first sample so the
+  // kernel only has to step i
+  dsp->cubic(out, (float)(v0 + alpha * (a1 + alpha * (a2 + alpha * a3))),
+             (float)(beta * (a1 + alpha * (2 * a2 + alpha * 3 * a3))),
+             (float)(beta * beta * (a2 + alpha * 3 * a3)),
+             (float)(beta * beta * beta * a3), n);
+}
+
+static void retainCurve(void *item) { automationRetain(item); }
+
+static int dropCurve(void *item) {
+  Automation a = item;
+  return atomic_fetch_sub_explicit(&a->references, 1, memory_order_acq_rel) ==
+         1;
+}
+
+static const struct LaneItems curveItems = {retainCurve, dropCurve, free};
+
+// PUBLIC FUNCTIONS
+
+Automation makeAutomation(const struct Breakpoint *points, int count) {
+  if (count < 1) {
+    return NULL;
+  }
+  struct Sortable *sorted = malloc(count * sizeof(struct Sortable));
+  for (int i = 0; i < count; i++) {
+    sorted[i] = (struct Sortable){points[i], i};
+  }
+  qsort(sorted, count, sizeof(struct Sortable), compareSortable);
+
+  Automation a = allocate(count);
+  for (int i = 0; i < count; i++) {
+    a->points[i] = sorted[i].point;
+  }
+  free(sorted);
+  return a;
+}
+
+void automationRetain(Automation a) {
+  atomic_fetch_add_explicit(&a->references, 1, memory_order_relaxed);
+}
+
+void automationRelease(Automation a) {
+  if (a && atomic_fetch_sub_explicit(&a->references, 1,
+                                     memory_order_acq_rel) == 1) {
+    free(a);
+  }
+}
+
+int automationCount(Automation a) { return a->count; }
+
+const struct Breakpoint *automationPoints(Automation a) { return a->points; }
+
+size_t automationBytes(Automation a) {
+  return sizeof(struct Automation) +
+         (size_t)a->count * sizeof(struct Breakpoint);
+}
+
+Automation automationInsert(Automation a, struct Breakpoint point) {
+  return rebuild(a, -1, &point);
+}
+
+Automation automationRemove(Automation a, int index) {
+  if (index < 0 || index >= a->count) {
+    die("Invalid breakpoint %d of %d\n", index, a->count);
+  }
+  return a->count > 1 ? rebuild(a, index, NULL) : NULL;
+}
+
+Automation automationReplace(Automation a, int index,
+                             struct Breakpoint point) {
+  if (index < 0 || index >= a->count) {
+    die("Invalid breakpoint %d of %d\n", index, a->count);
+  }
+  return rebuild(a, index, &point);
+}
+
+int automationVisible(Automation a, uint64_t start, uint64_t end, int *first) {
+  int from = search(a, start);
+  from = from < 0 ? 0 : from;
+  int to = search(a, end);
+  if (to < 0 || a->points[to].position < end) {
+    to = to + 1 < a->count ? to + 1 : a->count - 1;
+  }
+  *first = from;
+  return to - from + 1;
+}
+
+float automationValue(Automation a, struct AutomationCursor *cursor,
+                      uint64_t position) {
+  int s = locate(a, cursor, position);
+  if (s < 0) {
+    return a->points[0].value;
+  }
+  const struct Breakpoint *p = a->points + s;
+  if (s + 1 == a->count) {
+    return p->value;
+  }
+  double t = (double)(position - p->position) /
+             (double)(p[1].position - p->position);
+  return (float)segmentValue(p, t);
+}
+
+void automationRender(Automation a, struct AutomationCursor *cursor,
+                      uint64_t position, float *out, int frames) {
+  int done = 0;
+  while (done < frames) {
+    uint64_t at = position + done;
+    int s = locate(a, cursor, at);
+    int left = frames - done;
+
+    // before the first point or past the last, the value holds
+    if (s < 0 || s + 1 == a->count) {
+      const struct Breakpoint *p = a->points + (s < 0 ? 0 : s);
+      int n = left;
+      if (s < 0 && a->points[0].position - at < (uint64_t)left) {
+        n = (int)(a->points[0].position - at);
+      }
+      dsp->cubic(out + done, p->value, 0, 0, 0, n);
+      done += n;
+      continue;
+    }
+
+    const struct Breakpoint *p = a->points + s;
+    uint64_t remaining = p[1].position - at;
+    int n = remaining < (uint64_t)left ? (int)remaining : left;
+    fillSegment(p, at - p->position, out + done, n);
+    done += n;
+  }
+}
+
+AutomationLane makeAutomationLane(Automation curve) {
+  AutomationLane l = calloc(1, sizeof(struct AutomationLane));
+  l->curves = makeLane(&curveItems, curve, 1);
+  return l;
+}
+
+void freeAutomationLane(AutomationLane l) {
+  freeLane(l->curves);
+  free(l);
+}
+
+void automationLaneSet(AutomationLane l, Automation curve) {
+  laneSet(l->curves, curve);
+}
+
+void automationLaneCollect(AutomationLane l) { laneCollect(l->curves); }
+
+Automation automationLaneDisplay(AutomationLane l) {
+  return laneDisplay(l->curves);
+}
+
+void automationLaneProcess(void *state, const struct ProcessContext *ctx) {
+  AutomationLane l = state;
+  void *replaced;
+  if (lanePickUp(l->curves, &replaced)) {
+    laneRetire(l->curves, replaced);
+    l->cursor = (struct AutomationCursor){NULL, -1};
+  }
+  Automation curve = laneCurrent(l->curves);
+  if (ctx->outputCount < 1) {
+    return;
+  }
+
+  float *out = ctx->outputs[0];
+  if (!curve) {
+    memset(out, 0, ctx->frames * sizeof(float));
+  } else if (ctx->playing) {
+    automationRender(curve, &l->cursor, ctx->position, out, ctx->frames);
+  } else {
+    float value = automationValue(curve, &l->cursor, ctx->position);
+    dsp->cubic(out, value, 0, 0, 0, ctx->frames);
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef AUTOMATION_H
+#define AUTOMATION_H
+
+#include "graph.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// parameter automation: breakpoints on the timeline, joined by shaped
+// segments. the audio thread renders a block of values at a time, the
+// automation layer draws straight from the same breakpoints. a curve never
+// changes once made, an edit builds a new one, so every thread reads the
+// version it holds without locking.
+typedef struct Automation *Automation;
+
+// how the value travels from a breakpoint to the next one
+enum AutomationShape {
+  AUTOMATION_HOLD, // stays put, jumps at the next breakpoint
+  AUTOMATION_LINEAR,
+  // a constant ratio per sample. linear when the ends differ in sign or one
+  // of them is zero
+  AUTOMATION_EXPONENTIAL,
+  // cubic bezier in value, `control` are the inner control values. time
+  // runs evenly along the segment
+  AUTOMATION_BEZIER,
+};
+
+// also the vertex layout of the automation layer, which uploads these as is
+struct Breakpoint {
+  uint64_t position; // samples
+  float value;
+  uint32_t shape; // enum AutomationShape, of the segment starting here
+  float control[2];
+};
+
+// sorts a copy of the points. points sharing a position keep their order,
+// the value jumps from the first to the last. NULL without points. the curve
+// holds before its first and after its last breakpoint.
+Automation makeAutomation(const struct Breakpoint *points, int count);
+
+// curves are shared by reference count, they start with one and the last
+// release frees them. not real-time safe, the audio side goes through a lane
+void automationRetain(Automation a);
+void automationRelease(Automation a);
+
+int automationCount(Automation a);
+const struct Breakpoint *automationPoints(Automation a);
+
+// memory the curve holds, for accounting
+size_t automationBytes(Automation a);
+
+// edits. each returns a new curve with one reference and leaves `a` alone.
+// an inserted point goes after any at the same position; removing the only
+// point returns NULL. dies on an index the curve doesn't have
+Automation automationInsert(Automation a, struct Breakpoint point);
+Automation automationRemove(Automation a, int index);
+Automation automationReplace(Automation a, int index, struct Breakpoint point);
+
+// the breakpoints that shape [start, end): from the last one at or before
+// `start` to the first one at or after `end`. returns how many, the index of
+// the first goes in `first`
+int automationVisible(Automation a, uint64_t start, uint64_t end, int *first);
+
+// remembers where the last lookup landed. playback moving forward finds the
+// next segment in constant time, a jump falls back to a binary search. zero
+// it to start, it notices when it's used with another curve
+struct AutomationCursor {
+  Automation curve;
+  int segment; // last breakpoint at or before the position, -1 before all
+};
+
+// the value at one position
+float automationValue(Automation a, struct AutomationCursor *cursor,
+                      uint64_t position);
+
+// real-time safe. `frames` values from `position` on, each segment filled by
+// one vector kernel call
+void automationRender(Automation a, struct AutomationCursor *cursor,
+                      uint64_t position, float *out, int frames);
+
+// one automated parameter shared by the ui, the audio thread and the render
+// thread. the ui publishes new curves, the other two pick up the newest one
+// when they next look, curves the audio thread lets go of are freed by the ui
+typedef struct AutomationLane *AutomationLane;
+
+// takes its own references to `curve`, which may be NULL for a lane with no
+// curve until the first is set
+AutomationLane makeAutomationLane(Automation curve);
+void freeAutomationLane(AutomationLane l);
+
+// ui thread. takes its own references, the caller keeps theirs. NULL, as
+// removing the only point gives, leaves the lane as it is
+void automationLaneSet(AutomationLane l, Automation curve);
+
+// ui thread. frees curves the audio thread has let go of, call it regularly
+void automationLaneCollect(AutomationLane l);
+
+// render thread. the newest curve, valid until the next call
+Automation automationLaneDisplay(AutomationLane l);
+
+// a node with no inputs and one output, the parameter at audio rate. the
+// state is the lane. while stopped it holds the value at the playhead, and
+// while the lane has no curve it's 0
+void automationLaneProcess(void *state, const struct ProcessContext *ctx);
+
+#endif
@@ -0,0 +1,221 @@
+#include "automationlayer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// breakpoints a frame draws at most, plus room for the held ends
+#define MAX_VISIBLE 4096
+
+// lines per segment, matches assets/automation.vert
+#define STEPS 32
+
+// matches the push constant block in assets/automation.vert
+struct AutomationPushConstants {
+  float rect[4];
+  float color[4];
+  struct Vec2 size;
+  float range[2];
+  uint32_t start[2];
+  float span;
+};
+
+static const float color[4] = {1.0f, 0.8f, 0.3f, 0.9f};
+
+struct AutomationLayer {
+  AutomationLane lane;
+  const struct TimelineView *view;
+  float rect[4];
+  float range[2];
+
+  // what the last frame showed, `version` moves whenever it changes
+  Automation curve;
+  uint64_t start, end;
+  uint64_t version;
+
+  // per frame in flight: mapped breakpoints, how many and which version
+  int framesInFlight;
+  struct VertexBufferAndMemory *buffers;
+  struct Breakpoint **mapped;
+  int *counts;
+  uint64_t *uploaded;
+
+  // vulkan
+  VkDevice device;
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
+
+// PRIVATE FUNCTIONS
+
+// the breakpoint buffer bound twice, the second binding one further on
+static struct VertexInput breakpointInput(void) {
+  static const VkVertexInputBindingDescription bindings[] = {
+      {0, sizeof(struct Breakpoint), VK_VERTEX_INPUT_RATE_INSTANCE},
+      {1, sizeof(struct Breakpoint), VK_VERTEX_INPUT_RATE_INSTANCE},
+  };
+  static const VkVertexInputAttributeDescription attributes[] = {
+      {0, 0, VK_FORMAT_R32G32_UINT, offsetof(struct Breakpoint, position)},
+      {1, 0, VK_FORMAT_R32_SFLOAT, offsetof(struct Breakpoint, value)},
+      {2, 0, VK_FORMAT_R32_UINT, offsetof(struct Breakpoint, shape)},
+      {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(struct Breakpoint, control)},
+      {4, 1, VK_FORMAT_R32G32_UINT, offsetof(struct Breakpoint, position)},
+      {5, 1, VK_FORMAT_R32_SFLOAT, offsetof(struct Breakpoint, value)},
+  };
+  return (struct VertexInput){bindings, 2, attributes, 6};
+}
+
+// copies the breakpoints shaping the view, with the held ends made explicit.
+// a lane without a curve draws nothing
+static int upload(struct AutomationLayer *l, struct Breakpoint *mapped) {
+  if (!l->curve) {
+    return 0;
+  }
+  int first;
+  int count = automationVisible(l->curve, l->start, l->end, &first);
+  const struct Breakpoint *points = automationPoints(l->curve) + first;
+  int last = first + count == automationCount(l->curve);
+  if (count > MAX_VISIBLE) {
+    count = MAX_VISIBLE;
+    last = 0;
+  }
+
+  int n = 0;
+  if (points[0].position > l->start) {
+    mapped[n] = points[0];
+    mapped[n].position = l->start;
+    mapped[n].shape = AUTOMATION_HOLD;
+    n++;
+  }
+  memcpy(mapped + n, points, count * sizeof(struct Breakpoint));
+  n += count;
+  if (last && mapped[n - 1].position < l->end) {
+    mapped[n - 1].shape = AUTOMATION_HOLD;
+    mapped[n] = mapped[n - 1];
+    mapped[n].position = l->end;
+    n++;
+  }
+  return n;
+}
+
+static void prepare(void *state, int frame, double time) {
+  (void)time;
+  struct AutomationLayer *l = state;
+
+  Automation curve = automationLaneDisplay(l->lane);
+  uint64_t start = atomic_load_explicit(&l->view->start, memory_order_relaxed);
+  uint64_t end = atomic_load_explicit(&l->view->end, memory_order_relaxed);
+  if (curve != l->curve || start != l->start || end != l->end) {
+    l->curve = curve;
+    l->start = start;
+    l->end = end > start ? end : start + 1;
+    l->version++;
+  }
+  if (l->uploaded[frame] != l->version) {
+    l->counts[frame] = upload(l, l->mapped[frame]);
+    l->uploaded[frame] = l->version;
+  }
+}
+
+static void record(void *state, VkCommandBuffer commandBuffer, int frame,
+                   double time, struct Vec2 size) {
+  (void)time;
+  struct AutomationLayer *l = state;
+  if (l->counts[frame] < 2) {
+    return;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    l->pipeline);
+
+  VkBuffer buffers[] = {l->buffers[frame].buffer, l->buffers[frame].buffer};
+  VkDeviceSize offsets[] = {0, sizeof(struct Breakpoint)};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+  struct AutomationPushConstants pushConstants = {
+      .size = size,
+      .range = {l->range[0], l->range[1]},
+      .start = {(uint32_t)l->start, (uint32_t)(l->start >> 32)},
+      .span = (float)(l->end - l->start),
+  };
+  memcpy(pushConstants.rect, l->rect, sizeof(l->rect));
+  memcpy(pushConstants.color, color, sizeof(color));
+  vkCmdPushConstants(commandBuffer, l->pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                     0, sizeof(struct AutomationPushConstants),
+                     &pushConstants);
+  vkCmdDraw(commandBuffer, STEPS * 6, l->counts[frame] - 1, 0, 0);
+}
+
+static void destroy(void *state) {
+  struct AutomationLayer *l = state;
+
+  for (int f = 0; f < l->framesInFlight; f++) {
+    vkUnmapMemory(l->device, l->buffers[f].memory);
+    vkDestroyBuffer(l->device, l->buffers[f].buffer, NULL);
+    vkFreeMemory(l->device, l->buffers[f].memory, NULL);
+  }
+  free(l->buffers);
+  free(l->mapped);
+  free(l->counts);
+  free(l->uploaded);
+
+  vkDestroyPipeline(l->device, l->pipeline, NULL);
+  vkDestroyPipelineLayout(l->device, l->pipelineLayout, NULL);
+  vkDestroyShaderModule(l->device, l->fragShader, NULL);
+  vkDestroyShaderModule(l->device, l->vertShader, NULL);
+
+  free(l);
+}
+
+// PUBLIC FUNCTIONS
+
+struct Layer makeAutomationLayer(struct RenderContext ctx, AutomationLane lane,
+                                 const struct TimelineView *view, float low,
+                                 float high, float x, float y, float width,
+                                 float height) {
+  struct AutomationLayer *l = calloc(1, sizeof(struct AutomationLayer));
+  l->lane = lane;
+  l->view = view;
+  l->rect[0] = x;
+  l->rect[1] = y;
+  l->rect[2] = width;
+  l->rect[3] = height;
+  l->range[0] = low;
+  l->range[1] = high;
+  l->device = ctx.device;
+  l->framesInFlight = ctx.framesInFlight;
+
+  // breakpoint buffers, mapped for good
+  VkDeviceSize size = (MAX_VISIBLE + 2) * sizeof(struct Breakpoint);
+  l->buffers = malloc(l->framesInFlight * sizeof(struct VertexBufferAndMemory));
+  l->mapped = malloc(l->framesInFlight * sizeof(struct Breakpoint *));
+  l->counts = calloc(l->framesInFlight, sizeof(int));
+  l->uploaded = calloc(l->framesInFlight, sizeof(uint64_t));
+  for (int f = 0; f < l->framesInFlight; f++) {
+    l->buffers[f] = makeVkHostBuffer(ctx.physicalDevice, ctx.device, size,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vkMapMemory(ctx.device, l->buffers[f].memory, 0, size, 0,
+                (void **)&l->mapped[f]);
+  }
+
+  // pipeline
+  l->vertShader = makeVkShaderModule(ctx.device, "bin/automation-vert.spv");
+  l->fragShader = makeVkShaderModule(ctx.device, "bin/automation-frag.spv");
+  l->pipelineLayout = makeVkPushConstantLayout(
+      ctx.device, sizeof(struct AutomationPushConstants),
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+  l->pipeline = makeVkPipelineWithInput(
+      ctx.device, ctx.swapchainSettings, l->vertShader, l->fragShader,
+      ctx.renderPass, l->pipelineLayout, breakpointInput());
+
+  return (struct Layer){
+      .state = l,
+      .prepare = prepare,
+      .record = record,
+      .destroy = destroy,
+  };
+}
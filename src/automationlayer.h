@@ -0,0 +1,17 @@
+#ifndef AUTOMATIONLAYER_H
+#define AUTOMATIONLAYER_H
+
+#include "automation.h"
+#include "renderer.h"
+
+// draws the lane's newest curve inside the given rectangle (window
+// coordinates), `view` picks the stretch of the timeline and `low`/`high`
+// the values at the bottom and top. only the breakpoints shaping the view
+// are uploaded, as they are, and the shader traces each segment between
+// them; nothing is uploaded while the curve and the view stay put.
+struct Layer makeAutomationLayer(struct RenderContext ctx, AutomationLane lane,
+                                 const struct TimelineView *view, float low,
+                                 float high, float x, float y, float width,
+                                 float height);
+
+#endif
@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bounce.h"
+
+#include "clock.h"
+#include "die.h"
+#include "dsp.h"
+#include "scheduler.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// blocks of headroom between the renderer and each writer
+#define QUEUE_BLOCKS 16
+
+// how often the progress callback runs
+#define PROGRESS_NANOS 50000000
+
+// how long either side sleeps on a full or empty queue
+#define WAIT_NANOS 100000
+
+struct StemWriter {
+  const struct BounceStem *stem;
+  AudioWriter writer;
+  Spsc queue; // whole interleaved frames, a read never splits one
+  const float **ports;
+  float *interleaved;
+  pthread_t thread;
+  atomic_int finished; // no more frames are coming
+  int ok;
+};
+
+// PRIVATE FUNCTIONS
+
+static void backOff(void) {
+  struct timespec wait = {0, WAIT_NANOS};
+  nanosleep(&wait, NULL);
+}
+
+static void *writeStem(void *arg) {
+  struct StemWriter *w = arg;
+  int channels = w->stem->channels;
+  float *samples = malloc((size_t)BOUNCE_BLOCK_SIZE * channels * sizeof(float));
+  if (!samples) {
+    die("Failed to allocate a stem buffer\n");
+  }
+
+  w->ok = 1;
+  for (;;) {
+    // read the flag first, anything queued before it was set is still seen
+    int finished = atomic_load_explicit(&w->finished, memory_order_acquire);
+    size_t n = spscRead(w->queue, samples, BOUNCE_BLOCK_SIZE);
+    if (n > 0) {
+      w->ok = writeAudioFile(w->writer, samples, (int)n) && w->ok;
+    } else if (finished) {
+      break;
+    } else {
+      backOff();
+    }
+  }
+
+  free(samples);
+  return NULL;
+}
+
+static void queueStem(struct StemWriter *w, CompiledGraph graph, int frames) {
+  int channels = w->stem->channels;
+  for (int ch = 0; ch < channels; ch++) {
+    w->ports[ch] = compiledOutput(graph, w->stem->node, ch);
+  }
+  dspInterleave(w->interleaved, w->ports, channels, frames);
+
+  size_t sent = 0;
+  while ((sent += spscWrite(w->queue, w->interleaved + sent * channels,
+                            frames - sent)) < (size_t)frames) {
+    backOff();
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+struct BounceResult bounce(CompiledGraph graph, const struct BounceStem *stems,
+                           int stemCount, struct BounceSettings settings) {
+  struct BounceResult result = {0};
+  int blockSize = compiledBlockSize(graph);
+  int workers = settings.workers;
+  if (workers <= 0) {
+    workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  size_t queueFrames = settings.queueFrames > 0
+                           ? (size_t)settings.queueFrames
+                           : (size_t)QUEUE_BLOCKS * blockSize;
+
+  // open everything before rendering anything
+  struct StemWriter *writers = calloc(stemCount, sizeof(struct StemWriter));
+  int opened = 0;
+  for (; opened < stemCount; opened++) {
+    const struct BounceStem *stem = &stems[opened];
+    if (stem->node < 0 || stem->node >= compiledNodeCount(graph) ||
+        stem->channels < 1 ||
+        stem->channels > compiledOutputCount(graph, stem->node)) {
+      break;
+    }
+    struct StemWriter *w = &writers[opened];
+    w->stem = stem;
+    w->writer = openWavWriter(stem->path, stem->channels, settings.sampleRate,
+                              stem->format);
+    if (!w->writer) {
+      break;
+    }
+    w->queue = makeSpsc(stem->channels * sizeof(float), queueFrames);
+    w->ports = malloc(stem->channels * sizeof(float *));
+    w->interleaved = malloc((size_t)blockSize * stem->channels * sizeof(float));
+    atomic_init(&w->finished, 0);
+    if (pthread_create(&w->thread, NULL, writeStem, w) != 0) {
+      die("Failed to start the writer of %s\n", stem->path);
+    }
+  }
+
+  uint64_t begin = clockNanos();
+  if (opened == stemCount) {
+    Scheduler scheduler =
+        makeScheduler(workers, compiledNodeCount(graph), 0);
+    uint64_t lastProgress = begin;
+
+    while (result.frames < settings.frames) {
+      uint64_t left = settings.frames - result.frames;
+      int frames = left < (uint64_t)blockSize ? (int)left : blockSize;
+      schedulerRun(scheduler, graph, frames, settings.start + result.frames,
+                   1);
+      for (int i = 0; i < stemCount; i++) {
+        queueStem(&writers[i], graph, frames);
+      }
+      result.frames += frames;
+
+      uint64_t now = clockNanos();
+      if (settings.progress && now - lastProgress >= PROGRESS_NANOS) {
+        lastProgress = now;
+        double audio = (double)result.frames / settings.sampleRate;
+        double fraction = (double)result.frames / settings.frames;
+        if (!settings.progress(settings.user, fraction,
+                               audio / ((now - begin) * 1e-9))) {
+          result.cancelled = 1;
+          break;
+        }
+      }
+    }
+    freeScheduler(scheduler);
+  }
+
+  // the writers drain whatever is queued, the export only counts once it's on
+  // disk
+  result.ok = opened == stemCount && !result.cancelled;
+  for (int i = 0; i < opened; i++) {
+    struct StemWriter *w = &writers[i];
+    atomic_store_explicit(&w->finished, 1, memory_order_release);
+    pthread_join(w->thread, NULL);
+    result.ok = closeAudioWriter(w->writer) && w->ok && result.ok;
+    freeSpsc(w->queue);
+    free(w->ports);
+    free(w->interleaved);
+  }
+  free(writers);
+
+  result.seconds = (clockNanos() - begin) * 1e-9;
+  if (result.seconds > 0) {
+    result.realtimeFactor =
+        (double)result.frames / settings.sampleRate / result.seconds;
+  }
+  if (result.ok && settings.progress) {
+    settings.progress(settings.user, 1.0, result.realtimeFactor);
+  }
+  return result;
+}
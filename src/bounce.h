@@ -0,0 +1,55 @@
+#ifndef BOUNCE_H
+#define BOUNCE_H
+
+#include "audiofile.h"
+#include "graph.h"
+
+// offline export: runs a compiled graph as fast as the cores allow, with no
+// device and no real-time deadline, and writes any number of node outputs to
+// WAV files in one pass. the work-stealing scheduler spreads independent
+// stems over the workers, and every stem gets its own writer thread so
+// encoding and disk i/o overlap with processing.
+//
+// the graph's nodes must not be running anywhere else meanwhile (stop the
+// engine or bounce a separate instance of the session).
+
+// offline blocks are larger than real-time ones, there is no latency to keep
+// down and every block costs a scheduler round trip
+#define BOUNCE_BLOCK_SIZE 2048
+
+struct BounceStem {
+  const char *path;
+  int node;     // node whose outputs get written
+  int channels; // output ports 0 .. channels - 1 become the file's channels
+  enum SampleFormat format;
+};
+
+// called on the bouncing thread, return 0 to cancel
+typedef int (*BounceProgressFunc)(void *user, double fraction,
+                                  double realtimeFactor);
+
+struct BounceSettings {
+  int sampleRate;
+  uint64_t start;  // transport position of the first frame, in samples
+  uint64_t frames; // how much to render
+  int workers;     // 0 for one per core
+  int queueFrames; // between the renderer and each writer, 0 for 16 blocks
+  BounceProgressFunc progress; // optional
+  void *user;
+};
+
+struct BounceResult {
+  int ok; // every stem written completely
+  int cancelled;
+  uint64_t frames;       // rendered per stem
+  double seconds;        // wall clock
+  double realtimeFactor; // seconds of audio per second of wall clock
+};
+
+// blocks until the export is done. files of cancelled or failed exports are
+// valid but short. a stem naming a node the graph doesn't have, or more
+// channels than its node has outputs, fails the export before anything runs
+struct BounceResult bounce(CompiledGraph graph, const struct BounceStem *stems,
+                           int stemCount, struct BounceSettings settings);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// monotonic time, safe to call from any thread including the audio thread
+uint64_t clockNanos(void);
+
+#endif
@@ -0,0 +1,366 @@
+#define _POSIX_C_SOURCE 200809L
+#include "convolver.h"
+
+#include "dsp.h"
+#include "fft.h"
+#include "rtmem.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// partition sizes go blockSize, 8x, 64x, 512x; the last tier takes whatever
+// is left of the response
+#define MAX_TIERS 4
+#define TIER_GROWTH 8
+
+// the background thread polls for work this often, the shortest background
+// partition is eight blocks so it's nowhere near its deadline
+#define WAIT_NANOS 100000
+
+// how long the audio thread spins on a late partition before yielding
+#define SPIN_ITERATIONS 1000
+
+// uniformly partitioned overlap-save: `partitions` partitions of `size` taps
+// starting at tap `offset`. per channel arrays are laid out back to back
+struct Tier {
+  int size;
+  int offset;
+  int partitions;
+  int blocks; // audio blocks per partition
+  int bins;   // size + 1
+  int realtime;
+  Fft fft; // 2 * size
+
+  // per channel: the filter spectra, a delay line of input spectra and the
+  // last two partitions of input
+  float *filterRe, *filterIm;
+  float *lineRe, *lineIm;
+  float *window;
+  int newest; // delay line slot of the newest input
+
+  // scratch
+  float *accRe, *accIm;
+  float *time;
+
+  // per channel, double buffered between the audio and background thread.
+  // the tier on the audio thread only uses the first of each
+  float *input[2];
+  float *output[2];
+
+  // partitions of input handed over and partitions of output finished
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t published;
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t completed;
+};
+
+struct Convolver {
+  int channels;
+  int length;
+  int blockSize;
+  uint64_t block;
+
+  // the first block of taps, reversed for dot products, and per channel the
+  // previous block of input followed by the current one
+  float *head;
+  float *history;
+  size_t headBytes, historyBytes;
+
+  struct Tier tiers[MAX_TIERS];
+  int tierCount;
+
+  _Atomic uint64_t late;
+  atomic_int running;
+  pthread_t thread;
+};
+
+// PRIVATE FUNCTIONS
+
+static void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// anything the audio thread touches is locked, background tiers can be
+// hundreds of megabytes for a long stereo response
+static float *allocFloats(size_t count, int realtime) {
+  return realtime ? rtAlloc(count * sizeof(float))
+                  : calloc(count, sizeof(float));
+}
+
+static void freeFloats(float *memory, size_t count, int realtime) {
+  if (realtime) {
+    rtFree(memory, count * sizeof(float));
+  } else {
+    free(memory);
+  }
+}
+
+static void makeTier(struct Tier *t, const float *const *responses,
+                     int channels, int length) {
+  size_t spectra = (size_t)channels * t->partitions * t->bins;
+  t->fft = makeFft(2 * t->size);
+  t->filterRe = allocFloats(spectra, t->realtime);
+  t->filterIm = allocFloats(spectra, t->realtime);
+  t->lineRe = allocFloats(spectra, t->realtime);
+  t->lineIm = allocFloats(spectra, t->realtime);
+  t->window = allocFloats((size_t)channels * 2 * t->size, t->realtime);
+  t->accRe = allocFloats(t->bins, t->realtime);
+  t->accIm = allocFloats(t->bins, t->realtime);
+  t->time = allocFloats(2 * t->size, t->realtime);
+
+  // the audio thread writes input and reads output of every tier
+  for (int i = 0; i < 2; i++) {
+    t->input[i] = allocFloats((size_t)channels * t->size, 1);
+    t->output[i] = allocFloats((size_t)channels * t->size, 1);
+  }
+  t->newest = 0;
+  atomic_init(&t->published, 0);
+  atomic_init(&t->completed, 0);
+
+  // each partition zero padded to twice its size, with the inverse
+  // transform's scaling folded in
+  float scale = 1.0f / (2 * t->size);
+  for (int ch = 0; ch < channels; ch++) {
+    for (int k = 0; k < t->partitions; k++) {
+      int first = t->offset + k * t->size;
+      memset(t->time, 0, 2 * t->size * sizeof(float));
+      for (int i = 0; i < t->size && first + i < length; i++) {
+        t->time[i] = responses[ch][first + i] * scale;
+      }
+      size_t at = ((size_t)ch * t->partitions + k) * t->bins;
+      fftForward(t->fft, t->time, t->filterRe + at, t->filterIm + at);
+    }
+  }
+}
+
+static void freeTier(struct Tier *t, int channels) {
+  size_t spectra = (size_t)channels * t->partitions * t->bins;
+  freeFloats(t->filterRe, spectra, t->realtime);
+  freeFloats(t->filterIm, spectra, t->realtime);
+  freeFloats(t->lineRe, spectra, t->realtime);
+  freeFloats(t->lineIm, spectra, t->realtime);
+  freeFloats(t->window, (size_t)channels * 2 * t->size, t->realtime);
+  freeFloats(t->accRe, t->bins, t->realtime);
+  freeFloats(t->accIm, t->bins, t->realtime);
+  freeFloats(t->time, 2 * t->size, t->realtime);
+  for (int i = 0; i < 2; i++) {
+    freeFloats(t->input[i], (size_t)channels * t->size, 1);
+    freeFloats(t->output[i], (size_t)channels * t->size, 1);
+  }
+  freeFft(t->fft);
+}
+
+// one partition of input in, one partition of output out
+static void runTier(struct Tier *t, int channels, int buffer) {
+  int size = t->size, bins = t->bins, partitions = t->partitions;
+  t->newest = (t->newest + partitions - 1) % partitions;
+
+  for (int ch = 0; ch < channels; ch++) {
+    float *window = t->window + (size_t)ch * 2 * size;
+    memmove(window, window + size, size * sizeof(float));
+    memcpy(window + size, t->input[buffer] + (size_t)ch * size,
+           size * sizeof(float));
+
+    size_t line = (size_t)ch * partitions * bins;
+    fftForward(t->fft, window, t->lineRe + line + t->newest * bins,
+               t->lineIm + line + t->newest * bins);
+
+    // the newest input meets the first partition, the oldest the last
+    memset(t->accRe, 0, bins * sizeof(float));
+    memset(t->accIm, 0, bins * sizeof(float));
+    for (int k = 0; k < partitions; k++) {
+      size_t slot = line + (size_t)((t->newest + k) % partitions) * bins;
+      size_t filter = line + (size_t)k * bins;
+      dsp->complexMac(t->accRe, t->accIm, t->lineRe + slot, t->lineIm + slot,
+                      t->filterRe + filter, t->filterIm + filter, bins);
+    }
+
+    // overlap-save, the second half is the part that didn't wrap around
+    fftInverse(t->fft, t->accRe, t->accIm, t->time);
+    memcpy(t->output[buffer] + (size_t)ch * size, t->time + size,
+           size * sizeof(float));
+  }
+}
+
+static void *background(void *arg) {
+  Convolver c = arg;
+  while (atomic_load_explicit(&c->running, memory_order_acquire)) {
+    // shortest partitions first, they have the closest deadlines
+    int worked = 0;
+    for (int i = 1; i < c->tierCount && !worked; i++) {
+      struct Tier *t = &c->tiers[i];
+      uint64_t done = atomic_load_explicit(&t->completed, memory_order_relaxed);
+      if (atomic_load_explicit(&t->published, memory_order_acquire) > done) {
+        runTier(t, c->channels, done & 1);
+        atomic_store_explicit(&t->completed, done + 1, memory_order_release);
+        worked = 1;
+      }
+    }
+    if (!worked) {
+      struct timespec wait = {0, WAIT_NANOS};
+      nanosleep(&wait, NULL);
+    }
+  }
+  return NULL;
+}
+
+static void waitFor(Convolver c, struct Tier *t, uint64_t partition) {
+  if (atomic_load_explicit(&t->completed, memory_order_acquire) > partition) {
+    return;
+  }
+  atomic_fetch_add_explicit(&c->late, 1, memory_order_relaxed);
+  for (int i = 0;
+       atomic_load_explicit(&t->completed, memory_order_acquire) <= partition;
+       i++) {
+    if (i < SPIN_ITERATIONS) {
+      cpuRelax();
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+static void processBlock(Convolver c, const float *const *in,
+                         float *const *out, int offset) {
+  int b = c->blockSize;
+
+  // direct form for the first block of taps
+  for (int ch = 0; ch < c->channels; ch++) {
+    float *history = c->history + (size_t)ch * 2 * b;
+    const float *head = c->head + (size_t)ch * b;
+    memcpy(history + b, in[ch] + offset, b * sizeof(float));
+    for (int i = 0; i < b; i++) {
+      out[ch][offset + i] = dsp->dot(head, history + i + 1, b);
+    }
+    memcpy(history, history + b, b * sizeof(float));
+  }
+
+  // the first tier starts one block in, so what it made from the previous
+  // block is due now
+  if (c->tierCount > 0) {
+    struct Tier *t = &c->tiers[0];
+    for (int ch = 0; ch < c->channels; ch++) {
+      dsp->add(out[ch] + offset, t->output[0] + (size_t)ch * b, b);
+      memcpy(t->input[0] + (size_t)ch * b, in[ch] + offset,
+             b * sizeof(float));
+    }
+    runTier(t, c->channels, 0);
+  }
+
+  // background tiers start two partitions in: one to collect the input, one
+  // for the background thread to work on it
+  for (int i = 1; i < c->tierCount; i++) {
+    struct Tier *t = &c->tiers[i];
+    uint64_t partition = c->block / t->blocks;
+    int slice = (int)(c->block % t->blocks) * b;
+
+    if (partition >= 2) {
+      uint64_t due = partition - 2;
+      if (slice == 0) {
+        waitFor(c, t, due);
+      }
+      for (int ch = 0; ch < c->channels; ch++) {
+        dsp->add(out[ch] + offset,
+                 t->output[due & 1] + (size_t)ch * t->size + slice, b);
+      }
+    }
+
+    for (int ch = 0; ch < c->channels; ch++) {
+      memcpy(t->input[partition & 1] + (size_t)ch * t->size + slice,
+             in[ch] + offset, b * sizeof(float));
+    }
+    if (slice + b == t->size) {
+      atomic_store_explicit(&t->published, partition + 1,
+                            memory_order_release);
+    }
+  }
+  c->block++;
+}
+
+// PUBLIC FUNCTIONS
+
+Convolver makeConvolver(const float *const *responses, int channels,
+                        int length, int blockSize) {
+  Convolver c = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Convolver));
+  memset(c, 0, sizeof(struct Convolver));
+  c->channels = channels;
+  c->length = length;
+  c->blockSize = blockSize;
+
+  c->headBytes = (size_t)channels * blockSize * sizeof(float);
+  c->historyBytes = 2 * c->headBytes;
+  c->head = rtAlloc(c->headBytes);
+  c->history = rtAlloc(c->historyBytes);
+  for (int ch = 0; ch < channels; ch++) {
+    for (int i = 0; i < blockSize && i < length; i++) {
+      c->head[(size_t)ch * blockSize + blockSize - 1 - i] = responses[ch][i];
+    }
+  }
+
+  // each tier ends where the next, eight times longer, can start
+  int size = blockSize, offset = blockSize;
+  while (offset < length && c->tierCount < MAX_TIERS) {
+    struct Tier *t = &c->tiers[c->tierCount];
+    int next = 2 * size * TIER_GROWTH;
+    int end = c->tierCount == MAX_TIERS - 1 || next > length ? length : next;
+
+    t->size = size;
+    t->offset = offset;
+    t->partitions = (end - offset + size - 1) / size;
+    t->blocks = size / blockSize;
+    t->bins = size + 1;
+    t->realtime = c->tierCount == 0;
+    makeTier(t, responses, channels, length);
+
+    c->tierCount++;
+    offset = next;
+    size *= TIER_GROWTH;
+  }
+
+  atomic_init(&c->late, 0);
+  atomic_init(&c->running, c->tierCount > 1);
+  if (c->tierCount > 1) {
+    pthread_create(&c->thread, NULL, background, c);
+  }
+  return c;
+}
+
+void freeConvolver(Convolver c) {
+  if (c->tierCount > 1) {
+    atomic_store_explicit(&c->running, 0, memory_order_release);
+    pthread_join(c->thread, NULL);
+  }
+  for (int i = 0; i < c->tierCount; i++) {
+    freeTier(&c->tiers[i], c->channels);
+  }
+  rtFree(c->head, c->headBytes);
+  rtFree(c->history, c->historyBytes);
+  free(c);
+}
+
+int convolverChannelCount(Convolver c) { return c->channels; }
+
+void convolverProcess(Convolver c, const float *const *in, float *const *out,
+                      int frames) {
+  int offset = 0;
+  for (; offset + c->blockSize <= frames; offset += c->blockSize) {
+    processBlock(c, in, out, offset);
+  }
+  for (int ch = 0; ch < c->channels && offset < frames; ch++) {
+    memset(out[ch] + offset, 0, (frames - offset) * sizeof(float));
+  }
+}
+
+uint64_t convolverLateBlocks(Convolver c) {
+  return atomic_load_explicit(&c->late, memory_order_relaxed);
+}
+
+void convolverNodeProcess(void *state, const struct ProcessContext *ctx) {
+  convolverProcess(state, ctx->inputs, ctx->outputs, ctx->frames);
+}
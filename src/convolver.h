@@ -0,0 +1,34 @@
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include "graph.h"
+#include <stdint.h>
+
+// zero latency convolution for long impulse responses. the first block of
+// taps is applied directly, the next ones by uniformly partitioned fft
+// convolution on the audio thread, and everything further out in partitions
+// eight times longer per tier, computed on a background thread. a tier's
+// partitions start two partition lengths in, so each background job has a
+// whole partition of time before the audio thread needs its output.
+typedef struct Convolver *Convolver;
+
+// not real-time safe. one mono path per channel, each with its own response
+// of `length` samples. blockSize is a power of two
+Convolver makeConvolver(const float *const *responses, int channels,
+                        int length, int blockSize);
+void freeConvolver(Convolver c);
+
+int convolverChannelCount(Convolver c);
+
+// real-time safe. frames must be a multiple of the block size. if the
+// background thread falls behind, the audio thread waits for it
+void convolverProcess(Convolver c, const float *const *in, float *const *out,
+                      int frames);
+
+// how many blocks had to wait for the background thread
+uint64_t convolverLateBlocks(Convolver c);
+
+// a graph node with the convolver as its state, input i through response i
+void convolverNodeProcess(void *state, const struct ProcessContext *ctx);
+
+#endif
@@ -0,0 +1,42 @@
+#include "deferred.h"
+
+#include "spsc.h"
+#include <stdlib.h>
+
+struct Garbage {
+  void *memory;
+  ReleaseFunc release;
+};
+
+struct Deferred {
+  Spsc queue;
+};
+
+Deferred makeDeferred(int capacity) {
+  Deferred d = malloc(sizeof(struct Deferred));
+  d->queue = makeSpsc(sizeof(struct Garbage), capacity);
+  return d;
+}
+
+void freeDeferred(Deferred d) {
+  collectDeferred(d);
+  freeSpsc(d->queue);
+  free(d);
+}
+
+int deferRelease(Deferred d, void *memory, ReleaseFunc release) {
+  struct Garbage g = {memory, release ? release : free};
+  return spscPush(d->queue, &g);
+}
+
+int deferredRoom(Deferred d) { return (int)spscWritable(d->queue); }
+
+int collectDeferred(Deferred d) {
+  struct Garbage g;
+  int count = 0;
+  while (spscPop(d->queue, &g)) {
+    g.release(g.memory);
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,23 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+// hands memory from the audio thread back to a non real-time thread for
+// freeing. the audio thread queues, a housekeeping thread collects.
+typedef struct Deferred *Deferred;
+
+typedef void (*ReleaseFunc)(void *memory);
+
+Deferred makeDeferred(int capacity);
+void freeDeferred(Deferred d);
+
+// audio thread. returns 0 if the queue is full, the caller keeps ownership
+// and should try again next block
+int deferRelease(Deferred d, void *memory, ReleaseFunc release);
+
+// audio thread. how many more deferRelease can queue before the queue is full
+int deferredRoom(Deferred d);
+
+// housekeeping thread. releases everything queued so far, returns how many
+int collectDeferred(Deferred d);
+
+#endif
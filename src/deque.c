@@ -0,0 +1,101 @@
+#include "deque.h"
+
+#include "die.h"
+#include "spsc.h"
+#include <stdatomic.h>
+#include <string.h>
+
+struct Deque {
+  _Alignas(CACHE_LINE_SIZE) atomic_long top;
+  _Alignas(CACHE_LINE_SIZE) atomic_long bottom;
+  _Alignas(CACHE_LINE_SIZE) long mask;
+  atomic_int *tasks;
+};
+
+Deque makeDeque(int capacity) {
+  long size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  Deque d = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Deque));
+  if (!d) {
+    die("Failed to allocate deque\n");
+  }
+  memset(d, 0, sizeof(struct Deque));
+  atomic_init(&d->top, 0);
+  atomic_init(&d->bottom, 0);
+  d->mask = size - 1;
+
+  d->tasks = malloc(size * sizeof(atomic_int));
+  if (!d->tasks) {
+    die("Failed to allocate deque storage\n");
+  }
+  for (long i = 0; i < size; i++) {
+    atomic_init(&d->tasks[i], DEQUE_EMPTY);
+  }
+  return d;
+}
+
+void freeDeque(Deque d) {
+  free(d->tasks);
+  free(d);
+}
+
+// the orderings follow Lê, Pop, Cohen and Zappa Nardelli, "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013)
+
+void dequePush(Deque d, int task) {
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&d->top, memory_order_acquire);
+  if (b - t > d->mask) {
+    // the scheduler sizes every deque for the whole graph
+    die("Deque overflow\n");
+  }
+  atomic_store_explicit(&d->tasks[b & d->mask], task, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+int dequePop(Deque d) {
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+  if (t > b) {
+    // already empty
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return DEQUE_EMPTY;
+  }
+
+  int task = atomic_load_explicit(&d->tasks[b & d->mask], memory_order_relaxed);
+  if (t == b) {
+    // last element, race the thieves for it
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      task = DEQUE_EMPTY;
+    }
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+int dequeSteal(Deque d) {
+  long t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return DEQUE_EMPTY;
+  }
+
+  int task = atomic_load_explicit(&d->tasks[t & d->mask], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return DEQUE_ABORT;
+  }
+  return task;
+}
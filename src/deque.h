@@ -0,0 +1,22 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+// fixed-capacity Chase-Lev work-stealing deque of task indices. the owner
+// pushes and pops at the bottom, any other thread may steal from the top.
+// capacity is fixed at creation so nothing allocates while a block runs.
+typedef struct Deque *Deque;
+
+#define DEQUE_EMPTY -1
+#define DEQUE_ABORT -2 // lost a race with another thief, worth retrying
+
+Deque makeDeque(int capacity);
+void freeDeque(Deque d);
+
+// owner only
+void dequePush(Deque d, int task);
+int dequePop(Deque d);
+
+// any thread
+int dequeSteal(Deque d);
+
+#endif
@@ -0,0 +1,84 @@
+#include "drawlist.h"
+
+#include "die.h"
+#include <stdlib.h>
+
+#define MIN_CAPACITY 64
+
+struct DrawList {
+  struct Vertex *vertices;
+  int count;
+  int capacity;
+};
+
+// PRIVATE FUNCTIONS
+
+// room for `n` more vertices, written in place by the caller
+static struct Vertex *reserve(DrawList l, int n) {
+  if (l->count + n > l->capacity) {
+    int capacity = l->capacity ? l->capacity : MIN_CAPACITY;
+    while (capacity < l->count + n) {
+      capacity *= 2;
+    }
+    l->vertices = realloc(l->vertices, capacity * sizeof(struct Vertex));
+    if (!l->vertices) {
+      die("Failed to grow draw list to %d vertices\n", capacity);
+    }
+    l->capacity = capacity;
+  }
+  struct Vertex *at = l->vertices + l->count;
+  l->count += n;
+  return at;
+}
+
+// PUBLIC FUNCTIONS
+
+DrawList makeDrawList(int capacity) {
+  DrawList l = malloc(sizeof(struct DrawList));
+  l->vertices = NULL;
+  l->count = 0;
+  l->capacity = 0;
+  if (capacity > 0) {
+    reserve(l, capacity);
+    l->count = 0;
+  }
+  return l;
+}
+
+void freeDrawList(DrawList l) {
+  free(l->vertices);
+  free(l);
+}
+
+void drawListClear(DrawList l) { l->count = 0; }
+
+void drawListRectangle(DrawList l, float x, float y, float width,
+                       float height) {
+  struct Vertex topLeft = {{x, y}};
+  struct Vertex topRight = {{x + width, y}};
+  struct Vertex bottomRight = {{x + width, y + height}};
+  struct Vertex bottomLeft = {{x, y + height}};
+
+  struct Vertex *v = reserve(l, 6);
+  v[0] = topLeft;
+  v[1] = topRight;
+  v[2] = bottomRight;
+  v[3] = bottomRight;
+  v[4] = bottomLeft;
+  v[5] = topLeft;
+}
+
+void drawListTriangle(DrawList l, float x, float y, float width, float height) {
+  struct Vertex top = {{x, y}};
+  struct Vertex left = {{x, y + height}};
+  struct Vertex right = {{x + width, y + height}};
+
+  struct Vertex *v = reserve(l, 3);
+  v[0] = top;
+  v[1] = right;
+  v[2] = left;
+}
+
+struct Vertex *drawListVertices(DrawList l) { return l->vertices; }
+
+int drawListCount(DrawList l) { return l->count; }
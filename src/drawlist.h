@@ -0,0 +1,28 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include "geometry.h"
+
+// a growing list of triangles to draw. it doubles its storage when it runs
+// out and keeps it when cleared, so a list rebuilt every frame stops
+// allocating once it has seen its largest frame. shapes are in window
+// coordinates, two triangles a rectangle.
+typedef struct DrawList *DrawList;
+
+// room for `capacity` vertices up front, 0 to start small
+DrawList makeDrawList(int capacity);
+void freeDrawList(DrawList l);
+
+// forget the shapes but keep the storage
+void drawListClear(DrawList l);
+
+void drawListRectangle(DrawList l, float x, float y, float width,
+                       float height);
+// its right angle in the bottom left corner of the box
+void drawListTriangle(DrawList l, float x, float y, float width, float height);
+
+// valid until the next shape is added
+struct Vertex *drawListVertices(DrawList l);
+int drawListCount(DrawList l);
+
+#endif
@@ -0,0 +1,257 @@
+#include "dsp.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#define INT16_SCALE 32767.0f
+#define INT24_SCALE 8388607.0f
+
+// SCALAR REFERENCE
+
+static float clampSample(float x) {
+  const float t = x < -1.0f ? -1.0f : x;
+  return t > 1.0f ? 1.0f : t;
+}
+
+static void add(float *dst, const float *src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] += src[i];
+  }
+}
+
+static void mix(float *dst, const float *src, float gain, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+static void gainRamp(float *dst, const float *src, float from, float to,
+                     int n) {
+  float step = (to - from) / n;
+  for (int i = 0; i < n; i++) {
+    dst[i] = src[i] * (from + step * (float)i);
+  }
+}
+
+static void mixRamp(float *dst, const float *src, float from, float to,
+                    int n) {
+  float step = (to - from) / n;
+  for (int i = 0; i < n; i++) {
+    dst[i] += src[i] * (from + step * (float)i);
+  }
+}
+
+static float dot(const float *a, const float *b, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+static void cubic(float *dst, float c0, float c1, float c2, float c3, int n) {
+  for (int i = 0; i < n; i++) {
+    float x = (float)i;
+    dst[i] = c0 + x * (c1 + x * (c2 + x * c3));
+  }
+}
+
+static void geometric(float *dst, float from, float ratio, int n) {
+  float v = from;
+  for (int i = 0; i < n; i++) {
+    dst[i] = v;
+    v *= ratio;
+  }
+}
+
+static void affine(double *dst, const double *src, double offset,
+                   double scale, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = offset + src[i] * scale;
+  }
+}
+
+static void levels(const float *src, int n, float *peak, float *sumSquares) {
+  float p = 0.0f, sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    float x = fabsf(src[i]);
+    p = x > p ? x : p;
+    sum += src[i] * src[i];
+  }
+  *peak = p;
+  *sumSquares = sum;
+}
+
+static void fftRadix4(float *re, float *im, int n, int m,
+                      const float *twiddles) {
+  const float *w1r = twiddles, *w1i = twiddles + m;
+  const float *w2r = twiddles + 2 * m, *w2i = twiddles + 3 * m;
+  for (int g = 0; g < n; g += 4 * m) {
+    float *r = re + g, *i = im + g;
+    for (int j = 0; j < m; j++) {
+      float r0 = r[j], i0 = i[j], r1 = r[j + m], i1 = i[j + m];
+      float r2 = r[j + 2 * m], i2 = i[j + 2 * m];
+      float r3 = r[j + 3 * m], i3 = i[j + 3 * m];
+
+      // two radix-2 passes fused, first 0/1 and 2/3 with w^2j
+      float t1r = r1 * w2r[j] - i1 * w2i[j], t1i = r1 * w2i[j] + i1 * w2r[j];
+      float t3r = r3 * w2r[j] - i3 * w2i[j], t3i = r3 * w2i[j] + i3 * w2r[j];
+      float b0r = r0 + t1r, b0i = i0 + t1i, b1r = r0 - t1r, b1i = i0 - t1i;
+      float b2r = r2 + t3r, b2i = i2 + t3i, b3r = r2 - t3r, b3i = i2 - t3i;
+
+      // then 0/2 with w^j and 1/3 with w^(j+m), which is -i w^j
+      float ur = b2r * w1r[j] - b2i * w1i[j], ui = b2r * w1i[j] + b2i * w1r[j];
+      float vr = b3r * w1i[j] + b3i * w1r[j], vi = b3i * w1i[j] - b3r * w1r[j];
+
+      r[j] = b0r + ur, i[j] = b0i + ui;
+      r[j + m] = b1r + vr, i[j + m] = b1i + vi;
+      r[j + 2 * m] = b0r - ur, i[j + 2 * m] = b0i - ui;
+      r[j + 3 * m] = b1r - vr, i[j + 3 * m] = b1i - vi;
+    }
+  }
+}
+
+static void complexMac(float *accRe, float *accIm, const float *aRe,
+                       const float *aIm, const float *bRe, const float *bIm,
+                       int n) {
+  for (int i = 0; i < n; i++) {
+    accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+    accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+  }
+}
+
+static void interleave2(float *dst, const float *left, const float *right,
+                        int n) {
+  for (int i = 0; i < n; i++) {
+    dst[2 * i] = left[i];
+    dst[2 * i + 1] = right[i];
+  }
+}
+
+static void deinterleave2(float *left, float *right, const float *src, int n) {
+  for (int i = 0; i < n; i++) {
+    left[i] = src[2 * i];
+    right[i] = src[2 * i + 1];
+  }
+}
+
+static void floatToInt16(int16_t *dst, const float *src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = (int16_t)lrintf(clampSample(src[i]) * INT16_SCALE);
+  }
+}
+
+static void int16ToFloat(float *dst, const int16_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = src[i] * (1.0f / INT16_SCALE);
+  }
+}
+
+static void floatToInt24(uint8_t *dst, const float *src, int n) {
+  for (int i = 0; i < n; i++) {
+    int32_t s = (int32_t)lrintf(clampSample(src[i]) * INT24_SCALE);
+    dst[3 * i] = (uint8_t)s;
+    dst[3 * i + 1] = (uint8_t)(s >> 8);
+    dst[3 * i + 2] = (uint8_t)(s >> 16);
+  }
+}
+
+static void int24ToFloat(float *dst, const uint8_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    // assemble in the top bits so the shift back sign extends
+    int32_t s = (int32_t)((uint32_t)src[3 * i] << 8 |
+                          (uint32_t)src[3 * i + 1] << 16 |
+                          (uint32_t)src[3 * i + 2] << 24) >>
+                8;
+    dst[i] = s * (1.0f / INT24_SCALE);
+  }
+}
+
+const struct DspKernels dspScalar = {
+    .name = "scalar",
+    .add = add,
+    .mix = mix,
+    .gainRamp = gainRamp,
+    .mixRamp = mixRamp,
+    .dot = dot,
+    .cubic = cubic,
+    .geometric = geometric,
+    .affine = affine,
+    .levels = levels,
+    .fftRadix4 = fftRadix4,
+    .complexMac = complexMac,
+    .interleave2 = interleave2,
+    .deinterleave2 = deinterleave2,
+    .floatToInt16 = floatToInt16,
+    .int16ToFloat = int16ToFloat,
+    .floatToInt24 = floatToInt24,
+    .int24ToFloat = int24ToFloat,
+};
+
+// DISPATCH
+
+const struct DspKernels *dsp = &dspScalar;
+
+const struct DspKernels *dspKernels(enum DspIsa isa) {
+  switch (isa) {
+  case DSP_SCALAR:
+    return &dspScalar;
+#if defined(__x86_64__) || defined(__i386__)
+  case DSP_SSE2:
+    return __builtin_cpu_supports("sse2") ? &dspSse2 : NULL;
+  case DSP_AVX2:
+    return __builtin_cpu_supports("avx2") ? &dspAvx2 : NULL;
+  case DSP_AVX512:
+    return __builtin_cpu_supports("avx512f") ? &dspAvx512 : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+void dspInit(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+#endif
+  for (int isa = DSP_ISA_COUNT - 1; isa >= 0; isa--) {
+    const struct DspKernels *k = dspKernels(isa);
+    if (k) {
+      dsp = k;
+      return;
+    }
+  }
+}
+
+// HELPERS
+
+void dspPanGains(float pan, float *left, float *right) {
+  float angle = (clampSample(pan) + 1.0f) * (float)DSP_PI / 4.0f;
+  *left = cosf(angle);
+  *right = sinf(angle);
+}
+
+void dspInterleave(float *dst, const float *const *channels, int channelCount,
+                   int n) {
+  if (channelCount == 2) {
+    dsp->interleave2(dst, channels[0], channels[1], n);
+    return;
+  }
+  for (int c = 0; c < channelCount; c++) {
+    for (int i = 0; i < n; i++) {
+      dst[i * channelCount + c] = channels[c][i];
+    }
+  }
+}
+
+void dspDeinterleave(float *const *channels, const float *src,
+                     int channelCount, int n) {
+  if (channelCount == 2) {
+    dsp->deinterleave2(channels[0], channels[1], src, n);
+    return;
+  }
+  for (int c = 0; c < channelCount; c++) {
+    for (int i = 0; i < n; i++) {
+      channels[c][i] = src[i * channelCount + c];
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdint.h>
+
+#define DSP_PI 3.14159265358979323846
+
+// the innermost loops of the mix. every kernel has a scalar reference and,
+// on x86, SSE2/AVX2/AVX-512 versions; dspInit picks the widest one the cpu
+// supports. buffers don't need any particular alignment, n is in frames.
+struct DspKernels {
+  const char *name;
+
+  // dst += src
+  void (*add)(float *dst, const float *src, int n);
+  // dst += src * gain
+  void (*mix)(float *dst, const float *src, float gain, int n);
+  // dst = src * gain, gain ramping linearly from `from` towards `to`
+  void (*gainRamp)(float *dst, const float *src, float from, float to, int n);
+  // dst += src * gain, gain ramping linearly from `from` towards `to`
+  void (*mixRamp)(float *dst, const float *src, float from, float to, int n);
+
+  // sum of a[i] * b[i], summation order differs between implementations
+  float (*dot)(const float *a, const float *b, int n);
+  // dst[i] = c0 + c1 i + c2 i^2 + c3 i^3, automation segments
+  void (*cubic)(float *dst, float c0, float c1, float c2, float c3, int n);
+  // dst[i] = from * ratio^i, exponential automation segments. the vector
+  // versions step several lanes at once and round differently
+  void (*geometric)(float *dst, float from, float ratio, int n);
+  // dst[i] = offset + src[i] * scale in double, positions on the timeline
+  // mapped between beats, samples and pixels
+  void (*affine)(double *dst, const double *src, double offset, double scale,
+                 int n);
+
+  // largest |src[i]| and the sum of squares, for metering
+  void (*levels)(const float *src, int n, float *peak, float *sumSquares);
+
+  // one pass of a split complex fft over n points. every group of 4m points
+  // holds four length m transforms in bit reversed order and becomes one of
+  // length 4m. twiddles are w^j then w^2j for j < m, w = e^(-2 pi i / 4m),
+  // stored as four arrays of m: re, im, re, im
+  void (*fftRadix4)(float *re, float *im, int n, int m,
+                    const float *twiddles);
+  // acc += a * b over split complex arrays, for frequency domain filtering
+  void (*complexMac)(float *accRe, float *accIm, const float *aRe,
+                     const float *aIm, const float *bRe, const float *bIm,
+                     int n);
+
+  // stereo planar <-> interleaved
+  void (*interleave2)(float *dst, const float *left, const float *right,
+                      int n);
+  void (*deinterleave2)(float *left, float *right, const float *src, int n);
+
+  // sample format conversion, clamped and rounded to nearest. 24 bit samples
+  // are packed little-endian, 3 bytes each
+  void (*floatToInt16)(int16_t *dst, const float *src, int n);
+  void (*int16ToFloat)(float *dst, const int16_t *src, int n);
+  void (*floatToInt24)(uint8_t *dst, const float *src, int n);
+  void (*int24ToFloat)(float *dst, const uint8_t *src, int n);
+};
+
+enum DspIsa {
+  DSP_SCALAR,
+  DSP_SSE2,
+  DSP_AVX2,
+  DSP_AVX512,
+  DSP_ISA_COUNT,
+};
+
+// the kernels in use, scalar until dspInit runs
+extern const struct DspKernels *dsp;
+
+// select the best kernels for this cpu, call once at startup
+void dspInit(void);
+
+// a specific implementation, NULL if the cpu can't run it
+const struct DspKernels *dspKernels(enum DspIsa isa);
+
+// constant power pan law, pan in [-1, 1]
+void dspPanGains(float pan, float *left, float *right);
+
+// any channel count, uses the stereo kernels when it can
+void dspInterleave(float *dst, const float *const *channels, int channelCount,
+                   int n);
+void dspDeinterleave(float *const *channels, const float *src,
+                     int channelCount, int n);
+
+// per isa tables, see dsp_*.c
+extern const struct DspKernels dspScalar;
+#if defined(__x86_64__) || defined(__i386__)
+extern const struct DspKernels dspSse2;
+extern const struct DspKernels dspAvx2;
+extern const struct DspKernels dspAvx512;
+
+// shared by the avx2 and avx-512 tables
+void dspAvx2FloatToInt24(uint8_t *dst, const float *src, int n);
+void dspAvx2Int24ToFloat(float *dst, const uint8_t *src, int n);
+#endif
+
+#endif
@@ -0,0 +1,342 @@
+#include "dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static __m256 clamp8(__m256 x) {
+  return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)),
+                       _mm256_set1_ps(1.0f));
+}
+
+AVX2 static void add(float *dst, const float *src, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_loadu_ps(dst + i);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_loadu_ps(src + i)));
+  }
+  dspScalar.add(dst + i, src + i, n - i);
+}
+
+AVX2 static void mix(float *dst, const float *src, float gain, int n) {
+  __m256 g = _mm256_set1_ps(gain);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 s = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), s));
+  }
+  dspScalar.mix(dst + i, src + i, gain, n - i);
+}
+
+AVX2 static void gainRamp(float *dst, const float *src, float from, float to,
+                          int n) {
+  float step = (to - from) / n;
+  __m256 f = _mm256_set1_ps(from);
+  __m256 s = _mm256_set1_ps(step);
+  __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+    __m256 g = _mm256_add_ps(f, _mm256_mul_ps(s, index));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+  }
+  for (; i < n; i++) {
+    dst[i] = src[i] * (from + step * (float)i);
+  }
+}
+
+AVX2 static void mixRamp(float *dst, const float *src, float from, float to,
+                         int n) {
+  float step = (to - from) / n;
+  __m256 f = _mm256_set1_ps(from);
+  __m256 s = _mm256_set1_ps(step);
+  __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+    __m256 g = _mm256_add_ps(f, _mm256_mul_ps(s, index));
+    __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), x));
+  }
+  for (; i < n; i++) {
+    dst[i] += src[i] * (from + step * (float)i);
+  }
+}
+
+AVX2 static float dot(const float *a, const float *b, int n) {
+  // two accumulators hide the add latency
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_ps(
+        acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+                                             _mm256_loadu_ps(b + i + 8)));
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_ps(
+        acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                           _mm256_extractf128_ps(acc, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         dspScalar.dot(a + i, b + i, n - i);
+}
+
+AVX2 static void cubic(float *dst, float c0, float c1, float c2, float c3,
+                       int n) {
+  __m256 a = _mm256_set1_ps(c0), b = _mm256_set1_ps(c1);
+  __m256 c = _mm256_set1_ps(c2), d = _mm256_set1_ps(c3);
+  __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+    __m256 v = _mm256_add_ps(c, _mm256_mul_ps(x, d));
+    v = _mm256_add_ps(b, _mm256_mul_ps(x, v));
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(a, _mm256_mul_ps(x, v)));
+  }
+  for (; i < n; i++) {
+    float x = (float)i;
+    dst[i] = c0 + x * (c1 + x * (c2 + x * c3));
+  }
+}
+
+AVX2 static void geometric(float *dst, float from, float ratio, int n) {
+  float start[8], power = ratio;
+  start[0] = from;
+  for (int l = 1; l < 8; l++) {
+    start[l] = start[l - 1] * ratio;
+    power *= ratio;
+  }
+  __m256 v = _mm256_loadu_ps(start);
+  __m256 step = _mm256_set1_ps(power);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, v);
+    v = _mm256_mul_ps(v, step);
+  }
+  _mm256_storeu_ps(start, v);
+  dspScalar.geometric(dst + i, start[0], ratio, n - i);
+}
+
+AVX2 static void affine(double *dst, const double *src, double offset,
+                        double scale, int n) {
+  __m256d o = _mm256_set1_pd(offset);
+  __m256d s = _mm256_set1_pd(scale);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(src + i);
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(o, _mm256_mul_pd(x, s)));
+  }
+  dspScalar.affine(dst + i, src + i, offset, scale, n - i);
+}
+
+AVX2 static void levels(const float *src, int n, float *peak,
+                        float *sumSquares) {
+  __m256 abs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256 p = _mm256_setzero_ps();
+  __m256 sum = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_loadu_ps(src + i);
+    p = _mm256_max_ps(p, _mm256_and_ps(x, abs));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+  }
+  __m128 p4 =
+      _mm_max_ps(_mm256_castps256_ps128(p), _mm256_extractf128_ps(p, 1));
+  __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(sum),
+                         _mm256_extractf128_ps(sum, 1));
+  float peaks[4], sums[4], tailPeak, tailSum;
+  _mm_storeu_ps(peaks, p4);
+  _mm_storeu_ps(sums, s4);
+  dspScalar.levels(src + i, n - i, &tailPeak, &tailSum);
+  for (int l = 0; l < 4; l++) {
+    tailPeak = peaks[l] > tailPeak ? peaks[l] : tailPeak;
+  }
+  *peak = tailPeak;
+  *sumSquares = sums[0] + sums[1] + sums[2] + sums[3] + tailSum;
+}
+
+AVX2 static void fftRadix4(float *re, float *im, int n, int m,
+                           const float *twiddles) {
+  if (m < 8) {
+    dspSse2.fftRadix4(re, im, n, m, twiddles);
+    return;
+  }
+  const float *w1r = twiddles, *w1i = twiddles + m;
+  const float *w2r = twiddles + 2 * m, *w2i = twiddles + 3 * m;
+  for (int g = 0; g < n; g += 4 * m) {
+    float *r = re + g, *i = im + g;
+    for (int j = 0; j < m; j += 8) {
+      __m256 ar = _mm256_loadu_ps(w1r + j), ai = _mm256_loadu_ps(w1i + j);
+      __m256 br = _mm256_loadu_ps(w2r + j), bi = _mm256_loadu_ps(w2i + j);
+      __m256 r0 = _mm256_loadu_ps(r + j), i0 = _mm256_loadu_ps(i + j);
+      __m256 r1 = _mm256_loadu_ps(r + j + m), i1 = _mm256_loadu_ps(i + j + m);
+      __m256 r2 = _mm256_loadu_ps(r + j + 2 * m);
+      __m256 i2 = _mm256_loadu_ps(i + j + 2 * m);
+      __m256 r3 = _mm256_loadu_ps(r + j + 3 * m);
+      __m256 i3 = _mm256_loadu_ps(i + j + 3 * m);
+
+      // see the scalar version in dsp.c
+      __m256 t1r = _mm256_sub_ps(_mm256_mul_ps(r1, br), _mm256_mul_ps(i1, bi));
+      __m256 t1i = _mm256_add_ps(_mm256_mul_ps(r1, bi), _mm256_mul_ps(i1, br));
+      __m256 t3r = _mm256_sub_ps(_mm256_mul_ps(r3, br), _mm256_mul_ps(i3, bi));
+      __m256 t3i = _mm256_add_ps(_mm256_mul_ps(r3, bi), _mm256_mul_ps(i3, br));
+      __m256 b0r = _mm256_add_ps(r0, t1r), b0i = _mm256_add_ps(i0, t1i);
+      __m256 b1r = _mm256_sub_ps(r0, t1r), b1i = _mm256_sub_ps(i0, t1i);
+      __m256 b2r = _mm256_add_ps(r2, t3r), b2i = _mm256_add_ps(i2, t3i);
+      __m256 b3r = _mm256_sub_ps(r2, t3r), b3i = _mm256_sub_ps(i2, t3i);
+
+      __m256 ur = _mm256_sub_ps(_mm256_mul_ps(b2r, ar), _mm256_mul_ps(b2i, ai));
+      __m256 ui = _mm256_add_ps(_mm256_mul_ps(b2r, ai), _mm256_mul_ps(b2i, ar));
+      __m256 vr = _mm256_add_ps(_mm256_mul_ps(b3r, ai), _mm256_mul_ps(b3i, ar));
+      __m256 vi = _mm256_sub_ps(_mm256_mul_ps(b3i, ai), _mm256_mul_ps(b3r, ar));
+
+      _mm256_storeu_ps(r + j, _mm256_add_ps(b0r, ur));
+      _mm256_storeu_ps(i + j, _mm256_add_ps(b0i, ui));
+      _mm256_storeu_ps(r + j + m, _mm256_add_ps(b1r, vr));
+      _mm256_storeu_ps(i + j + m, _mm256_add_ps(b1i, vi));
+      _mm256_storeu_ps(r + j + 2 * m, _mm256_sub_ps(b0r, ur));
+      _mm256_storeu_ps(i + j + 2 * m, _mm256_sub_ps(b0i, ui));
+      _mm256_storeu_ps(r + j + 3 * m, _mm256_sub_ps(b1r, vr));
+      _mm256_storeu_ps(i + j + 3 * m, _mm256_sub_ps(b1i, vi));
+    }
+  }
+}
+
+AVX2 static void complexMac(float *accRe, float *accIm, const float *aRe,
+                            const float *aIm, const float *bRe,
+                            const float *bIm, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 ar = _mm256_loadu_ps(aRe + i), ai = _mm256_loadu_ps(aIm + i);
+    __m256 br = _mm256_loadu_ps(bRe + i), bi = _mm256_loadu_ps(bIm + i);
+    __m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi));
+    __m256 im = _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br));
+    _mm256_storeu_ps(accRe + i, _mm256_add_ps(_mm256_loadu_ps(accRe + i), re));
+    _mm256_storeu_ps(accIm + i, _mm256_add_ps(_mm256_loadu_ps(accIm + i), im));
+  }
+  dspScalar.complexMac(accRe + i, accIm + i, aRe + i, aIm + i, bRe + i,
+                       bIm + i, n - i);
+}
+
+AVX2 static void interleave2(float *dst, const float *left,
+                             const float *right, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 l = _mm256_loadu_ps(left + i);
+    __m256 r = _mm256_loadu_ps(right + i);
+    // unpack works within 128 bit lanes, stitch the halves back together
+    __m256 lo = _mm256_unpacklo_ps(l, r);
+    __m256 hi = _mm256_unpackhi_ps(l, r);
+    _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  dspScalar.interleave2(dst + 2 * i, left + i, right + i, n - i);
+}
+
+AVX2 static void deinterleave2(float *left, float *right, const float *src,
+                               int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 a = _mm256_loadu_ps(src + 2 * i);
+    __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+    // shuffle within lanes, then fix up the order of the 64 bit pairs
+    __m256d l = _mm256_castps_pd(_mm256_shuffle_ps(a, b, 0x88));
+    __m256d r = _mm256_castps_pd(_mm256_shuffle_ps(a, b, 0xDD));
+    _mm256_storeu_ps(left + i,
+                     _mm256_castpd_ps(_mm256_permute4x64_pd(l, 0xD8)));
+    _mm256_storeu_ps(right + i,
+                     _mm256_castpd_ps(_mm256_permute4x64_pd(r, 0xD8)));
+  }
+  dspScalar.deinterleave2(left + i, right + i, src + 2 * i, n - i);
+}
+
+AVX2 static void floatToInt16(int16_t *dst, const float *src, int n) {
+  __m256 scale = _mm256_set1_ps(32767.0f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i a = _mm256_cvtps_epi32(
+        _mm256_mul_ps(clamp8(_mm256_loadu_ps(src + i)), scale));
+    __m256i b = _mm256_cvtps_epi32(
+        _mm256_mul_ps(clamp8(_mm256_loadu_ps(src + i + 8)), scale));
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+    _mm256_storeu_si256((__m256i *)(dst + i), packed);
+  }
+  dspScalar.floatToInt16(dst + i, src + i, n - i);
+}
+
+AVX2 static void int16ToFloat(float *dst, const int16_t *src, int n) {
+  __m256 scale = _mm256_set1_ps(1.0f / 32767.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x =
+        _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+  }
+  dspScalar.int16ToFloat(dst + i, src + i, n - i);
+}
+
+// the 24 bit kernels move 16 bytes per 128 bit lane but only use 12, so the
+// vector loops stop early enough to never touch memory past the buffers
+
+AVX2 void dspAvx2FloatToInt24(uint8_t *dst, const float *src, int n) {
+  __m256 scale = _mm256_set1_ps(8388607.0f);
+  __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1,
+                                  -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12,
+                                  13, 14, -1, -1, -1, -1);
+  int i = 0;
+  for (; i + 10 <= n; i += 8) {
+    __m256i x = _mm256_cvtps_epi32(
+        _mm256_mul_ps(clamp8(_mm256_loadu_ps(src + i)), scale));
+    x = _mm256_shuffle_epi8(x, pack);
+    _mm_storeu_si128((__m128i *)(dst + 3 * i), _mm256_castsi256_si128(x));
+    _mm_storeu_si128((__m128i *)(dst + 3 * i + 12),
+                     _mm256_extracti128_si256(x, 1));
+  }
+  dspScalar.floatToInt24(dst + 3 * i, src + i, n - i);
+}
+
+AVX2 void dspAvx2Int24ToFloat(float *dst, const uint8_t *src, int n) {
+  __m256 scale = _mm256_set1_ps(1.0f / 8388607.0f);
+  // each sample lands in the top 3 bytes, the arithmetic shift sign extends
+  __m256i unpack = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1,
+                                    9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6,
+                                    7, 8, -1, 9, 10, 11);
+  int i = 0;
+  for (; i + 10 <= n; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(src + 3 * i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(src + 3 * i + 12));
+    __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    x = _mm256_srai_epi32(_mm256_shuffle_epi8(x, unpack), 8);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+  }
+  dspScalar.int24ToFloat(dst + i, src + 3 * i, n - i);
+}
+
+const struct DspKernels dspAvx2 = {
+    .name = "avx2",
+    .add = add,
+    .mix = mix,
+    .gainRamp = gainRamp,
+    .mixRamp = mixRamp,
+    .dot = dot,
+    .cubic = cubic,
+    .geometric = geometric,
+    .affine = affine,
+    .levels = levels,
+    .fftRadix4 = fftRadix4,
+    .complexMac = complexMac,
+    .interleave2 = interleave2,
+    .deinterleave2 = deinterleave2,
+    .floatToInt16 = floatToInt16,
+    .int16ToFloat = int16ToFloat,
+    .floatToInt24 = dspAvx2FloatToInt24,
+    .int24ToFloat = dspAvx2Int24ToFloat,
+};
+#endif
@@ -0,0 +1,273 @@
+#include "dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AVX512 __attribute__((target("avx512f")))
+
+// avx-512 masks the tails instead of falling back to scalar
+
+AVX512 static __mmask16 tailMask(int remaining) {
+  return remaining >= 16 ? 0xFFFF : (__mmask16)((1u << remaining) - 1);
+}
+
+AVX512 static __m512 clamp16(__m512 x) {
+  return _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-1.0f)),
+                       _mm512_set1_ps(1.0f));
+}
+
+AVX512 static void add(float *dst, const float *src, int n) {
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 d = _mm512_maskz_loadu_ps(m, dst + i);
+    __m512 s = _mm512_maskz_loadu_ps(m, src + i);
+    _mm512_mask_storeu_ps(dst + i, m, _mm512_add_ps(d, s));
+  }
+}
+
+AVX512 static void mix(float *dst, const float *src, float gain, int n) {
+  __m512 g = _mm512_set1_ps(gain);
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 d = _mm512_maskz_loadu_ps(m, dst + i);
+    __m512 s = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, src + i), g);
+    _mm512_mask_storeu_ps(dst + i, m, _mm512_add_ps(d, s));
+  }
+}
+
+AVX512 static __m512 ramp(float from, float step, int i) {
+  __m512 lanes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                14, 15);
+  __m512 index = _mm512_add_ps(_mm512_set1_ps((float)i), lanes);
+  return _mm512_add_ps(_mm512_set1_ps(from),
+                       _mm512_mul_ps(_mm512_set1_ps(step), index));
+}
+
+AVX512 static void gainRamp(float *dst, const float *src, float from,
+                            float to, int n) {
+  float step = (to - from) / n;
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 s = _mm512_maskz_loadu_ps(m, src + i);
+    _mm512_mask_storeu_ps(dst + i, m, _mm512_mul_ps(s, ramp(from, step, i)));
+  }
+}
+
+AVX512 static void mixRamp(float *dst, const float *src, float from, float to,
+                           int n) {
+  float step = (to - from) / n;
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 d = _mm512_maskz_loadu_ps(m, dst + i);
+    __m512 s = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, src + i),
+                             ramp(from, step, i));
+    _mm512_mask_storeu_ps(dst + i, m, _mm512_add_ps(d, s));
+  }
+}
+
+AVX512 static float dot(const float *a, const float *b, int n) {
+  __m512 acc = _mm512_setzero_ps();
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 x = _mm512_maskz_loadu_ps(m, a + i);
+    acc = _mm512_add_ps(acc, _mm512_mul_ps(x, _mm512_maskz_loadu_ps(m, b + i)));
+  }
+  return _mm512_reduce_add_ps(acc);
+}
+
+AVX512 static void cubic(float *dst, float c0, float c1, float c2, float c3,
+                         int n) {
+  __m512 a = _mm512_set1_ps(c0), b = _mm512_set1_ps(c1);
+  __m512 c = _mm512_set1_ps(c2), d = _mm512_set1_ps(c3);
+  __m512 lanes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                14, 15);
+  for (int i = 0; i < n; i += 16) {
+    __m512 x = _mm512_add_ps(_mm512_set1_ps((float)i), lanes);
+    __m512 v = _mm512_add_ps(c, _mm512_mul_ps(x, d));
+    v = _mm512_add_ps(b, _mm512_mul_ps(x, v));
+    v = _mm512_add_ps(a, _mm512_mul_ps(x, v));
+    _mm512_mask_storeu_ps(dst + i, tailMask(n - i), v);
+  }
+}
+
+AVX512 static void geometric(float *dst, float from, float ratio, int n) {
+  float start[16], power = ratio;
+  start[0] = from;
+  for (int l = 1; l < 16; l++) {
+    start[l] = start[l - 1] * ratio;
+    power *= ratio;
+  }
+  __m512 v = _mm512_loadu_ps(start);
+  __m512 step = _mm512_set1_ps(power);
+  for (int i = 0; i < n; i += 16) {
+    _mm512_mask_storeu_ps(dst + i, tailMask(n - i), v);
+    v = _mm512_mul_ps(v, step);
+  }
+}
+
+AVX512 static void affine(double *dst, const double *src, double offset,
+                          double scale, int n) {
+  __m512d o = _mm512_set1_pd(offset);
+  __m512d s = _mm512_set1_pd(scale);
+  for (int i = 0; i < n; i += 8) {
+    int left = n - i;
+    __mmask8 m = left >= 8 ? 0xFF : (__mmask8)((1u << left) - 1);
+    __m512d x = _mm512_maskz_loadu_pd(m, src + i);
+    _mm512_mask_storeu_pd(dst + i, m, _mm512_add_pd(o, _mm512_mul_pd(x, s)));
+  }
+}
+
+AVX512 static void levels(const float *src, int n, float *peak,
+                          float *sumSquares) {
+  __m512 p = _mm512_setzero_ps();
+  __m512 sum = _mm512_setzero_ps();
+  for (int i = 0; i < n; i += 16) {
+    __m512 x = _mm512_maskz_loadu_ps(tailMask(n - i), src + i);
+    p = _mm512_max_ps(p, _mm512_abs_ps(x));
+    sum = _mm512_add_ps(sum, _mm512_mul_ps(x, x));
+  }
+  *peak = _mm512_reduce_max_ps(p);
+  *sumSquares = _mm512_reduce_add_ps(sum);
+}
+
+AVX512 static void fftRadix4(float *re, float *im, int n, int m,
+                             const float *twiddles) {
+  if (m < 16) {
+    dspAvx2.fftRadix4(re, im, n, m, twiddles);
+    return;
+  }
+  const float *w1r = twiddles, *w1i = twiddles + m;
+  const float *w2r = twiddles + 2 * m, *w2i = twiddles + 3 * m;
+  for (int g = 0; g < n; g += 4 * m) {
+    float *r = re + g, *i = im + g;
+    for (int j = 0; j < m; j += 16) {
+      __m512 ar = _mm512_loadu_ps(w1r + j), ai = _mm512_loadu_ps(w1i + j);
+      __m512 br = _mm512_loadu_ps(w2r + j), bi = _mm512_loadu_ps(w2i + j);
+      __m512 r0 = _mm512_loadu_ps(r + j), i0 = _mm512_loadu_ps(i + j);
+      __m512 r1 = _mm512_loadu_ps(r + j + m), i1 = _mm512_loadu_ps(i + j + m);
+      __m512 r2 = _mm512_loadu_ps(r + j + 2 * m);
+      __m512 i2 = _mm512_loadu_ps(i + j + 2 * m);
+      __m512 r3 = _mm512_loadu_ps(r + j + 3 * m);
+      __m512 i3 = _mm512_loadu_ps(i + j + 3 * m);
+
+      // see the scalar version in dsp.c
+      __m512 t1r = _mm512_sub_ps(_mm512_mul_ps(r1, br), _mm512_mul_ps(i1, bi));
+      __m512 t1i = _mm512_add_ps(_mm512_mul_ps(r1, bi), _mm512_mul_ps(i1, br));
+      __m512 t3r = _mm512_sub_ps(_mm512_mul_ps(r3, br), _mm512_mul_ps(i3, bi));
+      __m512 t3i = _mm512_add_ps(_mm512_mul_ps(r3, bi), _mm512_mul_ps(i3, br));
+      __m512 b0r = _mm512_add_ps(r0, t1r), b0i = _mm512_add_ps(i0, t1i);
+      __m512 b1r = _mm512_sub_ps(r0, t1r), b1i = _mm512_sub_ps(i0, t1i);
+      __m512 b2r = _mm512_add_ps(r2, t3r), b2i = _mm512_add_ps(i2, t3i);
+      __m512 b3r = _mm512_sub_ps(r2, t3r), b3i = _mm512_sub_ps(i2, t3i);
+
+      __m512 ur = _mm512_sub_ps(_mm512_mul_ps(b2r, ar), _mm512_mul_ps(b2i, ai));
+      __m512 ui = _mm512_add_ps(_mm512_mul_ps(b2r, ai), _mm512_mul_ps(b2i, ar));
+      __m512 vr = _mm512_add_ps(_mm512_mul_ps(b3r, ai), _mm512_mul_ps(b3i, ar));
+      __m512 vi = _mm512_sub_ps(_mm512_mul_ps(b3i, ai), _mm512_mul_ps(b3r, ar));
+
+      _mm512_storeu_ps(r + j, _mm512_add_ps(b0r, ur));
+      _mm512_storeu_ps(i + j, _mm512_add_ps(b0i, ui));
+      _mm512_storeu_ps(r + j + m, _mm512_add_ps(b1r, vr));
+      _mm512_storeu_ps(i + j + m, _mm512_add_ps(b1i, vi));
+      _mm512_storeu_ps(r + j + 2 * m, _mm512_sub_ps(b0r, ur));
+      _mm512_storeu_ps(i + j + 2 * m, _mm512_sub_ps(b0i, ui));
+      _mm512_storeu_ps(r + j + 3 * m, _mm512_sub_ps(b1r, vr));
+      _mm512_storeu_ps(i + j + 3 * m, _mm512_sub_ps(b1i, vi));
+    }
+  }
+}
+
+AVX512 static void complexMac(float *accRe, float *accIm, const float *aRe,
+                              const float *aIm, const float *bRe,
+                              const float *bIm, int n) {
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 ar = _mm512_maskz_loadu_ps(m, aRe + i);
+    __m512 ai = _mm512_maskz_loadu_ps(m, aIm + i);
+    __m512 br = _mm512_maskz_loadu_ps(m, bRe + i);
+    __m512 bi = _mm512_maskz_loadu_ps(m, bIm + i);
+    __m512 re = _mm512_sub_ps(_mm512_mul_ps(ar, br), _mm512_mul_ps(ai, bi));
+    __m512 im = _mm512_add_ps(_mm512_mul_ps(ar, bi), _mm512_mul_ps(ai, br));
+    re = _mm512_add_ps(_mm512_maskz_loadu_ps(m, accRe + i), re);
+    im = _mm512_add_ps(_mm512_maskz_loadu_ps(m, accIm + i), im);
+    _mm512_mask_storeu_ps(accRe + i, m, re);
+    _mm512_mask_storeu_ps(accIm + i, m, im);
+  }
+}
+
+AVX512 static void interleave2(float *dst, const float *left,
+                               const float *right, int n) {
+  __m512i lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6,
+                                 22, 7, 23);
+  __m512i hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29,
+                                 14, 30, 15, 31);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 l = _mm512_loadu_ps(left + i);
+    __m512 r = _mm512_loadu_ps(right + i);
+    _mm512_storeu_ps(dst + 2 * i, _mm512_permutex2var_ps(l, lo, r));
+    _mm512_storeu_ps(dst + 2 * i + 16, _mm512_permutex2var_ps(l, hi, r));
+  }
+  dspScalar.interleave2(dst + 2 * i, left + i, right + i, n - i);
+}
+
+AVX512 static void deinterleave2(float *left, float *right, const float *src,
+                                 int n) {
+  __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22,
+                                   24, 26, 28, 30);
+  __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23,
+                                  25, 27, 29, 31);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 a = _mm512_loadu_ps(src + 2 * i);
+    __m512 b = _mm512_loadu_ps(src + 2 * i + 16);
+    _mm512_storeu_ps(left + i, _mm512_permutex2var_ps(a, even, b));
+    _mm512_storeu_ps(right + i, _mm512_permutex2var_ps(a, odd, b));
+  }
+  dspScalar.deinterleave2(left + i, right + i, src + 2 * i, n - i);
+}
+
+AVX512 static void floatToInt16(int16_t *dst, const float *src, int n) {
+  __m512 scale = _mm512_set1_ps(32767.0f);
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 m = tailMask(n - i);
+    __m512 x = clamp16(_mm512_maskz_loadu_ps(m, src + i));
+    __m512i s = _mm512_cvtps_epi32(_mm512_mul_ps(x, scale));
+    _mm512_mask_cvtsepi32_storeu_epi16(dst + i, m, s);
+  }
+}
+
+AVX512 static void int16ToFloat(float *dst, const int16_t *src, int n) {
+  __m512 scale = _mm512_set1_ps(1.0f / 32767.0f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x =
+        _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)(src + i)));
+    _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(x), scale));
+  }
+  dspScalar.int16ToFloat(dst + i, src + i, n - i);
+}
+
+// byte shuffles need avx512bw, every avx-512 cpu has avx2 so the 24 bit
+// kernels come from there
+const struct DspKernels dspAvx512 = {
+    .name = "avx512",
+    .add = add,
+    .mix = mix,
+    .gainRamp = gainRamp,
+    .mixRamp = mixRamp,
+    .dot = dot,
+    .cubic = cubic,
+    .geometric = geometric,
+    .affine = affine,
+    .levels = levels,
+    .fftRadix4 = fftRadix4,
+    .complexMac = complexMac,
+    .interleave2 = interleave2,
+    .deinterleave2 = deinterleave2,
+    .floatToInt16 = floatToInt16,
+    .int16ToFloat = int16ToFloat,
+    .floatToInt24 = dspAvx2FloatToInt24,
+    .int24ToFloat = dspAvx2Int24ToFloat,
+};
+#endif
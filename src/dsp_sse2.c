@@ -0,0 +1,312 @@
+#include "dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static __m128 clamp4(__m128 x) {
+  return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+SSE2 static void add(float *dst, const float *src, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 d = _mm_loadu_ps(dst + i);
+    _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_loadu_ps(src + i)));
+  }
+  dspScalar.add(dst + i, src + i, n - i);
+}
+
+SSE2 static void mix(float *dst, const float *src, float gain, int n) {
+  __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 s = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), s));
+  }
+  dspScalar.mix(dst + i, src + i, gain, n - i);
+}
+
+SSE2 static void gainRamp(float *dst, const float *src, float from, float to,
+                          int n) {
+  float step = (to - from) / n;
+  __m128 f = _mm_set1_ps(from);
+  __m128 s = _mm_set1_ps(step);
+  __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 index = _mm_add_ps(_mm_set1_ps((float)i), lanes);
+    __m128 g = _mm_add_ps(f, _mm_mul_ps(s, index));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+  }
+  for (; i < n; i++) {
+    dst[i] = src[i] * (from + step * (float)i);
+  }
+}
+
+SSE2 static void mixRamp(float *dst, const float *src, float from, float to,
+                         int n) {
+  float step = (to - from) / n;
+  __m128 f = _mm_set1_ps(from);
+  __m128 s = _mm_set1_ps(step);
+  __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 index = _mm_add_ps(_mm_set1_ps((float)i), lanes);
+    __m128 g = _mm_add_ps(f, _mm_mul_ps(s, index));
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), x));
+  }
+  for (; i < n; i++) {
+    dst[i] += src[i] * (from + step * (float)i);
+  }
+}
+
+SSE2 static float dot(const float *a, const float *b, int n) {
+  __m128 acc = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         dspScalar.dot(a + i, b + i, n - i);
+}
+
+SSE2 static void cubic(float *dst, float c0, float c1, float c2, float c3,
+                       int n) {
+  __m128 a = _mm_set1_ps(c0), b = _mm_set1_ps(c1);
+  __m128 c = _mm_set1_ps(c2), d = _mm_set1_ps(c3);
+  __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_add_ps(_mm_set1_ps((float)i), lanes);
+    __m128 v = _mm_add_ps(c, _mm_mul_ps(x, d));
+    v = _mm_add_ps(b, _mm_mul_ps(x, v));
+    _mm_storeu_ps(dst + i, _mm_add_ps(a, _mm_mul_ps(x, v)));
+  }
+  for (; i < n; i++) {
+    float x = (float)i;
+    dst[i] = c0 + x * (c1 + x * (c2 + x * c3));
+  }
+}
+
+SSE2 static void geometric(float *dst, float from, float ratio, int n) {
+  float start[4] = {from, from * ratio, from * ratio * ratio,
+                    from * ratio * ratio * ratio};
+  __m128 v = _mm_loadu_ps(start);
+  __m128 step = _mm_set1_ps(ratio * ratio * ratio * ratio);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(dst + i, v);
+    v = _mm_mul_ps(v, step);
+  }
+  _mm_storeu_ps(start, v);
+  dspScalar.geometric(dst + i, start[0], ratio, n - i);
+}
+
+SSE2 static void affine(double *dst, const double *src, double offset,
+                        double scale, int n) {
+  __m128d o = _mm_set1_pd(offset);
+  __m128d s = _mm_set1_pd(scale);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_loadu_pd(src + i);
+    _mm_storeu_pd(dst + i, _mm_add_pd(o, _mm_mul_pd(x, s)));
+  }
+  dspScalar.affine(dst + i, src + i, offset, scale, n - i);
+}
+
+SSE2 static void levels(const float *src, int n, float *peak,
+                        float *sumSquares) {
+  __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 p = _mm_setzero_ps();
+  __m128 sum = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(src + i);
+    p = _mm_max_ps(p, _mm_and_ps(x, abs));
+    sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+  }
+  float peaks[4], sums[4], tailPeak, tailSum;
+  _mm_storeu_ps(peaks, p);
+  _mm_storeu_ps(sums, sum);
+  dspScalar.levels(src + i, n - i, &tailPeak, &tailSum);
+  for (int l = 0; l < 4; l++) {
+    tailPeak = peaks[l] > tailPeak ? peaks[l] : tailPeak;
+  }
+  *peak = tailPeak;
+  *sumSquares = sums[0] + sums[1] + sums[2] + sums[3] + tailSum;
+}
+
+SSE2 static void fftRadix4(float *re, float *im, int n, int m,
+                           const float *twiddles) {
+  if (m < 4) {
+    dspScalar.fftRadix4(re, im, n, m, twiddles);
+    return;
+  }
+  const float *w1r = twiddles, *w1i = twiddles + m;
+  const float *w2r = twiddles + 2 * m, *w2i = twiddles + 3 * m;
+  for (int g = 0; g < n; g += 4 * m) {
+    float *r = re + g, *i = im + g;
+    for (int j = 0; j < m; j += 4) {
+      __m128 ar = _mm_loadu_ps(w1r + j), ai = _mm_loadu_ps(w1i + j);
+      __m128 br = _mm_loadu_ps(w2r + j), bi = _mm_loadu_ps(w2i + j);
+      __m128 r0 = _mm_loadu_ps(r + j), i0 = _mm_loadu_ps(i + j);
+      __m128 r1 = _mm_loadu_ps(r + j + m), i1 = _mm_loadu_ps(i + j + m);
+      __m128 r2 = _mm_loadu_ps(r + j + 2 * m);
+      __m128 i2 = _mm_loadu_ps(i + j + 2 * m);
+      __m128 r3 = _mm_loadu_ps(r + j + 3 * m);
+      __m128 i3 = _mm_loadu_ps(i + j + 3 * m);
+
+      // see the scalar version in dsp.c
+      __m128 t1r = _mm_sub_ps(_mm_mul_ps(r1, br), _mm_mul_ps(i1, bi));
+      __m128 t1i = _mm_add_ps(_mm_mul_ps(r1, bi), _mm_mul_ps(i1, br));
+      __m128 t3r = _mm_sub_ps(_mm_mul_ps(r3, br), _mm_mul_ps(i3, bi));
+      __m128 t3i = _mm_add_ps(_mm_mul_ps(r3, bi), _mm_mul_ps(i3, br));
+      __m128 b0r = _mm_add_ps(r0, t1r), b0i = _mm_add_ps(i0, t1i);
+      __m128 b1r = _mm_sub_ps(r0, t1r), b1i = _mm_sub_ps(i0, t1i);
+      __m128 b2r = _mm_add_ps(r2, t3r), b2i = _mm_add_ps(i2, t3i);
+      __m128 b3r = _mm_sub_ps(r2, t3r), b3i = _mm_sub_ps(i2, t3i);
+
+      __m128 ur = _mm_sub_ps(_mm_mul_ps(b2r, ar), _mm_mul_ps(b2i, ai));
+      __m128 ui = _mm_add_ps(_mm_mul_ps(b2r, ai), _mm_mul_ps(b2i, ar));
+      __m128 vr = _mm_add_ps(_mm_mul_ps(b3r, ai), _mm_mul_ps(b3i, ar));
+      __m128 vi = _mm_sub_ps(_mm_mul_ps(b3i, ai), _mm_mul_ps(b3r, ar));
+
+      _mm_storeu_ps(r + j, _mm_add_ps(b0r, ur));
+      _mm_storeu_ps(i + j, _mm_add_ps(b0i, ui));
+      _mm_storeu_ps(r + j + m, _mm_add_ps(b1r, vr));
+      _mm_storeu_ps(i + j + m, _mm_add_ps(b1i, vi));
+      _mm_storeu_ps(r + j + 2 * m, _mm_sub_ps(b0r, ur));
+      _mm_storeu_ps(i + j + 2 * m, _mm_sub_ps(b0i, ui));
+      _mm_storeu_ps(r + j + 3 * m, _mm_sub_ps(b1r, vr));
+      _mm_storeu_ps(i + j + 3 * m, _mm_sub_ps(b1i, vi));
+    }
+  }
+}
+
+SSE2 static void complexMac(float *accRe, float *accIm, const float *aRe,
+                            const float *aIm, const float *bRe,
+                            const float *bIm, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 ar = _mm_loadu_ps(aRe + i), ai = _mm_loadu_ps(aIm + i);
+    __m128 br = _mm_loadu_ps(bRe + i), bi = _mm_loadu_ps(bIm + i);
+    __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+    __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+    _mm_storeu_ps(accRe + i, _mm_add_ps(_mm_loadu_ps(accRe + i), re));
+    _mm_storeu_ps(accIm + i, _mm_add_ps(_mm_loadu_ps(accIm + i), im));
+  }
+  dspScalar.complexMac(accRe + i, accIm + i, aRe + i, aIm + i, bRe + i,
+                       bIm + i, n - i);
+}
+
+SSE2 static void interleave2(float *dst, const float *left,
+                             const float *right, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 l = _mm_loadu_ps(left + i);
+    __m128 r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+  dspScalar.interleave2(dst + 2 * i, left + i, right + i, n - i);
+}
+
+SSE2 static void deinterleave2(float *left, float *right, const float *src,
+                               int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 a = _mm_loadu_ps(src + 2 * i);
+    __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  dspScalar.deinterleave2(left + i, right + i, src + 2 * i, n - i);
+}
+
+SSE2 static void floatToInt16(int16_t *dst, const float *src, int n) {
+  __m128 scale = _mm_set1_ps(32767.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i a =
+        _mm_cvtps_epi32(_mm_mul_ps(clamp4(_mm_loadu_ps(src + i)), scale));
+    __m128i b =
+        _mm_cvtps_epi32(_mm_mul_ps(clamp4(_mm_loadu_ps(src + i + 4)), scale));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+  }
+  dspScalar.floatToInt16(dst + i, src + i, n - i);
+}
+
+SSE2 static void int16ToFloat(float *dst, const int16_t *src, int n) {
+  __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+    // sign extend by placing each sample in the top half then shifting down
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  dspScalar.int16ToFloat(dst + i, src + i, n - i);
+}
+
+SSE2 static void floatToInt24(uint8_t *dst, const float *src, int n) {
+  // sse2 has no byte shuffle, convert 4 at a time then pack in scalar
+  __m128 scale = _mm_set1_ps(8388607.0f);
+  int32_t s[4];
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x =
+        _mm_cvtps_epi32(_mm_mul_ps(clamp4(_mm_loadu_ps(src + i)), scale));
+    _mm_storeu_si128((__m128i *)s, x);
+    for (int j = 0; j < 4; j++) {
+      dst[3 * (i + j)] = (uint8_t)s[j];
+      dst[3 * (i + j) + 1] = (uint8_t)(s[j] >> 8);
+      dst[3 * (i + j) + 2] = (uint8_t)(s[j] >> 16);
+    }
+  }
+  dspScalar.floatToInt24(dst + 3 * i, src + i, n - i);
+}
+
+SSE2 static void int24ToFloat(float *dst, const uint8_t *src, int n) {
+  __m128 scale = _mm_set1_ps(1.0f / 8388607.0f);
+  int32_t s[4];
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (int j = 0; j < 4; j++) {
+      const uint8_t *b = src + 3 * (i + j);
+      s[j] = (int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 |
+                       (uint32_t)b[2] << 24);
+    }
+    __m128i x = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)s), 8);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+  }
+  dspScalar.int24ToFloat(dst + i, src + 3 * i, n - i);
+}
+
+const struct DspKernels dspSse2 = {
+    .name = "sse2",
+    .add = add,
+    .mix = mix,
+    .gainRamp = gainRamp,
+    .mixRamp = mixRamp,
+    .dot = dot,
+    .cubic = cubic,
+    .geometric = geometric,
+    .affine = affine,
+    .levels = levels,
+    .fftRadix4 = fftRadix4,
+    .complexMac = complexMac,
+    .interleave2 = interleave2,
+    .deinterleave2 = deinterleave2,
+    .floatToInt16 = floatToInt16,
+    .int16ToFloat = int16ToFloat,
+    .floatToInt24 = floatToInt24,
+    .int24ToFloat = int24ToFloat,
+};
+#endif
@@ -0,0 +1,211 @@
+#include "engine.h"
+
+#include "clock.h"
+#include "lane.h"
+#include "scheduler.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMAND_CAPACITY 1024
+#define TELEMETRY_CAPACITY 1024
+
+struct EngineGraph {
+  CompiledGraph graph;
+  int output;
+};
+
+struct Engine {
+  int sampleRate;
+  int blockSize;
+  Scheduler scheduler;
+  struct MessageQueues queues;
+  Meters meters;
+  Profiler profiler;
+  SampleCache samples;
+  int reader;
+
+  // ui -> audio, the graph to play
+  Lane graphs;
+
+  // audio thread
+  uint32_t xruns;
+
+  // written by the audio thread, read anywhere
+  _Atomic uint64_t position;
+  atomic_int playing;
+};
+
+// PRIVATE FUNCTIONS
+
+static void freeEngineGraph(void *memory) {
+  struct EngineGraph *g = memory;
+  freeCompiledGraph(g->graph);
+  free(g);
+}
+
+// the engine owns its graphs outright
+static const struct LaneItems graphItems = {NULL, NULL, freeEngineGraph};
+
+static void applyCommand(Engine e, const struct Command *c) {
+  struct EngineGraph *g = laneCurrent(e->graphs);
+  switch (c->type) {
+  case COMMAND_SET_PARAM:
+    if (g) {
+      compiledSetParam(g->graph, (int)c->param.node, c->param.param,
+                       c->param.value);
+    }
+    break;
+  case COMMAND_TRANSPORT:
+    switch (c->transport.action) {
+    case TRANSPORT_PLAY:
+      atomic_store_explicit(&e->playing, 1, memory_order_relaxed);
+      break;
+    case TRANSPORT_STOP:
+      atomic_store_explicit(&e->playing, 0, memory_order_relaxed);
+      break;
+    case TRANSPORT_SEEK:
+      atomic_store_explicit(&e->position, c->transport.position,
+                            memory_order_relaxed);
+      break;
+    }
+    break;
+  case COMMAND_CLIP_EDIT:
+    // clips don't live on the audio side yet
+    break;
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Engine makeEngine(int sampleRate, int blockSize, int workers, int maxNodes) {
+  Engine e = calloc(1, sizeof(struct Engine));
+  e->sampleRate = sampleRate;
+  e->blockSize = blockSize;
+  e->scheduler = makeScheduler(workers, maxNodes, 1);
+  e->queues = makeMessageQueues(COMMAND_CAPACITY, TELEMETRY_CAPACITY);
+  e->graphs = makeLane(&graphItems, NULL, 0);
+  atomic_init(&e->position, 0);
+  atomic_init(&e->playing, 0);
+  return e;
+}
+
+void freeEngine(Engine e) {
+  freeLane(e->graphs);
+  if (e->samples) {
+    sampleCacheRemoveReader(e->samples, e->reader);
+  }
+  freeMessageQueues(e->queues);
+  freeScheduler(e->scheduler);
+  free(e);
+}
+
+struct MessageQueues engineQueues(Engine e) { return e->queues; }
+
+void engineSetGraph(Engine e, CompiledGraph graph, int output) {
+  struct EngineGraph *g = malloc(sizeof(struct EngineGraph));
+  g->graph = graph;
+  g->output = output;
+  laneSet(e->graphs, g);
+}
+
+void engineSetMeters(Engine e, Meters meters) { e->meters = meters; }
+
+void engineSetProfiler(Engine e, Profiler profiler) { e->profiler = profiler; }
+
+int engineSetSampleCache(Engine e, SampleCache cache) {
+  int reader = sampleCacheAddReader(cache);
+  if (reader < 0) {
+    return 0;
+  }
+  if (e->samples) {
+    sampleCacheRemoveReader(e->samples, e->reader);
+  }
+  e->samples = cache;
+  e->reader = reader;
+  return 1;
+}
+
+void engineCollect(Engine e) { laneCollect(e->graphs); }
+
+void engineProcess(Engine e, float *const *out, int channels, int frames) {
+  uint64_t start = clockNanos();
+
+  void *replaced;
+  if (lanePickUp(e->graphs, &replaced)) {
+    struct EngineGraph *next = laneCurrent(e->graphs), *previous = replaced;
+    if (previous) {
+      compiledTakeOver(next->graph, previous->graph);
+    }
+    laneRetire(e->graphs, previous);
+  }
+
+  struct Command command;
+  while (receiveCommand(e->queues, &command)) {
+    applyCommand(e, &command);
+  }
+
+  uint64_t position = atomic_load_explicit(&e->position, memory_order_relaxed);
+  int playing = atomic_load_explicit(&e->playing, memory_order_relaxed);
+
+  if (e->samples) {
+    sampleCacheEnter(e->samples, e->reader);
+  }
+  struct EngineGraph *g = laneCurrent(e->graphs);
+  if (g) {
+    schedulerRun(e->scheduler, g->graph, frames, position, playing);
+  }
+  int ports = g ? compiledOutputCount(g->graph, g->output) : 0;
+  for (int ch = 0; ch < channels; ch++) {
+    if (ch < ports) {
+      const float *src = compiledOutput(g->graph, g->output, ch);
+      memcpy(out[ch], src, frames * sizeof(float));
+    } else {
+      memset(out[ch], 0, frames * sizeof(float));
+    }
+  }
+  if (e->samples) {
+    sampleCacheLeave(e->samples, e->reader);
+  }
+
+  if (e->meters) {
+    meterPublish(e->meters, position);
+  }
+
+  if (playing) {
+    position += frames;
+    atomic_store_explicit(&e->position, position, memory_order_relaxed);
+  }
+  sendTelemetry(e->queues, (struct Telemetry){
+                               .type = TELEMETRY_PLAYHEAD,
+                               .playhead = position,
+                           });
+
+  uint64_t end = clockNanos();
+  if (e->profiler) {
+    profilerRecord(e->profiler, g ? g->graph : NULL, start, end,
+                   playing ? position - frames : position, frames,
+                   e->sampleRate);
+  }
+
+  uint64_t budget = (uint64_t)frames * 1000000000 / e->sampleRate;
+  if (end - start > budget) {
+    e->xruns++;
+    sendTelemetry(e->queues, (struct Telemetry){
+                                 .type = TELEMETRY_XRUNS,
+                                 .xruns = e->xruns,
+                             });
+  }
+}
+
+uint64_t enginePosition(Engine e) {
+  return atomic_load_explicit(&e->position, memory_order_relaxed);
+}
+
+int enginePlaying(Engine e) {
+  return atomic_load_explicit(&e->playing, memory_order_relaxed);
+}
+
+int engineSampleRate(Engine e) { return e->sampleRate; }
+
+int engineBlockSize(Engine e) { return e->blockSize; }
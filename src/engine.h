@@ -0,0 +1,56 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "graph.h"
+#include "message.h"
+#include "meter.h"
+#include "profiler.h"
+#include "samplecache.h"
+
+// the audio side of the daw: owns the transport, applies commands from the
+// ui, runs the current compiled graph and reports back. it has no device of
+// its own, whatever drives it (a device callback, or a test) calls
+// engineProcess once per block on the audio thread.
+typedef struct Engine *Engine;
+
+Engine makeEngine(int sampleRate, int blockSize, int workers, int maxNodes);
+void freeEngine(Engine e);
+
+// ui thread. the queues to talk to the engine through
+struct MessageQueues engineQueues(Engine e);
+
+// ui thread. hands a compiled graph to the audio thread, which switches to it
+// at the start of its next block, see compiledTakeOver. `output` is the node
+// whose output ports feed the device channels. the engine owns the graph
+// from here on.
+void engineSetGraph(Engine e, CompiledGraph graph, int output);
+
+// ui thread, before processing starts. meters are published after every
+// block, meter taps in the graph feed them
+void engineSetMeters(Engine e, Meters meters);
+
+// ui thread, before processing starts. every block's timing, and that of each
+// node in it, is recorded into the profiler
+void engineSetProfiler(Engine e, Profiler profiler);
+
+// ui thread, before processing starts. the audio thread reads samples from
+// the cache inside its blocks, evicted ones outlive the blocks that might
+// have seen them. returns 0 if the cache has no reader slot left
+int engineSetSampleCache(Engine e, SampleCache cache);
+
+// ui thread. frees graphs the audio thread has switched away from, call it
+// regularly (once per frame is plenty)
+void engineCollect(Engine e);
+
+// audio thread. renders `frames` frames (at most the block size) into the
+// planar `out` buffers. blocks that take longer than their duration count as
+// xruns.
+void engineProcess(Engine e, float *const *out, int channels, int frames);
+
+// any thread
+uint64_t enginePosition(Engine e);
+int enginePlaying(Engine e);
+int engineSampleRate(Engine e);
+int engineBlockSize(Engine e);
+
+#endif
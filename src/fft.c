@@ -0,0 +1,179 @@
+#include "fft.h"
+
+#include "dsp.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define MAX_SIZE (1 << 24)
+
+struct Fft {
+  int size;
+  int half; // points of the complex transform
+  int *reverse;
+
+  // every radix-4 pass back to back, 4m floats for the pass of span m
+  float *twiddles;
+  int firstSpan; // 2 when a radix-2 pass goes first, 1 otherwise
+
+  // e^(-2 pi i k / size) for k <= half/2, to split the packed transform
+  float *splitRe, *splitIm;
+};
+
+// PRIVATE FUNCTIONS
+
+static int log2i(int n) {
+  int bits = 0;
+  while ((1 << bits) < n) {
+    bits++;
+  }
+  return bits;
+}
+
+// the complex transform of bit reversed input, in place
+static void transform(Fft f, float *re, float *im) {
+  int half = f->half;
+  if (f->firstSpan == 2) {
+    for (int k = 0; k < half; k += 2) {
+      float ar = re[k], ai = im[k], br = re[k + 1], bi = im[k + 1];
+      re[k] = ar + br, im[k] = ai + bi;
+      re[k + 1] = ar - br, im[k + 1] = ai - bi;
+    }
+  }
+  const float *w = f->twiddles;
+  for (int m = f->firstSpan; m < half; m *= 4) {
+    dsp->fftRadix4(re, im, half, m, w);
+    w += 4 * m;
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Fft makeFft(int size) {
+  if (size < 4 || size > MAX_SIZE || (size & (size - 1))) {
+    return NULL;
+  }
+
+  Fft f = malloc(sizeof(struct Fft));
+  f->size = size;
+  f->half = size / 2;
+
+  int bits = log2i(f->half);
+  f->reverse = malloc(f->half * sizeof(int));
+  for (int n = 0; n < f->half; n++) {
+    int r = 0;
+    for (int b = 0; b < bits; b++) {
+      r |= ((n >> b) & 1) << (bits - 1 - b);
+    }
+    f->reverse[n] = r;
+  }
+
+  // an odd number of doublings leaves one radix-2 pass, do it first where
+  // it needs no twiddles
+  f->firstSpan = bits % 2 ? 2 : 1;
+  size_t count = 0;
+  for (int m = f->firstSpan; m < f->half; m *= 4) {
+    count += 4 * (size_t)m;
+  }
+  f->twiddles = malloc((count ? count : 1) * sizeof(float));
+  float *w = f->twiddles;
+  for (int m = f->firstSpan; m < f->half; m *= 4) {
+    for (int j = 0; j < m; j++) {
+      double angle = -2.0 * DSP_PI * j / (4.0 * m);
+      w[j] = (float)cos(angle);
+      w[m + j] = (float)sin(angle);
+      w[2 * m + j] = (float)cos(2 * angle);
+      w[3 * m + j] = (float)sin(2 * angle);
+    }
+    w += 4 * m;
+  }
+
+  int quarter = f->half / 2;
+  f->splitRe = malloc((quarter + 1) * sizeof(float));
+  f->splitIm = malloc((quarter + 1) * sizeof(float));
+  for (int k = 0; k <= quarter; k++) {
+    double angle = -2.0 * DSP_PI * k / size;
+    f->splitRe[k] = (float)cos(angle);
+    f->splitIm[k] = (float)sin(angle);
+  }
+  return f;
+}
+
+void freeFft(Fft f) {
+  free(f->reverse);
+  free(f->twiddles);
+  free(f->splitRe);
+  free(f->splitIm);
+  free(f);
+}
+
+int fftSize(Fft f) { return f->size; }
+
+void fftForward(Fft f, const float *in, float *re, float *im) {
+  int half = f->half;
+
+  // even samples as the real part, odd as the imaginary, bit reversed on the
+  // way in
+  for (int n = 0; n < half; n++) {
+    re[f->reverse[n]] = in[2 * n];
+    im[f->reverse[n]] = in[2 * n + 1];
+  }
+
+  transform(f, re, im);
+
+  // z[k] = even[k] + i odd[k], the two halves of the spectrum come out of
+  // z[k] and z[half - k] together so this can work in place
+  float z0r = re[0], z0i = im[0];
+  re[0] = z0r + z0i, im[0] = 0;
+  re[half] = z0r - z0i, im[half] = 0;
+  for (int k = 1; k <= half / 2; k++) {
+    float ar = re[k], ai = im[k];
+    float br = re[half - k], bi = im[half - k];
+
+    float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+    float odr = 0.5f * (ai + bi), odi = 0.5f * (br - ar);
+    float tr = odr * f->splitRe[k] - odi * f->splitIm[k];
+    float ti = odr * f->splitIm[k] + odi * f->splitRe[k];
+
+    re[k] = er + tr, im[k] = ei + ti;
+    re[half - k] = er - tr, im[half - k] = ti - ei;
+  }
+}
+
+void fftInverse(Fft f, float *re, float *im, float *out) {
+  int half = f->half;
+
+  // undo the split: even + i odd again, from x[k] and x[half - k] together.
+  // the halves are left out, which is where the factor of size comes from
+  float x0 = re[0], xh = re[half];
+  re[0] = x0 + xh, im[0] = x0 - xh;
+  for (int k = 1; k <= half / 2; k++) {
+    float ar = re[k], ai = im[k];
+    float br = re[half - k], bi = im[half - k];
+
+    float er = ar + br, ei = ai - bi;
+    float dr = ar - br, di = ai + bi;
+    float odr = dr * f->splitRe[k] + di * f->splitIm[k];
+    float odi = di * f->splitRe[k] - dr * f->splitIm[k];
+
+    re[k] = er - odi, im[k] = ei + odr;
+    re[half - k] = er + odi, im[half - k] = odr - ei;
+  }
+
+  // bit reversal is its own inverse, swap in place
+  for (int n = 0; n < half; n++) {
+    int r = f->reverse[n];
+    if (n < r) {
+      float t = re[n];
+      re[n] = re[r], re[r] = t;
+      t = im[n];
+      im[n] = im[r], im[r] = t;
+    }
+  }
+
+  // the inverse transform is the forward one with re and im swapped
+  transform(f, im, re);
+  for (int n = 0; n < half; n++) {
+    out[2 * n] = re[n];
+    out[2 * n + 1] = im[n];
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef FFT_H
+#define FFT_H
+
+// power of two fft for real signals. a length n real input is packed into an
+// n/2 point complex transform, radix-4 passes with one radix-2 pass when the
+// log is odd, twiddles and the bit reversal precomputed. the passes run on
+// the dsp kernels so they pick up the widest simd the cpu has.
+typedef struct Fft *Fft;
+
+// not real-time safe. returns NULL unless size is a power of two >= 4
+Fft makeFft(int size);
+void freeFft(Fft f);
+
+int fftSize(Fft f);
+
+// real-time safe. size real samples in, size/2 + 1 bins out as separate real
+// and imaginary arrays, unnormalized. in must not alias re or im
+void fftForward(Fft f, const float *in, float *re, float *im);
+
+// real-time safe. the other way, size/2 + 1 bins in, size real samples out,
+// scaled by size so a round trip multiplies by size. re and im are used as
+// scratch and come back clobbered
+void fftInverse(Fft f, float *re, float *im, float *out);
+
+#endif
@@ -0,0 +1,323 @@
+#define _POSIX_C_SOURCE 200809L
+#include "freeze.h"
+
+#include "hash.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// renders are named by their key, 16 hex digits, and written under another
+// extension until they're complete
+#define KEY_DIGITS 16
+#define RENDER_EXTENSION ".wav"
+#define PARTIAL_EXTENSION ".part"
+
+// seconds a frozen track reads ahead, the streamer's ring per track
+#define PREFETCH_SECONDS 2.0
+
+// output ports a frozen track fills, more stay silent
+#define MAX_CHANNELS 16
+
+struct Render {
+  uint64_t key;
+  uint64_t bytes;
+  uint64_t used; // nanoseconds since the epoch, eviction goes by it
+};
+
+struct FreezeCache {
+  char *directory;
+  uint64_t budget;
+  struct Render *renders;
+  int count, capacity;
+  uint64_t bytes;
+};
+
+struct FrozenTrack {
+  Streamer streamer;
+  StreamClip clip;
+  uint64_t start;  // transport position of the render's first frame
+  uint64_t frames; // of the render
+
+  // audio thread
+  uint64_t next; // render frame the stream reads next
+};
+
+// PRIVATE FUNCTIONS
+
+static void hashNumber(struct Hasher *s, uint64_t value) {
+  hashBytes(s, &value, sizeof(value));
+}
+
+static void hashString(struct Hasher *s, const char *string) {
+  hashBytes(s, string, strlen(string) + 1);
+}
+
+// a source file edited in place changes the render as much as a moved clip
+static void hashSource(struct Hasher *s, const char *path) {
+  struct stat st;
+  int found = stat(path, &st) == 0;
+  hashString(s, path);
+  hashNumber(s, found ? (uint64_t)st.st_size : UINT64_MAX);
+  hashNumber(s, found ? (uint64_t)st.st_mtime : UINT64_MAX);
+}
+
+static uint64_t nowNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int renderPath(FreezeCache c, uint64_t key, const char *extension,
+                      char *path, size_t size) {
+  int n = snprintf(path, size, "%s/%016llx%s", c->directory,
+                   (unsigned long long)key, extension);
+  return n > 0 && (size_t)n < size;
+}
+
+static int findRender(FreezeCache c, uint64_t key) {
+  for (int i = 0; i < c->count; i++) {
+    if (c->renders[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void addRender(FreezeCache c, struct Render render) {
+  int i = findRender(c, render.key);
+  if (i >= 0) {
+    c->bytes -= c->renders[i].bytes;
+  } else {
+    if (c->count == c->capacity) {
+      c->capacity = c->capacity ? 2 * c->capacity : 64;
+      c->renders = realloc(c->renders, c->capacity * sizeof(struct Render));
+    }
+    i = c->count++;
+  }
+  c->renders[i] = render;
+  c->bytes += render.bytes;
+}
+
+// least recently used first, never `keep`
+static void evict(FreezeCache c, uint64_t keep) {
+  size_t size = strlen(c->directory) + KEY_DIGITS + 16;
+  char *path = malloc(size);
+  while (c->bytes > c->budget) {
+    int oldest = -1;
+    for (int i = 0; i < c->count; i++) {
+      if (c->renders[i].key != keep &&
+          (oldest < 0 || c->renders[i].used < c->renders[oldest].used)) {
+        oldest = i;
+      }
+    }
+    if (oldest < 0) {
+      break;
+    }
+    if (renderPath(c, c->renders[oldest].key, RENDER_EXTENSION, path, size)) {
+      unlink(path);
+    }
+    c->bytes -= c->renders[oldest].bytes;
+    c->renders[oldest] = c->renders[--c->count];
+  }
+  free(path);
+}
+
+// picks up a file of the cache directory: a render, or a partial one left by
+// a crash, which goes
+static void scanEntry(FreezeCache c, const char *name) {
+  size_t length = strlen(name);
+  const char *extension = name + KEY_DIGITS;
+  if (length <= KEY_DIGITS || strspn(name, "0123456789abcdef") != KEY_DIGITS) {
+    return;
+  }
+
+  size_t size = strlen(c->directory) + length + 2;
+  char *path = malloc(size);
+  snprintf(path, size, "%s/%s", c->directory, name);
+  struct stat st;
+  if (strcmp(extension, PARTIAL_EXTENSION) == 0) {
+    unlink(path);
+  } else if (strcmp(extension, RENDER_EXTENSION) == 0 &&
+             stat(path, &st) == 0) {
+    addRender(c, (struct Render){strtoull(name, NULL, 16),
+                                 (uint64_t)st.st_size,
+                                 (uint64_t)st.st_mtime * 1000000000});
+  }
+  free(path);
+}
+
+// PUBLIC FUNCTIONS
+
+uint64_t freezeKey(Track t, const void *processing, size_t bytes,
+                   struct FreezeRange range) {
+  struct Hasher s;
+  hashStart(&s);
+  hashNumber(&s, (uint64_t)range.sampleRate);
+  hashNumber(&s, (uint64_t)range.channels);
+  hashNumber(&s, range.start);
+  hashNumber(&s, range.frames);
+  hashNumber(&s, bytes);
+  hashBytes(&s, processing, bytes);
+
+  hashNumber(&s, (uint64_t)trackClipCount(t));
+  for (int i = 0; i < trackClipCount(t); i++) {
+    struct ClipState clip = trackClip(t, i);
+    hashNumber(&s, clip.start);
+    hashNumber(&s, clip.length);
+    hashNumber(&s, clip.offset);
+    hashNumber(&s, clip.flags);
+    hashSource(&s, clip.source);
+  }
+
+  NoteTrack notes = trackNotes(t);
+  int count = notes ? noteTrackCount(notes) : 0;
+  hashNumber(&s, (uint64_t)count);
+  if (count > 0) {
+    struct NoteColumns columns = noteTrackColumns(notes);
+    hashBytes(&s, columns.starts, count * sizeof(uint64_t));
+    hashBytes(&s, columns.lengths, count * sizeof(uint32_t));
+    hashBytes(&s, columns.pitches, count);
+    hashBytes(&s, columns.velocities, count);
+  }
+
+  hashNumber(&s, (uint64_t)trackLaneCount(t));
+  for (int i = 0; i < trackLaneCount(t); i++) {
+    struct LaneState lane = trackLane(t, i);
+    hashNumber(&s, lane.param);
+    hashNumber(&s, (uint64_t)automationCount(lane.curve));
+    hashBytes(&s, automationPoints(lane.curve),
+              automationCount(lane.curve) * sizeof(struct Breakpoint));
+  }
+  return hashEnd(&s);
+}
+
+FreezeCache makeFreezeCache(const char *directory, uint64_t budget) {
+  mkdir(directory, 0755);
+  DIR *dir = opendir(directory);
+  if (!dir) {
+    return NULL;
+  }
+
+  FreezeCache c = calloc(1, sizeof(struct FreezeCache));
+  c->directory = strdup(directory);
+  c->budget = budget;
+  for (struct dirent *entry; (entry = readdir(dir));) {
+    scanEntry(c, entry->d_name);
+  }
+  closedir(dir);
+  evict(c, 0);
+  return c;
+}
+
+void freeFreezeCache(FreezeCache c) {
+  free(c->renders);
+  free(c->directory);
+  free(c);
+}
+
+int freezeCacheFind(FreezeCache c, uint64_t key, char *path, size_t size) {
+  int i = findRender(c, key);
+  if (i < 0 || !renderPath(c, key, RENDER_EXTENSION, path, size)) {
+    return 0;
+  }
+
+  // the file's time is the use, so the order survives a restart
+  if (utimensat(AT_FDCWD, path, NULL, 0) != 0) {
+    // gone behind our back
+    c->bytes -= c->renders[i].bytes;
+    c->renders[i] = c->renders[--c->count];
+    return 0;
+  }
+  c->renders[i].used = nowNanos();
+  return 1;
+}
+
+int freezeCacheRender(FreezeCache c, uint64_t key, CompiledGraph graph,
+                      int node, struct FreezeRange range, char *path,
+                      size_t size) {
+  size_t partialSize = strlen(c->directory) + KEY_DIGITS + 16;
+  char *partial = malloc(partialSize);
+  if (!renderPath(c, key, RENDER_EXTENSION, path, size) ||
+      !renderPath(c, key, PARTIAL_EXTENSION, partial, partialSize)) {
+    free(partial);
+    return 0;
+  }
+
+  // float samples, so the frozen track plays exactly what it would have
+  struct BounceStem stem = {partial, node, range.channels, SAMPLE_FLOAT32};
+  struct BounceResult result =
+      bounce(graph, &stem, 1,
+             (struct BounceSettings){.sampleRate = range.sampleRate,
+                                     .start = range.start,
+                                     .frames = range.frames});
+  struct stat st;
+  int ok = result.ok && rename(partial, path) == 0 && stat(path, &st) == 0;
+  if (!ok) {
+    unlink(partial);
+  }
+  free(partial);
+  if (!ok) {
+    return 0;
+  }
+
+  addRender(c, (struct Render){key, (uint64_t)st.st_size, nowNanos()});
+  evict(c, key);
+  return 1;
+}
+
+int freezeCacheCount(FreezeCache c) { return c->count; }
+
+uint64_t freezeCacheBytes(FreezeCache c) { return c->bytes; }
+
+FrozenTrack makeFrozenTrack(Streamer s, const char *path, uint64_t start) {
+  StreamClip clip = streamerOpen(s, path, PREFETCH_SECONDS);
+  if (!clip) {
+    return NULL;
+  }
+  FrozenTrack f = malloc(sizeof(struct FrozenTrack));
+  f->streamer = s;
+  f->clip = clip;
+  f->start = start;
+  f->frames = streamClipFormat(clip).frames;
+  f->next = 0;
+  return f;
+}
+
+void freeFrozenTrack(FrozenTrack f) {
+  streamerClose(f->streamer, f->clip);
+  free(f);
+}
+
+void frozenTrackProcess(void *state, const struct ProcessContext *ctx) {
+  FrozenTrack f = state;
+  for (int ch = 0; ch < ctx->outputCount; ch++) {
+    memset(ctx->outputs[ch], 0, ctx->frames * sizeof(float));
+  }
+  uint64_t from = ctx->position, to = from + ctx->frames;
+  uint64_t end = f->start + f->frames;
+  if (!ctx->playing || to <= f->start || from >= end) {
+    return;
+  }
+
+  // the part of the block the render covers
+  int offset = from < f->start ? (int)(f->start - from) : 0;
+  uint64_t frame = from + offset - f->start;
+  int frames = (int)((to < end ? to : end) - (from + offset));
+  if (frame != f->next) {
+    streamClipSeek(f->clip, frame);
+  }
+  f->next = frame + frames;
+
+  float *channels[MAX_CHANNELS];
+  int count = ctx->outputCount < MAX_CHANNELS ? ctx->outputCount
+                                              : MAX_CHANNELS;
+  for (int ch = 0; ch < count; ch++) {
+    channels[ch] = ctx->outputs[ch] + offset;
+  }
+  streamClipRead(f->clip, channels, count, frames);
+}
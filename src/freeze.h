@@ -0,0 +1,78 @@
+#ifndef FREEZE_H
+#define FREEZE_H
+
+#include "bounce.h"
+#include "graph.h"
+#include "model.h"
+#include "stream.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// track freezing. a track whose processing is expensive and whose inputs
+// aren't being edited is rendered once, offline, into a cache of files, and
+// plays back from disk through the streamer in place of its processing.
+//
+// renders are found by a content hash of everything they depend on, so any
+// change to a track's inputs simply misses the cache and the old render ages
+// out. the least recently used renders go once the cache is over its disk
+// budget.
+
+// what a render covers
+struct FreezeRange {
+  int sampleRate;
+  int channels;
+  uint64_t start;  // transport position of the first frame, in samples
+  uint64_t frames;
+};
+
+// the content hash of a render of `t`: its clips along with the size and
+// modification time of each source file, notes, automation, the state of its
+// processing passed in as bytes, and the range. fader, pan and mute stay live
+// after the frozen output, they aren't part of it
+uint64_t freezeKey(Track t, const void *processing, size_t bytes,
+                   struct FreezeRange range);
+
+// THE CACHE
+
+// one thread at a time
+typedef struct FreezeCache *FreezeCache;
+
+// picks up the renders already in `directory`, creating it if needed, and
+// evicts down to `budget` bytes. NULL if the directory can't be used
+FreezeCache makeFreezeCache(const char *directory, uint64_t budget);
+void freeFreezeCache(FreezeCache c);
+
+// writes the path of the render for `key` into `path` and counts it as used.
+// returns 0 if there's none
+int freezeCacheFind(FreezeCache c, uint64_t key, char *path, size_t size);
+
+// renders `channels` output ports of `node` with bounce and adds the file
+// under `key`, then evicts least recently used renders until the cache fits
+// its budget, never the new one. blocks, and the graph mustn't be running
+// elsewhere, as with bounce. an evicted file being streamed keeps playing,
+// the open file outlives its name. returns 0 if the render failed
+int freezeCacheRender(FreezeCache c, uint64_t key, CompiledGraph graph,
+                      int node, struct FreezeRange range, char *path,
+                      size_t size);
+
+int freezeCacheCount(FreezeCache c);
+uint64_t freezeCacheBytes(FreezeCache c);
+
+// PLAYBACK
+
+// a frozen track, streamed from its render
+typedef struct FrozenTrack *FrozenTrack;
+
+// ui thread. `start` is the transport position the render begins at. NULL if
+// the file can't be streamed
+FrozenTrack makeFrozenTrack(Streamer s, const char *path, uint64_t start);
+
+// ui thread, once the audio thread is done with it
+void freeFrozenTrack(FrozenTrack f);
+
+// a node with no inputs and an output per channel of the render, silent
+// outside it. the state is the frozen track. a jump in the transport costs a
+// stream seek, like any streamed clip
+void frozenTrackProcess(void *state, const struct ProcessContext *ctx);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+// what the ui is made of, free of any windowing or vulkan headers so the code
+// building it can run anywhere
+struct Vec2 {
+  float x, y;
+};
+
+struct Vertex {
+  struct Vec2 pos;
+};
+
+#endif
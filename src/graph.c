@@ -0,0 +1,725 @@
+#include "graph.h"
+
+#include "clock.h"
+#include "die.h"
+#include "dsp.h"
+#include "rtmem.h"
+#include "spsc.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// frames a connection whose delay changed crossfades over, about 5 ms
+#define DELAY_FADE 256
+
+// EDITABLE GRAPH
+
+struct Connection {
+  int from, fromPort;
+  int to, toPort;
+  int most; // the longest delay any compile that may yet be replaced gave it
+  int next; // the longest delay any compile since the mark gave it
+};
+
+struct Graph {
+  struct NodeDescription *nodes;
+  int nodeCount;
+
+  struct Connection *connections;
+  int connectionCount;
+
+  // compiles so far, the first compile `next` covers, and the newest compile
+  // that took over on the audio thread. once that's caught up with the mark
+  // nothing before the mark can run again
+  uint64_t compiles;
+  uint64_t mark;
+  _Atomic uint64_t running;
+};
+
+Graph makeGraph(void) {
+  Graph g = malloc(sizeof(struct Graph));
+  g->nodes = NULL;
+  g->nodeCount = 0;
+  g->connections = NULL;
+  g->connectionCount = 0;
+  g->compiles = 0;
+  g->mark = 0;
+  atomic_init(&g->running, 0);
+  return g;
+}
+
+void freeGraph(Graph g) {
+  free(g->nodes);
+  free(g->connections);
+  free(g);
+}
+
+int graphAddNode(Graph g, struct NodeDescription node) {
+  if (node.latency < 0 || node.latency > GRAPH_MAX_LATENCY) {
+    die("Invalid latency %d for node %s\n", node.latency, node.name);
+  }
+  g->nodes = realloc(g->nodes, (g->nodeCount + 1) * sizeof(*g->nodes));
+  g->nodes[g->nodeCount] = node;
+  return g->nodeCount++;
+}
+
+void graphConnect(Graph g, int from, int fromPort, int to, int toPort) {
+  if (from < 0 || from >= g->nodeCount || to < 0 || to >= g->nodeCount ||
+      fromPort < 0 || fromPort >= g->nodes[from].outputs || toPort < 0 ||
+      toPort >= g->nodes[to].inputs) {
+    die("Invalid connection %d:%d -> %d:%d\n", from, fromPort, to, toPort);
+  }
+
+  g->connections = realloc(g->connections, (g->connectionCount + 1) *
+                                               sizeof(*g->connections));
+  g->connections[g->connectionCount++] =
+      (struct Connection){from, fromPort, to, toPort, 0, 0};
+}
+
+void graphDisconnect(Graph g, int from, int fromPort, int to, int toPort) {
+  for (int i = 0; i < g->connectionCount; i++) {
+    struct Connection c = g->connections[i];
+    if (c.from == from && c.fromPort == fromPort && c.to == to &&
+        c.toPort == toPort) {
+      g->connections[i] = g->connections[--g->connectionCount];
+      return;
+    }
+  }
+}
+
+int graphNodeCount(Graph g) { return g->nodeCount; }
+
+void graphSetLatency(Graph g, int node, int latency) {
+  if (node < 0 || node >= g->nodeCount || latency < 0 ||
+      latency > GRAPH_MAX_LATENCY) {
+    die("Invalid latency %d for node %d\n", latency, node);
+  }
+  g->nodes[node].latency = latency;
+}
+
+// COMPILED GRAPH
+
+// what one connection reads from a delay line, a block at a time
+struct DelayTap {
+  int to, toPort; // the connection
+  int delay;
+  int from;     // the delay it's crossfading from
+  int fade;     // frames of the crossfade left
+  int entering; // it began reading before the line's start, fading in
+  float *buffer;
+};
+
+// the recent past of one output, for the connections that need it later
+struct DelayLine {
+  int port;
+  const float *source;
+  float *ring;
+  int capacity;    // a power of two, the longest delay, a block and a fade
+  int64_t written; // frames so far
+  int64_t start;   // before it the ring is made up, silence
+  struct DelayTap *taps;
+  int tapCount;
+};
+
+struct CompiledNode {
+  // hot, written every block
+  _Alignas(CACHE_LINE_SIZE) atomic_int pending;
+  _Atomic uint64_t started;
+  _Atomic uint64_t nanos;
+  atomic_int worker;
+
+  // read-only after compilation
+  const char *name;
+  ProcessFunc process;
+  SetParamFunc setParam;
+  void *state;
+  int dependencies;
+  int *dependents;
+  int dependentCount;
+
+  // inputs[i] points straight at the source's output if there is exactly one
+  // connection, at a mix buffer if there are several, else at silence
+  const float **inputs;
+  int inputCount;
+  float **mixes;          // NULL for inputs that don't need summing
+  const float ***sources; // per input, the outputs summed into its mix
+  int *sourceCounts;
+
+  float **outputs;
+  int outputCount;
+
+  // frames its outputs lag the roots by, and the delays its outputs need
+  int latency;
+  struct DelayLine *lines;
+  int lineCount;
+};
+
+struct CompiledGraph {
+  struct CompiledNode *nodes;
+  int nodeCount;
+  int blockSize;
+  int frames;
+  uint64_t position;
+  int playing;
+
+  int *order;
+  int *roots;
+  int rootCount;
+
+  float *silence;
+  float *buffers; // one locked allocation backing every port buffer
+  size_t bufferBytes;
+  float *delays; // and one backing every delay line and tap
+  size_t delayBytes;
+
+  // which compile of the graph this is, told to the graph on taking over
+  uint64_t generation;
+  _Atomic uint64_t *running;
+};
+
+static float *takeBuffer(float **cursor, int blockSize) {
+  float *buffer = *cursor;
+  *cursor += blockSize;
+  return buffer;
+}
+
+static float readLine(const struct DelayLine *l, int64_t at) {
+  return at < l->start ? 0 : l->ring[at & (l->capacity - 1)];
+}
+
+// the block the line's node just wrote goes in, every tap reads its own
+static void runLine(struct DelayLine *l, int frames) {
+  int mask = l->capacity - 1;
+  int at = (int)(l->written & mask);
+  int first = frames < l->capacity - at ? frames : l->capacity - at;
+  memcpy(l->ring + at, l->source, first * sizeof(float));
+  memcpy(l->ring, l->source + first, (frames - first) * sizeof(float));
+
+  for (int t = 0; t < l->tapCount; t++) {
+    struct DelayTap *tap = &l->taps[t];
+    int64_t from = l->written - tap->delay;
+    if (!tap->fade && !tap->entering) {
+      at = (int)(from & mask);
+      first = frames < l->capacity - at ? frames : l->capacity - at;
+      memcpy(tap->buffer, l->ring + at, first * sizeof(float));
+      memcpy(tap->buffer + first, l->ring, (frames - first) * sizeof(float));
+      continue;
+    }
+    for (int i = 0; i < frames; i++) {
+      float x = readLine(l, from + i);
+      if (tap->entering) {
+        int64_t real = from + i - l->start;
+        x *= real < 0            ? 0.0f
+             : real < DELAY_FADE ? (float)real / DELAY_FADE
+                                 : 1.0f;
+      }
+      if (tap->fade > 0) {
+        float old = readLine(l, l->written + i - tap->from);
+        x += (float)tap->fade-- / DELAY_FADE * (old - x);
+      }
+      tap->buffer[i] = x;
+    }
+    tap->entering &= from + frames - l->start < DELAY_FADE;
+  }
+  l->written += frames;
+}
+
+static struct DelayLine *findLine(struct CompiledNode *node, int port) {
+  for (int l = 0; l < node->lineCount; l++) {
+    if (node->lines[l].port == port) {
+      return &node->lines[l];
+    }
+  }
+  return NULL;
+}
+
+static struct DelayTap *findTap(struct DelayLine *l, int to, int toPort) {
+  for (int t = 0; t < l->tapCount; t++) {
+    if (l->taps[t].to == to && l->taps[t].toPort == toPort) {
+      return &l->taps[t];
+    }
+  }
+  return NULL;
+}
+
+// whether `node` fed `to` at all, with or without a delay
+static int connected(const struct CompiledNode *node, int to) {
+  for (int j = 0; j < node->dependentCount; j++) {
+    if (node->dependents[j] == to) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// a fresh line's past becomes as much of the old one's as it holds. without
+// an old one the output's past is unknown and starts now
+static void inherit(struct DelayLine *l, const struct DelayLine *old) {
+  if (!old) {
+    l->start = 0;
+    return;
+  }
+  int kept = old->capacity < l->capacity ? old->capacity : l->capacity;
+  for (int k = 1; k <= kept; k++) {
+    l->ring[-k & (l->capacity - 1)] =
+        old->ring[(old->written - k) & (old->capacity - 1)];
+  }
+  int64_t start = old->start - old->written;
+  l->start = start > -kept ? start : -kept;
+}
+
+// lines every node's inputs up with the latest path into it, by giving the
+// connections from earlier paths a tap on a delay line at their source's
+// output. a connection keeps a tap, and a line that long, while any compile
+// that delayed it may still be running, so this one can crossfade down from
+// whatever delay the running compile has. `slots` are where each
+// connection's destination reads it from
+static void compensate(CompiledGraph c, Graph g, const float ***slots,
+                       int stride) {
+  int n = c->nodeCount, m = g->connectionCount;
+
+  // once a compile from the mark on has taken over, the ones before it are
+  // gone for good and only what came since still counts
+  c->generation = ++g->compiles;
+  c->running = &g->running;
+  if (atomic_load_explicit(&g->running, memory_order_relaxed) >= g->mark) {
+    for (int i = 0; i < m; i++) {
+      g->connections[i].most = g->connections[i].next;
+      g->connections[i].next = 0;
+    }
+    g->mark = c->generation;
+  }
+
+  // connections by destination, so each node's arrival is known before its
+  // latency is worked out
+  int *into = calloc(n + 1, sizeof(int));
+  int *byDestination = malloc((m > 0 ? m : 1) * sizeof(int));
+  for (int i = 0; i < m; i++) {
+    into[g->connections[i].to + 1]++;
+  }
+  for (int i = 0; i < n; i++) {
+    into[i + 1] += into[i];
+  }
+  int *filled = calloc(n > 0 ? n : 1, sizeof(int));
+  for (int i = 0; i < m; i++) {
+    int to = g->connections[i].to;
+    byDestination[into[to] + filled[to]++] = i;
+  }
+  int *arrival = calloc(n > 0 ? n : 1, sizeof(int));
+  for (int k = 0; k < n; k++) {
+    int u = c->order[k];
+    for (int j = into[u]; j < into[u + 1]; j++) {
+      int from = g->connections[byDestination[j]].from;
+      int latency = c->nodes[from].latency;
+      arrival[u] = latency > arrival[u] ? latency : arrival[u];
+    }
+    c->nodes[u].latency = arrival[u] + g->nodes[u].latency;
+    if (c->nodes[u].latency > GRAPH_MAX_LATENCY) {
+      die("Latency of %d frames at node %d exceeds %d\n", c->nodes[u].latency,
+          u, GRAPH_MAX_LATENCY);
+    }
+  }
+
+  // which outputs need a line, for how many taps and how long a delay
+  int *portBase = malloc((n + 1) * sizeof(int));
+  portBase[0] = 0;
+  for (int i = 0; i < n; i++) {
+    portBase[i + 1] = portBase[i] + g->nodes[i].outputs;
+  }
+  int ports = portBase[n] > 0 ? portBase[n] : 1;
+  int *tapCounts = calloc(ports, sizeof(int));
+  int *longest = calloc(ports, sizeof(int));
+  int *lineOf = malloc(ports * sizeof(int));
+  int *delays = malloc((m > 0 ? m : 1) * sizeof(int));
+  for (int i = 0; i < m; i++) {
+    struct Connection conn = g->connections[i];
+    delays[i] = arrival[conn.to] - c->nodes[conn.from].latency;
+    if (delays[i] > 0 || conn.most > 0) {
+      int port = portBase[conn.from] + conn.fromPort;
+      int most = delays[i] > conn.most ? delays[i] : conn.most;
+      tapCounts[port]++;
+      longest[port] = most > longest[port] ? most : longest[port];
+    }
+  }
+
+  size_t floats = 0;
+  for (int i = 0; i < n; i++) {
+    struct CompiledNode *node = &c->nodes[i];
+    for (int p = 0; p < node->outputCount; p++) {
+      node->lineCount += tapCounts[portBase[i] + p] > 0;
+    }
+    if (node->lineCount) {
+      node->lines = calloc(node->lineCount, sizeof(struct DelayLine));
+    }
+    int line = 0;
+    for (int p = 0; p < node->outputCount; p++) {
+      int port = portBase[i] + p;
+      if (!tapCounts[port]) {
+        continue;
+      }
+      struct DelayLine *l = &node->lines[line];
+      lineOf[port] = line++;
+      l->port = p;
+      l->source = node->outputs[p];
+      l->capacity = 1;
+      while (l->capacity < longest[port] + c->blockSize + DELAY_FADE) {
+        l->capacity *= 2;
+      }
+      l->start = -l->capacity;
+      l->taps = calloc(tapCounts[port], sizeof(struct DelayTap));
+      floats += l->capacity + (size_t)tapCounts[port] * stride;
+    }
+  }
+
+  c->delayBytes = floats * sizeof(float);
+  c->delays = floats ? rtAlloc(c->delayBytes) : NULL;
+  float *cursor = c->delays;
+  for (int i = 0; i < n; i++) {
+    for (int l = 0; l < c->nodes[i].lineCount; l++) {
+      struct DelayLine *line = &c->nodes[i].lines[l];
+      line->ring = takeBuffer(&cursor, line->capacity);
+    }
+  }
+  for (int i = 0; i < m; i++) {
+    struct Connection *conn = &g->connections[i];
+    if (delays[i] > 0 || conn->most > 0) {
+      int port = portBase[conn->from] + conn->fromPort;
+      struct DelayLine *l = &c->nodes[conn->from].lines[lineOf[port]];
+      struct DelayTap *tap = &l->taps[l->tapCount++];
+      *tap = (struct DelayTap){
+          .to = conn->to,
+          .toPort = conn->toPort,
+          .delay = delays[i],
+          .from = delays[i],
+          .buffer = takeBuffer(&cursor, stride),
+      };
+      *slots[i] = tap->buffer;
+    }
+    conn->most = delays[i] > conn->most ? delays[i] : conn->most;
+    conn->next = delays[i] > conn->next ? delays[i] : conn->next;
+  }
+
+  free(into);
+  free(byDestination);
+  free(filled);
+  free(arrival);
+  free(portBase);
+  free(tapCounts);
+  free(longest);
+  free(lineOf);
+  free(delays);
+}
+
+CompiledGraph compileGraph(Graph g, int blockSize) {
+  int n = g->nodeCount;
+
+  // round block size up to whole cache lines so buffers never share one
+  int floatsPerLine = CACHE_LINE_SIZE / sizeof(float);
+  int stride = (blockSize + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+
+  // count incoming connections per input port and edges per node
+  int *portSources = calloc(n > 0 ? n : 1, sizeof(int));
+  int bufferCount = 0;
+  for (int i = 0; i < n; i++) {
+    portSources[i] = bufferCount;
+    bufferCount += g->nodes[i].inputs;
+  }
+  int *inputConnections =
+      calloc(bufferCount > 0 ? bufferCount : 1, sizeof(int));
+  int *outgoing = calloc(n > 0 ? n : 1, sizeof(int));
+  for (int i = 0; i < g->connectionCount; i++) {
+    struct Connection c = g->connections[i];
+    inputConnections[portSources[c.to] + c.toPort]++;
+    outgoing[c.from]++;
+  }
+
+  // every output port and every input that sums more than one source gets a
+  // buffer
+  int mixCount = 0;
+  for (int i = 0; i < bufferCount; i++) {
+    mixCount += inputConnections[i] > 1;
+  }
+  int outputCount = 0;
+  for (int i = 0; i < n; i++) {
+    outputCount += g->nodes[i].outputs;
+  }
+
+  CompiledGraph c = malloc(sizeof(struct CompiledGraph));
+  c->nodeCount = n;
+  c->blockSize = blockSize;
+  c->frames = blockSize;
+  c->nodes = aligned_alloc(CACHE_LINE_SIZE,
+                           (n > 0 ? n : 1) * sizeof(struct CompiledNode));
+  c->order = malloc((n > 0 ? n : 1) * sizeof(int));
+  c->roots = malloc((n > 0 ? n : 1) * sizeof(int));
+  c->rootCount = 0;
+  c->bufferBytes =
+      (size_t)(outputCount + mixCount + 1) * stride * sizeof(float);
+  c->buffers = rtAlloc(c->bufferBytes);
+  c->delays = NULL;
+  c->delayBytes = 0;
+  float *cursor = c->buffers;
+  c->silence = takeBuffer(&cursor, stride);
+
+  // nodes
+  for (int i = 0; i < n; i++) {
+    struct NodeDescription d = g->nodes[i];
+    struct CompiledNode *node = &c->nodes[i];
+    memset(node, 0, sizeof(*node));
+
+    node->name = d.name;
+    node->process = d.process;
+    node->setParam = d.setParam;
+    node->state = d.state;
+    node->dependents =
+        malloc((outgoing[i] > 0 ? outgoing[i] : 1) * sizeof(int));
+
+    node->outputCount = d.outputs;
+    node->outputs = malloc((d.outputs > 0 ? d.outputs : 1) * sizeof(float *));
+    for (int p = 0; p < d.outputs; p++) {
+      node->outputs[p] = takeBuffer(&cursor, stride);
+    }
+
+    node->inputCount = d.inputs;
+    int ports = d.inputs > 0 ? d.inputs : 1;
+    node->inputs = malloc(ports * sizeof(float *));
+    node->mixes = calloc(ports, sizeof(float *));
+    node->sources = calloc(ports, sizeof(float **));
+    node->sourceCounts = calloc(ports, sizeof(int));
+    for (int p = 0; p < d.inputs; p++) {
+      int connections = inputConnections[portSources[i] + p];
+      node->inputs[p] = c->silence;
+      if (connections > 1) {
+        node->mixes[p] = takeBuffer(&cursor, stride);
+        node->inputs[p] = node->mixes[p];
+        node->sources[p] = malloc(connections * sizeof(float *));
+      }
+    }
+  }
+
+  // wire connections, counting unique upstream nodes as dependencies
+  const float ***slots =
+      malloc((g->connectionCount > 0 ? g->connectionCount : 1) *
+             sizeof(*slots));
+  for (int i = 0; i < g->connectionCount; i++) {
+    struct Connection conn = g->connections[i];
+    struct CompiledNode *from = &c->nodes[conn.from];
+    struct CompiledNode *to = &c->nodes[conn.to];
+    const float *output = from->outputs[conn.fromPort];
+
+    if (to->mixes[conn.toPort]) {
+      slots[i] = &to->sources[conn.toPort][to->sourceCounts[conn.toPort]++];
+    } else {
+      slots[i] = &to->inputs[conn.toPort];
+    }
+    *slots[i] = output;
+
+    int seen = 0;
+    for (int j = 0; j < from->dependentCount; j++) {
+      seen |= from->dependents[j] == conn.to;
+    }
+    if (!seen) {
+      from->dependents[from->dependentCount++] = conn.to;
+      to->dependencies++;
+    }
+  }
+
+  free(portSources);
+  free(inputConnections);
+  free(outgoing);
+
+  // topological order (Kahn's algorithm)
+  int *indegree = malloc((n > 0 ? n : 1) * sizeof(int));
+  int head = 0, tail = 0;
+  for (int i = 0; i < n; i++) {
+    indegree[i] = c->nodes[i].dependencies;
+    if (indegree[i] == 0) {
+      c->roots[c->rootCount++] = i;
+      c->order[tail++] = i;
+    }
+  }
+  while (head < tail) {
+    struct CompiledNode *node = &c->nodes[c->order[head++]];
+    for (int j = 0; j < node->dependentCount; j++) {
+      if (--indegree[node->dependents[j]] == 0) {
+        c->order[tail++] = node->dependents[j];
+      }
+    }
+  }
+  free(indegree);
+
+  if (tail != n) {
+    free(slots);
+    freeCompiledGraph(c);
+    return NULL;
+  }
+  compensate(c, g, slots, stride);
+  free(slots);
+
+  compiledBeginBlock(c, blockSize, 0, 0);
+  return c;
+}
+
+void freeCompiledGraph(CompiledGraph c) {
+  for (int i = 0; i < c->nodeCount; i++) {
+    struct CompiledNode *node = &c->nodes[i];
+    for (int p = 0; p < node->inputCount; p++) {
+      free(node->sources[p]);
+    }
+    free(node->sources);
+    free(node->sourceCounts);
+    free(node->mixes);
+    free(node->inputs);
+    free(node->outputs);
+    free(node->dependents);
+    for (int l = 0; l < node->lineCount; l++) {
+      free(node->lines[l].taps);
+    }
+    free(node->lines);
+  }
+  free(c->nodes);
+  free(c->order);
+  free(c->roots);
+  rtFree(c->buffers, c->bufferBytes);
+  rtFree(c->delays, c->delayBytes);
+  free(c);
+}
+
+int compiledNodeCount(CompiledGraph c) { return c->nodeCount; }
+
+int compiledBlockSize(CompiledGraph c) { return c->blockSize; }
+
+const char *compiledNodeName(CompiledGraph c, int node) {
+  return c->nodes[node].name;
+}
+
+const int *compiledOrder(CompiledGraph c) { return c->order; }
+
+float *compiledOutput(CompiledGraph c, int node, int port) {
+  return c->nodes[node].outputs[port];
+}
+
+int compiledOutputCount(CompiledGraph c, int node) {
+  return c->nodes[node].outputCount;
+}
+
+struct NodeTiming compiledNodeTiming(CompiledGraph c, int node) {
+  return (struct NodeTiming){
+      .start =
+          atomic_load_explicit(&c->nodes[node].started, memory_order_relaxed),
+      .nanos =
+          atomic_load_explicit(&c->nodes[node].nanos, memory_order_relaxed),
+      .worker =
+          atomic_load_explicit(&c->nodes[node].worker, memory_order_relaxed),
+  };
+}
+
+int compiledLatency(CompiledGraph c, int node) {
+  return c->nodes[node].latency;
+}
+
+size_t compiledDelayBytes(CompiledGraph c) { return c->delayBytes; }
+
+void compiledSetParam(CompiledGraph c, int node, uint32_t param,
+                      float value) {
+  if (node < 0 || node >= c->nodeCount || !c->nodes[node].setParam) {
+    return;
+  }
+  c->nodes[node].setParam(c->nodes[node].state, param, value);
+}
+
+void compiledTakeOver(CompiledGraph c, CompiledGraph previous) {
+  atomic_store_explicit(c->running, c->generation, memory_order_relaxed);
+  for (int i = 0; i < c->nodeCount && i < previous->nodeCount; i++) {
+    struct CompiledNode *node = &c->nodes[i];
+    for (int l = 0; l < node->lineCount; l++) {
+      struct DelayLine *line = &node->lines[l];
+      struct DelayLine *old = findLine(&previous->nodes[i], line->port);
+      inherit(line, old);
+      for (int t = 0; t < line->tapCount; t++) {
+        struct DelayTap *tap = &line->taps[t];
+        tap->entering = -tap->delay < line->start;
+        struct DelayTap *was = old ? findTap(old, tap->to, tap->toPort) : NULL;
+        if (!was && !connected(&previous->nodes[i], tap->to)) {
+          continue; // a new connection, it enters instead
+        }
+        tap->from = was ? was->delay : 0;
+        tap->fade = tap->from != tap->delay ? DELAY_FADE : 0;
+      }
+    }
+  }
+}
+
+int compiledRoots(CompiledGraph c, const int **roots) {
+  *roots = c->roots;
+  return c->rootCount;
+}
+
+void compiledBeginBlock(CompiledGraph c, int frames, uint64_t position,
+                        int playing) {
+  if (frames > c->blockSize) {
+    die("Block of %d frames exceeds compiled block size %d\n", frames,
+        c->blockSize);
+  }
+  c->frames = frames;
+  c->position = position;
+  c->playing = playing;
+  for (int i = 0; i < c->nodeCount; i++) {
+    atomic_store_explicit(&c->nodes[i].pending, c->nodes[i].dependencies,
+                          memory_order_relaxed);
+  }
+}
+
+int compiledRunTask(CompiledGraph c, int index, int worker, Arena scratch,
+                    int *ready) {
+  struct CompiledNode *node = &c->nodes[index];
+  uint64_t start = clockNanos();
+
+  // sum inputs with more than one source, every source is finished by now
+  for (int p = 0; p < node->inputCount; p++) {
+    float *mix = node->mixes[p];
+    if (!mix) {
+      continue;
+    }
+    const float **sources = node->sources[p];
+    memcpy(mix, sources[0], c->frames * sizeof(float));
+    for (int s = 1; s < node->sourceCounts[p]; s++) {
+      dsp->add(mix, sources[s], c->frames);
+    }
+  }
+
+  // process
+  struct ProcessContext ctx = {
+      .frames = c->frames,
+      .position = c->position,
+      .playing = c->playing,
+      .inputCount = node->inputCount,
+      .outputCount = node->outputCount,
+      .inputs = node->inputs,
+      .outputs = node->outputs,
+      .scratch = scratch,
+  };
+  arenaReset(scratch);
+  if (node->process) {
+    node->process(node->state, &ctx);
+  }
+  for (int l = 0; l < node->lineCount; l++) {
+    runLine(&node->lines[l], c->frames);
+  }
+
+  atomic_store_explicit(&node->started, start, memory_order_relaxed);
+  atomic_store_explicit(&node->nanos, clockNanos() - start,
+                        memory_order_relaxed);
+  atomic_store_explicit(&node->worker, worker, memory_order_relaxed);
+
+  // release dependents, the last upstream node to finish schedules them
+  int readyCount = 0;
+  for (int j = 0; j < node->dependentCount; j++) {
+    int dependent = node->dependents[j];
+    if (atomic_fetch_sub_explicit(&c->nodes[dependent].pending, 1,
+                                  memory_order_acq_rel) == 1) {
+      ready[readyCount++] = dependent;
+    }
+  }
+  return readyCount;
+}
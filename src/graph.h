@@ -0,0 +1,110 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "arena.h"
+#include <stdint.h>
+
+// everything a node sees for one block. every port is one planar channel of
+// `frames` samples, inputs with several connections arrive already summed.
+struct ProcessContext {
+  int frames;
+  uint64_t position; // transport position of the first frame, in samples
+  int playing;
+  int inputCount;
+  int outputCount;
+  const float *const *inputs;
+  float *const *outputs;
+  // the running worker's, empty at the start of every node. for temporary
+  // buffers that only live through one call, up to SCHEDULER_SCRATCH_BYTES
+  Arena scratch;
+};
+
+typedef void (*ProcessFunc)(void *state, const struct ProcessContext *ctx);
+
+// called on the audio thread between blocks, must be real-time safe
+typedef void (*SetParamFunc)(void *state, uint32_t param, float value);
+
+struct NodeDescription {
+  const char *name;
+  int inputs;
+  int outputs;
+  ProcessFunc process;
+  void *state;
+  SetParamFunc setParam; // optional
+  int latency; // frames its outputs lag its inputs by, for lookahead
+};
+
+struct NodeTiming {
+  uint64_t start; // clockNanos when it last began
+  uint64_t nanos; // duration of the last block
+  int worker;     // which worker ran it
+};
+
+// the most frames a node may lag its inputs by, and a path of them the roots,
+// about 20 s at 48 kHz. the delay lines are sized to it at most
+#define GRAPH_MAX_LATENCY (1 << 20)
+
+// the editable graph, owned by the ui thread
+typedef struct Graph *Graph;
+
+Graph makeGraph(void);
+void freeGraph(Graph g);
+int graphAddNode(Graph g, struct NodeDescription node);
+void graphConnect(Graph g, int from, int fromPort, int to, int toPort);
+void graphDisconnect(Graph g, int from, int fromPort, int to, int toPort);
+int graphNodeCount(Graph g);
+// for a node whose lookahead changed, takes effect from the next compile.
+// dies on a node the graph doesn't have or a latency past the limit, as
+// graphConnect does on a bad connection
+void graphSetLatency(Graph g, int node, int latency);
+
+// an immutable, topologically ordered task list built off the audio thread.
+// node ids are the same as in the graph it was compiled from.
+//
+// latency is compensated: every node's inputs are lined up with the latest
+// path into it by delaying the others, so parallel paths through nodes with
+// lookahead stay in sync where they meet. paths are only ever delayed as far
+// as the longest one they meet, a path that meets none keeps its own
+// latency, so live monitoring through a path without lookahead stays as
+// tight as it was. the delay lines are allocated with the graph. a connection
+// keeps its line as long as the longest delay of any compile that may still
+// be running when this one takes over, so it can always crossfade from that
+// one, and lets go of it once the audio thread has moved past them.
+typedef struct CompiledGraph *CompiledGraph;
+
+// returns NULL if the graph has a cycle, dies if a path lags the roots by
+// more than GRAPH_MAX_LATENCY
+CompiledGraph compileGraph(Graph g, int blockSize);
+void freeCompiledGraph(CompiledGraph c);
+
+int compiledNodeCount(CompiledGraph c);
+int compiledBlockSize(CompiledGraph c);
+const char *compiledNodeName(CompiledGraph c, int node);
+const int *compiledOrder(CompiledGraph c);
+float *compiledOutput(CompiledGraph c, int node, int port);
+int compiledOutputCount(CompiledGraph c, int node);
+struct NodeTiming compiledNodeTiming(CompiledGraph c, int node);
+// frames a node's outputs lag the roots by, its own latency included
+int compiledLatency(CompiledGraph c, int node);
+// what its delay lines and their taps take
+size_t compiledDelayBytes(CompiledGraph c);
+void compiledSetParam(CompiledGraph c, int node, uint32_t param, float value);
+
+// audio thread, real-time safe, when `c` replaces `previous` compiled from
+// the same graph, however many compiles came between them. the delay lines
+// take over what `previous` kept of their outputs, and connections whose
+// delay in `previous` differs crossfade from it to the new over a few
+// milliseconds rather than jump. what wasn't kept before (an output that had
+// no delay line) fades in once the line has it. tells the graph `c` was
+// compiled from that `c` runs, so that graph has to outlive the takeover.
+void compiledTakeOver(CompiledGraph c, CompiledGraph previous);
+
+// used by the scheduler, see scheduler.h. compiledRunTask processes one node
+// and writes the dependents it made ready into `ready`, returning how many.
+int compiledRoots(CompiledGraph c, const int **roots);
+void compiledBeginBlock(CompiledGraph c, int frames, uint64_t position,
+                        int playing);
+int compiledRunTask(CompiledGraph c, int node, int worker, Arena scratch,
+                    int *ready);
+
+#endif
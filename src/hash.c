@@ -0,0 +1,56 @@
+#include "hash.h"
+
+#include <string.h>
+
+// PRIVATE FUNCTIONS
+
+static void hashWord(struct Hasher *s, uint64_t w) {
+  s->h = (s->h ^ w) * 0x9E3779B97F4A7C15ull;
+  s->h ^= s->h >> 32;
+}
+
+// PUBLIC FUNCTIONS
+
+void hashStart(struct Hasher *s) {
+  *s = (struct Hasher){0x243F6A8885A308D3ull, 0, 0, 0};
+}
+
+void hashBytes(struct Hasher *s, const void *data, size_t n) {
+  const uint8_t *p = data;
+  s->total += n;
+  while (n > 0 && s->filled > 0) {
+    s->word |= (uint64_t)*p++ << (8 * s->filled);
+    n--;
+    if (++s->filled == 8) {
+      hashWord(s, s->word);
+      s->word = 0;
+      s->filled = 0;
+    }
+  }
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    hashWord(s, w);
+  }
+  for (; n > 0; n--) {
+    s->word |= (uint64_t)*p++ << (8 * s->filled++);
+  }
+}
+
+uint64_t hashEnd(struct Hasher *s) {
+  if (s->filled > 0) {
+    hashWord(s, s->word);
+  }
+  // splitmix64's finalizer, so nearby inputs land far apart
+  uint64_t h = s->h ^ s->total;
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+  return h ^ (h >> 31);
+}
+
+uint64_t hashOf(const void *data, size_t n) {
+  struct Hasher s;
+  hashStart(&s);
+  hashBytes(&s, data, n);
+  return hashEnd(&s);
+}
@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// a fast 64 bit content hash for telling data apart, not for security. it
+// reads whole words in memory order, so it's the same on every machine of
+// the same byte order, and data hashed in pieces hashes the same as in one.
+struct Hasher {
+  uint64_t h;
+  uint64_t word; // bytes that don't fill a word wait for the next piece
+  int filled;
+  uint64_t total;
+};
+
+void hashStart(struct Hasher *s);
+void hashBytes(struct Hasher *s, const void *data, size_t n);
+uint64_t hashEnd(struct Hasher *s);
+
+// all of it in one piece
+uint64_t hashOf(const void *data, size_t n);
+
+#endif
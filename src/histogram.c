@@ -0,0 +1,41 @@
+#include "histogram.h"
+
+// PUBLIC FUNCTIONS
+
+int histogramBucket(uint32_t nanos) {
+  if (nanos < HISTOGRAM_LINEAR) {
+    return (int)nanos;
+  }
+  int octave = 4;
+  while (nanos >> (octave + 1)) {
+    octave++;
+  }
+  int step = (nanos >> (octave - 3)) & (HISTOGRAM_STEPS - 1);
+  return HISTOGRAM_LINEAR + (octave - 4) * HISTOGRAM_STEPS + step;
+}
+
+uint32_t histogramBucketTop(int bucket) {
+  if (bucket < HISTOGRAM_LINEAR) {
+    return (uint32_t)bucket;
+  }
+  int octave = 4 + (bucket - HISTOGRAM_LINEAR) / HISTOGRAM_STEPS;
+  uint64_t step = (bucket - HISTOGRAM_LINEAR) % HISTOGRAM_STEPS;
+  return (uint32_t)(((HISTOGRAM_STEPS + step + 1) << (octave - 3)) - 1);
+}
+
+uint32_t histogramPercentile(const uint32_t *counts, int windows,
+                             uint64_t total, uint32_t max, double fraction) {
+  uint64_t rank = (uint64_t)(fraction * (double)total + 0.999999);
+  rank = rank > 0 ? rank : 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+    for (int w = 0; w < windows; w++) {
+      seen += counts[w * HISTOGRAM_BUCKETS + b];
+    }
+    if (seen >= rank) {
+      uint32_t top = histogramBucketTop(b);
+      return top < max ? top : max;
+    }
+  }
+  return max;
+}
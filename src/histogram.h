@@ -0,0 +1,24 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// buckets for timings in nanoseconds, shared by the profiler and input
+// latency: one a nanosecond below 16, then eight an octave up to 2^32, so a
+// bucket is never more than an eighth wider than its values
+#define HISTOGRAM_LINEAR 16
+#define HISTOGRAM_STEPS 8
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + (32 - 4) * HISTOGRAM_STEPS)
+
+int histogramBucket(uint32_t nanos);
+
+// the largest value that lands in `bucket`
+uint32_t histogramBucketTop(int bucket);
+
+// the value `fraction` of the way through `total` values counted across
+// `windows` sets of buckets laid end to end in `counts`, as the top of its
+// bucket but never above `max`
+uint32_t histogramPercentile(const uint32_t *counts, int windows,
+                             uint64_t total, uint32_t max, double fraction);
+
+#endif
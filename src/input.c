@@ -0,0 +1,138 @@
+#include "input.h"
+
+#include "clock.h"
+#include "die.h"
+#include "histogram.h"
+#include "spsc.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Input {
+  Spsc ring;
+
+  // window thread
+  _Alignas(CACHE_LINE_SIZE) double cursorX, cursorY;
+  _Atomic uint64_t pushed;
+  _Atomic uint64_t dropped;
+
+  // ui thread
+  _Alignas(CACHE_LINE_SIZE) struct InputEvent *events;
+  int capacity;
+  uint64_t merged;
+  uint32_t counts[HISTOGRAM_BUCKETS];
+  uint64_t frames;
+  uint32_t max;
+};
+
+// PRIVATE FUNCTIONS
+
+// whether `e` only restates `last`. buttons and keys are never merged, nor
+// is anything across them, a drag has to start where the press was
+static int redundant(const struct InputEvent *last,
+                     const struct InputEvent *e) {
+  return last->type == e->type &&
+         (e->type == INPUT_MOUSE_MOVE || e->type == INPUT_SCROLL);
+}
+
+// PUBLIC FUNCTIONS
+
+Input makeInput(int capacity) {
+  Input in = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Input));
+  if (!in) {
+    die("Failed to allocate input\n");
+  }
+  memset(in, 0, sizeof(struct Input));
+  in->ring = makeSpsc(sizeof(struct InputEvent), capacity);
+  in->capacity = (int)spscCapacity(in->ring);
+  in->events = malloc(in->capacity * sizeof(struct InputEvent));
+  atomic_init(&in->pushed, 0);
+  atomic_init(&in->dropped, 0);
+  return in;
+}
+
+void freeInput(Input in) {
+  freeSpsc(in->ring);
+  free(in->events);
+  free(in);
+}
+
+int inputPush(Input in, struct InputEvent e) {
+  e.time = clockNanos();
+  e.first = e.time;
+  e.merged = 1;
+  if (e.type == INPUT_MOUSE_MOVE) {
+    in->cursorX = e.x;
+    in->cursorY = e.y;
+  } else if (e.type == INPUT_MOUSE_BUTTON) {
+    e.x = in->cursorX;
+    e.y = in->cursorY;
+  }
+  atomic_fetch_add_explicit(&in->pushed, 1, memory_order_relaxed);
+  if (!spscPush(in->ring, &e)) {
+    atomic_fetch_add_explicit(&in->dropped, 1, memory_order_relaxed);
+    return 0;
+  }
+  return 1;
+}
+
+uint64_t inputDispatch(Input in, InputHandler handler, void *state) {
+  int count = (int)spscRead(in->ring, in->events, in->capacity);
+
+  // merge in place
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    struct InputEvent *e = &in->events[i];
+    struct InputEvent *last = kept ? &in->events[kept - 1] : NULL;
+    if (last && redundant(last, e)) {
+      if (e->type == INPUT_SCROLL) {
+        e->x += last->x;
+        e->y += last->y;
+      }
+      e->first = last->first;
+      e->merged += last->merged;
+      *last = *e;
+      in->merged++;
+    } else {
+      in->events[kept++] = *e;
+    }
+  }
+
+  uint64_t oldest = 0;
+  for (int i = 0; i < kept; i++) {
+    handler(state, &in->events[i]);
+    if (!oldest || in->events[i].first < oldest) {
+      oldest = in->events[i].first;
+    }
+  }
+  return oldest;
+}
+
+void inputPresented(Input in, uint64_t arrived, uint64_t now) {
+  if (!arrived) {
+    return;
+  }
+  uint64_t wait = now > arrived ? now - arrived : 0;
+  uint32_t nanos = wait < UINT32_MAX ? (uint32_t)wait : UINT32_MAX;
+  in->counts[histogramBucket(nanos)]++;
+  in->frames++;
+  in->max = nanos > in->max ? nanos : in->max;
+}
+
+struct InputLatency inputLatency(Input in) {
+  if (in->frames == 0) {
+    return (struct InputLatency){0};
+  }
+  return (struct InputLatency){
+      .frames = in->frames,
+      .p50 = histogramPercentile(in->counts, 1, in->frames, in->max, 0.5),
+      .p99 = histogramPercentile(in->counts, 1, in->frames, in->max, 0.99),
+      .max = in->max,
+  };
+}
+
+uint64_t inputPushed(Input in) { return atomic_load(&in->pushed); }
+
+uint64_t inputMerged(Input in) { return in->merged; }
+
+uint64_t inputDropped(Input in) { return atomic_load(&in->dropped); }
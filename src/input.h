@@ -0,0 +1,70 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+// input from the window, on its way to the ui. the window thread's callbacks
+// push events, stamped as they arrive, into a lock-free ring. once a frame
+// the ui drains it, merges what's redundant, a run of mouse moves into the
+// last one and a run of scrolls into their sum, and hands the rest on in
+// order. the arrival of the oldest event travels with the frame built from
+// it, and when that frame is known to be done the wait goes into a latency
+// histogram: input to photon, short of the display's own scan-out.
+typedef struct Input *Input;
+
+enum InputType {
+  INPUT_MOUSE_MOVE,
+  INPUT_MOUSE_BUTTON,
+  INPUT_SCROLL,
+  INPUT_KEY,
+  INPUT_CHAR,
+};
+
+// buttons, keys, actions and modifiers are glfw's
+struct InputEvent {
+  enum InputType type;
+  uint64_t time;  // clockNanos when it arrived
+  uint64_t first; // when the oldest event merged into it arrived
+  int merged;     // events it stands for, 1 for itself alone
+  double x, y;    // the cursor in screen coordinates, or the scroll offsets
+  int button;     // mouse button, or key
+  int action;
+  int mods;
+  uint32_t codepoint;
+};
+
+// what the histogram says, in nanoseconds. the percentiles are good to an
+// eighth of an octave, the maximum is exact
+struct InputLatency {
+  uint64_t frames; // that showed input
+  uint32_t p50, p99, max;
+};
+
+typedef void (*InputHandler)(void *state, const struct InputEvent *e);
+
+Input makeInput(int capacity);
+void freeInput(Input in);
+
+// WINDOW THREAD, wait-free
+
+// stamps and queues the event, returns 0 if the ring was full and it was
+// dropped. the cursor's position is filled in on button events
+int inputPush(Input in, struct InputEvent e);
+
+// UI THREAD
+
+// once a frame, before it's built. returns when the oldest event handed on
+// arrived, 0 if there were none
+uint64_t inputDispatch(Input in, InputHandler handler, void *state);
+
+// the frame carrying `arrived` from inputDispatch is done at `now`
+void inputPresented(Input in, uint64_t arrived, uint64_t now);
+
+struct InputLatency inputLatency(Input in);
+
+// events pushed, and those merged away or dropped on a full ring
+uint64_t inputPushed(Input in);
+uint64_t inputMerged(Input in);
+uint64_t inputDropped(Input in);
+
+#endif
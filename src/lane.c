@@ -0,0 +1,118 @@
+#include "lane.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// versions the audio thread let go of but the ui hasn't freed yet
+#define GARBAGE_CAPACITY 16
+
+struct Lane {
+  const struct LaneItems *items;
+  int display;
+
+  // ui -> audio and ui -> render thread, the newest version not picked up yet
+  _Atomic(void *) forAudio;
+  _Atomic(void *) forDisplay;
+
+  // audio thread
+  void *current;
+  Deferred garbage;
+
+  // render thread
+  void *shown;
+};
+
+// PRIVATE FUNCTIONS
+
+static void retain(Lane l, void *item) {
+  if (item && l->items->retain) {
+    l->items->retain(item);
+  }
+}
+
+// any thread but the audio one, which only drops
+static void release(Lane l, void *item) {
+  if (item && (!l->items->drop || l->items->drop(item))) {
+    l->items->destroy(item);
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Lane makeLane(const struct LaneItems *items, void *initial, int display) {
+  Lane l = calloc(1, sizeof(struct Lane));
+  l->items = items;
+  l->display = display;
+  atomic_init(&l->forAudio, NULL);
+  atomic_init(&l->forDisplay, NULL);
+  l->garbage = makeDeferred(GARBAGE_CAPACITY);
+  retain(l, initial);
+  l->current = initial;
+  if (display) {
+    retain(l, initial);
+    l->shown = initial;
+  }
+  return l;
+}
+
+void freeLane(Lane l) {
+  collectDeferred(l->garbage);
+  release(l, atomic_exchange(&l->forAudio, NULL));
+  release(l, atomic_exchange(&l->forDisplay, NULL));
+  release(l, l->current);
+  release(l, l->shown);
+  freeDeferred(l->garbage);
+  free(l);
+}
+
+void laneSet(Lane l, void *item) {
+  // whatever the audio thread retired makes room for the next it will
+  collectDeferred(l->garbage);
+
+  // a version nobody picked up is simply replaced
+  if (l->display) {
+    retain(l, item);
+    release(l, atomic_exchange_explicit(&l->forDisplay, item,
+                                        memory_order_acq_rel));
+  }
+  retain(l, item);
+  release(l,
+          atomic_exchange_explicit(&l->forAudio, item, memory_order_acq_rel));
+}
+
+void laneCollect(Lane l) { collectDeferred(l->garbage); }
+
+void *laneDisplay(Lane l) {
+  void *next =
+      atomic_exchange_explicit(&l->forDisplay, NULL, memory_order_acq_rel);
+  if (next) {
+    release(l, l->shown);
+    l->shown = next;
+  }
+  return l->shown;
+}
+
+int lanePickUp(Lane l, void **replaced) {
+  // only the audio thread queues, so the room it sees stays there
+  if (!deferredRoom(l->garbage) ||
+      !atomic_load_explicit(&l->forAudio, memory_order_relaxed)) {
+    return 0;
+  }
+  void *next =
+      atomic_exchange_explicit(&l->forAudio, NULL, memory_order_acq_rel);
+  if (!next) {
+    return 0;
+  }
+  *replaced = l->current;
+  l->current = next;
+  return 1;
+}
+
+void *laneCurrent(Lane l) { return l->current; }
+
+void laneRetire(Lane l, void *item) {
+  if (item && (!l->items->drop || l->items->drop(item))) {
+    // can't fail, lanePickUp saw room for it
+    deferRelease(l->garbage, item, l->items->destroy);
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef LANE_H
+#define LANE_H
+
+#include "deferred.h"
+
+// how a lane shares its versions. retain and drop are NULL for versions the
+// lane owns outright, otherwise drop lets go of one reference without freeing
+// anything and returns 1 if it was the last. destroy frees a version nobody
+// holds any more
+struct LaneItems {
+  void (*retain)(void *item);
+  int (*drop)(void *item);
+  ReleaseFunc destroy;
+};
+
+// hands the newest version of something immutable from the ui to the audio
+// thread, and to the render thread if asked to. a version set before the last
+// one was picked up is simply replaced, one the audio thread lets go of goes
+// back to the ui to be freed. the audio side never blocks, allocates or frees
+typedef struct Lane *Lane;
+
+// display is 1 if the render thread reads the lane too, which needs counted
+// versions. the lane retains what it's given, or takes it over if versions
+// aren't counted. items has to outlive the lane
+Lane makeLane(const struct LaneItems *items, void *initial, int display);
+void freeLane(Lane l);
+
+// ui thread. frees what the audio thread let go of, then publishes item
+void laneSet(Lane l, void *item);
+void laneCollect(Lane l);
+
+// render thread. the newest version set
+void *laneDisplay(Lane l);
+
+// audio thread. picks up the newest version set, if there is one, and returns
+// 1 if it did. the version it replaced is left in `replaced` for the caller to
+// finish with and hand to laneRetire. nothing is picked up while there's no
+// room to retire, so a ui that stops collecting keeps the audio thread on the
+// version it has instead of losing one
+int lanePickUp(Lane l, void **replaced);
+void *laneCurrent(Lane l);
+void laneRetire(Lane l, void *item);
+
+#endif
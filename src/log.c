@@ -0,0 +1,580 @@
+#define _POSIX_C_SOURCE 200809L
+#include "log.h"
+
+#include "clock.h"
+#include "die.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how long the background thread sleeps between passes
+#define FLUSH_NANOS 10000000
+
+// records formatted in one go, sorted by time across the rings
+#define BATCH 4096
+
+// the longest line written, longer ones are cut short
+#define LINE 1024
+
+// a conversion's flags, width and precision
+#define SPEC 32
+
+union LogArg {
+  int64_t i;
+  uint64_t u;
+  double f;
+  const void *p;
+  uint32_t text; // offset of a copied string
+};
+
+// two cache lines
+struct LogRecord {
+  uint64_t time; // clockNanos when it was written
+  const char *format;
+  uint8_t level;
+  uint8_t count; // arguments
+  union LogArg args[LOG_ARGS];
+  char text[LOG_TEXT];
+};
+
+struct Writer {
+  Spsc ring;
+  char name[16];
+  atomic_int left; // the thread is gone, free once empty
+  _Atomic uint64_t dropped;
+  uint64_t reported; // drops already in the log
+  struct Writer *next;
+};
+
+// what a conversion takes, from its length modifier and letter
+enum Size {
+  SIZE_NONE,
+  SIZE_CHAR,
+  SIZE_SHORT,
+  SIZE_LONG,
+  SIZE_LONG_LONG,
+  SIZE_SIZE,
+  SIZE_INTMAX,
+  SIZE_PTRDIFF,
+  SIZE_LONG_DOUBLE,
+};
+
+struct Spec {
+  const char *flags; // just past the '%'
+  int length;        // of the flags, width and precision
+  enum Size size;
+  char conversion; // 0 for one we can't take
+};
+
+static const char *levelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static _Thread_local struct Writer *writer = NULL;
+
+// the writer list, and taking records out of any ring
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static struct Writer *writers = NULL;
+static FILE *file = NULL; // stderr when NULL
+static pthread_t thread;
+static int stopping = 0;
+
+// threads that haven't entered push to `shared` one at a time, while running
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+static struct Writer *shared = NULL;
+static atomic_int running = 0;
+
+static _Atomic uint64_t origin = 0;
+static _Atomic uint64_t dropped = 0;
+static _Atomic uint64_t written = 0;
+
+static struct LogRecord batch[BATCH];
+static const char *batchNames[BATCH];
+static struct LogRecord *order[BATCH];
+
+// PRIVATE FUNCTIONS
+
+// lines count from the first time anything here was set up
+static uint64_t since(uint64_t time) {
+  uint64_t zero = 0;
+  atomic_compare_exchange_strong(&origin, &zero, time);
+  return time - atomic_load_explicit(&origin, memory_order_relaxed);
+}
+
+// the conversion after a '%', returns where it ends
+static const char *parse(const char *f, struct Spec *s) {
+  s->flags = f;
+  while (*f && strchr("-+ #0", *f)) {
+    f++;
+  }
+  while (*f >= '0' && *f <= '9') {
+    f++;
+  }
+  if (*f == '.') {
+    f++;
+    while (*f >= '0' && *f <= '9') {
+      f++;
+    }
+  }
+  s->length = (int)(f - s->flags);
+
+  s->size = SIZE_NONE;
+  switch (*f) {
+  case 'h':
+    s->size = f[1] == 'h' ? SIZE_CHAR : SIZE_SHORT;
+    f += f[1] == 'h' ? 2 : 1;
+    break;
+  case 'l':
+    s->size = f[1] == 'l' ? SIZE_LONG_LONG : SIZE_LONG;
+    f += f[1] == 'l' ? 2 : 1;
+    break;
+  case 'z':
+    s->size = SIZE_SIZE;
+    f++;
+    break;
+  case 'j':
+    s->size = SIZE_INTMAX;
+    f++;
+    break;
+  case 't':
+    s->size = SIZE_PTRDIFF;
+    f++;
+    break;
+  case 'L':
+    s->size = SIZE_LONG_DOUBLE;
+    f++;
+    break;
+  }
+
+  s->conversion = *f && strchr("diouxXcfFeEgGaAsp", *f) ? *f : 0;
+  if (s->length >= SPEC - 4) {
+    s->conversion = 0;
+  }
+  return *f ? f + 1 : f;
+}
+
+static int64_t signedArg(enum Size size, va_list *args) {
+  switch (size) {
+  case SIZE_CHAR:
+    return (signed char)va_arg(*args, int);
+  case SIZE_SHORT:
+    return (short)va_arg(*args, int);
+  case SIZE_LONG:
+    return va_arg(*args, long);
+  case SIZE_LONG_LONG:
+    return va_arg(*args, long long);
+  case SIZE_SIZE:
+    return (int64_t)va_arg(*args, size_t);
+  case SIZE_INTMAX:
+    return va_arg(*args, intmax_t);
+  case SIZE_PTRDIFF:
+    return va_arg(*args, ptrdiff_t);
+  default:
+    return va_arg(*args, int);
+  }
+}
+
+static uint64_t unsignedArg(enum Size size, va_list *args) {
+  switch (size) {
+  case SIZE_CHAR:
+    return (unsigned char)va_arg(*args, unsigned);
+  case SIZE_SHORT:
+    return (unsigned short)va_arg(*args, unsigned);
+  case SIZE_LONG:
+    return va_arg(*args, unsigned long);
+  case SIZE_LONG_LONG:
+    return va_arg(*args, unsigned long long);
+  case SIZE_SIZE:
+    return va_arg(*args, size_t);
+  case SIZE_INTMAX:
+    return va_arg(*args, uintmax_t);
+  case SIZE_PTRDIFF:
+    return (uint64_t)va_arg(*args, ptrdiff_t);
+  default:
+    return va_arg(*args, unsigned);
+  }
+}
+
+// copies the arguments by what the format says they are. stops at the first
+// conversion it can't take, the rest of the format is written as it is
+static void capture(struct LogRecord *r, int level, const char *format,
+                    va_list *args) {
+  r->time = clockNanos();
+  r->format = format;
+  r->level = (uint8_t)level;
+  r->count = 0;
+  r->text[LOG_TEXT - 1] = '\0';
+  int used = 0;
+
+  for (const char *f = format; *f && r->count < LOG_ARGS;) {
+    if (*f++ != '%') {
+      continue;
+    }
+    if (*f == '%') {
+      f++;
+      continue;
+    }
+    struct Spec s;
+    f = parse(f, &s);
+    union LogArg *a = &r->args[r->count];
+    switch (s.conversion) {
+    case 'd':
+    case 'i':
+    case 'c':
+      a->i = s.conversion == 'c' ? va_arg(*args, int)
+                                 : signedArg(s.size, args);
+      break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      a->u = unsignedArg(s.size, args);
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      a->f = s.size == SIZE_LONG_DOUBLE ? (double)va_arg(*args, long double)
+                                        : va_arg(*args, double);
+      break;
+    case 'p':
+      a->p = va_arg(*args, void *);
+      break;
+    case 's': {
+      const char *text = va_arg(*args, const char *);
+      if (!text) {
+        text = "(null)";
+      }
+      if (used >= LOG_TEXT - 1) {
+        a->text = LOG_TEXT - 1;
+        break;
+      }
+      int room = LOG_TEXT - 1 - used;
+      int n = 0;
+      while (n < room && text[n]) {
+        r->text[used + n] = text[n];
+        n++;
+      }
+      r->text[used + n] = '\0';
+      a->text = (uint32_t)used;
+      used += n + 1;
+      break;
+    }
+    default:
+      return;
+    }
+    r->count++;
+  }
+}
+
+// the record's message, returns its length
+static int format(const struct LogRecord *r, char *line, int size) {
+  int n = 0, arg = 0;
+  const char *f = r->format;
+  while (*f && n < size - 1) {
+    if (*f != '%' || f[1] == '%') {
+      line[n++] = *f;
+      f += *f == '%' ? 2 : 1;
+      continue;
+    }
+    struct Spec s;
+    const char *end = parse(f + 1, &s);
+    if (arg == r->count) {
+      // the rest wasn't captured
+      int rest = (int)strlen(f);
+      rest = rest < size - 1 - n ? rest : size - 1 - n;
+      memcpy(line + n, f, rest);
+      n += rest;
+      break;
+    }
+
+    char spec[SPEC] = "%";
+    memcpy(spec + 1, s.flags, s.length);
+    int k = 1 + s.length;
+    const union LogArg *a = &r->args[arg++];
+    int wrote = 0;
+    switch (s.conversion) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      spec[k++] = 'l';
+      spec[k++] = 'l';
+      spec[k++] = s.conversion;
+      spec[k] = '\0';
+      wrote = s.conversion == 'd' || s.conversion == 'i'
+                  ? snprintf(line + n, size - n, spec, (long long)a->i)
+                  : snprintf(line + n, size - n, spec,
+                             (unsigned long long)a->u);
+      break;
+    case 'c':
+      spec[k++] = 'c';
+      spec[k] = '\0';
+      wrote = snprintf(line + n, size - n, spec, (int)a->i);
+      break;
+    case 's':
+      spec[k++] = 's';
+      spec[k] = '\0';
+      wrote = snprintf(line + n, size - n, spec, r->text + a->text);
+      break;
+    case 'p':
+      spec[k++] = 'p';
+      spec[k] = '\0';
+      wrote = snprintf(line + n, size - n, spec, a->p);
+      break;
+    default:
+      spec[k++] = s.conversion;
+      spec[k] = '\0';
+      wrote = snprintf(line + n, size - n, spec, a->f);
+      break;
+    }
+    n += wrote < 0 ? 0 : wrote;
+    n = n < size - 1 ? n : size - 1;
+    f = end;
+  }
+  while (n > 0 && line[n - 1] == '\n') {
+    n--;
+  }
+  line[n] = '\0';
+  return n;
+}
+
+static void writeLine(FILE *out, uint64_t time, int level, const char *name,
+                      const char *message) {
+  uint64_t t = since(time);
+  fprintf(out, "%llu.%06llu %-5s %s: %s\n",
+          (unsigned long long)(t / 1000000000),
+          (unsigned long long)(t % 1000000000 / 1000), levelNames[level], name,
+          message);
+  atomic_fetch_add_explicit(&written, 1, memory_order_relaxed);
+}
+
+static void writeRecord(FILE *out, const struct LogRecord *r,
+                        const char *name) {
+  char message[LINE];
+  format(r, message, LINE);
+  writeLine(out, r->time, r->level, name, message);
+}
+
+static int compareRecords(const void *x, const void *y) {
+  const struct LogRecord *a = *(struct LogRecord *const *)x;
+  const struct LogRecord *b = *(struct LogRecord *const *)y;
+  if (a->time != b->time) {
+    return a->time < b->time ? -1 : 1;
+  }
+  // a ring's records keep their order
+  return a < b ? -1 : a > b;
+}
+
+static struct Writer *makeWriter(const char *name) {
+  struct Writer *w = malloc(sizeof(struct Writer));
+  if (!w) {
+    die("Failed to allocate log writer\n");
+  }
+  w->ring = makeSpsc(sizeof(struct LogRecord), LOG_CAPACITY);
+  snprintf(w->name, sizeof(w->name), "%s", name);
+  atomic_init(&w->left, 0);
+  atomic_init(&w->dropped, 0);
+  w->reported = 0;
+  w->next = NULL;
+  return w;
+}
+
+static void freeWriter(struct Writer *w) {
+  freeSpsc(w->ring);
+  free(w);
+}
+
+// empties every ring into the log, holding the lock
+static void drain(void) {
+  FILE *out = file ? file : stderr;
+  int full;
+  do {
+    int n = 0;
+    full = 0;
+    for (struct Writer *w = writers; w; w = w->next) {
+      // drops are noted when they're found, ahead of what's left
+      uint64_t lost = atomic_load_explicit(&w->dropped, memory_order_relaxed);
+      if (lost != w->reported) {
+        char message[64];
+        snprintf(message, sizeof(message), "%llu records dropped",
+                 (unsigned long long)(lost - w->reported));
+        writeLine(out, clockNanos(), LOG_WARN, w->name, message);
+        w->reported = lost;
+      }
+      size_t read = spscRead(w->ring, batch + n, BATCH - n);
+      for (size_t i = 0; i < read; i++) {
+        batchNames[n + i] = w->name;
+      }
+      n += (int)read;
+      full |= n == BATCH;
+    }
+
+    for (int i = 0; i < n; i++) {
+      order[i] = &batch[i];
+    }
+    qsort(order, n, sizeof(struct LogRecord *), compareRecords);
+    for (int i = 0; i < n; i++) {
+      writeRecord(out, order[i], batchNames[order[i] - batch]);
+    }
+  } while (full);
+  fflush(out);
+
+  // rings of threads that have left, and are empty now
+  for (struct Writer **w = &writers; *w;) {
+    struct Writer *next = (*w)->next;
+    if (atomic_load_explicit(&(*w)->left, memory_order_acquire) &&
+        spscReadable((*w)->ring) == 0) {
+      freeWriter(*w);
+      *w = next;
+    } else {
+      w = &(*w)->next;
+    }
+  }
+}
+
+static void *flushMain(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&lock);
+  while (!stopping) {
+    drain();
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += FLUSH_NANOS;
+    until.tv_sec += until.tv_nsec / 1000000000;
+    until.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&wake, &lock, &until);
+  }
+  drain();
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// PUBLIC FUNCTIONS
+
+int logStart(const char *path) {
+  since(clockNanos());
+  pthread_mutex_lock(&lock);
+  if (atomic_load(&running)) {
+    pthread_mutex_unlock(&lock);
+    return 1;
+  }
+  if (path) {
+    file = fopen(path, "a");
+    if (!file) {
+      pthread_mutex_unlock(&lock);
+      return 0;
+    }
+  }
+
+  struct Writer *w = makeWriter("-");
+  w->next = writers;
+  writers = w;
+  stopping = 0;
+  if (pthread_create(&thread, NULL, flushMain, NULL) != 0) {
+    die("Failed to start log thread\n");
+  }
+  pthread_mutex_lock(&sharedLock);
+  shared = w;
+  atomic_store(&running, 1);
+  pthread_mutex_unlock(&sharedLock);
+  pthread_mutex_unlock(&lock);
+  return 1;
+}
+
+void logStop(void) {
+  pthread_mutex_lock(&sharedLock);
+  if (!atomic_load(&running)) {
+    pthread_mutex_unlock(&sharedLock);
+    return;
+  }
+  // from here on, threads that haven't entered write to stderr themselves
+  atomic_store(&running, 0);
+  atomic_store(&shared->left, 1);
+  shared = NULL;
+  pthread_mutex_unlock(&sharedLock);
+
+  pthread_mutex_lock(&lock);
+  stopping = 1;
+  pthread_cond_signal(&wake);
+  pthread_mutex_unlock(&lock);
+  pthread_join(thread, NULL);
+
+  if (file) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+void logFlush(void) {
+  pthread_mutex_lock(&lock);
+  drain();
+  pthread_mutex_unlock(&lock);
+}
+
+void logThreadEnter(const char *name) {
+  if (writer) {
+    return;
+  }
+  since(clockNanos());
+  struct Writer *w = makeWriter(name);
+  pthread_mutex_lock(&lock);
+  w->next = writers;
+  writers = w;
+  pthread_mutex_unlock(&lock);
+  writer = w;
+}
+
+void logThreadLeave(void) {
+  if (!writer) {
+    return;
+  }
+  atomic_store_explicit(&writer->left, 1, memory_order_release);
+  writer = NULL;
+  // nobody else is going to empty it
+  if (!atomic_load(&running)) {
+    logFlush();
+  }
+}
+
+void logWrite(int level, const char *format, ...) {
+  struct LogRecord r;
+  va_list args;
+  va_start(args, format);
+  capture(&r, level, format, &args);
+  va_end(args);
+
+  struct Writer *w = writer;
+  if (w) {
+    if (!spscPush(w->ring, &r)) {
+      atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&sharedLock);
+  if (shared) {
+    if (!spscPush(shared->ring, &r)) {
+      atomic_fetch_add_explicit(&shared->dropped, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+    }
+  } else {
+    writeRecord(stderr, &r, "-");
+  }
+  pthread_mutex_unlock(&sharedLock);
+}
+
+uint64_t logDropped(void) { return atomic_load(&dropped); }
+
+uint64_t logWritten(void) { return atomic_load(&written); }
@@ -0,0 +1,106 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+// logging that's safe on the audio and render threads. a record is a fixed
+// size copy of the level, the time, the format string and its arguments, so
+// writing one is a short scan of the format and a push into the calling
+// thread's own lock-free ring, never a lock, a system call or an allocation.
+// a background thread takes records from every ring, formats them in the
+// order they were written and appends them to the log file. when a ring is
+// full the record is dropped and counted, and the count shows up in the log,
+// so a hot loop that logs every sample slows nothing down.
+//
+// the format must be a string literal, it's kept by pointer and read when the
+// record is written out. %s arguments are copied, LOG_TEXT bytes between all
+// of them, longer strings are cut short. a line ends on its own, a trailing
+// newline in the format is dropped. everything printf knows works apart from
+// * widths and precisions and %n, and at most LOG_ARGS arguments are kept.
+
+#define LOG_DEBUG 0
+#define LOG_INFO 1
+#define LOG_WARN 2
+#define LOG_ERROR 3
+
+// levels below LOG_LEVEL compile to nothing, arguments and all. debug builds
+// keep everything, release builds start at info
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_INFO
+#else
+#define LOG_LEVEL LOG_DEBUG
+#endif
+#endif
+
+#define LOG_ARGS 6
+#define LOG_TEXT 56
+
+// records a thread can have waiting before it drops them
+#define LOG_CAPACITY 1024
+
+// `if (0)` so the compiler still checks a filtered call's format
+#define LOG_FILTERED(level, ...)                                               \
+  do {                                                                         \
+    if (0) {                                                                   \
+      logWrite(level, __VA_ARGS__);                                            \
+    }                                                                          \
+  } while (0)
+
+#if LOG_LEVEL <= LOG_DEBUG
+#define logDebug(...) logWrite(LOG_DEBUG, __VA_ARGS__)
+#else
+#define logDebug(...) LOG_FILTERED(LOG_DEBUG, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_INFO
+#define logInfo(...) logWrite(LOG_INFO, __VA_ARGS__)
+#else
+#define logInfo(...) LOG_FILTERED(LOG_INFO, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_WARN
+#define logWarn(...) logWrite(LOG_WARN, __VA_ARGS__)
+#else
+#define logWarn(...) LOG_FILTERED(LOG_WARN, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_ERROR
+#define logError(...) logWrite(LOG_ERROR, __VA_ARGS__)
+#else
+#define logError(...) LOG_FILTERED(LOG_ERROR, __VA_ARGS__)
+#endif
+
+// starts the thread writing records to `path`, appending, or to stderr if
+// it's NULL. returns 0 if the file can't be opened. until then, and after
+// logStop, records from threads that haven't entered go straight to stderr
+int logStart(const char *path);
+
+// writes out everything left and stops the thread
+void logStop(void);
+
+// blocks until every record written before the call is out. not real-time
+// safe, for before an exit
+void logFlush(void);
+
+// gives the calling thread a ring of its own, `name` goes on its lines. not
+// real-time safe, call it when the thread starts, before rtThreadEnter.
+// threads that haven't entered share a ring behind a lock. the render thread,
+// the device thread driving the engine ("audio") and every scheduler worker
+// ("worker n") enter
+void logThreadEnter(const char *name);
+
+// the ring is freed once the background thread has emptied it
+void logThreadLeave(void);
+
+// use the macros above. real-time safe on a thread that has entered
+__attribute__((format(printf, 2, 3))) void logWrite(int level,
+                                                    const char *format, ...);
+
+// records dropped on full rings since the start
+uint64_t logDropped(void);
+
+// records written out since the start
+uint64_t logWritten(void);
+
+#endif
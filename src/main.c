@@ -1,42 +1,165 @@
+#define _POSIX_C_SOURCE 200809L
+#include "automationlayer.h"
+#include "die.h"
+#include "drawlist.h"
+#include "dsp.h"
+#include "engine.h"
+#include "log.h"
+#include "meterlayer.h"
+#include "pianorolllayer.h"
+#include "profilerlayer.h"
 #include "renderer.h"
+#include "rtmem.h"
+#include "spectrumlayer.h"
+#include "synth.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
-struct VertexBuilder {
-  struct Vertex *vertices;
-  int vertexCount;
+#define WIDTH 1280
+#define HEIGHT 720
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define CHANNELS 2
+#define WORKERS 2
+#define MAX_NODES 64
+#define COLLECT_NANOS 16000000L
+#define FFT_SIZE 4096
+#define OVERLAP 4
+#define VIEW_SECONDS 8
+#define SONG_SECONDS 64
+#define VOICES 32
+#define LOW_PITCH 36
+#define HIGH_PITCH 96
+#define HISTORY 512
+
+// stands in for the audio device until there is one: the engine renders a
+// block every block's worth of time and the output goes nowhere. a second
+// thread frees what the engine and the lanes let go of, pages the view along
+// with the playhead and starts the song over at its end
+struct Device {
+  Engine engine;
+  AutomationLane automation;
+  NoteLane notes;
+  struct TimelineView *view;
+  atomic_int running;
+  pthread_t audio;
+  pthread_t housekeeping;
 };
 
-static void pushVertex(struct VertexBuilder *b, struct Vertex v) {
-  b->vertices =
-      realloc(b->vertices, (b->vertexCount + 1) * sizeof(struct Vertex));
-  b->vertices[b->vertexCount++] = v;
+static void after(struct timespec *t, long nanos) {
+  t->tv_nsec += nanos;
+  while (t->tv_nsec >= 1000000000L) {
+    t->tv_nsec -= 1000000000L;
+    t->tv_sec++;
+  }
+}
+
+// a breakpoint every second, rising and falling along every shape in turn
+static Automation makeCurve(void) {
+  struct Breakpoint points[SONG_SECONDS + 1];
+  for (int i = 0; i <= SONG_SECONDS; i++) {
+    points[i] = (struct Breakpoint){
+        .position = (uint64_t)i * SAMPLE_RATE,
+        .value = i % 2 ? 0.9f : 0.1f,
+        .shape = (uint32_t)(i % (AUTOMATION_BEZIER + 1)),
+        .control = {0.8f, 0.2f},
+    };
+  }
+  return makeAutomation(points, SONG_SECONDS + 1);
 }
 
-static void rectangle(struct VertexBuilder *b, int x, int y, int width,
-                      int height) {
-  struct Vertex topLeft = {{x, y}};
-  struct Vertex topRight = {{x + width, y}};
-  struct Vertex bottomRight = {{x + width, y + height}};
-  struct Vertex bottomLeft = {{x, y + height}};
+// a chord every two seconds under an arpeggio of it in eighths at 120 bpm
+static NoteTrack makeSong(void) {
+  static const int roots[] = {48, 45, 41, 43};
+  static const int chord[] = {0, 4, 7, 12};
+  int bars = SONG_SECONDS / 2, count = 0;
+  uint32_t eighth = SAMPLE_RATE / 4;
+  struct Note *notes = malloc(bars * 20 * sizeof(struct Note));
+  if (!notes) {
+    die("Failed to allocate song\n");
+  }
+  for (int b = 0; b < bars; b++) {
+    uint64_t bar = (uint64_t)b * 2 * SAMPLE_RATE;
+    int root = roots[b % 4];
+    for (int i = 0; i < 4; i++) {
+      notes[count++] = (struct Note){bar, 8 * eighth, root + chord[i], 60};
+    }
+    for (int i = 0; i < 16; i++) {
+      int up = i % 8 < 4 ? i % 4 : 3 - i % 4;
+      notes[count++] = (struct Note){bar + i * eighth, eighth,
+                                     root + 12 + chord[up], 100};
+    }
+  }
+  NoteTrack t = makeNoteTrack(notes, count);
+  free(notes);
+  return t;
+}
 
-  pushVertex(b, topLeft);
-  pushVertex(b, topRight);
-  pushVertex(b, bottomRight);
-  pushVertex(b, bottomRight);
-  pushVertex(b, bottomLeft);
-  pushVertex(b, topLeft);
+static void *audioThread(void *arg) {
+  struct Device *d = arg;
+  float buffers[CHANNELS][BLOCK];
+  float *out[CHANNELS];
+  for (int c = 0; c < CHANNELS; c++) {
+    out[c] = buffers[c];
+  }
+  logThreadEnter("audio");
+  rtThreadEnter();
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (atomic_load(&d->running)) {
+    engineProcess(d->engine, out, CHANNELS, BLOCK);
+    after(&next, 1000000000L / SAMPLE_RATE * BLOCK);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  rtThreadLeave();
+  logThreadLeave();
+  return NULL;
 }
 
-static void triangle(struct VertexBuilder *b, int x, int y, int width,
-                     int height) {
-  struct Vertex top = {{x, y}};
-  struct Vertex left = {{x, y + height}};
-  struct Vertex right = {{x + width, y + height}};
+static void *housekeepingThread(void *arg) {
+  struct Device *d = arg;
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (atomic_load(&d->running)) {
+    engineCollect(d->engine);
+    automationLaneCollect(d->automation);
+    noteLaneCollect(d->notes);
 
-  pushVertex(b, top);
-  pushVertex(b, right);
-  pushVertex(b, left);
+    uint64_t position = enginePosition(d->engine);
+    uint64_t span = (uint64_t)VIEW_SECONDS * SAMPLE_RATE;
+    if (position >= (uint64_t)SONG_SECONDS * SAMPLE_RATE) {
+      sendCommand(engineQueues(d->engine),
+                  (struct Command){
+                      .type = COMMAND_TRANSPORT,
+                      .transport = {.action = TRANSPORT_SEEK, .position = 0},
+                  });
+      position = 0;
+    }
+    // the end first, a frame that sees only one of them shows too much
+    // rather than nothing
+    atomic_store(&d->view->end, position / span * span + span);
+    atomic_store(&d->view->start, position / span * span);
+    after(&next, COLLECT_NANOS);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  return NULL;
+}
+
+static void startDevice(struct Device *d) {
+  atomic_init(&d->running, 1);
+  if (pthread_create(&d->audio, NULL, audioThread, d) != 0 ||
+      pthread_create(&d->housekeeping, NULL, housekeepingThread, d) != 0) {
+    die("Failed to start the audio threads\n");
+  }
+}
+
+static void stopDevice(struct Device *d) {
+  atomic_store(&d->running, 0);
+  pthread_join(d->audio, NULL);
+  pthread_join(d->housekeeping, NULL);
 }
 
 int main(void) {
@@ -44,12 +167,132 @@ int main(void) {
   fprintf(stderr, "Press enter to continue\n");
   getchar();
 
+  // log to $DAW_LOG if it's set, stderr otherwise
+  const char *logPath = getenv("DAW_LOG");
+  if (!logStart(logPath)) {
+    fprintf(stderr, "Failed to open log %s, logging to stderr\n", logPath);
+    logStart(NULL);
+  }
+
+  // pick the fastest dsp kernels for this cpu
+  dspInit();
+
+  // audio: a synth playing a song through the analyzer and a meter tap to
+  // the device, and an automated parameter metered on a channel of its own.
+  // every block is profiled
+  Engine engine = makeEngine(SAMPLE_RATE, BLOCK, WORKERS, MAX_NODES);
+  Meters meters = makeMeters(CHANNELS + 1, SAMPLE_RATE);
+  Spectrum spectrum = makeSpectrum(CHANNELS, SAMPLE_RATE, FFT_SIZE, OVERLAP);
+  struct SpectrumTap analyzer = {spectrum, 0};
+  struct MeterTap tap = {meters, 0};
+  struct MeterTap parameterTap = {meters, CHANNELS};
+  Automation curve = makeCurve();
+  AutomationLane automation = makeAutomationLane(curve);
+  automationRelease(curve);
+  NoteTrack song = makeSong();
+  NoteLane notes = makeNoteLane(song);
+  noteTrackRelease(song);
+  Synth synth = makeSynth(SAMPLE_RATE, VOICES, notes);
+  Profiler profiler = makeProfiler(MAX_NODES, HISTORY);
+  Graph g = makeGraph();
+  int source = graphAddNode(g, (struct NodeDescription){
+                                   .name = "synth",
+                                   .outputs = CHANNELS,
+                                   .process = synthNodeProcess,
+                                   .state = synth,
+                                   .setParam = synthNodeSetParam,
+                               });
+  int analysis = graphAddNode(g, (struct NodeDescription){
+                                     .name = "spectrum",
+                                     .inputs = CHANNELS,
+                                     .outputs = CHANNELS,
+                                     .process = spectrumTapProcess,
+                                     .state = &analyzer,
+                                 });
+  int output = graphAddNode(g, (struct NodeDescription){
+                                   .name = "meters",
+                                   .inputs = CHANNELS,
+                                   .outputs = CHANNELS,
+                                   .process = meterTapProcess,
+                                   .state = &tap,
+                               });
+  for (int c = 0; c < CHANNELS; c++) {
+    graphConnect(g, source, c, analysis, c);
+    graphConnect(g, analysis, c, output, c);
+  }
+  int parameter = graphAddNode(g, (struct NodeDescription){
+                                      .name = "automation",
+                                      .outputs = 1,
+                                      .process = automationLaneProcess,
+                                      .state = automation,
+                                  });
+  int parameterMeter = graphAddNode(g, (struct NodeDescription){
+                                           .name = "automation meter",
+                                           .inputs = 1,
+                                           .outputs = 1,
+                                           .process = meterTapProcess,
+                                           .state = &parameterTap,
+                                       });
+  graphConnect(g, parameter, 0, parameterMeter, 0);
+  engineSetMeters(engine, meters);
+  engineSetProfiler(engine, profiler);
+  CompiledGraph compiled = compileGraph(g, BLOCK);
+  profilerNameNodes(profiler, compiled);
+  engineSetGraph(engine, compiled, output);
+  sendCommand(engineQueues(engine),
+              (struct Command){
+                  .type = COMMAND_TRANSPORT,
+                  .transport = {.action = TRANSPORT_PLAY},
+              });
+
   // ui
-  struct VertexBuilder b = {0};
-  rectangle(&b, 100, 100, 100, 100);
-  triangle(&b, 300, 100, 100, 100);
+  DrawList ui = makeDrawList(0);
+  drawListRectangle(ui, 100, 100, 100, 100);
+  drawListTriangle(ui, 300, 100, 100, 100);
+
+  Renderer r = makeRenderer("DAW", WIDTH, HEIGHT, drawListVertices(ui),
+                            drawListCount(ui));
+  struct RenderContext ctx = rendererContext(r);
+  rendererAddLayer(r, makeMeterLayer(ctx, meters, WIDTH - 80, 20, 60,
+                                     HEIGHT - 40));
+  rendererAddLayer(r, makeSpectrumLayer(ctx, spectrum, 20, HEIGHT - 200,
+                                        600, 180));
+  struct TimelineView view;
+  atomic_init(&view.start, 0);
+  atomic_init(&view.end, (uint64_t)VIEW_SECONDS * SAMPLE_RATE);
+  rendererAddLayer(r, makeAutomationLayer(ctx, automation, &view, 0, 1, 640,
+                                          HEIGHT - 200, 540, 90));
+  rendererAddLayer(r, makePianoRollLayer(ctx, notes, &view, LOW_PITCH,
+                                         HIGH_PITCH, 640, HEIGHT - 100, 540,
+                                         80));
+  rendererAddLayer(r, makeProfilerLayer(ctx, profiler, 640, 20, 540, 300));
 
-  Renderer r = makeRenderer("DAW", 640, 480, b.vertices, b.vertexCount);
+  struct Device device = {
+      .engine = engine,
+      .automation = automation,
+      .notes = notes,
+      .view = &view,
+  };
+  startDevice(&device);
   mainLoop(r);
+  stopDevice(&device);
+
+  struct InputLatency latency = inputLatency(rendererInput(r));
+  if (latency.frames) {
+    printf("input to photon over %llu frames: p50 %.1f ms, p99 %.1f ms, "
+           "max %.1f ms\n",
+           (unsigned long long)latency.frames, latency.p50 / 1e6,
+           latency.p99 / 1e6, latency.max / 1e6);
+  }
   freeRenderer(r);
+  freeDrawList(ui);
+  freeEngine(engine);
+  freeGraph(g);
+  freeMeters(meters);
+  freeSpectrum(spectrum);
+  freeAutomationLane(automation);
+  freeSynth(synth);
+  freeProfiler(profiler);
+  freeNoteLane(notes);
+  logStop();
 }
@@ -0,0 +1,30 @@
+#include "message.h"
+
+struct MessageQueues makeMessageQueues(int commandCapacity,
+                                       int telemetryCapacity) {
+  return (struct MessageQueues){
+      .commands = makeSpsc(sizeof(struct Command), commandCapacity),
+      .telemetry = makeSpsc(sizeof(struct Telemetry), telemetryCapacity),
+  };
+}
+
+void freeMessageQueues(struct MessageQueues q) {
+  freeSpsc(q.commands);
+  freeSpsc(q.telemetry);
+}
+
+int sendCommand(struct MessageQueues q, struct Command command) {
+  return spscPush(q.commands, &command);
+}
+
+int receiveTelemetry(struct MessageQueues q, struct Telemetry *telemetry) {
+  return spscPop(q.telemetry, telemetry);
+}
+
+int receiveCommand(struct MessageQueues q, struct Command *command) {
+  return spscPop(q.commands, command);
+}
+
+int sendTelemetry(struct MessageQueues q, struct Telemetry telemetry) {
+  return spscPush(q.telemetry, &telemetry);
+}
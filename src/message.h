@@ -0,0 +1,99 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include "spsc.h"
+#include <stdint.h>
+
+// UI -> AUDIO
+
+enum CommandType {
+  COMMAND_SET_PARAM,
+  COMMAND_TRANSPORT,
+  COMMAND_CLIP_EDIT,
+};
+
+enum TransportAction {
+  TRANSPORT_PLAY,
+  TRANSPORT_STOP,
+  TRANSPORT_SEEK,
+};
+
+enum ClipEditAction {
+  CLIP_MOVE,
+  CLIP_RESIZE,
+  CLIP_MUTE,
+};
+
+struct ParamChange {
+  uint32_t node;
+  uint32_t param;
+  float value;
+};
+
+struct TransportChange {
+  enum TransportAction action;
+  uint64_t position; // in samples, only used by TRANSPORT_SEEK
+};
+
+struct ClipEdit {
+  enum ClipEditAction action;
+  uint32_t track;
+  uint32_t clip;
+  uint64_t start;  // in samples
+  uint64_t length; // in samples
+  int muted;
+};
+
+struct Command {
+  enum CommandType type;
+  union {
+    struct ParamChange param;
+    struct TransportChange transport;
+    struct ClipEdit clip;
+  };
+};
+
+// AUDIO -> UI
+
+enum TelemetryType {
+  TELEMETRY_METER,
+  TELEMETRY_PLAYHEAD,
+  TELEMETRY_XRUNS,
+};
+
+struct MeterReading {
+  uint32_t channel;
+  float peak;
+  float rms;
+};
+
+struct Telemetry {
+  enum TelemetryType type;
+  union {
+    struct MeterReading meter;
+    uint64_t playhead; // in samples
+    uint32_t xruns;    // total since the engine started
+  };
+};
+
+// a pair of wait-free queues between exactly one UI thread and exactly one
+// audio thread. the audio side never blocks or allocates: a full telemetry
+// queue drops the reading, the UI will get a fresher one next block.
+struct MessageQueues {
+  Spsc commands;
+  Spsc telemetry;
+};
+
+struct MessageQueues makeMessageQueues(int commandCapacity,
+                                       int telemetryCapacity);
+void freeMessageQueues(struct MessageQueues q);
+
+// ui thread
+int sendCommand(struct MessageQueues q, struct Command command);
+int receiveTelemetry(struct MessageQueues q, struct Telemetry *telemetry);
+
+// audio thread
+int receiveCommand(struct MessageQueues q, struct Command *command);
+int sendTelemetry(struct MessageQueues q, struct Telemetry telemetry);
+
+#endif
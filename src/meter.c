@@ -0,0 +1,214 @@
+#include "meter.h"
+
+#include "dsp.h"
+#include "rtmem.h"
+#include "spsc.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RMS_SECONDS 0.3
+
+// the triple buffer state: which buffer sits in the middle, and whether the
+// audio thread put something there the ui hasn't taken yet
+#define INDEX_MASK 3u
+#define FRESH 4u
+
+// levels that move less than this keep their old target, block to block
+// jitter of a steady signal then costs no uploads
+#define TOLERANCE_DB 0.25f
+
+// audio side accumulator, one cache line per channel so parallel workers
+// metering neighbouring channels don't share lines
+struct Channel {
+  _Alignas(CACHE_LINE_SIZE) float peak;
+  float meanSquare;
+};
+
+struct Meters {
+  int channelCount;
+  int sampleRate;
+  struct Channel *channels;
+  size_t channelBytes;
+
+  // three snapshots: the audio thread owns `back`, the ui owns `front`, the
+  // middle one is exchanged through `state`
+  struct MeterLevel *buffers[3];
+  uint64_t positions[3];
+  size_t bufferBytes;
+  _Alignas(CACHE_LINE_SIZE) atomic_uint state;
+
+  // audio thread
+  _Alignas(CACHE_LINE_SIZE) unsigned back;
+
+  // ui thread
+  _Alignas(CACHE_LINE_SIZE) unsigned front;
+};
+
+// PRIVATE FUNCTIONS
+
+static float toDb(float linear) {
+  float db = linear > 0 ? 20.0f * log10f(linear) : METER_FLOOR_DB;
+  return db < METER_FLOOR_DB ? METER_FLOOR_DB : db;
+}
+
+// PUBLIC FUNCTIONS
+
+Meters makeMeters(int channels, int sampleRate) {
+  Meters m = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Meters));
+  memset(m, 0, sizeof(struct Meters));
+  m->channelCount = channels;
+  m->sampleRate = sampleRate;
+
+  // all of it is touched by the audio thread
+  m->channelBytes = channels * sizeof(struct Channel);
+  m->channels = rtAlloc(m->channelBytes);
+  m->bufferBytes = channels * sizeof(struct MeterLevel);
+  for (int i = 0; i < 3; i++) {
+    m->buffers[i] = rtAlloc(m->bufferBytes);
+  }
+
+  m->back = 0;
+  atomic_init(&m->state, 1);
+  m->front = 2;
+  return m;
+}
+
+void freeMeters(Meters m) {
+  rtFree(m->channels, m->channelBytes);
+  for (int i = 0; i < 3; i++) {
+    rtFree(m->buffers[i], m->bufferBytes);
+  }
+  free(m);
+}
+
+int meterChannelCount(Meters m) { return m->channelCount; }
+
+void meterMeasure(Meters m, int channel, const float *samples, int frames) {
+  if (channel < 0 || channel >= m->channelCount || frames <= 0) {
+    return;
+  }
+
+  float peak, sumSquares;
+  dsp->levels(samples, frames, &peak, &sumSquares);
+
+  // one pole over block mean squares, block sizes may vary
+  float coefficient = 1.0f - expf(-frames / (RMS_SECONDS * m->sampleRate));
+  struct Channel *c = &m->channels[channel];
+  c->peak = peak > c->peak ? peak : c->peak;
+  c->meanSquare += (sumSquares / frames - c->meanSquare) * coefficient;
+}
+
+void meterPublish(Meters m, uint64_t position) {
+  // if the ui hasn't taken the last snapshot, it's about to be replaced
+  // unseen and its peaks have to ride along in this one. only the audio
+  // thread sets FRESH, so if it's clear now it stays clear
+  unsigned state = atomic_load_explicit(&m->state, memory_order_acquire);
+  const struct MeterLevel *unseen =
+      state & FRESH ? m->buffers[state & INDEX_MASK] : NULL;
+
+  struct MeterLevel *out = m->buffers[m->back];
+  for (int i = 0; i < m->channelCount; i++) {
+    float peak = m->channels[i].peak;
+    if (unseen && unseen[i].peak > peak) {
+      peak = unseen[i].peak;
+    }
+    out[i].peak = peak;
+    out[i].rms = sqrtf(m->channels[i].meanSquare);
+    m->channels[i].peak = 0;
+  }
+  m->positions[m->back] = position;
+
+  unsigned previous = atomic_exchange_explicit(&m->state, m->back | FRESH,
+                                               memory_order_acq_rel);
+  m->back = previous & INDEX_MASK;
+}
+
+const struct MeterLevel *meterRead(Meters m, uint64_t *position) {
+  if (!(atomic_load_explicit(&m->state, memory_order_relaxed) & FRESH)) {
+    return NULL;
+  }
+  unsigned previous =
+      atomic_exchange_explicit(&m->state, m->front, memory_order_acq_rel);
+  m->front = previous & INDEX_MASK;
+  if (position) {
+    *position = m->positions[m->front];
+  }
+  return m->buffers[m->front];
+}
+
+void meterTapProcess(void *state, const struct ProcessContext *ctx) {
+  struct MeterTap *tap = state;
+  for (int i = 0; i < ctx->inputCount; i++) {
+    meterMeasure(tap->meters, tap->channel + i, ctx->inputs[i], ctx->frames);
+    if (i < ctx->outputCount) {
+      memcpy(ctx->outputs[i], ctx->inputs[i], ctx->frames * sizeof(float));
+    }
+  }
+}
+
+struct MeterInstance makeMeterInstance(float x, float y, float width,
+                                       float height) {
+  return (struct MeterInstance){
+      .x = x,
+      .y = y,
+      .width = width,
+      .height = height,
+      .peak = METER_FLOOR_DB,
+      .peakFrom = METER_FLOOR_DB,
+      .rms = METER_FLOOR_DB,
+      .rmsFrom = METER_FLOOR_DB,
+      .hold = METER_FLOOR_DB,
+  };
+}
+
+float meterShown(float level, float from, float since, float now) {
+  float falling = from - METER_DECAY_DB_PER_SECOND * (now - since);
+  return falling > level ? falling : level;
+}
+
+// retargets a level if it moved, returns 1 if it did
+static int retarget(float *level, float *from, float *since, float db,
+                    float now) {
+  if (fabsf(db - *level) <= TOLERANCE_DB) {
+    return 0;
+  }
+  *from = meterShown(*level, *from, *since, now);
+  *level = db;
+  *since = now;
+  return 1;
+}
+
+int meterUpdateInstances(struct MeterInstance *instances,
+                         const struct MeterLevel *levels, int channels,
+                         float now, uint8_t *dirty) {
+  int changed = 0;
+  for (int i = 0; i < channels; i++) {
+    struct MeterInstance *in = &instances[i];
+    float peak = toDb(levels[i].peak);
+    float rms = toDb(levels[i].rms);
+
+    // the hold line stays put for a while, then falls back onto the peak bar.
+    // it only moves for peaks above everything currently on screen
+    float shownPeak = meterShown(in->peak, in->peakFrom, in->peakTime, now);
+    float held = in->hold;
+    if (now - in->holdTime >= METER_HOLD_SECONDS) {
+      held = meterShown(METER_FLOOR_DB, in->hold,
+                        in->holdTime + METER_HOLD_SECONDS, now);
+    }
+    int update = 0;
+    if (peak > (held > shownPeak ? held : shownPeak) + TOLERANCE_DB) {
+      in->hold = peak;
+      in->holdTime = now;
+      update = 1;
+    }
+
+    update |= retarget(&in->peak, &in->peakFrom, &in->peakTime, peak, now);
+    update |= retarget(&in->rms, &in->rmsFrom, &in->rmsTime, rms, now);
+
+    dirty[i] = (uint8_t)update;
+    changed += update;
+  }
+  return changed;
+}
@@ -0,0 +1,70 @@
+#ifndef METER_H
+#define METER_H
+
+#include "graph.h"
+#include <stdint.h>
+
+// peak and rms levels for every mixer strip, measured on the audio thread and
+// read by the ui at display rate. the audio side never waits: each block's
+// levels go into a triple buffer and the ui picks up the newest one. peaks
+// keep accumulating until the ui has seen them, so a transient between two
+// display frames is never lost.
+typedef struct Meters *Meters;
+
+struct MeterLevel {
+  float peak; // largest |sample| since the ui last read, linear
+  float rms;  // ~300ms integration, linear
+};
+
+Meters makeMeters(int channels, int sampleRate);
+void freeMeters(Meters m);
+
+int meterChannelCount(Meters m);
+
+// audio thread. measure may run for different channels on different workers
+// in parallel, publish runs once after the whole block
+void meterMeasure(Meters m, int channel, const float *samples, int frames);
+void meterPublish(Meters m, uint64_t position);
+
+// ui thread. the newest levels, or NULL if nothing was published since the
+// last call. valid until the next call
+const struct MeterLevel *meterRead(Meters m, uint64_t *position);
+
+// a pass-through node that meters each of its inputs, input i goes to meter
+// channel `channel + i`
+struct MeterTap {
+  Meters meters;
+  int channel;
+};
+
+void meterTapProcess(void *state, const struct ProcessContext *ctx);
+
+// ui side of the display. every level is a target in dB plus the value the
+// bar was showing when the target was set; the shader lets the bar fall from
+// there towards the target. steady levels therefore need no new data at all,
+// a meter is only touched when one of its levels really moves.
+#define METER_FLOOR_DB -60.0f
+#define METER_DECAY_DB_PER_SECOND 24.0f
+#define METER_HOLD_SECONDS 1.5f
+
+struct MeterInstance {
+  float x, y, width, height; // window coordinates
+  float peak, peakFrom, peakTime;
+  float rms, rmsFrom, rmsTime;
+  float hold, holdTime;
+};
+
+// a silent meter covering the given rectangle
+struct MeterInstance makeMeterInstance(float x, float y, float width,
+                                       float height);
+
+// what the shader shows for a level, matches assets/meter.vert
+float meterShown(float level, float from, float since, float now);
+
+// folds new levels into the instances, marks what changed in `dirty` (one
+// byte per instance) and returns how many changed
+int meterUpdateInstances(struct MeterInstance *instances,
+                         const struct MeterLevel *levels, int channels,
+                         float now, uint8_t *dirty);
+
+#endif
@@ -0,0 +1,174 @@
+#include "meterlayer.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATTRIBUTE_COUNT 4
+
+// gap between strips, in window coordinates
+#define GAP 1.0f
+
+struct MeterPushConstants {
+  struct Vec2 size;
+  float time;
+};
+
+struct MeterLayer {
+  Meters meters;
+  int count;
+  struct MeterInstance *instances;
+  uint8_t *dirty;
+
+  // per frame in flight: a mapped instance buffer and which of its instances
+  // are behind `instances`
+  int framesInFlight;
+  struct VertexBufferAndMemory *buffers;
+  struct MeterInstance **mapped;
+  uint8_t **stale;
+
+  // vulkan
+  VkDevice device;
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
+
+// PRIVATE FUNCTIONS
+
+static struct VertexInput instanceInput(void) {
+  static VkVertexInputAttributeDescription attributes[ATTRIBUTE_COUNT];
+  attributes[0] = (VkVertexInputAttributeDescription){
+      0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(struct MeterInstance, x)};
+  attributes[1] = (VkVertexInputAttributeDescription){
+      1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(struct MeterInstance, peak)};
+  attributes[2] = (VkVertexInputAttributeDescription){
+      2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(struct MeterInstance, rms)};
+  attributes[3] = (VkVertexInputAttributeDescription){
+      3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(struct MeterInstance, hold)};
+
+  static VkVertexInputBindingDescription binding = {0};
+  binding.binding = 0;
+  binding.stride = sizeof(struct MeterInstance);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  return (struct VertexInput){&binding, 1, attributes, ATTRIBUTE_COUNT};
+}
+
+static void prepare(void *state, int frame, double time) {
+  struct MeterLayer *l = state;
+
+  const struct MeterLevel *levels = meterRead(l->meters, NULL);
+  if (levels &&
+      meterUpdateInstances(l->instances, levels, l->count, (float)time,
+                           l->dirty) > 0) {
+    for (int i = 0; i < l->count; i++) {
+      if (l->dirty[i]) {
+        for (int f = 0; f < l->framesInFlight; f++) {
+          l->stale[f][i] = 1;
+        }
+      }
+    }
+  }
+
+  // bring this frame's copy up to date
+  for (int i = 0; i < l->count; i++) {
+    if (l->stale[frame][i]) {
+      l->mapped[frame][i] = l->instances[i];
+      l->stale[frame][i] = 0;
+    }
+  }
+}
+
+static void record(void *state, VkCommandBuffer commandBuffer, int frame,
+                   double time, struct Vec2 size) {
+  struct MeterLayer *l = state;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    l->pipeline);
+
+  struct MeterPushConstants pushConstants = {size, (float)time};
+  vkCmdPushConstants(commandBuffer, l->pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(struct MeterPushConstants), &pushConstants);
+
+  VkBuffer buffers[] = {l->buffers[frame].buffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdDraw(commandBuffer, 6, l->count, 0, 0);
+}
+
+static void destroy(void *state) {
+  struct MeterLayer *l = state;
+
+  for (int f = 0; f < l->framesInFlight; f++) {
+    vkUnmapMemory(l->device, l->buffers[f].memory);
+    vkDestroyBuffer(l->device, l->buffers[f].buffer, NULL);
+    vkFreeMemory(l->device, l->buffers[f].memory, NULL);
+    free(l->stale[f]);
+  }
+  free(l->buffers);
+  free(l->mapped);
+  free(l->stale);
+
+  vkDestroyPipeline(l->device, l->pipeline, NULL);
+  vkDestroyPipelineLayout(l->device, l->pipelineLayout, NULL);
+  vkDestroyShaderModule(l->device, l->fragShader, NULL);
+  vkDestroyShaderModule(l->device, l->vertShader, NULL);
+
+  free(l->instances);
+  free(l->dirty);
+  free(l);
+}
+
+// PUBLIC FUNCTIONS
+
+struct Layer makeMeterLayer(struct RenderContext ctx, Meters meters, float x,
+                            float y, float width, float height) {
+  struct MeterLayer *l = malloc(sizeof(struct MeterLayer));
+  l->meters = meters;
+  l->count = meterChannelCount(meters);
+  l->device = ctx.device;
+  l->framesInFlight = ctx.framesInFlight;
+
+  // layout
+  l->instances = malloc(l->count * sizeof(struct MeterInstance));
+  l->dirty = malloc(l->count);
+  float strip = width / l->count;
+  for (int i = 0; i < l->count; i++) {
+    float w = strip > 2 * GAP ? strip - GAP : strip;
+    l->instances[i] = makeMeterInstance(x + i * strip, y, w, height);
+  }
+
+  // instance buffers, mapped for good
+  VkDeviceSize size = l->count * sizeof(struct MeterInstance);
+  l->buffers = malloc(l->framesInFlight * sizeof(struct VertexBufferAndMemory));
+  l->mapped = malloc(l->framesInFlight * sizeof(struct MeterInstance *));
+  l->stale = malloc(l->framesInFlight * sizeof(uint8_t *));
+  for (int f = 0; f < l->framesInFlight; f++) {
+    l->buffers[f] = makeVkHostBuffer(ctx.physicalDevice, ctx.device, size,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vkMapMemory(ctx.device, l->buffers[f].memory, 0, size, 0,
+                (void **)&l->mapped[f]);
+    l->stale[f] = malloc(l->count);
+    memset(l->stale[f], 1, l->count);
+  }
+
+  // pipeline
+  l->vertShader = makeVkShaderModule(ctx.device, "bin/meter-vert.spv");
+  l->fragShader = makeVkShaderModule(ctx.device, "bin/meter-frag.spv");
+  l->pipelineLayout = makeVkPushConstantLayout(
+      ctx.device, sizeof(struct MeterPushConstants),
+      VK_SHADER_STAGE_VERTEX_BIT);
+  l->pipeline = makeVkPipelineWithInput(
+      ctx.device, ctx.swapchainSettings, l->vertShader, l->fragShader,
+      ctx.renderPass, l->pipelineLayout, instanceInput());
+
+  return (struct Layer){
+      .state = l,
+      .prepare = prepare,
+      .record = record,
+      .destroy = destroy,
+  };
+}
@@ -0,0 +1,13 @@
+#ifndef METERLAYER_H
+#define METERLAYER_H
+
+#include "meter.h"
+#include "renderer.h"
+
+// draws every channel of `meters` as a vertical strip, side by side inside
+// the given rectangle (window coordinates). one instanced draw for all of
+// them; a frame only writes the instances whose levels moved.
+struct Layer makeMeterLayer(struct RenderContext ctx, Meters meters, float x,
+                            float y, float width, float height);
+
+#endif
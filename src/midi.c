@@ -0,0 +1,395 @@
+#include "midi.h"
+
+#include "die.h"
+#include "lane.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// notes under each leaf of the reach index
+#define REACH_BLOCK 32
+
+struct NoteTrack {
+  atomic_int references;
+  int count;
+  int leaves; // of the reach index, a power of two
+
+  // by start
+  uint64_t *starts;
+  uint32_t *lengths;
+  uint8_t *pitches;
+  uint8_t *velocities;
+
+  // by end, for note offs: where each note ends and which note it is
+  uint64_t *ends;
+  int32_t *byEnd;
+
+  // a tree over blocks of REACH_BLOCK notes in start order, the latest end
+  // under each node. the root is 1, the children of n are 2n and 2n + 1
+  uint64_t *reach;
+};
+
+struct NoteLane {
+  Lane tracks;
+  struct NoteCursor cursor; // audio thread
+};
+
+// PRIVATE FUNCTIONS
+
+static int reachLeaves(int count) {
+  int blocks = (count + REACH_BLOCK - 1) / REACH_BLOCK, leaves = 1;
+  while (leaves < blocks) {
+    leaves *= 2;
+  }
+  return leaves;
+}
+
+// the columns share one allocation with the track, widest first so each
+// stays aligned
+static size_t trackBytes(int count) {
+  return sizeof(struct NoteTrack) +
+         2 * (size_t)reachLeaves(count) * sizeof(uint64_t) +
+         (size_t)count * (2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + 2);
+}
+
+static NoteTrack allocate(int count) {
+  size_t n = (size_t)count;
+  NoteTrack t = malloc(trackBytes(count));
+  atomic_init(&t->references, 1);
+  t->count = count;
+  t->leaves = reachLeaves(count);
+  t->reach = (uint64_t *)(t + 1);
+  t->starts = t->reach + 2 * (size_t)t->leaves;
+  t->ends = t->starts + n;
+  t->lengths = (uint32_t *)(t->ends + n);
+  t->byEnd = (int32_t *)(t->lengths + n);
+  t->pitches = (uint8_t *)(t->byEnd + n);
+  t->velocities = t->pitches + n;
+  return t;
+}
+
+static int compareNotes(const void *x, const void *y) {
+  const struct Note *a = x, *b = y;
+  if (a->start != b->start) {
+    return a->start < b->start ? -1 : 1;
+  }
+  return a->pitch - b->pitch;
+}
+
+struct EndOrder {
+  uint64_t end;
+  int32_t note;
+};
+
+static int compareEnds(const void *x, const void *y) {
+  const struct EndOrder *a = x, *b = y;
+  if (a->end != b->end) {
+    return a->end < b->end ? -1 : 1;
+  }
+  return a->note - b->note;
+}
+
+// first index whose value is at least `value`
+static int lowerBound(const uint64_t *values, int count, uint64_t value) {
+  int low = 0, high = count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (values[mid] < value) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// first index whose value is past `value`
+static int upperBound(const uint64_t *values, int count, uint64_t value) {
+  int low = 0, high = count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (values[mid] <= value) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// where a note goes in start order, after any it ties with
+static int insertionIndex(NoteTrack t, struct Note note) {
+  int i = upperBound(t->starts, t->count, note.start);
+  while (i > 0 && t->starts[i - 1] == note.start &&
+         t->pitches[i - 1] > note.pitch) {
+    i--;
+  }
+  return i;
+}
+
+// once the notes are in place
+static void buildReach(NoteTrack t) {
+  memset(t->reach, 0, 2 * (size_t)t->leaves * sizeof(uint64_t));
+  for (int i = 0; i < t->count; i++) {
+    uint64_t end = t->starts[i] + t->lengths[i];
+    uint64_t *leaf = &t->reach[t->leaves + i / REACH_BLOCK];
+    *leaf = end > *leaf ? end : *leaf;
+  }
+  for (int n = t->leaves - 1; n > 0; n--) {
+    uint64_t a = t->reach[2 * n], b = t->reach[2 * n + 1];
+    t->reach[n] = a > b ? a : b;
+  }
+}
+
+struct Visible {
+  NoteTrack t;
+  uint64_t start;
+  int last; // notes from here on start too late
+  struct NoteRange *runs;
+  int capacity;
+  int count;
+};
+
+// joins the last run if it ends where this one starts, or if there's no room
+// for another
+static void addRun(struct Visible *v, int first, int past) {
+  if (v->count > 0) {
+    struct NoteRange *r = &v->runs[v->count - 1];
+    if (r->first + r->count == first || v->count == v->capacity) {
+      r->count = past - r->first;
+      return;
+    }
+  }
+  v->runs[v->count++] = (struct NoteRange){first, past - first};
+}
+
+// the node covers `span` blocks from block `block` on, skipped whole if none
+// of its notes reaches `start`
+static void visit(struct Visible *v, int node, int block, int span) {
+  if (block * REACH_BLOCK >= v->last || v->t->reach[node] <= v->start) {
+    return;
+  }
+  if (span > 1) {
+    visit(v, 2 * node, block, span / 2);
+    visit(v, 2 * node + 1, block + span / 2, span / 2);
+    return;
+  }
+  NoteTrack t = v->t;
+  int first = block * REACH_BLOCK;
+  int past = first + REACH_BLOCK < v->last ? first + REACH_BLOCK : v->last;
+  while (first < past && t->starts[first] + t->lengths[first] <= v->start) {
+    first++;
+  }
+  if (first < past) {
+    addRun(v, first, past);
+  }
+}
+
+static void copyNote(NoteTrack to, int i, NoteTrack from, int j) {
+  to->starts[i] = from->starts[j];
+  to->lengths[i] = from->lengths[j];
+  to->pitches[i] = from->pitches[j];
+  to->velocities[i] = from->velocities[j];
+}
+
+static void retainTrack(void *item) { noteTrackRetain(item); }
+
+static int dropTrack(void *item) {
+  NoteTrack t = item;
+  return atomic_fetch_sub_explicit(&t->references, 1, memory_order_acq_rel) ==
+         1;
+}
+
+static const struct LaneItems trackItems = {retainTrack, dropTrack, free};
+
+// PUBLIC FUNCTIONS
+
+NoteTrack makeNoteTrack(const struct Note *notes, int count) {
+  struct Note *sorted = malloc((count ? count : 1) * sizeof(struct Note));
+  if (count) {
+    memcpy(sorted, notes, count * sizeof(struct Note));
+    qsort(sorted, count, sizeof(struct Note), compareNotes);
+  }
+
+  NoteTrack t = allocate(count);
+  struct EndOrder *ends =
+      malloc((count ? count : 1) * sizeof(struct EndOrder));
+  for (int i = 0; i < count; i++) {
+    uint32_t length = sorted[i].length ? sorted[i].length : 1;
+    t->starts[i] = sorted[i].start;
+    t->lengths[i] = length;
+    t->pitches[i] = sorted[i].pitch;
+    t->velocities[i] = sorted[i].velocity;
+    ends[i] = (struct EndOrder){sorted[i].start + length, i};
+  }
+  qsort(ends, count, sizeof(struct EndOrder), compareEnds);
+  for (int i = 0; i < count; i++) {
+    t->ends[i] = ends[i].end;
+    t->byEnd[i] = ends[i].note;
+  }
+  buildReach(t);
+
+  free(ends);
+  free(sorted);
+  return t;
+}
+
+void noteTrackRetain(NoteTrack t) {
+  atomic_fetch_add_explicit(&t->references, 1, memory_order_relaxed);
+}
+
+void noteTrackRelease(NoteTrack t) {
+  if (t && atomic_fetch_sub_explicit(&t->references, 1,
+                                     memory_order_acq_rel) == 1) {
+    free(t);
+  }
+}
+
+int noteTrackCount(NoteTrack t) { return t->count; }
+
+struct NoteColumns noteTrackColumns(NoteTrack t) {
+  return (struct NoteColumns){t->starts, t->lengths, t->pitches,
+                              t->velocities};
+}
+
+struct Note noteTrackNote(NoteTrack t, int index) {
+  return (struct Note){t->starts[index], t->lengths[index], t->pitches[index],
+                       t->velocities[index]};
+}
+
+size_t noteTrackBytes(NoteTrack t) { return trackBytes(t->count); }
+
+NoteTrack noteTrackInsert(NoteTrack t, struct Note note) {
+  note.length = note.length ? note.length : 1;
+  int at = insertionIndex(t, note);
+  NoteTrack u = allocate(t->count + 1);
+
+  for (int i = 0; i < t->count; i++) {
+    copyNote(u, i + (i >= at), t, i);
+  }
+  u->starts[at] = note.start;
+  u->lengths[at] = note.length;
+  u->pitches[at] = note.pitch;
+  u->velocities[at] = note.velocity;
+
+  // the end order only shifts, the note indices past `at` move up one
+  uint64_t end = note.start + note.length;
+  int endAt = upperBound(t->ends, t->count, end);
+  for (int i = 0; i < t->count; i++) {
+    int j = i + (i >= endAt);
+    u->ends[j] = t->ends[i];
+    u->byEnd[j] = t->byEnd[i] + (t->byEnd[i] >= at);
+  }
+  u->ends[endAt] = end;
+  u->byEnd[endAt] = at;
+  buildReach(u);
+  return u;
+}
+
+NoteTrack noteTrackRemove(NoteTrack t, int index) {
+  if (index < 0 || index >= t->count) {
+    die("Invalid note %d of %d\n", index, t->count);
+  }
+  NoteTrack u = allocate(t->count - 1);
+  for (int i = 0, j = 0; i < t->count; i++) {
+    if (i == index) {
+      continue;
+    }
+    copyNote(u, j++, t, i);
+  }
+  for (int i = 0, j = 0; i < t->count; i++) {
+    if (t->byEnd[i] == index) {
+      continue;
+    }
+    u->ends[j] = t->ends[i];
+    u->byEnd[j++] = t->byEnd[i] - (t->byEnd[i] > index);
+  }
+  buildReach(u);
+  return u;
+}
+
+int noteTrackVisible(NoteTrack t, uint64_t start, uint64_t end,
+                     struct NoteRange *runs, int capacity) {
+  struct Visible v = {t, start, lowerBound(t->starts, t->count, end), runs,
+                      capacity, 0};
+  if (capacity > 0) {
+    visit(&v, 1, 0, t->leaves);
+  }
+  return v.count;
+}
+
+int noteTrackEvents(NoteTrack t, struct NoteCursor *cursor, uint64_t position,
+                    int frames, struct MidiEvent *events, int capacity) {
+  int n = 0;
+  if (cursor->track != t || cursor->next != position) {
+    if (cursor->track && n < capacity) {
+      events[n++] = (struct MidiEvent){0, MIDI_ALL_NOTES_OFF, 0, 0};
+    }
+    cursor->track = t;
+    cursor->on = lowerBound(t->starts, t->count, position);
+    cursor->off = lowerBound(t->ends, t->count, position);
+  }
+  uint64_t end = position + frames;
+  cursor->next = end;
+
+  // merge the two orders, offs first so a repeated note retriggers
+  while (n < capacity) {
+    int on = cursor->on, off = cursor->off;
+    int hasOn = on < t->count && t->starts[on] < end;
+    int hasOff = off < t->count && t->ends[off] < end;
+    if (hasOff && (!hasOn || t->ends[off] <= t->starts[on])) {
+      uint64_t at = t->ends[off];
+      events[n++] = (struct MidiEvent){
+          at > position ? (uint32_t)(at - position) : 0, MIDI_NOTE_OFF,
+          t->pitches[t->byEnd[off]], 0};
+      cursor->off++;
+    } else if (hasOn) {
+      uint64_t at = t->starts[on];
+      events[n++] = (struct MidiEvent){
+          at > position ? (uint32_t)(at - position) : 0, MIDI_NOTE_ON,
+          t->pitches[on], t->velocities[on]};
+      cursor->on++;
+    } else {
+      break;
+    }
+  }
+  return n;
+}
+
+NoteLane makeNoteLane(NoteTrack track) {
+  NoteLane l = calloc(1, sizeof(struct NoteLane));
+  l->tracks = makeLane(&trackItems, track, 1);
+  return l;
+}
+
+void freeNoteLane(NoteLane l) {
+  freeLane(l->tracks);
+  free(l);
+}
+
+void noteLaneSet(NoteLane l, NoteTrack track) { laneSet(l->tracks, track); }
+
+void noteLaneCollect(NoteLane l) { laneCollect(l->tracks); }
+
+NoteTrack noteLaneDisplay(NoteLane l) { return laneDisplay(l->tracks); }
+
+int noteLaneEvents(NoteLane l, const struct ProcessContext *ctx,
+                   struct MidiEvent *events, int capacity) {
+  void *replaced;
+  if (lanePickUp(l->tracks, &replaced)) {
+    laneRetire(l->tracks, replaced);
+    // the new track may sit where the old one was, force a seek all the same
+    l->cursor.next = UINT64_MAX;
+  }
+
+  if (!ctx->playing) {
+    if (l->cursor.track && capacity > 0) {
+      l->cursor.track = NULL;
+      events[0] = (struct MidiEvent){0, MIDI_ALL_NOTES_OFF, 0, 0};
+      return 1;
+    }
+    return 0;
+  }
+  return noteTrackEvents(laneCurrent(l->tracks), &l->cursor, ctx->position,
+                         ctx->frames, events, capacity);
+}
@@ -0,0 +1,114 @@
+#ifndef MIDI_H
+#define MIDI_H
+
+#include "graph.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// the notes of one track, stored column by column and sorted by start. like
+// automation curves a track never changes once made, an edit builds a new
+// one, and tracks are shared between threads by reference count.
+typedef struct NoteTrack *NoteTrack;
+
+struct Note {
+  uint64_t start;   // samples
+  uint32_t length;  // samples, at least one
+  uint8_t pitch;    // midi note number
+  uint8_t velocity; // 1 to 127
+};
+
+// one column per field, index i of each is note i. ties in start are broken
+// by pitch
+struct NoteColumns {
+  const uint64_t *starts;
+  const uint32_t *lengths;
+  const uint8_t *pitches;
+  const uint8_t *velocities;
+};
+
+// sorts a copy of the notes, zero lengths become one. an empty track is fine
+NoteTrack makeNoteTrack(const struct Note *notes, int count);
+
+// starts with one reference, the last release frees it. not real-time safe,
+// the audio side goes through a lane
+void noteTrackRetain(NoteTrack t);
+void noteTrackRelease(NoteTrack t);
+
+int noteTrackCount(NoteTrack t);
+struct NoteColumns noteTrackColumns(NoteTrack t);
+struct Note noteTrackNote(NoteTrack t, int index);
+
+// memory the track holds, for accounting
+size_t noteTrackBytes(NoteTrack t);
+
+// edits. each returns a new track with one reference and leaves `t` alone.
+// removing dies on an index the track doesn't have
+NoteTrack noteTrackInsert(NoteTrack t, struct Note note);
+NoteTrack noteTrackRemove(NoteTrack t, int index);
+
+struct NoteRange {
+  int first;
+  int count;
+};
+
+// the notes that may overlap [start, end), as runs in start order: every note
+// that does is in one of them, a few that end before `start` may be too. a
+// note held across the whole song adds a run of its own rather than widening
+// the rest. fills at most `capacity` runs, the last one taking in the rest if
+// there are more, and returns how many
+int noteTrackVisible(NoteTrack t, uint64_t start, uint64_t end,
+                     struct NoteRange *runs, int capacity);
+
+// EVENTS
+
+enum MidiEventType {
+  MIDI_NOTE_OFF,
+  MIDI_NOTE_ON,
+  MIDI_ALL_NOTES_OFF, // after a seek or a new version of the track
+};
+
+struct MidiEvent {
+  uint32_t offset; // frames into the block
+  uint8_t type;    // enum MidiEventType
+  uint8_t pitch;
+  uint8_t velocity;
+};
+
+// where playback got to. zero it to start
+struct NoteCursor {
+  NoteTrack track;
+  uint64_t next; // position the following block should start at
+  int on;        // next note to start, in start order
+  int off;       // next note to end, in end order
+};
+
+// real-time safe. the events of [position, position + frames) in order, note
+// offs before note ons at the same frame. costs a binary search after a jump
+// and nothing per note otherwise, just per event. events that don't fit come
+// first in the next block, late but not lost. returns how many
+int noteTrackEvents(NoteTrack t, struct NoteCursor *cursor, uint64_t position,
+                    int frames, struct MidiEvent *events, int capacity);
+
+// one track shared by the ui, the audio thread and the render thread, the
+// same way an automation lane shares its curve
+typedef struct NoteLane *NoteLane;
+
+// takes its own references to `track`
+NoteLane makeNoteLane(NoteTrack track);
+void freeNoteLane(NoteLane l);
+
+// ui thread. takes its own references, the caller keeps theirs
+void noteLaneSet(NoteLane l, NoteTrack track);
+
+// ui thread. frees tracks the audio thread has let go of, call regularly
+void noteLaneCollect(NoteLane l);
+
+// render thread. the newest track, valid until the next call
+NoteTrack noteLaneDisplay(NoteLane l);
+
+// audio thread. the events of this block at the transport position, all
+// notes off once when the transport stops
+int noteLaneEvents(NoteLane l, const struct ProcessContext *ctx,
+                   struct MidiEvent *events, int capacity);
+
+#endif
@@ -0,0 +1,586 @@
+#include "model.h"
+
+#include "lane.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// an immutable string shared between versions
+struct Text {
+  atomic_int references;
+  char chars[];
+};
+
+struct Track {
+  atomic_int references;
+  uint32_t flags;
+  float gain;
+  float pan;
+  struct Text *name;
+  NoteTrack notes;
+  Vector clips; // struct ClipState, sources point into texts
+  Vector lanes; // struct LaneState, by parameter
+};
+
+struct Model {
+  atomic_int references;
+  int sampleRate;
+  Vector tracks; // Track
+};
+
+struct History {
+  Model *versions; // a ring of `depth`
+  int depth;
+  int first; // ring index of the oldest version
+  int count;
+  int at; // the current version, counted from the oldest
+};
+
+struct ModelLane {
+  Lane models;
+};
+
+// PRIVATE FUNCTIONS
+
+static struct Text *makeText(const char *chars) {
+  size_t n = strlen(chars ? chars : "") + 1;
+  struct Text *t = malloc(sizeof(struct Text) + n);
+  atomic_init(&t->references, 1);
+  memcpy(t->chars, chars ? chars : "", n);
+  return t;
+}
+
+static struct Text *textOf(const char *chars) {
+  return (struct Text *)(chars - offsetof(struct Text, chars));
+}
+
+static void retainText(struct Text *t) {
+  atomic_fetch_add_explicit(&t->references, 1, memory_order_relaxed);
+}
+
+static void releaseText(struct Text *t) {
+  if (atomic_fetch_sub_explicit(&t->references, 1, memory_order_acq_rel) ==
+      1) {
+    free(t);
+  }
+}
+
+static size_t textBytes(const char *chars) {
+  return sizeof(struct Text) + strlen(chars) + 1;
+}
+
+static void retainClip(const void *item) {
+  retainText(textOf(((const struct ClipState *)item)->source));
+}
+
+static void releaseClip(const void *item) {
+  releaseText(textOf(((const struct ClipState *)item)->source));
+}
+
+static void retainLane(const void *item) {
+  automationRetain(((const struct LaneState *)item)->curve);
+}
+
+static void releaseLane(const void *item) {
+  automationRelease(((const struct LaneState *)item)->curve);
+}
+
+static void retainTrackItem(const void *item) {
+  trackRetain(*(const Track *)item);
+}
+
+static void releaseTrackItem(const void *item) {
+  trackRelease(*(const Track *)item);
+}
+
+static const struct VectorItems clipItems = {sizeof(struct ClipState),
+                                             retainClip, releaseClip};
+static const struct VectorItems laneItems = {sizeof(struct LaneState),
+                                             retainLane, releaseLane};
+static const struct VectorItems trackItems = {sizeof(Track), retainTrackItem,
+                                              releaseTrackItem};
+
+// shares everything with `t`
+static Track copyTrack(Track t) {
+  Track u = malloc(sizeof(struct Track));
+  atomic_init(&u->references, 1);
+  u->flags = t->flags;
+  u->gain = t->gain;
+  u->pan = t->pan;
+  u->name = t->name;
+  u->notes = t->notes;
+  u->clips = t->clips;
+  u->lanes = t->lanes;
+  retainText(u->name);
+  if (u->notes) {
+    noteTrackRetain(u->notes);
+  }
+  vectorRetain(u->clips);
+  vectorRetain(u->lanes);
+  return u;
+}
+
+// takes over `clips`
+static Track withClips(Track t, Vector clips) {
+  Track u = copyTrack(t);
+  vectorRelease(u->clips);
+  u->clips = clips;
+  return u;
+}
+
+static Track withLanes(Track t, Vector lanes) {
+  Track u = copyTrack(t);
+  vectorRelease(u->lanes);
+  u->lanes = lanes;
+  return u;
+}
+
+// a clip whose source is a text of its own, the caller releases it once the
+// clip is in a vector
+static struct ClipState ownClip(struct ClipState clip) {
+  clip.source = makeText(clip.source)->chars;
+  return clip;
+}
+
+static Model withTracks(Model m, Vector tracks) {
+  Model u = malloc(sizeof(struct Model));
+  atomic_init(&u->references, 1);
+  u->sampleRate = m ? m->sampleRate : 0;
+  u->tracks = tracks;
+  return u;
+}
+
+static void destroyModel(void *memory) {
+  Model m = memory;
+  vectorRelease(m->tracks);
+  free(m);
+}
+
+// a set of addresses, for telling shared memory from new
+struct Accounting {
+  const void **seen; // open addressing, a power of two
+  size_t capacity;
+  size_t count;
+  int counting; // only memory seen for the first time while counting adds up
+  size_t bytes;
+};
+
+static int seenBefore(struct Accounting *a, const void *p);
+
+static void growSeen(struct Accounting *a) {
+  const void **old = a->seen;
+  size_t capacity = a->capacity;
+  a->capacity = capacity ? 2 * capacity : 1024;
+  a->seen = calloc(a->capacity, sizeof(const void *));
+  a->count = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    if (old[i]) {
+      seenBefore(a, old[i]);
+    }
+  }
+  free(old);
+}
+
+// adds `p`, returns whether it was there already
+static int seenBefore(struct Accounting *a, const void *p) {
+  if (2 * (a->count + 1) > a->capacity) {
+    growSeen(a);
+  }
+  size_t mask = a->capacity - 1;
+  size_t i = ((uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ull >> 20 & mask;
+  for (; a->seen[i]; i = (i + 1) & mask) {
+    if (a->seen[i] == p) {
+      return 1;
+    }
+  }
+  a->seen[i] = p;
+  a->count++;
+  return 0;
+}
+
+static int account(void *context, const void *p, size_t bytes) {
+  struct Accounting *a = context;
+  if (seenBefore(a, p)) {
+    return 0;
+  }
+  a->bytes += a->counting ? bytes : 0;
+  return 1;
+}
+
+static void accountClip(void *context, const void *item) {
+  const char *source = ((const struct ClipState *)item)->source;
+  account(context, textOf(source), textBytes(source));
+}
+
+static void accountLane(void *context, const void *item) {
+  Automation curve = ((const struct LaneState *)item)->curve;
+  account(context, curve, automationBytes(curve));
+}
+
+static void accountTrack(void *context, const void *item) {
+  Track t = *(const Track *)item;
+  if (!account(context, t, sizeof(struct Track))) {
+    return;
+  }
+  account(context, t->name, textBytes(t->name->chars));
+  if (t->notes) {
+    account(context, t->notes, noteTrackBytes(t->notes));
+  }
+  vectorWalk(t->clips, &(struct VectorWalk){account, accountClip, context});
+  vectorWalk(t->lanes, &(struct VectorWalk){account, accountLane, context});
+}
+
+static void accountModel(struct Accounting *a, Model m) {
+  if (account(a, m, sizeof(struct Model))) {
+    vectorWalk(m->tracks, &(struct VectorWalk){account, accountTrack, a});
+  }
+}
+
+static void retainModel(void *item) {
+  Model m = item;
+  atomic_fetch_add_explicit(&m->references, 1, memory_order_relaxed);
+}
+
+static int dropModel(void *item) {
+  Model m = item;
+  return atomic_fetch_sub_explicit(&m->references, 1, memory_order_acq_rel) ==
+         1;
+}
+
+static const struct LaneItems modelItems = {retainModel, dropModel,
+                                            destroyModel};
+
+// PUBLIC FUNCTIONS
+
+Track makeTrack(const char *name) {
+  Track t = malloc(sizeof(struct Track));
+  atomic_init(&t->references, 1);
+  t->flags = 0;
+  t->gain = 1;
+  t->pan = 0;
+  t->name = makeText(name);
+  t->notes = NULL;
+  t->clips = makeVector(&clipItems);
+  t->lanes = makeVector(&laneItems);
+  return t;
+}
+
+void trackRetain(Track t) {
+  atomic_fetch_add_explicit(&t->references, 1, memory_order_relaxed);
+}
+
+void trackRelease(Track t) {
+  if (!t || atomic_fetch_sub_explicit(&t->references, 1,
+                                      memory_order_acq_rel) != 1) {
+    return;
+  }
+  releaseText(t->name);
+  noteTrackRelease(t->notes);
+  vectorRelease(t->clips);
+  vectorRelease(t->lanes);
+  free(t);
+}
+
+const char *trackName(Track t) { return t->name->chars; }
+
+uint32_t trackFlags(Track t) { return t->flags; }
+
+float trackGain(Track t) { return t->gain; }
+
+float trackPan(Track t) { return t->pan; }
+
+NoteTrack trackNotes(Track t) { return t->notes; }
+
+int trackClipCount(Track t) { return vectorCount(t->clips); }
+
+struct ClipState trackClip(Track t, int index) {
+  return *(const struct ClipState *)vectorGet(t->clips, index);
+}
+
+int trackLaneCount(Track t) { return vectorCount(t->lanes); }
+
+struct LaneState trackLane(Track t, int index) {
+  return *(const struct LaneState *)vectorGet(t->lanes, index);
+}
+
+Automation trackCurve(Track t, uint32_t param) {
+  for (int i = 0; i < vectorCount(t->lanes); i++) {
+    struct LaneState lane = trackLane(t, i);
+    if (lane.param == param) {
+      return lane.curve;
+    }
+  }
+  return NULL;
+}
+
+Track trackRename(Track t, const char *name) {
+  Track u = copyTrack(t);
+  releaseText(u->name);
+  u->name = makeText(name);
+  return u;
+}
+
+Track trackSetMix(Track t, uint32_t flags, float gain, float pan) {
+  Track u = copyTrack(t);
+  u->flags = flags;
+  u->gain = gain;
+  u->pan = pan;
+  return u;
+}
+
+Track trackSetNotes(Track t, NoteTrack notes) {
+  Track u = copyTrack(t);
+  if (notes) {
+    noteTrackRetain(notes);
+  }
+  noteTrackRelease(u->notes);
+  u->notes = notes;
+  return u;
+}
+
+Track trackInsertClip(Track t, int index, struct ClipState clip) {
+  clip = ownClip(clip);
+  Track u = withClips(t, vectorInsert(t->clips, index, &clip));
+  releaseClip(&clip);
+  return u;
+}
+
+Track trackSetClip(Track t, int index, struct ClipState clip) {
+  clip = ownClip(clip);
+  Track u = withClips(t, vectorSet(t->clips, index, &clip));
+  releaseClip(&clip);
+  return u;
+}
+
+Track trackRemoveClip(Track t, int index) {
+  return withClips(t, vectorRemove(t->clips, index));
+}
+
+Track trackSetCurve(Track t, uint32_t param, Automation curve) {
+  int count = vectorCount(t->lanes), at = 0;
+  while (at < count && trackLane(t, at).param < param) {
+    at++;
+  }
+  struct LaneState lane = {param, curve};
+  if (at < count && trackLane(t, at).param == param) {
+    return withLanes(t, curve ? vectorSet(t->lanes, at, &lane)
+                              : vectorRemove(t->lanes, at));
+  }
+  return curve ? withLanes(t, vectorInsert(t->lanes, at, &lane))
+               : copyTrack(t);
+}
+
+Model makeModel(int sampleRate) {
+  Model m = withTracks(NULL, makeVector(&trackItems));
+  m->sampleRate = sampleRate;
+  return m;
+}
+
+void modelRetain(Model m) {
+  atomic_fetch_add_explicit(&m->references, 1, memory_order_relaxed);
+}
+
+void modelRelease(Model m) {
+  if (m && atomic_fetch_sub_explicit(&m->references, 1,
+                                     memory_order_acq_rel) == 1) {
+    destroyModel(m);
+  }
+}
+
+int modelSampleRate(Model m) { return m->sampleRate; }
+
+int modelTrackCount(Model m) { return vectorCount(m->tracks); }
+
+Track modelTrack(Model m, int index) {
+  return *(const Track *)vectorGet(m->tracks, index);
+}
+
+Model modelInsertTrack(Model m, int index, Track t) {
+  return withTracks(m, vectorInsert(m->tracks, index, &t));
+}
+
+Model modelSetTrack(Model m, int index, Track t) {
+  return withTracks(m, vectorSet(m->tracks, index, &t));
+}
+
+Model modelRemoveTrack(Model m, int index) {
+  return withTracks(m, vectorRemove(m->tracks, index));
+}
+
+size_t modelBytes(Model m, Model previous) {
+  struct Accounting a = {0};
+  if (previous) {
+    accountModel(&a, previous);
+  }
+  a.counting = 1;
+  accountModel(&a, m);
+  free(a.seen);
+  return a.bytes;
+}
+
+uint64_t modelSave(ProjectWriter w, Model m) {
+  // the writer copies what it needs, these only live for the call
+  int trackCount = modelTrackCount(m), laneCount = 0, clipCount = 0;
+  for (int i = 0; i < trackCount; i++) {
+    laneCount += trackLaneCount(modelTrack(m, i));
+    clipCount += trackClipCount(modelTrack(m, i));
+  }
+  struct TrackState *tracks =
+      malloc((trackCount + 1) * sizeof(struct TrackState));
+  struct LaneState *lanes = malloc((laneCount + 1) * sizeof(struct LaneState));
+  struct ClipState *clips = malloc((clipCount + 1) * sizeof(struct ClipState));
+
+  struct LaneState *lane = lanes;
+  struct ClipState *clip = clips;
+  for (int i = 0; i < trackCount; i++) {
+    Track t = modelTrack(m, i);
+    tracks[i] = (struct TrackState){
+        .name = trackName(t),
+        .flags = t->flags,
+        .gain = t->gain,
+        .pan = t->pan,
+        .notes = t->notes,
+        .lanes = lane,
+        .laneCount = trackLaneCount(t),
+        .clips = clip,
+        .clipCount = trackClipCount(t),
+    };
+    for (int j = 0; j < tracks[i].laneCount; j++) {
+      *lane++ = trackLane(t, j);
+    }
+    for (int j = 0; j < tracks[i].clipCount; j++) {
+      *clip++ = trackClip(t, j);
+    }
+  }
+
+  uint64_t number = projectSave(
+      w, (struct ProjectState){m->sampleRate, tracks, trackCount});
+  free(tracks);
+  free(lanes);
+  free(clips);
+  return number;
+}
+
+Model modelLoad(Project p) {
+  Vector tracks = makeVector(&trackItems);
+  for (int i = 0; i < projectTrackCount(p); i++) {
+    const struct ProjectTrack *saved = projectTrack(p, i);
+    Track t = makeTrack(projectString(p, saved->name));
+    t->flags = saved->flags;
+    t->gain = saved->gain;
+    t->pan = saved->pan;
+    t->notes = projectLoadNotes(p, saved);
+
+    // built in place, nothing else holds the track yet
+    int count;
+    const struct ProjectClip *clips = projectClips(p, saved, &count);
+    for (int j = 0; j < count; j++) {
+      struct ClipState clip = ownClip((struct ClipState){
+          clips[j].start, clips[j].length, clips[j].offset,
+          projectString(p, clips[j].source), clips[j].flags});
+      Vector next = vectorPush(t->clips, &clip);
+      releaseClip(&clip);
+      vectorRelease(t->clips);
+      t->clips = next;
+    }
+    const struct ProjectLane *lanes = projectLanes(p, saved, &count);
+    for (int j = 0; j < count; j++) {
+      Automation curve = projectLoadCurve(p, lanes[j].curve);
+      if (curve) {
+        Track u = trackSetCurve(t, lanes[j].param, curve);
+        automationRelease(curve);
+        trackRelease(t);
+        t = u;
+      }
+    }
+
+    Vector next = vectorPush(tracks, &t);
+    trackRelease(t);
+    vectorRelease(tracks);
+    tracks = next;
+  }
+
+  Model m = withTracks(NULL, tracks);
+  m->sampleRate = projectSampleRate(p);
+  return m;
+}
+
+History makeHistory(Model initial, int depth) {
+  History h = malloc(sizeof(struct History));
+  h->depth = depth > 1 ? depth : 1;
+  h->versions = calloc(h->depth, sizeof(Model));
+  h->first = 0;
+  h->count = 1;
+  h->at = 0;
+  modelRetain(initial);
+  h->versions[0] = initial;
+  return h;
+}
+
+void freeHistory(History h) {
+  for (int i = 0; i < h->count; i++) {
+    modelRelease(h->versions[(h->first + i) % h->depth]);
+  }
+  free(h->versions);
+  free(h);
+}
+
+Model historyCurrent(History h) {
+  return h->versions[(h->first + h->at) % h->depth];
+}
+
+void historyCommit(History h, Model m) {
+  for (int i = h->at + 1; i < h->count; i++) {
+    modelRelease(h->versions[(h->first + i) % h->depth]);
+  }
+  h->count = h->at + 1;
+  if (h->count == h->depth) {
+    modelRelease(h->versions[h->first]);
+    h->first = (h->first + 1) % h->depth;
+    h->count--;
+  }
+  modelRetain(m);
+  h->versions[(h->first + h->count) % h->depth] = m;
+  h->at = h->count++;
+}
+
+int historyUndo(History h) {
+  if (h->at == 0) {
+    return 0;
+  }
+  h->at--;
+  return 1;
+}
+
+int historyRedo(History h) {
+  if (h->at + 1 == h->count) {
+    return 0;
+  }
+  h->at++;
+  return 1;
+}
+
+ModelLane makeModelLane(Model m) {
+  ModelLane l = calloc(1, sizeof(struct ModelLane));
+  l->models = makeLane(&modelItems, m, 1);
+  return l;
+}
+
+void freeModelLane(ModelLane l) {
+  freeLane(l->models);
+  free(l);
+}
+
+void modelLaneSet(ModelLane l, Model m) { laneSet(l->models, m); }
+
+void modelLaneCollect(ModelLane l) { laneCollect(l->models); }
+
+Model modelLaneDisplay(ModelLane l) { return laneDisplay(l->models); }
+
+Model modelLaneAudio(ModelLane l) {
+  void *replaced;
+  if (lanePickUp(l->models, &replaced)) {
+    laneRetire(l->models, replaced);
+  }
+  return laneCurrent(l->models);
+}
@@ -0,0 +1,132 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "project.h"
+#include "vector.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// the project as the ui edits it. a model is an immutable version of the
+// whole project: a persistent vector of tracks, each holding its clips and
+// lanes in persistent vectors of their own, its notes as a note track and
+// its automation as curves. an edit builds a new version that shares every
+// track, clip leaf, note track and curve it didn't touch with the old one, so
+// keeping a version for undo costs only what the edit changed, and a thread
+// holding a version reads it without locking.
+typedef struct Model *Model;
+typedef struct Track *Track;
+
+// TRACKS
+
+// unity gain, centred, no notes, clips or automation
+Track makeTrack(const char *name);
+
+// like every part of a model, tracks start with one reference and the last
+// release frees them
+void trackRetain(Track t);
+void trackRelease(Track t);
+
+const char *trackName(Track t);
+uint32_t trackFlags(Track t); // PROJECT_TRACK_*
+float trackGain(Track t);
+float trackPan(Track t);
+NoteTrack trackNotes(Track t); // NULL for none
+
+// clip sources are copied, the strings of a clip read back live as long as
+// the track does
+int trackClipCount(Track t);
+struct ClipState trackClip(Track t, int index);
+
+// lanes are kept in parameter order, at most one per parameter
+int trackLaneCount(Track t);
+struct LaneState trackLane(Track t, int index);
+Automation trackCurve(Track t, uint32_t param); // NULL if not automated
+
+// edits. each returns a new track with one reference and leaves `t` alone,
+// references are taken to the notes and curves passed in
+Track trackRename(Track t, const char *name);
+Track trackSetMix(Track t, uint32_t flags, float gain, float pan);
+Track trackSetNotes(Track t, NoteTrack notes);
+Track trackInsertClip(Track t, int index, struct ClipState clip);
+Track trackSetClip(Track t, int index, struct ClipState clip);
+Track trackRemoveClip(Track t, int index);
+Track trackSetCurve(Track t, uint32_t param, Automation curve); // NULL clears
+
+// MODELS
+
+// an empty project
+Model makeModel(int sampleRate);
+void modelRetain(Model m);
+void modelRelease(Model m);
+
+int modelSampleRate(Model m);
+int modelTrackCount(Model m);
+
+// real-time safe, valid while `m` is
+Track modelTrack(Model m, int index);
+
+// edits. each returns a new model with one reference and leaves `m` alone,
+// the model takes its own reference to `t`
+Model modelInsertTrack(Model m, int index, Track t);
+Model modelSetTrack(Model m, int index, Track t);
+Model modelRemoveTrack(Model m, int index);
+
+// the bytes `m` holds that `previous` doesn't share, everything it holds if
+// `previous` is NULL. what keeping `m` in the undo history costs
+size_t modelBytes(Model m, Model previous);
+
+// ui thread. hands the model to a project writer, see projectSave
+uint64_t modelSave(ProjectWriter w, Model m);
+
+// the model a project file holds. notes, clips and curves whose chunks are
+// damaged load empty
+Model modelLoad(Project p);
+
+// UNDO
+
+// the versions edits went through, up to a fixed depth. undo and redo only
+// move a cursor, the versions themselves never change
+typedef struct History *History;
+
+// takes its own reference to `initial`. the oldest versions are dropped once
+// there are more than `depth`
+History makeHistory(Model initial, int depth);
+void freeHistory(History h);
+
+// the version undo and redo are at, valid until the next call that changes
+// the history
+Model historyCurrent(History h);
+
+// takes its own reference to `m` and makes it current, the versions that
+// could have been redone are dropped
+void historyCommit(History h, Model m);
+
+// return 0 when there's nothing to undo or redo
+int historyUndo(History h);
+int historyRedo(History h);
+
+// SHARING
+
+// one model shared by the ui, the audio thread and the render thread, the
+// same way a note lane shares its track. each thread reads a whole version,
+// never half of an edit
+typedef struct ModelLane *ModelLane;
+
+// takes its own references to `m`
+ModelLane makeModelLane(Model m);
+void freeModelLane(ModelLane l);
+
+// ui thread. takes its own references, the caller keeps theirs
+void modelLaneSet(ModelLane l, Model m);
+
+// ui thread. frees versions the audio thread has let go of, call regularly
+void modelLaneCollect(ModelLane l);
+
+// render thread. the newest version, valid until the next call
+Model modelLaneDisplay(ModelLane l);
+
+// audio thread, real-time safe. the newest version, valid until the next
+// call. a version it lets go of is freed by modelLaneCollect
+Model modelLaneAudio(ModelLane l);
+
+#endif
@@ -0,0 +1,460 @@
+#define _GNU_SOURCE // SCHED_IDLE
+#include "overview.h"
+
+#include "die.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// frames decoded at a time within a step
+#define DECODE_FRAMES 4096
+
+// the level whose bins are a span, and the bins of a span on the levels up
+// to it: 256 + 64 + 16 + 4 + 1
+#define SPAN_LEVEL 4
+#define SPAN_BINS 341
+
+struct Overview {
+  AudioFile file; // closed once done
+  struct AudioFormat format;
+  int levelCount;
+  uint64_t *binCounts;
+  struct Peak **peaks; // per level, a channel's bins after another's
+  pthread_mutex_t lock; // the peaks
+
+  _Atomic unsigned version;
+  atomic_int readyLevel;
+  atomic_int done;
+
+  // under the overviews' lock
+  uint64_t order; // when it was added
+  int visible;
+  int busy;      // a worker is reading a span of it
+  int cancelled; // removed while busy, the worker frees it
+  int pass;
+  uint64_t spanCount;
+  uint64_t firstStride;
+  uint64_t stride; // between the spans of this pass, 0 once done
+  uint64_t span;   // the next one to read
+};
+
+struct Worker {
+  pthread_t thread;
+  Overviews overviews;
+  float *decode;
+  int capacity; // samples
+};
+
+struct Overviews {
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t idle;
+  int running;
+
+  Overview *jobs;
+  int count, capacity;
+  uint64_t added;
+
+  struct Worker *workers;
+  int workerCount;
+};
+
+// PRIVATE FUNCTIONS
+
+static void freeOverview(Overview v) {
+  if (v->file) {
+    closeAudioFile(v->file);
+  }
+  for (int l = 0; l < v->levelCount; l++) {
+    free(v->peaks[l]);
+  }
+  free(v->peaks);
+  free(v->binCounts);
+  pthread_mutex_destroy(&v->lock);
+  free(v);
+}
+
+static void detach(Overviews o, Overview v) {
+  for (int i = 0; i < o->count; i++) {
+    if (o->jobs[i] == v) {
+      o->jobs[i] = o->jobs[--o->count];
+      return;
+    }
+  }
+}
+
+// visible first, then the one with the fewest passes behind it, then the
+// oldest
+static Overview pick(Overviews o) {
+  Overview best = NULL;
+  for (int i = 0; i < o->count; i++) {
+    Overview v = o->jobs[i];
+    if (v->busy || !v->stride) {
+      continue;
+    }
+    if (!best || v->visible > best->visible ||
+        (v->visible == best->visible &&
+         (v->pass < best->pass ||
+          (v->pass == best->pass && v->order < best->order)))) {
+      best = v;
+    }
+  }
+  return best;
+}
+
+static void finishPass(Overview v) {
+  int level = SPAN_LEVEL;
+  for (uint64_t s = v->stride; s > 1; s /= OVERVIEW_FANOUT) {
+    level++;
+  }
+  if (v->stride == 1) {
+    level = 0;
+  } else if (level > v->levelCount - 1) {
+    level = v->levelCount - 1;
+  }
+  atomic_store(&v->readyLevel, level);
+  v->pass++;
+  v->stride /= OVERVIEW_FANOUT;
+  v->span = v->stride;
+}
+
+// on to the next span to read. the first pass reads every stride-th, later
+// ones the spans between those read already
+static void advance(Overview v) {
+  do {
+    v->span += v->stride;
+    if (v->span >= v->spanCount) {
+      finishPass(v);
+      if (!v->stride) {
+        return;
+      }
+    }
+  } while (v->stride != v->firstStride &&
+           v->span % (v->stride * OVERVIEW_FANOUT) == 0);
+}
+
+static void merge(struct Peak *into, struct Peak p) {
+  into->min = p.min < into->min ? p.min : into->min;
+  into->max = p.max > into->max ? p.max : into->max;
+}
+
+// the span's bins up to SPAN_LEVEL, a channel's after another's
+static void analyse(struct Worker *w, Overview v, uint64_t span,
+                    struct Peak *bins) {
+  int channels = v->format.channels;
+  uint64_t start = span * OVERVIEW_SPAN;
+  uint64_t end = start + OVERVIEW_SPAN;
+  end = end < v->format.frames ? end : v->format.frames;
+  for (int i = 0; i < channels * SPAN_BINS; i++) {
+    bins[i] = (struct Peak){INFINITY, -INFINITY};
+  }
+
+  if (w->capacity < DECODE_FRAMES * channels) {
+    w->capacity = DECODE_FRAMES * channels;
+    w->decode = realloc(w->decode, w->capacity * sizeof(float));
+    if (!w->decode) {
+      die("Failed to allocate overview decode buffer\n");
+    }
+  }
+
+  // level 0, a chunk is a whole number of bins
+  for (uint64_t frame = start; frame < end;) {
+    int want = end - frame < DECODE_FRAMES ? end - frame : DECODE_FRAMES;
+    int n = readAudioFile(v->file, frame, w->decode, want);
+    if (n <= 0) {
+      break;
+    }
+    for (int ch = 0; ch < channels; ch++) {
+      struct Peak *level0 = bins + ch * SPAN_BINS;
+      for (int i = 0; i < n; i += OVERVIEW_BIN) {
+        int last = i + OVERVIEW_BIN < n ? i + OVERVIEW_BIN : n;
+        struct Peak p = {INFINITY, -INFINITY};
+        for (int f = i; f < last; f++) {
+          float x = w->decode[f * channels + ch];
+          p.min = x < p.min ? x : p.min;
+          p.max = x > p.max ? x : p.max;
+        }
+        level0[(frame - start + i) / OVERVIEW_BIN] = p;
+      }
+    }
+    frame += n;
+  }
+
+  // and up
+  for (int ch = 0; ch < channels; ch++) {
+    struct Peak *below = bins + ch * SPAN_BINS;
+    int count = OVERVIEW_SPAN / OVERVIEW_BIN;
+    for (int l = 1; l <= SPAN_LEVEL; l++) {
+      struct Peak *level = below + count;
+      count /= OVERVIEW_FANOUT;
+      for (int b = 0; b < count * OVERVIEW_FANOUT; b++) {
+        merge(&level[b / OVERVIEW_FANOUT], below[b]);
+      }
+      below = level;
+    }
+  }
+}
+
+// the levels inside the span are replaced, the ones above merged into
+static void publish(Overview v, uint64_t span, const struct Peak *bins) {
+  pthread_mutex_lock(&v->lock);
+  for (int ch = 0; ch < v->format.channels; ch++) {
+    const struct Peak *level = bins + ch * SPAN_BINS;
+    uint64_t count = OVERVIEW_SPAN / OVERVIEW_BIN;
+    uint64_t spans = 1; // a bin of the level covers
+    for (int l = 0; l < v->levelCount; l++) {
+      struct Peak *to = v->peaks[l] + ch * v->binCounts[l];
+      if (l <= SPAN_LEVEL) {
+        uint64_t first = span * count;
+        uint64_t n = v->binCounts[l] - first < count ? v->binCounts[l] - first
+                                                     : count;
+        memcpy(to + first, level, n * sizeof(struct Peak));
+        level += count;
+        count /= OVERVIEW_FANOUT;
+      } else {
+        spans *= OVERVIEW_FANOUT;
+        merge(&to[span / spans], bins[ch * SPAN_BINS + SPAN_BINS - 1]);
+      }
+    }
+  }
+  atomic_fetch_add(&v->version, 1);
+  pthread_mutex_unlock(&v->lock);
+}
+
+static void demoteToBackground(void) {
+  // best effort, the jobs only get the cores nothing else wants
+#if defined(SCHED_IDLE)
+  struct sched_param param = {0};
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#elif defined(__APPLE__)
+  pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#endif
+}
+
+static void *workerMain(void *arg) {
+  struct Worker *w = arg;
+  Overviews o = w->overviews;
+  demoteToBackground();
+  struct Peak *bins = NULL;
+  int binCapacity = 0;
+
+  pthread_mutex_lock(&o->lock);
+  while (o->running) {
+    Overview v = pick(o);
+    if (!v) {
+      pthread_cond_wait(&o->work, &o->lock);
+      continue;
+    }
+    v->busy = 1;
+    uint64_t span = v->span;
+    pthread_mutex_unlock(&o->lock);
+
+    if (binCapacity < v->format.channels * SPAN_BINS) {
+      binCapacity = v->format.channels * SPAN_BINS;
+      bins = realloc(bins, binCapacity * sizeof(struct Peak));
+      if (!bins) {
+        die("Failed to allocate overview bins\n");
+      }
+    }
+    analyse(w, v, span, bins);
+    publish(v, span, bins);
+
+    pthread_mutex_lock(&o->lock);
+    v->busy = 0;
+    if (v->cancelled) {
+      freeOverview(v);
+      continue;
+    }
+    advance(v);
+    if (!v->stride) {
+      closeAudioFile(v->file);
+      v->file = NULL;
+      atomic_store(&v->done, 1);
+      pthread_cond_broadcast(&o->idle);
+    }
+  }
+  pthread_mutex_unlock(&o->lock);
+  free(bins);
+  return NULL;
+}
+
+// PUBLIC FUNCTIONS
+
+Overviews makeOverviews(int workers) {
+  if (workers < 1) {
+    workers = 1;
+  }
+  Overviews o = calloc(1, sizeof(struct Overviews));
+  pthread_mutex_init(&o->lock, NULL);
+  pthread_cond_init(&o->work, NULL);
+  pthread_cond_init(&o->idle, NULL);
+  o->running = 1;
+  o->workerCount = workers;
+  o->workers = calloc(workers, sizeof(struct Worker));
+  for (int i = 0; i < workers; i++) {
+    o->workers[i].overviews = o;
+    if (pthread_create(&o->workers[i].thread, NULL, workerMain,
+                       &o->workers[i]) != 0) {
+      die("Failed to start overview worker %d\n", i);
+    }
+  }
+  return o;
+}
+
+void freeOverviews(Overviews o) {
+  pthread_mutex_lock(&o->lock);
+  o->running = 0;
+  pthread_cond_broadcast(&o->work);
+  pthread_mutex_unlock(&o->lock);
+  for (int i = 0; i < o->workerCount; i++) {
+    pthread_join(o->workers[i].thread, NULL);
+    free(o->workers[i].decode);
+  }
+  for (int i = 0; i < o->count; i++) {
+    freeOverview(o->jobs[i]);
+  }
+  free(o->jobs);
+  free(o->workers);
+  pthread_cond_destroy(&o->idle);
+  pthread_cond_destroy(&o->work);
+  pthread_mutex_destroy(&o->lock);
+  free(o);
+}
+
+Overview overviewsAdd(Overviews o, const char *path) {
+  AudioFile f = openAudioFile(path);
+  if (!f) {
+    return NULL;
+  }
+  Overview v = calloc(1, sizeof(struct Overview));
+  v->file = f;
+  v->format = audioFileFormat(f);
+  pthread_mutex_init(&v->lock, NULL);
+
+  // levels up to a single bin
+  v->levelCount = 1;
+  while (overviewBinFrames(v->levelCount - 1) < v->format.frames) {
+    v->levelCount++;
+  }
+  v->binCounts = malloc(v->levelCount * sizeof(uint64_t));
+  v->peaks = malloc(v->levelCount * sizeof(struct Peak *));
+  for (int l = 0; l < v->levelCount; l++) {
+    uint64_t frames = overviewBinFrames(l);
+    v->binCounts[l] = (v->format.frames + frames - 1) / frames;
+    uint64_t n = v->binCounts[l] * v->format.channels;
+    v->peaks[l] = malloc((n ? n : 1) * sizeof(struct Peak));
+    for (uint64_t b = 0; b < n; b++) {
+      v->peaks[l][b] = (struct Peak){INFINITY, -INFINITY};
+    }
+  }
+
+  atomic_init(&v->version, 0);
+  atomic_init(&v->readyLevel, v->levelCount);
+  atomic_init(&v->done, 0);
+  v->spanCount = (v->format.frames + OVERVIEW_SPAN - 1) / OVERVIEW_SPAN;
+  v->firstStride = 1;
+  while (v->firstStride * OVERVIEW_FANOUT < v->spanCount) {
+    v->firstStride *= OVERVIEW_FANOUT;
+  }
+  v->stride = v->firstStride;
+  if (v->spanCount == 0) {
+    // nothing to read
+    closeAudioFile(v->file);
+    v->file = NULL;
+    v->stride = 0;
+    atomic_store(&v->readyLevel, 0);
+    atomic_store(&v->done, 1);
+  }
+
+  pthread_mutex_lock(&o->lock);
+  v->order = o->added++;
+  if (o->count == o->capacity) {
+    o->capacity = o->capacity ? 2 * o->capacity : 16;
+    o->jobs = realloc(o->jobs, o->capacity * sizeof(Overview));
+  }
+  o->jobs[o->count++] = v;
+  pthread_cond_signal(&o->work);
+  pthread_mutex_unlock(&o->lock);
+  return v;
+}
+
+void overviewsRemove(Overviews o, Overview v) {
+  pthread_mutex_lock(&o->lock);
+  detach(o, v);
+  if (v->busy) {
+    v->cancelled = 1;
+  } else {
+    freeOverview(v);
+  }
+  pthread_cond_broadcast(&o->idle);
+  pthread_mutex_unlock(&o->lock);
+}
+
+void overviewsSetVisible(Overviews o, Overview v, int visible) {
+  pthread_mutex_lock(&o->lock);
+  v->visible = visible;
+  pthread_mutex_unlock(&o->lock);
+}
+
+void overviewsWait(Overviews o) {
+  pthread_mutex_lock(&o->lock);
+  for (int i = 0; i < o->count;) {
+    if (!atomic_load(&o->jobs[i]->done)) {
+      pthread_cond_wait(&o->idle, &o->lock);
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  pthread_mutex_unlock(&o->lock);
+}
+
+struct AudioFormat overviewFormat(Overview v) { return v->format; }
+
+int overviewLevelCount(Overview v) { return v->levelCount; }
+
+uint64_t overviewBinCount(Overview v, int level) {
+  return v->binCounts[level];
+}
+
+uint64_t overviewBinFrames(int level) {
+  uint64_t frames = OVERVIEW_BIN;
+  for (int l = 0; l < level; l++) {
+    frames *= OVERVIEW_FANOUT;
+  }
+  return frames;
+}
+
+int overviewReadyLevel(Overview v) { return atomic_load(&v->readyLevel); }
+
+int overviewDone(Overview v) { return atomic_load(&v->done); }
+
+unsigned overviewVersion(Overview v) { return atomic_load(&v->version); }
+
+int overviewPickLevel(Overview v, double framesPerPixel) {
+  int level = 0;
+  while (level + 1 < v->levelCount &&
+         overviewBinFrames(level + 1) <= framesPerPixel) {
+    level++;
+  }
+  int ready = overviewReadyLevel(v);
+  ready = ready < v->levelCount ? ready : v->levelCount - 1;
+  return level > ready ? level : ready;
+}
+
+int overviewRead(Overview v, int level, int channel, uint64_t first,
+                 int count, struct Peak *out) {
+  uint64_t bins = v->binCounts[level];
+  if (first >= bins) {
+    return 0;
+  }
+  int n = bins - first < (uint64_t)count ? (int)(bins - first) : count;
+  pthread_mutex_lock(&v->lock);
+  memcpy(out, v->peaks[level] + channel * bins + first,
+         n * sizeof(struct Peak));
+  pthread_mutex_unlock(&v->lock);
+  return n;
+}
@@ -0,0 +1,73 @@
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include "audiofile.h"
+#include <stdint.h>
+
+// waveform overviews of imported audio, worked out in the background so an
+// import never waits on analysis. an overview is a pyramid of peaks: the
+// finest level has a bin per OVERVIEW_BIN frames, every level above merges
+// OVERVIEW_FANOUT bins of the one below, up to a single bin for the file.
+//
+// a file is read a span at a time on low priority worker threads, one job per
+// file, several files at once. the spans go in passes, every 4^k-th span
+// first, then those in between, so the coarse levels can be drawn early from
+// part of the file and sharpen as the rest comes in. visible files are worked
+// on first, and among the rest the ones with the least to show.
+typedef struct Overviews *Overviews;
+typedef struct Overview *Overview;
+
+#define OVERVIEW_BIN 256
+#define OVERVIEW_FANOUT 4
+
+// frames a job reads in one step, a bin of level 4
+#define OVERVIEW_SPAN (OVERVIEW_BIN * 256)
+
+// a bin no part of the file has been read for yet has min > max
+struct Peak {
+  float min, max;
+};
+
+Overviews makeOverviews(int workers);
+// cancels whatever's left
+void freeOverviews(Overviews o);
+
+// ui thread. queues the file, NULL if it can't be opened
+Overview overviewsAdd(Overviews o, const char *path);
+
+// ui thread. cancels the job and frees the overview. a worker in the middle
+// of a step for it finishes the step, then frees it
+void overviewsRemove(Overviews o, Overview v);
+
+// ui thread. visible overviews go ahead of the rest, for clips in the
+// viewport
+void overviewsSetVisible(Overviews o, Overview v, int visible);
+
+// ui thread. blocks until every job is done
+void overviewsWait(Overviews o);
+
+// any thread, until the overview is removed
+
+struct AudioFormat overviewFormat(Overview v);
+int overviewLevelCount(Overview v);
+uint64_t overviewBinCount(Overview v, int level);
+uint64_t overviewBinFrames(int level);
+
+// the finest level every bin of which has seen some of the file, the level
+// count before that. levels from there up are approximate until done, the
+// ones below only have the spans read so far
+int overviewReadyLevel(Overview v);
+int overviewDone(Overview v);
+
+// bumped whenever bins change, so the ui knows when to draw again
+unsigned overviewVersion(Overview v);
+
+// the level to draw at `framesPerPixel`: the coarsest with no more than a
+// bin a pixel, or the ready level if that's coarser
+int overviewPickLevel(Overview v, double framesPerPixel);
+
+// copies bins from `first` of one channel, returns how many there were
+int overviewRead(Overview v, int level, int channel, uint64_t first,
+                 int count, struct Peak *out);
+
+#endif
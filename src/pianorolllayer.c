@@ -0,0 +1,255 @@
+#include "pianorolllayer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// notes a buffer holds at least, it grows from there
+#define MIN_CAPACITY 1024
+
+// draws a view takes at most, the visible notes are merged past that
+#define MAX_RUNS 16
+
+// bytes a note takes across its columns
+#define NOTE_BYTES                                                             \
+  (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(uint8_t))
+
+// matches the push constant block in assets/pianoroll.vert
+struct PianoRollPushConstants {
+  float rect[4];
+  struct Vec2 size;
+  uint32_t start[2];
+  float span;
+  float pitches[2];
+};
+
+// a unit quad, scaled to each note by the shader
+static struct Vertex corners[6] = {
+    {{0, 0}}, {{1, 0}}, {{1, 1}}, {{1, 1}}, {{0, 1}}, {{0, 0}},
+};
+
+struct PianoRollLayer {
+  NoteLane lane;
+  const struct TimelineView *view;
+  float rect[4];
+  float pitches[2];
+
+  // what this frame shows
+  NoteTrack track;
+  uint64_t version;
+
+  // per frame in flight: a mapped buffer of every note, column after
+  // column, how many notes it has room for and which version it holds
+  int framesInFlight;
+  struct VertexBufferAndMemory *buffers;
+  uint8_t **mapped;
+  int *capacities;
+  uint64_t *uploaded;
+  struct VertexBufferAndMemory quad;
+
+  // vulkan
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
+
+// PRIVATE FUNCTIONS
+
+// struct Vertex per vertex, then one binding per note column
+static struct VertexInput noteInput(void) {
+  static const VkVertexInputBindingDescription bindings[] = {
+      {0, sizeof(struct Vertex), VK_VERTEX_INPUT_RATE_VERTEX},
+      {1, sizeof(uint64_t), VK_VERTEX_INPUT_RATE_INSTANCE},
+      {2, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE},
+      {3, sizeof(uint8_t), VK_VERTEX_INPUT_RATE_INSTANCE},
+      {4, sizeof(uint8_t), VK_VERTEX_INPUT_RATE_INSTANCE},
+  };
+  static const VkVertexInputAttributeDescription attributes[] = {
+      {0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+      {1, 1, VK_FORMAT_R32G32_UINT, 0},
+      {2, 2, VK_FORMAT_R32_UINT, 0},
+      {3, 3, VK_FORMAT_R8_UINT, 0},
+      {4, 4, VK_FORMAT_R8_UINT, 0},
+  };
+  return (struct VertexInput){bindings, 5, attributes, 5};
+}
+
+// byte offsets of the columns in a buffer for `capacity` notes
+static VkDeviceSize columnOffset(int capacity, int column) {
+  static const size_t widths[] = {sizeof(uint64_t), sizeof(uint32_t),
+                                  sizeof(uint8_t), sizeof(uint8_t)};
+  VkDeviceSize offset = 0;
+  for (int c = 0; c < column; c++) {
+    offset += (VkDeviceSize)capacity * widths[c];
+  }
+  return offset;
+}
+
+static void freeBuffer(struct PianoRollLayer *l, int frame) {
+  vkUnmapMemory(l->device, l->buffers[frame].memory);
+  vkDestroyBuffer(l->device, l->buffers[frame].buffer, NULL);
+  vkFreeMemory(l->device, l->buffers[frame].memory, NULL);
+}
+
+static void allocateBuffer(struct PianoRollLayer *l, int frame, int capacity) {
+  VkDeviceSize size = (VkDeviceSize)capacity * NOTE_BYTES;
+  l->buffers[frame] = makeVkHostBuffer(l->physicalDevice, l->device, size,
+                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  vkMapMemory(l->device, l->buffers[frame].memory, 0, size, 0,
+              (void **)&l->mapped[frame]);
+  l->capacities[frame] = capacity;
+}
+
+// the whole track, column by column. this slot's last frame is done on the
+// gpu, so a buffer that's too small can be replaced right away
+static void upload(struct PianoRollLayer *l, int frame) {
+  int count = noteTrackCount(l->track);
+  if (count > l->capacities[frame]) {
+    int capacity = l->capacities[frame];
+    while (capacity < count) {
+      capacity *= 2;
+    }
+    freeBuffer(l, frame);
+    allocateBuffer(l, frame, capacity);
+  }
+
+  struct NoteColumns notes = noteTrackColumns(l->track);
+  int capacity = l->capacities[frame];
+  uint8_t *mapped = l->mapped[frame];
+  memcpy(mapped + columnOffset(capacity, 0), notes.starts,
+         count * sizeof(uint64_t));
+  memcpy(mapped + columnOffset(capacity, 1), notes.lengths,
+         count * sizeof(uint32_t));
+  memcpy(mapped + columnOffset(capacity, 2), notes.pitches, count);
+  memcpy(mapped + columnOffset(capacity, 3), notes.velocities, count);
+}
+
+static void prepare(void *state, int frame, double time) {
+  (void)time;
+  struct PianoRollLayer *l = state;
+
+  NoteTrack track = noteLaneDisplay(l->lane);
+  if (track != l->track) {
+    l->track = track;
+    l->version++;
+  }
+  if (l->uploaded[frame] != l->version) {
+    upload(l, frame);
+    l->uploaded[frame] = l->version;
+  }
+}
+
+static void record(void *state, VkCommandBuffer commandBuffer, int frame,
+                   double time, struct Vec2 size) {
+  (void)time;
+  struct PianoRollLayer *l = state;
+
+  uint64_t start = atomic_load_explicit(&l->view->start, memory_order_relaxed);
+  uint64_t end = atomic_load_explicit(&l->view->end, memory_order_relaxed);
+  end = end > start ? end : start + 1;
+  struct NoteRange runs[MAX_RUNS];
+  int count = noteTrackVisible(l->track, start, end, runs, MAX_RUNS);
+  if (count == 0) {
+    return;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    l->pipeline);
+
+  VkBuffer notes = l->buffers[frame].buffer;
+  int capacity = l->capacities[frame];
+  VkBuffer buffers[] = {l->quad.buffer, notes, notes, notes, notes};
+  VkDeviceSize offsets[] = {
+      0,
+      columnOffset(capacity, 0),
+      columnOffset(capacity, 1),
+      columnOffset(capacity, 2),
+      columnOffset(capacity, 3),
+  };
+  vkCmdBindVertexBuffers(commandBuffer, 0, 5, buffers, offsets);
+
+  struct PianoRollPushConstants pushConstants = {
+      .size = size,
+      .start = {(uint32_t)start, (uint32_t)(start >> 32)},
+      .span = (float)(end - start),
+      .pitches = {l->pitches[0], l->pitches[1]},
+  };
+  memcpy(pushConstants.rect, l->rect, sizeof(l->rect));
+  vkCmdPushConstants(commandBuffer, l->pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(struct PianoRollPushConstants), &pushConstants);
+  for (int r = 0; r < count; r++) {
+    vkCmdDraw(commandBuffer, 6, runs[r].count, 0, runs[r].first);
+  }
+}
+
+static void destroy(void *state) {
+  struct PianoRollLayer *l = state;
+
+  for (int f = 0; f < l->framesInFlight; f++) {
+    freeBuffer(l, f);
+  }
+  free(l->buffers);
+  free(l->mapped);
+  free(l->capacities);
+  free(l->uploaded);
+  vkDestroyBuffer(l->device, l->quad.buffer, NULL);
+  vkFreeMemory(l->device, l->quad.memory, NULL);
+
+  vkDestroyPipeline(l->device, l->pipeline, NULL);
+  vkDestroyPipelineLayout(l->device, l->pipelineLayout, NULL);
+  vkDestroyShaderModule(l->device, l->fragShader, NULL);
+  vkDestroyShaderModule(l->device, l->vertShader, NULL);
+
+  free(l);
+}
+
+// PUBLIC FUNCTIONS
+
+struct Layer makePianoRollLayer(struct RenderContext ctx, NoteLane lane,
+                                const struct TimelineView *view, int low,
+                                int high, float x, float y, float width,
+                                float height) {
+  struct PianoRollLayer *l = calloc(1, sizeof(struct PianoRollLayer));
+  l->lane = lane;
+  l->view = view;
+  l->rect[0] = x;
+  l->rect[1] = y;
+  l->rect[2] = width;
+  l->rect[3] = height;
+  l->pitches[0] = (float)low;
+  l->pitches[1] = (float)high;
+  l->physicalDevice = ctx.physicalDevice;
+  l->device = ctx.device;
+  l->framesInFlight = ctx.framesInFlight;
+
+  // note buffers, mapped for good, and the shared quad
+  l->buffers = malloc(l->framesInFlight * sizeof(struct VertexBufferAndMemory));
+  l->mapped = malloc(l->framesInFlight * sizeof(uint8_t *));
+  l->capacities = calloc(l->framesInFlight, sizeof(int));
+  l->uploaded = calloc(l->framesInFlight, sizeof(uint64_t));
+  for (int f = 0; f < l->framesInFlight; f++) {
+    allocateBuffer(l, f, MIN_CAPACITY);
+  }
+  l->quad = makeVkVertexBuffer(ctx.physicalDevice, ctx.device, corners, 6);
+
+  // pipeline
+  l->vertShader = makeVkShaderModule(ctx.device, "bin/pianoroll-vert.spv");
+  l->fragShader = makeVkShaderModule(ctx.device, "bin/pianoroll-frag.spv");
+  l->pipelineLayout = makeVkPushConstantLayout(
+      ctx.device, sizeof(struct PianoRollPushConstants),
+      VK_SHADER_STAGE_VERTEX_BIT);
+  l->pipeline = makeVkPipelineWithInput(
+      ctx.device, ctx.swapchainSettings, l->vertShader, l->fragShader,
+      ctx.renderPass, l->pipelineLayout, noteInput());
+
+  return (struct Layer){
+      .state = l,
+      .prepare = prepare,
+      .record = record,
+      .destroy = destroy,
+  };
+}
@@ -0,0 +1,18 @@
+#ifndef PIANOROLLLAYER_H
+#define PIANOROLLLAYER_H
+
+#include "midi.h"
+#include "renderer.h"
+
+// draws the lane's newest track as a piano roll inside the given rectangle
+// (window coordinates). `view` picks the stretch of the timeline, `low` and
+// `high` the pitches at the bottom and top. every note is one instance of a
+// quad made of struct Vertex corners, a draw for each run of notes sounding
+// in the view (see noteTrackVisible). a track is uploaded once per version,
+// scrolling only changes which instances are drawn.
+struct Layer makePianoRollLayer(struct RenderContext ctx, NoteLane lane,
+                                const struct TimelineView *view, int low,
+                                int high, float x, float y, float width,
+                                float height);
+
+#endif
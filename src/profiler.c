@@ -0,0 +1,387 @@
+#define _POSIX_C_SOURCE 200809L
+#include "profiler.h"
+
+#include "histogram.h"
+#include "spsc.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// blocks of the largest graph the ring holds, about a second and a half of
+// 256 frame blocks at 48 kHz
+#define RING_BLOCKS 256
+
+// two windows, the current one and the one before it. the current one is
+// cleared as it takes over
+struct Histogram {
+  uint32_t counts[2][HISTOGRAM_BUCKETS];
+  uint32_t max[2];
+  uint64_t total[2];
+};
+
+// a stretch of records of `size` bytes, a block then its node samples, in a
+// ring of `capacity` starting at `first`
+struct Records {
+  uint8_t *base;
+  size_t size;
+  int first, count, capacity;
+};
+
+struct XrunReport {
+  struct ProfileXrun xrun;
+  uint8_t *records;
+  int count;
+};
+
+struct Profiler {
+  int maxNodes;
+  size_t recordSize;
+
+  // audio thread -> reading side, records packed back to back
+  Spsc ring;
+  uint8_t *scratch; // audio thread
+  _Atomic uint64_t dropped;
+
+  // reading side
+  uint8_t *history;
+  int historyCapacity, historyHead, historyCount;
+  struct Histogram block;
+  struct Histogram *nodes;
+  int window; // current one of the two
+  uint64_t windowStart;
+  int started;
+  struct XrunReport reports[PROFILER_XRUNS];
+  int xrunHead, xrunCount;
+  uint64_t xrunTotal;
+  char **names;
+};
+
+// PRIVATE FUNCTIONS
+
+static void histogramAdd(struct Histogram *h, int window, uint32_t nanos) {
+  h->counts[window][histogramBucket(nanos)]++;
+  h->total[window]++;
+  if (nanos > h->max[window]) {
+    h->max[window] = nanos;
+  }
+}
+
+static void histogramClear(struct Histogram *h, int window) {
+  memset(h->counts[window], 0, sizeof(h->counts[window]));
+  h->max[window] = 0;
+  h->total[window] = 0;
+}
+
+static struct ProfileStats stats(const struct Histogram *h) {
+  uint64_t count = h->total[0] + h->total[1];
+  if (count == 0) {
+    return (struct ProfileStats){0};
+  }
+  uint32_t max = h->max[0] > h->max[1] ? h->max[0] : h->max[1];
+  return (struct ProfileStats){
+      .count = count,
+      .p50 = histogramPercentile(h->counts[0], 2, count, max, 0.5),
+      .p99 = histogramPercentile(h->counts[0], 2, count, max, 0.99),
+      .max = max,
+  };
+}
+
+static uint8_t *recordAt(const struct Records *r, int index) {
+  return r->base + (size_t)((r->first + index) % r->capacity) * r->size;
+}
+
+static struct Records historyRecords(Profiler p) {
+  int first = (p->historyHead - p->historyCount + p->historyCapacity) %
+              p->historyCapacity;
+  return (struct Records){p->history, p->recordSize, first, p->historyCount,
+                          p->historyCapacity};
+}
+
+static void rotate(Profiler p, uint64_t now) {
+  if (!p->started) {
+    p->started = 1;
+    p->windowStart = now;
+  }
+  if (now - p->windowStart < PROFILER_WINDOW_NANOS) {
+    return;
+  }
+  p->window ^= 1;
+  p->windowStart = now;
+  histogramClear(&p->block, p->window);
+  for (int i = 0; i < p->maxNodes; i++) {
+    histogramClear(&p->nodes[i], p->window);
+  }
+}
+
+// keeps the history as it stands, the late block last, along with the node
+// that went furthest over its usual time
+static void reportXrun(Profiler p, const struct ProfileBlock *b) {
+  const struct NodeSample *samples = (const struct NodeSample *)(b + 1);
+  struct ProfileXrun xrun = {*b, -1, 0, 0};
+  int64_t worst = INT64_MIN;
+  for (int i = 0; i < b->nodeCount; i++) {
+    uint32_t median = stats(&p->nodes[i]).p50;
+    int64_t excess = (int64_t)samples[i].nanos - median;
+    if (excess > worst) {
+      worst = excess;
+      xrun = (struct ProfileXrun){*b, i, samples[i].nanos, median};
+    }
+  }
+
+  struct XrunReport *r = &p->reports[p->xrunHead];
+  struct Records history = historyRecords(p);
+  for (int i = 0; i < history.count; i++) {
+    memcpy(r->records + (size_t)i * p->recordSize, recordAt(&history, i),
+           p->recordSize);
+  }
+  r->count = history.count;
+  r->xrun = xrun;
+  p->xrunHead = (p->xrunHead + 1) % PROFILER_XRUNS;
+  if (p->xrunCount < PROFILER_XRUNS) {
+    p->xrunCount++;
+  }
+  p->xrunTotal++;
+}
+
+static void writeEscaped(FILE *f, const char *s) {
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+}
+
+static void writeName(Profiler p, FILE *f, int node) {
+  if (node < p->maxNodes && p->names[node]) {
+    writeEscaped(f, p->names[node]);
+  } else {
+    fprintf(f, "node %d", node);
+  }
+}
+
+// blocks on one row, each worker's nodes on a row of its own, and a marker
+// where a late block's deadline passed. times are microseconds from the
+// first block
+static int writeRecords(Profiler p, const struct Records *r,
+                        const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return 0;
+  }
+
+  uint64_t origin =
+      r->count > 0 ? ((struct ProfileBlock *)recordAt(r, 0))->start : 0;
+  int workers = 0;
+  fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":0,"
+             "\"args\":{\"name\":\"blocks\"}}");
+  for (int i = 0; i < r->count; i++) {
+    const struct ProfileBlock *b = (struct ProfileBlock *)recordAt(r, i);
+    const struct NodeSample *samples = (const struct NodeSample *)(b + 1);
+    double at = (b->start - origin) / 1e3;
+    fprintf(f,
+            ",\n{\"ph\":\"X\",\"cat\":\"block\",\"name\":\"block\","
+            "\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+            "\"position\":%llu,\"frames\":%d,\"deadline_us\":%.3f,"
+            "\"load\":%.3f}}",
+            at, b->nanos / 1e3, (unsigned long long)b->position, b->frames,
+            b->deadline / 1e3,
+            b->deadline ? (double)b->nanos / b->deadline : 0.0);
+    if (b->nanos > b->deadline) {
+      fprintf(f,
+              ",\n{\"ph\":\"i\",\"s\":\"p\",\"name\":\"xrun\",\"pid\":1,"
+              "\"tid\":0,\"ts\":%.3f}",
+              at + b->deadline / 1e3);
+    }
+
+    for (int n = 0; n < b->nodeCount; n++) {
+      const struct NodeSample *s = &samples[n];
+      workers = s->worker + 1 > workers ? s->worker + 1 : workers;
+      fprintf(f, ",\n{\"ph\":\"X\",\"cat\":\"node\",\"name\":\"");
+      writeName(p, f, n);
+      fprintf(f,
+              "\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+              "\"args\":{\"node\":%d}}",
+              s->worker + 1, at + s->start / 1e3, s->nanos / 1e3, n);
+    }
+  }
+  for (int w = 0; w < workers; w++) {
+    fprintf(f,
+            ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+            w + 1, w);
+  }
+  fprintf(f, "\n]}\n");
+
+  int ok = !ferror(f);
+  return fclose(f) == 0 && ok;
+}
+
+// PUBLIC FUNCTIONS
+
+Profiler makeProfiler(int maxNodes, int history) {
+  Profiler p = calloc(1, sizeof(struct Profiler));
+  p->maxNodes = maxNodes > 0 ? maxNodes : 0;
+  history = history > 0 ? history : 1;
+
+  // whole records keep the block header aligned
+  size_t size = sizeof(struct ProfileBlock) +
+                (size_t)p->maxNodes * sizeof(struct NodeSample);
+  p->recordSize = (size + 7) & ~(size_t)7;
+
+  p->ring = makeSpsc(1, RING_BLOCKS * p->recordSize);
+  p->scratch = malloc(p->recordSize);
+  atomic_init(&p->dropped, 0);
+
+  p->history = malloc(history * p->recordSize);
+  p->historyCapacity = history;
+  p->nodes = calloc(p->maxNodes > 0 ? p->maxNodes : 1,
+                    sizeof(struct Histogram));
+  for (int i = 0; i < PROFILER_XRUNS; i++) {
+    p->reports[i].records = malloc(history * p->recordSize);
+  }
+  p->names = calloc(p->maxNodes > 0 ? p->maxNodes : 1, sizeof(char *));
+  return p;
+}
+
+void freeProfiler(Profiler p) {
+  for (int i = 0; i < p->maxNodes; i++) {
+    free(p->names[i]);
+  }
+  free(p->names);
+  for (int i = 0; i < PROFILER_XRUNS; i++) {
+    free(p->reports[i].records);
+  }
+  free(p->nodes);
+  free(p->history);
+  free(p->scratch);
+  freeSpsc(p->ring);
+  free(p);
+}
+
+void profilerRecord(Profiler p, CompiledGraph g, uint64_t start, uint64_t end,
+                    uint64_t position, int frames, int sampleRate) {
+  int n = g ? compiledNodeCount(g) : 0;
+  n = n < p->maxNodes ? n : p->maxNodes;
+  uint64_t nanos = end - start;
+  struct ProfileBlock *b = (struct ProfileBlock *)p->scratch;
+  *b = (struct ProfileBlock){
+      .start = start,
+      .position = position,
+      .nanos = nanos < UINT32_MAX ? (uint32_t)nanos : UINT32_MAX,
+      .deadline = (uint32_t)((uint64_t)frames * 1000000000 / sampleRate),
+      .frames = frames,
+      .nodeCount = n,
+  };
+
+  struct NodeSample *samples = (struct NodeSample *)(b + 1);
+  for (int i = 0; i < n; i++) {
+    struct NodeTiming t = compiledNodeTiming(g, i);
+    samples[i] = (struct NodeSample){
+        .start = t.start > start ? (uint32_t)(t.start - start) : 0,
+        .nanos = (uint32_t)t.nanos,
+        .worker = t.worker,
+    };
+  }
+
+  // all of it or nothing, the reading side takes whole records
+  size_t bytes = sizeof(struct ProfileBlock) + n * sizeof(struct NodeSample);
+  if (spscWritable(p->ring) < bytes) {
+    atomic_fetch_add_explicit(&p->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  spscWrite(p->ring, b, bytes);
+}
+
+void profilerCollect(Profiler p) {
+  while (spscReadable(p->ring) >= sizeof(struct ProfileBlock)) {
+    uint8_t *record = p->history + (size_t)p->historyHead * p->recordSize;
+    struct ProfileBlock *b = (struct ProfileBlock *)record;
+    spscRead(p->ring, b, sizeof(struct ProfileBlock));
+    struct NodeSample *samples = (struct NodeSample *)(b + 1);
+    spscRead(p->ring, samples, b->nodeCount * sizeof(struct NodeSample));
+
+    p->historyHead = (p->historyHead + 1) % p->historyCapacity;
+    if (p->historyCount < p->historyCapacity) {
+      p->historyCount++;
+    }
+
+    rotate(p, b->start);
+    if (b->nanos > b->deadline) {
+      reportXrun(p, b);
+    }
+    histogramAdd(&p->block, p->window, b->nanos);
+    for (int i = 0; i < b->nodeCount; i++) {
+      histogramAdd(&p->nodes[i], p->window, samples[i].nanos);
+    }
+  }
+}
+
+void profilerNameNodes(Profiler p, CompiledGraph g) {
+  int n = compiledNodeCount(g);
+  for (int i = 0; i < n && i < p->maxNodes; i++) {
+    const char *name = compiledNodeName(g, i);
+    free(p->names[i]);
+    p->names[i] = name ? strdup(name) : NULL;
+  }
+}
+
+uint64_t profilerDropped(Profiler p) {
+  return atomic_load_explicit(&p->dropped, memory_order_relaxed);
+}
+
+int profilerHistoryCount(Profiler p) { return p->historyCount; }
+
+struct ProfileBlock profilerHistoryBlock(Profiler p, int index) {
+  struct Records history = historyRecords(p);
+  return *(struct ProfileBlock *)recordAt(&history, index);
+}
+
+const struct NodeSample *profilerHistoryNodes(Profiler p, int index) {
+  struct Records history = historyRecords(p);
+  const struct ProfileBlock *b =
+      (const struct ProfileBlock *)recordAt(&history, index);
+  return (const struct NodeSample *)(b + 1);
+}
+
+struct ProfileStats profilerBlockStats(Profiler p) { return stats(&p->block); }
+
+struct ProfileStats profilerNodeStats(Profiler p, int node) {
+  if (node < 0 || node >= p->maxNodes) {
+    return (struct ProfileStats){0};
+  }
+  return stats(&p->nodes[node]);
+}
+
+uint64_t profilerXrunTotal(Profiler p) { return p->xrunTotal; }
+
+int profilerXrunCount(Profiler p) { return p->xrunCount; }
+
+struct ProfileXrun profilerXrun(Profiler p, int index) {
+  int slot = (p->xrunHead - p->xrunCount + index + PROFILER_XRUNS) %
+             PROFILER_XRUNS;
+  return p->reports[slot].xrun;
+}
+
+int profilerWriteTrace(Profiler p, const char *path) {
+  struct Records history = historyRecords(p);
+  return writeRecords(p, &history, path);
+}
+
+int profilerWriteXrunTrace(Profiler p, int xrun, const char *path) {
+  if (xrun < 0 || xrun >= p->xrunCount) {
+    return 0;
+  }
+  int slot = (p->xrunHead - p->xrunCount + xrun + PROFILER_XRUNS) %
+             PROFILER_XRUNS;
+  struct XrunReport *r = &p->reports[slot];
+  struct Records records = {r->records, p->recordSize, 0, r->count,
+                            r->count > 0 ? r->count : 1};
+  return writeRecords(p, &records, path);
+}
@@ -0,0 +1,95 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "graph.h"
+#include <stdint.h>
+
+// where the audio thread's time goes. after every block the engine records
+// how long the block took and when and where each node ran into a lock-free
+// ring. the reading side drains it into a short history of whole blocks,
+// rolling histograms of the block against its deadline and of every node, and
+// a copy of the history leading up to each missed deadline, so an xrun can be
+// pinned on the node that caused it after the fact. any of it can be written
+// out as chrome trace json, for chrome://tracing or perfetto.
+typedef struct Profiler *Profiler;
+
+// a node within a block
+struct NodeSample {
+  uint32_t start; // nanoseconds after the block began
+  uint32_t nanos;
+  int32_t worker;
+};
+
+struct ProfileBlock {
+  uint64_t start;    // clockNanos when the block began
+  uint64_t position; // transport, in samples
+  uint32_t nanos;    // the whole block
+  uint32_t deadline; // how long its frames last
+  int32_t frames;
+  int32_t nodeCount; // samples that follow, node ids are their indices
+};
+
+// what a rolling histogram says, in nanoseconds. the percentiles are good to
+// an eighth of an octave, the maximum is exact
+struct ProfileStats {
+  uint64_t count; // blocks in the window
+  uint32_t p50, p99, max;
+};
+
+// an xrun as the reading side saw it
+struct ProfileXrun {
+  struct ProfileBlock block; // the late one
+  int culprit;               // node furthest over its median, -1 for none
+  uint32_t culpritNanos;     // what it took in the late block
+  uint32_t culpritMedian;    // what it usually takes
+};
+
+// the statistics cover between one and two windows
+#define PROFILER_WINDOW_NANOS 2000000000ull
+
+// xrun reports kept, the oldest go first
+#define PROFILER_XRUNS 8
+
+// `maxNodes` bounds the graphs it records, nodes past it go unrecorded.
+// `history` is how many blocks are kept, and copied for each xrun
+Profiler makeProfiler(int maxNodes, int history);
+void freeProfiler(Profiler p);
+
+// audio thread, real-time safe. records a block that began at `start` and
+// ended at `end` (clockNanos) with the timings `g` holds for it. NULL for a
+// block without a graph. a block that doesn't fit in the ring is dropped
+void profilerRecord(Profiler p, CompiledGraph g, uint64_t start, uint64_t end,
+                    uint64_t position, int frames, int sampleRate);
+
+// READING SIDE, one thread at a time
+
+// drains the ring. call regularly, it holds a few hundred blocks
+void profilerCollect(Profiler p);
+
+// names the nodes in traces after those of `g`, copied. node ids are stable
+// across recompiles, so once per graph edit is enough
+void profilerNameNodes(Profiler p, CompiledGraph g);
+
+// blocks lost because the ring was full
+uint64_t profilerDropped(Profiler p);
+
+// the kept history, oldest first. nodes are valid until the next collect
+int profilerHistoryCount(Profiler p);
+struct ProfileBlock profilerHistoryBlock(Profiler p, int index);
+const struct NodeSample *profilerHistoryNodes(Profiler p, int index);
+
+struct ProfileStats profilerBlockStats(Profiler p);
+struct ProfileStats profilerNodeStats(Profiler p, int node);
+
+// every xrun collected so far, and the reports kept of the latest ones,
+// oldest first
+uint64_t profilerXrunTotal(Profiler p);
+int profilerXrunCount(Profiler p);
+struct ProfileXrun profilerXrun(Profiler p, int index);
+
+// write the history, or the history an xrun report kept, as chrome trace
+// json. return 0 if the file can't be written
+int profilerWriteTrace(Profiler p, const char *path);
+int profilerWriteXrunTrace(Profiler p, int xrun, const char *path);
+
+#endif
@@ -0,0 +1,258 @@
+#include "profilerlayer.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATTRIBUTE_COUNT 2
+
+// newest blocks shown, and rows of nodes
+#define BARS 128
+#define ROWS 12
+
+// share of the height the blocks take, the rows get the rest
+#define BLOCKS_SHARE 0.4f
+
+// between bars and rows, in window coordinates
+#define GAP 1.0f
+
+// the panel, the deadline line, the blocks and three bars a row
+#define MAX_INSTANCES (2 + BARS + 3 * ROWS)
+
+// blocks past twice their deadline are drawn at full height
+#define MAX_LOAD 2.0f
+
+struct ProfilerInstance {
+  float x, y, width, height; // window coordinates
+  float color[4];
+};
+
+struct ProfilerPushConstants {
+  struct Vec2 size;
+};
+
+struct ProfilerLayer {
+  Profiler profiler;
+  float rect[4];
+
+  // per frame in flight: a mapped instance buffer, rebuilt every frame, and
+  // how many instances it holds
+  int framesInFlight;
+  struct VertexBufferAndMemory *buffers;
+  struct ProfilerInstance **mapped;
+  int *counts;
+
+  // vulkan
+  VkDevice device;
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
+
+static const float panel[4] = {0.05f, 0.05f, 0.07f, 0.75f};
+static const float deadline[4] = {1.0f, 1.0f, 1.0f, 0.6f};
+static const float easy[4] = {0.2f, 0.75f, 0.3f, 1.0f};
+static const float tight[4] = {0.9f, 0.8f, 0.2f, 1.0f};
+static const float late[4] = {0.9f, 0.2f, 0.2f, 1.0f};
+
+// PRIVATE FUNCTIONS
+
+static struct VertexInput instanceInput(void) {
+  static VkVertexInputAttributeDescription attributes[ATTRIBUTE_COUNT];
+  attributes[0] = (VkVertexInputAttributeDescription){
+      0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+      offsetof(struct ProfilerInstance, x)};
+  attributes[1] = (VkVertexInputAttributeDescription){
+      1, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+      offsetof(struct ProfilerInstance, color)};
+
+  static VkVertexInputBindingDescription binding = {0};
+  binding.binding = 0;
+  binding.stride = sizeof(struct ProfilerInstance);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  return (struct VertexInput){&binding, 1, attributes, ATTRIBUTE_COUNT};
+}
+
+static void push(struct ProfilerInstance *out, int *count, float x, float y,
+                 float width, float height, const float color[4]) {
+  out[*count] = (struct ProfilerInstance){x, y, width, height, {0}};
+  memcpy(out[*count].color, color, sizeof(out[*count].color));
+  (*count)++;
+}
+
+// spread around the hue circle by the golden ratio, so neighbouring ids
+// never look alike
+static void nodeColor(int node, float alpha, float color[4]) {
+  float hue = node * 0.618034f;
+  hue = (hue - (int)hue) * 6;
+  int sector = (int)hue;
+  float f = hue - sector;
+  float v = 0.9f, p = v * 0.4f, q = v * (1 - 0.6f * f);
+  float t = v * (1 - 0.6f * (1 - f));
+  float rgb[6][3] = {{v, t, p}, {q, v, p}, {p, v, t},
+                     {p, q, v}, {t, p, v}, {v, p, q}};
+  memcpy(color, rgb[sector % 6], 3 * sizeof(float));
+  color[3] = alpha;
+}
+
+// the costliest nodes by p99, most first
+static int pickRows(Profiler p, int nodeCount, int *rows) {
+  uint32_t costs[ROWS];
+  int count = 0;
+  for (int n = 0; n < nodeCount; n++) {
+    uint32_t cost = profilerNodeStats(p, n).p99;
+    int at = count < ROWS ? count++ : ROWS;
+    while (at > 0 && costs[at - 1] < cost) {
+      if (at < ROWS) {
+        costs[at] = costs[at - 1];
+        rows[at] = rows[at - 1];
+      }
+      at--;
+    }
+    if (at < ROWS) {
+      costs[at] = cost;
+      rows[at] = n;
+    }
+  }
+  return count;
+}
+
+static int build(struct ProfilerLayer *l, struct ProfilerInstance *out) {
+  Profiler p = l->profiler;
+  float x = l->rect[0], y = l->rect[1];
+  float width = l->rect[2], height = l->rect[3];
+  float blocksHeight = height * BLOCKS_SHARE;
+  int count = 0;
+
+  push(out, &count, x, y, width, height, panel);
+
+  int history = profilerHistoryCount(p);
+  int shown = history < BARS ? history : BARS;
+  float bar = width / BARS;
+  for (int i = 0; i < shown; i++) {
+    struct ProfileBlock b = profilerHistoryBlock(p, history - shown + i);
+    float load = b.deadline ? (float)b.nanos / b.deadline : 0;
+    load = load < MAX_LOAD ? load : MAX_LOAD;
+    float h = blocksHeight * load / MAX_LOAD;
+    const float *color = load >= 1 ? late : load >= 0.7f ? tight : easy;
+    push(out, &count, x + (BARS - shown + i) * bar, y + blocksHeight - h,
+         bar > 2 * GAP ? bar - GAP : bar, h, color);
+  }
+  push(out, &count, x, y + blocksHeight * (1 - 1 / MAX_LOAD), width, GAP,
+       deadline);
+  if (history == 0) {
+    return count;
+  }
+
+  // rows on a scale of one deadline
+  struct ProfileBlock newest = profilerHistoryBlock(p, history - 1);
+  float scale = newest.deadline ? width / newest.deadline : 0;
+  int rows[ROWS];
+  int rowCount = pickRows(p, newest.nodeCount, rows);
+  float top = y + blocksHeight + 4 * GAP;
+  float row = (height - blocksHeight - 4 * GAP) / ROWS;
+  for (int r = 0; r < rowCount; r++) {
+    struct ProfileStats s = profilerNodeStats(p, rows[r]);
+    float values[3] = {s.max, s.p99, s.p50};
+    float alphas[3] = {0.3f, 0.6f, 1.0f};
+    for (int v = 0; v < 3; v++) {
+      float color[4];
+      nodeColor(rows[r], alphas[v], color);
+      float w = values[v] * scale;
+      push(out, &count, x, top + r * row, w < width ? w : width, row - GAP,
+           color);
+    }
+  }
+  return count;
+}
+
+static void prepare(void *state, int frame, double time) {
+  (void)time;
+  struct ProfilerLayer *l = state;
+  profilerCollect(l->profiler);
+  l->counts[frame] = build(l, l->mapped[frame]);
+}
+
+static void record(void *state, VkCommandBuffer commandBuffer, int frame,
+                   double time, struct Vec2 size) {
+  (void)time;
+  struct ProfilerLayer *l = state;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    l->pipeline);
+
+  struct ProfilerPushConstants pushConstants = {size};
+  vkCmdPushConstants(commandBuffer, l->pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(struct ProfilerPushConstants), &pushConstants);
+
+  VkBuffer buffers[] = {l->buffers[frame].buffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdDraw(commandBuffer, 6, l->counts[frame], 0, 0);
+}
+
+static void destroy(void *state) {
+  struct ProfilerLayer *l = state;
+
+  for (int f = 0; f < l->framesInFlight; f++) {
+    vkUnmapMemory(l->device, l->buffers[f].memory);
+    vkDestroyBuffer(l->device, l->buffers[f].buffer, NULL);
+    vkFreeMemory(l->device, l->buffers[f].memory, NULL);
+  }
+  free(l->buffers);
+  free(l->mapped);
+  free(l->counts);
+
+  vkDestroyPipeline(l->device, l->pipeline, NULL);
+  vkDestroyPipelineLayout(l->device, l->pipelineLayout, NULL);
+  vkDestroyShaderModule(l->device, l->fragShader, NULL);
+  vkDestroyShaderModule(l->device, l->vertShader, NULL);
+
+  free(l);
+}
+
+// PUBLIC FUNCTIONS
+
+struct Layer makeProfilerLayer(struct RenderContext ctx, Profiler profiler,
+                               float x, float y, float width, float height) {
+  struct ProfilerLayer *l = malloc(sizeof(struct ProfilerLayer));
+  l->profiler = profiler;
+  l->rect[0] = x;
+  l->rect[1] = y;
+  l->rect[2] = width;
+  l->rect[3] = height;
+  l->device = ctx.device;
+  l->framesInFlight = ctx.framesInFlight;
+
+  // instance buffers, mapped for good
+  VkDeviceSize size = MAX_INSTANCES * sizeof(struct ProfilerInstance);
+  l->buffers = malloc(l->framesInFlight * sizeof(struct VertexBufferAndMemory));
+  l->mapped = malloc(l->framesInFlight * sizeof(struct ProfilerInstance *));
+  l->counts = calloc(l->framesInFlight, sizeof(int));
+  for (int f = 0; f < l->framesInFlight; f++) {
+    l->buffers[f] = makeVkHostBuffer(ctx.physicalDevice, ctx.device, size,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vkMapMemory(ctx.device, l->buffers[f].memory, 0, size, 0,
+                (void **)&l->mapped[f]);
+  }
+
+  // pipeline
+  l->vertShader = makeVkShaderModule(ctx.device, "bin/profiler-vert.spv");
+  l->fragShader = makeVkShaderModule(ctx.device, "bin/profiler-frag.spv");
+  l->pipelineLayout = makeVkPushConstantLayout(
+      ctx.device, sizeof(struct ProfilerPushConstants),
+      VK_SHADER_STAGE_VERTEX_BIT);
+  l->pipeline = makeVkPipelineWithInput(
+      ctx.device, ctx.swapchainSettings, l->vertShader, l->fragShader,
+      ctx.renderPass, l->pipelineLayout, instanceInput());
+
+  return (struct Layer){
+      .state = l,
+      .prepare = prepare,
+      .record = record,
+      .destroy = destroy,
+  };
+}
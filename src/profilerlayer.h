@@ -0,0 +1,17 @@
+#ifndef PROFILERLAYER_H
+#define PROFILERLAYER_H
+
+#include "profiler.h"
+#include "renderer.h"
+
+// draws the profiler over the given rectangle (window coordinates). the top
+// shows the newest blocks as bars against their deadline, the line across
+// the middle, late blocks in red. below, a row for each of the costliest
+// nodes with its maximum, p99 and median as nested bars on a scale of one
+// deadline. a node keeps its colour while rows reorder, the trace has its
+// name. the layer collects the profiler every frame, which makes the render
+// thread its reading side.
+struct Layer makeProfilerLayer(struct RenderContext ctx, Profiler profiler,
+                               float x, float y, float width, float height);
+
+#endif
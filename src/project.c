@@ -0,0 +1,1013 @@
+#define _POSIX_C_SOURCE 200809L
+#include "project.h"
+
+#include "die.h"
+#include "hash.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// everything is stored little endian, as laid out in memory
+
+#define MAGIC "DAWPROJ"
+#define HEADER_SLOTS 2
+#define DATA_START (HEADER_SLOTS * sizeof(struct Header))
+
+// compact once the file is this many times what the newest save reaches,
+// and at least this big
+#define COMPACT_RATIO 2
+#define COMPACT_MIN_BYTES (1 << 20)
+
+enum ChunkType {
+  CHUNK_ROOT = 1,
+  CHUNK_TRACKS,
+  CHUNK_STRINGS,
+  CHUNK_NOTES,
+  CHUNK_CLIPS,
+  CHUNK_LANES,
+  CHUNK_CURVE,
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t sequence; // the intact slot with the highest wins
+  uint64_t root;     // offset of the root chunk, 0 for an empty project
+  uint64_t end;      // where the next save appends
+  uint64_t live;     // bytes the root reaches
+  uint64_t spare;
+  uint64_t checksum; // of everything above
+};
+
+struct ChunkHeader {
+  uint32_t type;
+  uint32_t version;
+  uint64_t size; // payload bytes, before padding
+  uint64_t hash; // of the payload
+};
+
+struct Root {
+  uint32_t sampleRate;
+  uint32_t trackCount;
+  uint64_t tracks;  // CHUNK_TRACKS, trackCount struct ProjectTrack
+  uint64_t strings; // CHUNK_STRINGS, nul terminated, "" at offset 0
+};
+
+// followed by the columns: starts, lengths, pitches, velocities
+struct NotesHeader {
+  uint32_t count;
+  uint32_t reserved;
+};
+
+_Static_assert(sizeof(struct Header) == 64, "header slots are 64 bytes");
+_Static_assert(sizeof(struct ChunkHeader) == 24, "chunk headers are 24 bytes");
+_Static_assert(sizeof(struct ProjectTrack) == 40, "tracks are 40 bytes");
+_Static_assert(sizeof(struct ProjectClip) == 32, "clips are 32 bytes");
+
+struct Project {
+  const uint8_t *map;
+  size_t size;
+  struct Header header;
+  const struct Root *root;
+  const struct ProjectTrack *tracks;
+  const char *strings;
+  uint64_t stringsSize;
+};
+
+// the writer's copy of a ProjectState, in a few blocks
+struct Snapshot {
+  uint64_t number;
+  int sampleRate;
+  int trackCount;
+  struct TrackState *tracks;
+  struct LaneState *lanes;
+  struct ClipState *clips;
+  char *strings;
+};
+
+// a chunk already in the file, found by its hash
+struct KnownChunk {
+  uint64_t hash;
+  uint64_t offset; // 0 for an empty slot
+  uint64_t size;
+  uint32_t type;
+};
+
+// hashes of note tracks and curves from the last save, sorted by address
+struct KnownObject {
+  const void *object;
+  uint64_t hash;
+};
+
+// a file being appended to
+struct Target {
+  int fd;
+  struct Header header;
+  struct KnownChunk *chunks; // open addressing, a power of two
+  size_t chunkCapacity;
+  size_t chunkCount;
+};
+
+struct ProjectWriter {
+  char *path;
+  struct Target file;
+
+  // writer thread
+  struct KnownObject *objects, *nextObjects;
+  int objectCount, objectCapacity;
+  int nextCount, nextCapacity;
+  struct Snapshot *last; // keeps `objects` alive, so addresses stay unique
+  uint64_t appended;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // a snapshot handed over, or the writer freed
+  pthread_cond_t done; // a snapshot saved or given up on
+  _Atomic(struct Snapshot *) pending;
+  atomic_int running;
+  _Atomic uint64_t requested; // ui thread counts, the writer reads
+  _Atomic uint64_t handled;
+  _Atomic uint64_t saved;
+  _Atomic uint64_t lastBytes;
+  atomic_int failed;
+};
+
+static uint64_t headerChecksum(const struct Header *h) {
+  return hashOf(h, offsetof(struct Header, checksum));
+}
+
+static uint64_t padded(uint64_t size) { return (size + 7) & ~(uint64_t)7; }
+
+// READING
+
+static int headerIntact(const struct Header *h, uint64_t fileSize) {
+  return memcmp(h->magic, MAGIC, sizeof(h->magic)) == 0 &&
+         h->version <= PROJECT_VERSION && headerChecksum(h) == h->checksum &&
+         h->end >= DATA_START && h->end <= fileSize;
+}
+
+// the intact slots, newest first, returns how many there are
+static int intactHeaders(const struct Header slots[HEADER_SLOTS],
+                         uint64_t fileSize, struct Header out[HEADER_SLOTS]) {
+  int found = 0;
+  for (int i = 0; i < HEADER_SLOTS; i++) {
+    if (!headerIntact(&slots[i], fileSize)) {
+      continue;
+    }
+    int at = found++;
+    while (at > 0 && out[at - 1].sequence < slots[i].sequence) {
+      out[at] = out[at - 1];
+      at--;
+    }
+    out[at] = slots[i];
+  }
+  return found;
+}
+
+// the chunk at `offset` if it's of the given type and fits before `limit`
+static const struct ChunkHeader *chunkAt(const uint8_t *map, uint64_t limit,
+                                         uint64_t offset, uint32_t type) {
+  if (offset < DATA_START || offset % 8 != 0 ||
+      offset + sizeof(struct ChunkHeader) > limit) {
+    return NULL;
+  }
+  const struct ChunkHeader *c = (const struct ChunkHeader *)(map + offset);
+  if (c->type != type ||
+      c->size > limit - offset - sizeof(struct ChunkHeader)) {
+    return NULL;
+  }
+  return c;
+}
+
+static int chunkIntact(const struct ChunkHeader *c) {
+  return hashOf(c + 1, c->size) == c->hash;
+}
+
+// a checked chunk of whole `stride` byte records, NULL if there's none
+static const void *records(Project p, uint64_t offset, uint32_t type,
+                           size_t stride, int *count) {
+  *count = 0;
+  const struct ChunkHeader *c =
+      offset ? chunkAt(p->map, p->header.end, offset, type) : NULL;
+  if (!c || c->size % stride != 0 || !chunkIntact(c)) {
+    return NULL;
+  }
+  *count = (int)(c->size / stride);
+  return c + 1;
+}
+
+// the root and the small tables every lookup needs, for the save
+// `p->header` points at. returns 0 if any of them is damaged
+static int readRoot(Project p) {
+  p->root = NULL;
+  p->tracks = NULL;
+  p->strings = NULL;
+  p->stringsSize = 0;
+  if (!p->header.root) {
+    return 1; // saved while empty
+  }
+
+  const struct ChunkHeader *root =
+      chunkAt(p->map, p->header.end, p->header.root, CHUNK_ROOT);
+  if (!root || root->size != sizeof(struct Root) || !chunkIntact(root)) {
+    return 0;
+  }
+  p->root = (const struct Root *)(root + 1);
+  int count, size;
+  p->tracks = records(p, p->root->tracks, CHUNK_TRACKS,
+                      sizeof(struct ProjectTrack), &count);
+  p->strings = records(p, p->root->strings, CHUNK_STRINGS, 1, &size);
+  p->stringsSize = size;
+  int ok = (p->tracks || p->root->trackCount == 0) &&
+           count == (int)p->root->trackCount && p->strings && size > 0 &&
+           p->strings[size - 1] == '\0';
+  if (!ok) {
+    p->root = NULL;
+  }
+  return ok;
+}
+
+static Project mapProject(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < DATA_START) {
+    return NULL;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  Project p = calloc(1, sizeof(struct Project));
+  p->map = map;
+  p->size = st.st_size;
+  // the newest save whose root and tables are whole, a damaged one leaves
+  // the one before
+  struct Header slots[HEADER_SLOTS];
+  int count = intactHeaders((const struct Header *)p->map, p->size, slots);
+  for (int i = 0; i < count; i++) {
+    p->header = slots[i];
+    if (readRoot(p)) {
+      return p;
+    }
+  }
+  closeProject(p);
+  return NULL;
+}
+
+// WRITING
+
+static int writeAll(int fd, const void *data, size_t size, uint64_t offset) {
+  const uint8_t *p = data;
+  while (size > 0) {
+    ssize_t n = pwrite(fd, p, size, (off_t)offset);
+    if (n <= 0) {
+      return 0;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return 1;
+}
+
+static void rememberChunk(struct Target *t, struct KnownChunk chunk);
+
+static void growChunks(struct Target *t) {
+  struct KnownChunk *old = t->chunks;
+  size_t oldCapacity = t->chunkCapacity;
+  t->chunkCapacity = oldCapacity ? 2 * oldCapacity : 256;
+  t->chunks = calloc(t->chunkCapacity, sizeof(struct KnownChunk));
+  t->chunkCount = 0;
+  for (size_t i = 0; i < oldCapacity; i++) {
+    if (old[i].offset) {
+      rememberChunk(t, old[i]);
+    }
+  }
+  free(old);
+}
+
+static void rememberChunk(struct Target *t, struct KnownChunk chunk) {
+  if (2 * (t->chunkCount + 1) > t->chunkCapacity) {
+    growChunks(t);
+  }
+  size_t mask = t->chunkCapacity - 1;
+  size_t i = chunk.hash & mask;
+  while (t->chunks[i].offset) {
+    i = (i + 1) & mask;
+  }
+  t->chunks[i] = chunk;
+  t->chunkCount++;
+}
+
+static uint64_t findChunk(struct Target *t, uint32_t type, uint64_t size,
+                          uint64_t hash) {
+  if (!t->chunkCapacity) {
+    return 0;
+  }
+  size_t mask = t->chunkCapacity - 1;
+  for (size_t i = hash & mask; t->chunks[i].offset; i = (i + 1) & mask) {
+    struct KnownChunk *c = &t->chunks[i];
+    if (c->hash == hash && c->type == type && c->size == size) {
+      return c->offset;
+    }
+  }
+  return 0;
+}
+
+// drops chunks at or past `end`, a failed save's appends get overwritten
+static void forgetChunksFrom(struct Target *t, uint64_t end) {
+  struct KnownChunk *old = t->chunks;
+  size_t capacity = t->chunkCapacity;
+  t->chunks = calloc(capacity, sizeof(struct KnownChunk));
+  t->chunkCount = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    if (old[i].offset && old[i].offset < end) {
+      rememberChunk(t, old[i]);
+    }
+  }
+  free(old);
+}
+
+struct Piece {
+  const void *data;
+  size_t size;
+};
+
+// the offset of a chunk with this payload, appended if the file doesn't
+// have one yet. `hash` is the payload's if the caller knows it, else 0.
+// returns 0 on a write error
+static uint64_t putChunk(struct Target *t, uint64_t *appended, uint32_t type,
+                         const struct Piece *pieces, int count,
+                         uint64_t hash) {
+  uint64_t size = 0;
+  for (int i = 0; i < count; i++) {
+    size += pieces[i].size;
+  }
+  if (!hash) {
+    struct Hasher s;
+    hashStart(&s);
+    for (int i = 0; i < count; i++) {
+      hashBytes(&s, pieces[i].data, pieces[i].size);
+    }
+    hash = hashEnd(&s);
+  }
+  t->header.live += sizeof(struct ChunkHeader) + padded(size);
+
+  uint64_t offset = findChunk(t, type, size, hash);
+  if (offset) {
+    return offset;
+  }
+
+  offset = t->header.end;
+  struct ChunkHeader header = {type, PROJECT_VERSION, size, hash};
+  static const uint8_t zeros[8] = {0};
+  uint64_t at = offset;
+  if (!writeAll(t->fd, &header, sizeof(header), at)) {
+    return 0;
+  }
+  at += sizeof(header);
+  for (int i = 0; i < count; i++) {
+    if (!writeAll(t->fd, pieces[i].data, pieces[i].size, at)) {
+      return 0;
+    }
+    at += pieces[i].size;
+  }
+  if (!writeAll(t->fd, zeros, padded(size) - size, at)) {
+    return 0;
+  }
+
+  t->header.end = offset + sizeof(header) + padded(size);
+  *appended += t->header.end - offset;
+  rememberChunk(t, (struct KnownChunk){hash, offset, size, type});
+  return offset;
+}
+
+static int compareObjects(const void *x, const void *y) {
+  const struct KnownObject *a = x, *b = y;
+  uintptr_t p = (uintptr_t)a->object, q = (uintptr_t)b->object;
+  return p < q ? -1 : p > q;
+}
+
+// the hash of an immutable object from the last save, 0 if it's new
+static uint64_t knownHash(ProjectWriter w, const void *object) {
+  if (!w->objectCount) {
+    return 0;
+  }
+  struct KnownObject key = {object, 0};
+  struct KnownObject *found =
+      bsearch(&key, w->objects, w->objectCount, sizeof(struct KnownObject),
+              compareObjects);
+  return found ? found->hash : 0;
+}
+
+static void rememberObject(ProjectWriter w, const void *object,
+                           uint64_t hash) {
+  if (w->nextCount == w->nextCapacity) {
+    w->nextCapacity = w->nextCapacity ? 2 * w->nextCapacity : 64;
+    w->nextObjects = realloc(w->nextObjects,
+                             w->nextCapacity * sizeof(struct KnownObject));
+  }
+  w->nextObjects[w->nextCount++] = (struct KnownObject){object, hash};
+}
+
+static uint64_t hashPieces(const struct Piece *pieces, int count) {
+  struct Hasher s;
+  hashStart(&s);
+  for (int i = 0; i < count; i++) {
+    hashBytes(&s, pieces[i].data, pieces[i].size);
+  }
+  return hashEnd(&s);
+}
+
+static uint64_t putNotes(ProjectWriter w, struct Target *t, NoteTrack notes) {
+  int count = noteTrackCount(notes);
+  struct NoteColumns c = noteTrackColumns(notes);
+  struct NotesHeader header = {(uint32_t)count, 0};
+  struct Piece pieces[] = {
+      {&header, sizeof(header)},
+      {c.starts, count * sizeof(uint64_t)},
+      {c.lengths, count * sizeof(uint32_t)},
+      {c.pitches, (size_t)count},
+      {c.velocities, (size_t)count},
+  };
+  uint64_t hash = knownHash(w, notes);
+  hash = hash ? hash : hashPieces(pieces, 5);
+  rememberObject(w, notes, hash);
+  return putChunk(t, &w->appended, CHUNK_NOTES, pieces, 5, hash);
+}
+
+static uint64_t putCurve(ProjectWriter w, struct Target *t, Automation curve) {
+  struct Piece piece = {automationPoints(curve),
+                        automationCount(curve) * sizeof(struct Breakpoint)};
+  uint64_t hash = knownHash(w, curve);
+  hash = hash ? hash : hashPieces(&piece, 1);
+  rememberObject(w, curve, hash);
+  return putChunk(t, &w->appended, CHUNK_CURVE, &piece, 1, hash);
+}
+
+// a growing string table, "" at offset 0
+struct Strings {
+  char *data;
+  size_t size, capacity;
+};
+
+static uint32_t addString(struct Strings *s, const char *string) {
+  if (!string || !*string) {
+    return 0;
+  }
+  size_t n = strlen(string) + 1;
+  if (s->size + n > s->capacity) {
+    s->capacity = 2 * (s->size + n);
+    s->data = realloc(s->data, s->capacity);
+  }
+  memcpy(s->data + s->size, string, n);
+  s->size += n;
+  return (uint32_t)(s->size - n);
+}
+
+// appends everything `s` needs that `t` doesn't have yet, returns the root's
+// offset or 0 on a write error
+static uint64_t writeSnapshot(ProjectWriter w, struct Target *t,
+                              const struct Snapshot *s) {
+  struct Strings strings = {calloc(1, 64), 1, 64};
+  struct ProjectTrack *tracks =
+      calloc(s->trackCount ? s->trackCount : 1, sizeof(struct ProjectTrack));
+  w->nextCount = 0;
+  t->header.live = 0;
+
+  int ok = 1;
+  for (int i = 0; i < s->trackCount && ok; i++) {
+    const struct TrackState *state = &s->tracks[i];
+    struct ProjectTrack *track = &tracks[i];
+    track->name = addString(&strings, state->name);
+    track->flags = state->flags;
+    track->gain = state->gain;
+    track->pan = state->pan;
+
+    if (state->notes) {
+      track->notes = putNotes(w, t, state->notes);
+      ok &= track->notes != 0;
+    }
+
+    if (state->clipCount > 0) {
+      struct ProjectClip *clips =
+          malloc(state->clipCount * sizeof(struct ProjectClip));
+      for (int c = 0; c < state->clipCount; c++) {
+        const struct ClipState *clip = &state->clips[c];
+        clips[c] = (struct ProjectClip){clip->start, clip->length,
+                                        clip->offset,
+                                        addString(&strings, clip->source),
+                                        clip->flags};
+      }
+      struct Piece piece = {clips,
+                            state->clipCount * sizeof(struct ProjectClip)};
+      track->clips = putChunk(t, &w->appended, CHUNK_CLIPS, &piece, 1, 0);
+      ok &= track->clips != 0;
+      free(clips);
+    }
+
+    if (state->laneCount > 0) {
+      struct ProjectLane *lanes =
+          calloc(state->laneCount, sizeof(struct ProjectLane));
+      for (int l = 0; l < state->laneCount && ok; l++) {
+        lanes[l].param = state->lanes[l].param;
+        lanes[l].curve = putCurve(w, t, state->lanes[l].curve);
+        ok &= lanes[l].curve != 0;
+      }
+      struct Piece piece = {lanes,
+                            state->laneCount * sizeof(struct ProjectLane)};
+      track->lanes = ok ? putChunk(t, &w->appended, CHUNK_LANES, &piece, 1, 0)
+                        : 0;
+      ok &= track->lanes != 0;
+      free(lanes);
+    }
+  }
+
+  uint64_t root = 0;
+  if (ok) {
+    struct Piece stringPiece = {strings.data, strings.size};
+    struct Piece trackPiece = {tracks,
+                               s->trackCount * sizeof(struct ProjectTrack)};
+    struct Root r = {(uint32_t)s->sampleRate, (uint32_t)s->trackCount, 0, 0};
+    r.strings =
+        putChunk(t, &w->appended, CHUNK_STRINGS, &stringPiece, 1, 0);
+    r.tracks = putChunk(t, &w->appended, CHUNK_TRACKS, &trackPiece, 1, 0);
+    if (r.strings && r.tracks) {
+      struct Piece rootPiece = {&r, sizeof(r)};
+      root = putChunk(t, &w->appended, CHUNK_ROOT, &rootPiece, 1, 0);
+    }
+  }
+
+  free(strings.data);
+  free(tracks);
+  return root;
+}
+
+// makes the appended chunks durable, then points the spare slot at them
+static int commit(struct Target *t, uint64_t root) {
+  if (fdatasync(t->fd) != 0) {
+    return 0;
+  }
+  struct Header h = t->header;
+  h.sequence++;
+  h.root = root;
+  h.checksum = headerChecksum(&h);
+  uint64_t slot = h.sequence % HEADER_SLOTS;
+  if (!writeAll(t->fd, &h, sizeof(h), slot * sizeof(h)) ||
+      fdatasync(t->fd) != 0) {
+    return 0;
+  }
+  t->header = h;
+  return 1;
+}
+
+static struct Header emptyHeader(void) {
+  struct Header h = {0};
+  memcpy(h.magic, MAGIC, sizeof(h.magic));
+  h.version = PROJECT_VERSION;
+  h.end = DATA_START;
+  h.checksum = headerChecksum(&h);
+  return h;
+}
+
+static void syncDirectory(const char *path) {
+  char *dir = strdup(path);
+  char *slash = strrchr(dir, '/');
+  if (slash) {
+    *(slash == dir ? slash + 1 : slash) = '\0';
+  } else {
+    strcpy(dir, ".");
+  }
+  int fd = open(dir, O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  free(dir);
+}
+
+// writes only what `s` reaches into a fresh file, then renames it over the
+// project. the old file stays valid until the rename
+static int compact(ProjectWriter w, const struct Snapshot *s) {
+  size_t n = strlen(w->path);
+  char *temporary = malloc(n + sizeof(".compact"));
+  memcpy(temporary, w->path, n);
+  memcpy(temporary + n, ".compact", sizeof(".compact"));
+
+  struct Target fresh = {0};
+  fresh.fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  fresh.header = emptyHeader();
+  fresh.header.sequence = w->file.header.sequence;
+  struct Header slots[HEADER_SLOTS] = {fresh.header};
+  uint64_t appended = w->appended;
+
+  uint64_t root = 0;
+  int ok = fresh.fd >= 0 && writeAll(fresh.fd, slots, sizeof(slots), 0) &&
+           (root = writeSnapshot(w, &fresh, s)) && commit(&fresh, root) &&
+           rename(temporary, w->path) == 0;
+  w->appended = appended;
+  if (!ok) {
+    if (fresh.fd >= 0) {
+      close(fresh.fd);
+      unlink(temporary);
+    }
+    free(fresh.chunks);
+    free(temporary);
+    return 0;
+  }
+  syncDirectory(w->path);
+
+  close(w->file.fd);
+  free(w->file.chunks);
+  w->file = fresh;
+  free(temporary);
+  return 1;
+}
+
+// one snapshot, appended and committed, then compacted if it's time
+static int save(ProjectWriter w, const struct Snapshot *s) {
+  struct Header before = w->file.header;
+  w->appended = 0;
+  uint64_t root = writeSnapshot(w, &w->file, s);
+  // an unchanged project appended nothing and needs no new header
+  int ok = root != 0 && (root == before.root || commit(&w->file, root));
+  if (!ok) {
+    w->file.header = before;
+    forgetChunksFrom(&w->file, before.end);
+    return 0;
+  }
+
+  uint64_t used = w->file.header.end - DATA_START;
+  if (used > COMPACT_MIN_BYTES && used > COMPACT_RATIO * w->file.header.live) {
+    compact(w, s); // a failed compaction leaves a good, merely large file
+  }
+  return 1;
+}
+
+static void freeSnapshot(struct Snapshot *s) {
+  if (!s) {
+    return;
+  }
+  for (int i = 0; i < s->trackCount; i++) {
+    noteTrackRelease(s->tracks[i].notes);
+  }
+  for (int i = 0; i < s->trackCount; i++) {
+    for (int l = 0; l < s->tracks[i].laneCount; l++) {
+      automationRelease(s->tracks[i].lanes[l].curve);
+    }
+  }
+  free(s->tracks);
+  free(s->lanes);
+  free(s->clips);
+  free(s->strings);
+  free(s);
+}
+
+static void *writerMain(void *arg) {
+  ProjectWriter w = arg;
+  for (;;) {
+    // read the flag first, a snapshot handed over before it was cleared is
+    // still saved
+    int running = atomic_load_explicit(&w->running, memory_order_acquire);
+    struct Snapshot *s =
+        atomic_exchange_explicit(&w->pending, NULL, memory_order_acq_rel);
+    if (s) {
+      uint64_t number = s->number;
+      if (save(w, s)) {
+        // this save's objects are the ones the next one will look for
+        qsort(w->nextObjects, w->nextCount, sizeof(struct KnownObject),
+              compareObjects);
+        struct KnownObject *objects = w->objects;
+        int capacity = w->objectCapacity;
+        w->objects = w->nextObjects;
+        w->objectCount = w->nextCount;
+        w->objectCapacity = w->nextCapacity;
+        w->nextObjects = objects;
+        w->nextCapacity = capacity;
+        freeSnapshot(w->last);
+        w->last = s;
+        atomic_store_explicit(&w->lastBytes, w->appended,
+                              memory_order_relaxed);
+        atomic_store_explicit(&w->saved, number, memory_order_release);
+      } else {
+        atomic_store_explicit(&w->failed, 1, memory_order_relaxed);
+        freeSnapshot(s);
+      }
+      pthread_mutex_lock(&w->lock);
+      atomic_store_explicit(&w->handled, number, memory_order_release);
+      pthread_cond_broadcast(&w->done);
+      pthread_mutex_unlock(&w->lock);
+      continue;
+    }
+    if (!running) {
+      break;
+    }
+    pthread_mutex_lock(&w->lock);
+    while (!atomic_load_explicit(&w->pending, memory_order_acquire) &&
+           atomic_load_explicit(&w->running, memory_order_acquire)) {
+      pthread_cond_wait(&w->wake, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+  }
+  return NULL;
+}
+
+// remembers every intact chunk the newest save reaches, so the next save can
+// reuse them. a damaged one is written again instead
+static void learnChunks(struct Target *t, Project p) {
+  if (!p->root) {
+    return;
+  }
+  const uint8_t *map = p->map;
+  uint64_t end = p->header.end;
+  uint64_t offsets[3] = {p->header.root, p->root->tracks, p->root->strings};
+  uint32_t types[3] = {CHUNK_ROOT, CHUNK_TRACKS, CHUNK_STRINGS};
+  for (int i = 0; i < 3; i++) {
+    const struct ChunkHeader *c = chunkAt(map, end, offsets[i], types[i]);
+    if (c && chunkIntact(c)) {
+      rememberChunk(t, (struct KnownChunk){c->hash, offsets[i], c->size,
+                                           c->type});
+    }
+  }
+
+  for (int i = 0; i < (int)p->root->trackCount; i++) {
+    const struct ProjectTrack *track = &p->tracks[i];
+    uint64_t parts[3] = {track->notes, track->clips, track->lanes};
+    uint32_t partTypes[3] = {CHUNK_NOTES, CHUNK_CLIPS, CHUNK_LANES};
+    for (int j = 0; j < 3; j++) {
+      const struct ChunkHeader *c =
+          parts[j] ? chunkAt(map, end, parts[j], partTypes[j]) : NULL;
+      if (c && chunkIntact(c)) {
+        rememberChunk(t, (struct KnownChunk){c->hash, parts[j], c->size,
+                                             c->type});
+      }
+    }
+
+    // curves are only reachable through their lanes
+    const struct ChunkHeader *c =
+        track->lanes ? chunkAt(map, end, track->lanes, CHUNK_LANES) : NULL;
+    if (!c || c->size % sizeof(struct ProjectLane) != 0 || !chunkIntact(c)) {
+      continue;
+    }
+    const struct ProjectLane *lanes = (const struct ProjectLane *)(c + 1);
+    for (size_t l = 0; l < c->size / sizeof(struct ProjectLane); l++) {
+      const struct ChunkHeader *curve =
+          chunkAt(map, end, lanes[l].curve, CHUNK_CURVE);
+      if (curve && chunkIntact(curve)) {
+        rememberChunk(t, (struct KnownChunk){curve->hash, lanes[l].curve,
+                                             curve->size, curve->type});
+      }
+    }
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Project openProject(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  Project p = mapProject(fd);
+  close(fd);
+  return p;
+}
+
+void closeProject(Project p) {
+  munmap((void *)p->map, p->size);
+  free(p);
+}
+
+int projectSampleRate(Project p) {
+  return p->root ? (int)p->root->sampleRate : 0;
+}
+
+int projectTrackCount(Project p) {
+  return p->root ? (int)p->root->trackCount : 0;
+}
+
+const struct ProjectTrack *projectTrack(Project p, int index) {
+  return index >= 0 && index < projectTrackCount(p) ? &p->tracks[index] : NULL;
+}
+
+const char *projectString(Project p, uint32_t offset) {
+  return p->strings && offset < p->stringsSize ? p->strings + offset : "";
+}
+
+const struct ProjectClip *projectClips(Project p, const struct ProjectTrack *t,
+                                       int *count) {
+  return records(p, t->clips, CHUNK_CLIPS, sizeof(struct ProjectClip), count);
+}
+
+const struct ProjectLane *projectLanes(Project p, const struct ProjectTrack *t,
+                                       int *count) {
+  return records(p, t->lanes, CHUNK_LANES, sizeof(struct ProjectLane), count);
+}
+
+const struct Breakpoint *projectCurve(Project p, uint64_t curve, int *count) {
+  return records(p, curve, CHUNK_CURVE, sizeof(struct Breakpoint), count);
+}
+
+int projectNotes(Project p, const struct ProjectTrack *t,
+                 struct NoteColumns *columns) {
+  int size;
+  const uint8_t *payload = records(p, t->notes, CHUNK_NOTES, 1, &size);
+  if (!payload || (size_t)size < sizeof(struct NotesHeader)) {
+    return 0;
+  }
+  const struct NotesHeader *header = (const struct NotesHeader *)payload;
+  size_t count = header->count;
+  if ((size_t)size != sizeof(struct NotesHeader) + count * 14) {
+    return 0;
+  }
+
+  const uint8_t *column = payload + sizeof(struct NotesHeader);
+  columns->starts = (const uint64_t *)column;
+  column += count * sizeof(uint64_t);
+  columns->lengths = (const uint32_t *)column;
+  column += count * sizeof(uint32_t);
+  columns->pitches = column;
+  columns->velocities = column + count;
+  return (int)count;
+}
+
+NoteTrack projectLoadNotes(Project p, const struct ProjectTrack *t) {
+  struct NoteColumns c;
+  int count = projectNotes(p, t, &c);
+  if (count == 0) {
+    return NULL;
+  }
+  struct Note *notes = malloc(count * sizeof(struct Note));
+  for (int i = 0; i < count; i++) {
+    notes[i] = (struct Note){c.starts[i], c.lengths[i], c.pitches[i],
+                             c.velocities[i]};
+  }
+  NoteTrack track = makeNoteTrack(notes, count);
+  free(notes);
+  return track;
+}
+
+Automation projectLoadCurve(Project p, uint64_t curve) {
+  int count;
+  const struct Breakpoint *points = projectCurve(p, curve, &count);
+  return points ? makeAutomation(points, count) : NULL;
+}
+
+ProjectWriter makeProjectWriter(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct Target file = {fd, emptyHeader(), NULL, 0, 0};
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size == 0) {
+    // a new project, one empty save so it opens
+    struct Header slots[HEADER_SLOTS] = {file.header};
+    if (!writeAll(fd, slots, sizeof(slots), 0) || fdatasync(fd) != 0) {
+      close(fd);
+      return NULL;
+    }
+  } else {
+    // never write over something that isn't an intact project
+    Project p = mapProject(fd);
+    if (!p) {
+      close(fd);
+      return NULL;
+    }
+    file.header = p->header;
+    learnChunks(&file, p);
+    closeProject(p);
+  }
+
+  ProjectWriter w = calloc(1, sizeof(struct ProjectWriter));
+  w->path = strdup(path);
+  w->file = file;
+  atomic_init(&w->pending, NULL);
+  atomic_init(&w->running, 1);
+  atomic_init(&w->requested, 0);
+  atomic_init(&w->handled, 0);
+  atomic_init(&w->saved, 0);
+  atomic_init(&w->lastBytes, 0);
+  atomic_init(&w->failed, 0);
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->wake, NULL);
+  pthread_cond_init(&w->done, NULL);
+  if (pthread_create(&w->thread, NULL, writerMain, w) != 0) {
+    die("Failed to start project writer thread\n");
+  }
+  return w;
+}
+
+void freeProjectWriter(ProjectWriter w) {
+  pthread_mutex_lock(&w->lock);
+  atomic_store_explicit(&w->running, 0, memory_order_release);
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->wake);
+  pthread_cond_destroy(&w->done);
+  freeSnapshot(w->last);
+  free(w->objects);
+  free(w->nextObjects);
+  free(w->file.chunks);
+  close(w->file.fd);
+  free(w->path);
+  free(w);
+}
+
+uint64_t projectSave(ProjectWriter w, struct ProjectState state) {
+  // one block each for the tracks, lanes, clips and strings
+  int laneCount = 0, clipCount = 0;
+  size_t stringBytes = 0;
+  for (int i = 0; i < state.trackCount; i++) {
+    const struct TrackState *t = &state.tracks[i];
+    laneCount += t->laneCount;
+    clipCount += t->clipCount;
+    stringBytes += (t->name ? strlen(t->name) : 0) + 1;
+    for (int c = 0; c < t->clipCount; c++) {
+      const char *source = t->clips[c].source;
+      stringBytes += (source ? strlen(source) : 0) + 1;
+    }
+  }
+
+  struct Snapshot *s = malloc(sizeof(struct Snapshot));
+  s->sampleRate = state.sampleRate;
+  s->trackCount = state.trackCount;
+  s->tracks = malloc((state.trackCount + 1) * sizeof(struct TrackState));
+  s->lanes = malloc((laneCount + 1) * sizeof(struct LaneState));
+  s->clips = malloc((clipCount + 1) * sizeof(struct ClipState));
+  s->strings = malloc(stringBytes + 1);
+
+  struct LaneState *lane = s->lanes;
+  struct ClipState *clip = s->clips;
+  char *string = s->strings;
+  for (int i = 0; i < state.trackCount; i++) {
+    const struct TrackState *from = &state.tracks[i];
+    struct TrackState *to = &s->tracks[i];
+    *to = *from;
+    to->name = string;
+    string = stpcpy(string, from->name ? from->name : "") + 1;
+    if (to->notes) {
+      noteTrackRetain(to->notes);
+    }
+
+    to->lanes = lane;
+    for (int l = 0; l < from->laneCount; l++) {
+      *lane = from->lanes[l];
+      automationRetain(lane->curve);
+      lane++;
+    }
+    to->clips = clip;
+    for (int c = 0; c < from->clipCount; c++) {
+      const char *source = from->clips[c].source;
+      *clip = from->clips[c];
+      clip->source = string;
+      string = stpcpy(string, source ? source : "") + 1;
+      clip++;
+    }
+  }
+
+  // only the ui thread counts, so this is the next number
+  uint64_t number =
+      atomic_load_explicit(&w->requested, memory_order_relaxed) + 1;
+  s->number = number;
+  atomic_store_explicit(&w->requested, number, memory_order_relaxed);
+  freeSnapshot(
+      atomic_exchange_explicit(&w->pending, s, memory_order_acq_rel));
+  pthread_mutex_lock(&w->lock);
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+  return number;
+}
+
+uint64_t projectSaved(ProjectWriter w) {
+  return atomic_load_explicit(&w->saved, memory_order_acquire);
+}
+
+int projectFlush(ProjectWriter w) {
+  uint64_t number = atomic_load_explicit(&w->requested, memory_order_relaxed);
+  pthread_mutex_lock(&w->lock);
+  while (atomic_load_explicit(&w->handled, memory_order_acquire) < number) {
+    pthread_cond_wait(&w->done, &w->lock);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return !atomic_exchange_explicit(&w->failed, 0, memory_order_relaxed);
+}
+
+uint64_t projectLastSaveBytes(ProjectWriter w) {
+  return atomic_load_explicit(&w->lastBytes, memory_order_relaxed);
+}
@@ -0,0 +1,147 @@
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include "automation.h"
+#include "midi.h"
+#include <stdint.h>
+
+// project files. after two header slots the file is a run of chunks: a 24
+// byte chunk header (type, version, payload size, payload hash) and the
+// payload, padded to 8 bytes. chunks point at each other by file offset:
+// the root lists the tracks, each track points at its notes, clips and
+// automation lanes, so the file can be mapped and read in place.
+//
+// saving only appends. a chunk whose content is already in the file is
+// reused by its hash, everything else and a new root go at the end and are
+// synced, and only then does the spare header slot take the new root. a
+// crash at any point leaves the previous save intact. once dead chunks
+// outweigh live ones the next save writes a fresh copy and renames it over
+// the original.
+#define PROJECT_VERSION 1
+
+// ON DISK
+
+enum {
+  PROJECT_TRACK_MUTED = 1,
+  PROJECT_TRACK_SOLOED = 2,
+};
+
+enum {
+  PROJECT_CLIP_MUTED = 1,
+};
+
+struct ProjectTrack {
+  uint32_t name;  // offset in the string table
+  uint32_t flags; // PROJECT_TRACK_*
+  float gain;     // linear
+  float pan;      // -1 left to 1 right
+  uint64_t notes; // chunk offsets, 0 for none
+  uint64_t clips;
+  uint64_t lanes;
+};
+
+struct ProjectClip {
+  uint64_t start;  // samples on the timeline
+  uint64_t length; // samples
+  uint64_t offset; // samples into the source
+  uint32_t source; // path of the audio file, offset in the string table
+  uint32_t flags;  // PROJECT_CLIP_*
+};
+
+// an automated parameter of a track
+struct ProjectLane {
+  uint32_t param;
+  uint32_t reserved;
+  uint64_t curve; // chunk offset
+};
+
+// READING
+
+// a mapped project. opening checks the headers, the root, the track table
+// and the strings; everything else is checked as it's first asked for, so
+// opening costs the same however many notes the tracks hold.
+typedef struct Project *Project;
+
+// the newest save whose header, root and tables are intact, so a damaged
+// newest save opens the one before. returns NULL if the file can't be read
+// or no save in it is intact
+Project openProject(const char *path);
+void closeProject(Project p);
+
+int projectSampleRate(Project p);
+int projectTrackCount(Project p);
+const struct ProjectTrack *projectTrack(Project p, int index);
+const char *projectString(Project p, uint32_t offset);
+
+// the parts of a track, straight from the mapping. an empty result if the
+// track has none or the chunk is damaged
+const struct ProjectClip *projectClips(Project p, const struct ProjectTrack *t,
+                                       int *count);
+const struct ProjectLane *projectLanes(Project p, const struct ProjectTrack *t,
+                                       int *count);
+const struct Breakpoint *projectCurve(Project p, uint64_t curve, int *count);
+int projectNotes(Project p, const struct ProjectTrack *t,
+                 struct NoteColumns *columns);
+
+// live copies for editing and playback. NULL if there's nothing to load
+NoteTrack projectLoadNotes(Project p, const struct ProjectTrack *t);
+Automation projectLoadCurve(Project p, uint64_t curve);
+
+// WRITING
+
+struct LaneState {
+  uint32_t param;
+  Automation curve;
+};
+
+struct ClipState {
+  uint64_t start, length, offset;
+  const char *source;
+  uint32_t flags;
+};
+
+struct TrackState {
+  const char *name;
+  uint32_t flags;
+  float gain, pan;
+  NoteTrack notes; // NULL for none
+  const struct LaneState *lanes;
+  int laneCount;
+  const struct ClipState *clips;
+  int clipCount;
+};
+
+struct ProjectState {
+  int sampleRate;
+  const struct TrackState *tracks;
+  int trackCount;
+};
+
+// saves on a thread of its own, which does all the hashing, writing and
+// syncing. note tracks and curves never change, so one already in the file
+// is recognised by identity and never hashed again.
+typedef struct ProjectWriter *ProjectWriter;
+
+// opens the project at `path` to append to it, or creates it. NULL if the
+// file can't be opened or created
+ProjectWriter makeProjectWriter(const char *path);
+
+// finishes the saves handed over so far first
+void freeProjectWriter(ProjectWriter w);
+
+// ui thread. copies the small parts of the state, takes references to the
+// note tracks and curves, and returns; a snapshot the writer hasn't started
+// on yet is replaced. returns the save's number, counting from one
+uint64_t projectSave(ProjectWriter w, struct ProjectState state);
+
+// the number of the newest save that's safely on disk
+uint64_t projectSaved(ProjectWriter w);
+
+// blocks until every save handed over so far is on disk. returns 0 if any
+// of them failed
+int projectFlush(ProjectWriter w);
+
+// bytes appended by the newest save, for autosave bookkeeping
+uint64_t projectLastSaveBytes(ProjectWriter w);
+
+#endif
@@ -1,16 +1,23 @@
 #include "renderer.h"
 
+#include "clock.h"
 #include "die.h"
-#include "vk.h"
+#include "log.h"
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+#define MAX_LAYERS 16
+
+// input events between two frames, a fast mouse reports at 1 kHz
+#define INPUT_CAPACITY 1024
+
 struct Renderer {
   // state
-  int running;
+  atomic_int running; // written by the ui thread, read by the render thread
   int currentFrame;
 
   // ui
@@ -22,6 +29,15 @@ struct Renderer {
   int width, height;
   GLFWwindow *window;
   int resized;
+  atomic_int windowWidth, windowHeight; // screen coordinates, for layers
+
+  // layers
+  struct Layer layers[MAX_LAYERS];
+  int layerCount;
+
+  // input, and per frame in flight when the oldest input it shows arrived
+  Input input;
+  uint64_t *inputArrived;
 
   // vulkan
   VkInstance instance;
@@ -62,7 +78,17 @@ struct Renderer {
   VkDeviceMemory vertexMemory;
 };
 
-static void recordCommandBuffer(Renderer r, uint32_t imageIndex) {
+// a call the frame can't go on from. losing the device ends the session,
+// anything else costs the frame and is logged
+static void frameFailed(const char *call, VkResult result) {
+  if (result == VK_ERROR_DEVICE_LOST) {
+    die("Vulkan device lost in %s\n", call);
+  }
+  logError("%s failed: %d", call, result);
+}
+
+// returns 0 if the frame has to be skipped
+static int recordCommandBuffer(Renderer r, uint32_t imageIndex, double time) {
   VkResult result;
 
   // get framebuffer sizes
@@ -77,7 +103,8 @@ static void recordCommandBuffer(Renderer r, uint32_t imageIndex) {
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
   result = vkBeginCommandBuffer(r->commandBuffers[r->currentFrame], &beginInfo);
   if (result != VK_SUCCESS) {
-    die("Failed to begin recording command buffer: %d\n", result);
+    frameFailed("vkBeginCommandBuffer", result);
+    return 0;
   }
 
   // begin render pass
@@ -103,6 +130,17 @@ static void recordCommandBuffer(Renderer r, uint32_t imageIndex) {
   vkCmdBindPipeline(r->commandBuffers[r->currentFrame],
                     VK_PIPELINE_BIND_POINT_GRAPHICS, r->pipeline);
 
+  // viewport and scissor are dynamic in every pipeline
+  VkViewport viewport = {0};
+  viewport.width = (float)r->swapchainSettings.selectedExtent.width;
+  viewport.height = (float)r->swapchainSettings.selectedExtent.height;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(r->commandBuffers[r->currentFrame], 0, 1, &viewport);
+
+  VkRect2D scissor = {0};
+  scissor.extent = r->swapchainSettings.selectedExtent;
+  vkCmdSetScissor(r->commandBuffers[r->currentFrame], 0, 1, &scissor);
+
   // push constants
   struct PushConstants pushConstants = {{r->width, r->height}};
   vkCmdPushConstants(r->commandBuffers[r->currentFrame], r->pipelineLayout,
@@ -116,14 +154,27 @@ static void recordCommandBuffer(Renderer r, uint32_t imageIndex) {
                          vertexBuffers, offsets);
   vkCmdDraw(r->commandBuffers[r->currentFrame], r->vertexCount, 1, 0, 0);
 
+  // layers
+  struct Vec2 size = {
+      atomic_load_explicit(&r->windowWidth, memory_order_relaxed),
+      atomic_load_explicit(&r->windowHeight, memory_order_relaxed),
+  };
+  for (int i = 0; i < r->layerCount; i++) {
+    r->layers[i].record(r->layers[i].state,
+                        r->commandBuffers[r->currentFrame], r->currentFrame,
+                        time, size);
+  }
+
   // end render pass
   vkCmdEndRenderPass(r->commandBuffers[r->currentFrame]);
 
   // end recording
   result = vkEndCommandBuffer(r->commandBuffers[r->currentFrame]);
   if (result != VK_SUCCESS) {
-    die("Failed to end recording command buffer: %d\n", result);
+    frameFailed("vkEndCommandBuffer", result);
+    return 0;
   }
+  return 1;
 }
 
 static void framebufferResizeCallback(GLFWwindow *window, int width,
@@ -134,6 +185,71 @@ static void framebufferResizeCallback(GLFWwindow *window, int width,
   r->resized = 1;
 }
 
+static void windowSizeCallback(GLFWwindow *window, int width, int height) {
+  Renderer r = glfwGetWindowUserPointer(window);
+  atomic_store_explicit(&r->windowWidth, width, memory_order_relaxed);
+  atomic_store_explicit(&r->windowHeight, height, memory_order_relaxed);
+}
+
+static void cursorPosCallback(GLFWwindow *window, double x, double y) {
+  Renderer r = glfwGetWindowUserPointer(window);
+  inputPush(r->input, (struct InputEvent){
+                          .type = INPUT_MOUSE_MOVE,
+                          .x = x,
+                          .y = y,
+                      });
+}
+
+static void mouseButtonCallback(GLFWwindow *window, int button, int action,
+                                int mods) {
+  Renderer r = glfwGetWindowUserPointer(window);
+  inputPush(r->input, (struct InputEvent){
+                          .type = INPUT_MOUSE_BUTTON,
+                          .button = button,
+                          .action = action,
+                          .mods = mods,
+                      });
+}
+
+static void scrollCallback(GLFWwindow *window, double x, double y) {
+  Renderer r = glfwGetWindowUserPointer(window);
+  inputPush(r->input, (struct InputEvent){
+                          .type = INPUT_SCROLL,
+                          .x = x,
+                          .y = y,
+                      });
+}
+
+static void keyCallback(GLFWwindow *window, int key, int scancode, int action,
+                        int mods) {
+  (void)scancode;
+  Renderer r = glfwGetWindowUserPointer(window);
+  inputPush(r->input, (struct InputEvent){
+                          .type = INPUT_KEY,
+                          .button = key,
+                          .action = action,
+                          .mods = mods,
+                      });
+}
+
+static void charCallback(GLFWwindow *window, unsigned int codepoint) {
+  Renderer r = glfwGetWindowUserPointer(window);
+  inputPush(r->input, (struct InputEvent){
+                          .type = INPUT_CHAR,
+                          .codepoint = codepoint,
+                      });
+}
+
+// topmost layer first
+static void dispatchInput(void *state, const struct InputEvent *e) {
+  Renderer r = state;
+  for (int i = r->layerCount - 1; i >= 0; i--) {
+    if (r->layers[i].input && r->layers[i].input(r->layers[i].state, e)) {
+      return;
+    }
+  }
+}
+
 static void recreateSwapchain(Renderer r) {
   glfwGetFramebufferSize(r->window, &r->width, &r->height);
   while (r->width == 0 || r->height == 0) {
@@ -166,11 +282,30 @@ static void cleanupSwapchain(Renderer r) {
   vkDestroySwapchainKHR(r->device, r->swapchain, NULL);
 }
 
+// gives up on a frame after its image was acquired. the slot's semaphore was
+// signalled for nobody and its fence may never be, so they're made again,
+// and the image is let go of with the swapchain. its input was never shown
+static void abandonFrame(Renderer r) {
+  r->inputArrived[r->currentFrame] = 0;
+  vkDeviceWaitIdle(r->device);
+  struct SyncObjects *sync = &r->syncObjects[r->currentFrame];
+  vkDestroySemaphore(r->device, sync->imageAvailable, NULL);
+  vkDestroySemaphore(r->device, sync->renderFinished, NULL);
+  vkDestroyFence(r->device, sync->inFlight, NULL);
+  *sync = makeVkSyncObjects(r->device);
+  recreateSwapchain(r);
+}
+
 static void renderFrame(Renderer r) {
   // wait for previous frame to finish
   vkWaitForFences(r->device, 1, &r->syncObjects[r->currentFrame].inFlight,
                   VK_TRUE, UINT64_MAX);
 
+  // the frame that last used this slot is done, what input it showed is on
+  // its way to the screen
+  inputPresented(r->input, r->inputArrived[r->currentFrame], clockNanos());
+  r->inputArrived[r->currentFrame] = 0;
+
   // get next image to render to
   uint32_t imageIndex;
   VkResult result =
@@ -181,12 +316,25 @@ static void renderFrame(Renderer r) {
     recreateSwapchain(r);
     return;
   } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-    die("failed to acquire swap chain image!: %d\n", result);
+    frameFailed("vkAcquireNextImageKHR", result);
+    return;
+  }
+
+  // input since the last frame, then let layers update this frame's buffers,
+  // the gpu is done with them
+  r->inputArrived[r->currentFrame] = inputDispatch(r->input, dispatchInput, r);
+  double time = glfwGetTime();
+  for (int i = 0; i < r->layerCount; i++) {
+    if (r->layers[i].prepare) {
+      r->layers[i].prepare(r->layers[i].state, r->currentFrame, time);
+    }
   }
 
   // record command buffer
-  vkResetFences(r->device, 1, &r->syncObjects[r->currentFrame].inFlight);
-  recordCommandBuffer(r, imageIndex);
+  if (!recordCommandBuffer(r, imageIndex, time)) {
+    abandonFrame(r);
+    return;
+  }
 
   // submit command buffer
   VkSubmitInfo submitInfo = {0};
@@ -207,12 +355,13 @@ static void renderFrame(Renderer r) {
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
+  vkResetFences(r->device, 1, &r->syncObjects[r->currentFrame].inFlight);
   result = vkQueueSubmit(r->queue, 1, &submitInfo,
                          r->syncObjects[r->currentFrame].inFlight);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-    recreateSwapchain(r);
-  } else if (result != VK_SUCCESS) {
-    die("Failed to submit draw command buffer: %d\n", result);
+  if (result != VK_SUCCESS) {
+    frameFailed("vkQueueSubmit", result);
+    abandonFrame(r);
+    return;
   }
 
   // present image
@@ -227,20 +376,29 @@ static void renderFrame(Renderer r) {
   presentInfo.pImageIndices = &imageIndex;
   presentInfo.pResults = NULL;
 
-  vkQueuePresentKHR(r->queue, &presentInfo);
+  // an out of date swapchain is caught by the next acquire
+  result = vkQueuePresentKHR(r->queue, &presentInfo);
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR &&
+      result != VK_ERROR_OUT_OF_DATE_KHR) {
+    frameFailed("vkQueuePresentKHR", result);
+  }
   r->currentFrame = (r->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-static void render(Renderer r) {
-  while (r->running) {
+static void *render(void *arg) {
+  Renderer r = arg;
+  logThreadEnter("render");
+  while (atomic_load_explicit(&r->running, memory_order_acquire)) {
     renderFrame(r);
   }
+  logThreadLeave();
+  return NULL;
 }
 
 Renderer makeRenderer(char *title, int width, int height,
                       struct Vertex *vertices, int vertexCount) {
   Renderer r = malloc(sizeof(struct Renderer));
-  r->running = 1;
+  atomic_init(&r->running, 1);
   r->currentFrame = 0;
   r->vertices = vertices;
   r->vertexCount = vertexCount;
@@ -248,6 +406,11 @@ Renderer makeRenderer(char *title, int width, int height,
   r->width = width;
   r->height = height;
   r->resized = 0;
+  atomic_init(&r->windowWidth, width);
+  atomic_init(&r->windowHeight, height);
+  r->layerCount = 0;
+  r->input = makeInput(INPUT_CAPACITY);
+  r->inputArrived = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint64_t));
 
   // init windowing lib
   if (glfwInit() != GLFW_TRUE) {
@@ -271,8 +434,16 @@ Renderer makeRenderer(char *title, int width, int height,
   // resize callback
   glfwSetWindowUserPointer(r->window, r);
   glfwSetFramebufferSizeCallback(r->window, framebufferResizeCallback);
+  glfwSetWindowSizeCallback(r->window, windowSizeCallback);
   glfwGetFramebufferSize(r->window, &r->width, &r->height);
 
+  // input
+  glfwSetCursorPosCallback(r->window, cursorPosCallback);
+  glfwSetMouseButtonCallback(r->window, mouseButtonCallback);
+  glfwSetScrollCallback(r->window, scrollCallback);
+  glfwSetKeyCallback(r->window, keyCallback);
+  glfwSetCharCallback(r->window, charCallback);
+
   // vulkan
   r->instance = makeVkInstance(r->title);
   r->surface = makeVkSurface(r->instance, r->window);
@@ -329,12 +500,14 @@ void mainLoop(Renderer r) {
 #ifndef SEPARATE_RENDER_THREAD
   pthread_t renderThread;
 
-  pthread_create(&renderThread, NULL, (void *(*)(void *))render, r);
+  pthread_create(&renderThread, NULL, render, r);
+  // the callbacks queue input for the render thread, nothing to do here
+  // until the next event
   while (!glfwWindowShouldClose(r->window)) {
-    glfwPollEvents(); // TODO: event handling
+    glfwWaitEvents();
   }
 
-  r->running = 0;
+  atomic_store_explicit(&r->running, 0, memory_order_release);
   pthread_join(renderThread, NULL);
 #else
   (void)render;
@@ -344,7 +517,7 @@ void mainLoop(Renderer r) {
     renderFrame(r);
   }
 
-  r->running = 0;
+  atomic_store_explicit(&r->running, 0, memory_order_release);
 #endif
 }
 
@@ -352,12 +525,17 @@ void freeRenderer(Renderer r) {
   vkDeviceWaitIdle(r->device);
   cleanupSwapchain(r);
 
+  // layers
+  for (int i = 0; i < r->layerCount; i++) {
+    r->layers[i].destroy(r->layers[i].state);
+  }
+
   // vertexBuffer
   vkDestroyBuffer(r->device, r->vertexBuffer, NULL);
   vkFreeMemory(r->device, r->vertexMemory, NULL);
 
   // sync objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(r->device, r->syncObjects[i].imageAvailable, NULL);
     vkDestroySemaphore(r->device, r->syncObjects[i].renderFinished, NULL);
     vkDestroyFence(r->device, r->syncObjects[i].inFlight, NULL);
@@ -382,4 +560,25 @@ void freeRenderer(Renderer r) {
   // window
   glfwDestroyWindow(r->window);
   glfwTerminate();
+  freeInput(r->input);
+  free(r->inputArrived);
+}
+
+struct RenderContext rendererContext(Renderer r) {
+  return (struct RenderContext){
+      .physicalDevice = r->physicalDevice,
+      .device = r->device,
+      .renderPass = r->renderPass,
+      .swapchainSettings = r->swapchainSettings,
+      .framesInFlight = MAX_FRAMES_IN_FLIGHT,
+  };
+}
+
+Input rendererInput(Renderer r) { return r->input; }
+
+void rendererAddLayer(Renderer r, struct Layer layer) {
+  if (r->layerCount == MAX_LAYERS) {
+    die("Too many renderer layers\n");
+  }
+  r->layers[r->layerCount++] = layer;
 }
@@ -1,13 +1,57 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include "input.h"
 #include "vertex.h"
+#include "vk.h"
+#include <stdatomic.h>
+#include <stdint.h>
 
 typedef struct Renderer *Renderer;
 
+// what a layer needs to build its pipelines and buffers
+struct RenderContext {
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkRenderPass renderPass;
+  struct SwapchainSettings swapchainSettings;
+  int framesInFlight;
+};
+
+// drawn over the base geometry every frame, in the order added. everything
+// runs on the render thread. `frame` is the frame in flight being recorded,
+// the gpu is done with whatever that slot held before. `time` is in seconds
+// since the renderer started, `size` is the window in screen coordinates.
+struct Layer {
+  void *state;
+  // outside the render pass, optional
+  void (*prepare)(void *state, int frame, double time);
+  void (*record)(void *state, VkCommandBuffer commandBuffer, int frame,
+                 double time, struct Vec2 size);
+  // before prepare, optional. input reaches the topmost layer first, returns
+  // 1 if it took the event and the layers below shouldn't see it
+  int (*input)(void *state, const struct InputEvent *e);
+  // once the device is idle
+  void (*destroy)(void *state);
+};
+
+// the stretch of the timeline a layer shows, in samples. the ui scrolls and
+// zooms by storing new values, layers read them every frame
+struct TimelineView {
+  _Atomic uint64_t start;
+  _Atomic uint64_t end;
+};
+
 Renderer makeRenderer(char *title, int width, int height,
                       struct Vertex *vertices, int vertexCount);
 void mainLoop(Renderer r);
 void freeRenderer(Renderer r);
 
+// call before mainLoop
+struct RenderContext rendererContext(Renderer r);
+void rendererAddLayer(Renderer r, struct Layer layer);
+
+// the window's input, for its latency once the loop is over
+Input rendererInput(Renderer r);
+
 #endif
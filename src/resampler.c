@@ -0,0 +1,243 @@
+#include "resampler.h"
+
+#include "dsp.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ratios like 44100 -> 48000 reduce to 160/147, anything needing more phases
+// than this is almost certainly a typo'd rate
+#define MAX_PHASES 4096
+
+struct QualitySettings {
+  int taps;
+  double rolloff; // passband edge relative to the lower nyquist
+  double beta;    // kaiser window shape
+};
+
+static const struct QualitySettings qualities[] = {
+    [RESAMPLER_LOW] = {8, 0.80, 5.0},
+    [RESAMPLER_MEDIUM] = {16, 0.88, 6.5},
+    [RESAMPLER_HIGH] = {32, 0.92, 8.5},
+    [RESAMPLER_BEST] = {64, 0.95, 10.0},
+};
+
+struct FilterBank {
+  int up, down; // reduced ratio, up phases stepping `down` per output
+  enum ResamplerQuality quality;
+  int taps;
+  float *coefficients; // up rows of taps, row p is phase p/up
+  int references;
+  struct FilterBank *next;
+};
+
+struct Resampler {
+  struct FilterBank *bank;
+  int channels;
+  int taps;
+
+  // per channel history, `filled` frames valid, output reads from `position`
+  float **history;
+  int capacity;
+  int filled;
+  int position;
+  int phase;
+};
+
+// FILTER BANKS
+
+static pthread_mutex_t banksLock = PTHREAD_MUTEX_INITIALIZER;
+static struct FilterBank *banks = NULL;
+
+static int gcd(int a, int b) {
+  while (b) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// modified bessel function of the first kind, order zero
+static double besselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+static void designBank(struct FilterBank *b) {
+  struct QualitySettings q = qualities[b->quality];
+  int taps = q.taps;
+  double ratio = b->up < b->down ? (double)b->up / b->down : 1.0;
+  double cutoff = ratio * q.rolloff;
+  double half = taps / 2.0;
+  double norm = besselI0(q.beta);
+
+  // tap k of phase p sits at time k - (taps/2 - 1) - p/up input samples from
+  // the output, the window spans the whole kernel
+  for (int p = 0; p < b->up; p++) {
+    float *row = b->coefficients + (size_t)p * taps;
+    double sum = 0;
+    for (int k = 0; k < taps; k++) {
+      double t = k - (half - 1) - (double)p / b->up;
+      double x = cutoff * t;
+      double sinc = fabs(x) < 1e-9 ? 1.0 : sin(DSP_PI * x) / (DSP_PI * x);
+      double w = t / half;
+      double window =
+          fabs(w) >= 1.0 ? 0.0 : besselI0(q.beta * sqrt(1 - w * w)) / norm;
+      row[k] = (float)(cutoff * sinc * window);
+      sum += row[k];
+    }
+
+    // unity gain at dc for every phase, otherwise it buzzes at the ratio
+    for (int k = 0; k < taps; k++) {
+      row[k] = (float)(row[k] / sum);
+    }
+  }
+}
+
+static struct FilterBank *acquireBank(int up, int down,
+                                      enum ResamplerQuality quality) {
+  pthread_mutex_lock(&banksLock);
+
+  struct FilterBank *b = banks;
+  while (b && !(b->up == up && b->down == down && b->quality == quality)) {
+    b = b->next;
+  }
+  if (!b) {
+    b = malloc(sizeof(struct FilterBank));
+    b->up = up;
+    b->down = down;
+    b->quality = quality;
+    b->taps = qualities[quality].taps;
+    b->coefficients = malloc((size_t)up * b->taps * sizeof(float));
+    b->references = 0;
+    designBank(b);
+    b->next = banks;
+    banks = b;
+  }
+  b->references++;
+
+  pthread_mutex_unlock(&banksLock);
+  return b;
+}
+
+static void releaseBank(struct FilterBank *b) {
+  pthread_mutex_lock(&banksLock);
+  if (--b->references == 0) {
+    struct FilterBank **link = &banks;
+    while (*link != b) {
+      link = &(*link)->next;
+    }
+    *link = b->next;
+    free(b->coefficients);
+    free(b);
+  }
+  pthread_mutex_unlock(&banksLock);
+}
+
+// PUBLIC FUNCTIONS
+
+Resampler makeResampler(int inRate, int outRate, int channels, int maxBlock,
+                        enum ResamplerQuality quality) {
+  int g = gcd(inRate, outRate);
+  int up = outRate / g;
+  int down = inRate / g;
+  if (up > MAX_PHASES) {
+    return NULL;
+  }
+
+  Resampler r = malloc(sizeof(struct Resampler));
+  r->bank = acquireBank(up, down, quality);
+  r->channels = channels;
+  r->taps = r->bank->taps;
+
+  // enough for a full kernel plus the input of the largest block
+  r->capacity = r->taps + (int)((long)maxBlock * down / up) + 2;
+  r->history = malloc(channels * sizeof(float *));
+  for (int ch = 0; ch < channels; ch++) {
+    r->history[ch] = calloc(r->capacity, sizeof(float));
+  }
+  resamplerReset(r);
+  return r;
+}
+
+void freeResampler(Resampler r) {
+  for (int ch = 0; ch < r->channels; ch++) {
+    free(r->history[ch]);
+  }
+  free(r->history);
+  releaseBank(r->bank);
+  free(r);
+}
+
+void resamplerReset(Resampler r) {
+  // start with a kernel's worth of silence so the first output is valid
+  for (int ch = 0; ch < r->channels; ch++) {
+    memset(r->history[ch], 0, r->capacity * sizeof(float));
+  }
+  r->filled = r->taps - 1;
+  r->position = 0;
+  r->phase = 0;
+}
+
+int resamplerInputFrames(Resampler r, int outFrames) {
+  if (outFrames <= 0) {
+    return 0;
+  }
+  struct FilterBank *b = r->bank;
+  long last = r->position + ((long)r->phase + (long)(outFrames - 1) * b->down) /
+                                b->up;
+  long needed = last + r->taps - r->filled;
+  return needed > 0 ? (int)needed : 0;
+}
+
+int resamplerProcess(Resampler r, const float *const *in, int inFrames,
+                     float *const *out, int outFrames) {
+  struct FilterBank *b = r->bank;
+
+  // append the new input, dropping whatever nothing will read again
+  if (r->position > 0) {
+    for (int ch = 0; ch < r->channels; ch++) {
+      memmove(r->history[ch], r->history[ch] + r->position,
+              (r->filled - r->position) * sizeof(float));
+    }
+    r->filled -= r->position;
+    r->position = 0;
+  }
+  if (inFrames > r->capacity - r->filled) {
+    inFrames = r->capacity - r->filled;
+  }
+  for (int ch = 0; ch < r->channels; ch++) {
+    memcpy(r->history[ch] + r->filled, in[ch], inFrames * sizeof(float));
+  }
+  r->filled += inFrames;
+
+  // each output is one dot product against the row for its phase
+  int produced = 0;
+  while (produced < outFrames && r->position + r->taps <= r->filled) {
+    const float *row = b->coefficients + (size_t)r->phase * r->taps;
+    for (int ch = 0; ch < r->channels; ch++) {
+      out[ch][produced] = dsp->dot(r->history[ch] + r->position, row, r->taps);
+    }
+    produced++;
+
+    r->phase += b->down;
+    r->position += r->phase / b->up;
+    r->phase %= b->up;
+  }
+  return produced;
+}
+
+int resamplerLatency(Resampler r) {
+  // the primed history puts the kernel centre half a kernel behind the input
+  struct FilterBank *b = r->bank;
+  return (int)lround(r->taps / 2.0 * b->up / b->down);
+}
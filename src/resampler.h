@@ -0,0 +1,31 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+// streaming polyphase sample-rate converter. filter banks are computed once
+// per (ratio, quality) and shared between every resampler using them.
+enum ResamplerQuality {
+  RESAMPLER_LOW,    // 8 taps
+  RESAMPLER_MEDIUM, // 16 taps
+  RESAMPLER_HIGH,   // 32 taps
+  RESAMPLER_BEST,   // 64 taps
+};
+
+typedef struct Resampler *Resampler;
+
+// not real-time safe. maxBlock bounds the output frames per process call.
+// returns NULL if the reduced ratio needs too many phases.
+Resampler makeResampler(int inRate, int outRate, int channels, int maxBlock,
+                        enum ResamplerQuality quality);
+void freeResampler(Resampler r);
+
+// real-time safe. to produce a fixed block of `outFrames`, feed exactly
+// resamplerInputFrames(r, outFrames) input frames to resamplerProcess.
+int resamplerInputFrames(Resampler r, int outFrames);
+int resamplerProcess(Resampler r, const float *const *in, int inFrames,
+                     float *const *out, int outFrames);
+void resamplerReset(Resampler r);
+
+// group delay, in output frames
+int resamplerLatency(Resampler r);
+
+#endif
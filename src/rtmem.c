@@ -0,0 +1,134 @@
+#define _DEFAULT_SOURCE
+#include "rtmem.h"
+
+#include "die.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static _Thread_local int realtime = 0;
+static atomic_flag warnedUnlocked = ATOMIC_FLAG_INIT;
+
+// MEMORY
+
+static size_t pageSize(void) { return (size_t)sysconf(_SC_PAGESIZE); }
+
+static size_t roundToPages(size_t size) {
+  size_t page = pageSize();
+  return (size + page - 1) / page * page;
+}
+
+void *rtAlloc(size_t size) {
+  size = roundToPages(size > 0 ? size : 1);
+
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    die("Failed to map %zu bytes of real-time memory\n", size);
+  }
+
+  // locking needs RLIMIT_MEMLOCK headroom, without it we still prefault and
+  // just hope the pages stay resident
+  if (mlock(memory, size) != 0 && !atomic_flag_test_and_set(&warnedUnlocked)) {
+    fprintf(stderr, "Warning: could not lock real-time memory, raise the "
+                    "memlock limit to avoid page faults on the audio thread\n");
+  }
+
+  // touch every page so it's backed before the audio thread sees it
+  size_t page = pageSize();
+  for (size_t offset = 0; offset < size; offset += page) {
+    ((volatile char *)memory)[offset] = 0;
+  }
+  return memory;
+}
+
+void rtFree(void *memory, size_t size) {
+  if (!memory) {
+    return;
+  }
+  size = roundToPages(size > 0 ? size : 1);
+  munlock(memory, size);
+  munmap(memory, size);
+}
+
+// THREAD MARKING
+
+void rtThreadEnter(void) { realtime = 1; }
+
+void rtThreadLeave(void) { realtime = 0; }
+
+int rtThreadIsRealtime(void) { return realtime; }
+
+// ALLOCATION GUARD
+
+// glibc lets the executable interpose the allocator and exposes the real one
+// as __libc_*, so in debug builds every allocation checks the thread mark
+#if !defined(NDEBUG) && defined(__GLIBC__)
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *memory, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *memory);
+
+static void guard(const char *function) {
+  if (!realtime) {
+    return;
+  }
+  // no stdio here, it may allocate
+  // and nothing to do if it fails, we're aborting anyway
+  static const char prefix[] = "Allocator called from a real-time thread: ";
+  if (write(STDERR_FILENO, prefix, sizeof(prefix) - 1) < 0 ||
+      write(STDERR_FILENO, function, strlen(function)) < 0 ||
+      write(STDERR_FILENO, "\n", 1) < 0) {
+  }
+  abort();
+}
+
+void *malloc(size_t size) {
+  guard("malloc");
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  guard("calloc");
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *memory, size_t size) {
+  guard("realloc");
+  return __libc_realloc(memory, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  guard("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  guard("memalign");
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memory, size_t alignment, size_t size) {
+  guard("posix_memalign");
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1))) {
+    return EINVAL;
+  }
+  void *allocated = __libc_memalign(alignment, size);
+  if (!allocated) {
+    return ENOMEM;
+  }
+  *memory = allocated;
+  return 0;
+}
+
+void free(void *memory) {
+  guard("free");
+  __libc_free(memory);
+}
+#endif
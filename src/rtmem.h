@@ -0,0 +1,19 @@
+#ifndef RTMEM_H
+#define RTMEM_H
+
+#include <stddef.h>
+
+// page-aligned memory that is locked into ram and touched up front, so the
+// audio thread never takes a page fault on it. allocating and freeing it is
+// NOT real-time safe, do it while setting up.
+void *rtAlloc(size_t size);
+void rtFree(void *memory, size_t size);
+
+// mark the calling thread as real-time. in debug builds on glibc, any call to
+// malloc, calloc, realloc, aligned_alloc, posix_memalign, memalign or free
+// from a marked thread aborts.
+void rtThreadEnter(void);
+void rtThreadLeave(void);
+int rtThreadIsRealtime(void);
+
+#endif
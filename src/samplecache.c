@@ -0,0 +1,486 @@
+#define _POSIX_C_SOURCE 200809L
+#include "samplecache.h"
+
+#include "audiofile.h"
+#include "dsp.h"
+#include "hash.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// frames decoded at a time, and bytes hashed at a time
+#define DECODE_FRAMES 4096
+#define HASH_BYTES 65536
+
+struct Sample {
+  SampleCache cache;
+  uint64_t hash;
+  int refs;    // under the cache's lock
+  int loading; // decoding, loads of it wait
+  int channelCount;
+  int sampleRate;
+  uint64_t frames;
+  size_t bytes;
+  float *data;
+  float **channels;
+  uint64_t used;    // when it was last let go, the lowest goes first
+  uint64_t retired; // the epoch it was evicted in
+};
+
+// what a path was last time, to tell it hasn't changed without reading it
+struct Path {
+  char *path;
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  struct timespec modified;
+  uint64_t hash;
+};
+
+struct Reader {
+  // the epoch the reader's block began in, 0 between blocks
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t epoch;
+};
+
+struct SampleCache {
+  pthread_mutex_t lock;
+  pthread_cond_t loaded;
+
+  Sample *samples; // cached, including the ones decoding
+  int count, capacity;
+  struct Path *paths;
+  int pathCount, pathCapacity;
+  Sample *retired;
+  int retiredCount, retiredCapacity;
+
+  uint64_t tick;
+  struct SampleCacheStats stats;
+
+  _Atomic uint64_t epoch;
+  struct Reader readers[SAMPLE_CACHE_READERS];
+  int readerTaken[SAMPLE_CACHE_READERS];
+};
+
+// PRIVATE FUNCTIONS
+
+static void freeSample(Sample s) {
+  free(s->data);
+  free(s->channels);
+  free(s);
+}
+
+static void *grow(void *array, int *capacity, size_t size) {
+  *capacity = *capacity ? 2 * *capacity : 16;
+  return realloc(array, *capacity * size);
+}
+
+static Sample findSample(SampleCache c, uint64_t hash) {
+  for (int i = 0; i < c->count; i++) {
+    if (c->samples[i]->hash == hash) {
+      return c->samples[i];
+    }
+  }
+  return NULL;
+}
+
+static struct Path *findPath(SampleCache c, const char *path) {
+  for (int i = 0; i < c->pathCount; i++) {
+    if (strcmp(c->paths[i].path, path) == 0) {
+      return &c->paths[i];
+    }
+  }
+  return NULL;
+}
+
+static int unchanged(const struct Path *p, const struct stat *st) {
+  return p->device == st->st_dev && p->inode == st->st_ino &&
+         p->size == st->st_size &&
+         p->modified.tv_sec == st->st_mtim.tv_sec &&
+         p->modified.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void remember(SampleCache c, const char *path, const struct stat *st,
+                     uint64_t hash) {
+  struct Path *p = findPath(c, path);
+  if (!p) {
+    if (c->pathCount == c->pathCapacity) {
+      c->paths = grow(c->paths, &c->pathCapacity, sizeof(struct Path));
+    }
+    p = &c->paths[c->pathCount++];
+    p->path = strdup(path);
+  }
+  p->device = st->st_dev;
+  p->inode = st->st_ino;
+  p->size = st->st_size;
+  p->modified = st->st_mtim;
+  p->hash = hash;
+}
+
+// 0 if it can't be read
+static int hashFile(const char *path, uint64_t *hash) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return 0;
+  }
+  struct Hasher h;
+  hashStart(&h);
+  char *buffer = malloc(HASH_BYTES);
+  size_t n;
+  while ((n = fread(buffer, 1, HASH_BYTES, f)) > 0) {
+    hashBytes(&h, buffer, n);
+  }
+  int ok = !ferror(f);
+  free(buffer);
+  fclose(f);
+  *hash = hashEnd(&h);
+  return ok;
+}
+
+static int decode(Sample s, AudioFile f) {
+  float *interleaved = malloc(DECODE_FRAMES * s->channelCount * sizeof(float));
+  float **at = malloc(s->channelCount * sizeof(float *));
+  uint64_t frame = 0;
+  while (frame < s->frames) {
+    int n = readAudioFile(f, frame, interleaved, DECODE_FRAMES);
+    if (n <= 0) {
+      break;
+    }
+    for (int ch = 0; ch < s->channelCount; ch++) {
+      at[ch] = s->channels[ch] + frame;
+    }
+    dspDeinterleave(at, interleaved, s->channelCount, n);
+    frame += n;
+  }
+  free(at);
+  free(interleaved);
+  return frame == s->frames;
+}
+
+static void take(Sample s) {
+  if (s->refs++ == 0) {
+    s->cache->stats.usedBytes += s->bytes;
+  }
+}
+
+static void removeSample(SampleCache c, Sample s) {
+  for (int i = 0; i < c->count; i++) {
+    if (c->samples[i] == s) {
+      c->samples[i] = c->samples[--c->count];
+      break;
+    }
+  }
+  c->stats.bytes -= s->bytes;
+}
+
+// the least recently used sample nothing holds, off to be freed once the
+// readers are past it. 0 if there's none
+static int evict(SampleCache c) {
+  Sample oldest = NULL;
+  for (int i = 0; i < c->count; i++) {
+    Sample s = c->samples[i];
+    if (s->refs == 0 && !s->loading && (!oldest || s->used < oldest->used)) {
+      oldest = s;
+    }
+  }
+  if (!oldest) {
+    return 0;
+  }
+  removeSample(c, oldest);
+  // a reader that began its block in this epoch or earlier may have it, the
+  // ones beginning after the increment can't
+  oldest->retired =
+      atomic_fetch_add_explicit(&c->epoch, 1, memory_order_seq_cst);
+  if (c->retiredCount == c->retiredCapacity) {
+    c->retired = grow(c->retired, &c->retiredCapacity, sizeof(Sample));
+  }
+  c->retired[c->retiredCount++] = oldest;
+  c->stats.retiredBytes += oldest->bytes;
+  c->stats.evictions++;
+  return 1;
+}
+
+// the sample cached for `hash`, once it's done loading. under the lock
+static Sample await(SampleCache c, uint64_t hash) {
+  Sample s = findSample(c, hash);
+  while (s && s->loading) {
+    pthread_cond_wait(&c->loaded, &c->lock);
+    s = findSample(c, hash);
+  }
+  return s;
+}
+
+// a sample for `hash` that others wait on while it's filled in, its bytes
+// counted against the budget. NULL if they don't fit with every unused
+// sample gone. under the lock
+static Sample reserve(SampleCache c, uint64_t hash, int channels,
+                      int sampleRate, uint64_t frames) {
+  size_t bytes = (size_t)frames * channels * sizeof(float);
+  while (c->stats.bytes + bytes > c->stats.budget && evict(c)) {
+  }
+  if (c->stats.bytes + bytes > c->stats.budget) {
+    c->stats.refused++;
+    return NULL;
+  }
+
+  Sample s = calloc(1, sizeof(struct Sample));
+  s->cache = c;
+  s->hash = hash;
+  s->loading = 1;
+  s->channelCount = channels;
+  s->sampleRate = sampleRate;
+  s->frames = frames;
+  s->bytes = bytes;
+  if (c->count == c->capacity) {
+    c->samples = grow(c->samples, &c->capacity, sizeof(Sample));
+  }
+  c->samples[c->count++] = s;
+  c->stats.bytes += bytes;
+  return s;
+}
+
+// outside the lock
+static void allocate(Sample s) {
+  s->data = malloc(s->bytes ? s->bytes : sizeof(float));
+  s->channels = malloc(s->channelCount * sizeof(float *));
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    s->channels[ch] = s->data + (size_t)ch * s->frames;
+  }
+}
+
+// a reserved sample is filled in, or failed to be. wakes whoever waits on
+// it, under the lock
+static void settle(SampleCache c, Sample s, int filled) {
+  s->loading = 0;
+  if (filled) {
+    take(s);
+    c->stats.misses++;
+  } else {
+    removeSample(c, s);
+  }
+  pthread_cond_broadcast(&c->loaded);
+}
+
+// PUBLIC FUNCTIONS
+
+SampleCache makeSampleCache(size_t budget) {
+  SampleCache c = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct SampleCache));
+  memset(c, 0, sizeof(struct SampleCache));
+  pthread_mutex_init(&c->lock, NULL);
+  pthread_cond_init(&c->loaded, NULL);
+  c->stats.budget = budget;
+  atomic_init(&c->epoch, 1);
+  for (int r = 0; r < SAMPLE_CACHE_READERS; r++) {
+    atomic_init(&c->readers[r].epoch, 0);
+  }
+  return c;
+}
+
+void freeSampleCache(SampleCache c) {
+  for (int i = 0; i < c->count; i++) {
+    freeSample(c->samples[i]);
+  }
+  for (int i = 0; i < c->retiredCount; i++) {
+    freeSample(c->retired[i]);
+  }
+  for (int i = 0; i < c->pathCount; i++) {
+    free(c->paths[i].path);
+  }
+  free(c->samples);
+  free(c->retired);
+  free(c->paths);
+  pthread_cond_destroy(&c->loaded);
+  pthread_mutex_destroy(&c->lock);
+  free(c);
+}
+
+Sample sampleCacheLoad(SampleCache c, const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return NULL;
+  }
+
+  // a path seen before and not touched since needn't be read at all
+  pthread_mutex_lock(&c->lock);
+  struct Path *known = findPath(c, path);
+  Sample s = known && unchanged(known, &st) ? await(c, known->hash) : NULL;
+  if (s) {
+    take(s);
+    c->stats.hits++;
+    pthread_mutex_unlock(&c->lock);
+    return s;
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  uint64_t hash;
+  AudioFile f = hashFile(path, &hash) ? openAudioFile(path) : NULL;
+  if (!f) {
+    return NULL;
+  }
+  struct AudioFormat format = audioFileFormat(f);
+
+  pthread_mutex_lock(&c->lock);
+  s = await(c, hash);
+  if (s) {
+    // the same bytes under another name, or a load that raced this one
+    take(s);
+    remember(c, path, &st, hash);
+    c->stats.hits++;
+    c->stats.shared += known == NULL || known->hash != hash;
+    pthread_mutex_unlock(&c->lock);
+    closeAudioFile(f);
+    return s;
+  }
+
+  s = reserve(c, hash, format.channels, format.sampleRate, format.frames);
+  pthread_mutex_unlock(&c->lock);
+  if (!s) {
+    closeAudioFile(f);
+    return NULL;
+  }
+
+  // decoded outside the lock, others asking for it wait
+  allocate(s);
+  int decoded = decode(s, f);
+  closeAudioFile(f);
+
+  pthread_mutex_lock(&c->lock);
+  if (decoded) {
+    remember(c, path, &st, hash);
+  }
+  settle(c, s, decoded);
+  pthread_mutex_unlock(&c->lock);
+
+  if (!decoded) {
+    freeSample(s);
+    return NULL;
+  }
+  return s;
+}
+
+Sample sampleCacheDerive(SampleCache c, uint64_t key, int channels,
+                         int sampleRate, uint64_t frames, SampleRender render,
+                         void *state) {
+  pthread_mutex_lock(&c->lock);
+  Sample s = await(c, key);
+  if (s) {
+    take(s);
+    c->stats.hits++;
+    pthread_mutex_unlock(&c->lock);
+    return s;
+  }
+  s = reserve(c, key, channels, sampleRate, frames);
+  pthread_mutex_unlock(&c->lock);
+  if (!s) {
+    return NULL;
+  }
+
+  allocate(s);
+  int rendered = render(state, s->channels, frames);
+
+  pthread_mutex_lock(&c->lock);
+  settle(c, s, rendered);
+  pthread_mutex_unlock(&c->lock);
+  if (!rendered) {
+    freeSample(s);
+    return NULL;
+  }
+  return s;
+}
+
+void sampleRetain(Sample s) {
+  pthread_mutex_lock(&s->cache->lock);
+  take(s);
+  pthread_mutex_unlock(&s->cache->lock);
+}
+
+void sampleRelease(Sample s) {
+  SampleCache c = s->cache;
+  pthread_mutex_lock(&c->lock);
+  if (--s->refs == 0) {
+    c->stats.usedBytes -= s->bytes;
+    s->used = ++c->tick;
+  }
+  pthread_mutex_unlock(&c->lock);
+}
+
+int sampleChannelCount(Sample s) { return s->channelCount; }
+
+int sampleSampleRate(Sample s) { return s->sampleRate; }
+
+uint64_t sampleFrames(Sample s) { return s->frames; }
+
+const float *sampleChannel(Sample s, int channel) {
+  return s->channels[channel];
+}
+
+uint64_t sampleHash(Sample s) { return s->hash; }
+
+int sampleCacheAddReader(SampleCache c) {
+  pthread_mutex_lock(&c->lock);
+  int reader = -1;
+  for (int r = 0; r < SAMPLE_CACHE_READERS && reader < 0; r++) {
+    if (!c->readerTaken[r]) {
+      c->readerTaken[r] = 1;
+      reader = r;
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+  return reader;
+}
+
+void sampleCacheRemoveReader(SampleCache c, int reader) {
+  pthread_mutex_lock(&c->lock);
+  atomic_store(&c->readers[reader].epoch, 0);
+  c->readerTaken[reader] = 0;
+  pthread_mutex_unlock(&c->lock);
+}
+
+void sampleCacheEnter(SampleCache c, int reader) {
+  // seq_cst, so the eviction either sees this or the reader sees the epoch
+  // it bumped, and with it a sample that's no longer reachable
+  uint64_t epoch = atomic_load(&c->epoch);
+  atomic_store(&c->readers[reader].epoch, epoch);
+}
+
+void sampleCacheLeave(SampleCache c, int reader) {
+  atomic_store_explicit(&c->readers[reader].epoch, 0, memory_order_release);
+}
+
+size_t sampleCacheCollect(SampleCache c) {
+  pthread_mutex_lock(&c->lock);
+  // the oldest epoch a reader is still in
+  uint64_t oldest = UINT64_MAX;
+  for (int r = 0; r < SAMPLE_CACHE_READERS; r++) {
+    uint64_t epoch = atomic_load(&c->readers[r].epoch);
+    if (epoch && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+
+  size_t freed = 0;
+  for (int i = 0; i < c->retiredCount;) {
+    Sample s = c->retired[i];
+    if (s->retired < oldest) {
+      freed += s->bytes;
+      freeSample(s);
+      c->retired[i] = c->retired[--c->retiredCount];
+    } else {
+      i++;
+    }
+  }
+  c->stats.retiredBytes -= freed;
+  pthread_mutex_unlock(&c->lock);
+  return freed;
+}
+
+struct SampleCacheStats sampleCacheStats(SampleCache c) {
+  pthread_mutex_lock(&c->lock);
+  struct SampleCacheStats stats = c->stats;
+  stats.samples = c->count;
+  pthread_mutex_unlock(&c->lock);
+  return stats;
+}
@@ -0,0 +1,85 @@
+#ifndef SAMPLECACHE_H
+#define SAMPLECACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// decoded audio shared between clips. a file is decoded once, into planar
+// floats, and every clip that plays it holds a reference to the same sample.
+// samples are keyed by a hash of the file's bytes, so copies of a file under
+// other names share one too. samples no clip holds stay cached, oldest used
+// first out, for as long as they fit the memory budget.
+//
+// the audio thread reads samples without taking references. it marks the
+// blocks it reads them in, and an evicted sample is only freed once every
+// block that might have seen it is over.
+typedef struct SampleCache *SampleCache;
+typedef struct Sample *Sample;
+
+// readers are audio threads, each marks its blocks through a slot of its own
+#define SAMPLE_CACHE_READERS 8
+
+struct SampleCacheStats {
+  uint64_t hits;       // loads that found the audio already decoded
+  uint64_t shared;     // of which through another file with the same bytes
+  uint64_t misses;     // loads that decoded or rendered it
+  uint64_t refused;    // loads that didn't fit the budget
+  uint64_t evictions;  // unused samples dropped to make room
+  size_t budget;       // bytes of decoded audio kept at most
+  size_t bytes;        // decoded audio cached, in use or not
+  size_t usedBytes;    // of which clips hold references to
+  size_t retiredBytes; // evicted, waiting for readers to move on
+  int samples;
+};
+
+SampleCache makeSampleCache(size_t budget);
+// every sample released and no reader in a block
+void freeSampleCache(SampleCache c);
+
+// any thread but the audio thread. returns a new reference, NULL if the file
+// can't be read or decoding it would take the cache over budget with every
+// unused sample gone, in which case the clip had better be streamed. a file
+// another thread is decoding is waited for, not decoded again
+Sample sampleCacheLoad(SampleCache c, const char *path);
+
+// fills in the channels of a derived sample, returns 0 if it couldn't
+typedef int (*SampleRender)(void *state, float *const *channels,
+                            uint64_t frames);
+
+// any thread but the audio thread. audio worked out from other audio, cached
+// alongside decoded files under a key that hashes everything it depends on.
+// a miss renders it on the calling thread, otherwise as sampleCacheLoad
+Sample sampleCacheDerive(SampleCache c, uint64_t key, int channels,
+                         int sampleRate, uint64_t frames, SampleRender render,
+                         void *state);
+
+// any thread but the audio thread. a sample nothing holds stays cached until
+// evicted
+void sampleRetain(Sample s);
+void sampleRelease(Sample s);
+
+// any thread. channels are planar, valid while a reference is held, or on
+// the audio thread for the rest of the block it was reached in
+int sampleChannelCount(Sample s);
+int sampleSampleRate(Sample s);
+uint64_t sampleFrames(Sample s);
+const float *sampleChannel(Sample s, int channel);
+uint64_t sampleHash(Sample s);
+
+// READERS
+
+// setup. a slot for an audio thread, -1 if they're all taken
+int sampleCacheAddReader(SampleCache c);
+void sampleCacheRemoveReader(SampleCache c, int reader);
+
+// audio thread, real-time safe. around every block that reads samples
+void sampleCacheEnter(SampleCache c, int reader);
+void sampleCacheLeave(SampleCache c, int reader);
+
+// housekeeping thread. frees evicted samples no reader can still see,
+// returns how many bytes. call regularly
+size_t sampleCacheCollect(SampleCache c);
+
+struct SampleCacheStats sampleCacheStats(SampleCache c);
+
+#endif
@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200809L
+#include "scheduler.h"
+
+#include "deque.h"
+#include "die.h"
+#include "log.h"
+#include "rtmem.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how long an idle worker spins, then yields, before it starts sleeping
+#define SPIN_ITERATIONS 2000
+#define YIELD_ITERATIONS 20000
+#define IDLE_SLEEP_NANOS 50000
+
+struct Worker {
+  _Alignas(CACHE_LINE_SIZE) Deque deque;
+  int *ready;
+  Arena scratch;
+  unsigned random;
+  int index;
+  pthread_t thread;
+  Scheduler scheduler;
+};
+
+struct Scheduler {
+  // one cache line per field, these are hammered from every worker
+  _Alignas(CACHE_LINE_SIZE) atomic_uint epoch;
+  _Alignas(CACHE_LINE_SIZE) atomic_int remaining;
+  _Alignas(CACHE_LINE_SIZE) _Atomic(CompiledGraph) graph;
+  _Alignas(CACHE_LINE_SIZE) atomic_int running;
+
+  int workerCount;
+  int maxNodes;
+  struct Worker *workers;
+};
+
+// PRIVATE FUNCTIONS
+
+static void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static void idle(int iteration) {
+  if (iteration < SPIN_ITERATIONS) {
+    cpuRelax();
+  } else if (iteration < YIELD_ITERATIONS) {
+    sched_yield();
+  } else {
+    struct timespec ts = {0, IDLE_SLEEP_NANOS};
+    nanosleep(&ts, NULL);
+  }
+}
+
+static int findTask(Scheduler s, struct Worker *w) {
+  int task = dequePop(w->deque);
+  if (task >= 0) {
+    return task;
+  }
+
+  // steal, starting from a random victim so thieves spread out
+  w->random = w->random * 1103515245u + 12345u;
+  int start = (w->random >> 16) % s->workerCount;
+  for (int i = 0; i < s->workerCount; i++) {
+    int victim = (start + i) % s->workerCount;
+    if (victim == w->index) {
+      continue;
+    }
+    task = dequeSteal(s->workers[victim].deque);
+    if (task >= 0) {
+      return task;
+    }
+  }
+  return DEQUE_EMPTY;
+}
+
+static void work(Scheduler s, struct Worker *w) {
+  int misses = 0;
+  while (atomic_load_explicit(&s->remaining, memory_order_acquire) > 0) {
+    int task = findTask(s, w);
+    if (task < 0) {
+      // never sleep mid-block, but yield in case whoever holds the
+      // remaining work was preempted onto our core
+      if (++misses < SPIN_ITERATIONS) {
+        cpuRelax();
+      } else {
+        sched_yield();
+      }
+      continue;
+    }
+    misses = 0;
+
+    CompiledGraph g = atomic_load_explicit(&s->graph, memory_order_acquire);
+    int readyCount = compiledRunTask(g, task, w->index, w->scratch, w->ready);
+    for (int i = 0; i < readyCount; i++) {
+      dequePush(w->deque, w->ready[i]);
+    }
+    atomic_fetch_sub_explicit(&s->remaining, 1, memory_order_acq_rel);
+  }
+}
+
+static void promoteToRealtime(pthread_t thread) {
+  // best effort, needs privileges (rtprio on linux). without them the
+  // workers still run, just at normal priority
+  struct sched_param param = {0};
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+  pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+static void *workerMain(void *arg) {
+  struct Worker *w = arg;
+  Scheduler s = w->scheduler;
+  unsigned seen = 0;
+  char name[16];
+  snprintf(name, sizeof(name), "worker %d", w->index);
+  logThreadEnter(name);
+  rtThreadEnter();
+
+  while (1) {
+    // wait for the next block
+    for (int i = 0;
+         atomic_load_explicit(&s->epoch, memory_order_acquire) == seen; i++) {
+      if (!atomic_load_explicit(&s->running, memory_order_acquire)) {
+        // thread teardown frees, and is allowed to
+        rtThreadLeave();
+        logThreadLeave();
+        return NULL;
+      }
+      idle(i);
+    }
+    seen = atomic_load_explicit(&s->epoch, memory_order_acquire);
+    work(s, w);
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Scheduler makeScheduler(int workers, int maxNodes, int realtime) {
+  if (workers < 1) {
+    workers = 1;
+  }
+
+  Scheduler s = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Scheduler));
+  if (!s) {
+    die("Failed to allocate scheduler\n");
+  }
+  memset(s, 0, sizeof(struct Scheduler));
+  atomic_init(&s->epoch, 0);
+  atomic_init(&s->remaining, 0);
+  atomic_init(&s->graph, NULL);
+  atomic_init(&s->running, 1);
+  s->workerCount = workers;
+  s->maxNodes = maxNodes;
+
+  s->workers = aligned_alloc(CACHE_LINE_SIZE, workers * sizeof(struct Worker));
+  if (!s->workers) {
+    die("Failed to allocate scheduler workers\n");
+  }
+  memset(s->workers, 0, workers * sizeof(struct Worker));
+  for (int i = 0; i < workers; i++) {
+    struct Worker *w = &s->workers[i];
+    w->deque = makeDeque(maxNodes);
+    w->ready = malloc((maxNodes > 0 ? maxNodes : 1) * sizeof(int));
+    w->scratch = makeArena(SCHEDULER_SCRATCH_BYTES);
+    w->random = 2654435761u * (i + 1);
+    w->index = i;
+    w->scheduler = s;
+  }
+
+  // worker 0 is whoever calls schedulerRun
+  for (int i = 1; i < workers; i++) {
+    if (pthread_create(&s->workers[i].thread, NULL, workerMain,
+                       &s->workers[i]) != 0) {
+      die("Failed to start scheduler worker %d\n", i);
+    }
+    if (realtime) {
+      promoteToRealtime(s->workers[i].thread);
+    }
+  }
+
+  return s;
+}
+
+void freeScheduler(Scheduler s) {
+  atomic_store_explicit(&s->running, 0, memory_order_release);
+  for (int i = 1; i < s->workerCount; i++) {
+    pthread_join(s->workers[i].thread, NULL);
+  }
+  for (int i = 0; i < s->workerCount; i++) {
+    freeDeque(s->workers[i].deque);
+    free(s->workers[i].ready);
+    freeArena(s->workers[i].scratch);
+  }
+  free(s->workers);
+  free(s);
+}
+
+int schedulerWorkerCount(Scheduler s) { return s->workerCount; }
+
+void schedulerRun(Scheduler s, CompiledGraph g, int frames, uint64_t position,
+                  int playing) {
+  int n = compiledNodeCount(g);
+  if (n > s->maxNodes) {
+    die("Graph of %d nodes exceeds scheduler capacity %d\n", n, s->maxNodes);
+  }
+  compiledBeginBlock(g, frames, position, playing);
+
+  // a single worker walks the precomputed order, no atomics needed
+  if (s->workerCount == 1) {
+    const int *order = compiledOrder(g);
+    struct Worker *self = &s->workers[0];
+    for (int i = 0; i < n; i++) {
+      compiledRunTask(g, order[i], 0, self->scratch, self->ready);
+    }
+    return;
+  }
+
+  // publish the block, then seed our own deque with the roots
+  struct Worker *self = &s->workers[0];
+  const int *roots;
+  int rootCount = compiledRoots(g, &roots);
+  atomic_store_explicit(&s->graph, g, memory_order_relaxed);
+  atomic_store_explicit(&s->remaining, n, memory_order_relaxed);
+  for (int i = 0; i < rootCount; i++) {
+    dequePush(self->deque, roots[i]);
+  }
+  atomic_fetch_add_explicit(&s->epoch, 1, memory_order_release);
+
+  work(s, self);
+}
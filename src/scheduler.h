@@ -0,0 +1,29 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "graph.h"
+
+// runs compiled graphs one block at a time on a pool of real-time workers.
+// the thread calling schedulerRun (the audio thread) takes part as worker 0,
+// the others steal ready nodes from each other's deques. no locks, and
+// nothing allocates once the scheduler exists.
+typedef struct Scheduler *Scheduler;
+
+// scratch memory each worker keeps for the nodes it runs
+#define SCHEDULER_SCRATCH_BYTES (256 * 1024)
+
+// maxNodes bounds the graphs this scheduler can run, it sizes the deques.
+// realtime workers ask for SCHED_FIFO, offline work should leave them at
+// normal priority so it can't starve the rest of the system
+Scheduler makeScheduler(int workers, int maxNodes, int realtime);
+void freeScheduler(Scheduler s);
+
+int schedulerWorkerCount(Scheduler s);
+
+// process one block of `frames` samples starting at transport `position`,
+// returns once every node ran. the caller should have marked itself with
+// rtThreadEnter
+void schedulerRun(Scheduler s, CompiledGraph g, int frames, uint64_t position,
+                  int playing);
+
+#endif
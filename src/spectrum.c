@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L
+#include "spectrum.h"
+
+#include "dsp.h"
+#include "fft.h"
+#include "spsc.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how long the analysis thread sleeps when there's nothing to do, a hop at
+// 48kHz with the usual sizes is several times this
+#define WAIT_NANOS 1000000
+
+// the ring holds this many windows per channel before writes get dropped
+#define RING_WINDOWS 4
+
+// see meter.c, the same triple buffer state
+#define INDEX_MASK 3u
+#define FRESH 4u
+
+// a point either interpolates between two bins, where bins are wider than
+// points, or takes the loudest bin of its band
+struct Point {
+  int lo, hi;
+  float fraction; // negative for a band
+};
+
+struct Channel {
+  Spsc ring;
+  float *history; // the last fftSize samples
+  int filled;
+  float *shown; // SPECTRUM_POINTS heights, falling
+};
+
+struct Spectrum {
+  int channelCount;
+  int sampleRate;
+  int size;
+  int hop;
+  struct Channel *channels;
+
+  // analysis thread
+  Fft fft;
+  float *window;
+  float *windowed;
+  float *re, *im;
+  struct Point points[SPECTRUM_POINTS];
+  float gainDb; // brings a full scale sine to 0 dB
+  float fall;   // in heights per hop
+
+  // channels * SPECTRUM_POINTS each, analysis owns `back`, ui owns `front`
+  float *buffers[3];
+  _Alignas(CACHE_LINE_SIZE) atomic_uint state;
+  unsigned back;
+  _Alignas(CACHE_LINE_SIZE) unsigned front;
+
+  atomic_int running;
+  pthread_t thread;
+};
+
+// PRIVATE FUNCTIONS
+
+static void backOff(void) {
+  struct timespec wait = {0, WAIT_NANOS};
+  nanosleep(&wait, NULL);
+}
+
+static void mapPoints(Spectrum s) {
+  int bins = s->size / 2;
+  double binHz = (double)s->sampleRate / s->size;
+  double edge = pow(SPECTRUM_HIGH_HZ / SPECTRUM_LOW_HZ,
+                    0.5 / (SPECTRUM_POINTS - 1));
+
+  for (int p = 0; p < SPECTRUM_POINTS; p++) {
+    double hz = spectrumPointHz(p);
+    int lo = (int)ceil(hz / edge / binHz);
+    int hi = (int)floor(hz * edge / binHz);
+    struct Point *point = &s->points[p];
+
+    if (hi > lo) {
+      point->lo = lo;
+      point->hi = hi < bins ? hi : bins;
+      point->fraction = -1;
+    } else {
+      double bin = hz / binHz;
+      point->lo = (int)bin < bins ? (int)bin : bins - 1;
+      point->hi = point->lo + 1;
+      point->fraction = (float)(bin - point->lo);
+    }
+  }
+}
+
+static void analyzeChannel(Spectrum s, struct Channel *c) {
+  for (int i = 0; i < s->size; i++) {
+    s->windowed[i] = c->history[i] * s->window[i];
+  }
+  fftForward(s->fft, s->windowed, s->re, s->im);
+
+  // power only, the log is taken once per point
+  int bins = s->size / 2;
+  for (int k = 0; k <= bins; k++) {
+    s->re[k] = s->re[k] * s->re[k] + s->im[k] * s->im[k];
+  }
+
+  for (int p = 0; p < SPECTRUM_POINTS; p++) {
+    struct Point *point = &s->points[p];
+    float power;
+    if (point->fraction >= 0) {
+      power = s->re[point->lo] +
+              (s->re[point->hi] - s->re[point->lo]) * point->fraction;
+    } else {
+      power = 0;
+      for (int k = point->lo; k <= point->hi; k++) {
+        power = s->re[k] > power ? s->re[k] : power;
+      }
+    }
+
+    float db = 10.0f * log10f(power + 1e-20f) + s->gainDb;
+    float height = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+    height = height < 0 ? 0 : height > 1 ? 1 : height;
+
+    float fallen = c->shown[p] - s->fall;
+    c->shown[p] = height > fallen ? height : fallen;
+  }
+}
+
+static void publish(Spectrum s) {
+  float *out = s->buffers[s->back];
+  for (int c = 0; c < s->channelCount; c++) {
+    memcpy(out + c * SPECTRUM_POINTS, s->channels[c].shown,
+           SPECTRUM_POINTS * sizeof(float));
+  }
+  unsigned previous = atomic_exchange_explicit(&s->state, s->back | FRESH,
+                                               memory_order_acq_rel);
+  s->back = previous & INDEX_MASK;
+}
+
+static void *analyze(void *arg) {
+  Spectrum s = arg;
+  while (atomic_load_explicit(&s->running, memory_order_acquire)) {
+    int analyzed = 0;
+    for (int i = 0; i < s->channelCount; i++) {
+      struct Channel *c = &s->channels[i];
+      while (spscReadable(c->ring) >= (size_t)s->hop) {
+        memmove(c->history, c->history + s->hop,
+                (s->size - s->hop) * sizeof(float));
+        spscRead(c->ring, c->history + s->size - s->hop, s->hop);
+        c->filled += s->hop;
+        if (c->filled >= s->size) {
+          c->filled = s->size;
+          analyzeChannel(s, c);
+          analyzed = 1;
+        }
+      }
+    }
+
+    if (analyzed) {
+      publish(s);
+    } else {
+      backOff();
+    }
+  }
+  return NULL;
+}
+
+// PUBLIC FUNCTIONS
+
+Spectrum makeSpectrum(int channels, int sampleRate, int fftSize, int overlap) {
+  Fft fft = makeFft(fftSize);
+  if (!fft || overlap < 1 || fftSize % overlap) {
+    if (fft) {
+      freeFft(fft);
+    }
+    return NULL;
+  }
+
+  Spectrum s = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Spectrum));
+  memset(s, 0, sizeof(struct Spectrum));
+  s->channelCount = channels;
+  s->sampleRate = sampleRate;
+  s->size = fftSize;
+  s->hop = fftSize / overlap;
+  s->fft = fft;
+
+  s->channels = calloc(channels, sizeof(struct Channel));
+  size_t capacity = (size_t)RING_WINDOWS * fftSize;
+  for (int i = 0; i < channels; i++) {
+    s->channels[i].ring = makeSpsc(sizeof(float), capacity);
+    s->channels[i].history = calloc(fftSize, sizeof(float));
+    s->channels[i].shown = calloc(SPECTRUM_POINTS, sizeof(float));
+  }
+
+  // hann, its coherent gain of one half leaves a sine of amplitude a at
+  // a * size / 4
+  s->window = malloc(fftSize * sizeof(float));
+  for (int i = 0; i < fftSize; i++) {
+    s->window[i] = (float)(0.5 - 0.5 * cos(2 * DSP_PI * i / fftSize));
+  }
+  s->windowed = malloc(fftSize * sizeof(float));
+  s->re = malloc((fftSize / 2 + 1) * sizeof(float));
+  s->im = malloc((fftSize / 2 + 1) * sizeof(float));
+  s->gainDb = -20.0f * log10f(fftSize / 4.0f);
+  s->fall = SPECTRUM_FALL_DB_PER_SECOND / -SPECTRUM_FLOOR_DB *
+            ((float)s->hop / sampleRate);
+  mapPoints(s);
+
+  for (int i = 0; i < 3; i++) {
+    s->buffers[i] = calloc((size_t)channels * SPECTRUM_POINTS, sizeof(float));
+  }
+  s->back = 0;
+  atomic_init(&s->state, 1);
+  s->front = 2;
+
+  atomic_init(&s->running, 1);
+  pthread_create(&s->thread, NULL, analyze, s);
+  return s;
+}
+
+void freeSpectrum(Spectrum s) {
+  atomic_store_explicit(&s->running, 0, memory_order_release);
+  pthread_join(s->thread, NULL);
+
+  for (int i = 0; i < s->channelCount; i++) {
+    freeSpsc(s->channels[i].ring);
+    free(s->channels[i].history);
+    free(s->channels[i].shown);
+  }
+  free(s->channels);
+  for (int i = 0; i < 3; i++) {
+    free(s->buffers[i]);
+  }
+  freeFft(s->fft);
+  free(s->window);
+  free(s->windowed);
+  free(s->re);
+  free(s->im);
+  free(s);
+}
+
+int spectrumChannelCount(Spectrum s) { return s->channelCount; }
+
+int spectrumWrite(Spectrum s, int channel, const float *samples, int frames) {
+  if (channel < 0 || channel >= s->channelCount || frames <= 0) {
+    return 0;
+  }
+  return (int)spscWrite(s->channels[channel].ring, samples, frames);
+}
+
+const float *spectrumRead(Spectrum s) {
+  if (!(atomic_load_explicit(&s->state, memory_order_relaxed) & FRESH)) {
+    return NULL;
+  }
+  unsigned previous =
+      atomic_exchange_explicit(&s->state, s->front, memory_order_acq_rel);
+  s->front = previous & INDEX_MASK;
+  return s->buffers[s->front];
+}
+
+float spectrumPointHz(int point) {
+  return SPECTRUM_LOW_HZ * powf(SPECTRUM_HIGH_HZ / SPECTRUM_LOW_HZ,
+                                (float)point / (SPECTRUM_POINTS - 1));
+}
+
+void spectrumTapProcess(void *state, const struct ProcessContext *ctx) {
+  struct SpectrumTap *tap = state;
+  for (int i = 0; i < ctx->inputCount; i++) {
+    spectrumWrite(tap->spectrum, tap->channel + i, ctx->inputs[i],
+                  ctx->frames);
+    if (i < ctx->outputCount) {
+      memcpy(ctx->outputs[i], ctx->inputs[i], ctx->frames * sizeof(float));
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "graph.h"
+
+// spectrum analyzer. the audio thread only copies samples into a lock-free
+// ring per channel, the windowed ffts run on an analysis thread of their own
+// which hands finished curves to the ui through a triple buffer. a curve is
+// SPECTRUM_POINTS heights on a log frequency axis, already in display units,
+// so the ui uploads them as they are.
+#define SPECTRUM_POINTS 256
+#define SPECTRUM_LOW_HZ 20.0f
+#define SPECTRUM_HIGH_HZ 20000.0f
+#define SPECTRUM_FLOOR_DB -90.0f
+#define SPECTRUM_FALL_DB_PER_SECOND 40.0f
+
+typedef struct Spectrum *Spectrum;
+
+// not real-time safe, starts the analysis thread. fftSize is a power of two,
+// overlap is how many windows start within one fftSize (4 is 75%). returns
+// NULL if either doesn't fit
+Spectrum makeSpectrum(int channels, int sampleRate, int fftSize, int overlap);
+void freeSpectrum(Spectrum s);
+
+int spectrumChannelCount(Spectrum s);
+
+// audio thread. returns how many frames fit, the rest are dropped while the
+// analysis is behind
+int spectrumWrite(Spectrum s, int channel, const float *samples, int frames);
+
+// ui thread. channels * SPECTRUM_POINTS heights in 0..1 (floor to 0 dBFS
+// for a sine), or NULL if no new curves were published since the last call.
+// valid until the next call
+const float *spectrumRead(Spectrum s);
+
+// where point p sits on the frequency axis
+float spectrumPointHz(int point);
+
+// a pass-through node feeding each of its inputs to the analyzer, input i
+// goes to channel `channel + i`
+struct SpectrumTap {
+  Spectrum spectrum;
+  int channel;
+};
+
+void spectrumTapProcess(void *state, const struct ProcessContext *ctx);
+
+#endif
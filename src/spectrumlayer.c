@@ -0,0 +1,170 @@
+#include "spectrumlayer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// matches the push constant block in assets/spectrum.vert
+struct SpectrumPushConstants {
+  float rect[4];
+  float color[4];
+  struct Vec2 size;
+  int32_t first;
+  int32_t points;
+};
+
+static const float colors[][4] = {
+    {0.3f, 0.7f, 1.0f, 0.9f},
+    {1.0f, 0.6f, 0.2f, 0.9f},
+    {0.5f, 0.9f, 0.4f, 0.9f},
+    {0.9f, 0.4f, 0.8f, 0.9f},
+};
+#define COLORS (int)(sizeof(colors) / sizeof(colors[0]))
+
+struct SpectrumLayer {
+  Spectrum spectrum;
+  int channels;
+  float rect[4];
+  float *heights; // newest curves, channels * SPECTRUM_POINTS
+
+  // per frame in flight: a mapped copy of the heights and whether it's
+  // behind `heights`
+  int framesInFlight;
+  struct VertexBufferAndMemory *buffers;
+  float **mapped;
+  uint8_t *stale;
+
+  // vulkan
+  VkDevice device;
+  VkShaderModule vertShader;
+  VkShaderModule fragShader;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
+
+// PRIVATE FUNCTIONS
+
+static struct VertexInput heightInput(void) {
+  static VkVertexInputBindingDescription bindings[2];
+  static VkVertexInputAttributeDescription attributes[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    bindings[i] = (VkVertexInputBindingDescription){
+        i, sizeof(float), VK_VERTEX_INPUT_RATE_INSTANCE};
+    attributes[i] =
+        (VkVertexInputAttributeDescription){i, i, VK_FORMAT_R32_SFLOAT, 0};
+  }
+  return (struct VertexInput){bindings, 2, attributes, 2};
+}
+
+static void prepare(void *state, int frame, double time) {
+  (void)time;
+  struct SpectrumLayer *l = state;
+  size_t bytes = (size_t)l->channels * SPECTRUM_POINTS * sizeof(float);
+
+  const float *curves = spectrumRead(l->spectrum);
+  if (curves) {
+    memcpy(l->heights, curves, bytes);
+    memset(l->stale, 1, l->framesInFlight);
+  }
+  if (l->stale[frame]) {
+    memcpy(l->mapped[frame], l->heights, bytes);
+    l->stale[frame] = 0;
+  }
+}
+
+static void record(void *state, VkCommandBuffer commandBuffer, int frame,
+                   double time, struct Vec2 size) {
+  (void)time;
+  struct SpectrumLayer *l = state;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    l->pipeline);
+
+  VkBuffer buffers[] = {l->buffers[frame].buffer, l->buffers[frame].buffer};
+  VkDeviceSize offsets[] = {0, sizeof(float)};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+  for (int c = 0; c < l->channels; c++) {
+    struct SpectrumPushConstants pushConstants = {
+        .size = size,
+        .first = c * SPECTRUM_POINTS,
+        .points = SPECTRUM_POINTS,
+    };
+    memcpy(pushConstants.rect, l->rect, sizeof(l->rect));
+    memcpy(pushConstants.color, colors[c % COLORS], sizeof(colors[0]));
+    vkCmdPushConstants(commandBuffer, l->pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT |
+                           VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(struct SpectrumPushConstants),
+                       &pushConstants);
+    vkCmdDraw(commandBuffer, 6, SPECTRUM_POINTS - 1, 0, c * SPECTRUM_POINTS);
+  }
+}
+
+static void destroy(void *state) {
+  struct SpectrumLayer *l = state;
+
+  for (int f = 0; f < l->framesInFlight; f++) {
+    vkUnmapMemory(l->device, l->buffers[f].memory);
+    vkDestroyBuffer(l->device, l->buffers[f].buffer, NULL);
+    vkFreeMemory(l->device, l->buffers[f].memory, NULL);
+  }
+  free(l->buffers);
+  free(l->mapped);
+  free(l->stale);
+
+  vkDestroyPipeline(l->device, l->pipeline, NULL);
+  vkDestroyPipelineLayout(l->device, l->pipelineLayout, NULL);
+  vkDestroyShaderModule(l->device, l->fragShader, NULL);
+  vkDestroyShaderModule(l->device, l->vertShader, NULL);
+
+  free(l->heights);
+  free(l);
+}
+
+// PUBLIC FUNCTIONS
+
+struct Layer makeSpectrumLayer(struct RenderContext ctx, Spectrum spectrum,
+                               float x, float y, float width, float height) {
+  struct SpectrumLayer *l = malloc(sizeof(struct SpectrumLayer));
+  l->spectrum = spectrum;
+  l->channels = spectrumChannelCount(spectrum);
+  l->rect[0] = x;
+  l->rect[1] = y;
+  l->rect[2] = width;
+  l->rect[3] = height;
+  l->device = ctx.device;
+  l->framesInFlight = ctx.framesInFlight;
+
+  // height buffers, mapped for good
+  VkDeviceSize size = (VkDeviceSize)l->channels * SPECTRUM_POINTS *
+                      sizeof(float);
+  l->heights = calloc((size_t)l->channels * SPECTRUM_POINTS, sizeof(float));
+  l->buffers = malloc(l->framesInFlight * sizeof(struct VertexBufferAndMemory));
+  l->mapped = malloc(l->framesInFlight * sizeof(float *));
+  l->stale = malloc(l->framesInFlight);
+  memset(l->stale, 1, l->framesInFlight);
+  for (int f = 0; f < l->framesInFlight; f++) {
+    l->buffers[f] = makeVkHostBuffer(ctx.physicalDevice, ctx.device, size,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vkMapMemory(ctx.device, l->buffers[f].memory, 0, size, 0,
+                (void **)&l->mapped[f]);
+  }
+
+  // pipeline
+  l->vertShader = makeVkShaderModule(ctx.device, "bin/spectrum-vert.spv");
+  l->fragShader = makeVkShaderModule(ctx.device, "bin/spectrum-frag.spv");
+  l->pipelineLayout = makeVkPushConstantLayout(
+      ctx.device, sizeof(struct SpectrumPushConstants),
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+  l->pipeline = makeVkPipelineWithInput(
+      ctx.device, ctx.swapchainSettings, l->vertShader, l->fragShader,
+      ctx.renderPass, l->pipelineLayout, heightInput());
+
+  return (struct Layer){
+      .state = l,
+      .prepare = prepare,
+      .record = record,
+      .destroy = destroy,
+  };
+}
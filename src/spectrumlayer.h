@@ -0,0 +1,13 @@
+#ifndef SPECTRUMLAYER_H
+#define SPECTRUMLAYER_H
+
+#include "renderer.h"
+#include "spectrum.h"
+
+// draws every channel of `spectrum` as a filled curve over the given
+// rectangle (window coordinates), later channels on top. the gpu only ever
+// receives the heights, the shader turns them into geometry.
+struct Layer makeSpectrumLayer(struct RenderContext ctx, Spectrum spectrum,
+                               float x, float y, float width, float height);
+
+#endif
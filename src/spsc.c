@@ -0,0 +1,144 @@
+#include "spsc.h"
+
+#include "die.h"
+#include <stdatomic.h>
+#include <string.h>
+
+struct Spsc {
+  // producer line
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+  size_t cachedTail;
+
+  // consumer line
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+  size_t cachedHead;
+
+  // read-only after creation
+  _Alignas(CACHE_LINE_SIZE) size_t elementSize;
+  size_t capacity;
+  size_t mask;
+  unsigned char *data;
+};
+
+// PRIVATE FUNCTIONS
+
+static size_t nextPowerOfTwo(size_t n) {
+  size_t p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+
+// copies count elements starting at index, wrapping around the end of storage
+static void copyIn(Spsc q, size_t index, const unsigned char *src,
+                   size_t count) {
+  size_t offset = index & q->mask;
+  size_t first = q->capacity - offset < count ? q->capacity - offset : count;
+  memcpy(q->data + offset * q->elementSize, src, first * q->elementSize);
+  memcpy(q->data, src + first * q->elementSize,
+         (count - first) * q->elementSize);
+}
+
+static void copyOut(Spsc q, size_t index, unsigned char *dst, size_t count) {
+  size_t offset = index & q->mask;
+  size_t first = q->capacity - offset < count ? q->capacity - offset : count;
+  memcpy(dst, q->data + offset * q->elementSize, first * q->elementSize);
+  memcpy(dst + first * q->elementSize, q->data,
+         (count - first) * q->elementSize);
+}
+
+// PUBLIC FUNCTIONS
+
+Spsc makeSpsc(size_t elementSize, size_t capacity) {
+  if (elementSize == 0 || capacity == 0) {
+    die("Invalid ring buffer size: %zu x %zu\n", capacity, elementSize);
+  }
+
+  Spsc q = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct Spsc));
+  if (!q) {
+    die("Failed to allocate ring buffer\n");
+  }
+  memset(q, 0, sizeof(struct Spsc));
+
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->elementSize = elementSize;
+  q->capacity = nextPowerOfTwo(capacity);
+  q->mask = q->capacity - 1;
+
+  // storage gets its own lines too, and is touched now so the first push on
+  // the audio thread doesn't page fault
+  size_t bytes = q->capacity * elementSize;
+  bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  q->data = aligned_alloc(CACHE_LINE_SIZE, bytes);
+  if (!q->data) {
+    die("Failed to allocate ring buffer storage: %zu bytes\n", bytes);
+  }
+  memset(q->data, 0, bytes);
+
+  return q;
+}
+
+void freeSpsc(Spsc q) {
+  free(q->data);
+  free(q);
+}
+
+int spscPush(Spsc q, const void *element) {
+  return spscWrite(q, element, 1) == 1;
+}
+
+size_t spscWrite(Spsc q, const void *elements, size_t count) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  // only reload the consumer's index when the cached one says we're full
+  size_t space = q->capacity - (head - q->cachedTail);
+  if (space < count) {
+    q->cachedTail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    space = q->capacity - (head - q->cachedTail);
+  }
+  if (count > space) {
+    count = space;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  copyIn(q, head, elements, count);
+  atomic_store_explicit(&q->head, head + count, memory_order_release);
+  return count;
+}
+
+int spscPop(Spsc q, void *element) { return spscRead(q, element, 1) == 1; }
+
+size_t spscRead(Spsc q, void *elements, size_t count) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+  // only reload the producer's index when the cached one says we're empty
+  size_t available = q->cachedHead - tail;
+  if (available < count) {
+    q->cachedHead = atomic_load_explicit(&q->head, memory_order_acquire);
+    available = q->cachedHead - tail;
+  }
+  if (count > available) {
+    count = available;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  copyOut(q, tail, elements, count);
+  atomic_store_explicit(&q->tail, tail + count, memory_order_release);
+  return count;
+}
+
+size_t spscReadable(Spsc q) {
+  // tail first, head can only have moved further ahead by the time it's read
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  return atomic_load_explicit(&q->head, memory_order_acquire) - tail;
+}
+
+size_t spscWritable(Spsc q) { return q->capacity - spscReadable(q); }
+
+size_t spscCapacity(Spsc q) { return q->capacity; }
@@ -0,0 +1,35 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+
+// the destructive interference size, indices owned by different threads live
+// on separate lines so the producer and consumer never fight over one
+#if defined(__APPLE__) && defined(__aarch64__)
+#define CACHE_LINE_SIZE 128
+#else
+#define CACHE_LINE_SIZE 64
+#endif
+
+// wait-free single-producer/single-consumer ring buffer of fixed-size
+// elements. exactly one thread may push and exactly one thread may pop, neither
+// side ever blocks, locks or allocates.
+typedef struct Spsc *Spsc;
+
+Spsc makeSpsc(size_t elementSize, size_t capacity);
+void freeSpsc(Spsc q);
+
+// producer side, returns 0 if the queue is full
+int spscPush(Spsc q, const void *element);
+size_t spscWrite(Spsc q, const void *elements, size_t count);
+
+// consumer side, returns 0 if the queue is empty
+int spscPop(Spsc q, void *element);
+size_t spscRead(Spsc q, void *elements, size_t count);
+
+// safe to call from either side, exact only from the owning thread
+size_t spscReadable(Spsc q);
+size_t spscWritable(Spsc q);
+size_t spscCapacity(Spsc q);
+
+#endif
@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+
+#include "die.h"
+#include "dsp.h"
+#include "spsc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// frames decoded per ring write on the i/o thread, and drained per copy on
+// the audio thread
+#define DECODE_FRAMES 4096
+#define DRAIN_FRAMES 256
+
+// the i/o thread sleeps this long when every ring is topped up
+#define IDLE_NANOS 1000000
+
+struct StreamClip {
+  AudioFile file;
+  struct AudioFormat format;
+  Spsc ring; // interleaved frames
+
+  // seek handshake, one generation per seek:
+  // 1. the audio thread sets the target and bumps seekRequested
+  // 2. the i/o thread stops writing and publishes seekAcknowledged
+  // 3. the audio thread empties the ring and publishes seekFlushed
+  // 4. the i/o thread refills from the target and publishes seekCompleted
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t seekTarget;
+  atomic_uint seekRequested;
+  atomic_uint seekAcknowledged;
+  atomic_uint seekFlushed;
+  atomic_uint seekCompleted;
+  atomic_int endOfFile;
+
+  // i/o thread
+  _Alignas(CACHE_LINE_SIZE) uint64_t readFrame;
+  unsigned seekHandled;
+  float *decode;
+
+  // audio thread
+  _Alignas(CACHE_LINE_SIZE) float *drain;
+  _Atomic uint64_t underruns;
+  Streamer streamer;
+};
+
+struct Streamer {
+  _Atomic(StreamClip) *clips;
+  int maxClips;
+
+  pthread_t thread;
+  atomic_int running;
+  atomic_uint pass; // bumped after every sweep over the clips
+  _Atomic uint64_t underruns;
+};
+
+// I/O THREAD
+
+// returns 1 if it decoded anything
+static int fill(StreamClip c, size_t atLeast) {
+  unsigned requested =
+      atomic_load_explicit(&c->seekRequested, memory_order_acquire);
+  if (requested != c->seekHandled) {
+    c->seekHandled = requested;
+    atomic_store_explicit(&c->seekAcknowledged, requested,
+                          memory_order_release);
+    return 0;
+  }
+  if (atomic_load_explicit(&c->seekCompleted, memory_order_relaxed) !=
+      c->seekHandled) {
+    if (atomic_load_explicit(&c->seekFlushed, memory_order_acquire) !=
+        c->seekHandled) {
+      return 0; // waiting on the audio thread
+    }
+    c->readFrame = atomic_load_explicit(&c->seekTarget, memory_order_relaxed);
+    atomic_store_explicit(&c->endOfFile, 0, memory_order_relaxed);
+    atomic_store_explicit(&c->seekCompleted, c->seekHandled,
+                          memory_order_release);
+  }
+
+  size_t writable = spscWritable(c->ring);
+  if (writable < atLeast ||
+      atomic_load_explicit(&c->endOfFile, memory_order_relaxed)) {
+    return 0;
+  }
+
+  int decodedAny = 0;
+  while (writable > 0) {
+    int frames = writable < DECODE_FRAMES ? (int)writable : DECODE_FRAMES;
+    prefetchAudioFile(c->file, c->readFrame + frames, 4 * DECODE_FRAMES);
+    int decoded = readAudioFile(c->file, c->readFrame, c->decode, frames);
+    if (decoded == 0) {
+      atomic_store_explicit(&c->endOfFile, 1, memory_order_release);
+      break;
+    }
+    spscWrite(c->ring, c->decode, decoded);
+    c->readFrame += decoded;
+    writable -= decoded;
+    decodedAny = 1;
+
+    // a seek arriving mid-refill shouldn't wait for the whole ring
+    if (atomic_load_explicit(&c->seekRequested, memory_order_relaxed) !=
+        c->seekHandled) {
+      break;
+    }
+  }
+  return decodedAny;
+}
+
+static void *streamerMain(void *arg) {
+  Streamer s = arg;
+
+  while (atomic_load_explicit(&s->running, memory_order_acquire)) {
+    int busy = 0;
+
+    // clips below half full first, so one long refill can't starve the rest
+    for (int urgent = 1; urgent >= 0; urgent--) {
+      for (int i = 0; i < s->maxClips; i++) {
+        StreamClip c =
+            atomic_load_explicit(&s->clips[i], memory_order_acquire);
+        if (c) {
+          size_t half = spscCapacity(c->ring) / 2;
+          busy |= fill(c, urgent ? half : DECODE_FRAMES);
+        }
+      }
+    }
+
+    atomic_fetch_add_explicit(&s->pass, 1, memory_order_release);
+    if (!busy) {
+      struct timespec ts = {0, IDLE_NANOS};
+      nanosleep(&ts, NULL);
+    }
+  }
+  return NULL;
+}
+
+// AUDIO THREAD
+
+static void silence(float *const *channels, int channelCount, int offset,
+                    int frames) {
+  for (int ch = 0; ch < channelCount; ch++) {
+    memset(channels[ch] + offset, 0, frames * sizeof(float));
+  }
+}
+
+static void scatter(StreamClip c, float *const *channels, int channelCount,
+                    int offset, int frames) {
+  int clipChannels = c->format.channels;
+  if (clipChannels == 2 && channelCount >= 2) {
+    dsp->deinterleave2(channels[0] + offset, channels[1] + offset, c->drain,
+                       frames);
+  } else {
+    for (int ch = 0; ch < channelCount && ch < clipChannels; ch++) {
+      for (int i = 0; i < frames; i++) {
+        channels[ch][offset + i] = c->drain[i * clipChannels + ch];
+      }
+    }
+  }
+  for (int ch = clipChannels; ch < channelCount; ch++) {
+    memset(channels[ch] + offset, 0, frames * sizeof(float));
+  }
+}
+
+int streamClipRead(StreamClip c, float *const *channels, int channelCount,
+                   int frames) {
+  // mid-seek, keep the ring empty and play silence
+  unsigned requested =
+      atomic_load_explicit(&c->seekRequested, memory_order_relaxed);
+  if (atomic_load_explicit(&c->seekCompleted, memory_order_acquire) !=
+      requested) {
+    if (atomic_load_explicit(&c->seekAcknowledged, memory_order_acquire) ==
+            requested &&
+        atomic_load_explicit(&c->seekFlushed, memory_order_relaxed) !=
+            requested) {
+      while (spscRead(c->ring, c->drain, DRAIN_FRAMES) > 0) {
+      }
+      atomic_store_explicit(&c->seekFlushed, requested, memory_order_release);
+    }
+    silence(channels, channelCount, 0, frames);
+    return 0;
+  }
+
+  int done = 0;
+  while (done < frames) {
+    int want = frames - done < DRAIN_FRAMES ? frames - done : DRAIN_FRAMES;
+    int got = (int)spscRead(c->ring, c->drain, want);
+    if (got == 0) {
+      break;
+    }
+    scatter(c, channels, channelCount, done, got);
+    done += got;
+  }
+
+  if (done < frames) {
+    silence(channels, channelCount, done, frames - done);
+    // check the ring again after the flag, the last frames may have landed
+    // between our read and the i/o thread hitting the end
+    int ended = atomic_load_explicit(&c->endOfFile, memory_order_acquire) &&
+                spscReadable(c->ring) == 0;
+    if (!ended) {
+      atomic_fetch_add_explicit(&c->underruns, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&c->streamer->underruns, 1,
+                                memory_order_relaxed);
+    }
+  }
+  return done;
+}
+
+void streamClipSeek(StreamClip c, uint64_t frame) {
+  atomic_store_explicit(&c->seekTarget, frame, memory_order_relaxed);
+  atomic_fetch_add_explicit(&c->seekRequested, 1, memory_order_release);
+}
+
+// PUBLIC FUNCTIONS
+
+Streamer makeStreamer(int maxClips) {
+  Streamer s = malloc(sizeof(struct Streamer));
+  s->maxClips = maxClips;
+  s->clips = malloc(maxClips * sizeof(*s->clips));
+  for (int i = 0; i < maxClips; i++) {
+    atomic_init(&s->clips[i], NULL);
+  }
+  atomic_init(&s->running, 1);
+  atomic_init(&s->pass, 0);
+  atomic_init(&s->underruns, 0);
+  if (pthread_create(&s->thread, NULL, streamerMain, s) != 0) {
+    die("Failed to start streamer thread\n");
+  }
+  return s;
+}
+
+void freeStreamer(Streamer s) {
+  atomic_store_explicit(&s->running, 0, memory_order_release);
+  pthread_join(s->thread, NULL);
+  for (int i = 0; i < s->maxClips; i++) {
+    StreamClip c = atomic_load(&s->clips[i]);
+    if (c) {
+      streamerClose(s, c);
+    }
+  }
+  free(s->clips);
+  free(s);
+}
+
+StreamClip streamerOpen(Streamer s, const char *path, double prefetchSeconds) {
+  AudioFile file = openAudioFile(path);
+  if (!file) {
+    return NULL;
+  }
+
+  StreamClip c = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct StreamClip));
+  memset(c, 0, sizeof(struct StreamClip));
+  c->file = file;
+  c->format = audioFileFormat(file);
+  c->streamer = s;
+
+  size_t frames = (size_t)(prefetchSeconds * c->format.sampleRate);
+  if (frames < 2 * DECODE_FRAMES) {
+    frames = 2 * DECODE_FRAMES;
+  }
+  c->ring = makeSpsc(c->format.channels * sizeof(float), frames);
+  c->decode = malloc(DECODE_FRAMES * c->format.channels * sizeof(float));
+  c->drain = malloc(DRAIN_FRAMES * c->format.channels * sizeof(float));
+
+  atomic_init(&c->seekTarget, 0);
+  atomic_init(&c->seekRequested, 0);
+  atomic_init(&c->seekAcknowledged, 0);
+  atomic_init(&c->seekFlushed, 0);
+  atomic_init(&c->seekCompleted, 0);
+  atomic_init(&c->endOfFile, 0);
+  atomic_init(&c->underruns, 0);
+
+  // fill the ring before the i/o thread sees it, so playback starting right
+  // away doesn't open with an underrun
+  fill(c, 0);
+
+  for (int i = 0; i < s->maxClips; i++) {
+    StreamClip expected = NULL;
+    if (atomic_compare_exchange_strong(&s->clips[i], &expected, c)) {
+      return c;
+    }
+  }
+
+  // no free slot
+  freeSpsc(c->ring);
+  free(c->decode);
+  free(c->drain);
+  closeAudioFile(file);
+  free(c);
+  return NULL;
+}
+
+void streamerClose(Streamer s, StreamClip c) {
+  for (int i = 0; i < s->maxClips; i++) {
+    StreamClip expected = c;
+    if (atomic_compare_exchange_strong(&s->clips[i], &expected, NULL)) {
+      break;
+    }
+  }
+
+  // two full sweeps guarantee the i/o thread let go of it
+  if (atomic_load_explicit(&s->running, memory_order_acquire)) {
+    unsigned pass = atomic_load_explicit(&s->pass, memory_order_acquire);
+    while (atomic_load_explicit(&s->pass, memory_order_acquire) - pass < 2) {
+      struct timespec ts = {0, IDLE_NANOS / 4};
+      nanosleep(&ts, NULL);
+    }
+  }
+
+  freeSpsc(c->ring);
+  free(c->decode);
+  free(c->drain);
+  closeAudioFile(c->file);
+  free(c);
+}
+
+struct AudioFormat streamClipFormat(StreamClip c) { return c->format; }
+
+uint64_t streamClipUnderruns(StreamClip c) {
+  return atomic_load_explicit(&c->underruns, memory_order_relaxed);
+}
+
+uint64_t streamerUnderruns(Streamer s) {
+  return atomic_load_explicit(&s->underruns, memory_order_relaxed);
+}
@@ -0,0 +1,35 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "audiofile.h"
+#include <stdint.h>
+
+// streams audio clips from disk. a dedicated i/o thread decodes ahead of each
+// clip's playhead into a per-clip lock-free ring that the audio thread drains.
+typedef struct Streamer *Streamer;
+typedef struct StreamClip *StreamClip;
+
+Streamer makeStreamer(int maxClips);
+void freeStreamer(Streamer s);
+
+// ui thread. open returns NULL if the file can't be streamed or there is no
+// free slot. the audio thread must be done with a clip before it's closed.
+StreamClip streamerOpen(Streamer s, const char *path, double prefetchSeconds);
+void streamerClose(Streamer s, StreamClip c);
+
+// audio thread. read fills `frames` frames into the planar `channels`
+// buffers (missing channels are left alone) and returns how many came from
+// disk, the rest is silence. running dry before the end of the file or
+// mid-seek counts as an underrun.
+int streamClipRead(StreamClip c, float *const *channels, int channelCount,
+                   int frames);
+// asks the i/o thread to jump, output is silent until the new data arrives.
+// takes one i/o thread pass plus one block.
+void streamClipSeek(StreamClip c, uint64_t frame);
+
+// any thread
+struct AudioFormat streamClipFormat(StreamClip c);
+uint64_t streamClipUnderruns(StreamClip c);
+uint64_t streamerUnderruns(Streamer s);
+
+#endif
@@ -0,0 +1,466 @@
+#include "stretch.h"
+
+#include "die.h"
+#include "dsp.h"
+#include "fft.h"
+#include "hash.h"
+#include "rtmem.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TWO_PI (2 * DSP_PI)
+
+// a frame is a transient when more than this much of its magnitude is new
+// since the last one, and it isn't close to silence
+#define TRANSIENT_RISE 0.4f
+#define TRANSIENT_FLOOR 1e-3f
+
+// output frames rendered at a time by stretchRender
+#define RENDER_BLOCK 4096
+
+struct Channel {
+  float *input;          // `filled` frames from inputStart
+  float *accum;          // overlap-add of frames still to finish, fftSize
+  float *output;         // finished frames not read yet, `ready` of them
+  float *lastMag;        // the last analysis, half + 1 bins each
+  float *lastPhase;
+  float *mag, *phase;    // this frame's analysis
+  float *frequency;      // true frequency, radians per sample
+  float *synthesisPhase; // what the output bins are at
+};
+
+struct Stretch {
+  int channelCount;
+  int fftSize, half, hop;
+  int maxBlock;
+  int live;
+
+  double ratio;
+  float pitch; // a frequency factor
+  int preserve;
+
+  Fft fft;
+  float *window;
+  float *bins; // each bin's centre, radians per sample
+  float *windowed, *re, *im;
+  int *peaks;
+
+  int64_t inputStart;
+  int filled, inputCapacity;
+  double position; // where the next analysis starts, in input frames
+  int64_t lastStart;
+  int started;
+  int ready, outputCapacity;
+  uint64_t transients;
+
+  float *memory;
+  size_t bytes;
+  struct Channel channels[];
+};
+
+// PRIVATE FUNCTIONS
+
+static float wrap(float phase) {
+  return phase - (float)TWO_PI * rintf(phase / (float)TWO_PI);
+}
+
+// the most input a call for maxBlock frames can want: an fft's worth and a
+// hop of up to a whole fft for every hop of output
+static int inputCapacity(int fftSize, int maxBlock) {
+  int hop = fftSize / 4;
+  return fftSize + (maxBlock / hop + 2) * fftSize;
+}
+
+// magnitudes, phases and true frequencies of every channel's frame at
+// `start`, and whether it's a transient
+static int analyze(Stretch s, int64_t start) {
+  int n = s->fftSize, half = s->half;
+  int hop = s->started ? (int)(start - s->lastStart) : 0;
+  float flux = 0, energy = 0;
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    struct Channel *c = &s->channels[ch];
+    const float *x = c->input + (start - s->inputStart);
+    for (int i = 0; i < n; i++) {
+      s->windowed[i] = x[i] * s->window[i];
+    }
+    fftForward(s->fft, s->windowed, s->re, s->im);
+
+    for (int k = 0; k <= half; k++) {
+      float mag = sqrtf(s->re[k] * s->re[k] + s->im[k] * s->im[k]);
+      float phase = atan2f(s->im[k], s->re[k]);
+      // how far the phase moved beyond the bin's own frequency tells how far
+      // off its centre the partial is
+      float frequency = s->bins[k];
+      if (hop > 0) {
+        float moved = wrap(phase - c->lastPhase[k] - s->bins[k] * hop);
+        frequency += moved / hop;
+      }
+      float rise = mag - c->lastMag[k];
+      flux += rise > 0 ? rise : 0;
+      energy += mag;
+      c->mag[k] = mag;
+      c->phase[k] = phase;
+      c->frequency[k] = frequency;
+      c->lastMag[k] = mag;
+      c->lastPhase[k] = phase;
+    }
+  }
+  s->lastStart = start;
+  if (!s->started) {
+    s->started = 1;
+    return 1;
+  }
+  return s->preserve && energy > TRANSIENT_FLOOR * n &&
+         flux > TRANSIENT_RISE * energy;
+}
+
+// one channel's output frame from its analysis, overlap-added
+static void synthesize(Stretch s, struct Channel *c, int reset) {
+  int half = s->half;
+  float *mag = s->re, *turns = s->windowed;
+
+  // each peak and the bins around it down to the midpoints with its
+  // neighbours move as a whole to the bin nearest the peak's frequency times
+  // the pitch, so the lobe keeps its shape. the peak moves on by its
+  // frequency, the bins around it keep their phase relative to it as
+  // analysed, or on a reset everything starts over from the analysis
+  int count = 0;
+  for (int k = 2; k <= half - 2; k++) {
+    if (c->mag[k] > c->mag[k - 1] && c->mag[k] >= c->mag[k + 1] &&
+        c->mag[k] > c->mag[k - 2] && c->mag[k] >= c->mag[k + 2]) {
+      s->peaks[count++] = k;
+    }
+  }
+  if (count == 0) {
+    memcpy(mag, c->mag, (half + 1) * sizeof(float));
+    memcpy(c->synthesisPhase, c->phase, (half + 1) * sizeof(float));
+  } else {
+    memset(mag, 0, (half + 1) * sizeof(float));
+  }
+  // every turn is worked out before any phase is written over
+  for (int i = 0; i < count; i++) {
+    int peak = s->peaks[i];
+    int to = (int)lrintf(peak * s->pitch);
+    float advanced = c->synthesisPhase[to < half ? to : half] +
+                     c->frequency[peak] * s->pitch * s->hop;
+    turns[i] = reset ? 0 : advanced - c->phase[peak];
+  }
+  for (int i = 0; i < count; i++) {
+    int peak = s->peaks[i];
+    int shift = (int)lrintf(peak * s->pitch) - peak;
+    int low = i == 0 ? 0 : (s->peaks[i - 1] + peak) / 2 + 1;
+    int high = i == count - 1 ? half : (peak + s->peaks[i + 1]) / 2;
+    low = low + shift < 0 ? -shift : low;
+    high = high + shift > half ? half - shift : high;
+    for (int k = low; k <= high; k++) {
+      mag[k + shift] = c->mag[k];
+      c->synthesisPhase[k + shift] = wrap(c->phase[k] + turns[i]);
+    }
+  }
+
+  for (int k = 0; k <= half; k++) {
+    float m = mag[k];
+    s->re[k] = m * cosf(c->synthesisPhase[k]);
+    s->im[k] = m * sinf(c->synthesisPhase[k]);
+  }
+  fftInverse(s->fft, s->re, s->im, s->windowed);
+
+  // hann squared at a quarter fft hop sums to 1.5, and the inverse scales by
+  // the size
+  float scale = 1.0f / (1.5f * s->fftSize);
+  for (int i = 0; i < s->fftSize; i++) {
+    c->accum[i] += s->windowed[i] * s->window[i] * scale;
+  }
+}
+
+// the frame at `start` in, a hop of finished output out
+static void step(Stretch s, int64_t start) {
+  int reset = analyze(s, start);
+  s->transients += reset;
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    struct Channel *c = &s->channels[ch];
+    synthesize(s, c, reset);
+    memcpy(c->output + s->ready, c->accum, s->hop * sizeof(float));
+    memmove(c->accum, c->accum + s->hop,
+            (s->fftSize - s->hop) * sizeof(float));
+    memset(c->accum + s->fftSize - s->hop, 0, s->hop * sizeof(float));
+  }
+  s->ready += s->hop;
+}
+
+// PUBLIC FUNCTIONS
+
+Stretch makeStretch(int channels, int fftSize, int maxBlock, int live) {
+  if (channels <= 0 || maxBlock <= 0 || fftSize < 256 ||
+      (fftSize & (fftSize - 1))) {
+    return NULL;
+  }
+  Stretch s = calloc(1, sizeof(struct Stretch) +
+                            channels * sizeof(struct Channel));
+  if (!s) {
+    die("Failed to allocate stretch\n");
+  }
+  s->channelCount = channels;
+  s->fftSize = fftSize;
+  s->half = fftSize / 2;
+  s->hop = fftSize / 4;
+  s->maxBlock = maxBlock;
+  s->live = live;
+  s->ratio = 1;
+  s->pitch = 1;
+  s->preserve = 1;
+  s->fft = makeFft(fftSize);
+  s->inputCapacity = inputCapacity(fftSize, maxBlock);
+  s->outputCapacity = maxBlock + s->hop + s->half;
+  s->peaks = calloc(s->half + 1, sizeof(int));
+  if (!s->peaks) {
+    die("Failed to allocate stretch peaks\n");
+  }
+
+  // everything the audio thread touches in one locked block
+  size_t bins = s->half + 1;
+  size_t shared = 2 * fftSize + 3 * bins;
+  size_t perChannel = s->inputCapacity + fftSize + s->outputCapacity +
+                      6 * bins;
+  s->bytes = (shared + channels * perChannel) * sizeof(float);
+  s->memory = rtAlloc(s->bytes);
+  float *at = s->memory;
+  s->window = at, at += fftSize;
+  s->windowed = at, at += fftSize;
+  s->bins = at, at += bins;
+  s->re = at, at += bins;
+  s->im = at, at += bins;
+  for (int ch = 0; ch < channels; ch++) {
+    struct Channel *c = &s->channels[ch];
+    c->input = at, at += s->inputCapacity;
+    c->accum = at, at += fftSize;
+    c->output = at, at += s->outputCapacity;
+    c->lastMag = at, at += bins;
+    c->lastPhase = at, at += bins;
+    c->mag = at, at += bins;
+    c->phase = at, at += bins;
+    c->frequency = at, at += bins;
+    c->synthesisPhase = at, at += bins;
+  }
+
+  for (int i = 0; i < fftSize; i++) {
+    s->window[i] = (float)(0.5 - 0.5 * cos(TWO_PI * i / fftSize));
+  }
+  for (int k = 0; k <= s->half; k++) {
+    s->bins[k] = (float)(TWO_PI * k / fftSize);
+  }
+  stretchReset(s);
+  return s;
+}
+
+void freeStretch(Stretch s) {
+  if (!s) {
+    return;
+  }
+  rtFree(s->memory, s->bytes);
+  freeFft(s->fft);
+  free(s->peaks);
+  free(s);
+}
+
+int stretchChannelCount(Stretch s) { return s->channelCount; }
+
+int stretchFftSize(Stretch s) { return s->fftSize; }
+
+void stretchSetRatio(Stretch s, double ratio) {
+  if (s->live) {
+    return;
+  }
+  s->ratio = ratio < STRETCH_MIN_RATIO   ? STRETCH_MIN_RATIO
+             : ratio > STRETCH_MAX_RATIO ? STRETCH_MAX_RATIO
+                                         : ratio;
+}
+
+void stretchSetPitch(Stretch s, double semitones) {
+  semitones = semitones < -STRETCH_MAX_SEMITONES ? -STRETCH_MAX_SEMITONES
+              : semitones > STRETCH_MAX_SEMITONES ? STRETCH_MAX_SEMITONES
+                                                  : semitones;
+  s->pitch = (float)pow(2.0, semitones / 12.0);
+}
+
+void stretchSetTransients(Stretch s, int preserve) { s->preserve = preserve; }
+
+int stretchInputFrames(Stretch s, int outFrames) {
+  int need = outFrames - s->ready;
+  if (need <= 0) {
+    return 0;
+  }
+  int hops = (need + s->hop - 1) / s->hop;
+  double position = s->position;
+  for (int h = 1; h < hops; h++) {
+    position += s->hop / s->ratio;
+  }
+  int64_t end = (int64_t)floor(position) + s->fftSize;
+  int64_t have = s->inputStart + s->filled;
+  return end > have ? (int)(end - have) : 0;
+}
+
+int stretchProcess(Stretch s, const float *const *in, int inFrames,
+                   float *const *out, int outFrames) {
+  // stretchInputFrames never asks for more than there's room for, frames
+  // past it would be lost
+  assert(inFrames <= s->inputCapacity - s->filled);
+  int room = s->inputCapacity - s->filled;
+  int n = inFrames < room ? inFrames : room;
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    memcpy(s->channels[ch].input + s->filled, in[ch], n * sizeof(float));
+  }
+  s->filled += n;
+
+  while (s->ready + s->hop <= s->outputCapacity) {
+    int64_t start = (int64_t)floor(s->position);
+    if (start + s->fftSize > s->inputStart + s->filled) {
+      break;
+    }
+    step(s, start);
+    s->position += s->hop / s->ratio;
+  }
+
+  // input before the next frame is done with
+  int64_t drop = (int64_t)floor(s->position) - s->inputStart;
+  drop = drop < 0 ? 0 : drop > s->filled ? s->filled : drop;
+  int written = s->ready < outFrames ? s->ready : outFrames;
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    struct Channel *c = &s->channels[ch];
+    memmove(c->input, c->input + drop, (s->filled - drop) * sizeof(float));
+    memcpy(out[ch], c->output, written * sizeof(float));
+    memset(out[ch] + written, 0, (outFrames - written) * sizeof(float));
+    memmove(c->output, c->output + written,
+            (s->ready - written) * sizeof(float));
+  }
+  s->inputStart += drop;
+  s->filled -= (int)drop;
+  s->ready -= written;
+  return written;
+}
+
+void stretchReset(Stretch s) {
+  // half an fft of silence before the input, so the first frame is centred
+  // on its first frame
+  s->inputStart = -s->half;
+  s->filled = s->half;
+  s->position = -s->half;
+  s->started = 0;
+  s->lastStart = 0;
+  s->ready = s->live ? s->half : 0;
+  s->transients = 0;
+  size_t bins = s->half + 1;
+  for (int ch = 0; ch < s->channelCount; ch++) {
+    struct Channel *c = &s->channels[ch];
+    memset(c->input, 0, s->half * sizeof(float));
+    memset(c->accum, 0, s->fftSize * sizeof(float));
+    memset(c->output, 0, s->ready * sizeof(float));
+    memset(c->lastMag, 0, bins * sizeof(float));
+    memset(c->lastPhase, 0, bins * sizeof(float));
+    memset(c->synthesisPhase, 0, bins * sizeof(float));
+  }
+}
+
+int stretchLatency(Stretch s) { return s->half + (s->live ? s->half : 0); }
+
+uint64_t stretchTransients(Stretch s) { return s->transients; }
+
+void stretchNodeProcess(void *state, const struct ProcessContext *ctx) {
+  stretchProcess(state, ctx->inputs, ctx->frames, ctx->outputs, ctx->frames);
+}
+
+// PRECOMPUTED
+
+struct Render {
+  Sample source;
+  double ratio, semitones;
+  int fftSize;
+};
+
+static int render(void *state, float *const *channels, uint64_t frames) {
+  struct Render *r = state;
+  int count = sampleChannelCount(r->source);
+  uint64_t length = sampleFrames(r->source);
+  Stretch s = makeStretch(count, r->fftSize, RENDER_BLOCK, 0);
+  if (!s) {
+    return 0;
+  }
+  stretchSetRatio(s, r->ratio);
+  stretchSetPitch(s, r->semitones);
+
+  // input past the end of the source is silence, and the output's first
+  // frames are the latency
+  int capacity = inputCapacity(r->fftSize, RENDER_BLOCK);
+  float *pads = malloc((size_t)count * capacity * sizeof(float));
+  float *blocks = malloc((size_t)count * RENDER_BLOCK * sizeof(float));
+  const float **in = malloc(count * sizeof(float *));
+  float **out = malloc(count * sizeof(float *));
+  if (!pads || !blocks || !in || !out) {
+    die("Failed to allocate stretch render buffers\n");
+  }
+  for (int ch = 0; ch < count; ch++) {
+    out[ch] = blocks + (size_t)ch * RENDER_BLOCK;
+  }
+
+  uint64_t read = 0, written = 0;
+  int skip = stretchLatency(s);
+  while (written < frames) {
+    int need = stretchInputFrames(s, RENDER_BLOCK);
+    for (int ch = 0; ch < count; ch++) {
+      const float *source = sampleChannel(r->source, ch);
+      if (read + need <= length) {
+        in[ch] = source + read;
+        continue;
+      }
+      float *pad = pads + (size_t)ch * capacity;
+      uint64_t have = read < length ? length - read : 0;
+      if (have) {
+        memcpy(pad, source + read, have * sizeof(float));
+      }
+      memset(pad + have, 0, (need - have) * sizeof(float));
+      in[ch] = pad;
+    }
+    read += need;
+
+    int got = stretchProcess(s, in, need, out, RENDER_BLOCK);
+    int from = skip < got ? skip : got;
+    skip -= from;
+    uint64_t take = got - from;
+    take = take < frames - written ? take : frames - written;
+    for (int ch = 0; ch < count; ch++) {
+      memcpy(channels[ch] + written, out[ch] + from, take * sizeof(float));
+    }
+    written += take;
+  }
+
+  free(out);
+  free(in);
+  free(blocks);
+  free(pads);
+  freeStretch(s);
+  return 1;
+}
+
+Sample stretchRender(SampleCache c, Sample source, double ratio,
+                     double semitones, int fftSize) {
+  ratio = ratio < STRETCH_MIN_RATIO   ? STRETCH_MIN_RATIO
+          : ratio > STRETCH_MAX_RATIO ? STRETCH_MAX_RATIO
+                                      : ratio;
+  semitones = semitones < -STRETCH_MAX_SEMITONES ? -STRETCH_MAX_SEMITONES
+              : semitones > STRETCH_MAX_SEMITONES ? STRETCH_MAX_SEMITONES
+                                                  : semitones;
+  struct Render r = {source, ratio, semitones, fftSize};
+  uint64_t sourceHash = sampleHash(source);
+  struct Hasher h;
+  hashStart(&h);
+  hashBytes(&h, "stretch", 7);
+  hashBytes(&h, &sourceHash, sizeof(sourceHash));
+  hashBytes(&h, &ratio, sizeof(ratio));
+  hashBytes(&h, &semitones, sizeof(semitones));
+  hashBytes(&h, &fftSize, sizeof(fftSize));
+  uint64_t frames = (uint64_t)llround(sampleFrames(source) * ratio);
+  return sampleCacheDerive(c, hashEnd(&h), sampleChannelCount(source),
+                           sampleSampleRate(source), frames, render, &r);
+}
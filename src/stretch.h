@@ -0,0 +1,80 @@
+#ifndef STRETCH_H
+#define STRETCH_H
+
+#include "graph.h"
+#include "samplecache.h"
+#include <stdint.h>
+
+// time stretching and pitch shifting by phase vocoder, for loops following
+// the tempo. every synthesis hop of a quarter fft, the input is analysed a
+// quarter fft divided by the ratio further on, each bin's true frequency is
+// worked out from how far its phase moved, and the output phases advance by
+// it. peaks carry the phases of the bins around them along, so partials
+// keep their shape instead of smearing. a frame with a sudden rise in energy
+// across the spectrum is a transient, and its phases start over from the
+// analysis so the attack stays sharp. pitch moves each peak and its bins up
+// or down the spectrum as a whole.
+//
+// the output is the stretched input delayed by stretchLatency frames, and
+// the hops fall the same way whatever the blocks are, so blocking never
+// changes the result.
+typedef struct Stretch *Stretch;
+
+#define STRETCH_MIN_RATIO 0.25
+#define STRETCH_MAX_RATIO 4.0
+#define STRETCH_MAX_SEMITONES 24.0
+
+// not real-time safe. fftSize is a power of two from 256 up, larger is
+// smoother on held tones and smaller has less latency, 2048 suits most
+// material at 48 kHz. maxBlock bounds the output frames per call.
+//
+// a live stretcher is fed as many frames as it's asked for, a signal going
+// through it in real time. its ratio stays 1 and it only shifts pitch. it
+// starts with half an fft of silence queued so it never runs dry, which adds
+// to its latency. NULL for a bad size
+Stretch makeStretch(int channels, int fftSize, int maxBlock, int live);
+void freeStretch(Stretch s);
+
+int stretchChannelCount(Stretch s);
+int stretchFftSize(Stretch s);
+
+// real-time safe, between calls. the ratio is output length over input
+// length, both are clamped to the limits above
+void stretchSetRatio(Stretch s, double ratio);
+void stretchSetPitch(Stretch s, double semitones);
+// on by default, off for pads and other material without attacks
+void stretchSetTransients(Stretch s, int preserve);
+
+// real-time safe. to produce a block of `outFrames`, feed exactly
+// stretchInputFrames(s, outFrames) input frames to stretchProcess, as with
+// the resampler. returns the frames written, fewer only if it was fed less.
+// feeding more is a bug, asserted, and the frames past what it asked for are
+// dropped. a live stretcher is fed outFrames every time
+int stretchInputFrames(Stretch s, int outFrames);
+int stretchProcess(Stretch s, const float *const *in, int inFrames,
+                   float *const *out, int outFrames);
+void stretchReset(Stretch s);
+
+// how far behind the input the output is, in output frames
+int stretchLatency(Stretch s);
+
+// analysis frames treated as transients since the last reset
+uint64_t stretchTransients(Stretch s);
+
+// a graph node with a live stretcher as its state, input i shifted to
+// output i. its description's latency is stretchLatency
+void stretchNodeProcess(void *state, const struct ProcessContext *ctx);
+
+// PRECOMPUTED
+
+// a sample stretched and shifted once, off the audio thread, and cached in
+// `c` next to the sample it came from, for clips whose ratio doesn't change.
+// the render starts with the first frame of the source, the latency is
+// already taken off, and it's the source's length times the ratio. asking
+// again for the same source and settings finds it cached, the ratio and
+// pitch clamped first as the live setters clamp them. a new reference, NULL
+// if it doesn't fit the cache
+Sample stretchRender(SampleCache c, Sample source, double ratio,
+                     double semitones, int fftSize);
+
+#endif
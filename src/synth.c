@@ -0,0 +1,428 @@
+#include "synth.h"
+
+#include "rtmem.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// events a node takes from its lane per block
+#define MAX_EVENTS 256
+
+// the attack aims past full level so it gets there in its time, and hands
+// over to the decay when it does
+#define ATTACK_TARGET 1.2f
+
+// a voice heading for silence is free once below -80 dB
+#define SILENT 1e-4f
+
+#define MIN_SECONDS 0.001f
+#define MIN_CUTOFF 20.0f
+
+// arrays in struct SynthVoices
+#define FIELDS 12
+
+struct Synth {
+  int sampleRate;
+  int voiceCount;
+  int groupCount;
+  struct SynthVoices v;
+  float *fields; // every array of v, one after another, locked in ram
+  size_t fieldBytes;
+  SynthKernel kernel;
+  NoteLane lane;
+
+  // per voice, for allocation
+  uint8_t *pitch;
+  uint8_t *velocity;
+  uint8_t *held;     // note on, no note off yet
+  uint64_t *started; // note ons before it, the oldest voice has the lowest
+  // per group, a bit for every voice sounding
+  uint32_t *sounding;
+
+  uint64_t notes;
+  uint64_t stolen;
+  float params[SYNTH_PARAM_COUNT];
+  float attackRate, releaseRate;
+};
+
+// PRIVATE FUNCTIONS
+
+static int isSounding(Synth s, int n) {
+  return s->sounding[n / SYNTH_GROUP] >> (n % SYNTH_GROUP) & 1;
+}
+
+// the share of the way to its target a one pole segment moves each sample,
+// to get `timeConstants` of the way in `seconds`
+static float envelopeRate(Synth s, float seconds, float timeConstants) {
+  seconds = seconds > MIN_SECONDS ? seconds : MIN_SECONDS;
+  return 1 - expf(-timeConstants / (seconds * s->sampleRate));
+}
+
+static float attackRate(Synth s) {
+  return envelopeRate(s, s->params[SYNTH_ATTACK],
+                      logf(ATTACK_TARGET / (ATTACK_TARGET - 1)));
+}
+
+// decays and releases are 60 dB in their time
+static float fallRate(Synth s, float seconds) {
+  return envelopeRate(s, seconds, logf(1000));
+}
+
+static void setFilter(Synth s, int n) {
+  float frequency = s->v.increment[n] * s->sampleRate;
+  float cutoff = s->params[SYNTH_CUTOFF] * sqrtf(frequency / 440);
+  float nyquist = 0.45f * s->sampleRate;
+  cutoff = cutoff < MIN_CUTOFF ? MIN_CUTOFF : cutoff;
+  cutoff = cutoff > nyquist ? nyquist : cutoff;
+
+  float g = tanf((float)DSP_PI * cutoff / s->sampleRate);
+  float k = 2 - 1.96f * s->params[SYNTH_RESONANCE];
+  s->v.a1[n] = 1 / (1 + g * (g + k));
+  s->v.a2[n] = g * s->v.a1[n];
+  s->v.a3[n] = g * s->v.a2[n];
+}
+
+static int freeVoice(Synth s) {
+  for (int g = 0; g < s->groupCount; g++) {
+    uint32_t free = ~s->sounding[g] & ((1u << SYNTH_GROUP) - 1);
+    if (free) {
+      return g * SYNTH_GROUP + __builtin_ctz(free);
+    }
+  }
+  return -1;
+}
+
+// the quietest released voice, or failing that the oldest
+static int stealVoice(Synth s) {
+  int quietest = -1, oldest = 0;
+  for (int n = 0; n < s->voiceCount; n++) {
+    if (!s->held[n] &&
+        (quietest < 0 || s->v.env[n] < s->v.env[quietest])) {
+      quietest = n;
+    }
+    if (s->started[n] < s->started[oldest]) {
+      oldest = n;
+    }
+  }
+  return quietest >= 0 ? quietest : oldest;
+}
+
+// a stolen or retriggered voice starts its attack from where its envelope
+// is, free voices from silence
+static void noteOn(Synth s, int pitch, int velocity) {
+  int n = -1;
+  for (int i = 0; i < s->voiceCount && n < 0; i++) {
+    if (isSounding(s, i) && s->pitch[i] == pitch) {
+      n = i;
+    }
+  }
+  if (n < 0) {
+    n = freeVoice(s);
+  }
+  if (n < 0) {
+    n = stealVoice(s);
+    s->stolen++;
+  }
+
+  s->sounding[n / SYNTH_GROUP] |= 1u << (n % SYNTH_GROUP);
+  s->pitch[n] = pitch;
+  s->velocity[n] = velocity;
+  s->held[n] = 1;
+  s->started[n] = s->notes++;
+
+  float frequency = 440 * powf(2, (pitch - 69) / 12.0f);
+  s->v.increment[n] = frequency / s->sampleRate;
+  s->v.inverse[n] = 1 / s->v.increment[n];
+  s->v.target[n] = ATTACK_TARGET;
+  s->v.rate[n] = s->attackRate;
+  s->v.gain[n] = velocity / 127.0f * s->params[SYNTH_GAIN];
+  setFilter(s, n);
+}
+
+static void release(Synth s, int n) {
+  s->held[n] = 0;
+  s->v.target[n] = 0;
+  s->v.rate[n] = s->releaseRate;
+}
+
+static void noteOff(Synth s, int pitch) {
+  for (int n = 0; n < s->voiceCount; n++) {
+    if (isSounding(s, n) && s->held[n] && s->pitch[n] == pitch) {
+      release(s, n);
+    }
+  }
+}
+
+static void apply(Synth s, struct MidiEvent e) {
+  switch (e.type) {
+  case MIDI_NOTE_ON:
+    if (e.velocity > 0) {
+      noteOn(s, e.pitch, e.velocity);
+      break;
+    }
+    noteOff(s, e.pitch);
+    break;
+  case MIDI_NOTE_OFF:
+    noteOff(s, e.pitch);
+    break;
+  case MIDI_ALL_NOTES_OFF:
+    for (int n = 0; n < s->voiceCount; n++) {
+      if (isSounding(s, n) && s->held[n]) {
+        release(s, n);
+      }
+    }
+    break;
+  }
+}
+
+static void renderGroups(Synth s, float *out, int frames) {
+  for (int g = 0; g < s->groupCount; g++) {
+    if (s->sounding[g]) {
+      s->kernel(&s->v, g * SYNTH_GROUP, out, frames);
+    }
+  }
+}
+
+// frees the voices that faded out, silenced for good so their envelopes
+// stay at exactly zero
+static void collect(Synth s) {
+  for (int n = 0; n < s->voiceCount; n++) {
+    if (isSounding(s, n) && s->v.env[n] < SILENT &&
+        s->v.target[n] < SILENT) {
+      s->sounding[n / SYNTH_GROUP] &= ~(1u << (n % SYNTH_GROUP));
+      s->held[n] = 0;
+      s->v.env[n] = 0;
+      s->v.target[n] = 0;
+      s->v.rate[n] = 0;
+    }
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Synth makeSynth(int sampleRate, int voices, NoteLane lane) {
+  Synth s = calloc(1, sizeof(struct Synth));
+  s->sampleRate = sampleRate;
+  s->groupCount = (voices + SYNTH_GROUP - 1) / SYNTH_GROUP;
+  s->groupCount = s->groupCount > 0 ? s->groupCount : 1;
+  s->voiceCount = s->groupCount * SYNTH_GROUP;
+  s->lane = lane;
+
+  int n = s->voiceCount;
+  s->fieldBytes = FIELDS * n * sizeof(float);
+  s->fields = rtAlloc(s->fieldBytes);
+  memset(s->fields, 0, s->fieldBytes);
+  float **arrays[FIELDS] = {
+      &s->v.phase, &s->v.increment, &s->v.inverse, &s->v.a1,
+      &s->v.a2,    &s->v.a3,        &s->v.ic1,     &s->v.ic2,
+      &s->v.env,   &s->v.target,    &s->v.rate,    &s->v.gain,
+  };
+  for (int f = 0; f < FIELDS; f++) {
+    *arrays[f] = s->fields + f * n;
+  }
+  // idle voices run at a4, silent
+  for (int i = 0; i < n; i++) {
+    s->v.increment[i] = 440.0f / sampleRate;
+    s->v.inverse[i] = 1 / s->v.increment[i];
+  }
+
+  s->pitch = calloc(n, 1);
+  s->velocity = calloc(n, 1);
+  s->held = calloc(n, 1);
+  s->started = calloc(n, sizeof(uint64_t));
+  s->sounding = calloc(s->groupCount, sizeof(uint32_t));
+
+  s->params[SYNTH_ATTACK] = 0.005f;
+  s->params[SYNTH_DECAY] = 0.3f;
+  s->params[SYNTH_SUSTAIN] = 0.7f;
+  s->params[SYNTH_RELEASE] = 0.2f;
+  s->params[SYNTH_CUTOFF] = 2000.0f;
+  s->params[SYNTH_RESONANCE] = 0.3f;
+  s->params[SYNTH_GAIN] = 0.2f;
+  s->attackRate = attackRate(s);
+  s->releaseRate = fallRate(s, s->params[SYNTH_RELEASE]);
+  s->v.sustain = s->params[SYNTH_SUSTAIN];
+  s->v.decayRate = fallRate(s, s->params[SYNTH_DECAY]);
+
+  if (!synthUseKernel(s, DSP_AVX512) && !synthUseKernel(s, DSP_AVX2)) {
+    synthUseKernel(s, DSP_SCALAR);
+  }
+  return s;
+}
+
+void freeSynth(Synth s) {
+  rtFree(s->fields, s->fieldBytes);
+  free(s->pitch);
+  free(s->velocity);
+  free(s->held);
+  free(s->started);
+  free(s->sounding);
+  free(s);
+}
+
+void synthSetParam(Synth s, enum SynthParam param, float value) {
+  if (param >= SYNTH_PARAM_COUNT) {
+    return;
+  }
+  s->params[param] = value;
+  s->attackRate = attackRate(s);
+  s->releaseRate = fallRate(s, s->params[SYNTH_RELEASE]);
+  s->v.sustain = s->params[SYNTH_SUSTAIN];
+  s->v.decayRate = fallRate(s, s->params[SYNTH_DECAY]);
+
+  // the voices sounding pick it up in the stage they're in
+  for (int n = 0; n < s->voiceCount; n++) {
+    if (!isSounding(s, n)) {
+      continue;
+    }
+    int attacking = s->v.target[n] > 1;
+    int decaying = s->held[n] && !attacking;
+    switch (param) {
+    case SYNTH_ATTACK:
+      s->v.rate[n] = attacking ? s->attackRate : s->v.rate[n];
+      break;
+    case SYNTH_DECAY:
+      s->v.rate[n] = decaying ? s->v.decayRate : s->v.rate[n];
+      break;
+    case SYNTH_SUSTAIN:
+      s->v.target[n] = decaying ? s->v.sustain : s->v.target[n];
+      break;
+    case SYNTH_RELEASE:
+      s->v.rate[n] = !s->held[n] ? s->releaseRate : s->v.rate[n];
+      break;
+    case SYNTH_CUTOFF:
+    case SYNTH_RESONANCE:
+      setFilter(s, n);
+      break;
+    case SYNTH_GAIN:
+      s->v.gain[n] = s->velocity[n] / 127.0f * value;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void synthRender(Synth s, const struct MidiEvent *events, int count,
+                 float *out, int frames) {
+  memset(out, 0, frames * sizeof(float));
+  int done = 0;
+  for (int e = 0; e < count; e++) {
+    int offset = (int)events[e].offset < frames ? (int)events[e].offset
+                                                : frames;
+    if (offset > done) {
+      renderGroups(s, out + done, offset - done);
+      done = offset;
+    }
+    apply(s, events[e]);
+  }
+  if (done < frames) {
+    renderGroups(s, out + done, frames - done);
+  }
+  collect(s);
+}
+
+int synthVoiceCount(Synth s) { return s->voiceCount; }
+
+int synthActiveVoices(Synth s) {
+  int count = 0;
+  for (int g = 0; g < s->groupCount; g++) {
+    count += __builtin_popcount(s->sounding[g]);
+  }
+  return count;
+}
+
+uint64_t synthStolenVoices(Synth s) { return s->stolen; }
+
+int synthUseKernel(Synth s, enum DspIsa isa) {
+  if (!dspKernels(isa)) {
+    return 0;
+  }
+  switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+  case DSP_AVX2:
+    s->kernel = synthKernelAvx2;
+    break;
+  case DSP_AVX512:
+    s->kernel = synthKernelAvx512;
+    break;
+#endif
+  default:
+    s->kernel = synthKernelScalar;
+    break;
+  }
+  return 1;
+}
+
+void synthNodeProcess(void *state, const struct ProcessContext *ctx) {
+  Synth s = state;
+  // the block's events only live through this call
+  struct MidiEvent *events =
+      ctx->scratch
+          ? arenaAlloc(ctx->scratch, MAX_EVENTS * sizeof(struct MidiEvent))
+          : NULL;
+  int count = s->lane && events
+                  ? noteLaneEvents(s->lane, ctx, events, MAX_EVENTS)
+                  : 0;
+  if (ctx->outputCount == 0) {
+    return;
+  }
+  synthRender(s, events, count, ctx->outputs[0], ctx->frames);
+  for (int o = 1; o < ctx->outputCount; o++) {
+    memcpy(ctx->outputs[o], ctx->outputs[0], ctx->frames * sizeof(float));
+  }
+}
+
+void synthNodeSetParam(void *state, uint32_t param, float value) {
+  synthSetParam(state, param, value);
+}
+
+// KERNELS
+
+// the reference, a voice at a time. the vector kernels do the same
+// operations in the same order on a lane per voice
+void synthKernelScalar(struct SynthVoices *v, int first, float *out,
+                       int frames) {
+  for (int n = first; n < first + SYNTH_GROUP; n++) {
+    float phase = v->phase[n], dt = v->increment[n], inv = v->inverse[n];
+    float a1 = v->a1[n], a2 = v->a2[n], a3 = v->a3[n];
+    float ic1 = v->ic1[n], ic2 = v->ic2[n];
+    float env = v->env[n], target = v->target[n], rate = v->rate[n];
+    float gain = v->gain[n];
+
+    for (int i = 0; i < frames; i++) {
+      // saw with the step smoothed by a polynomial over a sample either side
+      float t = phase;
+      float saw = 2 * t - 1;
+      float x = t * inv;
+      float before = t < dt ? x + x - x * x - 1 : 0;
+      float y = (t - 1) * inv;
+      float after = t > 1 - dt ? y * y + y + y + 1 : 0;
+      saw = saw - before - after;
+      phase = t + dt;
+      phase = phase >= 1 ? phase - 1 : phase;
+
+      // lowpass
+      float v3 = saw - ic2;
+      float v1 = a1 * ic1 + a2 * v3;
+      float v2 = ic2 + a2 * ic1 + a3 * v3;
+      ic1 = 2 * v1 - ic1;
+      ic2 = 2 * v2 - ic2;
+
+      // envelope
+      env = env + (target - env) * rate;
+      int decay = env >= 1 && target > 1;
+      target = decay ? v->sustain : target;
+      rate = decay ? v->decayRate : rate;
+
+      out[i] += v2 * env * gain;
+    }
+
+    v->phase[n] = phase;
+    v->ic1[n] = ic1;
+    v->ic2[n] = ic2;
+    v->env[n] = env;
+    v->target[n] = target;
+    v->rate[n] = rate;
+  }
+}
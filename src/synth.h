@@ -0,0 +1,85 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include "dsp.h"
+#include "graph.h"
+#include "midi.h"
+#include <stdint.h>
+
+// a polyphonic subtractive synth: a polyblep saw per voice through a
+// resonant lowpass, shaped by an adsr envelope. the voices come from a pool
+// fixed when the synth is made, a note on with none free steals one. voice
+// state is kept one array per field, so the vector kernels run a whole group
+// of voices per instruction: the avx2 one eight at a time, the avx-512 one
+// sixteen. groups with nothing sounding are skipped.
+typedef struct Synth *Synth;
+
+// voices per group, the pool is rounded up to a multiple of it
+#define SYNTH_GROUP 16
+
+enum SynthParam {
+  SYNTH_ATTACK,    // seconds to full level
+  SYNTH_DECAY,     // seconds to the sustain level, to within 60 dB
+  SYNTH_SUSTAIN,   // 0 to 1
+  SYNTH_RELEASE,   // seconds to silence, to within 60 dB
+  SYNTH_CUTOFF,    // hertz at a4, the filter follows the key at half rate
+  SYNTH_RESONANCE, // 0 to 1
+  SYNTH_GAIN,      // linear, per voice at full velocity
+  SYNTH_PARAM_COUNT,
+};
+
+// not real-time safe. `lane` is where the node gets its notes, NULL to
+// drive it with synthRender alone. uses the widest kernel the cpu runs
+Synth makeSynth(int sampleRate, int voices, NoteLane lane);
+void freeSynth(Synth s);
+
+// real-time safe. sounding voices follow the change at once
+void synthSetParam(Synth s, enum SynthParam param, float value);
+
+// real-time safe. replaces `out` with `frames` of the synth, each event
+// applied at its offset. events must be in offset order
+void synthRender(Synth s, const struct MidiEvent *events, int count,
+                 float *out, int frames);
+
+// voices sounding, and note ons that had to steal one
+int synthVoiceCount(Synth s);
+int synthActiveVoices(Synth s);
+uint64_t synthStolenVoices(Synth s);
+
+// renders with a specific kernel, for benchmarks. isas without one render
+// with the scalar kernel. returns 0 if the cpu can't run it
+int synthUseKernel(Synth s, enum DspIsa isa);
+
+// a graph node with the synth as its state: the lane's notes, mono, copied
+// to every output
+void synthNodeProcess(void *state, const struct ProcessContext *ctx);
+void synthNodeSetParam(void *state, uint32_t param, float value);
+
+// KERNELS, see synth_*.c
+
+// the voices, SYNTH_GROUP aligned arrays of one field each
+struct SynthVoices {
+  // oscillator, in cycles per sample. inverse is 1 / increment
+  float *phase, *increment, *inverse;
+  // simper's state variable filter: coefficients and the two integrators
+  float *a1, *a2, *a3, *ic1, *ic2;
+  // envelope, moving `rate` of the way to `target` every sample. a target
+  // above one is the attack, reaching one hands over to the decay
+  float *env, *target, *rate;
+  float *gain;
+  float sustain, decayRate;
+};
+
+// adds the group of voices starting at `first` into `out`
+typedef void (*SynthKernel)(struct SynthVoices *v, int first, float *out,
+                            int frames);
+
+void synthKernelScalar(struct SynthVoices *v, int first, float *out,
+                       int frames);
+#if defined(__x86_64__) || defined(__i386__)
+void synthKernelAvx2(struct SynthVoices *v, int first, float *out, int frames);
+void synthKernelAvx512(struct SynthVoices *v, int first, float *out,
+                       int frames);
+#endif
+
+#endif
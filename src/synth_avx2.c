@@ -0,0 +1,86 @@
+#include "synth.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static float sum8(__m256 x) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(x),
+                        _mm256_extractf128_ps(x, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+// the scalar kernel's operations, eight voices at a time. the arrays are
+// aligned to the group, so every load is
+AVX2 void synthKernelAvx2(struct SynthVoices *v, int first, float *out,
+                          int frames) {
+  __m256 one = _mm256_set1_ps(1.0f);
+  __m256 two = _mm256_set1_ps(2.0f);
+  __m256 sustain = _mm256_set1_ps(v->sustain);
+  __m256 decayRate = _mm256_set1_ps(v->decayRate);
+
+  for (int n = first; n < first + SYNTH_GROUP; n += 8) {
+    __m256 phase = _mm256_load_ps(v->phase + n);
+    __m256 dt = _mm256_load_ps(v->increment + n);
+    __m256 inv = _mm256_load_ps(v->inverse + n);
+    __m256 a1 = _mm256_load_ps(v->a1 + n);
+    __m256 a2 = _mm256_load_ps(v->a2 + n);
+    __m256 a3 = _mm256_load_ps(v->a3 + n);
+    __m256 ic1 = _mm256_load_ps(v->ic1 + n);
+    __m256 ic2 = _mm256_load_ps(v->ic2 + n);
+    __m256 env = _mm256_load_ps(v->env + n);
+    __m256 target = _mm256_load_ps(v->target + n);
+    __m256 rate = _mm256_load_ps(v->rate + n);
+    __m256 gain = _mm256_load_ps(v->gain + n);
+    __m256 end = _mm256_sub_ps(one, dt);
+
+    for (int i = 0; i < frames; i++) {
+      // saw
+      __m256 t = phase;
+      __m256 saw = _mm256_sub_ps(_mm256_mul_ps(two, t), one);
+      __m256 x = _mm256_mul_ps(t, inv);
+      __m256 before = _mm256_sub_ps(
+          _mm256_sub_ps(_mm256_add_ps(x, x), _mm256_mul_ps(x, x)), one);
+      before = _mm256_and_ps(before, _mm256_cmp_ps(t, dt, _CMP_LT_OQ));
+      __m256 y = _mm256_mul_ps(_mm256_sub_ps(t, one), inv);
+      __m256 after = _mm256_add_ps(
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, y), y), y), one);
+      after = _mm256_and_ps(after, _mm256_cmp_ps(t, end, _CMP_GT_OQ));
+      saw = _mm256_sub_ps(_mm256_sub_ps(saw, before), after);
+      phase = _mm256_add_ps(t, dt);
+      phase = _mm256_blendv_ps(phase, _mm256_sub_ps(phase, one),
+                               _mm256_cmp_ps(phase, one, _CMP_GE_OQ));
+
+      // lowpass
+      __m256 v3 = _mm256_sub_ps(saw, ic2);
+      __m256 v1 =
+          _mm256_add_ps(_mm256_mul_ps(a1, ic1), _mm256_mul_ps(a2, v3));
+      __m256 v2 = _mm256_add_ps(_mm256_add_ps(ic2, _mm256_mul_ps(a2, ic1)),
+                                _mm256_mul_ps(a3, v3));
+      ic1 = _mm256_sub_ps(_mm256_mul_ps(two, v1), ic1);
+      ic2 = _mm256_sub_ps(_mm256_mul_ps(two, v2), ic2);
+
+      // envelope
+      env = _mm256_add_ps(
+          env, _mm256_mul_ps(_mm256_sub_ps(target, env), rate));
+      __m256 decay = _mm256_and_ps(_mm256_cmp_ps(env, one, _CMP_GE_OQ),
+                                   _mm256_cmp_ps(target, one, _CMP_GT_OQ));
+      target = _mm256_blendv_ps(target, sustain, decay);
+      rate = _mm256_blendv_ps(rate, decayRate, decay);
+
+      out[i] += sum8(_mm256_mul_ps(_mm256_mul_ps(v2, env), gain));
+    }
+
+    _mm256_store_ps(v->phase + n, phase);
+    _mm256_store_ps(v->ic1 + n, ic1);
+    _mm256_store_ps(v->ic2 + n, ic2);
+    _mm256_store_ps(v->env + n, env);
+    _mm256_store_ps(v->target + n, target);
+    _mm256_store_ps(v->rate + n, rate);
+  }
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include "synth.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AVX512 __attribute__((target("avx512f")))
+
+// the scalar kernel's operations, the whole group at once
+AVX512 void synthKernelAvx512(struct SynthVoices *v, int first, float *out,
+                              int frames) {
+  __m512 one = _mm512_set1_ps(1.0f);
+  __m512 two = _mm512_set1_ps(2.0f);
+  __m512 sustain = _mm512_set1_ps(v->sustain);
+  __m512 decayRate = _mm512_set1_ps(v->decayRate);
+
+  int n = first;
+  __m512 phase = _mm512_load_ps(v->phase + n);
+  __m512 dt = _mm512_load_ps(v->increment + n);
+  __m512 inv = _mm512_load_ps(v->inverse + n);
+  __m512 a1 = _mm512_load_ps(v->a1 + n);
+  __m512 a2 = _mm512_load_ps(v->a2 + n);
+  __m512 a3 = _mm512_load_ps(v->a3 + n);
+  __m512 ic1 = _mm512_load_ps(v->ic1 + n);
+  __m512 ic2 = _mm512_load_ps(v->ic2 + n);
+  __m512 env = _mm512_load_ps(v->env + n);
+  __m512 target = _mm512_load_ps(v->target + n);
+  __m512 rate = _mm512_load_ps(v->rate + n);
+  __m512 gain = _mm512_load_ps(v->gain + n);
+  __m512 end = _mm512_sub_ps(one, dt);
+
+  for (int i = 0; i < frames; i++) {
+    // saw
+    __m512 t = phase;
+    __m512 saw = _mm512_sub_ps(_mm512_mul_ps(two, t), one);
+    __m512 x = _mm512_mul_ps(t, inv);
+    __m512 before = _mm512_sub_ps(
+        _mm512_sub_ps(_mm512_add_ps(x, x), _mm512_mul_ps(x, x)), one);
+    before = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(t, dt, _CMP_LT_OQ),
+                                 before);
+    __m512 y = _mm512_mul_ps(_mm512_sub_ps(t, one), inv);
+    __m512 after = _mm512_add_ps(
+        _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(y, y), y), y), one);
+    after = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(t, end, _CMP_GT_OQ),
+                                after);
+    saw = _mm512_sub_ps(_mm512_sub_ps(saw, before), after);
+    phase = _mm512_add_ps(t, dt);
+    phase = _mm512_mask_sub_ps(phase,
+                               _mm512_cmp_ps_mask(phase, one, _CMP_GE_OQ),
+                               phase, one);
+
+    // lowpass
+    __m512 v3 = _mm512_sub_ps(saw, ic2);
+    __m512 v1 = _mm512_add_ps(_mm512_mul_ps(a1, ic1), _mm512_mul_ps(a2, v3));
+    __m512 v2 = _mm512_add_ps(_mm512_add_ps(ic2, _mm512_mul_ps(a2, ic1)),
+                              _mm512_mul_ps(a3, v3));
+    ic1 = _mm512_sub_ps(_mm512_mul_ps(two, v1), ic1);
+    ic2 = _mm512_sub_ps(_mm512_mul_ps(two, v2), ic2);
+
+    // envelope
+    env = _mm512_add_ps(env,
+                        _mm512_mul_ps(_mm512_sub_ps(target, env), rate));
+    __mmask16 decay = _mm512_cmp_ps_mask(env, one, _CMP_GE_OQ) &
+                      _mm512_cmp_ps_mask(target, one, _CMP_GT_OQ);
+    target = _mm512_mask_mov_ps(target, decay, sustain);
+    rate = _mm512_mask_mov_ps(rate, decay, decayRate);
+
+    out[i] += _mm512_reduce_add_ps(
+        _mm512_mul_ps(_mm512_mul_ps(v2, env), gain));
+  }
+
+  _mm512_store_ps(v->phase + n, phase);
+  _mm512_store_ps(v->ic1 + n, ic1);
+  _mm512_store_ps(v->ic2 + n, ic2);
+  _mm512_store_ps(v->env + n, env);
+  _mm512_store_ps(v->target + n, target);
+  _mm512_store_ps(v->rate + n, rate);
+}
+
+#endif
@@ -0,0 +1,313 @@
+#include "tempo.h"
+
+#include "dsp.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// segments a cursor steps forward through before giving up and searching
+#define CURSOR_STEPS 4
+
+enum Axis {
+  AXIS_BEAT,
+  AXIS_SAMPLE,
+  AXIS_BAR,
+};
+
+// where a segment starts on each axis, and how to get around inside it.
+// constant tempo is an affine map either way, a ramp goes by its velocity
+// and acceleration in beats per sample
+struct Segment {
+  double start[3]; // by enum Axis
+  double beatsPerBar;
+  double samplesPerBeat, sampleOffset;
+  double beatsPerSample, beatOffset;
+  double velocity, acceleration; // acceleration is 0 for constant tempo
+  int point;                     // the time signature
+};
+
+struct TempoMap {
+  atomic_int references;
+  int sampleRate;
+  int count;
+  struct TempoPoint *points; // after the segments
+  int segmentCount;
+  struct Segment segments[];
+};
+
+// PRIVATE FUNCTIONS
+
+struct Sortable {
+  struct TempoPoint point;
+  int index;
+};
+
+static int compareSortable(const void *x, const void *y) {
+  const struct Sortable *a = x, *b = y;
+  if (a->point.beat != b->point.beat) {
+    return a->point.beat < b->point.beat ? -1 : 1;
+  }
+  return a->index - b->index;
+}
+
+// index of the last segment starting at or before `x`, 0 before them all
+static int search(TempoMap m, enum Axis axis, double x) {
+  int low = 1, high = m->segmentCount;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (m->segments[mid].start[axis] <= x) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low - 1;
+}
+
+static int locate(TempoMap m, struct TempoCursor *c, enum Axis axis,
+                  double x) {
+  int s = c->segment;
+  if (c->map == m && c->axis == (int)axis && s < m->segmentCount &&
+      (s == 0 || m->segments[s].start[axis] <= x)) {
+    for (int step = 0; step < CURSOR_STEPS; step++) {
+      if (s + 1 == m->segmentCount || m->segments[s + 1].start[axis] > x) {
+        c->segment = s;
+        return s;
+      }
+      s++;
+    }
+  }
+  c->map = m;
+  c->axis = axis;
+  c->segment = search(m, axis, x);
+  return c->segment;
+}
+
+// the positions `s` covers on `axis`, the first segment reaches back forever
+static void bounds(TempoMap m, int s, enum Axis axis, double *low,
+                   double *high) {
+  *low = s == 0 ? -INFINITY : m->segments[s].start[axis];
+  *high = s + 1 == m->segmentCount ? INFINITY
+                                   : m->segments[s + 1].start[axis];
+}
+
+// a ramp's beat to sample, the inverse of b = v t + a t^2 / 2 written so
+// that it holds as the acceleration goes to 0. before the start of the map
+// the first tempo carries on
+static double rampSample(const struct Segment *g, double beat) {
+  double b = beat - g->start[AXIS_BEAT];
+  if (b < 0) {
+    return g->start[AXIS_SAMPLE] + b / g->velocity;
+  }
+  double v = g->velocity;
+  double root = sqrt(v * v + 2 * g->acceleration * b);
+  return g->start[AXIS_SAMPLE] + 2 * b / (v + root);
+}
+
+static double rampBeat(const struct Segment *g, double sample) {
+  double t = sample - g->start[AXIS_SAMPLE];
+  if (t < 0) {
+    return g->start[AXIS_BEAT] + t * g->velocity;
+  }
+  return g->start[AXIS_BEAT] + t * (g->velocity + g->acceleration * t / 2);
+}
+
+static double sampleIn(const struct Segment *g, double beat) {
+  return g->acceleration == 0 ? g->sampleOffset + beat * g->samplesPerBeat
+                              : rampSample(g, beat);
+}
+
+static double beatIn(const struct Segment *g, double sample) {
+  return g->acceleration == 0 ? g->beatOffset + sample * g->beatsPerSample
+                              : rampBeat(g, sample);
+}
+
+// `n` positions in a row on `axis` go to `offset + scale * converted`, one
+// segment's run at a time
+static void convert(TempoMap m, struct TempoCursor *c, enum Axis axis,
+                    const double *in, double *out, int n, double offset,
+                    double scale) {
+  for (int i = 0; i < n;) {
+    int s = locate(m, c, axis, in[i]);
+    const struct Segment *g = &m->segments[s];
+    double low, high;
+    bounds(m, s, axis, &low, &high);
+    int end = i + 1;
+    while (end < n && in[end] >= low && in[end] < high) {
+      end++;
+    }
+
+    if (g->acceleration == 0) {
+      double a = axis == AXIS_BEAT ? g->sampleOffset : g->beatOffset;
+      double b = axis == AXIS_BEAT ? g->samplesPerBeat : g->beatsPerSample;
+      dsp->affine(out + i, in + i, offset + scale * a, scale * b, end - i);
+    } else {
+      for (int j = i; j < end; j++) {
+        double x = axis == AXIS_BEAT ? rampSample(g, in[j])
+                                     : rampBeat(g, in[j]);
+        out[j] = offset + scale * x;
+      }
+    }
+    i = end;
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+TempoMap makeTempoMap(const struct TempoPoint *points, int count,
+                      int sampleRate) {
+  if (count <= 0 || sampleRate <= 0) {
+    return NULL;
+  }
+  struct Sortable *sorted = malloc(count * sizeof(struct Sortable));
+  for (int i = 0; i < count; i++) {
+    sorted[i] = (struct Sortable){points[i], i};
+  }
+  qsort(sorted, count, sizeof(struct Sortable), compareSortable);
+
+  // the last of the points sharing a beat wins
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    struct TempoPoint p = sorted[i].point;
+    if (!(p.bpm > 0) || p.beat < 0 || p.numerator <= 0 ||
+        p.denominator <= 0) {
+      free(sorted);
+      return NULL;
+    }
+    if (kept && sorted[kept - 1].point.beat == p.beat) {
+      kept--;
+    }
+    sorted[kept++].point = p;
+  }
+
+  int lead = sorted[0].point.beat > 0; // a segment from beat 0 to the first
+  int segmentCount = kept + lead;
+  TempoMap m = malloc(sizeof(struct TempoMap) +
+                      segmentCount * sizeof(struct Segment) +
+                      kept * sizeof(struct TempoPoint));
+  atomic_init(&m->references, 1);
+  m->sampleRate = sampleRate;
+  m->count = kept;
+  m->segmentCount = segmentCount;
+  m->points = (struct TempoPoint *)(m->segments + segmentCount);
+  for (int i = 0; i < kept; i++) {
+    m->points[i] = sorted[i].point;
+  }
+  free(sorted);
+
+  double beat = 0, sample = 0, bar = 0;
+  for (int s = 0; s < segmentCount; s++) {
+    int p = s - lead < 0 ? 0 : s - lead;
+    const struct TempoPoint *point = &m->points[p];
+    struct Segment *g = &m->segments[s];
+    g->point = p;
+    g->beatsPerBar = point->numerator * 4.0 / point->denominator;
+    if (s > 0) {
+      const struct Segment *last = g - 1;
+      double beats = point->beat - last->start[AXIS_BEAT];
+      sample = last->acceleration == 0
+                   ? last->start[AXIS_SAMPLE] + beats * last->samplesPerBeat
+                   : rampSample(last, point->beat);
+      bar = last->start[AXIS_BAR] + beats / last->beatsPerBar;
+      // a new time signature starts a new bar
+      const struct TempoPoint *before = &m->points[last->point];
+      if (point->numerator != before->numerator ||
+          point->denominator != before->denominator) {
+        bar = ceil(bar - 1e-9);
+      }
+      beat = point->beat;
+    }
+    g->start[AXIS_BEAT] = beat;
+    g->start[AXIS_SAMPLE] = sample;
+    g->start[AXIS_BAR] = bar;
+
+    g->velocity = point->bpm / (60.0 * sampleRate);
+    g->samplesPerBeat = 1 / g->velocity;
+    g->beatsPerSample = g->velocity;
+    g->sampleOffset = sample - beat * g->samplesPerBeat;
+    g->beatOffset = beat - sample * g->beatsPerSample;
+
+    // tempo linear in time: the segment's beats take 2 b / (v0 + v1) samples
+    g->acceleration = 0;
+    if (s >= lead && point->ramp && p + 1 < kept &&
+        m->points[p + 1].bpm != point->bpm) {
+      double v1 = m->points[p + 1].bpm / (60.0 * sampleRate);
+      double beats = m->points[p + 1].beat - beat;
+      double length = 2 * beats / (g->velocity + v1);
+      g->acceleration = (v1 - g->velocity) / length;
+    }
+  }
+  return m;
+}
+
+void tempoRetain(TempoMap m) {
+  atomic_fetch_add_explicit(&m->references, 1, memory_order_relaxed);
+}
+
+void tempoRelease(TempoMap m) {
+  if (m && atomic_fetch_sub_explicit(&m->references, 1,
+                                     memory_order_acq_rel) == 1) {
+    free(m);
+  }
+}
+
+int tempoCount(TempoMap m) { return m->count; }
+
+const struct TempoPoint *tempoPoints(TempoMap m) { return m->points; }
+
+int tempoSampleRate(TempoMap m) { return m->sampleRate; }
+
+double tempoSampleAt(TempoMap m, struct TempoCursor *c, double beat) {
+  return sampleIn(&m->segments[locate(m, c, AXIS_BEAT, beat)], beat);
+}
+
+double tempoBeatAt(TempoMap m, struct TempoCursor *c, double sample) {
+  return beatIn(&m->segments[locate(m, c, AXIS_SAMPLE, sample)], sample);
+}
+
+double tempoBpmAt(TempoMap m, struct TempoCursor *c, double beat) {
+  const struct Segment *g = &m->segments[locate(m, c, AXIS_BEAT, beat)];
+  double velocity = g->velocity;
+  if (g->acceleration != 0 && beat > g->start[AXIS_BEAT]) {
+    velocity += g->acceleration * (rampSample(g, beat) - g->start[AXIS_SAMPLE]);
+  }
+  return velocity * 60.0 * m->sampleRate;
+}
+
+double tempoBarAt(TempoMap m, struct TempoCursor *c, double beat) {
+  const struct Segment *g = &m->segments[locate(m, c, AXIS_BEAT, beat)];
+  return g->start[AXIS_BAR] + (beat - g->start[AXIS_BEAT]) / g->beatsPerBar;
+}
+
+double tempoBeatAtBar(TempoMap m, struct TempoCursor *c, double bar) {
+  const struct Segment *g = &m->segments[locate(m, c, AXIS_BAR, bar)];
+  return g->start[AXIS_BEAT] + (bar - g->start[AXIS_BAR]) * g->beatsPerBar;
+}
+
+struct TempoPoint tempoSignatureAt(TempoMap m, struct TempoCursor *c,
+                                   double beat) {
+  return m->points[m->segments[locate(m, c, AXIS_BEAT, beat)].point];
+}
+
+void tempoSamplesAt(TempoMap m, struct TempoCursor *c, const double *beats,
+                    double *samples, int n) {
+  convert(m, c, AXIS_BEAT, beats, samples, n, 0, 1);
+}
+
+void tempoBeatsAt(TempoMap m, struct TempoCursor *c, const double *samples,
+                  double *beats, int n) {
+  convert(m, c, AXIS_SAMPLE, samples, beats, n, 0, 1);
+}
+
+void tempoPixelsAt(TempoMap m, struct TempoCursor *c, const double *beats,
+                   double *x, int n, double startSample,
+                   double pixelsPerSample) {
+  convert(m, c, AXIS_BEAT, beats, x, n, -startSample * pixelsPerSample,
+          pixelsPerSample);
+}
+
+size_t tempoBytes(TempoMap m) {
+  return sizeof(struct TempoMap) + m->segmentCount * sizeof(struct Segment) +
+         m->count * sizeof(struct TempoPoint);
+}
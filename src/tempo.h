@@ -0,0 +1,80 @@
+#ifndef TEMPO_H
+#define TEMPO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the tempo and time signature of the timeline, for going between beats,
+// samples, bars and pixels. the points are turned into a table of segments,
+// each knowing the beat, sample and bar it starts at, so a lookup is a binary
+// search and a few operations, never a walk from the start. within a segment
+// the tempo is constant or ramps linearly in time to the next point's, both
+// integrated in closed form. like automation curves, a map never changes once
+// made, an edit builds a new one, and every thread reads the one it holds
+// without locking. lookups are real-time safe.
+typedef struct TempoMap *TempoMap;
+
+struct TempoPoint {
+  double beat; // quarter notes from the start of the timeline
+  double bpm;
+  int ramp; // the tempo moves evenly in time to the next point's
+  int numerator, denominator; // the time signature from here on
+};
+
+// sorts a copy of the points. a point sharing a beat with an earlier one
+// replaces it. the first point's tempo and time signature also hold before
+// it, from beat 0. NULL without points or with a tempo that isn't positive
+TempoMap makeTempoMap(const struct TempoPoint *points, int count,
+                      int sampleRate);
+
+// shared by reference count, they start with one and the last release frees
+// them. not real-time safe
+void tempoRetain(TempoMap m);
+void tempoRelease(TempoMap m);
+
+int tempoCount(TempoMap m);
+const struct TempoPoint *tempoPoints(TempoMap m);
+int tempoSampleRate(TempoMap m);
+
+// remembers the segment the last lookup landed in. moving forward finds the
+// next one in constant time, a jump falls back to a binary search. zero it
+// to start, it notices when it's used with another map, or for another kind
+// of position
+struct TempoCursor {
+  TempoMap map;
+  int axis;
+  int segment;
+};
+
+// positions are fractional. before beat 0 the first segment carries on
+double tempoSampleAt(TempoMap m, struct TempoCursor *c, double beat);
+double tempoBeatAt(TempoMap m, struct TempoCursor *c, double sample);
+double tempoBpmAt(TempoMap m, struct TempoCursor *c, double beat);
+
+// bars from 0, fractional within a bar. a time signature change starts a new
+// bar even if the last one wasn't full
+double tempoBarAt(TempoMap m, struct TempoCursor *c, double beat);
+double tempoBeatAtBar(TempoMap m, struct TempoCursor *c, double bar);
+
+// the time signature in force at `beat`
+struct TempoPoint tempoSignatureAt(TempoMap m, struct TempoCursor *c,
+                                   double beat);
+
+// many positions at once, for drawing and blocks of events. runs within a
+// constant tempo segment are one vector kernel call each, so ascending input
+// is fastest, though any order works. `out` may be `in`
+void tempoSamplesAt(TempoMap m, struct TempoCursor *c, const double *beats,
+                    double *samples, int n);
+void tempoBeatsAt(TempoMap m, struct TempoCursor *c, const double *samples,
+                  double *beats, int n);
+
+// beats to pixels for a view starting at `startSample` with `pixelsPerSample`
+// in one pass, grid lines and note edges
+void tempoPixelsAt(TempoMap m, struct TempoCursor *c, const double *beats,
+                   double *x, int n, double startSample,
+                   double pixelsPerSample);
+
+// memory the map holds, for accounting
+size_t tempoBytes(TempoMap m);
+
+#endif
@@ -0,0 +1,367 @@
+#include "vector.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITS 5
+#define WIDTH (1 << BITS)
+#define MASK (WIDTH - 1)
+
+// followed by child pointers in a branch or items in a leaf, exactly as many
+// as it holds
+struct Node {
+  atomic_int references;
+  int count;
+};
+
+struct Vector {
+  atomic_int references;
+  int count;
+  int shift; // of the root, 0 when it's a leaf
+  const struct VectorItems *items;
+  struct Node *root; // NULL when empty
+};
+
+// PRIVATE FUNCTIONS
+
+static struct Node **children(struct Node *n) {
+  return (struct Node **)(n + 1);
+}
+
+static uint8_t *itemsOf(struct Node *n) { return (uint8_t *)(n + 1); }
+
+static size_t nodeBytes(const struct VectorItems *items, int shift,
+                        int count) {
+  return sizeof(struct Node) +
+         count * (shift ? sizeof(struct Node *) : items->size);
+}
+
+static struct Node *allocateNode(const struct VectorItems *items, int shift,
+                                 int count) {
+  struct Node *n = malloc(nodeBytes(items, shift, count));
+  atomic_init(&n->references, 1);
+  n->count = count;
+  return n;
+}
+
+static void retainNode(struct Node *n) {
+  atomic_fetch_add_explicit(&n->references, 1, memory_order_relaxed);
+}
+
+static void releaseNode(const struct VectorItems *items, struct Node *n,
+                        int shift) {
+  if (atomic_fetch_sub_explicit(&n->references, 1, memory_order_acq_rel) !=
+      1) {
+    return;
+  }
+  for (int i = 0; i < n->count; i++) {
+    if (shift) {
+      releaseNode(items, children(n)[i], shift - BITS);
+    } else if (items->release) {
+      items->release(itemsOf(n) + i * items->size);
+    }
+  }
+  free(n);
+}
+
+static void putItem(const struct VectorItems *items, struct Node *leaf,
+                    int slot, const void *item) {
+  uint8_t *at = itemsOf(leaf) + slot * items->size;
+  memcpy(at, item, items->size);
+  if (items->retain) {
+    items->retain(at);
+  }
+}
+
+// the first `count` entries of `n` and room for `capacity`, each referenced
+static struct Node *copyNode(const struct VectorItems *items, struct Node *n,
+                             int shift, int count, int capacity) {
+  struct Node *c = allocateNode(items, shift, capacity);
+  if (shift) {
+    memcpy(children(c), children(n), count * sizeof(struct Node *));
+    for (int i = 0; i < count; i++) {
+      retainNode(children(c)[i]);
+    }
+  } else {
+    memcpy(itemsOf(c), itemsOf(n), count * items->size);
+    for (int i = 0; items->retain && i < count; i++) {
+      items->retain(itemsOf(c) + i * items->size);
+    }
+  }
+  return c;
+}
+
+// swaps in a child the copy doesn't reference yet
+static void replaceChild(const struct VectorItems *items, struct Node *c,
+                         int shift, int slot, struct Node *child) {
+  releaseNode(items, children(c)[slot], shift - BITS);
+  children(c)[slot] = child;
+}
+
+static struct Node *newPath(const struct VectorItems *items, int shift,
+                            const void *item) {
+  struct Node *n = allocateNode(items, shift, 1);
+  if (shift) {
+    children(n)[0] = newPath(items, shift - BITS, item);
+  } else {
+    putItem(items, n, 0, item);
+  }
+  return n;
+}
+
+static struct Node *setIn(const struct VectorItems *items, struct Node *n,
+                          int shift, int index, const void *item) {
+  int slot = (index >> shift) & MASK;
+  struct Node *c = copyNode(items, n, shift, n->count, n->count);
+  if (shift) {
+    replaceChild(items, c, shift, slot,
+                 setIn(items, children(n)[slot], shift - BITS, index, item));
+  } else {
+    if (items->release) {
+      items->release(itemsOf(c) + slot * items->size);
+    }
+    putItem(items, c, slot, item);
+  }
+  return c;
+}
+
+// `index` is one past the last item, the root has room for it
+static struct Node *pushIn(const struct VectorItems *items, struct Node *n,
+                           int shift, int index, const void *item) {
+  int slot = (index >> shift) & MASK;
+  if (slot == n->count) {
+    struct Node *c = copyNode(items, n, shift, n->count, n->count + 1);
+    if (shift) {
+      children(c)[slot] = newPath(items, shift - BITS, item);
+    } else {
+      putItem(items, c, slot, item);
+    }
+    return c;
+  }
+
+  // the last child has room
+  struct Node *c = copyNode(items, n, shift, n->count, n->count);
+  replaceChild(items, c, shift, slot,
+               pushIn(items, children(n)[slot], shift - BITS, index, item));
+  return c;
+}
+
+// the items of `n` up to and including `last`. shares `n` when it ends there
+// already
+static struct Node *take(const struct VectorItems *items, struct Node *n,
+                         int shift, int last) {
+  int slot = (last >> shift) & MASK;
+  if (!shift) {
+    if (slot + 1 == n->count) {
+      retainNode(n);
+      return n;
+    }
+    return copyNode(items, n, 0, slot + 1, slot + 1);
+  }
+
+  struct Node *child = take(items, children(n)[slot], shift - BITS, last);
+  if (child == children(n)[slot] && slot + 1 == n->count) {
+    releaseNode(items, child, shift - BITS);
+    retainNode(n);
+    return n;
+  }
+  struct Node *c = copyNode(items, n, shift, slot + 1, slot + 1);
+  replaceChild(items, c, shift, slot, child);
+  return c;
+}
+
+static Vector makeWith(const struct VectorItems *items, int count, int shift,
+                       struct Node *root) {
+  Vector v = malloc(sizeof(struct Vector));
+  atomic_init(&v->references, 1);
+  v->count = count;
+  v->shift = shift;
+  v->items = items;
+  v->root = root;
+  return v;
+}
+
+// the first `count` items
+static Vector truncated(Vector v, int count) {
+  if (count == 0) {
+    return makeVector(v->items);
+  }
+  struct Node *root = take(v->items, v->root, v->shift, count - 1);
+  int shift = v->shift;
+
+  // a root with one child gives way to it
+  while (shift > 0 && root->count == 1) {
+    struct Node *child = children(root)[0];
+    retainNode(child);
+    releaseNode(v->items, root, shift);
+    root = child;
+    shift -= BITS;
+  }
+  return makeWith(v->items, count, shift, root);
+}
+
+// a path down to `leaf` from a node at `shift`
+static struct Node *pathTo(const struct VectorItems *items, int shift,
+                           struct Node *leaf) {
+  if (!shift) {
+    return leaf;
+  }
+  struct Node *n = allocateNode(items, shift, 1);
+  children(n)[0] = pathTo(items, shift - BITS, leaf);
+  return n;
+}
+
+// hangs `leaf` on as the child holding `index`, the first item past the end
+static struct Node *attach(const struct VectorItems *items, struct Node *n,
+                           int shift, int index, struct Node *leaf) {
+  int slot = (index >> shift) & MASK;
+  if (slot == n->count) {
+    struct Node *c = copyNode(items, n, shift, n->count, n->count + 1);
+    children(c)[slot] = pathTo(items, shift - BITS, leaf);
+    return c;
+  }
+  struct Node *c = copyNode(items, n, shift, n->count, n->count);
+  replaceChild(items, c, shift, slot,
+               attach(items, children(n)[slot], shift - BITS, index, leaf));
+  return c;
+}
+
+// appends a leaf to a vector that ends on a leaf boundary, takes over both
+static Vector pushLeaf(Vector v, struct Node *leaf) {
+  const struct VectorItems *items = v->items;
+  Vector u;
+  if (!v->root) {
+    u = makeWith(items, leaf->count, 0, leaf);
+  } else if (v->count == 1 << (v->shift + BITS)) {
+    // the root is full, grow a level
+    struct Node *root = allocateNode(items, v->shift + BITS, 2);
+    retainNode(v->root);
+    children(root)[0] = v->root;
+    children(root)[1] = pathTo(items, v->shift, leaf);
+    u = makeWith(items, v->count + leaf->count, v->shift + BITS, root);
+  } else {
+    u = makeWith(items, v->count + leaf->count, v->shift,
+                 attach(items, v->root, v->shift, v->count, leaf));
+  }
+  vectorRelease(v);
+  return u;
+}
+
+// `item` goes in at `index`, or the item there goes if `item` is NULL. the
+// leaves before the one holding `index` are shared, the rest are rebuilt a
+// leaf at a time
+static Vector spliced(Vector v, int index, const void *item) {
+  const struct VectorItems *items = v->items;
+  int from = index & ~MASK;
+  int count = v->count - from + (item ? 1 : -1);
+  uint8_t *rest = malloc((size_t)(count + 1) * items->size);
+  for (int i = from, j = 0; i < v->count; i++) {
+    if (i == index) {
+      if (!item) {
+        continue;
+      }
+      memcpy(rest + j++ * items->size, item, items->size);
+    }
+    memcpy(rest + j++ * items->size, vectorGet(v, i), items->size);
+  }
+  if (item && index == v->count) {
+    memcpy(rest + (count - 1) * items->size, item, items->size);
+  }
+
+  Vector u = truncated(v, from);
+  for (int i = 0; i < count; i += WIDTH) {
+    int n = count - i < WIDTH ? count - i : WIDTH;
+    struct Node *leaf = allocateNode(items, 0, n);
+    for (int j = 0; j < n; j++) {
+      putItem(items, leaf, j, rest + (i + j) * items->size);
+    }
+    u = pushLeaf(u, leaf);
+  }
+  free(rest);
+  return u;
+}
+
+static void walkNode(const struct VectorItems *items, struct Node *n,
+                     int shift, const struct VectorWalk *walk) {
+  if (!walk->node(walk->context, n, nodeBytes(items, shift, n->count))) {
+    return;
+  }
+  for (int i = 0; i < n->count; i++) {
+    if (shift) {
+      walkNode(items, children(n)[i], shift - BITS, walk);
+    } else if (walk->item) {
+      walk->item(walk->context, itemsOf(n) + i * items->size);
+    }
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+Vector makeVector(const struct VectorItems *items) {
+  return makeWith(items, 0, 0, NULL);
+}
+
+void vectorRetain(Vector v) {
+  atomic_fetch_add_explicit(&v->references, 1, memory_order_relaxed);
+}
+
+void vectorRelease(Vector v) {
+  if (!v || atomic_fetch_sub_explicit(&v->references, 1,
+                                      memory_order_acq_rel) != 1) {
+    return;
+  }
+  if (v->root) {
+    releaseNode(v->items, v->root, v->shift);
+  }
+  free(v);
+}
+
+int vectorCount(Vector v) { return v->count; }
+
+const void *vectorGet(Vector v, int index) {
+  struct Node *n = v->root;
+  for (int shift = v->shift; shift > 0; shift -= BITS) {
+    n = children(n)[(index >> shift) & MASK];
+  }
+  return itemsOf(n) + (index & MASK) * v->items->size;
+}
+
+Vector vectorSet(Vector v, int index, const void *item) {
+  return makeWith(v->items, v->count, v->shift,
+                  setIn(v->items, v->root, v->shift, index, item));
+}
+
+Vector vectorPush(Vector v, const void *item) {
+  if (!v->root) {
+    return makeWith(v->items, 1, 0, newPath(v->items, 0, item));
+  }
+  if (v->count == 1 << (v->shift + BITS)) {
+    // the root is full, grow a level
+    int shift = v->shift + BITS;
+    struct Node *root = allocateNode(v->items, shift, 2);
+    retainNode(v->root);
+    children(root)[0] = v->root;
+    children(root)[1] = newPath(v->items, v->shift, item);
+    return makeWith(v->items, v->count + 1, shift, root);
+  }
+  return makeWith(v->items, v->count + 1, v->shift,
+                  pushIn(v->items, v->root, v->shift, v->count, item));
+}
+
+Vector vectorPop(Vector v) {
+  return truncated(v, v->count > 0 ? v->count - 1 : 0);
+}
+
+Vector vectorInsert(Vector v, int index, const void *item) {
+  return spliced(v, index, item);
+}
+
+Vector vectorRemove(Vector v, int index) { return spliced(v, index, NULL); }
+
+void vectorWalk(Vector v, const struct VectorWalk *walk) {
+  if (walk->node(walk->context, v, sizeof(struct Vector)) && v->root) {
+    walkNode(v->items, v->root, v->shift, walk);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stddef.h>
+
+// persistent vectors: a 32 way trie of reference counted nodes. a vector never
+// changes once made, an edit copies the path to the item it touches and
+// shares every other node with the vector it came from, so keeping old
+// versions around costs only what differs. like note tracks and curves they
+// are shared between threads by reference count.
+typedef struct Vector *Vector;
+
+// what a vector holds: items of `size` bytes stored inline in the leaves.
+// items that own something pass retain and release, they're called as leaves
+// are copied and freed. must outlive every vector made with it
+struct VectorItems {
+  size_t size;
+  void (*retain)(const void *item);
+  void (*release)(const void *item);
+};
+
+// an empty vector with one reference
+Vector makeVector(const struct VectorItems *items);
+
+// the last release frees it, and the nodes nothing else shares
+void vectorRetain(Vector v);
+void vectorRelease(Vector v);
+
+int vectorCount(Vector v);
+
+// points into the leaf, valid while `v` is. real-time safe
+const void *vectorGet(Vector v, int index);
+
+// edits. each returns a new vector with one reference and leaves `v` alone.
+// setting, pushing and popping copy one path, O(log n). inserting and
+// removing move everything after `index`, so only the leaves before it are
+// shared and the rest are rebuilt, O(n - index)
+Vector vectorSet(Vector v, int index, const void *item);
+Vector vectorPush(Vector v, const void *item);
+Vector vectorPop(Vector v);
+Vector vectorInsert(Vector v, int index, const void *item);
+Vector vectorRemove(Vector v, int index);
+
+// memory accounting. `node` gets the vector and each of its nodes with their
+// size in bytes and returns nonzero to go inside; `item` gets the items of
+// each leaf gone inside
+struct VectorWalk {
+  int (*node)(void *context, const void *node, size_t bytes);
+  void (*item)(void *context, const void *item);
+  void *context;
+};
+
+void vectorWalk(Vector v, const struct VectorWalk *walk);
+
+#endif
@@ -4,13 +4,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-struct Vec2 {
-  float x, y;
-};
-
-struct Vertex {
-  struct Vec2 pos;
-};
+#include "geometry.h"
 
 VkVertexInputBindingDescription getVertexBindingDescription(void);
 uint32_t getVertexAttributeDescriptionCount(void);
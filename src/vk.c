@@ -93,9 +93,8 @@ static uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
   die("failed to find suitable memory type!");
 }
 
-// PUBLIC FUNCTIONS
-
-VkInstance makeVkInstance(char *appName) {
+static VkInstance makeInstance(char *appName, const char **extensions,
+                               uint32_t extensionsCount) {
   VkInstance instance;
 
   // validation layers
@@ -112,10 +111,6 @@ VkInstance makeVkInstance(char *appName) {
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.apiVersion = VK_API_VERSION_1_0;
 
-  // required extensions
-  uint32_t extensionsCount = 0;
-  const char **extensions = instanceExtensions(&extensionsCount);
-
   // create info
   VkInstanceCreateInfo createInfo = {0};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -132,10 +127,104 @@ VkInstance makeVkInstance(char *appName) {
   if (result != VK_SUCCESS) {
     die("Failed to create instance: %d\n", result);
   }
+  return instance;
+}
+
+static VkDevice makeDevice(VkPhysicalDevice physicalDevice,
+                           int queueFamilyIndex, const char **extensions,
+                           uint32_t extensionsCount) {
+  VkDevice device;
+
+  // queue create info
+  VkDeviceQueueCreateInfo queueCreateInfo = {0};
+  queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
+  queueCreateInfo.queueCount = 1;
+  float queuePriority = 1.0f;
+  queueCreateInfo.pQueuePriorities = &queuePriority;
+
+  // device create info
+  VkDeviceCreateInfo createInfo = {0};
+  createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.queueCreateInfoCount = 1;
+  createInfo.pQueueCreateInfos = &queueCreateInfo;
+  createInfo.ppEnabledExtensionNames = extensions;
+  createInfo.enabledExtensionCount = extensionsCount;
+
+  // done
+  VkResult result = vkCreateDevice(physicalDevice, &createInfo, NULL, &device);
+  if (result != VK_SUCCESS) {
+    die("Failed to create logical device: %d\n", result);
+  }
+  return device;
+}
+
+static VkRenderPass makeRenderPass(VkDevice device, VkFormat format,
+                                   VkImageLayout finalLayout) {
+  VkAttachmentDescription colorAttachment = {0};
+  colorAttachment.format = format;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = finalLayout;
+
+  VkAttachmentReference colorAttachmentRef = {0};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {0};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+
+  VkSubpassDependency dependency = {0};
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.srcAccessMask = 0;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo = {0};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 1;
+  renderPassInfo.pDependencies = &dependency;
+
+  VkRenderPass renderPass;
+  VkResult result =
+      vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass);
+  if (result != VK_SUCCESS) {
+    die("Failed to create render pass: %d\n", result);
+  }
+  return renderPass;
+}
+
+// PUBLIC FUNCTIONS
+
+VkInstance makeVkInstance(char *appName) {
+  uint32_t extensionsCount = 0;
+  const char **extensions = instanceExtensions(&extensionsCount);
+  VkInstance instance = makeInstance(appName, extensions, extensionsCount);
   free(extensions);
   return instance;
 }
 
+VkInstance makeVkHeadlessInstance(char *appName) {
+#ifdef __APPLE__
+  const char *extensions[] = {VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME};
+  return makeInstance(appName, extensions, 1);
+#else
+  return makeInstance(appName, NULL, 0);
+#endif
+}
+
 VkSurfaceKHR makeVkSurface(VkInstance instance, GLFWwindow *window) {
   VkSurfaceKHR surface;
   if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
@@ -184,31 +273,33 @@ int findVkQueueFamilyIndex(VkPhysicalDevice device, VkSurfaceKHR surface) {
   die("No suitable queue family found\n");
 }
 
-VkDevice makeVkDevice(VkPhysicalDevice physicalDevice, int queueFamilyIndex) {
-  VkDevice device;
-
-  // queue create info
-  VkDeviceQueueCreateInfo queueCreateInfo = {0};
-  queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-  queueCreateInfo.queueCount = 1;
-  float queuePriority = 1.0f;
-  queueCreateInfo.pQueuePriorities = &queuePriority;
+int findVkGraphicsQueueFamilyIndex(VkPhysicalDevice device) {
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
 
-  // device create info
-  VkDeviceCreateInfo createInfo = {0};
-  createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  createInfo.queueCreateInfoCount = 1;
-  createInfo.pQueueCreateInfos = &queueCreateInfo;
-  createInfo.ppEnabledExtensionNames = deviceExtensions;
-  createInfo.enabledExtensionCount = DEVICE_EXTENSIONS;
+  VkQueueFamilyProperties *queueFamilies =
+      malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           queueFamilies);
 
-  // done
-  VkResult result = vkCreateDevice(physicalDevice, &createInfo, NULL, &device);
-  if (result != VK_SUCCESS) {
-    die("Failed to create logical device: %d\n", result);
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      free(queueFamilies);
+      return i;
+    }
   }
-  return device;
+
+  die("No graphics queue family found\n");
+}
+
+VkDevice makeVkDevice(VkPhysicalDevice physicalDevice, int queueFamilyIndex) {
+  return makeDevice(physicalDevice, queueFamilyIndex, deviceExtensions,
+                    DEVICE_EXTENSIONS);
+}
+
+VkDevice makeVkHeadlessDevice(VkPhysicalDevice physicalDevice,
+                              int queueFamilyIndex) {
+  return makeDevice(physicalDevice, queueFamilyIndex, NULL, 0);
 }
 
 struct SwapchainSettings makeSwapchainSettings(VkPhysicalDevice physicalDevice,
@@ -381,56 +472,27 @@ VkShaderModule makeVkShaderModule(VkDevice device, char *path) {
 
 VkRenderPass makeVkRenderPass(VkDevice device,
                               struct SwapchainSettings settings) {
-  VkAttachmentDescription colorAttachment = {0};
-  colorAttachment.format = settings.selectedFormat.format;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference colorAttachmentRef = {0};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass = {0};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-
-  VkSubpassDependency dependency = {0};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo renderPassInfo = {0};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  return makeRenderPass(device, settings.selectedFormat.format,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
 
-  VkRenderPass renderPass;
-  VkResult result =
-      vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass);
-  if (result != VK_SUCCESS) {
-    die("Failed to create render pass: %d\n", result);
-  }
-  return renderPass;
+VkRenderPass makeVkOffscreenRenderPass(VkDevice device,
+                                       struct SwapchainSettings settings) {
+  return makeRenderPass(device, settings.selectedFormat.format,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 }
 
 VkPipelineLayout makeVkPipelineLayout(VkDevice device) {
+  return makeVkPushConstantLayout(device, sizeof(struct PushConstants),
+                                  VK_SHADER_STAGE_VERTEX_BIT);
+}
+
+VkPipelineLayout makeVkPushConstantLayout(VkDevice device, uint32_t size,
+                                          VkShaderStageFlags stages) {
   VkPushConstantRange pushConstants;
   pushConstants.offset = 0;
-  pushConstants.size = sizeof(struct PushConstants);
-  pushConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstants.size = size;
+  pushConstants.stageFlags = stages;
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -452,6 +514,23 @@ VkPipeline makeVkPipeline(VkDevice device, struct SwapchainSettings settings,
                           VkShaderModule vert, VkShaderModule frag,
                           VkRenderPass renderPass,
                           VkPipelineLayout pipelineLayout) {
+  VkVertexInputBindingDescription binding = getVertexBindingDescription();
+  struct VertexInput input = {
+      .bindings = &binding,
+      .bindingCount = 1,
+      .attributes = getVertexAttributeDescriptions(),
+      .attributeCount = getVertexAttributeDescriptionCount(),
+  };
+  return makeVkPipelineWithInput(device, settings, vert, frag, renderPass,
+                                 pipelineLayout, input);
+}
+
+VkPipeline makeVkPipelineWithInput(VkDevice device,
+                                   struct SwapchainSettings settings,
+                                   VkShaderModule vert, VkShaderModule frag,
+                                   VkRenderPass renderPass,
+                                   VkPipelineLayout pipelineLayout,
+                                   struct VertexInput input) {
 // dynamic state
 #define DYNAMIC_STATES 2
   const VkDynamicState dynamicStates[DYNAMIC_STATES] = {
@@ -463,19 +542,13 @@ VkPipeline makeVkPipeline(VkDevice device, struct SwapchainSettings settings,
   dynamicState.pDynamicStates = dynamicStates;
 
   // vertex input state
-  VkVertexInputBindingDescription bindingDescription =
-      getVertexBindingDescription();
-  VkVertexInputAttributeDescription *attributeDescriptions =
-      getVertexAttributeDescriptions();
-
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-      getVertexAttributeDescriptionCount();
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+  vertexInputInfo.vertexBindingDescriptionCount = input.bindingCount;
+  vertexInputInfo.pVertexBindingDescriptions = input.bindings;
+  vertexInputInfo.vertexAttributeDescriptionCount = input.attributeCount;
+  vertexInputInfo.pVertexAttributeDescriptions = input.attributes;
 
   // input assembly stage
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
@@ -703,19 +776,37 @@ struct VertexBufferAndMemory makeVkVertexBuffer(VkPhysicalDevice physicalDevice,
                                                 VkDevice device,
                                                 struct Vertex *vertices,
                                                 int vertexCount) {
+  VkDeviceSize size = sizeof(vertices[0]) * vertexCount;
+  struct VertexBufferAndMemory vbam = makeVkHostBuffer(
+      physicalDevice, device, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+  // copy data
+  void *data;
+  vkMapMemory(device, vbam.memory, 0, size, 0, &data);
+  memcpy(data, vertices, (size_t)size);
+  vkUnmapMemory(device, vbam.memory);
+
+  // done
+  return vbam;
+}
+
+struct VertexBufferAndMemory makeVkHostBuffer(VkPhysicalDevice physicalDevice,
+                                              VkDevice device,
+                                              VkDeviceSize size,
+                                              VkBufferUsageFlags usage) {
   struct VertexBufferAndMemory vbam = {0};
   VkResult result;
 
   // create buffer
   VkBufferCreateInfo bufferInfo = {0};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = sizeof(vertices[0]) * vertexCount;
-  bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
   result = vkCreateBuffer(device, &bufferInfo, NULL, &vbam.buffer);
   if (result != VK_SUCCESS) {
-    die("failed to create vertex buffer!: %d\n", result);
+    die("failed to create buffer!: %d\n", result);
   }
 
   // alloc memory
@@ -732,18 +823,63 @@ struct VertexBufferAndMemory makeVkVertexBuffer(VkPhysicalDevice physicalDevice,
 
   result = vkAllocateMemory(device, &allocInfo, NULL, &vbam.memory);
   if (result != VK_SUCCESS) {
-    die("failed to allocate vertex buffer memory!: %d\n", result);
+    die("failed to allocate buffer memory!: %d\n", result);
   }
 
   // bind memory to buffer
   vkBindBufferMemory(device, vbam.buffer, vbam.memory, 0);
 
-  // copy data
-  void *data;
-  vkMapMemory(device, vbam.memory, 0, bufferInfo.size, 0, &data);
-  memcpy(data, vertices, (size_t)bufferInfo.size);
-  vkUnmapMemory(device, vbam.memory);
-
   // done
   return vbam;
 }
+
+struct ImageAndMemory makeVkColorImage(VkPhysicalDevice physicalDevice,
+                                       VkDevice device,
+                                       struct SwapchainSettings settings) {
+  struct ImageAndMemory iam = {0};
+  VkResult result;
+
+  // create image
+  VkImageCreateInfo imageInfo = {0};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = settings.selectedFormat.format;
+  imageInfo.extent.width = settings.selectedExtent.width;
+  imageInfo.extent.height = settings.selectedExtent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  result = vkCreateImage(device, &imageInfo, NULL, &iam.image);
+  if (result != VK_SUCCESS) {
+    die("failed to create image!: %d\n", result);
+  }
+
+  // alloc memory
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, iam.image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      findMemoryType(physicalDevice, memRequirements.memoryTypeBits,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  result = vkAllocateMemory(device, &allocInfo, NULL, &iam.memory);
+  if (result != VK_SUCCESS) {
+    die("failed to allocate image memory!: %d\n", result);
+  }
+
+  // bind memory to image
+  vkBindImageMemory(device, iam.image, iam.memory, 0);
+
+  // done
+  return iam;
+}
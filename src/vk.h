@@ -25,16 +25,35 @@ struct VertexBufferAndMemory {
   VkDeviceMemory memory;
 };
 
+struct ImageAndMemory {
+  VkImage image;
+  VkDeviceMemory memory;
+};
+
 struct PushConstants {
   struct Vec2 resolution;
 };
 
+// vertex buffer bindings, each per vertex or per instance
+struct VertexInput {
+  const VkVertexInputBindingDescription *bindings;
+  uint32_t bindingCount;
+  const VkVertexInputAttributeDescription *attributes;
+  uint32_t attributeCount;
+};
+
 VkInstance makeVkInstance(char *appName);
 VkSurfaceKHR makeVkSurface(VkInstance instance, GLFWwindow *window);
 VkPhysicalDevice pickVkPhysicalDevice(VkInstance instance);
 int findVkQueueFamilyIndex(VkPhysicalDevice device, VkSurfaceKHR surface);
 VkDevice makeVkDevice(VkPhysicalDevice physicalDevice, int queueFamilyIndex);
 
+// without a window: no surface and no swapchain, for rendering offscreen
+VkInstance makeVkHeadlessInstance(char *appName);
+int findVkGraphicsQueueFamilyIndex(VkPhysicalDevice device);
+VkDevice makeVkHeadlessDevice(VkPhysicalDevice physicalDevice,
+                              int queueFamilyIndex);
+
 struct SwapchainSettings makeSwapchainSettings(VkPhysicalDevice physicalDevice,
                                                VkSurfaceKHR surface, int width,
                                                int height);
@@ -51,11 +70,22 @@ VkImageView *makeVkImageViews(VkDevice device,
 VkShaderModule makeVkShaderModule(VkDevice device, char *path);
 VkRenderPass makeVkRenderPass(VkDevice device,
                               struct SwapchainSettings settings);
+// leaves the image ready to be copied out rather than presented
+VkRenderPass makeVkOffscreenRenderPass(VkDevice device,
+                                       struct SwapchainSettings settings);
 VkPipelineLayout makeVkPipelineLayout(VkDevice device);
+VkPipelineLayout makeVkPushConstantLayout(VkDevice device, uint32_t size,
+                                          VkShaderStageFlags stages);
 VkPipeline makeVkPipeline(VkDevice device, struct SwapchainSettings settings,
                           VkShaderModule vert, VkShaderModule frag,
                           VkRenderPass renderPass,
                           VkPipelineLayout pipelineLayout);
+VkPipeline makeVkPipelineWithInput(VkDevice device,
+                                   struct SwapchainSettings settings,
+                                   VkShaderModule vert, VkShaderModule frag,
+                                   VkRenderPass renderPass,
+                                   VkPipelineLayout pipelineLayout,
+                                   struct VertexInput input);
 
 VkFramebuffer *makeVkFramebuffers(VkDevice device,
                                   struct SwapchainSettings settings,
@@ -71,4 +101,16 @@ struct VertexBufferAndMemory makeVkVertexBuffer(VkPhysicalDevice physicalDevice,
                                                 struct Vertex *vertices,
                                                 int vertexCount);
 
+// host visible and coherent, map it once and write straight into it
+struct VertexBufferAndMemory makeVkHostBuffer(VkPhysicalDevice physicalDevice,
+                                              VkDevice device,
+                                              VkDeviceSize size,
+                                              VkBufferUsageFlags usage);
+
+// a device local color attachment the size and format of `settings`, to render
+// into without a swapchain
+struct ImageAndMemory makeVkColorImage(VkPhysicalDevice physicalDevice,
+                                       VkDevice device,
+                                       struct SwapchainSettings settings);
+
 #endif